@@ -0,0 +1,641 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_base64
+global command_base64
+
+extern asm_getopt
+extern arena_alloc_aligned
+extern base64_decode
+extern base64_decode_final
+extern base64_encode
+extern libc_strtol
+extern read_block
+extern write_block
+
+extern close
+extern dprintf
+extern open
+extern optarg
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_base64:  db  "see base64(1)",10, \
+                          10, \
+                          "Options:",10, \
+                          10, \
+                          "-d      : Decode the data.",10, \
+                          "-w COLS : Wrap encoded lines after COLS characters",10, \
+                          "          (default 76, 0 disables wrapping).",0
+
+;---------------------------------------------------------------------
+
+%assign BASE64_DEFAULT_WRAP     76
+
+; Number of input bytes encoded per line with the default wrap.
+%assign BASE64_LINE_BYTES       ((BASE64_DEFAULT_WRAP / 4) * 3)
+
+; Size of the encode input block.
+;
+; XXX: Must be a multiple of 3 so that padding is only ever required
+; at the end of the final block. Also being a multiple of
+; BASE64_LINE_BYTES means that, with the default wrap, every block
+; ends on a line boundary.
+%assign BASE64_ENC_BLOCK        (BASE64_LINE_BYTES * 1024)
+
+; Size of the encode output buffer: the encoded block plus the worst
+; case number of newlines (one per character with "-w 1").
+%assign BASE64_ENC_OUT_SIZE     ((BASE64_ENC_BLOCK / 3) * 4 * 2)
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Base64 encode or decode a file (or stdin).
+;---------------------------------------------------------------------
+
+command_base64:
+section .rodata
+    .optstring          db  "dw:",0
+    .decode_opt         equ 'd'
+    .wrap_opt           equ 'w'
+cold_rodata
+    .open_fmt           db  "base64: cannot open '%s'",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .decode         equ     16  ; bool.
+    .wrap           equ     24  ; size_t: column to wrap at (0 for none).
+    .file           equ     32  ; "char *"
+    .fd             equ     40  ; int.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.decode], 0
+    mov     qword [rsp+.wrap], BASE64_DEFAULT_WRAP
+    mov     qword [rsp+.fd], STDIN_FD
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .decode_opt
+    je      .handle_decode_opt
+
+    cmp     al, .wrap_opt
+    je      .handle_wrap_opt
+
+    jmp     .error_bad_option
+
+.handle_decode_opt:
+    mov     qword [rsp+.decode], 1
+    jmp     .next_arg
+
+.handle_wrap_opt:
+    mov     rdi, [optarg]
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.wrap]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .error_bad_num
+
+    cmp     qword [rsp+.wrap], 0
+    jl      .error_bad_num
+
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    jz      .opened ; No file so use stdin.
+
+    ; Only a single file is supported.
+    cmp     rcx, 1
+    jne     .error_bad_arg
+
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE]
+    mov     [rsp+.file], rdi
+
+    ; Handle the stdin alias.
+    cmp     byte [rdi], '-'
+    jne     .open_file
+
+    cmp     byte [rdi+1], 0
+    je      .opened
+
+.open_file:
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+.opened:
+    mov     rdi, [rsp+.fd]
+
+    cmp     qword [rsp+.decode], 0
+    jne     .decode_fd
+
+    mov     rsi, [rsp+.wrap]
+    dcall   base64_encode_fd
+    jmp     .done
+
+.decode_fd:
+    dcall   base64_decode_fd
+
+.done:
+    mov     rbx, rax
+
+    cmp     qword [rsp+.fd], STDIN_FD
+    je      .closed
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.closed:
+    mov     rax, CMD_OK
+
+    cmp     rbx, 0
+    je      .out
+
+    mov     rax, CMD_FAILED
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.file]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     rax, CMD_BAD_OPT
+    jmp     .out
+
+.error_bad_num:
+    mov     rax, CMD_BAD_OPT_VAL
+    jmp     .out
+
+.error_bad_arg:
+    mov     rax, CMD_BAD_ARG
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Base64 encode all the data read from the specified
+;   file descriptor to stdout.
+;
+; C prototype equivalent:
+;
+;     int base64_encode_fd(int fd, size_t wrap);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - file descriptor.
+; - Input: RSI (integer) - column to wrap lines at (0 for no wrapping).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Like base64(1), a newline is written after every "wrap"
+;   characters and after any final partial line, but never when
+;   wrapping is disabled.
+;
+; - Each block is encoded straight into the output buffer a line (or
+;   the part of a line remaining) at a time. Only a group that
+;   straddles a line boundary and the final padded group are encoded
+;   separately, so the encoded data is never copied.
+;---------------------------------------------------------------------
+
+base64_encode_fd:
+cold_rodata
+    .read_fmt       db  "base64: read error",10,0
+    .write_fmt      db  "base64: write error",10,0
+section .text
+    prologue_with_vars 12
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd         equ     0   ; int.
+    .wrap       equ     8   ; size_t: column to wrap at (0 for none).
+    .in_buf     equ    16   ; "unsigned char *": input block.
+    .out_buf    equ    24   ; "char *": output buffer.
+    .len        equ    32   ; size_t: bytes in input block.
+    .pos        equ    40   ; size_t: offset of next byte to encode.
+    .dst        equ    48   ; "char *": next free byte in output buffer.
+    .col        equ    56   ; size_t: current output column.
+    .eof        equ    64   ; bool.
+    .count      equ    72   ; size_t.
+    .group      equ    80   ; char [4]: encoded straddling/final group.
+    .ret        equ    88   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd], rdi
+    mov     [rsp+.wrap], rsi
+
+    mov     qword [rsp+.col], 0
+    mov     qword [rsp+.eof], 0
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+
+    mov     rdi, BASE64_ENC_BLOCK
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.in_buf], rax
+
+    mov     rdi, BASE64_ENC_OUT_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.out_buf], rax
+
+.read:
+    cmp     qword [rsp+.eof], 0
+    jne     .finish
+
+    mov     qword [rsp+.len], 0
+
+    ; Fill the block, since only the final block may be a partial one
+    ; (and a short read from a pipe is not the end of the data).
+.fill:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rsp+.in_buf]
+    add     rsi, [rsp+.len]
+    mov     rdx, BASE64_ENC_BLOCK
+    sub     rdx, [rsp+.len]
+    dcall   read_block
+    cmp     rax, 0
+    je      .at_eof
+    jl      .error_read
+
+    add     [rsp+.len], rax
+
+    cmp     qword [rsp+.len], BASE64_ENC_BLOCK
+    jb      .fill
+
+    jmp     .encode
+
+.at_eof:
+    mov     qword [rsp+.eof], 1
+
+    cmp     qword [rsp+.len], 0
+    je      .finish
+
+.encode:
+    mov     qword [rsp+.pos], 0
+
+    mov     rax, [rsp+.out_buf]
+    mov     [rsp+.dst], rax
+
+.next_chunk:
+    mov     rsi, [rsp+.len]
+    sub     rsi, [rsp+.pos]
+    jz      .write
+
+    cmp     qword [rsp+.wrap], 0
+    jne     .wrapped
+
+    ; No wrapping so encode the rest of the block in one go.
+    mov     rdi, [rsp+.in_buf]
+    add     rdi, [rsp+.pos]
+    add     [rsp+.pos], rsi
+    mov     rdx, [rsp+.dst]
+    dcall   base64_encode
+    add     [rsp+.dst], rax
+    jmp     .write
+
+.wrapped:
+    ;--------------------
+    ; groups = min(remaining / 3, (wrap - col) / 4)
+
+    mov     rax, rsi
+    xor     rdx, rdx
+    mov     rcx, 3
+    div     rcx
+    mov     rcx, rax
+
+    mov     rax, [rsp+.wrap]
+    sub     rax, [rsp+.col]
+    shr     rax, 2
+
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+    cmp     rax, 0
+    je      .split_group
+
+    lea     rsi, [rax+rax*2]
+    mov     rdi, [rsp+.in_buf]
+    add     rdi, [rsp+.pos]
+    add     [rsp+.pos], rsi
+    mov     rdx, [rsp+.dst]
+    dcall   base64_encode
+
+    add     [rsp+.dst], rax
+    add     [rsp+.col], rax
+
+    mov     rax, [rsp+.col]
+    cmp     rax, [rsp+.wrap]
+    jne     .next_chunk
+
+    mov     rdx, [rsp+.dst]
+    mov     byte [rdx], NL
+    inc     qword [rsp+.dst]
+    mov     qword [rsp+.col], 0
+
+    jmp     .next_chunk
+
+.split_group:
+    ;--------------------
+    ; Either the next group straddles the end of the line, or this is
+    ; the final (padded) group: encode it separately and then copy it
+    ; a character at a time.
+
+    mov     rsi, [rsp+.len]
+    sub     rsi, [rsp+.pos]
+    cmp     rsi, 3
+    jbe     .group_size_ok
+
+    mov     rsi, 3
+
+.group_size_ok:
+    mov     rdi, [rsp+.in_buf]
+    add     rdi, [rsp+.pos]
+    add     [rsp+.pos], rsi
+    lea     rdx, [rsp+.group]
+    dcall   base64_encode
+    mov     [rsp+.count], rax
+
+    xor     rbx, rbx
+
+.copy_char:
+    cmp     rbx, [rsp+.count]
+    jae     .next_chunk
+
+    mov     al, [rsp+.group+rbx]
+    mov     rdx, [rsp+.dst]
+    mov     [rdx], al
+    inc     rdx
+    mov     [rsp+.dst], rdx
+
+    inc     qword [rsp+.col]
+    mov     rax, [rsp+.col]
+    cmp     rax, [rsp+.wrap]
+    jne     .char_copied
+
+    mov     byte [rdx], NL
+    inc     qword [rsp+.dst]
+    mov     qword [rsp+.col], 0
+
+.char_copied:
+    inc     rbx
+    jmp     .copy_char
+
+.write:
+    mov     rdx, [rsp+.dst]
+    sub     rdx, [rsp+.out_buf]
+    mov     [rsp+.count], rdx
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.out_buf]
+    dcall   write_block
+    cmp     rax, [rsp+.count]
+    jne     .error_write
+
+    jmp     .read
+
+.finish:
+    ; Terminate a partial final line.
+    cmp     qword [rsp+.col], 0
+    je      .out
+
+    mov     rsi, [rsp+.out_buf]
+    mov     byte [rsi], NL
+
+    mov     rdi, STDOUT_FD
+    mov     rdx, 1
+    dcall   write_block
+    cmp     rax, 1
+    jne     .error_write
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 12
+    ret
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .error
+
+.error_write:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Decode all the base64 data read from the specified file
+;   descriptor to stdout.
+;
+; C prototype equivalent:
+;
+;     int base64_decode_fd(int fd);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - file descriptor.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Newlines are ignored.
+;
+; - Like base64(1), the data decoded before any invalid input is
+;   written before the error is reported.
+;---------------------------------------------------------------------
+
+base64_decode_fd:
+cold_rodata
+    .read_fmt       db  "base64: read error",10,0
+    .write_fmt      db  "base64: write error",10,0
+    .invalid_fmt    db  "base64: invalid input",10,0
+section .text
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd         equ     0   ; int.
+    .in_buf     equ     8   ; "char *": input buffer.
+    .out_buf    equ    16   ; "unsigned char *": output buffer.
+    .count      equ    24   ; size_t: bytes decoded.
+    .eof        equ    32   ; bool.
+    .ret        equ    40   ; int: return value.
+    .decoder    equ    48   ; Base64Decoder.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd], rdi
+
+    mov     qword [rsp+.eof], 0
+    mov     qword [rsp+.ret], 0
+
+    mov     dword [rsp+.decoder+Base64Decoder.count], 0
+    mov     dword [rsp+.decoder+Base64Decoder.invalid], 0
+
+    ;--------------------
+
+    mov     rdi, IO_READ_BUF_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.in_buf], rax
+
+    ; Decoding never produces more bytes than it consumes (including
+    ; the characters of a group carried over from the previous read).
+    mov     rdi, IO_READ_BUF_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.out_buf], rax
+
+.read:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rsp+.in_buf]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+    cmp     rax, 0
+    je      .final
+    jl      .error_read
+
+    lea     rdi, [rsp+.decoder]
+    mov     rsi, [rsp+.in_buf]
+    mov     rdx, rax
+    mov     rcx, [rsp+.out_buf]
+    dcall   base64_decode
+    jmp     .write
+
+.final:
+    mov     qword [rsp+.eof], 1
+
+    ; Handle any incomplete final group.
+    lea     rdi, [rsp+.decoder]
+    mov     rsi, [rsp+.out_buf]
+    dcall   base64_decode_final
+
+.write:
+    mov     [rsp+.count], rax
+    cmp     rax, 0
+    je      .written
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.out_buf]
+    mov     rdx, rax
+    dcall   write_block
+    cmp     rax, [rsp+.count]
+    jne     .error_write
+
+.written:
+    cmp     dword [rsp+.decoder+Base64Decoder.invalid], 0
+    jne     .error_invalid
+
+    cmp     qword [rsp+.eof], 0
+    je      .read
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 8
+    ret
+
+.error_invalid:
+    mov     rdi, STDERR_FD
+    mov     rsi, .invalid_fmt
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .error
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .error
+
+.error_write:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     qword [rsp+.ret], -1
+    jmp     .out
@@ -9,85 +9,284 @@
 global command_help_basename
 global command_basename
 
-extern free
-extern puts
-extern strdup
+extern arena_alloc
+extern asm_basename_len
+extern asm_getopt
+extern asm_memcmp
+extern asm_strlen
+extern read_block
+extern write_block
 
-; Use the POSIX version of the libc function for compatibility
-; with basename(1).
-;
-; XXX: See basename(3) for the gruesome details.
-; XXX: Note: we could add an option to toggle between the two differnt
-; implementations (which have slightly different behaviour)?
-extern __xpg_basename
+extern dprintf
+extern memchr
+extern memcpy
+extern memmove
+extern optarg
+
+extern optind
 
 %include "header.inc"
 
-section .rodata
-command_help_basename:      db    "see basename(1)",0
+cold_rodata
+command_help_basename:  db  "see basename(1)",10, \
+                            10, \
+                            "Options:",10, \
+                            10, \
+                            "-a        : Handle multiple names.",10, \
+                            "-s SUFFIX : Remove SUFFIX from each name (implies '-a').",10, \
+                            "-z        : Separate output names with a nul byte rather than a newline.",10, \
+                            "--stdin   : Read the names from stdin (one per line, or nul separated",10, \
+                            "            with '-z'), rather than from the arguments.",0
+
+;---------------------------------------------------------------------
+
+; Size of the output buffer.
+%assign BASENAME_OUT_SIZE       (64 * 1024)
+
+; Size of the stdin buffer (and so the maximum length of a name read
+; from stdin).
+%assign BASENAME_IN_SIZE        (1024 * 1024)
+
+struc BasenameState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .suffix         resq    1 ; "const char *": suffix to remove (or 0).
+    .suffix_len     resq    1 ; size_t.
+    .terminator     resq    1 ; char: output name separator.
+    .out            resq    1 ; "char *": output buffer.
+    .out_len        resq    1 ; size_t: bytes in .out.
+    .in             resq    1 ; "char *": stdin buffer.
+endstruc
 
 section .text
 
+;---------------------------------------------------------------------
+; Extensions:
+;
+; - Provides a '--stdin' option to read the names from stdin, which
+;   avoids the argument length limits (and the cost of running
+;   xargs(1)) for very large lists of names.
+;
+; Notes:
+;
+; - The names are never copied or modified: asm_basename_len() finds
+;   the basename within each name, which is then added to an output
+;   buffer that is written with a single write(2) per
+;   BASENAME_OUT_SIZE bytes.
+;---------------------------------------------------------------------
+
 command_basename:
-    prologue_with_vars 1
+section .rodata
+    .optstring          db  "as:z",0
+    .all_opt            equ 'a'
+    .suffix_opt         equ 's'
+    .zero_opt           equ 'z'
+    .stdin_opt          db  "--stdin",0
+section .text
+    prologue_with_vars 6
+
+    alloc_space BasenameState_size
 
     ;--------------------
     ; Stack offsets.
 
-    .p          equ     0   ; "char *" pointer.
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .all            equ     16  ; bool: handle every argument.
+    .stdin          equ     24  ; bool: read names from stdin.
+    .i              equ     32  ; size_t: argument index.
+    .ret            equ     40  ; int: return value.
+    .state          equ     48  ; BasenameState.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.all], 0
+    mov     qword [rsp+.stdin], 0
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     qword [rsp+.state+BasenameState.suffix], 0
+    mov     qword [rsp+.state+BasenameState.suffix_len], 0
+    mov     qword [rsp+.state+BasenameState.terminator], 10
+    mov     qword [rsp+.state+BasenameState.out_len], 0
+    mov     qword [rsp+.state+BasenameState.in], 0
 
     ;--------------------
 
-    consume_program_name
+.next_arg:
+    ; asm_getopt() does not support long options (it treats any
+    ; argument starting with "--" as the end of the options), so handle
+    ; "--stdin" first.
+    mov     eax, [optind]
+    cdqe
+    cmp     rax, [rsp+.argc]
+    jae     .getopt
 
-    cmp     rdi, 0
+    mov     rcx, [rsp+.argv]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+    mov     rsi, .stdin_opt
+    mov     rdx, 8 ; Include the terminator.
+    dcall   asm_memcmp
+    cmp     rax, 0
+    jne     .getopt
+
+    mov     qword [rsp+.stdin], 1
+    inc     dword [optind]
+    jmp     .next_arg
+
+.getopt:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .all_opt
+    je      .handle_all_opt
+
+    cmp     al, .suffix_opt
+    je      .handle_suffix_opt
+
+    cmp     al, .zero_opt
+    je      .handle_zero_opt
+
+    jmp     .error_bad_option
+
+.handle_all_opt:
+    mov     qword [rsp+.all], 1
+    jmp     .next_arg
+
+.handle_suffix_opt:
+    mov     qword [rsp+.all], 1
+
+    mov     rdi, [optarg]
+    mov     [rsp+.state+BasenameState.suffix], rdi
+    dcall   asm_strlen
+    mov     [rsp+.state+BasenameState.suffix_len], rax
+    jmp     .next_arg
+
+.handle_zero_opt:
+    mov     qword [rsp+.state+BasenameState.terminator], 0
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.i], rax
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+
+    cmp     qword [rsp+.stdin], 1
+    je      .check_stdin_args
+
+    cmp     rcx, 0
     je      .error_no_arg
 
-    ; Get the first argument
-    mov     rdi, [rsi]
+    cmp     qword [rsp+.all], 1
+    je      .setup
 
-    cmp     rdi, 0
-    je      .error ; Something bad happened.
+    ; "basename NAME [SUFFIX]"
+    cmp     rcx, 2
+    ja      .error_bad_arg
+    jb      .setup
 
-    mov     al, [rdi] ; Get 1st char of string
-    cmp     al, 0
-    je      .just_print_nl ; Empty string specified.
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE+PTR_SIZE]
+    mov     [rsp+.state+BasenameState.suffix], rdi
+    dcall   asm_strlen
+    mov     [rsp+.state+BasenameState.suffix_len], rax
 
-    dcall   strdup
+    ; Only handle the name.
+    dec     qword [rsp+.argc]
+    jmp     .setup
+
+.check_stdin_args:
+    ; Names cannot be specified as arguments too.
+    cmp     rcx, 0
+    jne     .error_bad_arg
+
+.setup:
+    mov     rdi, BASENAME_OUT_SIZE
+    dcall   arena_alloc
     cmp     rax, 0
     je      .error
 
-    mov     [rsp+.p], rax
+    mov     [rsp+.state+BasenameState.out], rax
 
-    mov     rdi, rax
+    cmp     qword [rsp+.stdin], 1
+    je      .read_stdin
 
-    dcall   __xpg_basename
+.next_name:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.argc]
+    jae     .flush
+
+    mov     rcx, [rsp+.argv]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+    dcall   asm_strlen
+
+    mov     rcx, [rsp+.i]
+    mov     rdx, [rsp+.argv]
+    mov     rsi, [rdx+rcx*PTR_SIZE]
+    mov     rdx, rax
+    lea     rdi, [rsp+.state]
+    dcall   basename_name
     cmp     rax, 0
-    je     .error
+    jne     .error
 
-    mov     rdi, rax
-    dcall   puts
+    inc     qword [rsp+.i]
+    jmp     .next_name
 
-    mov     rdi, [rsp+.p]
-    dcall   free
+.read_stdin:
+    mov     rdi, BASENAME_IN_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
 
-.success:
+    mov     [rsp+.state+BasenameState.in], rax
 
-    mov     rax, CMD_OK
+    lea     rdi, [rsp+.state]
+    dcall   basename_stdin
+    mov     [rsp+.ret], rax
+
+.flush:
+    lea     rdi, [rsp+.state]
+    dcall   basename_flush
+    cmp     rax, 0
+    jne     .error
+
+    mov     rax, [rsp+.ret]
 
 .out:
-    epilogue_with_vars 1
+    free_space BasenameState_size
+    epilogue_with_vars 6
 
     ret
 
-; Although the man page disagrees, it seems that the POSIX version of
-; basename prints a period if the path is empty. However, basename(3)
-; only prints a newline in that scenario so be compatible with
-; basename(3).
-.just_print_nl:
-    dcall   puts
-    jmp     .success
-
 .error:
     mov     rax, CMD_FAILED
     jmp     .out
@@ -95,3 +294,351 @@ command_basename:
 .error_no_arg:
     mov     rax, CMD_NO_ARG
     jmp     .out
+
+.error_bad_arg:
+    mov     rax, CMD_BAD_ARG
+    jmp     .out
+
+.error_bad_option:
+    mov     rax, CMD_BAD_OPT
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the basename of the specified name.
+;
+; C prototype equivalent:
+;
+;     int basename_name(BasenameState *state, const char *name,
+;                       size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - BasenameState.
+; - Input: RSI (address) - name (which does not need to be nul
+;   terminated).
+; - Input: RDX (integer) - length of name.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; Like basename(1), the suffix is only removed if it is not the
+; entire basename.
+;---------------------------------------------------------------------
+
+basename_name:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .name       equ     0   ; "const char *": basename.
+    .len        equ     8   ; size_t: length of basename.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rdi, rsi
+    mov     rsi, rdx
+    lea     rdx, [rsp+.len]
+    dcall   asm_basename_len
+    mov     [rsp+.name], rax
+
+    ;--------------------
+    ; Remove the suffix.
+
+    mov     rcx, [rbx+BasenameState.suffix_len]
+    cmp     rcx, 0
+    je      .write
+
+    mov     rdx, [rsp+.len]
+    cmp     rdx, rcx
+    jbe     .write
+
+    sub     rdx, rcx
+    lea     rdi, [rax+rdx]
+    mov     rsi, [rbx+BasenameState.suffix]
+    mov     rdx, rcx
+    dcall   asm_memcmp
+    cmp     rax, 0
+    jne     .write
+
+    mov     rcx, [rbx+BasenameState.suffix_len]
+    sub     [rsp+.len], rcx
+
+.write:
+    mov     rdi, rbx
+    mov     rsi, [rsp+.name]
+    mov     rdx, [rsp+.len]
+    dcall   basename_write
+    cmp     rax, 0
+    jne     .out
+
+    ; Add the terminator (which always fits after a write).
+    mov     rax, [rbx+BasenameState.out]
+    mov     rcx, [rbx+BasenameState.out_len]
+    mov     dl, [rbx+BasenameState.terminator]
+    mov     [rax+rcx], dl
+    inc     qword [rbx+BasenameState.out_len]
+
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Display the basename of each name read from stdin.
+;
+; C prototype equivalent:
+;
+;     int basename_stdin(BasenameState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - BasenameState.
+; - Output: RAX (integer) - CMD_OK on success, or CMD_FAILED on error.
+;
+; Notes:
+;
+; - The names are separated by the output terminator (a newline, or a
+;   nul byte for '-z'). A final name without a terminator is also
+;   handled.
+;
+; - A partial name at the end of the buffer is moved to the start of
+;   the buffer before the next read.
+;
+; Limitations:
+;
+; - Names must be shorter than BASENAME_IN_SIZE bytes.
+;---------------------------------------------------------------------
+
+basename_stdin:
+cold_rodata
+    .read_fmt       db  "basename: failed to read stdin",10,0
+    .long_fmt       db  "basename: name too long",10,0
+section .text
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .used       equ     0   ; size_t: bytes in the buffer.
+    .p          equ     8   ; "char *": next name.
+    .end        equ     16  ; "char *": end of the data.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     qword [rsp+.used], 0
+
+.read:
+    mov     rdi, STDIN_FD
+    mov     rsi, [rbx+BasenameState.in]
+    add     rsi, [rsp+.used]
+    mov     rdx, BASENAME_IN_SIZE
+    sub     rdx, [rsp+.used]
+    dcall   read_block
+    cmp     rax, 0
+    jl      .error_read
+    je      .eof
+
+    mov     rcx, [rbx+BasenameState.in]
+    mov     [rsp+.p], rcx
+    add     rax, [rsp+.used]
+    add     rcx, rax
+    mov     [rsp+.end], rcx
+
+.next_name:
+    mov     rdi, [rsp+.p]
+    movzx   esi, byte [rbx+BasenameState.terminator]
+    mov     rdx, [rsp+.end]
+    sub     rdx, rdi
+    dcall   memchr
+    cmp     rax, 0
+    je      .partial
+
+    mov     rdx, rax
+    mov     rsi, [rsp+.p]
+    sub     rdx, rsi
+    inc     rax
+    mov     [rsp+.p], rax
+
+    mov     rdi, rbx
+    dcall   basename_name
+    cmp     rax, 0
+    jne     .error
+
+    jmp     .next_name
+
+.partial:
+    ; Move the start of the partial name to the start of the buffer.
+    mov     rdx, [rsp+.end]
+    mov     rsi, [rsp+.p]
+    sub     rdx, rsi
+    mov     [rsp+.used], rdx
+
+    cmp     rdx, BASENAME_IN_SIZE
+    je      .error_long
+
+    mov     rdi, [rbx+BasenameState.in]
+    dcall   memmove
+
+    jmp     .read
+
+.eof:
+    cmp     qword [rsp+.used], 0
+    je      .success
+
+    ; Handle the final unterminated name.
+    mov     rdi, rbx
+    mov     rsi, [rbx+BasenameState.in]
+    mov     rdx, [rsp+.used]
+    dcall   basename_name
+    cmp     rax, 0
+    jne     .error
+
+.success:
+    mov     rax, CMD_OK
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+.error_long:
+    mov     rsi, .long_fmt
+    jmp     .error_msg
+
+.error_read:
+    mov     rsi, .read_fmt
+
+.error_msg:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Add data to the output buffer, leaving space for at
+;   least one more byte.
+;
+; C prototype equivalent:
+;
+;     int basename_write(BasenameState *state, const char *data,
+;                        size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - BasenameState.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; Data too large for the buffer is written directly.
+;---------------------------------------------------------------------
+
+basename_write:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .data       equ     0   ; "const char *"
+    .len        equ     8   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.data], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    mov     rax, [rbx+BasenameState.out_len]
+    lea     rax, [rax+rdx+1]
+    cmp     rax, BASENAME_OUT_SIZE
+    jbe     .copy
+
+    mov     rdi, rbx
+    dcall   basename_flush
+    cmp     rax, 0
+    jne     .out
+
+    mov     rdx, [rsp+.len]
+    cmp     rdx, BASENAME_OUT_SIZE
+    jb      .copy
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.data]
+    dcall   write_block
+    cmp     rax, [rsp+.len]
+    jne     .error
+
+    xor     eax, eax
+    jmp     .out
+
+.copy:
+    mov     rdi, [rbx+BasenameState.out]
+    add     rdi, [rbx+BasenameState.out_len]
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    add     [rbx+BasenameState.out_len], rdx
+    dcall   memcpy
+
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Write the output buffer to stdout.
+;
+; C prototype equivalent:
+;
+;     int basename_flush(BasenameState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - BasenameState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+basename_flush:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    xor     eax, eax
+
+    mov     rdx, [rbx+BasenameState.out_len]
+    cmp     rdx, 0
+    je      .out
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rbx+BasenameState.out]
+    dcall   write_block
+    cmp     rax, [rbx+BasenameState.out_len]
+    jne     .error
+
+    mov     qword [rbx+BasenameState.out_len], 0
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
@@ -10,28 +10,116 @@ global command_help_cat
 global command_cat
 
 extern close
+extern get_nprocs
 extern open
+extern posix_fadvise
+extern pthread_create
+extern pthread_join
+
+extern arena_alloc_aligned
+extern arena_mark
+extern arena_release
+extern futex_wait
+extern futex_wake
+extern libc_strtol
+extern prefetch_end
+extern prefetch_next
+extern prefetch_read
+extern prefetch_start
 extern read_block
+extern write_block
 
-; FIXME: using stdin_filename instead
-extern stdin_alias
+%include "header.inc"
+%include "prefetch.inc"
 
-extern write_block
+cold_rodata
+command_help_cat:  db  "see cat(1)",10, \
+                       10, \
+                       "Extensions:",10, \
+                       10, \
+                       "-p   : Pipelined mode: read on a separate thread while writing.",10, \
+                       "-P N : Read up to N files at the same time (0 for one per CPU).",10, \
+                       "       The output is the same as when reading one at a time.",0
 
-section .rodata
-command_help_cat:  db  "see cat(1)",0
+;---------------------------------------------------------------------
+; Number of buffers in the pipelined mode ring.
+;
+; XXX: Must be a power of two (so that a ring index can be calculated
+; with a mask rather than a division).
+%assign CAT_RING_SLOTS  8
 
-%include "header.inc"
+;---------------------------------------------------------------------
+; Single-producer, single-consumer ring of buffers used by the
+; pipelined mode (see cat_pipelined()).
+;
+; The reader thread is the only writer of .head and
+; .reader_waiting, and the writer (main thread) is the only writer
+; of .tail and .writer_waiting. The two groups live on separate
+; cache lines so that the threads do not keep stealing the same line
+; from each other.
+;
+; .head and .tail are free-running 32-bit counters: the number of
+; full slots is (head - tail) (modulo 2^32) and the slot for a
+; counter value is (counter & (CAT_RING_SLOTS-1)).
+;---------------------------------------------------------------------
+struc CatRing
+
+%ifdef NASM
+    align 8,db 0
+%endif
 
-section .text
+%ifdef YASM
+    align 8
+%endif
+    ; Reader (producer) cache line.
+    .head            resd    1 ; uint32_t: number of slots filled.
+    .reader_waiting  resd    1 ; uint32_t: bool: reader is in futex_wait().
+    .head_pad        resb    (CACHE_LINE_SIZE - 8)
+
+    ; Writer (consumer) cache line.
+    .tail            resd    1 ; uint32_t: number of slots drained.
+    .writer_waiting  resd    1 ; uint32_t: bool: writer is in futex_wait().
+    .tail_pad        resb    (CACHE_LINE_SIZE - 8)
+
+    ; Set once before the reader thread starts.
+    .fd              resq    1 ; int: file descriptor to read from.
+    .buffers         resq    1 ; "char *": CAT_RING_SLOTS buffers.
+
+    ; Set by the writer to ask the reader to give up.
+    .stop            resq    1 ; bool.
+
+    ; Byte count for each slot: >0 is data, 0 is EOF, -1 is a read error.
+    .bytes           resq    CAT_RING_SLOTS ; ssize_t array.
+endstruc
+
+hot_text cat
 
 ;---------------------------------------------------------------------
+; Extensions:
+;
+; - Provides a '-p' (pipelined) option. In this mode, a reader thread
+;   fills a ring of buffers while the main thread writes them out, so
+;   a slow output (such as a network pipe) does not leave the input
+;   idle and vice versa.
+;
+; - Provides a '-P N' (parallel) option. In this mode, up to N files
+;   are read at the same time by a pool of reader threads while the
+;   main thread writes them out in order (see cat_parallel()).
+;
+; Notes:
+;
+; - When multiple files are specified, the next file is opened and the
+;   kernel is asked to start reading it (see cat_open()) while the
+;   current file is still being written.
 ;
+; - The options must come before the files.
 ;---------------------------------------------------------------------
 
 command_cat:
-section .text
-    prologue_with_vars 3
+    .pipelined_opt  equ '-p'
+    .parallel_opt   equ '-P'
+hot_text cat
+    prologue_with_vars 6
 
     ;--------------------
     ; Stack offsets.
@@ -39,6 +127,16 @@ section .text
     .argc       equ     0   ; size_t.
     .argv       equ     8   ; "char **"
     .fd_in      equ    16   ; size_t: file descriptor (int actually).
+    .fd_next    equ    24   ; size_t: fd of next file (or -1).
+    .pipelined  equ    32   ; bool: use cat_pipelined().
+    .threads    equ    40   ; size_t: use cat_parallel() if >0.
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.fd_next], -1
+    mov     qword [rsp+.pipelined], 0
+    mov     qword [rsp+.threads], 0
 
     ;--------------------
     ; Save args
@@ -50,52 +148,143 @@ section .text
     mov     [rsp+.argv], rsi
 
     ;--------------------
+    ; Look for the options (which must come before the files).
 
-    cmp     rdi, 0
-    jg      .not_stdin
+.next_opt:
+    cmp     qword [rsp+.argc], 0
+    je      .options_parsed
+
+    mov     rax, [rsp+.argv]
+    mov     rax, [rax]
+    movzx   ecx, word [rax]
+
+    cmp     cx, .pipelined_opt
+    je      .handle_pipelined_opt
+
+    cmp     cx, .parallel_opt
+    je      .handle_parallel_opt
+
+    jmp     .options_parsed
+
+.handle_pipelined_opt:
+    cmp     byte [rax+2], 0
+    jne     .options_parsed
+
+    mov     qword [rsp+.pipelined], 1
+    jmp     .consume_opt
+
+.handle_parallel_opt:
+    ; The value is either part of the option ("-P4") or the next arg.
+    lea     rdi, [rax+2]
+    cmp     byte [rdi], 0
+    jne     .parse_threads
+
+    add     qword [rsp+.argv], 8 ; argv++
+    dec     qword [rsp+.argc]    ; argc--
+
+    cmp     qword [rsp+.argc], 0
+    je      .error_no_threads
+
+    mov     rax, [rsp+.argv]
+    mov     rdi, [rax]
+
+.parse_threads:
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.threads]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .error_bad_threads
+
+    cmp     qword [rsp+.threads], 0
+    jl      .error_bad_threads
+    jg      .consume_opt
 
-    ; The user didn't specify an argument, which means that the
+    ; One per CPU.
+    dcall   get_nprocs
+    cdqe
+
+    cmp     rax, 1
+    jge     .save_threads
+
+    mov     rax, 1
+
+.save_threads:
+    mov     [rsp+.threads], rax
+
+.consume_opt:
+    add     qword [rsp+.argv], 8 ; argv++
+    dec     qword [rsp+.argc]    ; argc--
+    jmp     .next_opt
+
+.options_parsed:
+    cmp     qword [rsp+.argc], 0
+    jg      .have_files
+
+.read_stdin:
+    ; The user didn't specify a file argument, which means that the
     ; command should read from stdin.
     mov     rdi, STDIN_FD
+    mov     rsi, [rsp+.pipelined]
 
-    dcall   cat
+    dcall   cat_fd
     cmp     rax, 0
     jne     .error
 
     jmp     .success
 
-.not_stdin:
-.next_file:
-    mov     rdi, [rsi] ; Grab the next filename.
+.have_files:
+    cmp     qword [rsp+.threads], 0
+    je      .not_stdin
 
-    ; Check if the stdin alias has been specified as an arg.
-    mov     rax, [rdi]
-    cmp     al, stdin_filename
-    cmp     ah, 0
-    jne     .open_file
+    mov     rdi, [rsp+.argv]
+    mov     rsi, [rsp+.argc]
+    mov     rdx, [rsp+.threads]
 
-    ;--------------------
-    ; Ok, arg is exactly "-", so read from stdin.
+    dcall   cat_parallel
+    cmp     rax, 0
+    je      .success
+    jl      .error
 
-    ; The return code (fd) from the elided open(2) call for stdin.
-    mov     rax, STDIN_FD
+    ; The reader threads could not be started, so handle the files
+    ; one at a time.
 
-    jmp     .file_opened
+.not_stdin:
+    ; Open the first file.
+    mov     rax, [rsp+.argv]
+    mov     rdi, [rax]
 
-.open_file:
-    mov     rsi, O_RDONLY
-    dcall   open
+    dcall   cat_open
     cmp     rax, -1
     je      .error
 
-.file_opened:
-    ; Save the fd
     mov     [rsp+.fd_in], rax
 
-    ; Setup cat call
-    mov     rdi, rax
+.next_file:
+    ;--------------------
+    ; Open the next file (if there is one) so the kernel can start
+    ; reading it while we handle the current one.
 
-    dcall   cat
+    mov     qword [rsp+.fd_next], -1
+
+    cmp     qword [rsp+.argc], 1
+    jle     .no_next_file
+
+    mov     rax, [rsp+.argv]
+    mov     rdi, [rax+8]
+
+    ; Note: failure is not fatal here: if the open failed, it will be
+    ; retried (and the error handled) when it is the file's turn.
+    dcall   cat_open
+    mov     [rsp+.fd_next], rax
+
+.no_next_file:
+    ;--------------------
+    ; Handle the current file.
+
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.pipelined]
+
+    dcall   cat_fd
     cmp     rax, 0
     jne     .error
 
@@ -114,26 +303,159 @@ section .text
     add     qword [rsp+.argv], 8 ; argv++
     dec     qword [rsp+.argc]    ; argc--
 
-    ; Reload the values
-    mov     rdi, [rsp+.argc]
-    mov     rsi, [rsp+.argv]
-
-    cmp     rdi, 0  ; argc was >=1, but is now zero!
+    cmp     qword [rsp+.argc], 0  ; argc was >=1, but is now zero!
     je      .success
+
+    ; The next file becomes the current one.
+    mov     rax, [rsp+.fd_next]
+    mov     [rsp+.fd_in], rax
+    mov     qword [rsp+.fd_next], -1
+
+    cmp     rax, -1
+    jne     .next_file
+
+    ; The early open failed, so try again to handle the error.
+    mov     rax, [rsp+.argv]
+    mov     rdi, [rax]
+
+    dcall   cat_open
+    cmp     rax, -1
+    je      .error
+
+    mov     [rsp+.fd_in], rax
     jmp     .next_file
 
 .success:
     mov     rax, CMD_OK
 
 .out:
-    epilogue_with_vars 3
+    epilogue_with_vars 6
 
     ret
 
+.error_no_threads:
+    mov     rax, CMD_NO_ARG
+    jmp     .out
+
+.error_bad_threads:
+    mov     rax, CMD_BAD_OPT_VAL
+    jmp     .out
+
 .error:
+    ; Don't leak the early-opened file.
+    mov     rdi, [rsp+.fd_next]
+    cmp     rdi, 0
+    jle     .error_no_next_file
+
+    dcall   close
+
+.error_no_next_file:
     mov     rax, CMD_FAILED
     jmp     .out
 
+;---------------------------------------------------------------------
+; Description: Open a file for cat(1) and tell the kernel that we are
+;   about to read all of it.
+;
+; C prototype equivalent:
+;
+;     int cat_open(const char *path);
+;
+; Parameters:
+;
+; - Input: RDI (string) - path to open, or "-" for stdin.
+; - Output: RAX (integer) - file descriptor on success, or -1 on error.
+;
+; Notes:
+;
+; The POSIX_FADV_WILLNEED hint makes the kernel start asynchronous
+; readahead of the file immediately, so by the time cat() gets to it,
+; (some of) the data should already be in the page cache.
+;
+; See: posix_fadvise(2).
+;---------------------------------------------------------------------
+
+cat_open:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd         equ     0   ; size_t: file descriptor (int actually).
+
+    ;--------------------
+    ; Check if the stdin alias has been specified (exactly "-").
+
+    cmp     byte [rdi], stdin_filename
+    jne     .open_file
+
+    cmp     byte [rdi+1], 0
+    jne     .open_file
+
+    mov     rax, STDIN_FD
+    jmp     .out
+
+.open_file:
+    mov     rsi, O_RDONLY
+    dcall   open
+
+    ; open(2) returns an int, so sign extend it.
+    cdqe
+    cmp     rax, -1
+    je      .out
+
+    mov     [rsp+.fd], rax
+
+    ; Advisory only, so ignore failures.
+    mov     rdi, rax
+    mov     rsi, 0 ; offset.
+    mov     rdx, 0 ; length (0 means "to the end of the file").
+    mov     rcx, POSIX_FADV_WILLNEED
+    dcall   posix_fadvise
+
+    mov     rdi, [rsp+.fd]
+    mov     rsi, 0
+    mov     rdx, 0
+    mov     rcx, POSIX_FADV_SEQUENTIAL
+    dcall   posix_fadvise
+
+    mov     rax, [rsp+.fd]
+
+.out:
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Display the file specified by it's file descriptor using
+;   the selected mode.
+;
+; C prototype equivalent:
+;
+;     int cat_fd(int fd, bool pipelined);
+;
+; Parameters:
+;
+; - Input: RDI (int) - File descriptor to read from.
+; - Input: RSI (bool) - if true, use cat_pipelined(), else cat().
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cat_fd:
+    prologue_with_vars 0
+
+    cmp     rsi, 0
+    je      .not_pipelined
+
+    dcall   cat_pipelined
+    jmp     .out
+
+.not_pipelined:
+    dcall   cat
+
+.out:
+    epilogue_with_vars 0
+    ret
+
 ;---------------------------------------------------------------------
 ; Description: Read a single file specified by it's file descriptor
 ;   and display to stdout.
@@ -169,8 +491,8 @@ cat:
 
     .fd_in      equ     0   ; size_t: file descriptor.
     .bytes      equ     8   ; size_t: bytes read.
-    .buffer     equ     16  ; IO_READ_BUF_SIZE bytes.
-    .ret        equ     24  ; return value.
+    .ret        equ     16  ; return value.
+    .buffer     equ     24  ; IO_READ_BUF_SIZE bytes.
 
     ;--------------------
     ; Setup
@@ -220,6 +542,8 @@ cat:
     mov     qword [rsp+.ret], CMD_OK
 
 .out:
+    mov     rax, [rsp+.ret]
+
     add     rsp, IO_READ_BUF_SIZE
     epilogue_with_vars 3
 
@@ -228,3 +552,434 @@ cat:
 .error:
     mov     qword [rsp+.ret], CMD_FAILED
     jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Read a single file specified by it's file descriptor
+;   and display to stdout, using a separate thread for reading.
+;
+; C prototype equivalent:
+;
+;     int cat_pipelined(int fd);
+;
+; Parameters:
+;
+; - Input: RDI (int) - File descriptor to read from.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - A reader thread (cat_reader()) fills the slots of a CatRing while
+;   this function (the writer) drains them to stdout. With this
+;   arrangement, reading and writing overlap, so the throughput
+;   approaches the slower of the two rather than a combination of
+;   both.
+;
+; - Neither thread takes a lock. A thread only sleeps (in futex_wait())
+;   when the ring is full (reader) or empty (writer), and only
+;   calls futex_wake() if the other thread has said it is asleep.
+;
+; - The handshake is safe because both sides use a full barrier
+;   between their two memory operations: the sleeper sets its
+;   "waiting" flag with xchg and then re-reads the counter, and the
+;   waker updates the counter with a "lock" prefixed instruction and
+;   then reads the flag. So at least one of them must see the other's
+;   update.
+;
+; - The ring buffers are allocated from the arena and released again
+;   before returning, so each file reuses the same memory.
+;
+; - If the reader thread cannot be created, this function falls back
+;   to cat().
+;
+; See: futex(7).
+;---------------------------------------------------------------------
+
+cat_pipelined:
+    prologue_with_vars 4
+
+    ; Allocate space for the ring (but not the buffers).
+    alloc_space CatRing_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; size_t: file descriptor.
+    .thread     equ     8   ; pthread_t: reader thread.
+    .ret        equ     16  ; return value.
+    .mark       equ     24  ; arena mark for the ring buffers.
+    .ring       equ     32  ; CatRing_size bytes.
+
+    ;--------------------
+    ; Setup
+
+    ; Assume failure. Pessimistic but safe.
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    cmp     rdi, 0
+    jl      .out ; Invalid fd
+
+    mov     [rsp+.fd_in], rdi
+
+    ; Clear the ring.
+    lea     rdi, [rsp+.ring]
+    mov     rcx, CatRing_size
+    xor     eax, eax
+    cld
+    rep     stosb
+
+    lea     rbx, [rsp+.ring]
+
+    mov     rax, [rsp+.fd_in]
+    mov     [rbx+CatRing.fd], rax
+
+    dcall   arena_mark
+    mov     [rsp+.mark], rax
+
+    ; Allocate the ring buffers (page aligned for efficient I/O).
+    mov     rdi, (CAT_RING_SLOTS * IO_READ_BUF_SIZE)
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .fallback
+
+    lea     rbx, [rsp+.ring]
+    mov     [rbx+CatRing.buffers], rax
+
+    ; Start the reader thread.
+    lea     rdi, [rsp+.thread]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, cat_reader
+    lea     rcx, [rsp+.ring]
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .fallback_free_buffers
+
+    ;--------------------
+
+.next_slot:
+    lea     rbx, [rsp+.ring]
+
+    ; Is there a full slot to write?
+    mov     ecx, [rbx+CatRing.head]
+    cmp     ecx, [rbx+CatRing.tail]
+    jne     .slot_available
+
+    ; The ring looks empty, so announce that we are about to sleep
+    ; (xchg acts as a full memory barrier)...
+    mov     eax, 1
+    xchg    eax, [rbx+CatRing.writer_waiting]
+
+    ; ... and check again in case the reader published a slot in the
+    ; meantime.
+    mov     ecx, [rbx+CatRing.head]
+    cmp     ecx, [rbx+CatRing.tail]
+    jne     .stop_waiting
+
+    lea     rdi, [rbx+CatRing.head]
+    mov     esi, ecx
+    dcall   futex_wait
+
+.stop_waiting:
+    lea     rbx, [rsp+.ring]
+    mov     dword [rbx+CatRing.writer_waiting], 0
+    jmp     .next_slot
+
+.slot_available:
+    ; Calculate the index of the slot: tail & (CAT_RING_SLOTS-1).
+    mov     eax, [rbx+CatRing.tail]
+    and     eax, (CAT_RING_SLOTS - 1)
+
+    mov     rdx, [rbx+CatRing.bytes+rax*8]
+
+    cmp     rdx, 0
+    je      .reader_done  ; EOF.
+    jl      .reader_done  ; Read error (reported below).
+
+    ; Calculate the address of the slot's buffer.
+    imul    rsi, rax, IO_READ_BUF_SIZE
+    add     rsi, [rbx+CatRing.buffers]
+
+    mov     rdi, STDOUT_FD
+    dcall   write_block
+
+    cmp     rax, 1
+    jl      .write_failed
+
+    ; Hand the slot back to the reader. The lock prefix makes this a
+    ; full barrier (see Notes).
+    lea     rbx, [rsp+.ring]
+    lock inc dword [rbx+CatRing.tail]
+
+    cmp     dword [rbx+CatRing.reader_waiting], 0
+    je      .next_slot
+
+    lea     rdi, [rbx+CatRing.tail]
+    mov     esi, 1
+    dcall   futex_wake
+
+    jmp     .next_slot
+
+.write_failed:
+    ; Tell the reader to stop. Changing the tail value guarantees that
+    ; a reader about to sleep on it will not do so.
+    lea     rbx, [rsp+.ring]
+    mov     qword [rbx+CatRing.stop], 1
+    lock inc dword [rbx+CatRing.tail]
+
+    lea     rdi, [rbx+CatRing.tail]
+    mov     esi, 1
+    dcall   futex_wake
+
+    jmp     .join
+
+.reader_done:
+    ; The reader has finished, either because it reached EOF (success)
+    ; or because the read failed.
+    cmp     rdx, 0
+    jne     .join
+
+    mov     qword [rsp+.ret], CMD_OK
+
+.join:
+    mov     rdi, [rsp+.thread]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+.free_buffers:
+    mov     rdi, [rsp+.mark]
+    dcall   arena_release
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space CatRing_size
+    epilogue_with_vars 4
+    ret
+
+.fallback_free_buffers:
+    mov     rdi, [rsp+.mark]
+    dcall   arena_release
+
+.fallback:
+    ; Not enough resources to pipeline, so just do it the simple way.
+    mov     rdi, [rsp+.fd_in]
+    dcall   cat
+    mov     [rsp+.ret], rax
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Reader thread for cat_pipelined(): read blocks from the
+;   ring's file descriptor into the ring's free slots.
+;
+; C prototype equivalent:
+;
+;     void *cat_reader(CatRing *ring);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CatRing.
+; - Output: RAX (address) - always NULL.
+;
+; Notes:
+;
+; The last slot the reader publishes always has a byte count of either
+; 0 (EOF) or -1 (error), which tells the writer to stop.
+;---------------------------------------------------------------------
+
+cat_reader:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .ring       equ     0   ; "CatRing *"
+    .slot       equ     8   ; size_t: index of slot being filled.
+    .bytes      equ     16  ; ssize_t: bytes read into slot.
+
+    ;--------------------
+
+    mov     [rsp+.ring], rdi
+
+.next_slot:
+    mov     rbx, [rsp+.ring]
+
+    cmp     qword [rbx+CatRing.stop], 0
+    jne     .out
+
+    ; Is there a free slot to fill?
+    mov     ecx, [rbx+CatRing.tail]
+    mov     eax, [rbx+CatRing.head]
+    sub     eax, ecx
+    cmp     eax, CAT_RING_SLOTS
+    jb      .slot_available
+
+    ; The ring looks full, so announce that we are about to sleep
+    ; (xchg acts as a full memory barrier)...
+    mov     eax, 1
+    xchg    eax, [rbx+CatRing.reader_waiting]
+
+    ; ... and check again in case the writer freed a slot in the
+    ; meantime.
+    mov     ecx, [rbx+CatRing.tail]
+    mov     eax, [rbx+CatRing.head]
+    sub     eax, ecx
+    cmp     eax, CAT_RING_SLOTS
+    jb      .stop_waiting
+
+    lea     rdi, [rbx+CatRing.tail]
+    mov     esi, ecx
+    dcall   futex_wait
+
+.stop_waiting:
+    mov     rbx, [rsp+.ring]
+    mov     dword [rbx+CatRing.reader_waiting], 0
+    jmp     .next_slot
+
+.slot_available:
+    ; Calculate the index of the slot: head & (CAT_RING_SLOTS-1).
+    mov     eax, [rbx+CatRing.head]
+    and     eax, (CAT_RING_SLOTS - 1)
+    mov     [rsp+.slot], rax
+
+    ; Calculate the address of the slot's buffer.
+    imul    rsi, rax, IO_READ_BUF_SIZE
+    add     rsi, [rbx+CatRing.buffers]
+
+    mov     rdi, [rbx+CatRing.fd]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+
+    mov     [rsp+.bytes], rax
+
+    ; Record the byte count for the slot...
+    mov     rbx, [rsp+.ring]
+    mov     rcx, [rsp+.slot]
+    mov     [rbx+CatRing.bytes+rcx*8], rax
+
+    ; ... then publish the slot. The lock prefix makes this a full
+    ; barrier (see cat_pipelined()).
+    lock inc dword [rbx+CatRing.head]
+
+    cmp     dword [rbx+CatRing.writer_waiting], 0
+    je      .check_done
+
+    lea     rdi, [rbx+CatRing.head]
+    mov     esi, 1
+    dcall   futex_wake
+
+.check_done:
+    ; Stop after publishing EOF or an error.
+    cmp     qword [rsp+.bytes], 0
+    jg      .next_slot
+
+.out:
+    xor     rax, rax
+
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Display the specified files, reading up to the specified
+;   number of them at the same time.
+;
+; C prototype equivalent:
+;
+;     int cat_parallel(char **paths, size_t count, size_t threads);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of file paths ("-" for stdin).
+; - Input: RSI (integer) - number of paths.
+; - Input: RDX (integer) - maximum number of files to read at once.
+; - Output: RAX (integer) - 0 on success, -1 on error, or 1 if the
+;   reader threads could not be started (in which case nothing has
+;   been read).
+;
+; Notes:
+;
+; - The files are read by a pool of threads (see prefetch_start()),
+;   but written strictly in argument order, so the output is the same
+;   as for the sequential mode. This helps when each file takes a long
+;   time to start arriving (network file systems, slow devices).
+;
+; - As in the sequential mode, the first file that cannot be opened or
+;   read stops the command (after the earlier files have been written).
+;
+; See: prefetch.asm.
+;---------------------------------------------------------------------
+
+cat_parallel:
+    prologue_with_vars 2
+
+    alloc_space Prefetch_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .ret        equ     0   ; return value.
+    .data       equ     8   ; "char *": data to write.
+    .pf         equ    16   ; Prefetch_size bytes.
+
+    ;--------------------
+    ; Setup
+
+    ; Assume failure. Pessimistic but safe.
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    lea     rbx, [rsp+.pf]
+    mov     [rbx+Prefetch.paths], rdi
+    mov     [rbx+Prefetch.count], rsi
+    mov     [rbx+Prefetch.nthreads], rdx
+    mov     qword [rbx+Prefetch.limit], 0 ; Default.
+    mov     qword [rbx+Prefetch.max_bytes], 0 ; All of each file.
+
+    mov     rdi, rbx
+    dcall   prefetch_start
+    cmp     rax, 0
+    jne     .not_started
+
+    ;--------------------
+
+.next_block:
+    lea     rdi, [rsp+.pf]
+    lea     rsi, [rsp+.data]
+    dcall   prefetch_read
+    cmp     rax, 0
+    je      .next_file
+    jl      .end ; Open or read error.
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.data]
+    mov     rdx, rax
+    dcall   write_block
+
+    cmp     rax, 1
+    jl      .end
+
+    jmp     .next_block
+
+.next_file:
+    lea     rdi, [rsp+.pf]
+    dcall   prefetch_next
+
+    lea     rbx, [rsp+.pf]
+    mov     rax, [rbx+Prefetch.turn]
+    cmp     rax, [rbx+Prefetch.count]
+    jb      .next_block
+
+    mov     qword [rsp+.ret], CMD_OK
+
+.end:
+    lea     rdi, [rsp+.pf]
+    dcall   prefetch_end
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space Prefetch_size
+    epilogue_with_vars 2
+    ret
+
+.not_started:
+    mov     qword [rsp+.ret], 1
+    jmp     .out
@@ -0,0 +1,434 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_cksum
+global command_cksum
+
+extern asm_getopt
+extern crc32_posix_final
+extern crc32_posix_update
+extern crc32c_update
+extern read_block
+
+extern close
+extern dprintf
+extern open
+extern strcmp
+
+extern optarg
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_cksum:  db  "see cksum(1)",10, \
+                         10, \
+                         "Options:",10, \
+                         10, \
+                         "-a <algorithm> : Use the specified CRC algorithm:",10, \
+                         10, \
+                         "  crc    : POSIX CRC-32 (default).",10, \
+                         "  crc32c : CRC-32C (Castagnoli).",0
+
+; Algorithms.
+%assign CKSUM_CRC               0
+%assign CKSUM_CRC32C            1
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `cksum` command.
+;
+; C prototype equivalent:
+;
+;     int command_cksum(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, -1 on error.
+;
+; Notes:
+;
+; - The output format matches coreutils: "<crc> <size> [<file>]".
+;
+; - The "-a crc32c" option is an extension which calculates the
+;   CRC-32C used by iSCSI, ext4, btrfs, etc. rather than the POSIX
+;   CRC.
+;
+; - The CRCs are calculated using hardware instructions where available
+;   (see crc32.asm).
+;
+; Limitations:
+;
+; - Only the POSIX CRC and CRC-32C algorithms are supported.
+;
+; See: cksum(1).
+;---------------------------------------------------------------------
+
+command_cksum:
+section .rodata
+    .optstring          db  "a:",0
+    .algorithm_opt      equ 'a'
+
+    .crc_name           db  "crc",0
+    .crc32c_name        db  "crc32c",0
+
+    .bad_algorithm_fmt  db  "cksum: invalid algorithm: '%s'",10,0
+
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .algorithm      equ     16  ; int: CKSUM_* value.
+    .file_idx       equ     24  ; size_t: index into argv of next file.
+    .ret            equ     32  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.algorithm], CKSUM_CRC
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .algorithm_opt
+    je      .handle_algorithm_opt
+
+    jmp     .error_bad_option
+
+.handle_algorithm_opt:
+    mov     rdi, [optarg]
+    mov     rsi, .crc_name
+    dcall   strcmp
+    cmp     eax, 0
+    jne     .check_crc32c
+
+    mov     qword [rsp+.algorithm], CKSUM_CRC
+    jmp     .next_arg
+
+.check_crc32c:
+    mov     rdi, [optarg]
+    mov     rsi, .crc32c_name
+    dcall   strcmp
+    cmp     eax, 0
+    jne     .error_bad_algorithm
+
+    mov     qword [rsp+.algorithm], CKSUM_CRC32C
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.file_idx], rax
+
+    cmp     rax, [rsp+.argc]
+    jne     .next_file
+
+    ;--------------------
+    ; No files, so read stdin (and don't display a name).
+
+    mov     rdi, STDIN_FD
+    mov     rsi, 0
+    mov     rdx, [rsp+.algorithm]
+    dcall   cksum_fd
+    mov     [rsp+.ret], rax
+    jmp     .out
+
+.next_file:
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    je      .out
+
+    mov     rcx, [rsp+.argv]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+    mov     rsi, [rsp+.algorithm]
+    dcall   cksum_file
+    cmp     rax, 0
+    je      .file_done
+
+    ; Carry on with the remaining files, but remember the failure.
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.file_done:
+    inc     qword [rsp+.file_idx]
+    jmp     .next_file
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_bad_algorithm:
+    mov     rdi, STDERR_FD
+    mov     rsi, .bad_algorithm_fmt
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the checksum of the specified file.
+;
+; C prototype equivalent:
+;
+;     int cksum_file(const char *file, int algorithm);
+;
+; Parameters:
+;
+; - Input: RDI (string) - file path ("-" means stdin).
+; - Input: RSI (integer) - CKSUM_* value.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cksum_file:
+section .rodata
+    .open_fmt       db  "cksum: cannot open '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .file       equ     0   ; "char *"
+    .algorithm  equ     8   ; int: CKSUM_* value.
+    .fd         equ    16   ; int.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.file], rdi
+    mov     [rsp+.algorithm], rsi
+
+    ;--------------------
+
+    mov     qword [rsp+.fd], STDIN_FD
+
+    ; Handle the stdin alias.
+    cmp     byte [rdi], '-'
+    jne     .open_file
+
+    cmp     byte [rdi+1], 0
+    je      .opened
+
+.open_file:
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+.opened:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rsp+.file]
+    mov     rdx, [rsp+.algorithm]
+    dcall   cksum_fd
+    mov     [rsp+.ret], rax
+
+    cmp     qword [rsp+.fd], STDIN_FD
+    je      .out
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.file]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the checksum of all the data read from the
+;   specified file descriptor.
+;
+; C prototype equivalent:
+;
+;     int cksum_fd(int fd, const char *name, int algorithm);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - file descriptor.
+; - Input: RSI (string) - name to display (or NULL).
+; - Input: RDX (integer) - CKSUM_* value.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cksum_fd:
+section .rodata
+    .named_fmt      db  "%u %lu %s",10,0
+    .unnamed_fmt    db  "%u %lu",10,0
+    .read_fmt       db  "cksum: error reading '%s'",10,0
+    .stdin_name     db  "-",0
+section .text
+    prologue_with_vars 6
+
+    sub     rsp, IO_READ_BUF_SIZE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd         equ     0   ; int.
+    .name       equ     8   ; "char *"
+    .algorithm  equ    16   ; int: CKSUM_* value.
+    .crc        equ    24   ; uint32_t.
+    .total      equ    32   ; uint64_t: total bytes read.
+    .unused     equ    40   ; padding.
+    .buffer     equ    48   ; IO_READ_BUF_SIZE bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd], rdi
+    mov     [rsp+.name], rsi
+    mov     [rsp+.algorithm], rdx
+
+    ;--------------------
+
+    mov     qword [rsp+.total], 0
+    mov     qword [rsp+.crc], 0
+
+    cmp     qword [rsp+.algorithm], CKSUM_CRC32C
+    jne     .read_again
+
+    mov     dword [rsp+.crc], 0xffffffff
+
+.read_again:
+    mov     rdi, [rsp+.fd]
+    lea     rsi, [rsp+.buffer]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .eof
+    jl      .error_read
+
+    add     [rsp+.total], rax
+
+    mov     rdi, [rsp+.crc]
+    lea     rsi, [rsp+.buffer]
+    mov     rdx, rax
+
+    cmp     qword [rsp+.algorithm], CKSUM_CRC32C
+    je      .update_crc32c
+
+    dcall   crc32_posix_update
+    jmp     .updated
+
+.update_crc32c:
+    dcall   crc32c_update
+
+.updated:
+    mov     eax, eax ; Zero the upper 32-bits.
+    mov     [rsp+.crc], rax
+    jmp     .read_again
+
+.eof:
+    cmp     qword [rsp+.algorithm], CKSUM_CRC32C
+    je      .final_crc32c
+
+    mov     rdi, [rsp+.crc]
+    mov     rsi, [rsp+.total]
+    dcall   crc32_posix_final
+    jmp     .display
+
+.final_crc32c:
+    mov     eax, [rsp+.crc]
+    not     eax
+
+.display:
+    mov     edx, eax ; crc (unsigned 32-bit).
+    mov     rcx, [rsp+.total]
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, .unnamed_fmt
+
+    mov     r8, [rsp+.name]
+    cmp     r8, 0
+    je      .print
+
+    mov     rsi, .named_fmt
+
+.print:
+    xor     rax, rax
+    dcall   dprintf
+
+    cmp     eax, 0
+    jl      .error
+
+    mov     rax, 0
+
+.out:
+    add     rsp, IO_READ_BUF_SIZE
+    epilogue_with_vars 6
+    ret
+
+.error_read:
+    mov     rdx, [rsp+.name]
+    cmp     rdx, 0
+    jne     .show_read_error
+
+    mov     rdx, .stdin_name
+
+.show_read_error:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, -1
+    jmp     .out
@@ -12,11 +12,11 @@ global command_help_clear
 extern close
 extern write
 
-section .rodata
-command_help_clear: db  "see clear(1)",0
-
 %include "header.inc"
 
+cold_rodata
+command_help_clear: db  "see clear(1)",0
+
 section .text
 
 ;---------------------------------------------------------------------
@@ -0,0 +1,1046 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_cmp
+global command_cmp
+
+extern arena_alloc
+extern asm_getopt
+extern asm_memcount
+extern asm_memdiff
+extern libc_strtol
+extern read_block
+
+extern close
+extern dprintf
+extern fflush
+extern fstat
+extern madvise
+extern mmap
+extern munmap
+extern open
+extern optarg
+extern printf
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_cmp:  db  "see cmp(1)",10, \
+                       10, \
+                       "Usage: cmp [-l|-s] [-n LIMIT] FILE1 [FILE2 [SKIP1 [SKIP2]]]",10, \
+                       10, \
+                       "Options:",10, \
+                       10, \
+                       "-l       : Display the byte number and values of every differing byte.",10, \
+                       "-n LIMIT : Compare at most LIMIT bytes.",10, \
+                       "-s       : Do not display anything (just set the exit status).",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign CMP_LIST                (1 << 0)
+%assign CMP_SILENT              (1 << 1)
+
+; Size of the buffer used to read each file that cannot be mapped.
+CMP_READ_BUF_SIZE       equ     (IO_READ_BUF_SIZE * 4)
+
+;---------------------------------------------------------------------
+; A file being compared.
+;---------------------------------------------------------------------
+struc CmpInput
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .name       resq    1 ; "char *": file path ("-" means stdin).
+    .fd         resq    1 ; int (-1 if not open).
+    .skip       resq    1 ; size_t: bytes to skip at the start.
+    .regular    resq    1 ; bool: true for a regular file.
+    .size       resq    1 ; size_t: bytes after the skip (regular files).
+    .dev        resq    1 ; dev_t.
+    .ino        resq    1 ; ino_t.
+    .map        resq    1 ; "void *": mapped file (or 0).
+    .map_size   resq    1 ; size_t.
+    .buffer     resq    1 ; "char *": read buffer (or 0).
+    .data       resq    1 ; "char *": next byte to compare.
+    .avail      resq    1 ; size_t: bytes available at .data.
+    .eof        resq    1 ; bool: true if no more data can be read.
+endstruc
+
+;---------------------------------------------------------------------
+; State shared by the cmp functions.
+;---------------------------------------------------------------------
+struc CmpState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .flags      resq    1 ; CMP_* bitmask.
+    .limit      resq    1 ; size_t: maximum bytes to compare.
+    .offset     resq    1 ; size_t: bytes compared.
+    .lines      resq    1 ; size_t: newlines in the bytes compared.
+    .differ     resq    1 ; bool: true if a difference was listed.
+    .width      resq    1 ; int: width of byte numbers for '-l'.
+    .last       resq    1 ; char: last byte compared.
+    .input1     resb    CmpInput_size
+    .input2     resb    CmpInput_size
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `cmp` command.
+;
+; C prototype equivalent:
+;
+;     int command_cmp(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 if the files are identical, else -1.
+;
+; Notes:
+;
+; - Regular files are mapped into memory and compared in one go by
+;   asm_memdiff(), which compares 32 bytes at a time. Other files are
+;   read into a buffer.
+;
+; - Line numbers are only calculated (with asm_memcount()) for the
+;   bytes before the first difference.
+;
+; - With '-s', regular files whose sizes mean they cannot be identical
+;   are not read at all. Files that are the same file are not read
+;   either.
+;
+; Limitations:
+;
+; - SKIP and LIMIT values do not support suffixes.
+; - Errors result in an exit code of 1 (rather than 2).
+;
+; See: cmp(1).
+;---------------------------------------------------------------------
+
+command_cmp:
+section .rodata
+    .optstring          db  "ln:s",0
+    .list_opt           equ 'l'
+    .limit_opt          equ 'n'
+    .silent_opt         equ 's'
+
+    .stdin_name         db  "-",0
+cold_rodata
+    .limit_fmt          db  "cmp: invalid limit: '%s'",10,0
+    .skip_fmt           db  "cmp: invalid skip: '%s'",10,0
+    .options_msg        db  "cmp: options -l and -s are incompatible",10,0
+section .text
+    prologue_with_vars 6
+
+    alloc_space CmpState_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .arg            equ     16  ; size_t: index of next operand.
+    .unused         equ     24  ; padding.
+    .ret            equ     32  ; int: return value.
+    .value          equ     40  ; long: option value.
+    .state          equ     48  ; CmpState.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.state+CmpState.flags], 0
+    mov     qword [rsp+.state+CmpState.limit], -1
+    mov     qword [rsp+.state+CmpState.offset], 0
+    mov     qword [rsp+.state+CmpState.lines], 0
+    mov     qword [rsp+.state+CmpState.differ], 0
+    mov     qword [rsp+.state+CmpState.last], 0
+
+    lea     rdi, [rsp+.state+CmpState.input1]
+    dcall   cmp_init_input
+
+    lea     rdi, [rsp+.state+CmpState.input2]
+    dcall   cmp_init_input
+
+    mov     qword [rsp+.state+CmpState.input2+CmpInput.name], .stdin_name
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .list_opt
+    je      .handle_list_opt
+
+    cmp     al, .limit_opt
+    je      .handle_limit_opt
+
+    cmp     al, .silent_opt
+    je      .handle_silent_opt
+
+    jmp     .error_bad_option
+
+.handle_list_opt:
+    or      qword [rsp+.state+CmpState.flags], CMP_LIST
+    jmp     .next_arg
+
+.handle_silent_opt:
+    or      qword [rsp+.state+CmpState.flags], CMP_SILENT
+    jmp     .next_arg
+
+.handle_limit_opt:
+    mov     rdi, [optarg]
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.value]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .error_limit
+
+    mov     rax, [rsp+.value]
+    cmp     rax, 0
+    jl      .error_limit
+
+    mov     [rsp+.state+CmpState.limit], rax
+    jmp     .next_arg
+
+.options_parsed:
+    mov     rax, [rsp+.state+CmpState.flags]
+    and     rax, (CMP_LIST|CMP_SILENT)
+    cmp     rax, (CMP_LIST|CMP_SILENT)
+    je      .error_options
+
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.arg], rax
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+
+    ; FILE1 [FILE2 [SKIP1 [SKIP2]]]
+    cmp     rcx, 0
+    je      .error_no_arg
+
+    cmp     rcx, 4
+    ja      .error_bad_arg
+
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE]
+    mov     [rsp+.state+CmpState.input1+CmpInput.name], rdi
+
+    cmp     rcx, 1
+    je      .open
+
+    mov     rdi, [rdx+rax*PTR_SIZE+PTR_SIZE]
+    mov     [rsp+.state+CmpState.input2+CmpInput.name], rdi
+
+    add     qword [rsp+.arg], 2
+
+    lea     rbx, [rsp+.state+CmpState.input1]
+
+.next_skip:
+    mov     rax, [rsp+.arg]
+    cmp     rax, [rsp+.argc]
+    jae     .open
+
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE]
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.value]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .error_skip
+
+    mov     rax, [rsp+.value]
+    cmp     rax, 0
+    jl      .error_skip
+
+    mov     [rbx+CmpInput.skip], rax
+
+    inc     qword [rsp+.arg]
+    add     rbx, CmpInput_size
+    jmp     .next_skip
+
+.open:
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    lea     rdi, [rsp+.state+CmpState.input1]
+    dcall   cmp_open
+    cmp     rax, 0
+    jne     .close
+
+    lea     rdi, [rsp+.state+CmpState.input2]
+    dcall   cmp_open
+    cmp     rax, 0
+    jne     .close
+
+    lea     rdi, [rsp+.state]
+    dcall   cmp_compare
+    cmp     rax, 0
+    jne     .close
+
+    mov     qword [rsp+.ret], CMD_OK
+
+.close:
+    lea     rdi, [rsp+.state+CmpState.input1]
+    dcall   cmp_close
+
+    lea     rdi, [rsp+.state+CmpState.input2]
+    dcall   cmp_close
+
+    mov     rax, [rsp+.ret]
+
+.out:
+    free_space CmpState_size
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     rax, CMD_BAD_OPT
+    jmp     .out
+
+.error_no_arg:
+    mov     rax, CMD_NO_ARG
+    jmp     .out
+
+.error_bad_arg:
+    mov     rax, CMD_BAD_ARG
+    jmp     .out
+
+.error_options:
+    mov     rdi, STDERR_FD
+    mov     rsi, .options_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+.error_limit:
+    mov     rsi, .limit_fmt
+    mov     rdx, [optarg]
+    jmp     .error_value
+
+.error_skip:
+    mov     rsi, .skip_fmt
+    mov     rax, [rsp+.arg]
+    mov     rdx, [rsp+.argv]
+    mov     rdx, [rdx+rax*PTR_SIZE]
+
+.error_value:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Initialise a CmpInput.
+;
+; C prototype equivalent:
+;
+;     void cmp_init_input(CmpInput *input);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpInput.
+; - Output: None.
+;---------------------------------------------------------------------
+
+cmp_init_input:
+    prologue_with_vars 0
+
+    mov     rcx, CmpInput_size / 8
+    xor     eax, eax
+    rep     stosq
+
+    mov     qword [rdi-CmpInput_size+CmpInput.fd], -1
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Open a file to compare, and skip the requested number
+;   of bytes.
+;
+; C prototype equivalent:
+;
+;     int cmp_open(CmpInput *input);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpInput (with the name and skip set).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; Non-empty regular files are mapped into memory so that all of the
+; data is available at once. Everything else (or if the mapping
+; fails) is read into a buffer by cmp_fill().
+;---------------------------------------------------------------------
+
+cmp_open:
+cold_rodata
+    .open_fmt       db  "cmp: %s: cannot open file",10,0
+section .text
+    prologue_with_vars 1
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .stat       equ     8   ; Stat_size bytes.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    ;--------------------
+    ; Handle the stdin alias.
+
+    mov     rdi, [rbx+CmpInput.name]
+
+    mov     qword [rbx+CmpInput.fd], STDIN_FD
+
+    cmp     byte [rdi], '-'
+    jne     .open_file
+
+    cmp     byte [rdi+1], 0
+    je      .opened
+
+.open_file:
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    mov     [rbx+CmpInput.fd], rax
+    cmp     rax, -1
+    je      .error_open
+
+.opened:
+    mov     rdi, [rbx+CmpInput.fd]
+    lea     rsi, [rsp+.stat]
+    dcall   fstat
+    cmp     eax, 0
+    jne     .stream
+
+    mov     rax, [rsp+.stat+Stat.st_dev]
+    mov     [rbx+CmpInput.dev], rax
+    mov     rax, [rsp+.stat+Stat.st_ino]
+    mov     [rbx+CmpInput.ino], rax
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFREG
+    jne     .stream
+
+    ; Some regular files (such as those in /proc) claim to be empty,
+    ; so only trust the size of non-empty files.
+    cmp     qword [rsp+.stat+Stat.st_size], 0
+    jle     .stream
+
+    mov     qword [rbx+CmpInput.regular], 1
+
+    ; Bytes after the skip.
+    mov     rax, [rsp+.stat+Stat.st_size]
+    xor     ecx, ecx
+    sub     rax, [rbx+CmpInput.skip]
+    cmovb   rax, rcx
+    mov     [rbx+CmpInput.size], rax
+
+    cmp     rax, 0
+    je      .skipped_all
+
+    mov     rdi, 0 ; Let the kernel choose the address.
+    mov     rsi, [rsp+.stat+Stat.st_size]
+    mov     rdx, PROT_READ
+    mov     rcx, MAP_PRIVATE
+    mov     r8, [rbx+CmpInput.fd]
+    mov     r9, 0 ; offset.
+    dcall   mmap
+    cmp     rax, MAP_FAILED
+    je      .stream
+
+    mov     [rbx+CmpInput.map], rax
+    mov     rcx, [rsp+.stat+Stat.st_size]
+    mov     [rbx+CmpInput.map_size], rcx
+
+    add     rax, [rbx+CmpInput.skip]
+    mov     [rbx+CmpInput.data], rax
+    mov     rax, [rbx+CmpInput.size]
+    mov     [rbx+CmpInput.avail], rax
+
+    ; The file is read from start to end (once), so the kernel can
+    ; read ahead aggressively.
+    mov     rdi, [rbx+CmpInput.map]
+    mov     rsi, [rbx+CmpInput.map_size]
+    mov     rdx, MADV_SEQUENTIAL
+    dcall   madvise
+
+.skipped_all:
+    mov     qword [rbx+CmpInput.eof], 1
+    jmp     .success
+
+.stream:
+    mov     rdi, CMP_READ_BUF_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rbx+CmpInput.buffer], rax
+
+.next_skip:
+    ; Read (and discard) the bytes to skip.
+    mov     rdx, [rbx+CmpInput.skip]
+    cmp     rdx, 0
+    je      .success
+
+    mov     rax, CMP_READ_BUF_SIZE
+    cmp     rdx, rax
+    cmova   rdx, rax
+
+    mov     rdi, [rbx+CmpInput.fd]
+    mov     rsi, [rbx+CmpInput.buffer]
+    dcall   read_block
+    cmp     rax, 0
+    jl      .error_read
+    je      .skipped_all
+
+    sub     [rbx+CmpInput.skip], rax
+    jmp     .next_skip
+
+.success:
+    xor     eax, eax
+
+.out:
+    free_space Stat_size
+    epilogue_with_vars 1
+    ret
+
+.error_read:
+    mov     rdi, rbx
+    dcall   cmp_error_read
+    jmp     .error
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rbx+CmpInput.name]
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Release the resources used by a CmpInput.
+;
+; C prototype equivalent:
+;
+;     void cmp_close(CmpInput *input);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpInput.
+; - Output: None.
+;---------------------------------------------------------------------
+
+cmp_close:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    cmp     qword [rbx+CmpInput.map], 0
+    je      .unmapped
+
+    mov     rdi, [rbx+CmpInput.map]
+    mov     rsi, [rbx+CmpInput.map_size]
+    dcall   munmap
+
+.unmapped:
+    mov     rdi, [rbx+CmpInput.fd]
+    cmp     rdi, STDIN_FD
+    jle     .out
+
+    dcall   close
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Display a read error.
+;
+; C prototype equivalent:
+;
+;     void cmp_error_read(CmpInput *input);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpInput.
+; - Output: None.
+;---------------------------------------------------------------------
+
+cmp_error_read:
+cold_rodata
+    .read_fmt       db  "cmp: %s: read error",10,0
+section .text
+    prologue_with_vars 0
+
+    mov     rdx, [rdi+CmpInput.name]
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Make more data available for an input if all of the
+;   available data has been compared.
+;
+; C prototype equivalent:
+;
+;     int cmp_fill(CmpInput *input);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpInput.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; At the end of the file, .avail is 0 and .eof is set.
+;---------------------------------------------------------------------
+
+cmp_fill:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    xor     eax, eax
+
+    cmp     qword [rbx+CmpInput.avail], 0
+    jne     .out
+
+    cmp     qword [rbx+CmpInput.eof], 0
+    jne     .out
+
+    mov     rdi, [rbx+CmpInput.fd]
+    mov     rsi, [rbx+CmpInput.buffer]
+    mov     rdx, CMP_READ_BUF_SIZE
+    dcall   read_block
+    cmp     rax, 0
+    jl      .error_read
+    jg      .got_data
+
+    mov     qword [rbx+CmpInput.eof], 1
+
+.got_data:
+    mov     rcx, [rbx+CmpInput.buffer]
+    mov     [rbx+CmpInput.data], rcx
+    mov     [rbx+CmpInput.avail], rax
+
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+.error_read:
+    mov     rdi, rbx
+    dcall   cmp_error_read
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Compare the two inputs.
+;
+; C prototype equivalent:
+;
+;     int cmp_compare(CmpState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpState.
+; - Output: RAX (integer) - 0 if the inputs are identical, 1 if they
+;   differ, or -1 on error.
+;---------------------------------------------------------------------
+
+cmp_compare:
+section .rodata
+    .differ_fmt     db  "%s %s differ: char %lu, line %lu",10,0
+cold_rodata
+    .empty_fmt      db  "cmp: EOF on %s which is empty",10,0
+    .eof_fmt        db  "cmp: EOF on %s after byte %lu, in line %lu",10,0
+    .eof_line_fmt   db  "cmp: EOF on %s after byte %lu, line %lu",10,0
+    .list_eof_fmt   db  "cmp: EOF on %s after byte %lu",10,0
+section .text
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .n          equ     0   ; size_t: bytes to compare.
+    .i          equ     8   ; size_t: offset of first difference.
+    .eof_name   equ     16  ; "char *": name of shorter input.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    ;--------------------
+    ; Check for trivial results.
+
+    mov     rax, [rbx+CmpState.input1+CmpInput.regular]
+    and     rax, [rbx+CmpState.input2+CmpInput.regular]
+    jz      .set_width
+
+    ; The same file (and position) is identical.
+    mov     rax, [rbx+CmpState.input1+CmpInput.dev]
+    cmp     rax, [rbx+CmpState.input2+CmpInput.dev]
+    jne     .check_sizes
+
+    mov     rax, [rbx+CmpState.input1+CmpInput.ino]
+    cmp     rax, [rbx+CmpState.input2+CmpInput.ino]
+    jne     .check_sizes
+
+    mov     rax, [rbx+CmpState.input1+CmpInput.skip]
+    cmp     rax, [rbx+CmpState.input2+CmpInput.skip]
+    je      .identical
+
+.check_sizes:
+    ; If the (limited) sizes differ, so do the files. Only the output
+    ; requires the data to be read.
+    test    qword [rbx+CmpState.flags], CMP_SILENT
+    jz      .set_width
+
+    mov     rcx, [rbx+CmpState.limit]
+
+    mov     rax, [rbx+CmpState.input1+CmpInput.size]
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+    mov     rdx, [rbx+CmpState.input2+CmpInput.size]
+    cmp     rdx, rcx
+    cmova   rdx, rcx
+
+    cmp     rax, rdx
+    jne     .differ
+
+.set_width:
+    ;--------------------
+    ; The width of the byte numbers for '-l' is that of the largest
+    ; possible byte number.
+
+    mov     rax, [rbx+CmpState.limit]
+    mov     rcx, -1
+    shr     rcx, 1
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+    cmp     qword [rbx+CmpState.input1+CmpInput.regular], 0
+    je      .input2_width
+
+    mov     rcx, [rbx+CmpState.input1+CmpInput.size]
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+.input2_width:
+    cmp     qword [rbx+CmpState.input2+CmpInput.regular], 0
+    je      .count_digits
+
+    mov     rcx, [rbx+CmpState.input2+CmpInput.size]
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+.count_digits:
+    mov     qword [rbx+CmpState.width], 1
+    mov     rcx, 10
+
+.next_digit:
+    xor     edx, edx
+    div     rcx
+    cmp     rax, 0
+    je      .next_block
+
+    inc     qword [rbx+CmpState.width]
+    jmp     .next_digit
+
+    ;--------------------
+
+.next_block:
+    lea     rdi, [rbx+CmpState.input1]
+    dcall   cmp_fill
+    cmp     rax, 0
+    jne     .out
+
+    lea     rdi, [rbx+CmpState.input2]
+    dcall   cmp_fill
+    cmp     rax, 0
+    jne     .out
+
+    ; n = min(avail1, avail2, limit - offset)
+    mov     rax, [rbx+CmpState.input1+CmpInput.avail]
+    mov     rcx, [rbx+CmpState.input2+CmpInput.avail]
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+    mov     rcx, [rbx+CmpState.limit]
+    sub     rcx, [rbx+CmpState.offset]
+    cmp     rax, rcx
+    cmova   rax, rcx
+
+    mov     [rsp+.n], rax
+    cmp     rax, 0
+    je      .compared
+
+    test    qword [rbx+CmpState.flags], CMP_LIST
+    jz      .find_difference
+
+    mov     rdi, rbx
+    mov     rsi, rax
+    dcall   cmp_list
+    jmp     .advance
+
+.find_difference:
+    mov     rdi, [rbx+CmpState.input1+CmpInput.data]
+    mov     rsi, [rbx+CmpState.input2+CmpInput.data]
+    mov     rdx, [rsp+.n]
+    dcall   asm_memdiff
+    mov     [rsp+.i], rax
+
+    test    qword [rbx+CmpState.flags], CMP_SILENT
+    jnz     .check_difference
+
+    ; Count the lines up to the difference.
+    mov     rdi, [rbx+CmpState.input1+CmpInput.data]
+    mov     rsi, NL
+    mov     rdx, rax
+    dcall   asm_memcount
+    add     [rbx+CmpState.lines], rax
+
+.check_difference:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.n]
+    jne     .found_difference
+
+.advance:
+    mov     rax, [rsp+.n]
+    mov     rcx, [rbx+CmpState.input1+CmpInput.data]
+    movzx   ecx, byte [rcx+rax-1]
+    mov     [rbx+CmpState.last], rcx
+
+    add     [rbx+CmpState.offset], rax
+    add     [rbx+CmpState.input1+CmpInput.data], rax
+    sub     [rbx+CmpState.input1+CmpInput.avail], rax
+    add     [rbx+CmpState.input2+CmpInput.data], rax
+    sub     [rbx+CmpState.input2+CmpInput.avail], rax
+    jmp     .next_block
+
+.found_difference:
+    test    qword [rbx+CmpState.flags], CMP_SILENT
+    jnz     .differ
+
+    mov     rdi, .differ_fmt
+    mov     rsi, [rbx+CmpState.input1+CmpInput.name]
+    mov     rdx, [rbx+CmpState.input2+CmpInput.name]
+    mov     rcx, [rbx+CmpState.offset]
+    add     rcx, [rsp+.i]
+    inc     rcx
+    mov     r8, [rbx+CmpState.lines]
+    inc     r8
+    xor     rax, rax
+    dcall   printf
+
+    jmp     .differ
+
+.compared:
+    ;--------------------
+    ; Check if all the bytes were compared.
+
+    mov     rax, [rbx+CmpState.offset]
+    cmp     rax, [rbx+CmpState.limit]
+    je      .result
+
+    mov     rax, [rbx+CmpState.input1+CmpInput.avail]
+    or      rax, [rbx+CmpState.input2+CmpInput.avail]
+    jz      .result
+
+    ; One input is shorter than the other.
+    test    qword [rbx+CmpState.flags], CMP_SILENT
+    jnz     .differ
+
+    mov     rax, [rbx+CmpState.input1+CmpInput.name]
+    cmp     qword [rbx+CmpState.input1+CmpInput.avail], 0
+    je      .got_eof_name
+
+    mov     rax, [rbx+CmpState.input2+CmpInput.name]
+
+.got_eof_name:
+    mov     [rsp+.eof_name], rax
+
+    ; Don't mix the message with any listed differences.
+    mov     rdi, 0
+    dcall   fflush
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .empty_fmt
+    mov     rdx, [rsp+.eof_name]
+    mov     rcx, [rbx+CmpState.offset]
+    mov     r8, [rbx+CmpState.lines]
+    inc     r8
+
+    cmp     rcx, 0
+    je      .show_eof
+
+    mov     rsi, .list_eof_fmt
+
+    test    qword [rbx+CmpState.flags], CMP_LIST
+    jnz     .show_eof
+
+    mov     rsi, .eof_fmt
+
+    ; Like cmp(1), show the number of complete lines, or the line the
+    ; input ends in.
+    cmp     qword [rbx+CmpState.last], NL
+    jne     .show_eof
+
+    mov     rsi, .eof_line_fmt
+    dec     r8
+
+.show_eof:
+    xor     rax, rax
+    dcall   dprintf
+
+.differ:
+    mov     rax, 1
+    jmp     .out
+
+.result:
+    mov     rax, [rbx+CmpState.differ]
+    jmp     .out
+
+.identical:
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Display every differing byte in the next block.
+;
+; C prototype equivalent:
+;
+;     void cmp_list(CmpState *state, size_t n);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CmpState.
+; - Input: RSI (integer) - number of bytes to compare.
+; - Output: None.
+;
+; Notes:
+;
+; Displays the (1-based) byte number and the differing byte values in
+; octal, like cmp(1).
+;---------------------------------------------------------------------
+
+cmp_list:
+section .rodata
+    .list_fmt       db  "%*lu %3o %3o",10,0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .n          equ     0   ; size_t: bytes to compare.
+    .i          equ     8   ; size_t: offset of next byte to compare.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     [rsp+.n], rsi
+    mov     qword [rsp+.i], 0
+
+.next_difference:
+    mov     rcx, [rsp+.i]
+
+    mov     rdi, [rbx+CmpState.input1+CmpInput.data]
+    add     rdi, rcx
+    mov     rsi, [rbx+CmpState.input2+CmpInput.data]
+    add     rsi, rcx
+    mov     rdx, [rsp+.n]
+    sub     rdx, rcx
+    dcall   asm_memdiff
+
+    add     rax, [rsp+.i]
+    cmp     rax, [rsp+.n]
+    je      .out
+
+    mov     [rsp+.i], rax
+    mov     qword [rbx+CmpState.differ], 1
+
+    mov     rdi, .list_fmt
+    mov     esi, [rbx+CmpState.width]
+    mov     rdx, [rbx+CmpState.offset]
+    lea     rdx, [rdx+rax+1]
+    mov     rcx, [rbx+CmpState.input1+CmpInput.data]
+    movzx   ecx, byte [rcx+rax]
+    mov     r8, [rbx+CmpState.input2+CmpInput.data]
+    movzx   r8d, byte [r8+rax]
+    xor     rax, rax
+    dcall   printf
+
+    inc     qword [rsp+.i]
+    jmp     .next_difference
+
+.out:
+    epilogue_with_vars 2
+    ret
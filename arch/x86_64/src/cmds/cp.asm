@@ -0,0 +1,1864 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_cp
+global command_cp
+
+extern asm_basename
+extern asm_getopt
+extern get_errno
+extern read_block
+extern write_block
+
+extern close
+extern closedir
+extern copy_file_range
+extern dprintf
+extern fallocate
+extern fchmod
+extern fchown
+extern ftruncate
+extern futimens
+extern get_nprocs
+extern ioctl
+extern lseek
+extern lstat
+extern mkdir
+extern open
+extern opendir
+extern pread
+extern pthread_create
+extern pthread_join
+extern pwrite
+extern readdir
+extern readlink
+extern snprintf
+extern stat
+extern symlink
+extern unlink
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_cp:  db  "see cp(1)",10, \
+                      10, \
+                      "Options:",10, \
+                      10, \
+                      "-f : Remove an existing destination file that cannot be opened.",10, \
+                      "-p : Preserve mode, ownership and timestamps.",10, \
+                      "-r : Copy directories recursively.",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask) passed to the cp_* functions.
+
+%assign CP_FORCE        (1 << 0)
+%assign CP_PRESERVE     (1 << 1)
+%assign CP_RECURSIVE    (1 << 2)
+
+;---------------------------------------------------------------------
+; Files at least this big are copied by multiple threads.
+%assign CP_PARALLEL_MIN_SIZE    (64 * 1024 * 1024)
+
+; Smallest amount of data worth giving a thread.
+%assign CP_MIN_CHUNK_SIZE       (16 * 1024 * 1024)
+
+; Chunk boundaries are rounded to a multiple of this value, which
+; keeps each chunk aligned to filesystem blocks.
+%assign CP_CHUNK_ALIGN          (1024 * 1024)
+
+; Maximum number of copy threads.
+%assign CP_MAX_THREADS          8
+
+;---------------------------------------------------------------------
+; A range of a file copied by a single thread (see cp_parallel()).
+;---------------------------------------------------------------------
+struc CpChunk
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .src_fd     resq    1 ; int: file descriptor to copy from.
+    .dst_fd     resq    1 ; int: file descriptor to copy to.
+    .offset     resq    1 ; off_t: start of the range.
+    .length     resq    1 ; size_t: number of bytes in the range.
+    .thread     resq    1 ; pthread_t.
+    .started    resq    1 ; bool: true if .thread needs to be joined.
+    .ret        resq    1 ; int: 0 on success, or -1 on error.
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `cp` command.
+;
+; C prototype equivalent:
+;
+;     int command_cp(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, -1 on error.
+;
+; Notes:
+;
+; - For each regular file, the fastest method available is used:
+;
+;   1. A reflink (FICLONE), which shares the data blocks and so copies
+;      nothing at all (for example on btrfs and XFS).
+;   2. copy_file_range(2), which copies inside the kernel (and which
+;      some filesystems can offload to the storage).
+;   3. pread(2) + pwrite(2), if the kernel cannot copy between the
+;      two files.
+;
+; - Large files are copied by multiple threads, each handling a
+;   separate range of the file (see cp_parallel()).
+;
+; - Holes in sparse files are preserved (see cp_range()).
+;
+; - Files that are not regular files (or which claim to be empty,
+;   such as those in /proc) are copied using read_block() and
+;   write_block().
+;
+; Limitations:
+;
+; - Only supports the -f, -p and -r options.
+;
+; See: cp(1).
+;---------------------------------------------------------------------
+
+command_cp:
+section .rodata
+    .optstring          db  "fpr",0
+    .force_opt          equ 'f'
+    .preserve_opt       equ 'p'
+    .recursive_opt      equ 'r'
+
+    .errArgCount        db  "ERROR: Usage: cp [-fpr] <source>... <dest>",10,0
+    .errArgCountLen     equ $-.errArgCount-1
+
+    .not_dir_fmt        db  "cp: target '%s' is not a directory",10,0
+    .too_long_fmt       db  "cp: name too long: '%s'",10,0
+    .str_fmt            db  "%s",0
+    .path_fmt           db  "%s/%s",0
+
+section .text
+    prologue_with_vars 10
+
+    alloc_space (Stat_size + (PATH_MAX * 2))
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .flags          equ     16  ; size_t: CP_* bitmask.
+    .file_idx       equ     24  ; size_t: index into argv of next source.
+    .last_idx       equ     32  ; size_t: index into argv of destination.
+    .dest           equ     40  ; "char *": destination.
+    .dest_is_dir    equ     48  ; bool.
+    .src            equ     56  ; "char *": current source.
+    .ret            equ     64  ; int: return value.
+    .unused         equ     72  ; padding.
+
+    .stat           equ     80                      ; Stat_size bytes.
+    .base_path      equ     (.stat + Stat_size)     ; char[PATH_MAX]
+    .target         equ     (.base_path + PATH_MAX) ; char[PATH_MAX]
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.flags], 0
+    mov     qword [rsp+.dest_is_dir], 0
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    ;------------------------------
+
+    cmp     al, .force_opt
+    je      .handle_force_opt
+
+    cmp     al, .preserve_opt
+    je      .handle_preserve_opt
+
+    cmp     al, .recursive_opt
+    je      .handle_recursive_opt
+
+    jmp     .error_bad_option
+
+.handle_force_opt:
+    or      qword [rsp+.flags], CP_FORCE
+    jmp     .next_arg
+
+.handle_preserve_opt:
+    or      qword [rsp+.flags], CP_PRESERVE
+    jmp     .next_arg
+
+.handle_recursive_opt:
+    or      qword [rsp+.flags], CP_RECURSIVE
+    jmp     .next_arg
+
+.options_parsed:
+
+    ; The remaining args (from index optind to .argc) are the
+    ; source(s) followed by the destination.
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.file_idx], rax
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+
+    cmp     rcx, 2
+    jl      .error_arg_count
+
+    ; The destination is the last argument.
+    mov     rax, [rsp+.argc]
+    dec     rax
+    mov     [rsp+.last_idx], rax
+
+    mov     rcx, [rsp+.argv]
+    mov     rax, [rcx+rax*PTR_SIZE]
+    mov     [rsp+.dest], rax
+
+    ;--------------------
+    ; Check if the destination is an existing directory.
+
+    mov     rdi, [rsp+.dest]
+    lea     rsi, [rsp+.stat]
+    dcall   stat
+    cmp     eax, 0
+    jne     .dest_checked
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFDIR
+    jne     .dest_checked
+
+    mov     qword [rsp+.dest_is_dir], 1
+
+.dest_checked:
+    ; Multiple sources can only be copied into a directory.
+    mov     rax, [rsp+.last_idx]
+    sub     rax, [rsp+.file_idx]
+    cmp     rax, 1
+    je      .next_source
+
+    cmp     qword [rsp+.dest_is_dir], 1
+    jne     .error_not_dir
+
+.next_source:
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.last_idx]
+    je      .out ; No more sources.
+
+    mov     rcx, [rsp+.argv]
+    mov     rax, [rcx+rax*PTR_SIZE]
+    mov     [rsp+.src], rax
+
+    cmp     qword [rsp+.dest_is_dir], 1
+    jne     .copy_to_dest
+
+    ;--------------------
+    ; Copy into the directory: target = "$dest/$(basename $src)".
+
+    ; asm_basename() modifies its argument, so give it a copy.
+    lea     rdi, [rsp+.base_path]
+    mov     rsi, PATH_MAX
+    mov     rdx, .str_fmt
+    mov     rcx, [rsp+.src]
+    xor     rax, rax ; No fp args
+    dcall   snprintf
+
+    cmp     rax, PATH_MAX
+    jge     .error_too_long
+
+    lea     rdi, [rsp+.base_path]
+    dcall   asm_basename
+
+    lea     rdi, [rsp+.target]
+    mov     rsi, PATH_MAX
+    mov     rdx, .path_fmt
+    mov     rcx, [rsp+.dest]
+    mov     r8, rax
+    xor     rax, rax ; No fp args
+    dcall   snprintf
+
+    cmp     rax, PATH_MAX
+    jge     .error_too_long
+
+    mov     rdi, [rsp+.src]
+    lea     rsi, [rsp+.target]
+    jmp     .copy
+
+.copy_to_dest:
+    mov     rdi, [rsp+.src]
+    mov     rsi, [rsp+.dest]
+
+.copy:
+    mov     rdx, [rsp+.flags]
+    dcall   cp_path
+    cmp     rax, 0
+    je      .source_done
+
+    ; Like cp(1), carry on with the remaining sources, but
+    ; remember the failure.
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.source_done:
+    inc     qword [rsp+.file_idx]
+    jmp     .next_source
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (Stat_size + (PATH_MAX * 2))
+    epilogue_with_vars 10
+
+    ret
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_arg_count:
+    mov     rdi, STDERR_FD
+    mov     rsi, .errArgCount
+    mov     rdx, .errArgCountLen
+    dcall   write_block
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_not_dir:
+    mov     rdi, STDERR_FD
+    mov     rsi, .not_dir_fmt
+    mov     rdx, [rsp+.dest]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_too_long:
+    mov     rdi, STDERR_FD
+    mov     rsi, .too_long_fmt
+    mov     rdx, [rsp+.src]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .source_done
+
+;---------------------------------------------------------------------
+; Description: Copy a path of any type.
+;
+; C prototype equivalent:
+;
+;     int cp_path(const char *src, const char *dst, int flags);
+;
+; Parameters:
+;
+; - Input: RDI (string) - source path.
+; - Input: RSI (string) - destination path.
+; - Input: RDX (integer) - CP_* flags.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; Like cp(1), recursive copies do not follow symbolic links: they
+; copy the links themselves.
+;---------------------------------------------------------------------
+
+cp_path:
+section .rodata
+    .stat_fmt       db  "cp: cannot stat '%s'",10,0
+    .omit_dir_fmt   db  "cp: -r not specified; omitting directory '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .src        equ     0   ; "char *"
+    .dst        equ     8   ; "char *"
+    .flags      equ    16   ; size_t: CP_* bitmask.
+    .unused     equ    24   ; padding.
+    .stat       equ    32   ; Stat_size bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.src], rdi
+    mov     [rsp+.dst], rsi
+    mov     [rsp+.flags], rdx
+
+    ;--------------------
+
+    lea     rsi, [rsp+.stat]
+
+    test    qword [rsp+.flags], CP_RECURSIVE
+    jz      .follow_links
+
+    dcall   lstat
+    jmp     .check_stat
+
+.follow_links:
+    dcall   stat
+
+.check_stat:
+    cmp     eax, 0
+    jne     .error_stat
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+
+    cmp     eax, S_IFDIR
+    je      .handle_dir
+
+    cmp     eax, S_IFLNK
+    je      .handle_symlink
+
+    mov     rdi, [rsp+.src]
+    mov     rsi, [rsp+.dst]
+    lea     rdx, [rsp+.stat]
+    mov     rcx, [rsp+.flags]
+    dcall   cp_file
+    jmp     .out
+
+.handle_dir:
+    test    qword [rsp+.flags], CP_RECURSIVE
+    jz      .error_omit_dir
+
+    mov     rdi, [rsp+.src]
+    mov     rsi, [rsp+.dst]
+    lea     rdx, [rsp+.stat]
+    mov     rcx, [rsp+.flags]
+    dcall   cp_dir
+    jmp     .out
+
+.handle_symlink:
+    mov     rdi, [rsp+.src]
+    mov     rsi, [rsp+.dst]
+    mov     rdx, [rsp+.flags]
+    dcall   cp_symlink
+
+.out:
+    free_space Stat_size
+    epilogue_with_vars 4
+    ret
+
+.error_stat:
+    mov     rsi, .stat_fmt
+    jmp     .show_error
+
+.error_omit_dir:
+    mov     rsi, .omit_dir_fmt
+
+.show_error:
+    mov     rdi, STDERR_FD
+    mov     rdx, [rsp+.src]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Recursively copy a directory.
+;
+; C prototype equivalent:
+;
+;     int cp_dir(const char *src, const char *dst,
+;                const struct stat *st, int flags);
+;
+; Parameters:
+;
+; - Input: RDI (string) - source directory path.
+; - Input: RSI (string) - destination directory path.
+; - Input: RDX (address) - Stat for the source.
+; - Input: RCX (integer) - CP_* flags.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The destination directory is created with owner write permission
+;   so that it can be filled even if the source directory is
+;   read-only. With -p, the original mode is applied once the
+;   directory is complete (which also ensures the preserved
+;   modification time isn't changed by creating the entries).
+;
+; - Failing to copy an entry does not stop the copy (as for cp(1)).
+;---------------------------------------------------------------------
+
+cp_dir:
+section .rodata
+    .mkdir_fmt      db  "cp: cannot create directory '%s'",10,0
+    .opendir_fmt    db  "cp: cannot open directory '%s'",10,0
+    .path_fmt       db  "%s/%s",0
+section .text
+    prologue_with_vars 6
+
+    alloc_space (PATH_MAX * 2)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .src        equ     0   ; "char *"
+    .dst        equ     8   ; "char *"
+    .st         equ    16   ; "struct stat *"
+    .flags      equ    24   ; size_t: CP_* bitmask.
+    .dir        equ    32   ; "DIR *"
+    .ret        equ    40   ; int: return value.
+
+    .src_path   equ    48                       ; char[PATH_MAX]
+    .dst_path   equ    (.src_path + PATH_MAX)   ; char[PATH_MAX]
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.src], rdi
+    mov     [rsp+.dst], rsi
+    mov     [rsp+.st], rdx
+    mov     [rsp+.flags], rcx
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Create the destination directory.
+
+    mov     rax, [rsp+.st]
+    mov     esi, [rax+Stat.st_mode]
+    and     esi, S_IPERMS
+    or      esi, 700o
+
+    mov     rdi, [rsp+.dst]
+    dcall   mkdir
+    cmp     eax, 0
+    je      .created
+
+    ; Copying into an existing directory is fine.
+    dcall   get_errno
+    cmp     rax, EEXIST
+    jne     .error_mkdir
+
+.created:
+    mov     rdi, [rsp+.src]
+    dcall   opendir
+    cmp     rax, 0
+    je      .error_opendir
+
+    mov     [rsp+.dir], rax
+
+.next_entry:
+    mov     rdi, [rsp+.dir]
+    dcall   readdir
+    cmp     rax, 0
+    je      .no_more_entries
+
+    ; Get the address of the name (dirent.d_name).
+    lea     rbx, [rax+Dirent64.d_name]
+
+    ;--------------------
+    ; Ignore "." and "..".
+
+    cmp     byte [rbx], '.'
+    jne     .not_dot
+
+    cmp     byte [rbx+1], 0
+    je      .next_entry
+
+    cmp     byte [rbx+1], '.'
+    jne     .not_dot
+
+    cmp     byte [rbx+2], 0
+    je      .next_entry
+
+.not_dot:
+    ;--------------------
+    ; Build the source and destination paths for the entry.
+
+    lea     rdi, [rsp+.src_path]
+    mov     rsi, PATH_MAX
+    mov     rdx, .path_fmt
+    mov     rcx, [rsp+.src]
+    mov     r8, rbx
+    xor     rax, rax ; No fp args
+    dcall   snprintf
+
+    cmp     rax, PATH_MAX
+    jge     .entry_failed
+
+    lea     rdi, [rsp+.dst_path]
+    mov     rsi, PATH_MAX
+    mov     rdx, .path_fmt
+    mov     rcx, [rsp+.dst]
+    mov     r8, rbx
+    xor     rax, rax ; No fp args
+    dcall   snprintf
+
+    cmp     rax, PATH_MAX
+    jge     .entry_failed
+
+    lea     rdi, [rsp+.src_path]
+    lea     rsi, [rsp+.dst_path]
+    mov     rdx, [rsp+.flags]
+    dcall   cp_path
+    cmp     rax, 0
+    je      .next_entry
+
+.entry_failed:
+    mov     qword [rsp+.ret], -1
+    jmp     .next_entry
+
+.no_more_entries:
+    mov     rdi, [rsp+.dir]
+    dcall   closedir
+
+    test    qword [rsp+.flags], CP_PRESERVE
+    jz      .out
+
+    ;--------------------
+    ; Preserve the directory attributes.
+
+    mov     rdi, [rsp+.dst]
+    mov     rsi, (O_RDONLY|O_DIRECTORY)
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error
+
+    ; Reuse .dir for the fd.
+    mov     [rsp+.dir], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.st]
+    dcall   cp_preserve
+    cmp     rax, 0
+    je      .close_dir_fd
+
+    mov     qword [rsp+.ret], -1
+
+.close_dir_fd:
+    mov     rdi, [rsp+.dir]
+    dcall   close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (PATH_MAX * 2)
+    epilogue_with_vars 6
+    ret
+
+.error_mkdir:
+    mov     rsi, .mkdir_fmt
+    mov     rdx, [rsp+.dst]
+    jmp     .show_error
+
+.error_opendir:
+    mov     rsi, .opendir_fmt
+    mov     rdx, [rsp+.src]
+
+.show_error:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy a symbolic link (not the file it points to).
+;
+; C prototype equivalent:
+;
+;     int cp_symlink(const char *src, const char *dst, int flags);
+;
+; Parameters:
+;
+; - Input: RDI (string) - source symbolic link.
+; - Input: RSI (string) - destination path.
+; - Input: RDX (integer) - CP_* flags.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cp_symlink:
+section .rodata
+    .symlink_fmt    db  "cp: cannot create symbolic link '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    alloc_space PATH_MAX
+
+    ;--------------------
+    ; Stack offsets.
+
+    .src        equ     0   ; "char *"
+    .dst        equ     8   ; "char *"
+    .flags      equ    16   ; size_t: CP_* bitmask.
+    .unused     equ    24   ; padding.
+    .target     equ    32   ; char[PATH_MAX]
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.src], rdi
+    mov     [rsp+.dst], rsi
+    mov     [rsp+.flags], rdx
+
+    ;--------------------
+
+    ; Note: readlink(2) does not add a terminator.
+    lea     rsi, [rsp+.target]
+    mov     rdx, (PATH_MAX - 1)
+    dcall   readlink
+    cmp     rax, 0
+    jl      .error
+
+    mov     byte [rsp+.target+rax], 0
+
+.create_link:
+    lea     rdi, [rsp+.target]
+    mov     rsi, [rsp+.dst]
+    dcall   symlink
+    cmp     eax, 0
+    je      .success
+
+    dcall   get_errno
+    cmp     rax, EEXIST
+    jne     .error
+
+    test    qword [rsp+.flags], CP_FORCE
+    jz      .error
+
+    ; Replace the existing file (once).
+    and     qword [rsp+.flags], ~CP_FORCE
+
+    mov     rdi, [rsp+.dst]
+    dcall   unlink
+    cmp     eax, 0
+    je      .create_link
+
+.error:
+    mov     rdi, STDERR_FD
+    mov     rsi, .symlink_fmt
+    mov     rdx, [rsp+.dst]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+.success:
+    mov     rax, 0
+
+.out:
+    free_space PATH_MAX
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Copy a file that is not a directory or a symbolic link.
+;
+; C prototype equivalent:
+;
+;     int cp_file(const char *src, const char *dst,
+;                 const struct stat *st, int flags);
+;
+; Parameters:
+;
+; - Input: RDI (string) - source path.
+; - Input: RSI (string) - destination path.
+; - Input: RDX (address) - Stat for the source.
+; - Input: RCX (integer) - CP_* flags.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cp_file:
+section .rodata
+    .open_fmt       db  "cp: cannot open '%s' for reading",10,0
+    .create_fmt     db  "cp: cannot create regular file '%s'",10,0
+    .same_fmt       db  "cp: '%s' and '%s' are the same file",10,0
+    .copy_fmt       db  "cp: error copying '%s' to '%s'",10,0
+section .text
+    .create_flags   equ (O_WRONLY|O_CREAT|O_TRUNC)
+
+    prologue_with_vars 8
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .src        equ     0   ; "char *"
+    .dst        equ     8   ; "char *"
+    .st         equ    16   ; "struct stat *"
+    .flags      equ    24   ; size_t: CP_* bitmask.
+    .fd_in      equ    32   ; int.
+    .fd_out     equ    40   ; int.
+    .ret        equ    48   ; int: return value.
+    .unused     equ    56   ; padding.
+    .dst_stat   equ    64   ; Stat_size bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.src], rdi
+    mov     [rsp+.dst], rsi
+    mov     [rsp+.st], rdx
+    mov     [rsp+.flags], rcx
+
+    mov     qword [rsp+.fd_in], -1
+    mov     qword [rsp+.fd_out], -1
+    mov     qword [rsp+.ret], -1
+
+    ;--------------------
+    ; Refuse to copy a file onto itself since truncating the
+    ; destination would destroy the source.
+
+    mov     rdi, [rsp+.dst]
+    lea     rsi, [rsp+.dst_stat]
+    dcall   stat
+    cmp     eax, 0
+    jne     .not_same_file
+
+    mov     rax, [rsp+.st]
+
+    mov     rcx, [rax+Stat.st_dev]
+    cmp     rcx, [rsp+.dst_stat+Stat.st_dev]
+    jne     .not_same_file
+
+    mov     rcx, [rax+Stat.st_ino]
+    cmp     rcx, [rsp+.dst_stat+Stat.st_ino]
+    je      .error_same_file
+
+.not_same_file:
+    mov     rdi, [rsp+.src]
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd_in], rax
+
+.create_dst:
+    ; Create the destination with the source permissions
+    ; (as modified by the umask).
+    mov     rax, [rsp+.st]
+    mov     edx, [rax+Stat.st_mode]
+    and     edx, 777o
+
+    mov     rdi, [rsp+.dst]
+    mov     rsi, .create_flags
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    jne     .created
+
+    test    qword [rsp+.flags], CP_FORCE
+    jz      .error_create
+
+    ; Remove the destination and try again (once).
+    and     qword [rsp+.flags], ~CP_FORCE
+
+    mov     rdi, [rsp+.dst]
+    dcall   unlink
+    cmp     eax, 0
+    je      .create_dst
+
+    jmp     .error_create
+
+.created:
+    mov     [rsp+.fd_out], rax
+
+    ;--------------------
+    ; Select the copy method.
+
+    mov     rax, [rsp+.st]
+
+    mov     ecx, [rax+Stat.st_mode]
+    and     ecx, S_IFMT
+    cmp     ecx, S_IFREG
+    jne     .stream
+
+    ; Some regular files (such as those in /proc) claim to be empty
+    ; but are not, so they must be read until EOF.
+    cmp     qword [rax+Stat.st_size], 0
+    je      .stream
+
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.fd_out]
+    mov     rdx, [rsp+.st]
+    dcall   cp_regular
+    jmp     .copied
+
+.stream:
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.fd_out]
+    dcall   cp_stream
+
+.copied:
+    cmp     rax, 0
+    jne     .error_copy
+
+    test    qword [rsp+.flags], CP_PRESERVE
+    jz      .success
+
+    mov     rdi, [rsp+.fd_out]
+    mov     rsi, [rsp+.st]
+    dcall   cp_preserve
+    cmp     rax, 0
+    jne     .error_copy
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.out:
+    mov     rdi, [rsp+.fd_out]
+    cmp     rdi, 0
+    jl      .close_fd_in
+
+    dcall   close
+
+    ; close(2) can report a delayed write error.
+    cmp     eax, 0
+    je      .close_fd_in
+
+    mov     qword [rsp+.ret], -1
+
+.close_fd_in:
+    mov     rdi, [rsp+.fd_in]
+    cmp     rdi, 0
+    jl      .done
+
+    dcall   close
+
+.done:
+    mov     rax, [rsp+.ret]
+
+    free_space Stat_size
+    epilogue_with_vars 8
+    ret
+
+.error_same_file:
+    mov     rdi, STDERR_FD
+    mov     rsi, .same_fmt
+    mov     rdx, [rsp+.src]
+    mov     rcx, [rsp+.dst]
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .out
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.src]
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .out
+
+.error_create:
+    mov     rdi, STDERR_FD
+    mov     rsi, .create_fmt
+    mov     rdx, [rsp+.dst]
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .out
+
+.error_copy:
+    mov     rdi, STDERR_FD
+    mov     rsi, .copy_fmt
+    mov     rdx, [rsp+.src]
+    mov     rcx, [rsp+.dst]
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy the data of a (non-empty) regular file.
+;
+; C prototype equivalent:
+;
+;     int cp_regular(int fd_in, int fd_out, const struct stat *st);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - source file descriptor.
+; - Input: RSI (integer) - destination file descriptor (empty file).
+; - Input: RDX (address) - Stat for the source.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - If the source is not sparse, the destination is preallocated with
+;   fallocate(2) to avoid the filesystem allocating (and possibly
+;   fragmenting) the file piecemeal as it is written (particularly
+;   since the threads write ranges of the file out of order).
+;
+; - If the source is sparse (fewer blocks allocated than its size
+;   requires), preallocating would fill the holes, so the destination
+;   size is just set with ftruncate(2), leaving it entirely "hole"
+;   until the data segments are copied.
+;---------------------------------------------------------------------
+
+cp_regular:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .st         equ    16   ; "struct stat *"
+    .size       equ    24   ; off_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+    mov     [rsp+.st], rdx
+
+    mov     rax, [rdx+Stat.st_size]
+    mov     [rsp+.size], rax
+
+    ;--------------------
+    ; Try a reflink first: if it works, there is nothing left to do.
+
+    mov     rdi, [rsp+.fd_out]
+    mov     rsi, FICLONE
+    mov     rdx, [rsp+.fd_in]
+    xor     rax, rax ; No fp args (ioctl(2) is variadic)
+    dcall   ioctl
+    cmp     eax, 0
+    je      .out
+
+    ;--------------------
+    ; Size the destination.
+
+    mov     rax, [rsp+.st]
+    mov     rcx, [rax+Stat.st_blocks]
+    shl     rcx, 9 ; st_blocks is in units of 512 bytes.
+    cmp     rcx, [rsp+.size]
+    jl      .set_size ; Sparse.
+
+    ; Failure is not fatal (not all filesystems support it).
+    mov     rdi, [rsp+.fd_out]
+    mov     rsi, 0 ; mode.
+    mov     rdx, 0 ; offset.
+    mov     rcx, [rsp+.size]
+    dcall   fallocate
+
+.set_size:
+    mov     rdi, [rsp+.fd_out]
+    mov     rsi, [rsp+.size]
+    dcall   ftruncate
+    cmp     eax, 0
+    jne     .error
+
+    ;--------------------
+    ; Copy the data.
+
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.fd_out]
+    mov     rdx, [rsp+.size]
+
+    cmp     rdx, CP_PARALLEL_MIN_SIZE
+    jl      .serial
+
+    dcall   cp_parallel
+    jmp     .out
+
+.serial:
+    mov     rcx, rdx ; length.
+    mov     rdx, 0   ; offset.
+    dcall   cp_range
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy a file using multiple threads.
+;
+; C prototype equivalent:
+;
+;     int cp_parallel(int fd_in, int fd_out, off_t size);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - source file descriptor.
+; - Input: RSI (integer) - destination file descriptor.
+; - Input: RDX (integer) - number of bytes to copy.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The file is split into (at most CP_MAX_THREADS) equal,
+;   CP_CHUNK_ALIGN aligned chunks and each chunk is copied by its own
+;   thread using cp_range(). Since cp_range() only uses calls that take
+;   an explicit offset, the threads can safely share the file
+;   descriptors.
+;
+; - If a thread cannot be created, its chunk is copied by this thread
+;   instead.
+;---------------------------------------------------------------------
+
+cp_parallel:
+    prologue_with_vars 8
+
+    alloc_space (CpChunk_size * CP_MAX_THREADS)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .size       equ    16   ; off_t.
+    .threads    equ    24   ; size_t: number of chunks.
+    .chunk_size equ    32   ; size_t.
+    .i          equ    40   ; size_t: chunk index.
+    .ret        equ    48   ; int: return value.
+    .unused     equ    56   ; padding.
+    .chunks     equ    64   ; CpChunk array.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+    mov     [rsp+.size], rdx
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; threads = min(get_nprocs(), CP_MAX_THREADS, size / CP_MIN_CHUNK_SIZE)
+
+    dcall   get_nprocs
+    cdqe
+    mov     [rsp+.threads], rax
+
+    cmp     qword [rsp+.threads], CP_MAX_THREADS
+    jle     .cpus_ok
+
+    mov     qword [rsp+.threads], CP_MAX_THREADS
+
+.cpus_ok:
+    mov     rax, [rsp+.size]
+    xor     rdx, rdx
+    mov     rcx, CP_MIN_CHUNK_SIZE
+    div     rcx
+
+    cmp     rax, [rsp+.threads]
+    jge     .size_ok
+
+    mov     [rsp+.threads], rax
+
+.size_ok:
+    cmp     qword [rsp+.threads], 1
+    jg      .split
+
+    ; Not worth using threads.
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.fd_out]
+    mov     rdx, 0
+    mov     rcx, [rsp+.size]
+    dcall   cp_range
+    jmp     .out
+
+.split:
+    ;--------------------
+    ; chunk_size = roundup(ceil(size / threads), CP_CHUNK_ALIGN)
+
+    mov     rax, [rsp+.size]
+    add     rax, [rsp+.threads]
+    dec     rax
+    xor     rdx, rdx
+    div     qword [rsp+.threads]
+
+    add     rax, (CP_CHUNK_ALIGN - 1)
+    and     rax, ~(CP_CHUNK_ALIGN - 1)
+    mov     [rsp+.chunk_size], rax
+
+    ;--------------------
+    ; Start a thread for each chunk.
+
+    mov     qword [rsp+.i], 0
+
+.next_chunk:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.threads]
+    je      .join
+
+    ; rbx = &chunks[i]
+    imul    rbx, rax, CpChunk_size
+    lea     rbx, [rsp+.chunks+rbx]
+
+    mov     rcx, [rsp+.fd_in]
+    mov     [rbx+CpChunk.src_fd], rcx
+
+    mov     rcx, [rsp+.fd_out]
+    mov     [rbx+CpChunk.dst_fd], rcx
+
+    ; offset = i * chunk_size
+    imul    rax, [rsp+.chunk_size]
+    mov     [rbx+CpChunk.offset], rax
+
+    ; length = min(chunk_size, size - offset) (or 0 if past the end)
+    mov     rcx, [rsp+.size]
+    sub     rcx, rax
+    jg      .some_left
+
+    xor     rcx, rcx
+
+.some_left:
+    cmp     rcx, [rsp+.chunk_size]
+    jle     .got_length
+
+    mov     rcx, [rsp+.chunk_size]
+
+.got_length:
+    mov     [rbx+CpChunk.length], rcx
+
+    mov     qword [rbx+CpChunk.ret], -1
+    mov     qword [rbx+CpChunk.started], 0
+
+    lea     rdi, [rbx+CpChunk.thread]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, cp_chunk_thread
+    mov     rcx, rbx
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .copy_chunk_here
+
+    mov     qword [rbx+CpChunk.started], 1
+    jmp     .chunk_started
+
+.copy_chunk_here:
+    mov     rdi, rbx
+    dcall   cp_chunk_thread
+
+.chunk_started:
+    inc     qword [rsp+.i]
+    jmp     .next_chunk
+
+    ;--------------------
+    ; Wait for all the threads and collect the results.
+
+.join:
+    mov     qword [rsp+.i], 0
+
+.join_next:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.threads]
+    je      .out
+
+    imul    rbx, rax, CpChunk_size
+    lea     rbx, [rsp+.chunks+rbx]
+
+    cmp     qword [rbx+CpChunk.started], 0
+    je      .check_chunk
+
+    mov     rdi, [rbx+CpChunk.thread]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+.check_chunk:
+    cmp     qword [rbx+CpChunk.ret], 0
+    je      .chunk_ok
+
+    mov     qword [rsp+.ret], -1
+
+.chunk_ok:
+    inc     qword [rsp+.i]
+    jmp     .join_next
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (CpChunk_size * CP_MAX_THREADS)
+    epilogue_with_vars 8
+    ret
+
+;---------------------------------------------------------------------
+; Description: Thread function to copy a single chunk.
+;
+; C prototype equivalent:
+;
+;     void *cp_chunk_thread(CpChunk *chunk);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CpChunk to copy (CpChunk.ret is set to the
+;   result).
+; - Output: RAX (address) - always NULL.
+;---------------------------------------------------------------------
+
+cp_chunk_thread:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .chunk      equ     0   ; "CpChunk *"
+
+    ;--------------------
+
+    mov     [rsp+.chunk], rdi
+
+    mov     rax, rdi
+    mov     rdi, [rax+CpChunk.src_fd]
+    mov     rsi, [rax+CpChunk.dst_fd]
+    mov     rdx, [rax+CpChunk.offset]
+    mov     rcx, [rax+CpChunk.length]
+    dcall   cp_range
+
+    mov     rcx, [rsp+.chunk]
+    mov     [rcx+CpChunk.ret], rax
+
+    xor     rax, rax
+
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Copy a range of a file, skipping any holes.
+;
+; C prototype equivalent:
+;
+;     int cp_range(int fd_in, int fd_out, off_t offset, size_t length);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - source file descriptor.
+; - Input: RSI (integer) - destination file descriptor.
+; - Input: RDX (integer) - offset of start of range.
+; - Input: RCX (integer) - number of bytes in range.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The destination must already have the final size, so that the
+;   holes skipped here remain holes in the destination.
+;
+; - lseek(2) SEEK_DATA and SEEK_HOLE calculate their result from the
+;   offset argument (not the current file offset) so the result is
+;   unaffected by other threads calling lseek(2) on the same fd.
+;
+; - If the filesystem does not support SEEK_DATA, the whole range is
+;   treated as data.
+;---------------------------------------------------------------------
+
+cp_range:
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .pos        equ    16   ; off_t: current offset.
+    .end        equ    24   ; off_t: end of range.
+    .data       equ    32   ; off_t: start of data segment.
+    .hole       equ    40   ; off_t: end of data segment.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+    mov     [rsp+.pos], rdx
+
+    add     rdx, rcx
+    mov     [rsp+.end], rdx
+
+    ;--------------------
+
+.next_segment:
+    mov     rax, [rsp+.pos]
+    cmp     rax, [rsp+.end]
+    jge     .success
+
+    ; Find the next data segment.
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.pos]
+    mov     rdx, SEEK_DATA
+    dcall   lseek
+    cmp     rax, -1
+    jne     .got_data
+
+    ; ENXIO means there is no more data: just holes until EOF.
+    dcall   get_errno
+    cmp     rax, ENXIO
+    je      .success
+
+    ; Holes are not supported, so copy everything.
+    mov     rax, [rsp+.pos]
+    mov     [rsp+.data], rax
+    mov     rax, [rsp+.end]
+    mov     [rsp+.hole], rax
+    jmp     .copy_segment
+
+.got_data:
+    cmp     rax, [rsp+.end]
+    jge     .success ; The rest of the range is a hole.
+
+    mov     [rsp+.data], rax
+
+    ; Find the end of the data segment.
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, rax
+    mov     rdx, SEEK_HOLE
+    dcall   lseek
+    cmp     rax, -1
+    je      .hole_at_end
+
+    cmp     rax, [rsp+.end]
+    jle     .got_hole
+
+.hole_at_end:
+    mov     rax, [rsp+.end]
+
+.got_hole:
+    mov     [rsp+.hole], rax
+
+.copy_segment:
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.fd_out]
+    mov     rdx, [rsp+.data]
+    mov     rcx, [rsp+.hole]
+    sub     rcx, rdx
+    dcall   cp_data
+    cmp     rax, 0
+    jne     .error
+
+    mov     rax, [rsp+.hole]
+    mov     [rsp+.pos], rax
+    jmp     .next_segment
+
+.success:
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy a range of data between two files inside the
+;   kernel.
+;
+; C prototype equivalent:
+;
+;     int cp_data(int fd_in, int fd_out, off_t offset, size_t length);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - source file descriptor.
+; - Input: RSI (integer) - destination file descriptor.
+; - Input: RDX (integer) - offset in both files.
+; - Input: RCX (integer) - number of bytes to copy.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; If copy_file_range(2) cannot be used for these files (for example,
+; older kernels refuse to copy between filesystems), the remaining
+; data is copied with cp_data_rw().
+;---------------------------------------------------------------------
+
+cp_data:
+    prologue_with_vars 5
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .off_in     equ    16   ; off_t: updated by copy_file_range(2).
+    .off_out    equ    24   ; off_t: updated by copy_file_range(2).
+    .remaining  equ    32   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+    mov     [rsp+.off_in], rdx
+    mov     [rsp+.off_out], rdx
+    mov     [rsp+.remaining], rcx
+
+    ;--------------------
+
+.copy_again:
+    cmp     qword [rsp+.remaining], 0
+    je      .success
+
+    mov     rdi, [rsp+.fd_in]
+    lea     rsi, [rsp+.off_in]
+    mov     rdx, [rsp+.fd_out]
+    lea     rcx, [rsp+.off_out]
+    mov     r8, [rsp+.remaining]
+    mov     r9, 0 ; flags.
+    dcall   copy_file_range
+
+    cmp     rax, 0
+    je      .success ; EOF (the source has shrunk).
+    jl      .check_error
+
+    ; The offsets have been updated by the kernel.
+    sub     [rsp+.remaining], rax
+    jmp     .copy_again
+
+.check_error:
+    dcall   get_errno
+
+    cmp     rax, EINTR
+    je      .copy_again
+
+    cmp     rax, EXDEV
+    je      .fallback
+
+    cmp     rax, EINVAL
+    je      .fallback
+
+    cmp     rax, ENOSYS
+    je      .fallback
+
+    cmp     rax, EOPNOTSUPP
+    je      .fallback
+
+    cmp     rax, EBADF
+    je      .fallback
+
+    jmp     .error
+
+.fallback:
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.fd_out]
+    mov     rdx, [rsp+.off_in]
+    mov     rcx, [rsp+.remaining]
+    dcall   cp_data_rw
+    jmp     .out
+
+.success:
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 5
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy a range of data between two files via a buffer.
+;
+; C prototype equivalent:
+;
+;     int cp_data_rw(int fd_in, int fd_out, off_t offset, size_t length);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - source file descriptor.
+; - Input: RSI (integer) - destination file descriptor.
+; - Input: RDX (integer) - offset in both files.
+; - Input: RCX (integer) - number of bytes to copy.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; Unlike read_block() and write_block(), pread(2) and pwrite(2) do not
+; use (or change) the file offset, so this is safe to call from
+; multiple threads on the same file descriptors.
+;---------------------------------------------------------------------
+
+cp_data_rw:
+    prologue_with_vars 7
+
+    sub     rsp, IO_READ_BUF_SIZE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .offset     equ    16   ; off_t.
+    .remaining  equ    24   ; size_t.
+    .bytes      equ    32   ; ssize_t: bytes in buffer.
+    .written    equ    40   ; size_t: bytes of buffer written.
+    .unused     equ    48   ; padding.
+    .buffer     equ    56   ; IO_READ_BUF_SIZE bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+    mov     [rsp+.offset], rdx
+    mov     [rsp+.remaining], rcx
+
+    ;--------------------
+
+.read_again:
+    cmp     qword [rsp+.remaining], 0
+    je      .success
+
+    mov     rdx, [rsp+.remaining]
+    cmp     rdx, IO_READ_BUF_SIZE
+    jle     .read_size_ok
+
+    mov     rdx, IO_READ_BUF_SIZE
+
+.read_size_ok:
+    mov     rdi, [rsp+.fd_in]
+    lea     rsi, [rsp+.buffer]
+    mov     rcx, [rsp+.offset]
+    dcall   pread
+
+    cmp     rax, 0
+    je      .success ; EOF.
+    jg      .got_data
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .read_again
+    jmp     .error
+
+.got_data:
+    mov     [rsp+.bytes], rax
+    mov     qword [rsp+.written], 0
+
+.write_again:
+    mov     rdx, [rsp+.bytes]
+    sub     rdx, [rsp+.written]
+    je      .written_all
+
+    mov     rdi, [rsp+.fd_out]
+    lea     rsi, [rsp+.buffer]
+    add     rsi, [rsp+.written]
+    mov     rcx, [rsp+.offset]
+    add     rcx, [rsp+.written]
+    dcall   pwrite
+
+    cmp     rax, 0
+    jg      .wrote_data
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .write_again
+    jmp     .error
+
+.wrote_data:
+    add     [rsp+.written], rax
+    jmp     .write_again
+
+.written_all:
+    mov     rax, [rsp+.bytes]
+    add     [rsp+.offset], rax
+    sub     [rsp+.remaining], rax
+    jmp     .read_again
+
+.success:
+    mov     rax, 0
+
+.out:
+    add     rsp, IO_READ_BUF_SIZE
+    epilogue_with_vars 7
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy all data from one file descriptor to another using
+;   read_block() and write_block().
+;
+; C prototype equivalent:
+;
+;     int cp_stream(int fd_in, int fd_out);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - source file descriptor.
+; - Input: RSI (integer) - destination file descriptor.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cp_stream:
+    prologue_with_vars 3
+
+    sub     rsp, IO_READ_BUF_SIZE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .bytes      equ    16   ; ssize_t.
+    .buffer     equ    24   ; IO_READ_BUF_SIZE bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+
+    ;--------------------
+
+.read_again:
+    mov     rdi, [rsp+.fd_in]
+    lea     rsi, [rsp+.buffer]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .success ; EOF
+    jl      .error
+
+    mov     [rsp+.bytes], rax
+
+    mov     rdi, [rsp+.fd_out]
+    lea     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.bytes]
+    dcall   write_block
+
+    cmp     rax, 1
+    jge     .read_again
+    jmp     .error
+
+.success:
+    mov     rax, 0
+
+.out:
+    add     rsp, IO_READ_BUF_SIZE
+    epilogue_with_vars 3
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Apply the ownership, mode and timestamps of the source
+;   to the destination.
+;
+; C prototype equivalent:
+;
+;     int cp_preserve(int fd, const struct stat *st);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - destination file descriptor.
+; - Input: RSI (address) - Stat for the source.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Failing to change the ownership is not an error (only root can
+;   give a file away), which matches cp(1).
+;
+; - The mode is set *after* the ownership since changing the owner
+;   clears the setuid and setgid bits.
+;
+; - Stat.st_atim and Stat.st_mtim are adjacent, so they form the
+;   "struct timespec times[2]" array that futimens(3) requires.
+;---------------------------------------------------------------------
+
+cp_preserve:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd         equ     0   ; int.
+    .st         equ     8   ; "struct stat *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd], rdi
+    mov     [rsp+.st], rsi
+
+    ;--------------------
+
+    mov     rax, [rsp+.st]
+    mov     edx, [rax+Stat.st_gid]
+    mov     esi, [rax+Stat.st_uid]
+    mov     rdi, [rsp+.fd]
+    dcall   fchown
+
+    mov     rax, [rsp+.st]
+    mov     esi, [rax+Stat.st_mode]
+    and     esi, S_IPERMS
+    mov     rdi, [rsp+.fd]
+    dcall   fchmod
+    cmp     eax, 0
+    jne     .error
+
+    mov     rax, [rsp+.st]
+    lea     rsi, [rax+Stat.st_atim]
+    mov     rdi, [rsp+.fd]
+    dcall   futimens
+    cmp     eax, 0
+    jne     .error
+
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
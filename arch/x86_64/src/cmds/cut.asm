@@ -0,0 +1,1720 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_cut
+global command_cut
+
+extern arena_alloc
+extern arena_free
+extern asm_getopt
+extern read_block
+extern write_block
+
+extern close
+extern dprintf
+extern memcpy
+extern memmove
+extern memrchr
+extern open
+
+extern optarg
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_cut:  db  "see cut(1)",10, \
+                       10, \
+                       "Usage: cut -b LIST [FILE]...",10, \
+                       "       cut -f LIST [-d DELIM] [-s] [FILE]...",10, \
+                       10, \
+                       "Options:",10, \
+                       10, \
+                       "-b LIST  : Select only these bytes.",10, \
+                       "-c LIST  : Same as '-b'.",10, \
+                       "-d DELIM : Use DELIM rather than TAB as the field delimiter.",10, \
+                       "-f LIST  : Select only these fields.",10, \
+                       "-s       : Don't show lines without delimiters.",10, \
+                       10, \
+                       "LIST is a comma separated list of N, N-, N-M or -M ranges",10, \
+                       "(counting from 1).",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign CUT_BYTES               (1 << 0)
+%assign CUT_FIELDS              (1 << 1)
+%assign CUT_ONLY_DELIMITED      (1 << 2)
+%assign CUT_DELIMITER           (1 << 3)
+
+; Size of the output buffer.
+CUT_OUT_BUF_SIZE        equ     (IO_READ_BUF_SIZE * 4)
+
+; Initial size of the input buffer. It grows if a single line does not
+; fit.
+CUT_READ_BUF_SIZE       equ     (IO_READ_BUF_SIZE * 4)
+
+; Bytes after the end of the data in each buffer that may be read or
+; written by the vector loops (which work on whole blocks).
+%assign CUT_SLACK               64
+
+; Largest value allowed in a LIST.
+CUT_MAX_POSITION        equ     (1 << 62)
+
+;---------------------------------------------------------------------
+; An inclusive range of selected fields or bytes (counting from 1).
+;---------------------------------------------------------------------
+struc CutRange
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .start      resq    1 ; size_t: first position.
+    .end        resq    1 ; size_t: last position (-1 for no limit).
+endstruc
+
+;---------------------------------------------------------------------
+; State shared by the cut functions.
+;---------------------------------------------------------------------
+struc CutState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .delim_vec  resb    16 ; The delimiter in every byte.
+    .nl_vec     resb    16 ; '\n' in every byte.
+    .flags      resq    1  ; CUT_* bitmask.
+    .delim      resq    1  ; char: field delimiter.
+    .ranges     resq    1  ; "CutRange *": sorted, non-overlapping and
+                           ; non-adjacent ranges.
+    .ranges_end resq    1  ; "CutRange *": end of .ranges.
+    .out_buf    resq    1  ; "char *": CUT_OUT_BUF_SIZE + CUT_SLACK bytes.
+    .out_pos    resq    1  ; "char *": next byte to write.
+    .out_limit  resq    1  ; "char *": flush before writing past here.
+    .error      resq    1  ; bool: true if output failed.
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `cut` command.
+;
+; C prototype equivalent:
+;
+;     int command_cut(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, else -1.
+;
+; Notes:
+;
+; - The input is read in large blocks and only complete lines are
+;   handled (see cut_stream()). The delimiters and newlines in each
+;   block are found 64 bytes at a time using bitmasks (see
+;   cut_fields()).
+;
+; - Selected fields (or bytes) that are next to each other are written
+;   as a single run.
+;
+; - Output is buffered.
+;
+; Limitations:
+;
+; - '-c' selects bytes rather than (multibyte) characters.
+; - '-n', '--complement' and '--output-delimiter' are not supported.
+; - Blanks cannot be used to separate the ranges in a LIST.
+;
+; See: cut(1).
+;---------------------------------------------------------------------
+
+command_cut:
+section .rodata
+    .optstring          db  "b:c:d:f:s",0
+    .bytes_opt          equ 'b'
+    .chars_opt          equ 'c'
+    .delim_opt          equ 'd'
+    .fields_opt         equ 'f'
+    .only_delim_opt     equ 's'
+
+    .stdin_name         db  "-",0
+cold_rodata
+    .nomem_msg          db  "cut: cannot allocate memory",10,0
+    .one_list_msg       db  "cut: only one type of list may be specified",10,0
+    .no_list_msg        db  "cut: you must specify a list of bytes, characters, or fields",10,0
+    .delim_msg          db  "cut: the delimiter must be a single character",10,0
+    .delim_fields_msg   db  "cut: an input delimiter may be specified only when operating on fields",10,0
+    .only_fields_msg    db  "cut: suppressing non-delimited lines makes sense only when operating on fields",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .state          equ     16  ; "CutState *"
+    .list           equ     24  ; "char *": LIST.
+    .file_idx       equ     32  ; size_t: index into argv of next file.
+    .ret            equ     40  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     rdi, CutState_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.state], rax
+
+    ;--------------------
+    ; Set defaults
+
+    mov     rbx, rax
+
+    mov     qword [rbx+CutState.flags], 0
+    mov     qword [rbx+CutState.delim], 0x09 ; '\t'
+    mov     qword [rbx+CutState.error], 0
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .bytes_opt
+    je      .handle_bytes_opt
+
+    cmp     al, .chars_opt
+    je      .handle_bytes_opt
+
+    cmp     al, .delim_opt
+    je      .handle_delim_opt
+
+    cmp     al, .fields_opt
+    je      .handle_fields_opt
+
+    cmp     al, .only_delim_opt
+    je      .handle_only_delim_opt
+
+    jmp     .error_bad_option
+
+.handle_bytes_opt:
+    mov     rax, CUT_BYTES
+    jmp     .set_list
+
+.handle_fields_opt:
+    mov     rax, CUT_FIELDS
+
+.set_list:
+    test    qword [rbx+CutState.flags], (CUT_BYTES|CUT_FIELDS)
+    jnz     .error_one_list
+
+    or      [rbx+CutState.flags], rax
+
+    mov     rax, [optarg]
+    mov     [rsp+.list], rax
+    jmp     .next_arg
+
+.handle_delim_opt:
+    ; An empty delimiter means NUL.
+    mov     rdx, [optarg]
+    movzx   eax, byte [rdx]
+    cmp     al, 0
+    je      .set_delim
+
+    cmp     byte [rdx+1], 0
+    jne     .error_delim
+
+.set_delim:
+    mov     [rbx+CutState.delim], rax
+    or      qword [rbx+CutState.flags], CUT_DELIMITER
+    jmp     .next_arg
+
+.handle_only_delim_opt:
+    or      qword [rbx+CutState.flags], CUT_ONLY_DELIMITED
+    jmp     .next_arg
+
+.options_parsed:
+    mov     rax, [rbx+CutState.flags]
+
+    test    rax, (CUT_BYTES|CUT_FIELDS)
+    jz      .error_no_list
+
+    test    rax, CUT_FIELDS
+    jnz     .parse_list
+
+    test    rax, CUT_DELIMITER
+    jnz     .error_delim_fields
+
+    test    rax, CUT_ONLY_DELIMITED
+    jnz     .error_only_fields
+
+.parse_list:
+    mov     rdi, rbx
+    mov     rsi, [rsp+.list]
+    dcall   cut_parse_list
+    cmp     rax, 0
+    jne     .error_list
+
+    ;--------------------
+    ; Fill the vectors used to find delimiters and newlines.
+
+    mov     rax, [rbx+CutState.delim]
+    mov     rdx, 0x0101010101010101
+    imul    rax, rdx
+    mov     [rbx+CutState.delim_vec], rax
+    mov     [rbx+CutState.delim_vec+8], rax
+
+    mov     rax, 0x0a0a0a0a0a0a0a0a
+    mov     [rbx+CutState.nl_vec], rax
+    mov     [rbx+CutState.nl_vec+8], rax
+
+    ;--------------------
+    ; Create the output buffer.
+
+    mov     rdi, (CUT_OUT_BUF_SIZE + CUT_SLACK)
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rbx+CutState.out_buf], rax
+    mov     [rbx+CutState.out_pos], rax
+    add     rax, CUT_OUT_BUF_SIZE
+    mov     [rbx+CutState.out_limit], rax
+
+    ;--------------------
+
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.file_idx], rax
+
+    cmp     rax, [rsp+.argc]
+    jne     .next_file
+
+    ; No files, so read stdin.
+    mov     rdi, rbx
+    mov     rsi, .stdin_name
+    dcall   cut_file
+    jmp     .check_result
+
+.next_file:
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    je      .finish
+
+    mov     rcx, [rsp+.argv]
+    mov     rsi, [rcx+rax*PTR_SIZE]
+    mov     rdi, rbx
+    dcall   cut_file
+
+    inc     qword [rsp+.file_idx]
+
+.check_result:
+    cmp     rax, 0
+    je      .check_output
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.check_output:
+    ; Give up if the output is broken.
+    cmp     qword [rbx+CutState.error], 0
+    jne     .finish
+
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    jl      .next_file
+
+.finish:
+    mov     rdi, rbx
+    mov     rsi, [rbx+CutState.out_pos]
+    dcall   cut_flush
+
+    cmp     qword [rbx+CutState.error], 0
+    je      .out
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 6
+    ret
+
+.error_nomem:
+    mov     rsi, .nomem_msg
+    jmp     .error_msg
+
+.error_one_list:
+    mov     rsi, .one_list_msg
+    jmp     .error_msg
+
+.error_no_list:
+    mov     rsi, .no_list_msg
+    jmp     .error_msg
+
+.error_delim:
+    mov     rsi, .delim_msg
+    jmp     .error_msg
+
+.error_delim_fields:
+    mov     rsi, .delim_fields_msg
+    jmp     .error_msg
+
+.error_only_fields:
+    mov     rsi, .only_fields_msg
+
+.error_msg:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+.error_list:
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse a LIST of ranges.
+;
+; C prototype equivalent:
+;
+;     int cut_parse_list(CutState *state, const char *list);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (string) - LIST.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The ranges are sorted and overlapping or adjacent ranges are
+;   merged, so a line can be handled by walking through the ranges in
+;   order and each range is a single run of output.
+;
+; - An error message is shown on failure.
+;---------------------------------------------------------------------
+
+cut_parse_list:
+cold_rodata
+    .nomem_msg          db  "cut: cannot allocate memory",10,0
+    .invalid_fmt        db  "cut: invalid list: '%s'",10,0
+    .zero_msg           db  "cut: fields and positions are numbered from 1",10,0
+    .decreasing_msg     db  "cut: invalid decreasing range",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "CutState *"
+    .list       equ     8   ; "char *"
+    .ranges     equ    16   ; "CutRange *"
+    .ptr        equ    24   ; "char *": current position in list.
+    .start      equ    32   ; size_t: start of current range.
+    .count      equ    40   ; size_t: number of ranges.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.list], rsi
+    mov     [rsp+.ptr], rsi
+
+    ;--------------------
+    ; There is one more range than there are commas.
+
+    mov     rdi, CutRange_size
+
+.count_commas:
+    movzx   eax, byte [rsi]
+    cmp     al, 0
+    je      .alloc
+
+    inc     rsi
+
+    cmp     al, ','
+    jne     .count_commas
+
+    add     rdi, CutRange_size
+    jmp     .count_commas
+
+.alloc:
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.ranges], rax
+    mov     qword [rsp+.count], 0
+
+    ;--------------------
+
+.next_range:
+    mov     rsi, [rsp+.ptr]
+    cmp     byte [rsi], '-'
+    jne     .parse_start
+
+    ; "-M"
+    mov     qword [rsp+.start], 1
+    inc     qword [rsp+.ptr]
+    jmp     .parse_end
+
+.parse_start:
+    lea     rdi, [rsp+.ptr]
+    dcall   cut_number
+    cmp     rax, -1
+    je      .error_invalid
+
+    mov     [rsp+.start], rax
+
+    mov     rsi, [rsp+.ptr]
+    cmp     byte [rsi], '-'
+    jne     .save_range ; "N" (RAX is the end too).
+
+    inc     rsi
+    mov     [rsp+.ptr], rsi
+
+    ; "N-"
+    mov     rax, -1
+    movzx   edx, byte [rsi]
+    cmp     dl, 0
+    je      .save_range
+
+    cmp     dl, ','
+    je      .save_range
+
+.parse_end:
+    lea     rdi, [rsp+.ptr]
+    dcall   cut_number
+    cmp     rax, -1
+    je      .error_invalid
+
+.save_range:
+    mov     rdx, [rsp+.start]
+    cmp     rdx, 0
+    je      .error_zero
+
+    cmp     rax, 0
+    je      .error_zero
+
+    cmp     rax, rdx
+    jb      .error_decreasing
+
+    mov     rcx, [rsp+.count]
+    shl     rcx, 4 ; CutRange_size
+    add     rcx, [rsp+.ranges]
+    mov     [rcx+CutRange.start], rdx
+    mov     [rcx+CutRange.end], rax
+    inc     qword [rsp+.count]
+
+    mov     rsi, [rsp+.ptr]
+    movzx   eax, byte [rsi]
+    cmp     al, 0
+    je      .sort
+
+    cmp     al, ','
+    jne     .error_invalid
+
+    inc     qword [rsp+.ptr]
+    jmp     .next_range
+
+    ;--------------------
+    ; Insertion sort the ranges by their start.
+
+.sort:
+    mov     rdi, [rsp+.ranges]
+    mov     r8, [rsp+.count]
+    shl     r8, 4 ; CutRange_size
+    add     r8, rdi ; End of ranges.
+
+    lea     rsi, [rdi+CutRange_size]
+
+.next_sort:
+    cmp     rsi, r8
+    jae     .merge
+
+    mov     rax, [rsi+CutRange.start]
+    mov     rdx, [rsi+CutRange.end]
+    mov     rcx, rsi
+
+.shift:
+    cmp     rcx, rdi
+    je      .insert
+
+    cmp     [rcx-CutRange_size+CutRange.start], rax
+    jbe     .insert
+
+    mov     r9, [rcx-CutRange_size+CutRange.start]
+    mov     [rcx+CutRange.start], r9
+    mov     r9, [rcx-CutRange_size+CutRange.end]
+    mov     [rcx+CutRange.end], r9
+
+    sub     rcx, CutRange_size
+    jmp     .shift
+
+.insert:
+    mov     [rcx+CutRange.start], rax
+    mov     [rcx+CutRange.end], rdx
+
+    add     rsi, CutRange_size
+    jmp     .next_sort
+
+    ;--------------------
+    ; Merge ranges that overlap or touch (RDI is the last merged range).
+
+.merge:
+    lea     rsi, [rdi+CutRange_size]
+
+.next_merge:
+    cmp     rsi, r8
+    jae     .merged
+
+    mov     rax, [rsi+CutRange.start]
+    mov     rdx, [rsi+CutRange.end]
+
+    ; Note: "start - 1" avoids overflow when the end is unlimited.
+    lea     rcx, [rax-1]
+    cmp     rcx, [rdi+CutRange.end]
+    ja      .new_range
+
+    cmp     rdx, [rdi+CutRange.end]
+    jbe     .merged_range
+
+    mov     [rdi+CutRange.end], rdx
+    jmp     .merged_range
+
+.new_range:
+    add     rdi, CutRange_size
+    mov     [rdi+CutRange.start], rax
+    mov     [rdi+CutRange.end], rdx
+
+.merged_range:
+    add     rsi, CutRange_size
+    jmp     .next_merge
+
+.merged:
+    add     rdi, CutRange_size
+
+    mov     rax, [rsp+.state]
+    mov     rdx, [rsp+.ranges]
+    mov     [rax+CutState.ranges], rdx
+    mov     [rax+CutState.ranges_end], rdi
+
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+.error_nomem:
+    mov     rsi, .nomem_msg
+    jmp     .error_msg
+
+.error_zero:
+    mov     rsi, .zero_msg
+    jmp     .error_msg
+
+.error_decreasing:
+    mov     rsi, .decreasing_msg
+    jmp     .error_msg
+
+.error_invalid:
+    mov     rsi, .invalid_fmt
+    mov     rdx, [rsp+.list]
+
+.error_msg:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse a position in a LIST.
+;
+; C prototype equivalent:
+;
+;     size_t cut_number(const char **str);
+;
+; Parameters:
+;
+; - Input+Output: RDI (address) - pointer to the string, which is
+;   updated to point to the first byte after the digits.
+; - Output: RAX (integer) - value, or -1 if there are no digits or the
+;   value is larger than CUT_MAX_POSITION.
+;---------------------------------------------------------------------
+
+cut_number:
+    prologue_with_vars 0
+
+    mov     rsi, [rdi]
+    mov     r8, rsi
+    xor     eax, eax
+    mov     rcx, CUT_MAX_POSITION
+
+.next_digit:
+    movzx   edx, byte [rsi]
+    sub     edx, '0'
+    cmp     edx, 9
+    ja      .end
+
+    imul    rax, rax, 10
+    add     rax, rdx
+    cmp     rax, rcx
+    ja      .error
+
+    inc     rsi
+    jmp     .next_digit
+
+.end:
+    cmp     rsi, r8
+    je      .error
+
+    mov     [rdi], rsi
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Cut the specified file.
+;
+; C prototype equivalent:
+;
+;     int cut_file(CutState *state, const char *file);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (string) - file path ("-" means stdin).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+cut_file:
+section .rodata
+    .stdin_name     db  "(standard input)",0
+cold_rodata
+    .open_fmt       db  "cut: %s: cannot open file",10,0
+    .read_fmt       db  "cut: %s: read error",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "CutState *"
+    .file       equ     8   ; "char *"
+    .fd         equ    16   ; int.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.file], rsi
+
+    ;--------------------
+    ; Handle the stdin alias.
+
+    cmp     byte [rsi], '-'
+    jne     .open_file
+
+    cmp     byte [rsi+1], 0
+    jne     .open_file
+
+    mov     qword [rsp+.file], .stdin_name
+
+    mov     rsi, STDIN_FD
+    dcall   cut_stream
+    cmp     rax, 0
+    jne     .error_read
+
+    jmp     .out
+
+.open_file:
+    mov     rdi, [rsp+.file]
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    dcall   cut_stream
+    mov     [rsp+.ret], rax
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+    mov     rax, [rsp+.ret]
+    cmp     rax, 0
+    jne     .error_read
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error_open:
+    mov     rsi, .open_fmt
+    jmp     .error
+
+.error_read:
+    mov     rsi, .read_fmt
+
+.error:
+    mov     [rsp+.fd], rsi ; No longer needed, so reuse to save format.
+
+    ; Don't mix the error with any buffered output.
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rdi+CutState.out_pos]
+    dcall   cut_flush
+
+    mov     rdi, STDERR_FD
+    mov     rsi, [rsp+.fd]
+    mov     rdx, [rsp+.file]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Cut all the data available from the specified file
+;   descriptor.
+;
+; C prototype equivalent:
+;
+;     int cut_stream(CutState *state, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (integer) - file descriptor.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Only complete lines are handled: any partial line at the end of
+;   the buffer is moved to the start of the buffer before reading more
+;   data.
+;
+; - If a line does not fit in the buffer, the buffer size is doubled.
+;
+; - The buffer is allocated from the arena and returned to it (with
+;   arena_free()) for the next file.
+;
+; - A newline is added to a final unterminated line.
+;---------------------------------------------------------------------
+
+cut_stream:
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "CutState *"
+    .fd         equ     8   ; int.
+    .buffer     equ    16   ; "char *"
+    .size       equ    24   ; size_t: size of buffer (excluding slack).
+    .keep       equ    32   ; size_t: bytes of data in buffer.
+    .consumed   equ    40   ; size_t: bytes of complete lines in buffer.
+    .ret        equ    48   ; int: return value.
+    .bigger     equ    56   ; "char *": replacement buffer.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+
+    ;--------------------
+
+    mov     qword [rsp+.keep], 0
+    mov     qword [rsp+.ret], -1
+    mov     qword [rsp+.size], CUT_READ_BUF_SIZE
+
+    mov     rdi, (CUT_READ_BUF_SIZE + CUT_SLACK)
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.buffer], rax
+
+.read_again:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rsp+.buffer]
+    add     rsi, [rsp+.keep]
+    mov     rdx, [rsp+.size]
+    sub     rdx, [rsp+.keep]
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .eof
+    jl      .free_buffer
+
+    add     [rsp+.keep], rax
+
+    ;--------------------
+    ; Find the end of the last complete line.
+
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.keep]
+    dcall   memrchr
+    cmp     rax, 0
+    je      .no_complete_line
+
+    inc     rax
+    sub     rax, [rsp+.buffer]
+    mov     [rsp+.consumed], rax
+    sub     [rsp+.keep], rax
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.consumed]
+    dcall   cut_region
+
+    ; Give up if the output is broken.
+    mov     rax, [rsp+.state]
+    cmp     qword [rax+CutState.error], 0
+    jne     .success
+
+    ; Move the partial line to the start of the buffer.
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, rdi
+    add     rsi, [rsp+.consumed]
+    mov     rdx, [rsp+.keep]
+    dcall   memmove
+
+    jmp     .read_again
+
+.no_complete_line:
+    mov     rax, [rsp+.keep]
+    cmp     rax, [rsp+.size]
+    jne     .read_again
+
+    ; The buffer is full of a single line, so make it bigger.
+    mov     rdi, [rsp+.size]
+    shl     rdi, 1
+    add     rdi, CUT_SLACK
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .free_buffer
+
+    mov     [rsp+.bigger], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.keep]
+    dcall   memcpy
+
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, [rsp+.size]
+    add     rsi, CUT_SLACK
+    dcall   arena_free
+
+    mov     rax, [rsp+.bigger]
+    mov     [rsp+.buffer], rax
+    shl     qword [rsp+.size], 1
+    jmp     .read_again
+
+.eof:
+    ; Terminate and cut any final unterminated line (there is always
+    ; space in the slack).
+    mov     rdx, [rsp+.keep]
+    cmp     rdx, 0
+    je      .success
+
+    mov     rsi, [rsp+.buffer]
+    mov     byte [rsi+rdx], 0x0a ; '\n'
+    inc     rdx
+
+    mov     rdi, [rsp+.state]
+    dcall   cut_region
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.free_buffer:
+    ; Let the next file reuse the buffer.
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, [rsp+.size]
+    add     rsi, CUT_SLACK
+    dcall   arena_free
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 8
+    ret
+
+;---------------------------------------------------------------------
+; Description: Cut a block of complete lines.
+;
+; C prototype equivalent:
+;
+;     void cut_region(CutState *state, const char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (address) - start of first line.
+; - Input: RDX (integer) - number of bytes (the last of which must be
+;   a newline).
+; - Output: None.
+;
+; Notes:
+;
+; CUT_SLACK bytes after the end of the block must be readable.
+;---------------------------------------------------------------------
+
+cut_region:
+    prologue_with_vars 0
+
+    test    qword [rdi+CutState.flags], CUT_FIELDS
+    jz      .bytes
+
+    dcall   cut_fields
+    jmp     .out
+
+.bytes:
+    dcall   cut_bytes
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the selected fields of a block of complete lines.
+;
+; C prototype equivalent:
+;
+;     void cut_fields(CutState *state, const char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (address) - start of first line.
+; - Input: RDX (integer) - number of bytes (the last of which must be
+;   a newline).
+; - Output: None.
+;
+; Notes:
+;
+; - Each 64 byte block is compared against the delimiter and newline
+;   vectors to give a 64-bit mask of each, with one bit per byte. The
+;   boundaries are then visited in order by finding the lowest set bit
+;   (tzcnt) and clearing it ("x & (x - 1)", as blsr does).
+;
+; - Once the last selected field of a line has been written, the
+;   delimiters are masked off so the rest of the line is skipped by
+;   going straight to the next newline.
+;
+; - A selected run is written by copying 16 bytes at a time (which may
+;   copy up to 15 bytes too many into the output slack).
+;
+; - The state of the current line is kept in local variables, so each
+;   call must start at the beginning of a line.
+;
+; - tzcnt executes as bsf on CPUs without BMI1, which gives the same
+;   result since the mask is never zero.
+;---------------------------------------------------------------------
+
+cut_fields:
+    prologue_with_vars 12
+
+    ;--------------------
+    ; Stack offsets.
+
+    .field          equ      0  ; size_t: number of current field.
+    .range          equ      8  ; "CutRange *": next range to select.
+    .field_start    equ     16  ; "char *": start of current field.
+    .run_start      equ     24  ; "char *": start of selected run (or 0).
+    .delimited      equ     32  ; bool: line contains a delimiter.
+    .separate       equ     40  ; size_t: 1 if the next run needs a
+                                ; leading delimiter, else 0.
+    .delims         equ     48  ; uint64_t: delimiters in current block.
+    .save_r8        equ     56  ; uint64_t: saved across calls.
+    .save_r9        equ     64  ; uint64_t: saved across calls.
+    .save_r10       equ     72  ; "char *": saved across calls.
+    .save_r11       equ     80  ; "char *": saved across calls.
+    .save_rsi       equ     88  ; "char *": saved across calls.
+
+    ;--------------------
+    ; Register usage:
+    ;
+    ; - RBX: CutState.
+    ; - RDI: output position.
+    ; - RSI: current boundary (delimiter or newline).
+    ; - R8: boundaries not yet handled in the current block.
+    ; - R9: newlines in the current block.
+    ; - R10: start of the current block.
+    ; - R11: end of the data.
+
+    mov     rbx, rdi
+    mov     r10, rsi
+    lea     r11, [rsi+rdx]
+    mov     rdi, [rbx+CutState.out_pos]
+
+    mov     qword [rsp+.field], 1
+    mov     rax, [rbx+CutState.ranges]
+    mov     [rsp+.range], rax
+    mov     [rsp+.field_start], rsi
+    mov     qword [rsp+.run_start], 0
+    mov     qword [rsp+.delimited], 0
+    mov     qword [rsp+.separate], 0
+
+.next_block:
+    cmp     r10, r11
+    jae     .out
+
+    movdqu  xmm6, [rbx+CutState.delim_vec]
+    movdqu  xmm7, [rbx+CutState.nl_vec]
+
+    movdqu  xmm0, [r10]
+    movdqu  xmm1, [r10+16]
+    movdqu  xmm2, [r10+32]
+    movdqu  xmm3, [r10+48]
+
+    ; Delimiter mask in RAX.
+    movdqa  xmm4, xmm0
+    pcmpeqb xmm4, xmm6
+    pmovmskb eax, xmm4
+
+    movdqa  xmm5, xmm1
+    pcmpeqb xmm5, xmm6
+    pmovmskb ecx, xmm5
+    shl     ecx, 16
+    or      eax, ecx
+
+    movdqa  xmm4, xmm2
+    pcmpeqb xmm4, xmm6
+    pmovmskb ecx, xmm4
+    shl     rcx, 32
+    or      rax, rcx
+
+    movdqa  xmm5, xmm3
+    pcmpeqb xmm5, xmm6
+    pmovmskb ecx, xmm5
+    shl     rcx, 48
+    or      rax, rcx
+
+    ; Newline mask in R9.
+    pcmpeqb xmm0, xmm7
+    pmovmskb r9d, xmm0
+
+    pcmpeqb xmm1, xmm7
+    pmovmskb ecx, xmm1
+    shl     ecx, 16
+    or      r9d, ecx
+
+    pcmpeqb xmm2, xmm7
+    pmovmskb ecx, xmm2
+    shl     rcx, 32
+    or      r9, rcx
+
+    pcmpeqb xmm3, xmm7
+    pmovmskb ecx, xmm3
+    shl     rcx, 48
+    or      r9, rcx
+
+    ; Ignore anything after the end of the data.
+    mov     rcx, r11
+    sub     rcx, r10
+    cmp     rcx, 64
+    jae     .whole_block
+
+    mov     rdx, 1
+    shl     rdx, cl
+    dec     rdx
+    and     rax, rdx
+    and     r9, rdx
+
+.whole_block:
+    mov     [rsp+.delims], rax
+    mov     r8, r9
+
+    ; Only look for delimiters if more fields are selected.
+    mov     rdx, [rsp+.range]
+    cmp     rdx, [rbx+CutState.ranges_end]
+    je      .next_boundary
+
+    or      r8, rax
+
+.next_boundary:
+    test    r8, r8
+    jz      .block_done
+
+    tzcnt   rcx, r8
+    lea     rax, [r8-1]
+    and     r8, rax
+
+    lea     rsi, [r10+rcx]
+    bt      r9, rcx
+    jc      .newline
+
+    ;--------------------
+    ; End of a field.
+
+    mov     qword [rsp+.delimited], 1
+
+    mov     rax, [rsp+.field]
+    mov     rdx, [rsp+.range]
+    cmp     rax, [rdx+CutRange.start]
+    jb      .next_field
+
+    cmp     qword [rsp+.run_start], 0
+    jne     .check_range_end
+
+    mov     rcx, [rsp+.field_start]
+    mov     [rsp+.run_start], rcx
+
+.check_range_end:
+    cmp     rax, [rdx+CutRange.end]
+    jae     .emit
+
+.next_field:
+    inc     qword [rsp+.field]
+    lea     rax, [rsi+1]
+    mov     [rsp+.field_start], rax
+    jmp     .next_boundary
+
+.next_range:
+    mov     rdx, [rsp+.range]
+    add     rdx, CutRange_size
+    mov     [rsp+.range], rdx
+    cmp     rdx, [rbx+CutState.ranges_end]
+    jne     .next_field
+
+    ; No more fields are selected, so skip to the end of the line.
+    and     r8, r9
+    jmp     .next_field
+
+    ;--------------------
+    ; End of a line.
+
+.newline:
+    cmp     qword [rsp+.delimited], 0
+    jne     .delimited_line
+
+    ; The whole line is a single field, which is shown whatever is
+    ; selected (unless only delimited lines are wanted).
+    test    qword [rbx+CutState.flags], CUT_ONLY_DELIMITED
+    jnz     .reset_line
+
+    jmp     .emit_field
+
+.delimited_line:
+    mov     rdx, [rsp+.range]
+    cmp     rdx, [rbx+CutState.ranges_end]
+    je      .end_line
+
+    mov     rax, [rsp+.field]
+    cmp     rax, [rdx+CutRange.start]
+    jb      .end_line
+
+.emit_field:
+    cmp     qword [rsp+.run_start], 0
+    jne     .emit
+
+    mov     rax, [rsp+.field_start]
+    mov     [rsp+.run_start], rax
+
+    ;--------------------
+    ; Write the run ending at RSI.
+
+.emit:
+    mov     rax, [rsp+.run_start]
+    mov     rcx, rsi
+    sub     rcx, rax
+
+    ; Separate this run from the previous one.
+    movzx   edx, byte [rbx+CutState.delim]
+    mov     [rdi], dl
+    add     rdi, [rsp+.separate]
+    mov     qword [rsp+.separate], 1
+
+    lea     rdx, [rdi+rcx]
+    cmp     rdx, [rbx+CutState.out_limit]
+    ja      .emit_slow
+
+    xor     edx, edx
+
+.copy:
+    movdqu  xmm0, [rax+rdx]
+    movdqu  [rdi+rdx], xmm0
+    add     rdx, 16
+    cmp     rdx, rcx
+    jb      .copy
+
+    add     rdi, rcx
+
+.emitted:
+    mov     qword [rsp+.run_start], 0
+
+    cmp     byte [rsi], 0x0a ; '\n'
+    jne     .next_range
+
+.end_line:
+    mov     byte [rdi], 0x0a ; '\n'
+    inc     rdi
+
+    cmp     rdi, [rbx+CutState.out_limit]
+    ja      .flush_line
+
+.reset_line:
+    mov     qword [rsp+.field], 1
+    mov     rax, [rbx+CutState.ranges]
+    mov     [rsp+.range], rax
+    lea     rax, [rsi+1]
+    mov     [rsp+.field_start], rax
+    mov     qword [rsp+.run_start], 0
+    mov     qword [rsp+.delimited], 0
+    mov     qword [rsp+.separate], 0
+
+    ; Look for the delimiters after the newline again (in case they
+    ; were being skipped).
+    mov     rcx, rsi
+    sub     rcx, r10
+    mov     rdx, -2
+    shl     rdx, cl
+    and     rdx, [rsp+.delims]
+    or      r8, rdx
+    jmp     .next_boundary
+
+.block_done:
+    add     r10, 64
+    jmp     .next_block
+
+.out:
+    mov     [rbx+CutState.out_pos], rdi
+
+    epilogue_with_vars 12
+    ret
+
+    ;--------------------
+    ; The run doesn't fit in the output buffer.
+
+.emit_slow:
+    mov     [rsp+.save_r8], r8
+    mov     [rsp+.save_r9], r9
+    mov     [rsp+.save_r10], r10
+    mov     [rsp+.save_r11], r11
+    mov     [rsp+.save_rsi], rsi
+
+    mov     rdx, rax
+    mov     rsi, rdi
+    mov     rdi, rbx
+    dcall   cut_write
+
+    mov     r8, [rsp+.save_r8]
+    mov     r9, [rsp+.save_r9]
+    mov     r10, [rsp+.save_r10]
+    mov     r11, [rsp+.save_r11]
+    mov     rsi, [rsp+.save_rsi]
+
+    mov     rdi, rax
+    jmp     .emitted
+
+.flush_line:
+    mov     [rsp+.save_r8], r8
+    mov     [rsp+.save_r9], r9
+    mov     [rsp+.save_r10], r10
+    mov     [rsp+.save_r11], r11
+    mov     [rsp+.save_rsi], rsi
+
+    mov     rsi, rdi
+    mov     rdi, rbx
+    dcall   cut_flush
+
+    mov     r8, [rsp+.save_r8]
+    mov     r9, [rsp+.save_r9]
+    mov     r10, [rsp+.save_r10]
+    mov     r11, [rsp+.save_r11]
+    mov     rsi, [rsp+.save_rsi]
+
+    mov     rdi, [rbx+CutState.out_buf]
+    jmp     .reset_line
+
+;---------------------------------------------------------------------
+; Description: Write the selected bytes of a block of complete lines.
+;
+; C prototype equivalent:
+;
+;     void cut_bytes(CutState *state, const char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (address) - start of first line.
+; - Input: RDX (integer) - number of bytes (the last of which must be
+;   a newline).
+; - Output: None.
+;
+; Notes:
+;
+; The newlines are found 64 bytes at a time as in cut_fields() and
+; each range is written as a single run.
+;---------------------------------------------------------------------
+
+cut_bytes:
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .line_start     equ      0  ; "char *": start of current line.
+    .line_len       equ      8  ; size_t: length of current line.
+    .save_r8        equ     16  ; uint64_t: saved across calls.
+    .save_r9        equ     24  ; "CutRange *": saved across calls.
+    .save_r10       equ     32  ; "char *": saved across calls.
+    .save_r11       equ     40  ; "char *": saved across calls.
+    .save_rsi       equ     48  ; "char *": saved across calls.
+    .unused         equ     56  ; padding.
+
+    ;--------------------
+    ; Register usage:
+    ;
+    ; - RBX: CutState.
+    ; - RDI: output position.
+    ; - RSI: current newline.
+    ; - R8: newlines not yet handled in the current block.
+    ; - R9: next range to select.
+    ; - R10: start of the current block.
+    ; - R11: end of the data.
+
+    mov     rbx, rdi
+    mov     r10, rsi
+    lea     r11, [rsi+rdx]
+    mov     rdi, [rbx+CutState.out_pos]
+
+    mov     [rsp+.line_start], rsi
+
+.next_block:
+    cmp     r10, r11
+    jae     .out
+
+    movdqu  xmm7, [rbx+CutState.nl_vec]
+
+    movdqu  xmm0, [r10]
+    movdqu  xmm1, [r10+16]
+    movdqu  xmm2, [r10+32]
+    movdqu  xmm3, [r10+48]
+
+    pcmpeqb xmm0, xmm7
+    pmovmskb r8d, xmm0
+
+    pcmpeqb xmm1, xmm7
+    pmovmskb ecx, xmm1
+    shl     ecx, 16
+    or      r8d, ecx
+
+    pcmpeqb xmm2, xmm7
+    pmovmskb ecx, xmm2
+    shl     rcx, 32
+    or      r8, rcx
+
+    pcmpeqb xmm3, xmm7
+    pmovmskb ecx, xmm3
+    shl     rcx, 48
+    or      r8, rcx
+
+    ; Ignore anything after the end of the data.
+    mov     rcx, r11
+    sub     rcx, r10
+    cmp     rcx, 64
+    jae     .next_newline
+
+    mov     rdx, 1
+    shl     rdx, cl
+    dec     rdx
+    and     r8, rdx
+
+.next_newline:
+    test    r8, r8
+    jz      .block_done
+
+    tzcnt   rcx, r8
+    lea     rax, [r8-1]
+    and     r8, rax
+
+    lea     rsi, [r10+rcx]
+    mov     rax, rsi
+    sub     rax, [rsp+.line_start]
+    mov     [rsp+.line_len], rax
+
+    mov     r9, [rbx+CutState.ranges]
+
+.next_range:
+    cmp     r9, [rbx+CutState.ranges_end]
+    je      .end_line
+
+    ; Offset of the first byte.
+    mov     rax, [r9+CutRange.start]
+    dec     rax
+    cmp     rax, [rsp+.line_len]
+    jae     .end_line
+
+    ; Offset after the last byte.
+    mov     rcx, [r9+CutRange.end]
+    cmp     rcx, [rsp+.line_len]
+    jbe     .got_end
+
+    mov     rcx, [rsp+.line_len]
+
+.got_end:
+    sub     rcx, rax
+    add     rax, [rsp+.line_start]
+
+    lea     rdx, [rdi+rcx]
+    cmp     rdx, [rbx+CutState.out_limit]
+    ja      .emit_slow
+
+    xor     edx, edx
+
+.copy:
+    movdqu  xmm0, [rax+rdx]
+    movdqu  [rdi+rdx], xmm0
+    add     rdx, 16
+    cmp     rdx, rcx
+    jb      .copy
+
+    add     rdi, rcx
+
+.emitted:
+    add     r9, CutRange_size
+    jmp     .next_range
+
+.end_line:
+    mov     byte [rdi], 0x0a ; '\n'
+    inc     rdi
+
+    cmp     rdi, [rbx+CutState.out_limit]
+    ja      .flush_line
+
+.reset_line:
+    lea     rax, [rsi+1]
+    mov     [rsp+.line_start], rax
+    jmp     .next_newline
+
+.block_done:
+    add     r10, 64
+    jmp     .next_block
+
+.out:
+    mov     [rbx+CutState.out_pos], rdi
+
+    epilogue_with_vars 8
+    ret
+
+    ;--------------------
+    ; The run doesn't fit in the output buffer.
+
+.emit_slow:
+    mov     [rsp+.save_r8], r8
+    mov     [rsp+.save_r9], r9
+    mov     [rsp+.save_r10], r10
+    mov     [rsp+.save_r11], r11
+    mov     [rsp+.save_rsi], rsi
+
+    mov     rdx, rax
+    mov     rsi, rdi
+    mov     rdi, rbx
+    dcall   cut_write
+
+    mov     r8, [rsp+.save_r8]
+    mov     r9, [rsp+.save_r9]
+    mov     r10, [rsp+.save_r10]
+    mov     r11, [rsp+.save_r11]
+    mov     rsi, [rsp+.save_rsi]
+
+    mov     rdi, rax
+    jmp     .emitted
+
+.flush_line:
+    mov     [rsp+.save_r8], r8
+    mov     [rsp+.save_r10], r10
+    mov     [rsp+.save_r11], r11
+    mov     [rsp+.save_rsi], rsi
+
+    mov     rsi, rdi
+    mov     rdi, rbx
+    dcall   cut_flush
+
+    mov     r8, [rsp+.save_r8]
+    mov     r10, [rsp+.save_r10]
+    mov     r11, [rsp+.save_r11]
+    mov     rsi, [rsp+.save_rsi]
+
+    mov     rdi, [rbx+CutState.out_buf]
+    jmp     .reset_line
+
+;---------------------------------------------------------------------
+; Description: Add data to the output buffer, flushing it first if the
+;   data does not fit.
+;
+; C prototype equivalent:
+;
+;     char *cut_write(CutState *state, char *pos, const void *data,
+;                     size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (address) - output position (end of buffered data).
+; - Input: RDX (address) - data.
+; - Input: RCX (integer) - number of bytes of data.
+; - Output: RAX (address) - new output position.
+;
+; Notes:
+;
+; Data that is larger than the output buffer is written directly.
+;---------------------------------------------------------------------
+
+cut_write:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "CutState *"
+    .data       equ     8   ; "void *"
+    .len        equ    16   ; size_t.
+    .unused     equ    24   ; padding.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.data], rdx
+    mov     [rsp+.len], rcx
+
+    ;--------------------
+
+    dcall   cut_flush
+
+    mov     rax, [rsp+.state]
+    cmp     qword [rsp+.len], CUT_OUT_BUF_SIZE
+    jbe     .copy
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    dcall   write_block
+
+    mov     rdi, [rsp+.state]
+
+    cmp     rax, 0
+    jge     .written
+
+    mov     qword [rdi+CutState.error], 1
+
+.written:
+    mov     rax, [rdi+CutState.out_buf]
+    jmp     .out
+
+.copy:
+    mov     rdi, [rax+CutState.out_buf]
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    dcall   memcpy
+
+    add     rax, [rsp+.len]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the contents of the output buffer.
+;
+; C prototype equivalent:
+;
+;     void cut_flush(CutState *state, char *pos);
+;
+; Parameters:
+;
+; - Input: RDI (address) - CutState.
+; - Input: RSI (address) - output position (end of buffered data).
+; - Output: None.
+;---------------------------------------------------------------------
+
+cut_flush:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "CutState *"
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+
+    mov     rdx, rsi
+    mov     rsi, [rdi+CutState.out_buf]
+    mov     [rdi+CutState.out_pos], rsi
+    sub     rdx, rsi
+    cmp     rdx, 0
+    je      .out
+
+    mov     rdi, STDOUT_FD
+    dcall   write_block
+
+    cmp     rax, 0
+    jge     .out
+
+    mov     rdi, [rsp+.state]
+    mov     qword [rdi+CutState.error], 1
+
+.out:
+    epilogue_with_vars 1
+    ret
@@ -0,0 +1,543 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_du
+global command_du
+
+extern asm_getopt
+extern inode_set_add
+extern inode_set_free
+extern inode_set_new
+extern walk_statx
+extern walk_tree
+
+extern dprintf
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_du:  db  "see du(1)",10, \
+                      10, \
+                      "Options:",10, \
+                      10, \
+                      "-h : Display sizes in human readable form (such as 1.5K, 20M).",10, \
+                      "-s : Only display a total for each argument (required).",0
+
+%include "walk.inc"
+
+; Option flags (bitmask).
+%assign DU_HUMAN                (1 << 0)
+%assign DU_SUMMARY              (1 << 1)
+
+; Fields needed from statx(2).
+%assign DU_STATX_MASK           (STATX_BLOCKS|STATX_NLINK|STATX_INO)
+
+; Size of the unit st_blocks is measured in.
+%assign DU_BLOCK_SIZE           512
+
+;---------------------------------------------------------------------
+; State shared by the walk threads.
+;---------------------------------------------------------------------
+struc DuState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .inodes     resq    1 ; "InodeSet *": hard linked files already counted.
+    .error      resq    1 ; bool: true if an entry could not be checked.
+    .found      resq    1 ; bool: true once the starting path is visited.
+
+    ; Bytes counted by each walk thread. Each total is on its own cache
+    ; line, since every thread updates its total for every entry.
+    .totals     resb    (CACHE_LINE_SIZE * WALK_MAX_THREADS)
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `du` command.
+;
+; C prototype equivalent:
+;
+;     int command_du(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, -1 on error.
+;
+; Notes:
+;
+; - Each tree is read by multiple threads (see walk_tree()). Only the
+;   fields needed (blocks, link count and inode number) are requested
+;   from statx(2).
+;
+; - Files with multiple hard links are only counted once (across all
+;   the arguments), using a set of (device, inode) pairs shared by all
+;   the threads.
+;
+; - Sizes are displayed in KiB (rounded up).
+;
+; Limitations:
+;
+; - Only the total for each argument can be displayed, so -s must be
+;   specified (rather than silently ignoring the sizes of the
+;   directories below each argument).
+; - Symbolic links are never followed and file systems are always
+;   crossed.
+;
+; See: du(1).
+;---------------------------------------------------------------------
+
+command_du:
+section .rodata
+    .optstring          db  "hs",0
+    .human_opt          equ 'h'
+    .summary_opt        equ 's'
+
+    .default_path       db  ".",0
+    .cmd_name           db  "du",0
+
+    .alloc_fmt          db  "du: out of memory",10,0
+    .summary_fmt        db  "du: only summaries are supported (specify -s)",10,0
+section .text
+    prologue_with_vars 6
+
+    alloc_space (Walk_size + DuState_size)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .file_idx       equ     16  ; size_t: index into argv of next path.
+    .flags          equ     24  ; size_t: DU_* bitmask.
+    .ret            equ     32  ; int: return value.
+    .path           equ     40  ; "char *": current path.
+    .walk           equ     48  ; Walk.
+    .state          equ     (.walk + Walk_size) ; DuState.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.flags], 0
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .human_opt
+    je      .handle_human_opt
+
+    cmp     al, .summary_opt
+    je      .handle_summary_opt
+
+    jmp     .error_bad_option
+
+.handle_human_opt:
+    or      qword [rsp+.flags], DU_HUMAN
+    jmp     .next_arg
+
+.handle_summary_opt:
+    or      qword [rsp+.flags], DU_SUMMARY
+    jmp     .next_arg
+
+.options_parsed:
+    test    qword [rsp+.flags], DU_SUMMARY
+    jz      .error_summary
+
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.file_idx], rax
+
+    ;--------------------
+    ; Set up the walk.
+
+    dcall   inode_set_new
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.state+DuState.inodes], rax
+    mov     qword [rsp+.state+DuState.error], 0
+
+    mov     qword [rsp+.walk+Walk.visit], du_visit
+    lea     rax, [rsp+.state]
+    mov     [rsp+.walk+Walk.data], rax
+    mov     qword [rsp+.walk+Walk.cmd], .cmd_name
+
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    jne     .next_path
+
+    ; No paths, so use the current directory.
+    mov     rdi, .default_path
+    jmp     .handle_path
+
+.next_path:
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    jae     .done
+
+    mov     rcx, [rsp+.argv]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+
+.handle_path:
+    mov     [rsp+.path], rdi
+
+    ; Clear the totals.
+    lea     rdi, [rsp+.state+DuState.totals]
+    xor     rax, rax
+    mov     rcx, ((CACHE_LINE_SIZE * WALK_MAX_THREADS) / 8)
+    rep     stosq
+
+    mov     qword [rsp+.state+DuState.found], 0
+
+    lea     rdi, [rsp+.walk]
+    mov     rsi, [rsp+.path]
+    dcall   walk_tree
+    cmp     rax, 0
+    je      .walked
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.walked:
+    ; Nothing to display if the path itself could not be accessed.
+    cmp     qword [rsp+.state+DuState.found], 0
+    je      .path_done
+
+    ;--------------------
+    ; Add up the totals of all the threads.
+
+    xor     rax, rax
+    xor     rcx, rcx
+
+.add_total:
+    add     rax, [rsp+.state+DuState.totals+rcx]
+    add     rcx, CACHE_LINE_SIZE
+    cmp     rcx, (CACHE_LINE_SIZE * WALK_MAX_THREADS)
+    jb      .add_total
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.path]
+    mov     rdx, [rsp+.flags]
+    dcall   du_show
+
+.path_done:
+    inc     qword [rsp+.file_idx]
+    jmp     .next_path
+
+.done:
+    cmp     qword [rsp+.state+DuState.error], 0
+    je      .cleanup
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.cleanup:
+    mov     rdi, [rsp+.state+DuState.inodes]
+    dcall   inode_set_free
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (Walk_size + DuState_size)
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_summary:
+    mov     rsi, .summary_fmt
+    jmp     .error_msg
+
+.error_alloc:
+    mov     rsi, .alloc_fmt
+
+.error_msg:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Walk visit function that adds the size of an entry to
+;   the total of the calling thread.
+;
+; C prototype equivalent:
+;
+;     int du_visit(WalkEntry *entry, DuState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkEntry.
+; - Input: RSI (address) - DuState.
+; - Output: RAX (integer) - WALK_CONTINUE.
+;---------------------------------------------------------------------
+
+du_visit:
+section .rodata
+    .stat_fmt       db  "du: cannot access '%s'",10,0
+    .alloc_fmt      db  "du: out of memory",10,0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .entry      equ     0   ; "WalkEntry *"
+    .state      equ     8   ; "DuState *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.entry], rdi
+    mov     [rsp+.state], rsi
+
+    ;--------------------
+
+    mov     rsi, DU_STATX_MASK
+    dcall   walk_statx
+    cmp     rax, 0
+    jne     .error_stat
+
+    mov     rbx, [rsp+.entry]
+
+    cmp     qword [rbx+WalkEntry.depth], 0
+    jne     .check_links
+
+    mov     rax, [rsp+.state]
+    mov     qword [rax+DuState.found], 1
+
+.check_links:
+    ;--------------------
+    ; Only count files with multiple links the first time they are
+    ; seen.
+
+    cmp     qword [rbx+WalkEntry.type], DT_DIR
+    je      .count
+
+    cmp     dword [rbx+WalkEntry.stx+Statx.stx_nlink], 1
+    jbe     .count
+
+    ; dev = (major << 32) | minor
+    mov     esi, [rbx+WalkEntry.stx+Statx.stx_dev_major]
+    shl     rsi, 32
+    mov     eax, [rbx+WalkEntry.stx+Statx.stx_dev_minor]
+    or      rsi, rax
+
+    mov     rdi, [rsp+.state]
+    mov     rdi, [rdi+DuState.inodes]
+    mov     rdx, [rbx+WalkEntry.stx+Statx.stx_ino]
+    dcall   inode_set_add
+    cmp     rax, 0
+    je      .out ; Already counted.
+    jl      .error_alloc
+
+.count:
+    ; totals[worker] += blocks * DU_BLOCK_SIZE
+    mov     rax, [rbx+WalkEntry.stx+Statx.stx_blocks]
+    imul    rax, rax, DU_BLOCK_SIZE
+
+    mov     rcx, [rbx+WalkEntry.worker]
+    imul    rcx, rcx, CACHE_LINE_SIZE
+    add     rcx, [rsp+.state]
+    add     [rcx+DuState.totals], rax
+
+.out:
+    mov     rax, WALK_CONTINUE
+
+    epilogue_with_vars 2
+    ret
+
+.error_stat:
+    mov     rdi, STDERR_FD
+    mov     rsi, .stat_fmt
+    mov     rax, [rsp+.entry]
+    mov     rdx, [rax+WalkEntry.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, [rsp+.state]
+    mov     qword [rax+DuState.error], 1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the size of a path.
+;
+; C prototype equivalent:
+;
+;     void du_show(uint64_t bytes, const char *path, size_t flags);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - size in bytes.
+; - Input: RSI (string) - path.
+; - Input: RDX (integer) - DU_* bitmask.
+; - Output: None.
+;
+; Notes:
+;
+; As for GNU du(1), sizes are always rounded up. Human readable sizes
+; below 10 are displayed with one decimal place.
+;---------------------------------------------------------------------
+
+du_show:
+section .rodata
+    .size_fmt       db  "%lu",9,"%s",10,0
+    .decimal_fmt    db  "%lu.%lu%c",9,"%s",10,0
+    .whole_fmt      db  "%lu%c",9,"%s",10,0
+    .suffixes       db  "KMGTPE"
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .bytes      equ     0   ; uint64_t
+    .path       equ     8   ; "char *"
+    .unit       equ    16   ; size_t: index into .suffixes.
+    .divisor    equ    24   ; uint64_t: bytes in unit.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.bytes], rdi
+    mov     [rsp+.path], rsi
+
+    ;--------------------
+
+    test    rdx, DU_HUMAN
+    jnz     .human
+
+    ; KiB, rounded up.
+    mov     rdx, rdi
+    add     rdx, 1023
+    shr     rdx, 10
+
+    mov     rsi, .size_fmt
+    mov     rcx, [rsp+.path]
+    jmp     .print
+
+.human:
+    cmp     rdi, 1024
+    jae     .scale
+
+    mov     rdx, rdi
+    mov     rsi, .size_fmt
+    mov     rcx, [rsp+.path]
+    jmp     .print
+
+.scale:
+    mov     qword [rsp+.unit], 0
+    mov     qword [rsp+.divisor], 1024
+
+.try_unit:
+    ; tenths = ceil((bytes * 10) / divisor)
+    mov     rax, [rsp+.bytes]
+    mov     rcx, 10
+    mul     rcx
+    mov     rcx, [rsp+.divisor]
+    add     rax, rcx
+    adc     rdx, 0
+    sub     rax, 1
+    sbb     rdx, 0
+    div     rcx
+
+    cmp     rax, 100
+    jae     .whole
+
+    ; x.y
+    xor     rdx, rdx
+    mov     rcx, 10
+    div     rcx
+
+    mov     rcx, rdx ; Tenths.
+    mov     rdx, rax ; Whole units.
+    mov     rax, [rsp+.unit]
+    movzx   r8d, byte [.suffixes+rax]
+    mov     r9, [rsp+.path]
+    mov     rsi, .decimal_fmt
+    jmp     .print
+
+.whole:
+    ; units = ceil(bytes / divisor)
+    mov     rax, [rsp+.bytes]
+    mov     rcx, [rsp+.divisor]
+    xor     rdx, rdx
+    div     rcx
+    cmp     rdx, 0
+    je      .check_unit
+
+    inc     rax
+
+.check_unit:
+    cmp     rax, 1024
+    jb      .show_whole
+
+    ; Too big for this unit (there is always a bigger unit since
+    ; 2^64 bytes is 16 exbibytes).
+    inc     qword [rsp+.unit]
+    shl     qword [rsp+.divisor], 10
+    jmp     .try_unit
+
+.show_whole:
+    mov     rdx, rax
+    mov     rax, [rsp+.unit]
+    movzx   ecx, byte [.suffixes+rax]
+    mov     r8, [rsp+.path]
+    mov     rsi, .whole_fmt
+
+.print:
+    mov     rdi, STDOUT_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    epilogue_with_vars 4
+    ret
@@ -9,7 +9,6 @@
 global command_help_echo
 global command_echo
 
-extern free
 extern write
 
 extern alloc_args_buffer
@@ -18,7 +17,7 @@ extern print_nl
 
 %include "header.inc"
 
-section .rodata
+cold_rodata
 command_help_echo:  db  "see echo(1)",0
 
 section .text
@@ -75,9 +74,6 @@ command_echo:
     mov     rdx, [rsp+.bytes]
     dcall    write
 
-    mov     rdi, [rsp+.buf]
-    dcall   free
-
     mov     rax, CMD_OK
     jmp     .done
 
@@ -12,11 +12,11 @@ global command_env
 extern abox_environ
 extern puts
 
-section .rodata
-command_help_env:  db  "see env(1)",0
-
 %include "header.inc"
 
+cold_rodata
+command_help_env:  db  "see env(1)",0
+
 section .text
 
 ;---------------------------------------------------------------------
@@ -7,13 +7,18 @@
 ;---------------------------------------------------------------------
 
 global command_false
+global command_flags_false
 global command_help_false
 
 %include "header.inc"
 
 extern exit
 
-section .rodata
+; command_false never returns, so other commands must not run it
+; in-process.
+command_flags_false equ CMD_FLAG_EXITS
+
+cold_rodata
 command_help_false:  db  "see false(1)",0
 
 section .text
@@ -0,0 +1,998 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_find
+global command_find
+
+extern walk_statx
+extern walk_tree
+extern write_block
+
+extern calloc
+extern dprintf
+extern fnmatch
+extern free
+extern malloc
+extern memcpy
+extern pthread_mutex_destroy
+extern pthread_mutex_init
+extern pthread_mutex_lock
+extern pthread_mutex_unlock
+extern strcmp
+extern strlen
+
+%include "header.inc"
+
+cold_rodata
+command_help_find:  db  "see find(1)",10, \
+                        10, \
+                        "Usage: find [PATH...] [EXPRESSION]",10, \
+                        10, \
+                        "Expression (all tests must match):",10, \
+                        10, \
+                        "-name PATTERN     : Base name matches shell glob PATTERN.",10, \
+                        "-type [bcdflps]   : File is of the specified type.",10, \
+                        "-size [+-]N[cwbkMG] : File uses (more than, less than) N units.",10, \
+                        "-print            : Display path followed by a newline (default).",10, \
+                        "-print0           : Display path followed by a nul byte.",10, \
+                        10, \
+                        "Note: paths are displayed in no particular order.",0
+
+%include "walk.inc"
+
+; Types of FindTest.
+%assign FIND_NAME               1
+%assign FIND_TYPE               2
+%assign FIND_SIZE               3
+%assign FIND_PRINT              4
+%assign FIND_PRINT0             5
+
+; Maximum number of primaries in an expression.
+%assign FIND_MAX_TESTS          64
+
+; Size of the output buffer of each walk thread.
+%assign FIND_BUF_SIZE           (64 * 1024)
+
+; Default unit for -size.
+%assign FIND_SIZE_UNIT          512
+
+;---------------------------------------------------------------------
+; A primary of the expression.
+;---------------------------------------------------------------------
+struc FindTest
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .type       resq    1 ; FIND_* value.
+    .arg        resq    1 ; "char *": pattern (FIND_NAME).
+    .value      resq    1 ; DT_* (FIND_TYPE), units (FIND_SIZE) or
+                          ; terminating byte (FIND_PRINT*).
+    .unit       resq    1 ; size_t: bytes in unit (FIND_SIZE).
+    .cmp        resq    1 ; int: -1 (less than), 0 (equal) or
+                          ; 1 (greater than) (FIND_SIZE).
+endstruc
+
+;---------------------------------------------------------------------
+; Output buffer of a walk thread (one per cache line).
+;---------------------------------------------------------------------
+struc FindBuf
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .data       resq    1 ; "char *": FIND_BUF_SIZE bytes (allocated
+                          ; when first used).
+    .len        resq    1 ; size_t: bytes used.
+    .pad        resb    (CACHE_LINE_SIZE - 16)
+endstruc
+
+;---------------------------------------------------------------------
+; State shared by the walk threads.
+;---------------------------------------------------------------------
+struc FindState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .ntests     resq    1 ; size_t: number of entries in .tests.
+    .error      resq    1 ; bool: true if an entry could not be checked.
+    .lock       resb    PTHREAD_MUTEX_T_SIZE ; Serialises output.
+    .tests      resb    (FindTest_size * FIND_MAX_TESTS)
+    .bufs       resb    (FindBuf_size * WALK_MAX_THREADS)
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement a basic `find` command.
+;
+; C prototype equivalent:
+;
+;     int command_find(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, -1 on error.
+;
+; Notes:
+;
+; - Each tree is read by multiple threads (see walk_tree()), so paths
+;   are displayed in no particular order (pipe to sort(1) if the
+;   order matters).
+;
+; - Entry types come from the directory itself so only -size
+;   requires a statx(2) call, and only for entries that pass any
+;   tests before it.
+;
+; - Each thread buffers its output, which is written in blocks of
+;   whole paths.
+;
+; Limitations:
+;
+; - The expression is a list of primaries that must all be true:
+;   there is no support for operators ('-o', '!', parentheses).
+; - Symbolic links are never followed.
+;
+; See: find(1).
+;---------------------------------------------------------------------
+
+command_find:
+section .rodata
+    .default_path       db  ".",0
+    .cmd_name           db  "find",0
+
+    .name_primary       db  "-name",0
+    .type_primary       db  "-type",0
+    .size_primary       db  "-size",0
+    .print_primary      db  "-print",0
+    .print0_primary     db  "-print0",0
+
+    .type_chars         db  "bcdflps"
+    .type_count         equ ($ - .type_chars)
+    .type_values        db  DT_BLK, DT_CHR, DT_DIR, DT_FIFO, DT_REG, DT_LNK, DT_SOCK
+
+    .alloc_fmt          db  "find: out of memory",10,0
+    .missing_fmt        db  "find: missing argument to '%s'",10,0
+    .unknown_fmt        db  "find: unknown predicate '%s'",10,0
+    .invalid_fmt        db  "find: invalid argument '%s' to '%s'",10,0
+    .order_fmt          db  "find: paths must precede expression: '%s'",10,0
+    .too_many_fmt       db  "find: too many predicates",10,0
+section .text
+    prologue_with_vars 7
+
+    alloc_space Walk_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .idx            equ     16  ; size_t: index into argv.
+    .first_test     equ     24  ; size_t: index into argv of expression.
+    .state          equ     32  ; "FindState *"
+    .ret            equ     40  ; int: return value.
+    .arg            equ     48  ; "char *": current primary.
+    .walk           equ     56  ; Walk.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    mov     rdi, 1
+    mov     rsi, FindState_size
+    dcall   calloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.state], rax
+
+    lea     rdi, [rax+FindState.lock]
+    xor     rsi, rsi
+    dcall   pthread_mutex_init
+
+    ;--------------------
+    ; Find the start of the expression (argv[0] is the command name).
+
+    mov     qword [rsp+.idx], 1
+
+.find_expr:
+    mov     rax, [rsp+.idx]
+    cmp     rax, [rsp+.argc]
+    jae     .found_expr
+
+    mov     rcx, [rsp+.argv]
+    mov     rcx, [rcx+rax*PTR_SIZE]
+    cmp     byte [rcx], '-'
+    je      .found_expr
+
+    inc     qword [rsp+.idx]
+    jmp     .find_expr
+
+.found_expr:
+    mov     rax, [rsp+.idx]
+    mov     [rsp+.first_test], rax
+
+    ;--------------------
+    ; Parse the expression.
+
+.next_primary:
+    mov     rax, [rsp+.idx]
+    cmp     rax, [rsp+.argc]
+    jae     .parsed
+
+    mov     rcx, [rsp+.argv]
+    mov     rcx, [rcx+rax*PTR_SIZE]
+    mov     [rsp+.arg], rcx
+
+    cmp     byte [rcx], '-'
+    jne     .error_order
+
+    mov     rbx, [rsp+.state]
+    mov     rax, [rbx+FindState.ntests]
+    cmp     rax, FIND_MAX_TESTS
+    jae     .error_too_many
+
+    ; rbx = &state->tests[ntests]
+    imul    rax, rax, FindTest_size
+    lea     rbx, [rbx+FindState.tests+rax]
+
+    mov     rdi, [rsp+.arg]
+    mov     rsi, .print_primary
+    dcall   strcmp
+    cmp     eax, 0
+    je      .handle_print
+
+    mov     rdi, [rsp+.arg]
+    mov     rsi, .print0_primary
+    dcall   strcmp
+    cmp     eax, 0
+    je      .handle_print0
+
+    mov     rdi, [rsp+.arg]
+    mov     rsi, .name_primary
+    dcall   strcmp
+    cmp     eax, 0
+    je      .handle_name
+
+    mov     rdi, [rsp+.arg]
+    mov     rsi, .type_primary
+    dcall   strcmp
+    cmp     eax, 0
+    je      .handle_type
+
+    mov     rdi, [rsp+.arg]
+    mov     rsi, .size_primary
+    dcall   strcmp
+    cmp     eax, 0
+    je      .handle_size
+
+    jmp     .error_unknown
+
+.handle_print:
+    mov     qword [rbx+FindTest.type], FIND_PRINT
+    mov     qword [rbx+FindTest.value], 10
+    jmp     .add_test
+
+.handle_print0:
+    mov     qword [rbx+FindTest.type], FIND_PRINT0
+    mov     qword [rbx+FindTest.value], 0
+    jmp     .add_test
+
+.handle_name:
+    mov     qword [rbx+FindTest.type], FIND_NAME
+    jmp     .get_value
+
+.handle_type:
+    mov     qword [rbx+FindTest.type], FIND_TYPE
+    jmp     .get_value
+
+.handle_size:
+    mov     qword [rbx+FindTest.type], FIND_SIZE
+
+.get_value:
+    ; The primary requires an argument.
+    mov     rax, [rsp+.idx]
+    inc     rax
+    cmp     rax, [rsp+.argc]
+    jae     .error_missing
+
+    mov     [rsp+.idx], rax
+    mov     rcx, [rsp+.argv]
+    mov     rax, [rcx+rax*PTR_SIZE]
+    mov     [rbx+FindTest.arg], rax
+
+    cmp     qword [rbx+FindTest.type], FIND_NAME
+    je      .add_test
+
+    cmp     qword [rbx+FindTest.type], FIND_SIZE
+    je      .parse_size
+
+    ;--------------------
+    ; -type: a single character is expected.
+
+    cmp     byte [rax+1], 0
+    jne     .error_invalid
+
+    movzx   edx, byte [rax]
+    xor     rcx, rcx
+
+.next_type:
+    cmp     rcx, .type_count
+    je      .error_invalid
+
+    cmp     dl, [.type_chars+rcx]
+    je      .found_type
+
+    inc     rcx
+    jmp     .next_type
+
+.found_type:
+    movzx   eax, byte [.type_values+rcx]
+    mov     [rbx+FindTest.value], rax
+    jmp     .add_test
+
+.parse_size:
+    ;--------------------
+    ; -size: [+-]N[cwbkMG]
+
+    mov     qword [rbx+FindTest.unit], FIND_SIZE_UNIT
+    mov     qword [rbx+FindTest.cmp], 0
+
+    mov     rsi, rax
+
+    cmp     byte [rsi], '+'
+    jne     .check_minus
+
+    mov     qword [rbx+FindTest.cmp], 1
+    inc     rsi
+    jmp     .size_digits
+
+.check_minus:
+    cmp     byte [rsi], '-'
+    jne     .size_digits
+
+    mov     qword [rbx+FindTest.cmp], -1
+    inc     rsi
+
+.size_digits:
+    ; At least one digit is required.
+    movzx   ecx, byte [rsi]
+    sub     ecx, '0'
+    cmp     ecx, 9
+    ja      .error_invalid
+
+    xor     rax, rax
+
+.next_digit:
+    movzx   ecx, byte [rsi]
+    sub     ecx, '0'
+    cmp     ecx, 9
+    ja      .size_unit
+
+    ; value = (value * 10) + digit
+    mov     rdx, 10
+    mul     rdx
+    jc      .error_invalid
+    add     rax, rcx
+    jc      .error_invalid
+
+    inc     rsi
+    jmp     .next_digit
+
+.size_unit:
+    mov     [rbx+FindTest.value], rax
+
+    movzx   eax, byte [rsi]
+    cmp     al, 0
+    je      .add_test
+
+    ; The unit must be the last character.
+    cmp     byte [rsi+1], 0
+    jne     .error_invalid
+
+    mov     rcx, 1
+    cmp     al, 'c'
+    je      .set_unit
+
+    mov     rcx, 2
+    cmp     al, 'w'
+    je      .set_unit
+
+    mov     rcx, 512
+    cmp     al, 'b'
+    je      .set_unit
+
+    mov     rcx, 1024
+    cmp     al, 'k'
+    je      .set_unit
+
+    mov     rcx, (1024 * 1024)
+    cmp     al, 'M'
+    je      .set_unit
+
+    mov     rcx, (1024 * 1024 * 1024)
+    cmp     al, 'G'
+    je      .set_unit
+
+    jmp     .error_invalid
+
+.set_unit:
+    mov     [rbx+FindTest.unit], rcx
+
+.add_test:
+    mov     rax, [rsp+.state]
+    inc     qword [rax+FindState.ntests]
+
+    inc     qword [rsp+.idx]
+    jmp     .next_primary
+
+.parsed:
+    ;--------------------
+    ; Display every entry that matches if there is no action.
+
+    mov     rbx, [rsp+.state]
+    mov     rcx, [rbx+FindState.ntests]
+    lea     rax, [rbx+FindState.tests]
+
+.check_action:
+    cmp     rcx, 0
+    je      .add_print
+
+    cmp     qword [rax+FindTest.type], FIND_PRINT
+    jae     .walk_paths ; FIND_PRINT or FIND_PRINT0
+
+    add     rax, FindTest_size
+    dec     rcx
+    jmp     .check_action
+
+.add_print:
+    mov     rax, [rbx+FindState.ntests]
+    cmp     rax, FIND_MAX_TESTS
+    jae     .error_too_many
+
+    imul    rax, rax, FindTest_size
+    lea     rax, [rbx+FindState.tests+rax]
+    mov     qword [rax+FindTest.type], FIND_PRINT
+    mov     qword [rax+FindTest.value], 10
+    inc     qword [rbx+FindState.ntests]
+
+.walk_paths:
+    ;--------------------
+    ; Walk each path.
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     qword [rsp+.walk+Walk.visit], find_visit
+    mov     rax, [rsp+.state]
+    mov     [rsp+.walk+Walk.data], rax
+    mov     qword [rsp+.walk+Walk.cmd], .cmd_name
+
+    mov     qword [rsp+.idx], 1
+
+    mov     rax, [rsp+.first_test]
+    cmp     rax, 1
+    jne     .next_path
+
+    ; No paths, so use the current directory.
+    mov     rsi, .default_path
+    jmp     .handle_path
+
+.next_path:
+    mov     rax, [rsp+.idx]
+    cmp     rax, [rsp+.first_test]
+    jae     .done
+
+    mov     rcx, [rsp+.argv]
+    mov     rsi, [rcx+rax*PTR_SIZE]
+
+.handle_path:
+    lea     rdi, [rsp+.walk]
+    dcall   walk_tree
+    cmp     rax, 0
+    je      .flush
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.flush:
+    ; Display everything found under the path before moving on to
+    ; the next one.
+    mov     rdi, [rsp+.state]
+    dcall   find_flush_all
+
+    inc     qword [rsp+.idx]
+    jmp     .next_path
+
+.done:
+    mov     rax, [rsp+.state]
+    cmp     qword [rax+FindState.error], 0
+    je      .cleanup
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.cleanup:
+    ;--------------------
+    ; Free the output buffers and the state.
+
+    mov     rbx, [rsp+.state]
+    xor     rcx, rcx
+
+.free_buf:
+    mov     [rsp+.idx], rcx
+
+    imul    rax, rcx, FindBuf_size
+    mov     rdi, [rbx+FindState.bufs+rax+FindBuf.data]
+    dcall   free
+
+    mov     rcx, [rsp+.idx]
+    inc     rcx
+    cmp     rcx, WALK_MAX_THREADS
+    jb      .free_buf
+
+    lea     rdi, [rbx+FindState.lock]
+    dcall   pthread_mutex_destroy
+
+    mov     rdi, rbx
+    dcall   free
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space Walk_size
+    epilogue_with_vars 7
+    ret
+
+.error_missing:
+    mov     rdi, STDERR_FD
+    mov     rsi, .missing_fmt
+    mov     rdx, [rsp+.arg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error_cleanup
+
+.error_invalid:
+    mov     rdi, STDERR_FD
+    mov     rsi, .invalid_fmt
+    mov     rdx, [rbx+FindTest.arg]
+    mov     rcx, [rsp+.arg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error_cleanup
+
+.error_unknown:
+    mov     rdi, STDERR_FD
+    mov     rsi, .unknown_fmt
+    mov     rdx, [rsp+.arg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error_cleanup
+
+.error_order:
+    mov     rdi, STDERR_FD
+    mov     rsi, .order_fmt
+    mov     rdx, [rsp+.arg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error_cleanup
+
+.error_too_many:
+    mov     rdi, STDERR_FD
+    mov     rsi, .too_many_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error_cleanup:
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .cleanup
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Walk visit function that applies the expression to an
+;   entry.
+;
+; C prototype equivalent:
+;
+;     int find_visit(WalkEntry *entry, FindState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkEntry.
+; - Input: RSI (address) - FindState.
+; - Output: RAX (integer) - WALK_CONTINUE.
+;
+; Notes:
+;
+; Tests are applied in order and stop at the first one that fails, so
+; placing cheap tests (-name, -type) before -size avoids statx(2)
+; calls.
+;---------------------------------------------------------------------
+
+find_visit:
+section .rodata
+    .stat_fmt       db  "find: cannot access '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .entry      equ     0   ; "WalkEntry *"
+    .state      equ     8   ; "FindState *"
+    .test       equ    16   ; "FindTest *": current test.
+    .remaining  equ    24   ; size_t: tests left to apply.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.entry], rdi
+    mov     [rsp+.state], rsi
+
+    ;--------------------
+
+    lea     rax, [rsi+FindState.tests]
+    mov     [rsp+.test], rax
+    mov     rax, [rsi+FindState.ntests]
+    mov     [rsp+.remaining], rax
+
+.next_test:
+    cmp     qword [rsp+.remaining], 0
+    je      .out
+
+    mov     rbx, [rsp+.test]
+    mov     rax, [rbx+FindTest.type]
+
+    cmp     rax, FIND_NAME
+    je      .test_name
+
+    cmp     rax, FIND_TYPE
+    je      .test_type
+
+    cmp     rax, FIND_SIZE
+    je      .test_size
+
+    ; FIND_PRINT or FIND_PRINT0.
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.entry]
+    mov     rdx, [rbx+FindTest.value]
+    dcall   find_emit
+    jmp     .passed
+
+.test_name:
+    mov     rdi, [rbx+FindTest.arg]
+    mov     rsi, [rsp+.entry]
+    mov     rsi, [rsi+WalkEntry.name]
+    xor     rdx, rdx
+    dcall   fnmatch
+    cmp     eax, 0
+    jne     .out
+
+    jmp     .passed
+
+.test_type:
+    mov     rax, [rsp+.entry]
+    mov     rax, [rax+WalkEntry.type]
+    cmp     rax, [rbx+FindTest.value]
+    jne     .out
+
+    jmp     .passed
+
+.test_size:
+    mov     rdi, [rsp+.entry]
+    mov     rsi, STATX_SIZE
+    dcall   walk_statx
+    cmp     rax, 0
+    jne     .error_stat
+
+    ; units = ceil(size / unit)
+    mov     rbx, [rsp+.test]
+    mov     rax, [rsp+.entry]
+    mov     rax, [rax+WalkEntry.stx+Statx.stx_size]
+    mov     rcx, [rbx+FindTest.unit]
+    xor     rdx, rdx
+    div     rcx
+    cmp     rdx, 0
+    je      .compare_size
+
+    inc     rax
+
+.compare_size:
+    mov     rcx, [rbx+FindTest.cmp]
+    cmp     rcx, 0
+    jl      .size_less
+    jg      .size_greater
+
+    cmp     rax, [rbx+FindTest.value]
+    jne     .out
+
+    jmp     .passed
+
+.size_less:
+    cmp     rax, [rbx+FindTest.value]
+    jae     .out
+
+    jmp     .passed
+
+.size_greater:
+    cmp     rax, [rbx+FindTest.value]
+    jbe     .out
+
+.passed:
+    add     qword [rsp+.test], FindTest_size
+    dec     qword [rsp+.remaining]
+    jmp     .next_test
+
+.out:
+    mov     rax, WALK_CONTINUE
+
+    epilogue_with_vars 4
+    ret
+
+.error_stat:
+    mov     rdi, STDERR_FD
+    mov     rsi, .stat_fmt
+    mov     rax, [rsp+.entry]
+    mov     rdx, [rax+WalkEntry.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, [rsp+.state]
+    mov     qword [rax+FindState.error], 1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Add the path of an entry to the output buffer of the
+;   calling thread.
+;
+; C prototype equivalent:
+;
+;     void find_emit(FindState *state, WalkEntry *entry, int terminator);
+;
+; Parameters:
+;
+; - Input: RDI (address) - FindState.
+; - Input: RSI (address) - WalkEntry.
+; - Input: RDX (integer) - byte to write after the path.
+; - Output: None.
+;
+; Notes:
+;
+; The buffer is written (see find_flush()) when it has no room for the
+; path. If the buffer cannot be allocated, the path is written
+; directly.
+;---------------------------------------------------------------------
+
+find_emit:
+section .rodata
+    .alloc_fmt      db  "find: out of memory",10,0
+section .text
+    prologue_with_vars 5
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "FindState *"
+    .path       equ     8   ; "char *"
+    .term       equ    16   ; size_t: terminating byte.
+    .len        equ    24   ; size_t: length of path.
+    .buf        equ    32   ; "FindBuf *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     rax, [rsi+WalkEntry.path]
+    mov     [rsp+.path], rax
+    mov     [rsp+.term], rdx
+
+    ; buf = &state->bufs[entry->worker]
+    mov     rax, [rsi+WalkEntry.worker]
+    imul    rax, rax, FindBuf_size
+    lea     rbx, [rdi+FindState.bufs+rax]
+    mov     [rsp+.buf], rbx
+
+    ;--------------------
+
+    mov     rdi, [rsp+.path]
+    dcall   strlen
+    mov     [rsp+.len], rax
+
+    cmp     qword [rbx+FindBuf.data], 0
+    jne     .check_space
+
+    mov     rdi, FIND_BUF_SIZE
+    dcall   malloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     rbx, [rsp+.buf]
+    mov     [rbx+FindBuf.data], rax
+    mov     qword [rbx+FindBuf.len], 0
+
+.check_space:
+    ; Note: PATH_MAX is much smaller than FIND_BUF_SIZE so a path
+    ; always fits in an empty buffer.
+    mov     rax, [rbx+FindBuf.len]
+    add     rax, [rsp+.len]
+    inc     rax
+    cmp     rax, FIND_BUF_SIZE
+    jbe     .append
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, rbx
+    dcall   find_flush
+
+    mov     rbx, [rsp+.buf]
+
+.append:
+    mov     rdi, [rbx+FindBuf.data]
+    add     rdi, [rbx+FindBuf.len]
+    mov     rsi, [rsp+.path]
+    mov     rdx, [rsp+.len]
+    dcall   memcpy
+
+    mov     rbx, [rsp+.buf]
+    mov     rcx, [rbx+FindBuf.data]
+    mov     rax, [rbx+FindBuf.len]
+    add     rax, [rsp+.len]
+    mov     rdx, [rsp+.term]
+    mov     [rcx+rax], dl
+    inc     rax
+    mov     [rbx+FindBuf.len], rax
+
+.out:
+    epilogue_with_vars 5
+    ret
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, [rsp+.state]
+    mov     qword [rax+FindState.error], 1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Write the contents of an output buffer.
+;
+; C prototype equivalent:
+;
+;     void find_flush(FindState *state, FindBuf *buf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - FindState.
+; - Input: RSI (address) - FindBuf.
+; - Output: None.
+;
+; Notes:
+;
+; Writes are serialised so that the output of the threads is not
+; interleaved.
+;---------------------------------------------------------------------
+
+find_flush:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "FindState *"
+    .buf        equ     8   ; "FindBuf *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.buf], rsi
+
+    ;--------------------
+
+    cmp     qword [rsi+FindBuf.len], 0
+    je      .out
+
+    lea     rdi, [rdi+FindState.lock]
+    dcall   pthread_mutex_lock
+
+    mov     rbx, [rsp+.buf]
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rbx+FindBuf.data]
+    mov     rdx, [rbx+FindBuf.len]
+    dcall   write_block
+    cmp     rax, 0
+    jge     .unlock
+
+    mov     rax, [rsp+.state]
+    mov     qword [rax+FindState.error], 1
+
+.unlock:
+    mov     rdi, [rsp+.state]
+    lea     rdi, [rdi+FindState.lock]
+    dcall   pthread_mutex_unlock
+
+    mov     rbx, [rsp+.buf]
+    mov     qword [rbx+FindBuf.len], 0
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the contents of all the output buffers.
+;
+; C prototype equivalent:
+;
+;     void find_flush_all(FindState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - FindState.
+; - Output: None.
+;---------------------------------------------------------------------
+
+find_flush_all:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "FindState *"
+    .i          equ     8   ; size_t: index of buffer.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     qword [rsp+.i], 0
+
+.next:
+    mov     rax, [rsp+.i]
+    cmp     rax, WALK_MAX_THREADS
+    je      .out
+
+    imul    rax, rax, FindBuf_size
+    mov     rdi, [rsp+.state]
+    lea     rsi, [rdi+FindState.bufs+rax]
+    dcall   find_flush
+
+    inc     qword [rsp+.i]
+    jmp     .next
+
+.out:
+    epilogue_with_vars 2
+    ret
@@ -0,0 +1,1444 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_grep
+global command_grep
+
+extern arena_alloc
+extern arena_free
+extern asm_getopt
+extern asm_memcount
+extern asm_memmem
+extern asm_strlen
+extern read_block
+extern write_block
+
+extern close
+extern dprintf
+extern fstat
+extern madvise
+extern memchr
+extern memcpy
+extern memmove
+extern memrchr
+extern mmap
+extern munmap
+extern open
+extern snprintf
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_grep:  db  "see grep(1)",10, \
+                        10, \
+                        "Options:",10, \
+                        10, \
+                        "-F : Pattern is a fixed string (always assumed).",10, \
+                        "-c : Only display a count of selected lines.",10, \
+                        "-l : Only display the names of files with selected lines.",10, \
+                        "-n : Show line numbers.",10, \
+                        "-v : Select lines that do not match.",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign GREP_COUNT              (1 << 0)
+%assign GREP_INVERT             (1 << 1)
+%assign GREP_LINE_NUMBERS       (1 << 2)
+%assign GREP_FILES_WITH_MATCHES (1 << 3)
+%assign GREP_SHOW_NAME          (1 << 4)
+
+; Size of the output buffer.
+GREP_OUT_BUF_SIZE       equ     IO_READ_BUF_SIZE
+
+; Initial size of the buffer used to read files that cannot be
+; mapped. It grows if a single line does not fit.
+GREP_READ_BUF_SIZE      equ     (IO_READ_BUF_SIZE * 4)
+
+; Size of the buffer used by grep_printf().
+GREP_MSG_SIZE           equ     (PATH_MAX + 32)
+
+;---------------------------------------------------------------------
+; State shared by the grep functions.
+;---------------------------------------------------------------------
+struc GrepState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .flags      resq    1 ; GREP_* bitmask.
+    .needle     resq    1 ; "char *": pattern.
+    .needle_len resq    1 ; size_t.
+    .name       resq    1 ; "char *": name of current file.
+    .lineno     resq    1 ; size_t: lines before the current position.
+    .count      resq    1 ; size_t: lines selected in current file.
+    .done       resq    1 ; bool: true if rest of file can be ignored.
+    .out_buf    resq    1 ; "char *": output buffer.
+    .out_len    resq    1 ; size_t: bytes in output buffer.
+    .error      resq    1 ; bool: true if output failed.
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `grep` command for fixed
+;   strings.
+;
+; C prototype equivalent:
+;
+;     int command_grep(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 if any lines were selected, else -1.
+;
+; Notes:
+;
+; - The input is never split into lines. Instead, the pattern is
+;   searched for in a large block of data using asm_memmem() and the
+;   line boundaries are only found around each match. Line numbers are
+;   calculated by counting the newlines between matches with
+;   asm_memcount().
+;
+; - Regular files are mapped into memory and searched in one go. Other
+;   files are read into a buffer (see grep_stream()).
+;
+; - Output is buffered.
+;
+; - Buffers are allocated from the arena (and released by
+;   handle_command()).
+;
+; Limitations:
+;
+; - The pattern is always treated as a fixed string (as if -F were
+;   specified).
+; - Only a single pattern is supported.
+; - Errors result in an exit code of 1 (rather than 2).
+;
+; See: grep(1).
+;---------------------------------------------------------------------
+
+command_grep:
+section .rodata
+    .optstring          db  "Fcvnl",0
+    .fixed_opt          equ 'F'
+    .count_opt          equ 'c'
+    .invert_opt         equ 'v'
+    .line_numbers_opt   equ 'n'
+    .files_opt          equ 'l'
+
+    .stdin_name         db  "(standard input)",0
+
+    .errUsage           db  "ERROR: Usage: grep [-F] [-c] [-l] [-n] [-v] <pattern> [<file>...]",10,0
+    .errUsageLen        equ $-.errUsage-1
+
+section .text
+    prologue_with_vars 6
+
+    alloc_space GrepState_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .file_idx       equ     16  ; size_t: index into argv of next file.
+    .matched        equ     24  ; bool: true if any lines selected.
+    .failed         equ     32  ; bool: true if any file failed.
+    .unused         equ     40  ; padding.
+    .state          equ     48  ; GrepState.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.state+GrepState.flags], 0
+    mov     qword [rsp+.state+GrepState.out_buf], 0
+    mov     qword [rsp+.state+GrepState.out_len], 0
+    mov     qword [rsp+.state+GrepState.error], 0
+
+    mov     qword [rsp+.matched], 0
+    mov     qword [rsp+.failed], 0
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    ;------------------------------
+
+    cmp     al, .fixed_opt
+    je      .next_arg ; The default.
+
+    cmp     al, .count_opt
+    je      .handle_count_opt
+
+    cmp     al, .invert_opt
+    je      .handle_invert_opt
+
+    cmp     al, .line_numbers_opt
+    je      .handle_line_numbers_opt
+
+    cmp     al, .files_opt
+    je      .handle_files_opt
+
+    jmp     .error_bad_option
+
+.handle_count_opt:
+    or      qword [rsp+.state+GrepState.flags], GREP_COUNT
+    jmp     .next_arg
+
+.handle_invert_opt:
+    or      qword [rsp+.state+GrepState.flags], GREP_INVERT
+    jmp     .next_arg
+
+.handle_line_numbers_opt:
+    or      qword [rsp+.state+GrepState.flags], GREP_LINE_NUMBERS
+    jmp     .next_arg
+
+.handle_files_opt:
+    or      qword [rsp+.state+GrepState.flags], GREP_FILES_WITH_MATCHES
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.file_idx], rax
+
+    cmp     rax, [rsp+.argc]
+    jge     .error_usage ; No pattern.
+
+    ;--------------------
+    ; Save the pattern.
+
+    mov     rcx, [rsp+.argv]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+    mov     [rsp+.state+GrepState.needle], rdi
+
+    dcall   asm_strlen
+    mov     [rsp+.state+GrepState.needle_len], rax
+
+    inc     qword [rsp+.file_idx]
+
+    ;--------------------
+    ; Show file names if there are multiple files.
+
+    mov     rax, [rsp+.argc]
+    sub     rax, [rsp+.file_idx]
+    cmp     rax, 1
+    jle     .create_buffer
+
+    or      qword [rsp+.state+GrepState.flags], GREP_SHOW_NAME
+
+.create_buffer:
+    mov     rdi, GREP_OUT_BUF_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.state+GrepState.out_buf], rax
+
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    jne     .next_file
+
+    ;--------------------
+    ; No files, so read stdin.
+
+    lea     rdi, [rsp+.state]
+    mov     rsi, STDIN_FD
+    mov     rdx, .stdin_name
+    dcall   grep_fd
+    jmp     .check_result
+
+.next_file:
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    je      .finish
+
+    mov     rcx, [rsp+.argv]
+    mov     rsi, [rcx+rax*PTR_SIZE]
+    lea     rdi, [rsp+.state]
+    dcall   grep_file
+
+    inc     qword [rsp+.file_idx]
+
+.check_result:
+    cmp     rax, 0
+    je      .check_output
+    jg      .file_matched
+
+    mov     qword [rsp+.failed], 1
+    jmp     .check_output
+
+.file_matched:
+    mov     qword [rsp+.matched], 1
+
+.check_output:
+    ; Give up if the output is broken.
+    cmp     qword [rsp+.state+GrepState.error], 0
+    jne     .finish
+
+    jmp     .next_file
+
+.finish:
+    lea     rdi, [rsp+.state]
+    dcall   grep_flush
+
+    cmp     qword [rsp+.state+GrepState.error], 0
+    jne     .error
+
+    cmp     qword [rsp+.failed], 0
+    jne     .error
+
+    cmp     qword [rsp+.matched], 0
+    je      .error
+
+    mov     rax, CMD_OK
+
+.out:
+    free_space GrepState_size
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     rax, CMD_BAD_OPT
+    jmp     .out
+
+.error_usage:
+    mov     rdi, STDERR_FD
+    mov     rsi, .errUsage
+    mov     rdx, .errUsageLen
+    dcall   write_block
+
+.error:
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Search the specified file.
+;
+; C prototype equivalent:
+;
+;     int grep_file(GrepState *state, const char *file);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (string) - file path ("-" means stdin).
+; - Output: RAX (integer) - 1 if lines were selected, 0 if not,
+;   or -1 on error.
+;---------------------------------------------------------------------
+
+grep_file:
+section .rodata
+    .open_fmt       db  "grep: %s: cannot open file",10,0
+    .stdin_name     db  "(standard input)",0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .file       equ     8   ; "char *"
+    .fd         equ    16   ; int.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.file], rsi
+
+    ;--------------------
+    ; Handle the stdin alias.
+
+    cmp     byte [rsi], '-'
+    jne     .open_file
+
+    cmp     byte [rsi+1], 0
+    jne     .open_file
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, STDIN_FD
+    mov     rdx, .stdin_name
+    dcall   grep_fd
+    jmp     .out
+
+.open_file:
+    mov     rdi, [rsp+.file]
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    mov     rdx, [rsp+.file]
+    dcall   grep_fd
+    mov     [rsp+.ret], rax
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+    mov     rax, [rsp+.ret]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error_open:
+    ; Don't mix the error with any buffered output.
+    mov     rdi, [rsp+.state]
+    dcall   grep_flush
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.file]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Search all the data available from the specified file
+;   descriptor.
+;
+; C prototype equivalent:
+;
+;     int grep_fd(GrepState *state, int fd, const char *name);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (integer) - file descriptor.
+; - Input: RDX (string) - name of file.
+; - Output: RAX (integer) - 1 if lines were selected, 0 if not,
+;   or -1 on error.
+;
+; Notes:
+;
+; Non-empty regular files are mapped into memory (avoiding copying
+; the data into a buffer). Everything else, or if the mapping fails,
+; is handled by grep_stream().
+;---------------------------------------------------------------------
+
+grep_fd:
+section .rodata
+    .count_fmt      db  "%lu",10,0
+    .named_count_fmt db "%s:%lu",10,0
+    .name_fmt       db  "%s",10,0
+    .read_fmt       db  "grep: %s: read error",10,0
+section .text
+    prologue_with_vars 6
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .fd         equ     8   ; int.
+    .name       equ    16   ; "char *"
+    .map        equ    24   ; "void *": mapped file.
+    .size       equ    32   ; size_t: file size.
+    .ret        equ    40   ; int: return value.
+    .stat       equ    48   ; Stat_size bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+    mov     [rsp+.name], rdx
+
+    ;--------------------
+    ; Reset the file state.
+
+    mov     rax, rdi
+    mov     [rax+GrepState.name], rdx
+    mov     qword [rax+GrepState.lineno], 0
+    mov     qword [rax+GrepState.count], 0
+    mov     qword [rax+GrepState.done], 0
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Try to map the file.
+
+    mov     rdi, [rsp+.fd]
+    lea     rsi, [rsp+.stat]
+    dcall   fstat
+    cmp     eax, 0
+    jne     .stream
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFREG
+    jne     .stream
+
+    mov     rax, [rsp+.stat+Stat.st_size]
+    cmp     rax, 0
+    jle     .stream
+
+    mov     [rsp+.size], rax
+
+    mov     rdi, 0 ; Let the kernel choose the address.
+    mov     rsi, [rsp+.size]
+    mov     rdx, PROT_READ
+    mov     rcx, MAP_PRIVATE
+    mov     r8, [rsp+.fd]
+    mov     r9, 0 ; offset.
+    dcall   mmap
+    cmp     rax, MAP_FAILED
+    je      .stream
+
+    mov     [rsp+.map], rax
+
+    ; The file is read from start to end (once), so the kernel can
+    ; read ahead aggressively (and drop pages behind).
+    mov     rdi, rax
+    mov     rsi, [rsp+.size]
+    mov     rdx, MADV_SEQUENTIAL
+    dcall   madvise
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.map]
+    mov     rdx, [rsp+.size]
+    dcall   grep_region
+
+    mov     rdi, [rsp+.map]
+    mov     rsi, [rsp+.size]
+    dcall   munmap
+
+    jmp     .searched
+
+.stream:
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    dcall   grep_stream
+    cmp     rax, 0
+    jne     .error_read
+
+.searched:
+    mov     rax, [rsp+.state]
+    mov     rcx, [rax+GrepState.flags]
+
+    cmp     qword [rax+GrepState.count], 0
+    je      .report
+
+    mov     qword [rsp+.ret], 1
+
+.report:
+    ;--------------------
+    ; Display the per-file results.
+
+    test    rcx, GREP_FILES_WITH_MATCHES
+    jnz     .report_name
+
+    test    rcx, GREP_COUNT
+    jz      .out
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, .count_fmt
+    mov     rdx, [rax+GrepState.count]
+
+    test    rcx, GREP_SHOW_NAME
+    jz      .print
+
+    mov     rsi, .named_count_fmt
+    mov     rcx, rdx
+    mov     rdx, [rax+GrepState.name]
+    jmp     .print
+
+.report_name:
+    cmp     qword [rsp+.ret], 0
+    je      .out
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, .name_fmt
+    mov     rdx, [rax+GrepState.name]
+
+.print:
+    dcall   grep_printf
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space Stat_size
+    epilogue_with_vars 6
+    ret
+
+.error_read:
+    mov     rdi, [rsp+.state]
+    dcall   grep_flush
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    mov     rdx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Search a file that cannot be mapped by reading it into
+;   a buffer.
+;
+; C prototype equivalent:
+;
+;     int grep_stream(GrepState *state, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (integer) - file descriptor.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Only complete lines are searched: any partial line at the end of
+;   the buffer is moved to the start of the buffer before reading more
+;   data.
+;
+; - If a line does not fit in the buffer, the buffer size is doubled.
+;
+; - The buffer is allocated from the arena and returned to it (with
+;   arena_free()) for the next file.
+;---------------------------------------------------------------------
+
+grep_stream:
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .fd         equ     8   ; int.
+    .buffer     equ    16   ; "char *"
+    .size       equ    24   ; size_t: size of buffer.
+    .keep       equ    32   ; size_t: bytes of data in buffer.
+    .consumed   equ    40   ; size_t: bytes of complete lines in buffer.
+    .ret        equ    48   ; int: return value.
+    .bigger     equ    56   ; "char *": replacement buffer.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+
+    ;--------------------
+
+    mov     qword [rsp+.keep], 0
+    mov     qword [rsp+.ret], -1
+    mov     qword [rsp+.size], GREP_READ_BUF_SIZE
+
+    mov     rdi, GREP_READ_BUF_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.buffer], rax
+
+.read_again:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rsp+.buffer]
+    add     rsi, [rsp+.keep]
+    mov     rdx, [rsp+.size]
+    sub     rdx, [rsp+.keep]
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .eof
+    jl      .free_buffer
+
+    add     [rsp+.keep], rax
+
+    ;--------------------
+    ; Find the end of the last complete line.
+
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.keep]
+    dcall   memrchr
+    cmp     rax, 0
+    je      .no_complete_line
+
+    inc     rax
+    sub     rax, [rsp+.buffer]
+    mov     [rsp+.consumed], rax
+    sub     [rsp+.keep], rax
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.consumed]
+    dcall   grep_region
+
+    mov     rax, [rsp+.state]
+    cmp     qword [rax+GrepState.done], 0
+    jne     .success
+
+    ; Move the partial line to the start of the buffer.
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, rdi
+    add     rsi, [rsp+.consumed]
+    mov     rdx, [rsp+.keep]
+    dcall   memmove
+
+    jmp     .read_again
+
+.no_complete_line:
+    mov     rax, [rsp+.keep]
+    cmp     rax, [rsp+.size]
+    jne     .read_again
+
+    ; The buffer is full of a single line, so make it bigger.
+    mov     rdi, [rsp+.size]
+    shl     rdi, 1
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .free_buffer
+
+    mov     [rsp+.bigger], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.keep]
+    dcall   memcpy
+
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, [rsp+.size]
+    dcall   arena_free
+
+    mov     rax, [rsp+.bigger]
+    mov     [rsp+.buffer], rax
+    shl     qword [rsp+.size], 1
+    jmp     .read_again
+
+.eof:
+    ; Search any final unterminated line.
+    mov     rdx, [rsp+.keep]
+    cmp     rdx, 0
+    je      .success
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buffer]
+    dcall   grep_region
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.free_buffer:
+    ; Let the next file reuse the buffer.
+    mov     rdi, [rsp+.buffer]
+    mov     rsi, [rsp+.size]
+    dcall   arena_free
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 8
+    ret
+
+;---------------------------------------------------------------------
+; Description: Search a block of complete lines (the final line may
+;   not be terminated) and handle the selected lines.
+;
+; C prototype equivalent:
+;
+;     void grep_region(GrepState *state, const char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (address) - start of first line.
+; - Input: RDX (integer) - number of bytes.
+; - Output: None.
+;---------------------------------------------------------------------
+
+grep_region:
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .pos        equ     8   ; "char *": start of next line to consider.
+    .end        equ    16   ; "char *": end of block.
+    .match      equ    24   ; "char *": start of match.
+    .line_start equ    32   ; "char *": start of matching line.
+    .line_end   equ    40   ; "char *": end of matching line (after newline).
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.pos], rsi
+
+    add     rdx, rsi
+    mov     [rsp+.end], rdx
+
+    ;--------------------
+
+.next_match:
+    mov     rax, [rsp+.state]
+    cmp     qword [rax+GrepState.done], 0
+    jne     .out
+
+    ; Required since an empty pattern matches an empty block.
+    mov     rdi, [rsp+.pos]
+    cmp     rdi, [rsp+.end]
+    jae     .no_more_matches
+
+    mov     rsi, [rsp+.end]
+    sub     rsi, rdi
+    mov     rdx, [rax+GrepState.needle]
+    mov     rcx, [rax+GrepState.needle_len]
+    dcall   asm_memmem
+    cmp     rax, 0
+    je      .no_more_matches
+
+    mov     [rsp+.match], rax
+
+    ;--------------------
+    ; Find the start of the line containing the match.
+
+    mov     rax, [rsp+.pos]
+    mov     [rsp+.line_start], rax
+
+    mov     rdi, [rsp+.pos]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.match]
+    sub     rdx, rdi
+    dcall   memrchr
+    cmp     rax, 0
+    je      .find_line_end
+
+    inc     rax
+    mov     [rsp+.line_start], rax
+
+.find_line_end:
+    mov     rax, [rsp+.end]
+    mov     [rsp+.line_end], rax
+
+    mov     rdi, [rsp+.match]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.end]
+    sub     rdx, rdi
+    dcall   memchr
+    cmp     rax, 0
+    je      .got_line
+
+    inc     rax
+    mov     [rsp+.line_end], rax
+
+.got_line:
+    mov     rax, [rsp+.state]
+    test    qword [rax+GrepState.flags], GREP_INVERT
+    jz      .select_match
+
+    ;--------------------
+    ; Invert: select all the lines before the matching line, and skip
+    ; the matching line.
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.pos]
+    mov     rdx, [rsp+.line_start]
+    dcall   grep_lines
+
+    mov     rax, [rsp+.state]
+    inc     qword [rax+GrepState.lineno]
+
+    jmp     .matched_line_done
+
+.select_match:
+    mov     rdi, rax
+    mov     rsi, [rsp+.pos]
+    mov     rdx, [rsp+.line_start]
+    mov     rcx, [rsp+.line_end]
+    dcall   grep_select
+
+.matched_line_done:
+    mov     rax, [rsp+.line_end]
+    mov     [rsp+.pos], rax
+    jmp     .next_match
+
+.no_more_matches:
+    mov     rax, [rsp+.state]
+    test    qword [rax+GrepState.flags], GREP_INVERT
+    jz      .count_remaining_lines
+
+    ; Select all the remaining lines.
+    mov     rdi, rax
+    mov     rsi, [rsp+.pos]
+    mov     rdx, [rsp+.end]
+    dcall   grep_lines
+    jmp     .out
+
+.count_remaining_lines:
+    ; Line numbers must be correct for the next block.
+    test    qword [rax+GrepState.flags], GREP_LINE_NUMBERS
+    jz      .out
+
+    mov     rdi, [rsp+.pos]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.end]
+    sub     rdx, rdi
+    dcall   asm_memcount
+
+    mov     rcx, [rsp+.state]
+    add     [rcx+GrepState.lineno], rax
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Handle a line containing a match.
+;
+; C prototype equivalent:
+;
+;     void grep_select(GrepState *state, const char *pos,
+;                      const char *line_start, const char *line_end);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (address) - end of the previous line handled (used to
+;   update the line number).
+; - Input: RDX (address) - start of the line.
+; - Input: RCX (address) - end of the line.
+; - Output: None.
+;---------------------------------------------------------------------
+
+grep_select:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .pos        equ     8   ; "char *"
+    .line_start equ    16   ; "char *"
+    .line_end   equ    24   ; "char *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.pos], rsi
+    mov     [rsp+.line_start], rdx
+    mov     [rsp+.line_end], rcx
+
+    ;--------------------
+
+    inc     qword [rdi+GrepState.count]
+
+    mov     rax, [rdi+GrepState.flags]
+
+    test    rax, GREP_FILES_WITH_MATCHES
+    jz      .check_count
+
+    ; One line is enough.
+    mov     qword [rdi+GrepState.done], 1
+    jmp     .out
+
+.check_count:
+    test    rax, GREP_COUNT
+    jnz     .out
+
+    test    rax, GREP_LINE_NUMBERS
+    jz      .show_line
+
+    ; Count the lines since the last match.
+    mov     rdi, [rsp+.pos]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.line_start]
+    sub     rdx, rdi
+    dcall   asm_memcount
+
+    mov     rdi, [rsp+.state]
+    add     [rdi+GrepState.lineno], rax
+
+.show_line:
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.line_start]
+    mov     rdx, [rsp+.line_end]
+    dcall   grep_line
+
+    ; Account for the matching line.
+    mov     rdi, [rsp+.state]
+    inc     qword [rdi+GrepState.lineno]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Handle a block of complete lines, all of which are
+;   selected (used for -v).
+;
+; C prototype equivalent:
+;
+;     void grep_lines(GrepState *state, const char *start, const char *end);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (address) - start of first line.
+; - Input: RDX (address) - end of block (the final line may not be
+;   terminated).
+; - Output: None.
+;
+; Notes:
+;
+; If no prefixes are required, the whole block is written at once
+; without finding the individual lines.
+;---------------------------------------------------------------------
+
+grep_lines:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .start      equ     8   ; "char *"
+    .end        equ    16   ; "char *"
+    .lines      equ    24   ; size_t: number of lines.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.start], rsi
+    mov     [rsp+.end], rdx
+
+    ;--------------------
+
+    cmp     rsi, rdx
+    je      .out ; No lines.
+
+    ;--------------------
+    ; Count the lines.
+
+    mov     rdi, rsi
+    mov     rsi, 0x0a ; '\n'
+    sub     rdx, rdi
+    dcall   asm_memcount
+    mov     [rsp+.lines], rax
+
+    mov     rcx, [rsp+.end]
+    cmp     byte [rcx-1], 0x0a
+    je      .counted
+
+    inc     qword [rsp+.lines] ; Unterminated final line.
+
+.counted:
+    mov     rdi, [rsp+.state]
+    mov     rax, [rsp+.lines]
+    add     [rdi+GrepState.count], rax
+
+    mov     rax, [rdi+GrepState.flags]
+
+    test    rax, GREP_FILES_WITH_MATCHES
+    jz      .check_count
+
+    mov     qword [rdi+GrepState.done], 1
+    jmp     .out
+
+.check_count:
+    test    rax, GREP_COUNT
+    jnz     .update_lineno
+
+    test    rax, (GREP_LINE_NUMBERS|GREP_SHOW_NAME)
+    jnz     .next_line
+
+    ;--------------------
+    ; No prefixes, so write everything at once.
+
+    mov     rsi, [rsp+.start]
+    mov     rdx, [rsp+.end]
+    dcall   grep_line
+
+.update_lineno:
+    mov     rdi, [rsp+.state]
+    mov     rax, [rsp+.lines]
+    add     [rdi+GrepState.lineno], rax
+    jmp     .out
+
+    ;--------------------
+    ; Write each line with a prefix.
+
+.next_line:
+    mov     rsi, [rsp+.start]
+    cmp     rsi, [rsp+.end]
+    jae     .out
+
+    mov     rdi, rsi
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rsp+.end]
+    sub     rdx, rdi
+    dcall   memchr
+
+    mov     rdx, [rsp+.end]
+    cmp     rax, 0
+    je      .show_line
+
+    lea     rdx, [rax+1]
+
+.show_line:
+    mov     rsi, [rsp+.start]
+    mov     [rsp+.start], rdx
+
+    mov     rdi, [rsp+.state]
+    dcall   grep_line
+
+    mov     rdi, [rsp+.state]
+    inc     qword [rdi+GrepState.lineno]
+    jmp     .next_line
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write a selected line, with the required prefixes.
+;
+; C prototype equivalent:
+;
+;     void grep_line(GrepState *state, const char *start, const char *end);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (address) - start of line.
+; - Input: RDX (address) - end of line (after the newline, if any).
+; - Output: None.
+;
+; Notes:
+;
+; - A newline is added if the line does not end with one.
+;
+; - The line number shown is GrepState.lineno + 1 (the caller updates
+;   GrepState.lineno). The same function is also used to write blocks
+;   of lines when no prefixes are required.
+;---------------------------------------------------------------------
+
+grep_line:
+section .rodata
+    .lineno_fmt     db  "%lu:",0
+    .newline        db  10
+section .text
+    prologue_with_vars 4
+
+    alloc_space 32
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .start      equ     8   ; "char *"
+    .end        equ    16   ; "char *"
+    .unused     equ    24   ; padding.
+    .prefix     equ    32   ; char[32]: line number prefix.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.start], rsi
+    mov     [rsp+.end], rdx
+
+    ;--------------------
+
+    mov     rax, [rdi+GrepState.flags]
+    test    rax, GREP_SHOW_NAME
+    jz      .check_lineno
+
+    ; "name:"
+    mov     rdi, [rdi+GrepState.name]
+    dcall   asm_strlen
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rdi+GrepState.name]
+    mov     rdx, rax
+    dcall   grep_write
+
+    mov     rdi, [rsp+.state]
+    mov     byte [rsp+.prefix], ':'
+    lea     rsi, [rsp+.prefix]
+    mov     rdx, 1
+    dcall   grep_write
+
+.check_lineno:
+    mov     rdi, [rsp+.state]
+    test    qword [rdi+GrepState.flags], GREP_LINE_NUMBERS
+    jz      .show_line
+
+    ; "lineno:"
+    mov     rcx, [rdi+GrepState.lineno]
+    inc     rcx
+
+    lea     rdi, [rsp+.prefix]
+    mov     rsi, 32
+    mov     rdx, .lineno_fmt
+    xor     rax, rax
+    dcall   snprintf
+    cdqe
+
+    mov     rdi, [rsp+.state]
+    lea     rsi, [rsp+.prefix]
+    mov     rdx, rax
+    dcall   grep_write
+
+.show_line:
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.start]
+    mov     rdx, [rsp+.end]
+    sub     rdx, rsi
+    jz      .out
+    dcall   grep_write
+
+    mov     rax, [rsp+.end]
+    cmp     byte [rax-1], 0x0a
+    je      .out
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, .newline
+    mov     rdx, 1
+    dcall   grep_write
+
+.out:
+    free_space 32
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Format a message and add it to the output buffer.
+;
+; C prototype equivalent:
+;
+;     void grep_printf(GrepState *state, const char *fmt, ...);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (string) - printf(3) format.
+; - Input: RDX (integer) - 1st format argument.
+; - Input: RCX (integer) - 2nd format argument.
+; - Output: None.
+;
+; Limitations:
+;
+; - Only supports two (integer or pointer) format arguments.
+; - The formatted message is truncated to PATH_MAX + 32 bytes.
+;---------------------------------------------------------------------
+
+grep_printf:
+    prologue_with_vars 2
+
+    alloc_space GREP_MSG_SIZE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .unused     equ     8   ; padding.
+    .msg        equ    16   ; char[GREP_MSG_SIZE]
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+
+    ; snprintf(msg, size, fmt, arg1, arg2)
+    lea     rdi, [rsp+.msg]
+    mov     r8, rcx
+    mov     rcx, rdx
+    mov     rdx, rsi
+    mov     rsi, GREP_MSG_SIZE
+    xor     rax, rax
+    dcall   snprintf
+    cdqe
+
+    cmp     rax, 0
+    jle     .out
+
+    cmp     rax, GREP_MSG_SIZE
+    jb      .write
+
+    mov     rax, (GREP_MSG_SIZE - 1) ; Truncated.
+
+.write:
+    mov     rdi, [rsp+.state]
+    lea     rsi, [rsp+.msg]
+    mov     rdx, rax
+    dcall   grep_write
+
+.out:
+    free_space GREP_MSG_SIZE
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Add data to the output buffer.
+;
+; C prototype equivalent:
+;
+;     void grep_write(GrepState *state, const void *data, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: None.
+;
+; Notes:
+;
+; - The buffer is flushed when full. Data too big to fit in the buffer
+;   is written directly.
+;
+; - Write errors are recorded in GrepState.error.
+;---------------------------------------------------------------------
+
+grep_write:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+    .data       equ     8   ; "void *"
+    .len        equ    16   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.data], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    mov     rax, [rdi+GrepState.out_len]
+    add     rax, rdx
+    cmp     rax, GREP_OUT_BUF_SIZE
+    jbe     .copy
+
+    dcall   grep_flush
+
+    cmp     qword [rsp+.len], GREP_OUT_BUF_SIZE
+    jb      .copy
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    dcall   write_block
+    cmp     rax, 0
+    jge     .out
+
+    mov     rdi, [rsp+.state]
+    mov     qword [rdi+GrepState.error], 1
+    jmp     .out
+
+.copy:
+    mov     rax, [rsp+.state]
+    mov     rdi, [rax+GrepState.out_buf]
+    add     rdi, [rax+GrepState.out_len]
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    dcall   memcpy
+
+    mov     rax, [rsp+.state]
+    mov     rdx, [rsp+.len]
+    add     [rax+GrepState.out_len], rdx
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the contents of the output buffer.
+;
+; C prototype equivalent:
+;
+;     void grep_flush(GrepState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - GrepState.
+; - Output: None.
+;---------------------------------------------------------------------
+
+grep_flush:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "GrepState *"
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+
+    mov     rdx, [rdi+GrepState.out_len]
+    cmp     rdx, 0
+    je      .out
+
+    mov     rsi, [rdi+GrepState.out_buf]
+    mov     rdi, STDOUT_FD
+    dcall   write_block
+
+    mov     rdi, [rsp+.state]
+    mov     qword [rdi+GrepState.out_len], 0
+
+    cmp     rax, 0
+    jge     .out
+
+    mov     qword [rdi+GrepState.error], 1
+
+.out:
+    epilogue_with_vars 1
+    ret
@@ -10,22 +10,33 @@ global command_help_head
 global command_head
 
 extern asm_getopt
-extern asm_strchr
 extern libc_strtol
+extern prefetch_end
+extern prefetch_next
+extern prefetch_read
+extern prefetch_start
 extern read_block
 extern write_block
 
 extern close
+extern dprintf
+extern get_nprocs
+extern memchr
 extern open
 extern optarg
-extern write
 
 extern optind
 
-section .rodata
-command_help_head:  db  "see head(1)",0
-
 %include "header.inc"
+%include "prefetch.inc"
+
+cold_rodata
+command_help_head:  db  "see head(1)",10, \
+                        10, \
+                        "Extensions:",10, \
+                        10, \
+                        "-P N : Read up to N files at the same time (0 for one per CPU).",10, \
+                        "       The output is the same as when reading one at a time.",0
 
 section .text
 
@@ -49,16 +60,25 @@ struc Block
     .num     resq    1 ; size_t: Block number (1st is 0).
     .data    resq    1 ; size_t: Handler specific data [*].
     .done    resq    1 ; bool: Handler sets to indicate work complete.
-    .buffer  resb    IO_READ_BUF_SIZE ; char array: file data to read.
+    .buffer  resq    1 ; "char *": file data to handle.
 endstruc
 
 ;---------------------------------------------------------------------
+; Extensions:
+;
+; - Provides a '-P N' (parallel) option. In this mode, up to N files
+;   are read at the same time by a pool of reader threads, but the
+;   output is still produced in argument order (see head_parallel()).
 ;
+; Notes:
+;
+; - As with GNU head(1), a "==> name <==" header is displayed before
+;   each file when more than one file is specified.
 ;---------------------------------------------------------------------
 
 command_head:
 section .rodata
-    .optstring          db  "c:n:",0
+    .optstring          db  "c:n:P:",0
 
     .short_bytes_opt    equ 'c'
     .long_bytes_opt     db  "--bytes",0     ; FIXME: long options not supported.
@@ -66,8 +86,10 @@ section .rodata
     .short_lines_opt    equ 'n'
     .long_lines_opt     db  "--lines",0     ; FIXME: long options not supported.
 
+    .short_threads_opt  equ 'P'
+
 section .text
-    prologue_with_vars 6
+    prologue_with_vars 8
 
     ;--------------------
     ; Stack offsets.
@@ -78,6 +100,8 @@ section .text
     .use_bytes  equ    24   ; bool: bytes if true, else lines (default).
     .file_idx   equ    32   ; int: index into argc for file(s) to process.
     .fd_in      equ    40   ; int: file descriptor of file to read.
+    .threads    equ    48   ; size_t: use head_parallel() if >0.
+    .files      equ    56   ; size_t: number of files.
 
     ;--------------------
     ; Set defaults
@@ -85,6 +109,7 @@ section .text
     ; By default, head(1) prints the 1st 10 lines of a file.
     mov     qword [rsp+.use_bytes], 0
     mov     qword [rsp+.amount], 10
+    mov     qword [rsp+.threads], 0
 
     ; XXX: Careful! optind and argc are 32-bit ints, so clear all
     ; 64-bits of each to avoid surprises!
@@ -126,6 +151,11 @@ section .text
     cmp     al, .short_lines_opt
     je      .handle_lines_opt
 
+    cmp     al, .short_threads_opt
+    je      .handle_threads_opt
+
+    jmp     .error_bad_option
+
 .handle_bytes_opt:
     mov     qword [rsp+.use_bytes], 1
 
@@ -154,6 +184,33 @@ section .text
 
     jmp     .next_arg
 
+.handle_threads_opt:
+    mov     rdi, [optarg]
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.threads]
+
+    dcall   libc_strtol
+
+    cmp     rax, 0
+    jne     .error_bad_num
+
+    cmp     qword [rsp+.threads], 0
+    jl      .error_bad_num
+    jg      .next_arg
+
+    ; One per CPU.
+    dcall   get_nprocs
+    cdqe
+
+    cmp     rax, 1
+    jge     .save_threads
+
+    mov     rax, 1
+
+.save_threads:
+    mov     [rsp+.threads], rax
+    jmp     .next_arg
+
     ;--------------------
 
 .options_parsed:
@@ -164,9 +221,33 @@ section .text
     mov     [rsp+.file_idx], eax
 
     mov     ecx, [rsp+.argc]
-    cmp     ecx, optind
+    sub     ecx, eax
+    mov     [rsp+.files], rcx
     je      .read_stdin ; No file arg specified.
 
+    ;--------------------
+    ; There is nothing to read ahead if no data is to be displayed.
+
+    cmp     qword [rsp+.threads], 0
+    je      .next_file
+
+    cmp     qword [rsp+.amount], 0
+    je      .next_file
+
+    mov     rdi, [rsp+.argv]
+    lea     rdi, [rdi+rax*PTR_SIZE]
+    mov     rsi, [rsp+.files]
+    mov     rdx, [rsp+.threads]
+    mov     rcx, [rsp+.amount]
+    mov     r8, [rsp+.use_bytes]
+
+    dcall   head_parallel
+    cmp     rax, 1
+    jne     .out
+
+    ; The reader threads could not be started, so handle the files
+    ; one at a time.
+
 .next_file:
     mov     ecx, [rsp+.file_idx]
     cmp     ecx, [rsp+.argc]
@@ -179,7 +260,15 @@ section .text
     add     rdi, rax
     mov     rdi, [rdi]
 
-    ; FIXME: TODO: support magic "-" file (meaning stdin).
+    ; Check if the stdin alias has been specified (exactly "-").
+    mov     qword [rsp+.fd_in], STDIN_FD
+
+    cmp     byte [rdi], stdin_filename
+    jne     .open_file
+
+    cmp     byte [rdi+1], 0
+    je      .opened
+
 .open_file:
     mov     rsi, O_RDONLY
     dcall   open
@@ -189,17 +278,36 @@ section .text
     ; Save fd
     mov     [rsp+.fd_in], rax
 
-    mov     rdi, rax
+.opened:
+    cmp     qword [rsp+.files], 1
+    je      .no_header
+
+    ; Display the header (this is the first file if the index is still
+    ; optind).
+    mov     ecx, [rsp+.file_idx]
+    mov     rdi, [rsp+.argv]
+    mov     rdi, [rdi+rcx*PTR_SIZE]
+
+    xor     esi, esi
+    cmp     ecx, [optind]
+    sete    sil
+
+    dcall   head_header
+    cmp     rax, 0
+    jl      .error_close
+
+.no_header:
+    mov     rdi, [rsp+.fd_in]
     mov     rsi, [rsp+.amount]
     mov     rdx, [rsp+.use_bytes]
 
     dcall   head
     cmp     rax, 0
-    jl      .error
+    jl      .error_close
 
 .close_file:
     mov     rdi, [rsp+.fd_in]
-    cmp     rdi, 0 ; Is the file stdin?
+    cmp     rdi, STDIN_FD ; Is the file stdin?
     je      .dont_close_file
 
     dcall   close
@@ -217,7 +325,7 @@ section .text
     mov     rax, 0
 
 .out:
-    epilogue_with_vars 6
+    epilogue_with_vars 8
 
     ret
 
@@ -244,7 +352,246 @@ section .text
     mov     rax, CMD_BAD_ARG
     jmp     .out
 
+.error_close:
+    mov     rdi, [rsp+.fd_in]
+    cmp     rdi, STDIN_FD
+    je      .error
+
+    dcall   close
+
+.error:
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the top of the specified files, reading up to
+;   the specified number of them at the same time.
+;
+; C prototype equivalent:
+;
+;     int head_parallel(char **paths, size_t count, size_t threads,
+;                       size_t amount, bool use_bytes);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of file paths ("-" for stdin).
+; - Input: RSI (integer) - number of paths.
+; - Input: RDX (integer) - maximum number of files to read at once.
+; - Input: RCX (integer) - Amount of bytes or lines (>0).
+; - Input: R8 (bool) - if true, treat amount as bytes, else lines.
+; - Output: RAX (integer) - CMD_OK on success, CMD_BAD_ARG if a file
+;   could not be opened, CMD_FAILED on error, or 1 if the reader
+;   threads could not be started (in which case nothing has been
+;   read).
+;
+; Notes:
+;
+; - The files are read by a pool of threads (see prefetch_start()),
+;   but handled strictly in argument order by the same handlers as
+;   head(), so the output (including the headers) is the same as for
+;   the sequential mode.
+;
+; - As soon as the handler has displayed enough of a file, its reader
+;   is told to stop. With '-c', the readers do not read beyond the
+;   amount requested in the first place.
+;
+; See: prefetch.asm.
+;---------------------------------------------------------------------
+
+head_parallel:
+    prologue_with_vars 4
+
+    alloc_space (Prefetch_size + Block_size)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .ret        equ     0   ; return value.
+    .bytes      equ     8   ; ssize_t: amount of data read.
+    .handler    equ    16   ; void *: function pointer
+    .unused     equ    24   ; padding.
+    .pf         equ    32   ; Prefetch_size bytes.
+    .block      equ    (.pf + Prefetch_size) ; Block_size bytes.
+
+    ;--------------------
+    ; Setup
+
+    ; Assume failure. Pessimistic but safe.
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    lea     rbx, [rsp+.pf]
+    mov     [rbx+Prefetch.paths], rdi
+    mov     [rbx+Prefetch.count], rsi
+    mov     [rbx+Prefetch.nthreads], rdx
+    mov     qword [rbx+Prefetch.limit], 0 ; Default.
+    mov     qword [rbx+Prefetch.max_bytes], 0 ; All of each file.
+
+    lea     rax, [rsp+.block]
+    mov     [rax+Block.amount], rcx
+
+    mov     qword [rsp+.handler], head_handle_lines
+
+    cmp     r8, 0
+    je      .selected_handler
+
+    mov     qword [rsp+.handler], head_handle_bytes
+    mov     [rbx+Prefetch.max_bytes], rcx
+
+.selected_handler:
+    mov     rdi, rbx
+    dcall   prefetch_start
+    cmp     rax, 0
+    jne     .not_started
+
+    ;--------------------
+
+.next_file:
+    ; Get the first block before displaying the header, since there
+    ; is no header for a file that cannot be opened.
+    lea     rdi, [rsp+.pf]
+    lea     rsi, [rsp+.block+Block.buffer]
+    dcall   prefetch_read
+    mov     [rsp+.bytes], rax
+
+    cmp     rax, PREFETCH_OPEN_FAILED
+    je      .error_open
+
+    lea     rbx, [rsp+.pf]
+    cmp     qword [rbx+Prefetch.count], 1
+    je      .no_header
+
+    mov     rax, [rbx+Prefetch.turn]
+    mov     rdi, [rbx+Prefetch.paths]
+    mov     rdi, [rdi+rax*PTR_SIZE]
+
+    xor     esi, esi
+    cmp     rax, 0
+    sete    sil
+
+    dcall   head_header
+    cmp     rax, 0
+    jl      .end
+
+.no_header:
+    lea     rax, [rsp+.block]
+    mov     qword [rax+Block.num], 0
+    mov     qword [rax+Block.data], 0
+    mov     qword [rax+Block.done], 0
+
+.handle_block:
+    mov     rax, [rsp+.bytes]
+    cmp     rax, 0
+    je      .file_done ; EOF.
+    jl      .end       ; Read error.
+
+    lea     rdi, [rsp+.block]
+    mov     [rdi+Block.bytes], rax
+
+    ; Call handler
+    mov     rax, [rsp+.handler]
+    dcall   rax
+
+    cmp     rax, 0
+    jl      .end
+
+    lea     rbx, [rsp+.block]
+
+    ; Check if handler signalled completion
+    cmp     qword [rbx+Block.done], 1
+    je      .file_done
+
+    inc     qword [rbx+Block.num]
+
+    lea     rdi, [rsp+.pf]
+    lea     rsi, [rsp+.block+Block.buffer]
+    dcall   prefetch_read
+    mov     [rsp+.bytes], rax
+
+    jmp     .handle_block
+
+.file_done:
+    ; Stops the file's reader (if it is still going).
+    lea     rdi, [rsp+.pf]
+    dcall   prefetch_next
+
+    lea     rbx, [rsp+.pf]
+    mov     rax, [rbx+Prefetch.turn]
+    cmp     rax, [rbx+Prefetch.count]
+    jb      .next_file
+
+    mov     qword [rsp+.ret], CMD_OK
+
+.end:
+    lea     rdi, [rsp+.pf]
+    dcall   prefetch_end
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (Prefetch_size + Block_size)
+    epilogue_with_vars 4
+    ret
+
+.error_open:
+    mov     qword [rsp+.ret], CMD_BAD_ARG
+    jmp     .end
+
+.not_started:
+    mov     qword [rsp+.ret], 1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the header shown before each file when
+;   multiple files are specified.
+;
+; C prototype equivalent:
+;
+;     int head_header(const char *path, bool first);
+;
+; Parameters:
+;
+; - Input: RDI (string) - path of file ("-" for stdin).
+; - Input: RSI (bool) - true for the first file (which is not
+;   separated from the previous file by a blank line).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+head_header:
+section .rodata
+    .header_fmt     db  10,"==> %s <==",10,0
+    .stdin_name     db  "standard input",0
+section .text
+    prologue_with_vars 0
+
+    mov     rdx, rdi
+
+    cmp     byte [rdx], stdin_filename
+    jne     .not_stdin
+
+    cmp     byte [rdx+1], 0
+    jne     .not_stdin
+
+    mov     rdx, .stdin_name
+
+.not_stdin:
+    ; Skip the leading blank line for the first file.
+    mov     rax, .header_fmt
+    add     rsi, rax
+    mov     rdi, STDOUT_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    cmp     eax, 0
+    jl      .error
+
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 0
+    ret
+
 .error:
+    mov     rax, -1
     jmp     .out
 
 ;---------------------------------------------------------------------
@@ -268,12 +615,11 @@ section .text
 ;   block to a handler: a bytes handler if use_bytes is true, else a line
 ;   handler. The handler has the following prototype:
 ;
-;     int head_handler(int fd, Block *block);
+;     int head_handler(Block *block);
 ;
 ;     Handler parameters:
 ;
-;     - Input: RDI (int) - File descriptor.
-;     - Input: RSI (Block *) - Block to handle.
+;     - Input: RDI (Block *) - Block to handle.
 ;     - Output: RAX (integer) - 0 on success, or -1 on error.
 ;
 ; - The caller is responsible for closing the fd on error.
@@ -287,10 +633,10 @@ head:
     ; This many auto-allocated variable...
     prologue_with_vars 6
 
-    ; ... plus a manually allocated one.
+    ; ... plus manually allocated ones.
     ;
-    ; Allocate space for Block
-    alloc_space Block_size
+    ; Allocate space for Block and the read buffer.
+    alloc_space (Block_size + IO_READ_BUF_SIZE)
 
     ;--------------------
     ; Stack offsets.
@@ -302,6 +648,7 @@ head:
     .handler    equ    40   ; void *: function pointer
 
     .block      equ    48   ; Block_size bytes.
+    .buffer     equ    (.block + Block_size) ; IO_READ_BUF_SIZE bytes.
 
     ;--------------------
 
@@ -329,6 +676,8 @@ head:
     lea     rax, [rsp+.block]   ; Get Block pointer
 
     mov     qword [rax+Block.amount], rsi
+    lea     rcx, [rsp+.buffer]
+    mov     qword [rax+Block.buffer], rcx
     mov     qword [rax+Block.num], 0
     mov     qword [rax+Block.data], 0
     mov     qword [rax+Block.done], 0
@@ -349,8 +698,7 @@ head:
 .read_next_block:
     mov     rdi, [rsp+.fd_in]
 
-    lea     rax, [rsp+.block]   ; Get Block pointer
-    lea     rsi, [rax+Block.buffer]
+    lea     rsi, [rsp+.buffer]
     mov     rdx, IO_READ_BUF_SIZE
 
     dcall   read_block
@@ -388,7 +736,7 @@ head:
     ; Set return value
     mov     rax, [rsp+.ret]
 
-    free_space  Block_size
+    free_space  (Block_size + IO_READ_BUF_SIZE)
     epilogue_with_vars 6
     ret
 
@@ -411,6 +759,9 @@ head:
 ;
 ; Notes:
 ;
+; - Block.done is set as soon as the requested amount has been
+;   displayed, so no further (possibly blocking) read is attempted.
+;
 ; Limitations:
 ;
 ; See:
@@ -418,8 +769,7 @@ head:
 ;---------------------------------------------------------------------
 
 head_handle_bytes:
-    prologue_with_vars 1
-    alloc_space      Block_size
+    prologue_with_vars 2
 
     ;--------------------
     ; Stack offsets.
@@ -443,42 +793,25 @@ head_handle_bytes:
     cmp         qword [rdi+Block.done], 1
     je          .success
 
-    ; Check if we've handled all the data we've been asked to.
-    mov         rax, [rdi+Block.amount]
-    cmp         rax, [rdi+Block.data]
-    jne         .more_data_to_process
-
-    mov         qword [rdi+Block.done], 1
-    jmp         .success
-
-.more_data_to_process:
-
     ; Calculate remaining bytes to handle
+    mov         rax, [rdi+Block.amount]
     sub         rax, [rdi+Block.data]
 
-    ; Compare remaining bytes with bytes in block
+    ; Display the smaller of the remaining bytes and the block.
     cmp         rax, [rdi+Block.bytes]
-    jl          .show_partial_buffer
+    jbe         .calculated_bytes_to_write
 
-    ; show full buffer
     mov         rax, [rdi+Block.bytes]
-    mov         [rsp+.show_bytes], rax
-    jmp         .calculted_bytes_to_write
 
-.show_partial_buffer:
+.calculated_bytes_to_write:
     mov         [rsp+.show_bytes], rax
 
-.calculted_bytes_to_write:
-
-    ; if (remaining >= bytes)
-    ;     write_block(entire)
-    ; else
-    ;     write_block(partial)
+    cmp         rax, 0
+    je          .check_done
 
     mov         rdi, STDOUT_FD
-
     mov         rax, [rsp+.block]
-    lea         rsi, [rax+Block.buffer]
+    mov         rsi, [rax+Block.buffer]
     mov         rdx, [rsp+.show_bytes]
 
     dcall       write_block
@@ -488,12 +821,20 @@ head_handle_bytes:
     mov         rbx, [rsp+.block]   ; Get Block pointer
     add         [rbx+Block.data], rax
 
+.check_done:
+    ; Check if we've handled all the data we've been asked to.
+    mov         rbx, [rsp+.block]
+    mov         rax, [rbx+Block.amount]
+    cmp         rax, [rbx+Block.data]
+    jne         .success
+
+    mov         qword [rbx+Block.done], 1
+
 .success:
     mov         rax, CMD_OK
 
 .out:
-    free_space  Block_size
-    epilogue_with_vars 1
+    epilogue_with_vars 2
     ret
 
 .error:
@@ -515,6 +856,13 @@ head_handle_bytes:
 ;
 ; Notes:
 ;
+; - The end of the last line to display is found with memchr(3)
+;   (which only looks at the Block.bytes bytes of the block), then all
+;   the lines in the block are displayed with a single write.
+;
+; - A partial line at the end of a block is displayed and counted
+;   when its NL is found in a later block.
+;
 ; Limitations:
 ;
 ; See:
@@ -523,15 +871,13 @@ head_handle_bytes:
 
 head_handle_lines:
     prologue_with_vars 3
-    alloc_space      Block_size
 
     ;--------------------
     ; Stack offsets.
 
-    .show_lines equ     0   ; size_t: Number of lines to display for this call.
-    .start      equ     8   ; "char *": Address of start of line in .block.buffer.
-    .end        equ    16   ; "char *": Address of end of line in .block.buffer.
-    .block      equ    24   ; "Block *"
+    .start      equ     0   ; "char *": Address of start of data in .block.buffer.
+    .end        equ     8   ; "char *": Address after the data to display.
+    .block      equ    16   ; "Block *"
 
     ;--------------------
 
@@ -546,9 +892,10 @@ head_handle_lines:
     ;--------------------
     ; Setup
 
-    ; start = Block->buffer;
-    lea         rax, [rdi+Block.buffer]
+    ; start = end = Block->buffer;
+    mov         rax, [rdi+Block.buffer]
     mov         [rsp+.start], rax
+    mov         [rsp+.end], rax
 
     ;--------------------
     ; Checks
@@ -556,81 +903,54 @@ head_handle_lines:
     cmp         qword [rdi+Block.done], 1
     je          .success
 
-    ; Check if we've handled all the data we've been asked to.
-    mov         rax, [rdi+Block.amount]
-    cmp         rax, [rdi+Block.data]
-    jne         .more_data_to_process
-
-    mov         qword [rdi+Block.done], 1
-    jmp         .success
-
-.more_data_to_process:
 .next_line:
-
-    mov         rdi, [rsp+.start]
+    ; Check if we've handled all the lines we've been asked to.
+    mov         rbx, [rsp+.block]
+    mov         rax, [rbx+Block.amount]
+    cmp         rax, [rbx+Block.data]
+    jne         .find_line
+
+    ; We've found all the lines requested, so signal the caller.
+    mov         qword [rbx+Block.done], 1
+    jmp         .display
+
+.find_line:
+    ; Search the rest of the block: (buffer + bytes) - end.
+    mov         rdx, [rbx+Block.buffer]
+    add         rdx, [rbx+Block.bytes]
+    sub         rdx, [rsp+.end]
+    je          .display
+
+    mov         rdi, [rsp+.end]
     mov         esi, NL
 
-    dcall       asm_strchr
-
-    mov         [rsp+.end], rax
-
-    ; If strchr returns NULL, there are no more (full) lines remaining
-    ; in the block, so try to handle a final partial line (without a
-    ; trailing NL).
+    dcall       memchr
     cmp         rax, 0
+    je          .partial_line
 
-    je          .handle_partial_block
-
-    ;------------------------------
-    ; Handle complete line
-
-    ; Calculate bytes in line
-    sub         rax, [rsp+.start]
-
-    inc         rax ; Also include the NL we just found in the output.
-
-    mov         rdx, rax ; bytes to display
-    mov         rdi, STDOUT_FD
-
-    mov         rsi, [rsp+.start]
-
-    dcall       write_block
-
-    ; Jump over the already displayed NL
-    inc         qword [rsp+.end]
-
-    ; Set start = end.
-    mov         rax, [rsp+.end]
-    mov         [rsp+.start], rax
+    ; Include the NL in the output.
+    inc         rax
+    mov         [rsp+.end], rax
 
     ; Increment number of lines displayed count.
-    mov         rax, [rsp+.block]
-    inc         qword [rax+Block.data]
+    mov         rbx, [rsp+.block]
+    inc         qword [rbx+Block.data]
 
-    mov         rbx, [rax+Block.amount]
-    cmp         rbx, [rax+Block.data]
-    jne         .next_line
+    jmp         .next_line
 
-    ; We've displayed all the lines requested,
-    ; so signal the caller.
-    mov         qword [rax+Block.done], 1
-    jmp         .success
-
-.handle_partial_block:
-    mov         rax, [rsp+.end]
-    cmp         rax, 0
-    jne         .error ; We expect end to be null for a partial block.
-
-    ; Set end to the end byte of the buffer
-    ; (buffer address + bytes)
-    mov         rax, [rsp+.block]
-    mov         rbx, [rax+Block.buffer]
-    add         rbx, [rax+Block.bytes]
-    mov         [rsp+.end], rbx
+.partial_line:
+    ; No more (complete) lines remaining in the block, so display the
+    ; start of the next line too.
+    mov         rbx, [rsp+.block]
+    mov         rax, [rbx+Block.buffer]
+    add         rax, [rbx+Block.bytes]
+    mov         [rsp+.end], rax
 
+.display:
     ; Calculate bytes to display (end - start)
-    mov         rdx, rbx
+    mov         rdx, [rsp+.end]
     sub         rdx, [rsp+.start]
+    je          .success
 
     mov         rdi, STDOUT_FD
     mov         rsi, [rsp+.start]
@@ -645,7 +965,6 @@ head_handle_lines:
     mov         rax, CMD_OK
 
 .out:
-    add         rsp, Block_size
     epilogue_with_vars 3
     ret
 
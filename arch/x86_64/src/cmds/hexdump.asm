@@ -0,0 +1,229 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_hexdump
+global command_hexdump
+
+extern arena_alloc
+extern asm_getopt
+extern hexfmt_files
+extern hexfmt_init
+extern hexfmt_parse_bytes
+
+extern dprintf
+extern optarg
+
+extern optind
+
+%include "header.inc"
+%include "hexfmt.inc"
+
+cold_rodata
+command_help_hexdump:  db  "see hexdump(1)",10, \
+                           10, \
+                           "Usage: hexdump [-Cv] [-n LENGTH] [-s OFFSET] [FILE]...",10, \
+                           10, \
+                           "Options:",10, \
+                           10, \
+                           "-C        : Canonical hex+ASCII display (the only format supported).",10, \
+                           "-n LENGTH : Show at most LENGTH input bytes.",10, \
+                           "-s OFFSET : Skip OFFSET input bytes first.",10, \
+                           "-v        : Show repeated lines (rather than '*').",0
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `hexdump` command.
+;
+; C prototype equivalent:
+;
+;     int command_hexdump(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, else -1.
+;
+; Notes:
+;
+; - The output is formatted by hexfmt_files().
+;
+; - LENGTH and OFFSET values may be given in hex ("0x" prefix) or
+;   octal ("0" prefix).
+;
+; Limitations:
+;
+; - Only the canonical ('-C') format is supported (so it is also the
+;   default).
+; - LENGTH and OFFSET values do not support suffixes.
+;
+; See: hexdump(1).
+;---------------------------------------------------------------------
+
+command_hexdump:
+section .rodata
+    .optstring          db  "Cn:s:v",0
+    .canonical_opt      equ 'C'
+    .length_opt         equ 'n'
+    .offset_opt         equ 's'
+    .verbose_opt        equ 'v'
+
+    .name               db  "hexdump",0
+cold_rodata
+    .nomem_msg          db  "hexdump: cannot allocate memory",10,0
+    .length_fmt         db  "hexdump: invalid length: '%s'",10,0
+    .offset_fmt         db  "hexdump: invalid offset: '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .hf             equ     16  ; "HexFmt *"
+    .ret            equ     24  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     rdi, HexFmt_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.hf], rax
+
+    mov     rdi, rax
+    dcall   hexfmt_init
+    cmp     rax, 0
+    jne     .error_nomem
+
+    ;--------------------
+    ; Set defaults
+
+    mov     rbx, [rsp+.hf]
+
+    mov     qword [rbx+HexFmt.name], .name
+    mov     qword [rbx+HexFmt.style], HEXFMT_STYLE_CANONICAL
+    mov     qword [rbx+HexFmt.radix], 16
+    mov     qword [rbx+HexFmt.width], 8
+    mov     qword [rbx+HexFmt.flags], HEXFMT_OMIT_EMPTY_END
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .canonical_opt
+    je      .next_arg
+
+    cmp     al, .length_opt
+    je      .handle_length_opt
+
+    cmp     al, .offset_opt
+    je      .handle_offset_opt
+
+    cmp     al, .verbose_opt
+    je      .handle_verbose_opt
+
+    jmp     .error_bad_option
+
+.handle_length_opt:
+    mov     rdi, [optarg]
+    dcall   hexfmt_parse_bytes
+    cmp     rax, 0
+    jl      .error_length
+
+    mov     [rbx+HexFmt.limit], rax
+    jmp     .next_arg
+
+.handle_offset_opt:
+    mov     rdi, [optarg]
+    dcall   hexfmt_parse_bytes
+    cmp     rax, 0
+    jl      .error_offset
+
+    mov     [rbx+HexFmt.skip], rax
+    jmp     .next_arg
+
+.handle_verbose_opt:
+    or      qword [rbx+HexFmt.flags], HEXFMT_VERBOSE
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+
+    mov     rdx, [rsp+.argc]
+    sub     rdx, rax
+
+    mov     rsi, [rsp+.argv]
+    lea     rsi, [rsi+rax*PTR_SIZE]
+    mov     rdi, rbx
+    dcall   hexfmt_files
+    cmp     rax, 0
+    je      .out
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_nomem:
+    mov     rdi, STDERR_FD
+    mov     rsi, .nomem_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_length:
+    mov     rsi, .length_fmt
+    jmp     .error_value
+
+.error_offset:
+    mov     rsi, .offset_fmt
+
+.error_value:
+    mov     rdi, STDERR_FD
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
@@ -26,11 +26,11 @@ extern write
 
 extern optind
 
-section .rodata
-command_help_ln:  db  "see ln(1)",0
-
 %include "header.inc"
 
+cold_rodata
+command_help_ln:  db  "see ln(1)",0
+
 section .text
 
 ;---------------------------------------------------------------------
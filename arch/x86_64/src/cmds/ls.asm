@@ -0,0 +1,2970 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_ls
+global command_ls
+
+extern asm_getopt
+extern asm_strlen
+extern arena_alloc
+extern arena_alloc_aligned
+extern arena_free
+extern arena_mark
+extern arena_release
+extern write_block
+
+extern close
+extern dprintf
+extern getgrgid
+extern getpwuid
+extern localtime_r
+extern memcpy
+extern open
+extern pthread_create
+extern pthread_join
+extern qsort
+extern readlinkat
+extern snprintf
+extern statx
+extern strcmp
+extern strftime
+extern strncpy
+extern time
+extern tzset
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_ls:  db  "see ls(1)",10, \
+                      10, \
+                      "Options:",10, \
+                      10, \
+                      "-1 : List one entry per line (the default).",10, \
+                      "-R : List subdirectories recursively.",10, \
+                      "-S : Sort by size (largest first).",10, \
+                      "-U : Do not sort (list entries in directory order).",10, \
+                      "-a : Include entries starting with '.'.",10, \
+                      "-l : Use the long listing format.",10, \
+                      "-t : Sort by modification time (newest first).",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign LS_ALL                  (1 << 0)
+%assign LS_LONG                 (1 << 1)
+%assign LS_RECURSIVE            (1 << 2)
+
+; Sort orders (the last of -S, -t and -U specified wins).
+%assign LS_SORT_NAME            0
+%assign LS_SORT_NONE            1
+%assign LS_SORT_SIZE            2
+%assign LS_SORT_TIME            3
+
+; Fields needed for the long listing format.
+%assign LS_LONG_MASK            (STATX_TYPE|STATX_MODE|STATX_NLINK|STATX_UID|STATX_GID|STATX_SIZE|STATX_BLOCKS|STATX_MTIME)
+
+; Permission bits not defined in header.inc.
+%assign LS_S_ISUID              4000o
+%assign LS_S_ISGID              2000o
+%assign LS_S_ISVTX              1000o
+
+; Size of the getdents64(2) buffer: large enough that a directory
+; with a million entries needs only a few dozen system calls.
+%assign LS_DENTS_BUF_SIZE       (1024 * 1024)
+
+%assign LS_OUT_BUF_SIZE         (64 * 1024)
+
+; Size of the buffer a long format line is built in (big enough for
+; the name and the target of a symbolic link).
+LS_LINE_SIZE                    equ     (PATH_MAX * 2)
+
+; Entries are allocated from chunks of this size (so that adding an
+; entry is just a pointer bump).
+%assign LS_CHUNK_SIZE           (256 * 1024)
+
+; Initial size of the item array (doubled as required).
+%assign LS_MIN_ITEMS            1024
+
+; Entries are passed to statx(2) in batches of this size, and
+; directories with fewer than two batches are handled by the calling
+; thread alone.
+%assign LS_STAT_BATCH           256
+
+; Maximum number of threads calling statx(2) (including the calling
+; thread).
+%assign LS_MAX_THREADS          16
+
+%assign LS_NAME_SIZE            64
+
+; Files modified more than this many seconds ago (an average
+; Gregorian half year), or in the future, are shown with the year
+; rather than the time.
+%assign LS_SIX_MONTHS           15778476
+
+;---------------------------------------------------------------------
+; A directory entry (or a command-line file).
+;
+; Entries are variable length (the name is stored inline) and 8 byte
+; aligned, with at least 8 bytes of name space, so the first 8 bytes
+; of the name can always be loaded in one go.
+;---------------------------------------------------------------------
+struc LsEntry
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .stat       resq    1 ; "LsStat *": (NULL if statx(2) not called).
+    .len        resd    1 ; uint32_t: length of name.
+    .type       resd    1 ; uint32_t: DT_* value.
+    .name       resb    1 ; Start of null-terminated name.
+endstruc
+
+; An element of the array that is sorted.
+struc LsItem
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .key        resq    1 ; uint64_t: sort key.
+    .entry      resq    1 ; "LsEntry *"
+endstruc
+
+; The fields of a Statx that are used.
+struc LsStat
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .size       resq    1 ; uint64_t
+    .blocks     resq    1 ; uint64_t: number of 512 byte blocks.
+    .mtime      resq    1 ; int64_t: seconds.
+    .mtime_nsec resd    1 ; uint32_t: nanoseconds.
+    .mode       resd    1 ; uint32_t
+    .nlink      resd    1 ; uint32_t
+    .uid        resd    1 ; uint32_t
+    .gid        resd    1 ; uint32_t
+    .rdev_major resd    1 ; uint32_t
+    .rdev_minor resd    1 ; uint32_t
+    .failed     resd    1 ; bool: statx(2) failed (the other fields are invalid).
+endstruc
+
+;---------------------------------------------------------------------
+; The entries of a directory (or the command-line files).
+;---------------------------------------------------------------------
+struc LsDir
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .path       resq    1 ; "char *": directory (NULL for the command-line files).
+    .fd         resq    1 ; int: directory fd (or AT_FDCWD).
+    .stat_flags resq    1 ; AT_* flags for statx(2).
+    .mask       resq    1 ; STATX_* fields required (0 if none).
+    .items      resq    1 ; "LsItem *"
+    .count      resq    1 ; size_t: number of items.
+    .capacity   resq    1 ; size_t: size of .items.
+    .chunk      resq    1 ; "char *": chunk entries are allocated from.
+    .chunk_used resq    1 ; size_t: bytes of .chunk used.
+    .stats      resq    1 ; "LsStat *": one per item (in the original order).
+    .next       resq    1 ; size_t: index of next item to stat (atomic).
+    .error      resq    1 ; bool: set if statx(2) failed for any item.
+endstruc
+
+; The most recent user or group name looked up.
+struc LsIdCache
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .id         resq    1 ; uid_t / gid_t (-1 for none).
+    .name       resb    LS_NAME_SIZE
+endstruc
+
+struc LsState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .flags          resq    1 ; LS_* bitmask.
+    .sort           resq    1 ; LS_SORT_* value.
+    .mask           resq    1 ; STATX_* fields required for each entry.
+    .dents          resq    1 ; "char *": getdents64(2) buffer.
+    .out            resq    1 ; "char *": output buffer.
+    .out_len        resq    1 ; size_t: bytes in .out.
+    .line           resq    1 ; "char *": LS_LINE_SIZE bytes.
+    .now            resq    1 ; time_t: current time.
+    .headers        resq    1 ; bool: show "directory:" headers.
+    .listed         resq    1 ; bool: something has been listed.
+    .error          resq    1 ; bool: set if anything failed.
+
+    ; Column widths for the long listing format.
+    .nlink_width    resq    1
+    .owner_width    resq    1
+    .group_width    resq    1
+    .size_width     resq    1
+
+    .owner          resb    LsIdCache_size
+    .group          resb    LsIdCache_size
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: List directory contents.
+;
+; Notes:
+;
+; - Directories are read with getdents64(2) into a large buffer.
+;
+; - statx(2) is only called if the output format or sort order needs
+;   it, and only for the fields required. For big directories, the
+;   calls are spread over a pool of threads.
+;
+; - Entries are sorted with a radix sort (see ls_sort()).
+;
+; - With -U (and without -l), names are written straight from the
+;   getdents64(2) buffer, so no memory is allocated per entry (except
+;   for subdirectories with -R).
+;
+; - With -R, the memory used for a directory is released once it and
+;   its subdirectories have been listed.
+;
+; Limitations:
+;
+; - Output is always one entry per line.
+; - The C locale is assumed for sorting.
+;---------------------------------------------------------------------
+
+command_ls:
+section .rodata
+    .optstring          db  "1RSUalt",0
+    .one_opt            equ '1'
+    .recursive_opt      equ 'R'
+    .size_opt           equ 'S'
+    .unsorted_opt       equ 'U'
+    .all_opt            equ 'a'
+    .long_opt           equ 'l'
+    .time_opt           equ 't'
+    .dot                db  ".",0
+cold_rodata
+    .access_fmt         db  "ls: cannot access '%s'",10,0
+    .alloc_fmt          db  "ls: out of memory",10,0
+section .text
+    prologue_with_vars 10
+
+    alloc_space Statx_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .state          equ     16  ; "LsState *"
+    .files          equ     24  ; "LsDir *": command-line files.
+    .dirs           equ     32  ; "LsDir *": command-line directories.
+    .i              equ     40  ; size_t: index.
+    .args           equ     48  ; size_t: number of non-option arguments.
+    .arg_flags      equ     56  ; AT_* flags for command-line files.
+    .name           equ     64  ; "char *": current argument.
+    .ret            equ     72  ; int: return value.
+    .stx            equ     80  ; Statx.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     rdi, LsState_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.state], rax
+
+    mov     rdi, rax
+    mov     rcx, LsState_size
+    xor     eax, eax
+    rep     stosb
+
+    mov     rbx, [rsp+.state] ; Preserved across calls.
+
+    mov     qword [rbx+LsState.owner+LsIdCache.id], -1
+    mov     qword [rbx+LsState.group+LsIdCache.id], -1
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .one_opt
+    je      .next_arg
+
+    cmp     al, .recursive_opt
+    je      .handle_recursive_opt
+
+    cmp     al, .size_opt
+    je      .handle_size_opt
+
+    cmp     al, .unsorted_opt
+    je      .handle_unsorted_opt
+
+    cmp     al, .all_opt
+    je      .handle_all_opt
+
+    cmp     al, .long_opt
+    je      .handle_long_opt
+
+    cmp     al, .time_opt
+    je      .handle_time_opt
+
+    jmp     .error_bad_option
+
+.handle_recursive_opt:
+    or      qword [rbx+LsState.flags], LS_RECURSIVE
+    jmp     .next_arg
+
+.handle_size_opt:
+    mov     qword [rbx+LsState.sort], LS_SORT_SIZE
+    jmp     .next_arg
+
+.handle_unsorted_opt:
+    mov     qword [rbx+LsState.sort], LS_SORT_NONE
+    jmp     .next_arg
+
+.handle_all_opt:
+    or      qword [rbx+LsState.flags], LS_ALL
+    jmp     .next_arg
+
+.handle_long_opt:
+    or      qword [rbx+LsState.flags], LS_LONG
+    jmp     .next_arg
+
+.handle_time_opt:
+    mov     qword [rbx+LsState.sort], LS_SORT_TIME
+    jmp     .next_arg
+
+.options_parsed:
+    ;--------------------
+    ; Work out which fields statx(2) must return.
+
+    xor     eax, eax
+    xor     edx, edx
+
+    test    qword [rbx+LsState.flags], LS_LONG
+    jz      .mask_size
+
+    mov     eax, LS_LONG_MASK
+
+    ; The long format shows symbolic links rather than what they
+    ; point to.
+    mov     edx, AT_SYMLINK_NOFOLLOW
+
+.mask_size:
+    mov     [rsp+.arg_flags], rdx
+
+    cmp     qword [rbx+LsState.sort], LS_SORT_SIZE
+    jne     .mask_time
+
+    or      eax, (STATX_TYPE|STATX_SIZE)
+
+.mask_time:
+    cmp     qword [rbx+LsState.sort], LS_SORT_TIME
+    jne     .mask_set
+
+    or      eax, (STATX_TYPE|STATX_MTIME)
+
+.mask_set:
+    mov     [rbx+LsState.mask], rax
+
+    ;--------------------
+    ; Buffers
+
+    mov     rdi, LS_DENTS_BUF_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rbx+LsState.dents], rax
+
+    mov     rdi, LS_OUT_BUF_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rbx+LsState.out], rax
+
+    mov     rdi, LS_LINE_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rbx+LsState.line], rax
+
+    test    qword [rbx+LsState.flags], LS_LONG
+    jz      .create_lists
+
+    dcall   tzset
+
+    mov     rdi, 0
+    dcall   time
+    mov     [rbx+LsState.now], rax
+
+.create_lists:
+    mov     rdi, 0
+    mov     rsi, AT_FDCWD
+    mov     rdx, [rsp+.arg_flags]
+    mov     rcx, [rbx+LsState.mask]
+    dcall   ls_new_dir
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.files], rax
+
+    ; Directories are always followed (but with -l, a symbolic link
+    ; to a directory is treated as a file).
+    mov     rdi, 0
+    mov     rsi, AT_FDCWD
+    mov     rdx, 0
+    mov     rcx, [rbx+LsState.mask]
+    dcall   ls_new_dir
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.dirs], rax
+
+    ;--------------------
+    ; Sort the arguments into files and directories.
+
+    mov     eax, [optind]
+    cdqe
+
+    mov     [rsp+.i], rax
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    mov     [rsp+.args], rcx
+
+    cmp     rcx, 1
+    ja      .show_headers
+
+    test    qword [rbx+LsState.flags], LS_RECURSIVE
+    jz      .check_args
+
+.show_headers:
+    mov     qword [rbx+LsState.headers], 1
+
+.check_args:
+    cmp     qword [rsp+.args], 0
+    jne     .next_path
+
+    mov     rdi, [rsp+.dirs]
+    mov     rsi, .dot
+    mov     rdx, 1
+    mov     rcx, DT_DIR
+    dcall   ls_add_entry
+    cmp     rax, 0
+    je      .error_alloc
+
+    jmp     .list
+
+.next_path:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.argc]
+    jae     .list
+
+    inc     qword [rsp+.i]
+
+    mov     rdx, [rsp+.argv]
+    mov     rsi, [rdx+rax*PTR_SIZE]
+    mov     [rsp+.name], rsi
+
+    mov     rdi, AT_FDCWD
+    mov     rdx, [rsp+.arg_flags]
+    mov     rcx, STATX_TYPE
+    lea     r8, [rsp+.stx]
+    dcall   statx
+    cmp     eax, 0
+    jne     .error_access
+
+    mov     rdi, [rsp+.name]
+    dcall   asm_strlen
+    mov     rdx, rax
+
+    ; DT_* value = (S_IF* >> 12)
+    movzx   ecx, word [rsp+.stx+Statx.stx_mode]
+    and     ecx, S_IFMT
+    shr     ecx, 12
+
+    mov     rdi, [rsp+.files]
+
+    cmp     ecx, DT_DIR
+    jne     .add_path
+
+    mov     rdi, [rsp+.dirs]
+
+.add_path:
+    mov     rsi, [rsp+.name]
+    dcall   ls_add_entry
+    cmp     rax, 0
+    je      .error_alloc
+
+    jmp     .next_path
+
+.error_access:
+    mov     rdi, STDERR_FD
+    mov     rsi, .access_fmt
+    mov     rdx, [rsp+.name]
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .next_path
+
+.list:
+    ;--------------------
+    ; Files are listed first, then the directories.
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.files]
+    dcall   ls_prepare
+    cmp     rax, 0
+    jne     .error_alloc
+
+    mov     rsi, [rsp+.files]
+    cmp     qword [rsi+LsDir.count], 0
+    je      .list_dirs
+
+    mov     rdi, rbx
+    mov     rdx, 0 ; Not a directory (so no total).
+    dcall   ls_print_entries
+
+    mov     qword [rbx+LsState.listed], 1
+
+.list_dirs:
+    mov     rdi, rbx
+    mov     rsi, [rsp+.dirs]
+    dcall   ls_prepare
+    cmp     rax, 0
+    jne     .error_alloc
+
+    mov     qword [rsp+.i], 0
+
+.next_dir:
+    mov     rcx, [rsp+.dirs]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rcx+LsDir.count]
+    jae     .done
+
+    inc     qword [rsp+.i]
+
+    shl     rax, 4 ; LsItem_size
+    add     rax, [rcx+LsDir.items]
+    mov     rax, [rax+LsItem.entry]
+
+    mov     rdi, rbx
+    lea     rsi, [rax+LsEntry.name]
+    dcall   ls_list_dir
+
+    jmp     .next_dir
+
+.done:
+    mov     rdi, rbx
+    dcall   ls_flush
+
+    cmp     qword [rbx+LsState.error], 0
+    je      .out
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space Statx_size
+    epilogue_with_vars 10
+    ret
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Create an empty list of entries.
+;
+; C prototype equivalent:
+;
+;     LsDir *ls_new_dir(char *path, int fd, int stat_flags,
+;                       unsigned int mask);
+;
+; Parameters:
+;
+; - Input: RDI (string) - directory path (or NULL).
+; - Input: RSI (integer) - directory fd (or AT_FDCWD).
+; - Input: RDX (integer) - AT_* flags for statx(2).
+; - Input: RCX (integer) - STATX_* fields required.
+; - Output: RAX (address) - LsDir, or NULL on error.
+;---------------------------------------------------------------------
+
+ls_new_dir:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .path       equ     0   ; "char *"
+    .fd         equ     8   ; int.
+    .stat_flags equ    16   ; int.
+    .mask       equ    24   ; unsigned int.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.path], rdi
+    mov     [rsp+.fd], rsi
+    mov     [rsp+.stat_flags], rdx
+    mov     [rsp+.mask], rcx
+
+    ;--------------------
+
+    mov     rdi, LsDir_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     rbx, rax
+
+    mov     rdi, rax
+    mov     rcx, LsDir_size
+    xor     eax, eax
+    rep     stosb
+
+    mov     rax, [rsp+.path]
+    mov     [rbx+LsDir.path], rax
+    mov     rax, [rsp+.fd]
+    mov     [rbx+LsDir.fd], rax
+    mov     rax, [rsp+.stat_flags]
+    mov     [rbx+LsDir.stat_flags], rax
+    mov     rax, [rsp+.mask]
+    mov     [rbx+LsDir.mask], rax
+
+    mov     rax, rbx
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Add an entry to a list.
+;
+; C prototype equivalent:
+;
+;     LsEntry *ls_add_entry(LsDir *dir, const char *name, size_t len,
+;                           unsigned int type);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsDir.
+; - Input: RSI (string) - name.
+; - Input: RDX (integer) - length of name.
+; - Input: RCX (integer) - DT_* value.
+; - Output: RAX (address) - new LsEntry, or NULL on error.
+;
+; Notes:
+;
+; The entry is allocated from the current chunk, so this only calls
+; the arena allocator when a chunk is full (or the item array needs
+; to grow).
+;---------------------------------------------------------------------
+
+ls_add_entry:
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .name       equ     0   ; "const char *"
+    .len        equ     8   ; size_t.
+    .type       equ    16   ; unsigned int.
+    .size       equ    24   ; size_t: bytes needed for the entry.
+    .entry      equ    32   ; "LsEntry *"
+    .items      equ    40   ; "LsItem *": new item array.
+    .capacity   equ    48   ; size_t: size of new item array.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.name], rsi
+    mov     [rsp+.len], rdx
+    mov     [rsp+.type], rcx
+
+    ;--------------------
+    ; size = align(LsEntry.name + len + 1, 8)
+    ;
+    ; Note: LsEntry.name + 1 + 7 >= 24 so the name space is always at
+    ; least 8 bytes.
+
+    lea     rax, [rdx+LsEntry.name+1+7]
+    and     rax, ~7
+    mov     [rsp+.size], rax
+
+    cmp     qword [rbx+LsDir.chunk], 0
+    je      .new_chunk
+
+    mov     rcx, [rbx+LsDir.chunk_used]
+    add     rcx, rax
+    cmp     rcx, LS_CHUNK_SIZE
+    jbe     .have_space
+
+.new_chunk:
+    mov     rdi, LS_CHUNK_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rbx+LsDir.chunk], rax
+    mov     qword [rbx+LsDir.chunk_used], 0
+
+.have_space:
+    mov     rax, [rbx+LsDir.chunk]
+    add     rax, [rbx+LsDir.chunk_used]
+    mov     [rsp+.entry], rax
+
+    mov     rcx, [rsp+.size]
+    add     [rbx+LsDir.chunk_used], rcx
+
+    mov     qword [rax+LsEntry.stat], 0
+    mov     ecx, [rsp+.len]
+    mov     [rax+LsEntry.len], ecx
+    mov     ecx, [rsp+.type]
+    mov     [rax+LsEntry.type], ecx
+
+    lea     rdi, [rax+LsEntry.name]
+    mov     rsi, [rsp+.name]
+    mov     rdx, [rsp+.len]
+    inc     rdx ; Include the terminator.
+    dcall   memcpy
+
+    ;--------------------
+    ; Add an item for the entry.
+
+    mov     rax, [rbx+LsDir.count]
+    cmp     rax, [rbx+LsDir.capacity]
+    jb      .add_item
+
+    mov     rcx, [rbx+LsDir.capacity]
+    shl     rcx, 1
+    jnz     .grow
+
+    mov     rcx, LS_MIN_ITEMS
+
+.grow:
+    mov     [rsp+.capacity], rcx
+
+    mov     rdi, rcx
+    shl     rdi, 4 ; LsItem_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.items], rax
+
+    cmp     qword [rbx+LsDir.items], 0
+    je      .grown
+
+    mov     rdi, rax
+    mov     rsi, [rbx+LsDir.items]
+    mov     rdx, [rbx+LsDir.count]
+    shl     rdx, 4 ; LsItem_size
+    dcall   memcpy
+
+    mov     rdi, [rbx+LsDir.items]
+    mov     rsi, [rbx+LsDir.capacity]
+    shl     rsi, 4 ; LsItem_size
+    dcall   arena_free
+
+.grown:
+    mov     rax, [rsp+.items]
+    mov     [rbx+LsDir.items], rax
+    mov     rax, [rsp+.capacity]
+    mov     [rbx+LsDir.capacity], rax
+
+.add_item:
+    mov     rax, [rbx+LsDir.count]
+    shl     rax, 4 ; LsItem_size
+    add     rax, [rbx+LsDir.items]
+
+    mov     qword [rax+LsItem.key], 0
+    mov     rcx, [rsp+.entry]
+    mov     [rax+LsItem.entry], rcx
+
+    inc     qword [rbx+LsDir.count]
+
+    mov     rax, rcx
+
+.out:
+    epilogue_with_vars 7
+    ret
+
+;---------------------------------------------------------------------
+; Description: List a directory (and, with -R, its subdirectories).
+;
+; C prototype equivalent:
+;
+;     void ls_list_dir(LsState *state, char *path);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (string) - directory path.
+; - Output: None.
+;
+; Notes:
+;
+; All the memory allocated for the directory is released before
+; returning, so the memory used depends on the depth of the tree
+; rather than its size.
+;---------------------------------------------------------------------
+
+ls_list_dir:
+section .rodata
+    .newline        db  10
+    .colon          db  ":",10
+cold_rodata
+    .open_fmt       db  "ls: cannot open directory '%s'",10,0
+    .alloc_fmt      db  "ls: out of memory",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "LsState *"
+    .path       equ     8   ; "char *"
+    .mark       equ    16   ; "void *": arena mark.
+    .dir        equ    24   ; "LsDir *"
+    .i          equ    32   ; size_t: index.
+    .streaming  equ    40   ; bool: names are written as they are read.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.state], rdi
+    mov     [rsp+.path], rsi
+
+    ;--------------------
+
+    dcall   arena_mark
+    mov     [rsp+.mark], rax
+
+    xor     eax, eax
+
+    cmp     qword [rbx+LsState.sort], LS_SORT_NONE
+    jne     .set_streaming
+
+    test    qword [rbx+LsState.flags], LS_LONG
+    jnz     .set_streaming
+
+    mov     eax, 1
+
+.set_streaming:
+    mov     [rsp+.streaming], rax
+
+    mov     rdi, [rsp+.path]
+    mov     rsi, -1
+    mov     rdx, AT_SYMLINK_NOFOLLOW
+    mov     rcx, [rbx+LsState.mask]
+    dcall   ls_new_dir
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.dir], rax
+
+    mov     rdi, [rsp+.path]
+    mov     rsi, (O_RDONLY|O_DIRECTORY|O_CLOEXEC)
+    dcall   open
+    cmp     eax, 0
+    jl      .error_open
+
+    cdqe
+    mov     rcx, [rsp+.dir]
+    mov     [rcx+LsDir.fd], rax
+
+    ;--------------------
+    ; Header (separated from any previous output by a blank line).
+
+    cmp     qword [rbx+LsState.headers], 0
+    je      .read
+
+    cmp     qword [rbx+LsState.listed], 0
+    je      .header
+
+    mov     rdi, rbx
+    mov     rsi, .newline
+    mov     rdx, 1
+    dcall   ls_write
+
+.header:
+    mov     rdi, [rsp+.path]
+    dcall   asm_strlen
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.path]
+    mov     rdx, rax
+    dcall   ls_write
+
+    mov     rdi, rbx
+    mov     rsi, .colon
+    mov     rdx, 2
+    dcall   ls_write
+
+.read:
+    mov     qword [rbx+LsState.listed], 1
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.dir]
+    mov     rdx, [rsp+.streaming]
+    dcall   ls_read_dir
+    cmp     rax, 0
+    jne     .close
+
+    cmp     qword [rsp+.streaming], 0
+    jne     .close
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.dir]
+    dcall   ls_prepare
+    cmp     rax, 0
+    jne     .error_alloc_close
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.dir]
+    mov     rdx, 1 ; Show the total.
+    dcall   ls_print_entries
+
+.close:
+    ; Close before recursing so the number of open files does not
+    ; depend on the depth of the tree.
+    mov     rax, [rsp+.dir]
+    mov     rdi, [rax+LsDir.fd]
+    dcall   close
+
+    test    qword [rbx+LsState.flags], LS_RECURSIVE
+    jz      .release
+
+    mov     qword [rsp+.i], 0
+
+.next_entry:
+    mov     rcx, [rsp+.dir]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rcx+LsDir.count]
+    jae     .release
+
+    inc     qword [rsp+.i]
+
+    shl     rax, 4 ; LsItem_size
+    add     rax, [rcx+LsDir.items]
+    mov     rsi, [rax+LsItem.entry]
+
+    cmp     dword [rsi+LsEntry.type], DT_DIR
+    jne     .next_entry
+
+    ;--------------------
+    ; Ignore "." and "..".
+
+    lea     rdx, [rsi+LsEntry.name]
+
+    cmp     byte [rdx], '.'
+    jne     .recurse
+
+    cmp     byte [rdx+1], 0
+    je      .next_entry
+
+    cmp     byte [rdx+1], '.'
+    jne     .recurse
+
+    cmp     byte [rdx+2], 0
+    je      .next_entry
+
+.recurse:
+    mov     rdi, [rsp+.path]
+    dcall   ls_join_path
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     rdi, rbx
+    mov     rsi, rax
+    dcall   ls_list_dir
+
+    jmp     .next_entry
+
+.release:
+    mov     rdi, [rsp+.mark]
+    dcall   arena_release
+
+    epilogue_with_vars 6
+    ret
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.path]
+    dcall   dprintf
+
+    mov     qword [rbx+LsState.error], 1
+    jmp     .release
+
+.error_alloc_close:
+    mov     rax, [rsp+.dir]
+    mov     rdi, [rax+LsDir.fd]
+    dcall   close
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    dcall   dprintf
+
+    mov     qword [rbx+LsState.error], 1
+    jmp     .release
+
+;---------------------------------------------------------------------
+; Description: Create the path of a subdirectory.
+;
+; C prototype equivalent:
+;
+;     char *ls_join_path(const char *path, LsEntry *entry);
+;
+; Parameters:
+;
+; - Input: RDI (string) - directory path.
+; - Input: RSI (address) - LsEntry.
+; - Output: RAX (string) - "path/name" (allocated from the arena), or
+;   NULL on error.
+;---------------------------------------------------------------------
+
+ls_join_path:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .path       equ     0   ; "const char *"
+    .entry      equ     8   ; "LsEntry *"
+    .len        equ    16   ; size_t: length of path.
+    .result     equ    24   ; "char *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.path], rdi
+    mov     [rsp+.entry], rsi
+
+    ;--------------------
+
+    dcall   asm_strlen
+    mov     [rsp+.len], rax
+
+    ; len + '/' + name + '\0'
+    mov     rcx, [rsp+.entry]
+    mov     edi, [rcx+LsEntry.len]
+    lea     rdi, [rdi+rax+2]
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.result], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.path]
+    mov     rdx, [rsp+.len]
+    dcall   memcpy
+
+    mov     rdi, [rsp+.result]
+    add     rdi, [rsp+.len]
+
+    cmp     qword [rsp+.len], 0
+    je      .add_separator
+
+    cmp     byte [rdi-1], '/'
+    je      .add_name
+
+.add_separator:
+    mov     byte [rdi], '/'
+    inc     rdi
+
+.add_name:
+    mov     rax, [rsp+.entry]
+    lea     rsi, [rax+LsEntry.name]
+    mov     edx, [rax+LsEntry.len]
+    inc     rdx ; Include the terminator.
+    dcall   memcpy
+
+    mov     rax, [rsp+.result]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Read the entries of a directory.
+;
+; C prototype equivalent:
+;
+;     int ls_read_dir(LsState *state, LsDir *dir, bool streaming);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (address) - LsDir (with an open fd).
+; - Input: RDX (integer) - if set, write the names as they are read
+;   and only add subdirectories to the LsDir (for -R).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+ls_read_dir:
+cold_rodata
+    .read_fmt       db  "ls: error reading directory '%s'",10,0
+    .alloc_fmt      db  "ls: out of memory",10,0
+section .text
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "LsState *"
+    .dir        equ     8   ; "LsDir *"
+    .streaming  equ    16   ; bool.
+    .bytes      equ    24   ; size_t: bytes in the dents buffer.
+    .offset     equ    32   ; size_t: offset of next dirent.
+    .name       equ    40   ; "char *"
+    .len        equ    48   ; size_t: length of name.
+    .type       equ    56   ; size_t: DT_* value.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.state], rdi
+    mov     [rsp+.dir], rsi
+    mov     [rsp+.streaming], rdx
+
+    ;--------------------
+
+.read_entries:
+    ; getdents64(fd, buf, size)
+    mov     rax, [rsp+.dir]
+    mov     rdi, [rax+LsDir.fd]
+    mov     rsi, [rbx+LsState.dents]
+    mov     rdx, LS_DENTS_BUF_SIZE
+    mov     rax, SYS_getdents64
+    syscall
+
+    cmp     rax, 0
+    je      .done
+    jl      .error_read
+
+    mov     [rsp+.bytes], rax
+    mov     qword [rsp+.offset], 0
+
+.next_entry:
+    mov     rax, [rsp+.offset]
+    cmp     rax, [rsp+.bytes]
+    jae     .read_entries
+
+    ; rcx = &dirent
+    mov     rcx, [rbx+LsState.dents]
+    add     rcx, rax
+
+    movzx   edx, word [rcx+Dirent64.d_reclen]
+    add     [rsp+.offset], rdx
+
+    movzx   eax, byte [rcx+Dirent64.d_type]
+    mov     [rsp+.type], rax
+
+    lea     rdi, [rcx+Dirent64.d_name]
+    mov     [rsp+.name], rdi
+
+    cmp     byte [rdi], '.'
+    jne     .visible
+
+    test    qword [rbx+LsState.flags], LS_ALL
+    jz      .next_entry
+
+.visible:
+    dcall   asm_strlen
+    mov     [rsp+.len], rax
+
+    cmp     qword [rsp+.streaming], 0
+    je      .add
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.name]
+    mov     rdx, [rsp+.len]
+    dcall   ls_write_line
+
+    test    qword [rbx+LsState.flags], LS_RECURSIVE
+    jz      .next_entry
+
+    cmp     qword [rsp+.type], DT_UNKNOWN
+    jne     .check_dir
+
+    mov     rdi, [rsp+.dir]
+    mov     rsi, [rsp+.name]
+    dcall   ls_entry_type
+    mov     [rsp+.type], rax
+
+.check_dir:
+    cmp     qword [rsp+.type], DT_DIR
+    jne     .next_entry
+
+.add:
+    mov     rdi, [rsp+.dir]
+    mov     rsi, [rsp+.name]
+    mov     rdx, [rsp+.len]
+    mov     rcx, [rsp+.type]
+    dcall   ls_add_entry
+    cmp     rax, 0
+    je      .error_alloc
+
+    ;--------------------
+    ; The type is only needed to recurse, and is set by
+    ; ls_stat_entries() if statx(2) will be called anyway.
+
+    cmp     dword [rax+LsEntry.type], DT_UNKNOWN
+    jne     .next_entry
+
+    test    qword [rbx+LsState.flags], LS_RECURSIVE
+    jz      .next_entry
+
+    mov     rdi, [rsp+.dir]
+    cmp     qword [rdi+LsDir.mask], 0
+    jne     .next_entry
+
+    mov     [rsp+.name], rax ; Now the entry.
+
+    lea     rsi, [rax+LsEntry.name]
+    dcall   ls_entry_type
+
+    mov     rcx, [rsp+.name]
+    mov     [rcx+LsEntry.type], eax
+
+    jmp     .next_entry
+
+.done:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 8
+    ret
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    mov     rax, [rsp+.dir]
+    mov     rdx, [rax+LsDir.path]
+    dcall   dprintf
+    jmp     .error
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    dcall   dprintf
+
+.error:
+    mov     qword [rbx+LsState.error], 1
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Find the type of a directory entry whose type was not
+;   returned by getdents64(2).
+;
+; C prototype equivalent:
+;
+;     unsigned int ls_entry_type(LsDir *dir, const char *name);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsDir.
+; - Input: RSI (string) - name.
+; - Output: RAX (integer) - DT_* value (DT_UNKNOWN on error).
+;---------------------------------------------------------------------
+
+ls_entry_type:
+    prologue_with_vars 0
+
+    alloc_space Statx_size
+
+    mov     rdi, [rdi+LsDir.fd]
+    mov     rdx, (AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT)
+    mov     rcx, STATX_TYPE
+    mov     r8, rsp
+    dcall   statx
+    cmp     eax, 0
+    jne     .error
+
+    movzx   eax, word [rsp+Statx.stx_mode]
+    and     eax, S_IFMT
+    shr     eax, 12
+    jmp     .out
+
+.error:
+    mov     rax, DT_UNKNOWN
+
+.out:
+    free_space Statx_size
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Get the details needed for, and sort, a list of
+;   entries.
+;
+; C prototype equivalent:
+;
+;     int ls_prepare(LsState *state, LsDir *dir);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (address) - LsDir.
+; - Output: RAX (integer) - 0 on success, or -1 if memory could not
+;   be allocated.
+;
+; Notes:
+;
+; Entries that cannot be statted are reported (and LsState.error is
+; set) but are not considered an error here.
+;---------------------------------------------------------------------
+
+ls_prepare:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "LsState *"
+    .dir        equ     8   ; "LsDir *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.dir], rsi
+
+    ;--------------------
+
+    cmp     qword [rsi+LsDir.mask], 0
+    je      .sort
+
+    mov     rdi, rsi
+    dcall   ls_stat_entries
+    cmp     rax, 0
+    jne     .out
+
+    mov     rsi, [rsp+.dir]
+    cmp     qword [rsi+LsDir.error], 0
+    je      .sort
+
+    mov     rdi, [rsp+.state]
+    mov     qword [rdi+LsState.error], 1
+
+.sort:
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.dir]
+    dcall   ls_sort
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Call statx(2) for all the entries of a list.
+;
+; C prototype equivalent:
+;
+;     int ls_stat_entries(LsDir *dir);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsDir.
+; - Output: RAX (integer) - 0 on success, or -1 if memory could not
+;   be allocated.
+;
+; Notes:
+;
+; - Only the LsDir.mask fields are requested.
+;
+; - For big directories, the entries are split into batches of
+;   LS_STAT_BATCH which are claimed by a pool of threads. Each call
+;   is cheap when the inodes are cached, but for a cold cache (or a
+;   network file system) the calls are mostly spent waiting, so
+;   having several outstanding at once hides most of the latency.
+;
+; See: ls_stat_worker().
+;---------------------------------------------------------------------
+
+ls_stat_entries:
+    prologue_with_vars 2
+
+    alloc_space (LS_MAX_THREADS * PTR_SIZE)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .threads    equ     0   ; size_t: number of threads to create.
+    .started    equ     8   ; size_t: number of threads created.
+    .tids       equ    16   ; pthread_t array.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rdi, [rbx+LsDir.count]
+    cmp     rdi, 0
+    je      .done
+
+    imul    rdi, rdi, LsStat_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rbx+LsDir.stats], rax
+    mov     qword [rbx+LsDir.next], 0
+
+    ;--------------------
+    ; threads = min(batches, LS_MAX_THREADS) - 1 (since this thread
+    ; calls statx(2) too).
+
+    mov     rcx, [rbx+LsDir.count]
+    shr     rcx, 8 ; / LS_STAT_BATCH
+    jz      .threads_ok
+
+    cmp     rcx, LS_MAX_THREADS
+    jbe     .threads_dec
+
+    mov     rcx, LS_MAX_THREADS
+
+.threads_dec:
+    dec     rcx
+
+.threads_ok:
+    mov     [rsp+.threads], rcx
+    mov     qword [rsp+.started], 0
+
+.start_thread:
+    mov     rax, [rsp+.started]
+    cmp     rax, [rsp+.threads]
+    jae     .threads_started
+
+    lea     rdi, [rsp+.tids+rax*PTR_SIZE]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, ls_stat_worker
+    mov     rcx, rbx
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .threads_started ; Make do with the threads we have.
+
+    inc     qword [rsp+.started]
+    jmp     .start_thread
+
+.threads_started:
+    mov     rdi, rbx
+    dcall   ls_stat_worker
+
+.join_thread:
+    cmp     qword [rsp+.started], 0
+    je      .done
+
+    dec     qword [rsp+.started]
+
+    mov     rax, [rsp+.started]
+    mov     rdi, [rsp+.tids+rax*PTR_SIZE]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+    jmp     .join_thread
+
+.done:
+    xor     rax, rax
+
+.out:
+    free_space (LS_MAX_THREADS * PTR_SIZE)
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Thread function that calls statx(2) for batches of
+;   entries until none remain.
+;
+; C prototype equivalent:
+;
+;     void *ls_stat_worker(LsDir *dir);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsDir.
+; - Output: RAX (address) - always NULL.
+;
+; Notes:
+;
+; Each entry gets the LsStat with the same index as its item (the
+; items have not been sorted yet). The LsEntry.type is also set.
+;---------------------------------------------------------------------
+
+ls_stat_worker:
+cold_rodata
+    .access_fmt     db  "ls: cannot access '%s'",10,0
+    .dir_access_fmt db  "ls: cannot access '%s/%s'",10,0
+section .text
+    prologue_with_vars 3
+
+    alloc_space Statx_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .i          equ     0   ; size_t: index of next item.
+    .end        equ     8   ; size_t: end of batch.
+    .entry      equ    16   ; "LsEntry *"
+    .stx        equ    24   ; Statx.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+.next_batch:
+    mov     rax, LS_STAT_BATCH
+    lock xadd [rbx+LsDir.next], rax
+
+    mov     rcx, [rbx+LsDir.count]
+    cmp     rax, rcx
+    jae     .done
+
+    mov     [rsp+.i], rax
+
+    add     rax, LS_STAT_BATCH
+    cmp     rax, rcx
+    jbe     .set_end
+
+    mov     rax, rcx
+
+.set_end:
+    mov     [rsp+.end], rax
+
+.next_entry:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.end]
+    jae     .next_batch
+
+    inc     qword [rsp+.i]
+
+    mov     rcx, rax
+    shl     rcx, 4 ; LsItem_size
+    add     rcx, [rbx+LsDir.items]
+    mov     rcx, [rcx+LsItem.entry]
+    mov     [rsp+.entry], rcx
+
+    imul    rax, rax, LsStat_size
+    add     rax, [rbx+LsDir.stats]
+    mov     [rcx+LsEntry.stat], rax
+
+    mov     rdi, [rbx+LsDir.fd]
+    lea     rsi, [rcx+LsEntry.name]
+    mov     rdx, [rbx+LsDir.stat_flags]
+    or      rdx, AT_NO_AUTOMOUNT
+    mov     rcx, [rbx+LsDir.mask]
+    lea     r8, [rsp+.stx]
+    dcall   statx
+
+    mov     rcx, [rsp+.entry]
+    mov     rdx, [rcx+LsEntry.stat]
+
+    cmp     eax, 0
+    jne     .error
+
+    mov     dword [rdx+LsStat.failed], 0
+
+    movzx   eax, word [rsp+.stx+Statx.stx_mode]
+    mov     [rdx+LsStat.mode], eax
+
+    ; DT_* value = (S_IF* >> 12)
+    and     eax, S_IFMT
+    shr     eax, 12
+    mov     [rcx+LsEntry.type], eax
+
+    mov     eax, [rsp+.stx+Statx.stx_nlink]
+    mov     [rdx+LsStat.nlink], eax
+    mov     eax, [rsp+.stx+Statx.stx_uid]
+    mov     [rdx+LsStat.uid], eax
+    mov     eax, [rsp+.stx+Statx.stx_gid]
+    mov     [rdx+LsStat.gid], eax
+    mov     eax, [rsp+.stx+Statx.stx_rdev_major]
+    mov     [rdx+LsStat.rdev_major], eax
+    mov     eax, [rsp+.stx+Statx.stx_rdev_minor]
+    mov     [rdx+LsStat.rdev_minor], eax
+
+    mov     rax, [rsp+.stx+Statx.stx_size]
+    mov     [rdx+LsStat.size], rax
+    mov     rax, [rsp+.stx+Statx.stx_blocks]
+    mov     [rdx+LsStat.blocks], rax
+
+    ; struct statx_timestamp: int64_t tv_sec, uint32_t tv_nsec.
+    mov     rax, [rsp+.stx+Statx.stx_mtime]
+    mov     [rdx+LsStat.mtime], rax
+    mov     eax, [rsp+.stx+Statx.stx_mtime+8]
+    mov     [rdx+LsStat.mtime_nsec], eax
+
+    jmp     .next_entry
+
+.error:
+    mov     dword [rdx+LsStat.failed], 1
+    mov     qword [rbx+LsDir.error], 1
+
+    mov     rdi, STDERR_FD
+
+    cmp     qword [rbx+LsDir.path], 0
+    je      .file_error
+
+    mov     rsi, .dir_access_fmt
+    mov     rdx, [rbx+LsDir.path]
+    lea     rcx, [rcx+LsEntry.name]
+    dcall   dprintf
+
+    jmp     .next_entry
+
+.file_error:
+    mov     rsi, .access_fmt
+    lea     rdx, [rcx+LsEntry.name]
+    dcall   dprintf
+
+    jmp     .next_entry
+
+.done:
+    xor     rax, rax
+
+    free_space Statx_size
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Sort a list of entries.
+;
+; C prototype equivalent:
+;
+;     int ls_sort(LsState *state, LsDir *dir);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (address) - LsDir.
+; - Output: RAX (integer) - 0 on success, or -1 if memory could not
+;   be allocated.
+;
+; Notes:
+;
+; - Names are sorted by a radix sort of the first 8 bytes of each
+;   name (as a big endian number, so the order is that of strcmp(3)).
+;   Only runs of names that share those 8 bytes are then sorted by
+;   comparing the whole names.
+;
+; - Sorting by size or time is done by further (stable) radix sorts
+;   of the name order, so entries with the same key stay sorted by
+;   name.
+;
+; - Radix passes where all the keys have the same byte are skipped,
+;   so for example small sizes only need a few passes.
+;---------------------------------------------------------------------
+
+ls_sort:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "LsState *"
+    .tmp        equ     8   ; "LsItem *": scratch array.
+    .i          equ    16   ; size_t: start of next run.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     rbx, rsi ; Preserved across calls.
+
+    ;--------------------
+
+    cmp     qword [rdi+LsState.sort], LS_SORT_NONE
+    je      .done
+
+    cmp     qword [rbx+LsDir.count], 2
+    jb      .done
+
+    mov     rdi, [rbx+LsDir.count]
+    shl     rdi, 4 ; LsItem_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.tmp], rax
+
+    ;--------------------
+    ; key = big endian first 8 bytes of name (zero padded).
+
+    mov     r9, [rbx+LsDir.items]
+    mov     r8, [rbx+LsDir.count]
+
+.name_key:
+    mov     rsi, [r9+LsItem.entry]
+    mov     rax, [rsi+LsEntry.name]
+
+    mov     ecx, [rsi+LsEntry.len]
+    cmp     ecx, 8
+    jae     .name_key_set
+
+    ; Clear the bytes after the name (which may not be zero).
+    shl     ecx, 3
+    mov     rdx, 1
+    shl     rdx, cl
+    dec     rdx
+    and     rax, rdx
+
+.name_key_set:
+    bswap   rax
+    mov     [r9+LsItem.key], rax
+
+    add     r9, LsItem_size
+    dec     r8
+    jnz     .name_key
+
+    mov     rdi, [rbx+LsDir.items]
+    mov     rsi, [rsp+.tmp]
+    mov     rdx, [rbx+LsDir.count]
+    dcall   ls_radix_sort
+
+    ;--------------------
+    ; Sort runs of names with the same first 8 bytes.
+
+    mov     qword [rsp+.i], 0
+
+.next_run:
+    mov     rax, [rsp+.i]
+    mov     rcx, [rbx+LsDir.count]
+    cmp     rax, rcx
+    jae     .names_sorted
+
+    mov     rsi, [rbx+LsDir.items]
+    mov     rdx, rax
+    shl     rdx, 4 ; LsItem_size
+    mov     r8, [rsi+rdx+LsItem.key]
+
+    lea     r9, [rax+1]
+
+.run:
+    cmp     r9, rcx
+    jae     .run_end
+
+    mov     rdx, r9
+    shl     rdx, 4 ; LsItem_size
+    cmp     [rsi+rdx+LsItem.key], r8
+    jne     .run_end
+
+    inc     r9
+    jmp     .run
+
+.run_end:
+    mov     [rsp+.i], r9
+
+    sub     r9, rax
+    cmp     r9, 1
+    jbe     .next_run
+
+    ; If the 8th byte is zero, the names are shorter than 8 bytes
+    ; (and so identical).
+    cmp     r8b, 0
+    je      .next_run
+
+    shl     rax, 4 ; LsItem_size
+    lea     rdi, [rsi+rax]
+    mov     rsi, r9
+    mov     rdx, LsItem_size
+    mov     rcx, ls_compare_items
+    dcall   qsort
+
+    jmp     .next_run
+
+.names_sorted:
+    mov     rax, [rsp+.state]
+    mov     rax, [rax+LsState.sort]
+
+    cmp     rax, LS_SORT_SIZE
+    je      .sort_size
+
+    cmp     rax, LS_SORT_TIME
+    je      .sort_time
+
+    jmp     .done
+
+.sort_size:
+    ;--------------------
+    ; key = ~size (largest first).
+
+    mov     r9, [rbx+LsDir.items]
+    mov     r8, [rbx+LsDir.count]
+
+.size_key:
+    mov     rsi, [r9+LsItem.entry]
+    mov     rsi, [rsi+LsEntry.stat]
+    xor     eax, eax
+
+    cmp     dword [rsi+LsStat.failed], 0
+    jne     .size_key_set
+
+    mov     rax, [rsi+LsStat.size]
+
+.size_key_set:
+    not     rax
+    mov     [r9+LsItem.key], rax
+
+    add     r9, LsItem_size
+    dec     r8
+    jnz     .size_key
+
+    jmp     .sort_keys
+
+.sort_time:
+    ;--------------------
+    ; Sort by the nanoseconds, then the seconds (newest first).
+
+    mov     r9, [rbx+LsDir.items]
+    mov     r8, [rbx+LsDir.count]
+
+.nsec_key:
+    mov     rsi, [r9+LsItem.entry]
+    mov     rsi, [rsi+LsEntry.stat]
+    xor     eax, eax
+
+    cmp     dword [rsi+LsStat.failed], 0
+    jne     .nsec_key_set
+
+    mov     eax, [rsi+LsStat.mtime_nsec]
+
+.nsec_key_set:
+    not     rax
+    mov     [r9+LsItem.key], rax
+
+    add     r9, LsItem_size
+    dec     r8
+    jnz     .nsec_key
+
+    mov     rdi, [rbx+LsDir.items]
+    mov     rsi, [rsp+.tmp]
+    mov     rdx, [rbx+LsDir.count]
+    dcall   ls_radix_sort
+
+    mov     r9, [rbx+LsDir.items]
+    mov     r8, [rbx+LsDir.count]
+    mov     rdx, (1 << 63)
+
+.sec_key:
+    mov     rsi, [r9+LsItem.entry]
+    mov     rsi, [rsi+LsEntry.stat]
+    xor     eax, eax
+
+    cmp     dword [rsi+LsStat.failed], 0
+    jne     .sec_key_set
+
+    mov     rax, [rsi+LsStat.mtime]
+
+.sec_key_set:
+    ; Signed to unsigned order.
+    xor     rax, rdx
+    not     rax
+    mov     [r9+LsItem.key], rax
+
+    add     r9, LsItem_size
+    dec     r8
+    jnz     .sec_key
+
+.sort_keys:
+    mov     rdi, [rbx+LsDir.items]
+    mov     rsi, [rsp+.tmp]
+    mov     rdx, [rbx+LsDir.count]
+    dcall   ls_radix_sort
+
+.done:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Stable sort of items by key.
+;
+; C prototype equivalent:
+;
+;     void ls_radix_sort(LsItem *items, LsItem *tmp, size_t count);
+;
+; Parameters:
+;
+; - Input: RDI (address) - items to sort.
+; - Input: RSI (address) - scratch array of count items.
+; - Input: RDX (integer) - number of items (at least 1).
+; - Output: None.
+;
+; Notes:
+;
+; This is an LSD radix sort on each byte of the key, which skips the
+; bytes that are the same for all keys.
+;---------------------------------------------------------------------
+
+ls_radix_sort:
+    prologue_with_vars 6
+
+    alloc_space (256 * 8)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .items      equ     0   ; "LsItem *"
+    .tmp        equ     8   ; "LsItem *"
+    .count      equ    16   ; size_t.
+    .src        equ    24   ; "LsItem *": input of pass.
+    .dst        equ    32   ; "LsItem *": output of pass.
+    .shift      equ    40   ; size_t: bit offset of byte.
+    .offsets    equ    48   ; size_t[256]: counts, then offsets.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.items], rdi
+    mov     [rsp+.tmp], rsi
+    mov     [rsp+.count], rdx
+
+    ;--------------------
+
+    mov     [rsp+.src], rdi
+    mov     [rsp+.dst], rsi
+    mov     qword [rsp+.shift], 0
+
+.next_pass:
+    lea     rdi, [rsp+.offsets]
+    mov     rcx, 256
+    xor     eax, eax
+    rep     stosq
+
+    ;--------------------
+    ; Count the items with each byte value.
+
+    mov     rsi, [rsp+.src]
+    mov     rdx, [rsp+.count]
+    mov     rcx, [rsp+.shift]
+
+.histogram:
+    mov     rax, [rsi+LsItem.key]
+    shr     rax, cl
+    movzx   eax, al
+    inc     qword [rsp+.offsets+rax*8]
+
+    add     rsi, LsItem_size
+    dec     rdx
+    jnz     .histogram
+
+    ; Nothing to do if all the items have the same byte.
+    mov     rsi, [rsp+.src]
+    mov     rax, [rsi+LsItem.key]
+    shr     rax, cl
+    movzx   eax, al
+
+    mov     rdx, [rsp+.count]
+    cmp     [rsp+.offsets+rax*8], rdx
+    je      .pass_done
+
+    ;--------------------
+    ; Convert the counts to offsets.
+
+    xor     eax, eax
+    xor     edx, edx
+
+.prefix_sum:
+    mov     r8, [rsp+.offsets+rdx*8]
+    mov     [rsp+.offsets+rdx*8], rax
+    add     rax, r8
+
+    inc     edx
+    cmp     edx, 256
+    jb      .prefix_sum
+
+    ;--------------------
+    ; Move the items to their new positions.
+
+    mov     rsi, [rsp+.src]
+    mov     rdi, [rsp+.dst]
+    mov     rdx, [rsp+.count]
+
+.scatter:
+    mov     r8, [rsi+LsItem.key]
+    mov     r10, [rsi+LsItem.entry]
+
+    mov     rax, r8
+    shr     rax, cl
+    movzx   eax, al
+
+    mov     r9, [rsp+.offsets+rax*8]
+    inc     qword [rsp+.offsets+rax*8]
+
+    shl     r9, 4 ; LsItem_size
+    mov     [rdi+r9+LsItem.key], r8
+    mov     [rdi+r9+LsItem.entry], r10
+
+    add     rsi, LsItem_size
+    dec     rdx
+    jnz     .scatter
+
+    mov     rax, [rsp+.src]
+    mov     rdx, [rsp+.dst]
+    mov     [rsp+.src], rdx
+    mov     [rsp+.dst], rax
+
+.pass_done:
+    add     qword [rsp+.shift], 8
+    cmp     qword [rsp+.shift], 64
+    jb      .next_pass
+
+    ;--------------------
+    ; Make sure the result is in the items array.
+
+    mov     rsi, [rsp+.src]
+    cmp     rsi, [rsp+.items]
+    je      .out
+
+    mov     rdi, [rsp+.items]
+    mov     rdx, [rsp+.count]
+    shl     rdx, 4 ; LsItem_size
+    dcall   memcpy
+
+.out:
+    free_space (256 * 8)
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: qsort(3) comparison function for items.
+;
+; C prototype equivalent:
+;
+;     int ls_compare_items(const LsItem *a, const LsItem *b);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsItem.
+; - Input: RSI (address) - LsItem.
+; - Output: RAX (integer) - strcmp(3) of the names.
+;---------------------------------------------------------------------
+
+ls_compare_items:
+    prologue_with_vars 0
+
+    mov     rax, [rdi+LsItem.entry]
+    lea     rdi, [rax+LsEntry.name]
+
+    mov     rax, [rsi+LsItem.entry]
+    lea     rsi, [rax+LsEntry.name]
+
+    dcall   strcmp
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write a list of entries.
+;
+; C prototype equivalent:
+;
+;     void ls_print_entries(LsState *state, LsDir *dir, bool is_dir);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (address) - LsDir (sorted).
+; - Input: RDX (integer) - set if listing a directory (which shows
+;   the total number of blocks for -l).
+; - Output: None.
+;
+; Notes:
+;
+; For -l, the column widths are worked out first. Entries that could
+; not be statted are not shown in the long format.
+;---------------------------------------------------------------------
+
+ls_print_entries:
+section .rodata
+    .total_fmt      db  "total %lu",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .dir        equ     0   ; "LsDir *"
+    .is_dir     equ     8   ; bool.
+    .i          equ    16   ; size_t: index.
+    .total      equ    24   ; size_t: 512 byte blocks used.
+    .stat       equ    32   ; "LsStat *"
+    .entry      equ    40   ; "LsEntry *"
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.dir], rsi
+    mov     [rsp+.is_dir], rdx
+
+    ;--------------------
+
+    test    qword [rbx+LsState.flags], LS_LONG
+    jz      .print
+
+    mov     qword [rbx+LsState.nlink_width], 0
+    mov     qword [rbx+LsState.owner_width], 0
+    mov     qword [rbx+LsState.group_width], 0
+    mov     qword [rbx+LsState.size_width], 0
+    mov     qword [rsp+.total], 0
+    mov     qword [rsp+.i], 0
+
+.next_width:
+    mov     rcx, [rsp+.dir]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rcx+LsDir.count]
+    jae     .widths_done
+
+    inc     qword [rsp+.i]
+
+    shl     rax, 4 ; LsItem_size
+    add     rax, [rcx+LsDir.items]
+    mov     rax, [rax+LsItem.entry]
+    mov     rax, [rax+LsEntry.stat]
+
+    cmp     dword [rax+LsStat.failed], 0
+    jne     .next_width
+
+    mov     [rsp+.stat], rax
+
+    mov     rcx, [rax+LsStat.blocks]
+    add     [rsp+.total], rcx
+
+    mov     edi, [rax+LsStat.nlink]
+    dcall   ls_digits
+    cmp     rax, [rbx+LsState.nlink_width]
+    jbe     .owner_width
+
+    mov     [rbx+LsState.nlink_width], rax
+
+.owner_width:
+    lea     rdi, [rbx+LsState.owner]
+    mov     rax, [rsp+.stat]
+    mov     esi, [rax+LsStat.uid]
+    mov     rdx, getpwuid
+    dcall   ls_id_name
+
+    mov     rdi, rax
+    dcall   asm_strlen
+    cmp     rax, [rbx+LsState.owner_width]
+    jbe     .group_width
+
+    mov     [rbx+LsState.owner_width], rax
+
+.group_width:
+    lea     rdi, [rbx+LsState.group]
+    mov     rax, [rsp+.stat]
+    mov     esi, [rax+LsStat.gid]
+    mov     rdx, getgrgid
+    dcall   ls_id_name
+
+    mov     rdi, rax
+    dcall   asm_strlen
+    cmp     rax, [rbx+LsState.group_width]
+    jbe     .size_width
+
+    mov     [rbx+LsState.group_width], rax
+
+.size_width:
+    mov     rdi, [rsp+.stat]
+    mov     rsi, [rbx+LsState.line] ; Scratch.
+    dcall   ls_format_size
+    cmp     rax, [rbx+LsState.size_width]
+    jbe     .next_width
+
+    mov     [rbx+LsState.size_width], rax
+    jmp     .next_width
+
+.widths_done:
+    cmp     qword [rsp+.is_dir], 0
+    je      .print
+
+    ; The total is shown in 1024 byte units.
+    mov     rcx, [rsp+.total]
+    inc     rcx
+    shr     rcx, 1
+
+    mov     rdi, [rbx+LsState.line]
+    mov     rsi, LS_LINE_SIZE
+    mov     rdx, .total_fmt
+    dcall   snprintf
+
+    mov     rdi, rbx
+    mov     rsi, [rbx+LsState.line]
+    movsxd  rdx, eax
+    dcall   ls_write
+
+.print:
+    mov     qword [rsp+.i], 0
+
+.next_entry:
+    mov     rcx, [rsp+.dir]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rcx+LsDir.count]
+    jae     .out
+
+    inc     qword [rsp+.i]
+
+    shl     rax, 4 ; LsItem_size
+    add     rax, [rcx+LsDir.items]
+    mov     rax, [rax+LsItem.entry]
+
+    test    qword [rbx+LsState.flags], LS_LONG
+    jnz     .long
+
+    mov     rdi, rbx
+    lea     rsi, [rax+LsEntry.name]
+    mov     edx, [rax+LsEntry.len]
+    dcall   ls_write_line
+
+    jmp     .next_entry
+
+.long:
+    mov     rdx, [rax+LsEntry.stat]
+    cmp     dword [rdx+LsStat.failed], 0
+    jne     .next_entry
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.dir]
+    mov     rdx, rax
+    dcall   ls_print_long
+
+    jmp     .next_entry
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write an entry in the long listing format.
+;
+; C prototype equivalent:
+;
+;     void ls_print_long(LsState *state, LsDir *dir, LsEntry *entry);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState (with the column widths set).
+; - Input: RSI (address) - LsDir.
+; - Input: RDX (address) - LsEntry (which has been statted).
+; - Output: None.
+;
+; Notes:
+;
+; The format is that of GNU ls in the C locale:
+;
+;     mode nlink owner group size date name [-> target]
+;
+; Files modified in the last six months show the time, older (or
+; future) files show the year instead.
+;---------------------------------------------------------------------
+
+ls_print_long:
+section .rodata
+    .nlink_fmt      db  "%s %*u ",0
+    .id_fmt         db  "%-*s ",0
+    .size_fmt       db  "%*s %s ",0
+    .recent_fmt     db  "%b %e %H:%M",0
+    .old_fmt        db  "%b %e  %Y",0
+section .text
+    prologue_with_vars 5
+
+    alloc_space (64 + 16 + 32 + 64)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .dir        equ     0   ; "LsDir *"
+    .entry      equ     8   ; "LsEntry *"
+    .stat       equ    16   ; "LsStat *"
+    .len        equ    24   ; size_t: length of line.
+    .mtime      equ    32   ; time_t.
+    .tm         equ    40   ; struct tm (64 bytes).
+    .mode_str   equ   104   ; char[16]
+    .size_str   equ   120   ; char[32]
+    .date_str   equ   152   ; char[64]
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.dir], rsi
+    mov     [rsp+.entry], rdx
+
+    mov     rax, [rdx+LsEntry.stat]
+    mov     [rsp+.stat], rax
+
+    ;--------------------
+    ; mode and nlink
+
+    mov     edi, [rax+LsStat.mode]
+    lea     rsi, [rsp+.mode_str]
+    dcall   ls_mode_string
+
+    mov     rdi, [rbx+LsState.line]
+    mov     rsi, LS_LINE_SIZE
+    mov     rdx, .nlink_fmt
+    lea     rcx, [rsp+.mode_str]
+    mov     r8, [rbx+LsState.nlink_width]
+    mov     rax, [rsp+.stat]
+    mov     r9d, [rax+LsStat.nlink]
+    dcall   snprintf
+
+    movsxd  rax, eax
+    mov     [rsp+.len], rax
+
+    ;--------------------
+    ; owner
+
+    lea     rdi, [rbx+LsState.owner]
+    mov     rax, [rsp+.stat]
+    mov     esi, [rax+LsStat.uid]
+    mov     rdx, getpwuid
+    dcall   ls_id_name
+
+    mov     r8, rax
+    mov     rdi, [rbx+LsState.line]
+    add     rdi, [rsp+.len]
+    mov     rsi, LS_LINE_SIZE
+    sub     rsi, [rsp+.len]
+    mov     rdx, .id_fmt
+    mov     rcx, [rbx+LsState.owner_width]
+    dcall   snprintf
+
+    movsxd  rax, eax
+    add     [rsp+.len], rax
+
+    ;--------------------
+    ; group
+
+    lea     rdi, [rbx+LsState.group]
+    mov     rax, [rsp+.stat]
+    mov     esi, [rax+LsStat.gid]
+    mov     rdx, getgrgid
+    dcall   ls_id_name
+
+    mov     r8, rax
+    mov     rdi, [rbx+LsState.line]
+    add     rdi, [rsp+.len]
+    mov     rsi, LS_LINE_SIZE
+    sub     rsi, [rsp+.len]
+    mov     rdx, .id_fmt
+    mov     rcx, [rbx+LsState.group_width]
+    dcall   snprintf
+
+    movsxd  rax, eax
+    add     [rsp+.len], rax
+
+    ;--------------------
+    ; size and date
+
+    mov     rdi, [rsp+.stat]
+    lea     rsi, [rsp+.size_str]
+    dcall   ls_format_size
+
+    mov     rax, [rsp+.stat]
+    mov     rax, [rax+LsStat.mtime]
+    mov     [rsp+.mtime], rax
+
+    lea     rdi, [rsp+.mtime]
+    lea     rsi, [rsp+.tm]
+    dcall   localtime_r
+    cmp     rax, 0
+    jne     .recent
+
+    mov     word [rsp+.date_str], '?'
+    jmp     .size_date
+
+.recent:
+    mov     rdx, .old_fmt
+
+    mov     rax, [rsp+.mtime]
+    mov     rcx, [rbx+LsState.now]
+    cmp     rax, rcx
+    jg      .format_date
+
+    sub     rcx, LS_SIX_MONTHS
+    cmp     rax, rcx
+    jle     .format_date
+
+    mov     rdx, .recent_fmt
+
+.format_date:
+    lea     rdi, [rsp+.date_str]
+    mov     rsi, 64
+    lea     rcx, [rsp+.tm]
+    dcall   strftime
+
+.size_date:
+    mov     rdi, [rbx+LsState.line]
+    add     rdi, [rsp+.len]
+    mov     rsi, LS_LINE_SIZE
+    sub     rsi, [rsp+.len]
+    mov     rdx, .size_fmt
+    mov     rcx, [rbx+LsState.size_width]
+    lea     r8, [rsp+.size_str]
+    lea     r9, [rsp+.date_str]
+    dcall   snprintf
+
+    movsxd  rax, eax
+    add     [rsp+.len], rax
+
+    ;--------------------
+    ; name
+
+    mov     rax, [rsp+.entry]
+    mov     rdi, [rbx+LsState.line]
+    add     rdi, [rsp+.len]
+    lea     rsi, [rax+LsEntry.name]
+    mov     edx, [rax+LsEntry.len]
+    add     [rsp+.len], rdx
+    dcall   memcpy
+
+    ;--------------------
+    ; symbolic link target
+
+    mov     rax, [rsp+.stat]
+    mov     eax, [rax+LsStat.mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFLNK
+    jne     .end_line
+
+    ; readlinkat(fd, name, line+len+4, LS_LINE_SIZE-len-5)
+    mov     rax, [rsp+.dir]
+    mov     rdi, [rax+LsDir.fd]
+    mov     rax, [rsp+.entry]
+    lea     rsi, [rax+LsEntry.name]
+    mov     rdx, [rbx+LsState.line]
+    add     rdx, [rsp+.len]
+    add     rdx, 4
+    mov     rcx, (LS_LINE_SIZE - 5)
+    sub     rcx, [rsp+.len]
+    dcall   readlinkat
+    cmp     rax, 0
+    jl      .end_line
+
+    mov     rdx, [rbx+LsState.line]
+    add     rdx, [rsp+.len]
+    mov     dword [rdx], ' -> '
+
+    add     rax, 4
+    add     [rsp+.len], rax
+
+.end_line:
+    mov     rdx, [rbx+LsState.line]
+    add     rdx, [rsp+.len]
+    mov     byte [rdx], 10
+    inc     qword [rsp+.len]
+
+    mov     rdi, rbx
+    mov     rsi, [rbx+LsState.line]
+    mov     rdx, [rsp+.len]
+    dcall   ls_write
+
+    free_space (64 + 16 + 32 + 64)
+    epilogue_with_vars 5
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create the mode string for the long listing format.
+;
+; C prototype equivalent:
+;
+;     void ls_mode_string(unsigned int mode, char *buf);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - st_mode value.
+; - Input: RSI (address) - buffer of at least 11 bytes.
+; - Output: None.
+;---------------------------------------------------------------------
+
+ls_mode_string:
+section .rodata
+    ; Indexed by the DT_* value.
+    .types          db  "?pc?d?b?-?l?s???"
+    .perms          db  "rwxrwxrwx"
+section .text
+    prologue_with_vars 0
+
+    mov     eax, edi
+    shr     eax, 12
+    and     eax, 0xf
+    movzx   eax, byte [.types+rax]
+    mov     [rsi], al
+
+    ;--------------------
+    ; Permissions (bit 8 is the first).
+
+    xor     ecx, ecx
+
+.next_perm:
+    mov     edx, 8
+    sub     edx, ecx
+    mov     al, '-'
+    bt      edi, edx
+    jnc     .set_perm
+
+    mov     al, [.perms+rcx]
+
+.set_perm:
+    mov     [rsi+rcx+1], al
+
+    inc     ecx
+    cmp     ecx, 9
+    jb      .next_perm
+
+    ;--------------------
+    ; Special bits replace the execute bits.
+
+    test    edi, LS_S_ISUID
+    jz      .setgid
+
+    mov     al, 'S'
+    cmp     byte [rsi+3], 'x'
+    jne     .set_setuid
+
+    mov     al, 's'
+
+.set_setuid:
+    mov     [rsi+3], al
+
+.setgid:
+    test    edi, LS_S_ISGID
+    jz      .sticky
+
+    mov     al, 'S'
+    cmp     byte [rsi+6], 'x'
+    jne     .set_setgid
+
+    mov     al, 's'
+
+.set_setgid:
+    mov     [rsi+6], al
+
+.sticky:
+    test    edi, LS_S_ISVTX
+    jz      .out
+
+    mov     al, 'T'
+    cmp     byte [rsi+9], 'x'
+    jne     .set_sticky
+
+    mov     al, 't'
+
+.set_sticky:
+    mov     [rsi+9], al
+
+.out:
+    mov     byte [rsi+10], 0
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create the size column for the long listing format.
+;
+; C prototype equivalent:
+;
+;     size_t ls_format_size(LsStat *stat, char *buf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsStat.
+; - Input: RSI (address) - buffer of at least 32 bytes.
+; - Output: RAX (integer) - length of string.
+;
+; Notes:
+;
+; Devices show the major and minor numbers instead of the size.
+;---------------------------------------------------------------------
+
+ls_format_size:
+section .rodata
+    .size_fmt       db  "%lu",0
+    .device_fmt     db  "%u, %u",0
+section .text
+    prologue_with_vars 0
+
+    mov     eax, [rdi+LsStat.mode]
+    and     eax, S_IFMT
+
+    cmp     eax, S_IFCHR
+    je      .device
+
+    cmp     eax, S_IFBLK
+    je      .device
+
+    mov     rcx, [rdi+LsStat.size]
+    mov     rdi, rsi
+    mov     rsi, 32
+    mov     rdx, .size_fmt
+    dcall   snprintf
+    jmp     .out
+
+.device:
+    mov     ecx, [rdi+LsStat.rdev_major]
+    mov     r8d, [rdi+LsStat.rdev_minor]
+    mov     rdi, rsi
+    mov     rsi, 32
+    mov     rdx, .device_fmt
+    dcall   snprintf
+
+.out:
+    movsxd  rax, eax
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Count the decimal digits of a number.
+;
+; C prototype equivalent:
+;
+;     size_t ls_digits(uint64_t n);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - number.
+; - Output: RAX (integer) - number of digits.
+;---------------------------------------------------------------------
+
+ls_digits:
+    prologue_with_vars 0
+
+    mov     rax, rdi
+    mov     ecx, 10
+    xor     r8d, r8d
+
+.next_digit:
+    xor     edx, edx
+    div     rcx
+    inc     r8
+    cmp     rax, 0
+    jne     .next_digit
+
+    mov     rax, r8
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Get the name of a user or group.
+;
+; C prototype equivalent:
+;
+;     const char *ls_id_name(LsIdCache *cache, unsigned int id,
+;                            void *(*lookup)(unsigned int));
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsIdCache.
+; - Input: RSI (integer) - uid or gid.
+; - Input: RDX (address) - getpwuid(3) or getgrgid(3).
+; - Output: RAX (string) - name (or the number if there is no name).
+;
+; Notes:
+;
+; - Both "struct passwd" and "struct group" start with the name.
+;
+; - The last name looked up is cached since most of the entries of a
+;   directory tend to have the same owner and group.
+;---------------------------------------------------------------------
+
+ls_id_name:
+section .rodata
+    .id_fmt         db  "%u",0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .id         equ     0   ; unsigned int.
+    .lookup     equ     8   ; function pointer.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     esi, esi
+    mov     [rsp+.id], rsi
+    mov     [rsp+.lookup], rdx
+
+    ;--------------------
+
+    cmp     [rbx+LsIdCache.id], rsi
+    je      .out
+
+    mov     [rbx+LsIdCache.id], rsi
+
+    mov     rdi, rsi
+    mov     rax, [rsp+.lookup]
+    dcall   rax
+    cmp     rax, 0
+    je      .number
+
+    lea     rdi, [rbx+LsIdCache.name]
+    mov     rsi, [rax] ; pw_name / gr_name
+    mov     rdx, (LS_NAME_SIZE - 1)
+    dcall   strncpy
+
+    mov     byte [rbx+LsIdCache.name+LS_NAME_SIZE-1], 0
+    jmp     .out
+
+.number:
+    lea     rdi, [rbx+LsIdCache.name]
+    mov     rsi, LS_NAME_SIZE
+    mov     rdx, .id_fmt
+    mov     rcx, [rsp+.id]
+    dcall   snprintf
+
+.out:
+    lea     rax, [rbx+LsIdCache.name]
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Add data to the output buffer.
+;
+; C prototype equivalent:
+;
+;     void ls_write(LsState *state, const void *data, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - length of data.
+; - Output: None.
+;
+; Notes:
+;
+; The buffer is flushed when full.
+;---------------------------------------------------------------------
+
+ls_write:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .data       equ     0   ; "const void *"
+    .len        equ     8   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.data], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    mov     rax, [rbx+LsState.out_len]
+    add     rax, rdx
+    cmp     rax, LS_OUT_BUF_SIZE
+    jbe     .copy
+
+    mov     rdi, rbx
+    dcall   ls_flush
+
+.copy:
+    mov     rdi, [rbx+LsState.out]
+    add     rdi, [rbx+LsState.out_len]
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    add     [rbx+LsState.out_len], rdx
+    dcall   memcpy
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Add a name and a newline to the output buffer.
+;
+; C prototype equivalent:
+;
+;     void ls_write_line(LsState *state, const char *name, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Input: RSI (string) - name.
+; - Input: RDX (integer) - length of name.
+; - Output: None.
+;---------------------------------------------------------------------
+
+ls_write_line:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .name       equ     0   ; "const char *"
+    .len        equ     8   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.name], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    mov     rax, [rbx+LsState.out_len]
+    lea     rax, [rax+rdx+1]
+    cmp     rax, LS_OUT_BUF_SIZE
+    jbe     .copy
+
+    mov     rdi, rbx
+    dcall   ls_flush
+
+.copy:
+    mov     rdi, [rbx+LsState.out]
+    add     rdi, [rbx+LsState.out_len]
+    mov     rsi, [rsp+.name]
+    mov     rdx, [rsp+.len]
+    mov     byte [rdi+rdx], 10
+    lea     rax, [rdx+1]
+    add     [rbx+LsState.out_len], rax
+    dcall   memcpy
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the output buffer to stdout.
+;
+; C prototype equivalent:
+;
+;     void ls_flush(LsState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - LsState.
+; - Output: None.
+;---------------------------------------------------------------------
+
+ls_flush:
+cold_rodata
+    .write_fmt      db  "ls: write error",10,0
+section .text
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rdx, [rbx+LsState.out_len]
+    cmp     rdx, 0
+    je      .out
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rbx+LsState.out]
+    dcall   write_block
+    cmp     rax, [rbx+LsState.out_len]
+    je      .done
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    dcall   dprintf
+
+    mov     qword [rbx+LsState.error], 1
+
+.done:
+    mov     qword [rbx+LsState.out_len], 0
+
+.out:
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,295 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_od
+global command_od
+
+extern arena_alloc
+extern asm_getopt
+extern hexfmt_files
+extern hexfmt_init
+extern hexfmt_parse_bytes
+
+extern dprintf
+extern optarg
+
+extern optind
+
+%include "header.inc"
+%include "hexfmt.inc"
+
+cold_rodata
+command_help_od:  db  "see od(1)",10, \
+                      10, \
+                      "Usage: od [-v] [-A RADIX] [-j BYTES] [-N BYTES] [-t x1] [FILE]...",10, \
+                      10, \
+                      "Options:",10, \
+                      10, \
+                      "-A RADIX : Show offsets in RADIX (d, o, x or n for none).",10, \
+                      "-j BYTES : Skip BYTES input bytes first.",10, \
+                      "-N BYTES : Show at most BYTES input bytes.",10, \
+                      "-t x1    : Show each byte in hex (the only type supported).",10, \
+                      "-v       : Show repeated lines (rather than '*').",0
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `od` command.
+;
+; C prototype equivalent:
+;
+;     int command_od(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, else -1.
+;
+; Notes:
+;
+; - The output is formatted by hexfmt_files().
+;
+; - BYTES values may be given in hex ("0x" prefix) or octal ("0"
+;   prefix).
+;
+; Limitations:
+;
+; - Only the "x1" type is supported (so it is also the default).
+; - BYTES values do not support suffixes.
+;
+; See: od(1).
+;---------------------------------------------------------------------
+
+command_od:
+section .rodata
+    .optstring          db  "A:j:N:t:v",0
+    .radix_opt          equ 'A'
+    .skip_opt           equ 'j'
+    .limit_opt          equ 'N'
+    .type_opt           equ 't'
+    .verbose_opt        equ 'v'
+
+    .name               db  "od",0
+cold_rodata
+    .nomem_msg          db  "od: cannot allocate memory",10,0
+    .radix_fmt          db  "od: invalid output address radix '%s'; it must be one character from [doxn]",10,0
+    .skip_fmt           db  "od: invalid -j argument '%s'",10,0
+    .limit_fmt          db  "od: invalid -N argument '%s'",10,0
+    .type_fmt           db  "od: unsupported type: '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .hf             equ     16  ; "HexFmt *"
+    .ret            equ     24  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     rdi, HexFmt_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.hf], rax
+
+    mov     rdi, rax
+    dcall   hexfmt_init
+    cmp     rax, 0
+    jne     .error_nomem
+
+    ;--------------------
+    ; Set defaults
+
+    mov     rbx, [rsp+.hf]
+
+    mov     qword [rbx+HexFmt.name], .name
+    mov     qword [rbx+HexFmt.style], HEXFMT_STYLE_OD
+    mov     qword [rbx+HexFmt.radix], 8
+    mov     qword [rbx+HexFmt.width], 7
+    mov     qword [rbx+HexFmt.flags], HEXFMT_SKIP_ERROR
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .radix_opt
+    je      .handle_radix_opt
+
+    cmp     al, .skip_opt
+    je      .handle_skip_opt
+
+    cmp     al, .limit_opt
+    je      .handle_limit_opt
+
+    cmp     al, .type_opt
+    je      .handle_type_opt
+
+    cmp     al, .verbose_opt
+    je      .handle_verbose_opt
+
+    jmp     .error_bad_option
+
+.handle_radix_opt:
+    mov     rdx, [optarg]
+    movzx   eax, byte [rdx]
+    cmp     al, 0
+    je      .error_radix
+
+    cmp     byte [rdx+1], 0
+    jne     .error_radix
+
+    mov     ecx, 10
+    mov     edx, 7
+    cmp     al, 'd'
+    je      .set_radix
+
+    mov     ecx, 8
+    cmp     al, 'o'
+    je      .set_radix
+
+    mov     ecx, 16
+    mov     edx, 6
+    cmp     al, 'x'
+    je      .set_radix
+
+    xor     ecx, ecx
+    xor     edx, edx
+    cmp     al, 'n'
+    jne     .error_radix
+
+.set_radix:
+    mov     [rbx+HexFmt.radix], rcx
+    mov     [rbx+HexFmt.width], rdx
+    jmp     .next_arg
+
+.handle_skip_opt:
+    mov     rdi, [optarg]
+    dcall   hexfmt_parse_bytes
+    cmp     rax, 0
+    jl      .error_skip
+
+    mov     [rbx+HexFmt.skip], rax
+    jmp     .next_arg
+
+.handle_limit_opt:
+    mov     rdi, [optarg]
+    dcall   hexfmt_parse_bytes
+    cmp     rax, 0
+    jl      .error_limit
+
+    mov     [rbx+HexFmt.limit], rax
+    jmp     .next_arg
+
+.handle_type_opt:
+    ; "x1" and "xC" (the size of a char) are the same.
+    mov     rdx, [optarg]
+    cmp     byte [rdx], 'x'
+    jne     .error_type
+
+    movzx   eax, byte [rdx+1]
+    cmp     al, '1'
+    je      .check_type_end
+
+    cmp     al, 'C'
+    jne     .error_type
+
+.check_type_end:
+    cmp     byte [rdx+2], 0
+    jne     .error_type
+
+    jmp     .next_arg
+
+.handle_verbose_opt:
+    or      qword [rbx+HexFmt.flags], HEXFMT_VERBOSE
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+
+    mov     rdx, [rsp+.argc]
+    sub     rdx, rax
+
+    mov     rsi, [rsp+.argv]
+    lea     rsi, [rsi+rax*PTR_SIZE]
+    mov     rdi, rbx
+    dcall   hexfmt_files
+    cmp     rax, 0
+    je      .out
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_nomem:
+    mov     rdi, STDERR_FD
+    mov     rsi, .nomem_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_radix:
+    mov     rsi, .radix_fmt
+    jmp     .error_value
+
+.error_skip:
+    mov     rsi, .skip_fmt
+    jmp     .error_value
+
+.error_limit:
+    mov     rsi, .limit_fmt
+    jmp     .error_value
+
+.error_type:
+    mov     rsi, .type_fmt
+
+.error_value:
+    mov     rdi, STDERR_FD
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
@@ -9,44 +9,122 @@
 global command_help_pwd
 global command_pwd
 
-extern free
+extern getcwd
+extern getenv
+extern stat
 extern write
 
+extern arena_alloc
 extern asm_strlen
-extern get_current_dir_name
 extern print_nl
 
-section .rodata
+%include "header.inc"
+
+cold_rodata
 command_help_pwd:  db  "see pwd(1)",0
 
-%include "header.inc"
+; Maximum buffer size to try for the current directory.
+%assign PWD_MAX_BYTES   (1024 * 1024)
 
 section .text
 
 ;---------------------------------------------------------------------
+; Notes:
 ;
+; - Like get_current_dir_name(3), the value of PWD is displayed if it
+;   refers to the current directory (which preserves the logical path
+;   if a symbolic link was followed to get there).
+; - Otherwise, the physical path is read into an arena buffer, so
+;   nothing needs to be freed.
 ;---------------------------------------------------------------------
 
 command_pwd:
-    prologue_with_vars 2
+section .rodata
+    .pwd_var    db  "PWD",0
+    .dot        db  ".",0
+section .text
+    prologue_with_vars 4
+
+    alloc_space (Stat_size * 2)
 
     ;--------------------
     ; Stack offsets
 
     .cwd        equ     0   ; "char *"
     .len        equ     8   ; size_t
+    .size       equ    16   ; size_t: getcwd buffer size.
+    .unused     equ    24   ; padding.
+    .dot_stat   equ    32                       ; Stat_size bytes.
+    .pwd_stat   equ    (.dot_stat + Stat_size)  ; Stat_size bytes.
 
     ;--------------------
 
     consume_program_name
 
-    dcall   get_current_dir_name
+    ;--------------------
+    ; Use PWD if it is an absolute path to the current directory.
+
+    mov     rdi, .pwd_var
+    dcall   getenv
+    cmp     rax, 0
+    je      .physical
+
+    cmp     byte [rax], '/'
+    jne     .physical
+
+    mov     [rsp+.cwd], rax
+
+    mov     rdi, rax
+    lea     rsi, [rsp+.pwd_stat]
+    dcall   stat
+    cmp     eax, 0
+    jne     .physical
+
+    mov     rdi, .dot
+    lea     rsi, [rsp+.dot_stat]
+    dcall   stat
+    cmp     eax, 0
+    jne     .physical
+
+    mov     rax, [rsp+.pwd_stat+Stat.st_dev]
+    cmp     rax, [rsp+.dot_stat+Stat.st_dev]
+    jne     .physical
+
+    mov     rax, [rsp+.pwd_stat+Stat.st_ino]
+    cmp     rax, [rsp+.dot_stat+Stat.st_ino]
+    je      .show
+
+.physical:
+    ;--------------------
+    ; Read the current directory, growing the buffer as required.
+
+    mov     qword [rsp+.size], PATH_MAX
+
+.try_size:
+    mov     rdi, [rsp+.size]
+    dcall   arena_alloc
     cmp     rax, 0
     je      .error
 
-    mov     [rsp+.cwd], rax ; Save path
+    mov     [rsp+.cwd], rax
 
     mov     rdi, rax
+    mov     rsi, [rsp+.size]
+    dcall   getcwd
+    cmp     rax, 0
+    jne     .show
+
+    ; The buffer is not explicitly freed as the arena will release it.
+    mov     rax, [rsp+.size]
+    shl     rax, 1
+    cmp     rax, PWD_MAX_BYTES
+    ja      .error
+
+    mov     [rsp+.size], rax
+    jmp     .try_size
+
+.show:
+    mov     rdi, [rsp+.cwd]
     dcall   asm_strlen
 
     mov     [rsp+.len], rax ; Save length
@@ -58,14 +136,12 @@ command_pwd:
 
     dcall   print_nl
 
-    mov     rdi, [rsp+.cwd]
-    dcall   free
-
 .success:
     mov     rax, CMD_OK
 
 .out:
-    epilogue_with_vars 2
+    free_space (Stat_size * 2)
+    epilogue_with_vars 4
 
     ret
 
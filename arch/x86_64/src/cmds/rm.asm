@@ -11,11 +11,11 @@ global command_rm
 
 extern unlink
 
-section .rodata
-command_help_rm:   db  "see rm(1)",0
-
 %include "header.inc"
 
+cold_rodata
+command_help_rm:   db  "see rm(1)",0
+
 section .text
 
 ;---------------------------------------------------------------------
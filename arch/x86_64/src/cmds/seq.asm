@@ -14,11 +14,11 @@ extern libc_strtol
 extern printf
 extern write
 
-section .rodata
-command_help_seq:  db  "see seq(1)",0
-
 %include "header.inc"
 
+cold_rodata
+command_help_seq:  db  "see seq(1)",0
+
 section .text
 
 ;---------------------------------------------------------------------
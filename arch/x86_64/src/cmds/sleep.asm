@@ -9,19 +9,28 @@
 global command_help_sleep
 global command_sleep
 
-extern get_errno
-extern libc_strtod
+extern arena_alloc
+extern libc_strtol
 extern num_to_timespec
 extern strcasestr
 
-extern nanosleep
+extern clock_gettime
+extern clock_nanosleep
+extern dprintf
 extern printf
-
-section .rodata
-command_help_sleep:  db  "see sleep(1)",0
+extern qsort
 
 %include "header.inc"
 
+cold_rodata
+command_help_sleep:  db  "see sleep(1)",10, \
+                         10, \
+                         "Options:",10, \
+                         10, \
+                         "-b N : Sleep N times and display how late the wake-ups were (in nanoseconds).",10, \
+                         "-n   : Display the number of seconds that would be slept, but do not sleep.",10, \
+                         "-s N : Busy-wait for the last N microseconds (for more accurate wake-ups).",0
+
 section .text
 
 ;---------------------------------------------------------------------
@@ -30,6 +39,16 @@ section .text
 ; - Provides a '-n' (no-act or dry-run) option that displays the number
 ;   of seconds that would be slept, but does not sleep. This option is
 ;   useful for debugging and testing.
+;
+; - Provides a '-s' option to spin for the end of the sleep, and a '-b'
+;   option to benchmark the accuracy of the sleep (see
+;   sleep_benchmark()).
+;
+; Notes:
+;
+; - The sleep is to an absolute CLOCK_MONOTONIC deadline (see
+;   sleep_until()), so being interrupted by a signal does not make the
+;   sleep any longer, and changes to the system time have no effect.
 ;---------------------------------------------------------------------
 
 command_sleep:
@@ -37,57 +56,143 @@ section .rodata
     .forever_prefix   db "inf",0
     .max_nanoseconds  equ 999999999
 
+    ; Benchmark runs (each needs an 8 byte sample, see
+    ; sleep_benchmark()).
+    .max_runs         equ (1 << 24)
+
 %ifdef NASM
     ; Integer value: 18446744073709551615
     ; Note that YASM seemingly only supports 32-bit literal values so
     ; we have to waste some instructions to handle this for YASM ;(
     .max_seconds      equ 0xffffffffffffffff
 %endif
+cold_rodata
+    .runs_fmt         db "sleep: invalid number of runs: '%s'",10,0
+    .spin_fmt         db "sleep: invalid spin time: '%s'",10,0
 section .bss
     .delay          resb Timespec_size
-    .remainder      resb Timespec_size
 
 section .text
-    prologue_with_vars 4
+    prologue_with_vars 8
 
     ;--------------------
     ; Stack offsets.
 
     .str_value  equ     0   ; "char *"
-    .fp_value   equ     8   ; 8 byte double floating point.
+    .argc       equ     8   ; int.
     .forever    equ     16  ; bool: if true, sleep forever
 
     ; bool: if true, do not sleep: just display how long command would
     ; normally sleep for.
     .no_act     equ     24
 
+    .argv       equ     32  ; "char **"
+    .spin       equ     40  ; size_t: nanoseconds to spin for.
+    .runs       equ     48  ; size_t: benchmark runs (0 for none).
+    .value      equ     56  ; long: option value.
+
     ;--------------------
 
     consume_program_name
 
-    cmp     rdi, 0
-    je     .err_need_arg
-
     ;--------------------
     ; Set defaults
 
     mov     qword [rsp+.no_act], 0
+    mov     qword [rsp+.forever], 0
+    mov     qword [rsp+.spin], 0
+    mov     qword [rsp+.runs], 0
 
     ;--------------------
+    ; Options are handled here rather than by getopt so that negative
+    ; values are reported as invalid arguments.
+
+.next_option:
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    cmp     rdi, 0
+    je     .err_need_arg
 
     mov     rax, [rsi]
 
-    ; Look for the dry-run option
-    mov     rbx, [rax]
-    cmp     bx, '-n'
+    cmp     byte [rax], '-'
+    jne     .no_arg
 
+    cmp     byte [rax+2], 0
     jne     .no_arg
 
+    movzx   eax, byte [rax+1]
+
+    ; Look for the dry-run option
+    cmp     al, 'n'
+    je      .handle_no_act_opt
+
+    cmp     al, 'b'
+    je      .handle_runs_opt
+
+    cmp     al, 's'
+    je      .handle_spin_opt
+
+    jmp     .no_arg
+
+.handle_no_act_opt:
     mov     byte [rsp+.no_act], 1
 
     ; Consume the argument
     dec     rdi    ; argc--
     add     rsi, 8 ; argv++
+    jmp     .next_option
+
+.handle_runs_opt:
+    cmp     rdi, 2
+    jb      .err_need_arg
+
+    mov     rdi, [rsi+8]
+    mov     rsi, 10
+    lea     rdx, [rsp+.value]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .err_runs
+
+    mov     rax, [rsp+.value]
+    cmp     rax, 0
+    jle     .err_runs
+
+    cmp     rax, .max_runs
+    ja      .err_runs
+
+    mov     [rsp+.runs], rax
+    jmp     .consume_option_value
+
+.handle_spin_opt:
+    cmp     rdi, 2
+    jb      .err_need_arg
+
+    mov     rdi, [rsi+8]
+    mov     rsi, 10
+    lea     rdx, [rsp+.value]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .err_spin
+
+    ; Microseconds to nanoseconds (limited to one second).
+    mov     rax, [rsp+.value]
+    cmp     rax, 0
+    jl      .err_spin
+
+    cmp     rax, 1000000
+    ja      .err_spin
+
+    imul    rax, rax, 1000
+    mov     [rsp+.spin], rax
+
+.consume_option_value:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    sub     rdi, 2
+    add     rsi, 16
+    jmp     .next_option
 
 .no_arg:
     mov     rax, [rsi]
@@ -137,48 +242,42 @@ section .text
     jne     .err_bad_arg
 
 .setup_for_sleep:
-    mov     rdi, .delay
-    mov     rsi, .remainder
-
     cmp     byte [rsp+.no_act], 1
     je     .display_only
 
-.sleep_again:
-    dcall   nanosleep
+    cmp     qword [rsp+.runs], 0
+    jne     .benchmark
 
-    cmp     rax, 0
-    je      .success
+    ; An infinite sleep is to a deadline that is never reached.
+    mov     rdi, .delay
+    mov     rsi, [rsp+.spin]
+    dcall   sleep_for
 
-    ; An error occurred so check errno
-    dcall   get_errno
     cmp     rax, 0
-    je      .success
+    jne     .error
 
-    cmp     rax, EFAULT
-    je      .error
+.success:
+    mov     rax, CMD_OK
 
-    cmp     rax, EINVAL
-    je      .error
+.out:
+    epilogue_with_vars 8
 
-    cmp     rax, EINTR
-    je      .err_eintr
+    ret
 
-.success:
-    ; Unlikely that we'll ever get here, but the user requested an
-    ; infinite sleep, so give it to them!
+.benchmark:
+    ; Benchmarking an infinite sleep would take a while.
     cmp     qword [rsp+.forever], 1
+    je      .err_bad_arg
 
-    cmp     byte [rsp+.no_act], 1
-    jne     .success_not_infinity
-
-.success_not_infinity:
-
-    mov     rax, CMD_OK
+    mov     rdi, .delay
+    mov     rsi, [rsp+.runs]
+    mov     rdx, [rsp+.spin]
+    dcall   sleep_benchmark
 
-.out:
-    epilogue_with_vars 4
+    cmp     rax, 0
+    jne     .error
 
-    ret
+    jmp     .success
 
 .display_only:
 section .rodata
@@ -203,16 +302,481 @@ section .text
     mov     rax, CMD_BAD_ARG
     jmp     .out
 
-.err_eintr:
-    ; set delay=remainder
-    mov     rax, [.remainder+Timespec.tv_sec]
-    mov     [.delay+Timespec.tv_sec], rax
+.err_runs:
+    mov     rdx, .runs_fmt
+    jmp     .err_option_value
+
+.err_spin:
+    mov     rdx, .spin_fmt
+
+.err_option_value:
+    mov     rsi, rdx
+    mov     rdi, STDERR_FD
+    mov     rax, [rsp+.argv]
+    mov     rdx, [rax+8]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error
+
+;---------------------------------------------------------------------
+; Description: Sleep for the specified time.
+;
+; C prototype equivalent:
+;
+;     int sleep_for(const struct timespec *delay, size_t spin);
+;
+; Parameters:
+;
+; - Input: RDI (address) - time to sleep for.
+; - Input: RSI (integer) - nanoseconds at the end of the sleep to
+;   spin for (0 to not spin).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+sleep_for:
+    prologue_with_vars 2
+
+    alloc_space Timespec_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .delay      equ     0   ; "const struct timespec *"
+    .spin       equ     8   ; size_t.
+    .deadline   equ     16  ; Timespec.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.delay], rdi
+    mov     [rsp+.spin], rsi
+
+    ;--------------------
+
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.deadline]
+    dcall   clock_gettime
+    cmp     eax, 0
+    jne     .error
+
+    lea     rdi, [rsp+.deadline]
+    mov     rsi, [rsp+.delay]
+    dcall   sleep_add
+
+    lea     rdi, [rsp+.deadline]
+    mov     rsi, [rsp+.spin]
+    dcall   sleep_until
+
+.out:
+    free_space Timespec_size
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Add a (non-negative) time to a timespec.
+;
+; C prototype equivalent:
+;
+;     void sleep_add(struct timespec *ts, const struct timespec *delay);
+;
+; Parameters:
+;
+; - Input/Output: RDI (address) - time to add to.
+; - Input: RSI (address) - time to add (where tv_sec is treated as
+;   unsigned).
+; - Output: None.
+;
+; Notes:
+;
+; The result saturates at the maximum time_t value (which is how an
+; infinite sleep is handled).
+;---------------------------------------------------------------------
+
+sleep_add:
+    prologue_with_vars 0
+
+    ; rdx = maximum time_t value.
+    mov     rdx, -1
+    shr     rdx, 1
+
+    mov     rax, [rdi+Timespec.tv_sec]
+    mov     rcx, rdx
+    sub     rcx, rax ; Seconds that can be added.
+
+    cmp     [rsi+Timespec.tv_sec], rcx
+    ja      .saturate
+
+    add     rax, [rsi+Timespec.tv_sec]
+
+    mov     rcx, [rdi+Timespec.tv_nsec]
+    add     rcx, [rsi+Timespec.tv_nsec]
+    cmp     rcx, 1000000000
+    jb      .store
+
+    sub     rcx, 1000000000
+
+    cmp     rax, rdx
+    je      .saturate
+
+    inc     rax
+
+.store:
+    mov     [rdi+Timespec.tv_sec], rax
+    mov     [rdi+Timespec.tv_nsec], rcx
+
+    epilogue_with_vars 0
+    ret
+
+.saturate:
+    mov     rax, rdx
+    mov     rcx, 999999999
+    jmp     .store
+
+;---------------------------------------------------------------------
+; Description: Sleep until a CLOCK_MONOTONIC deadline.
+;
+; C prototype equivalent:
+;
+;     int sleep_until(const struct timespec *deadline, size_t spin);
+;
+; Parameters:
+;
+; - Input: RDI (address) - absolute CLOCK_MONOTONIC time to wake at.
+; - Input: RSI (integer) - nanoseconds before the deadline to stop
+;   sleeping and start spinning (0 to not spin).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - If a signal interrupts the sleep, it is restarted with the same
+;   deadline (unlike a relative sleep restarted with the remaining
+;   time, which accumulates the time taken to handle the signal).
+;
+; - The kernel wakes a sleeping thread some time after the deadline
+;   (the timer slack, plus the scheduling latency). Spinning on
+;   clock_gettime(2) (a vDSO call that does not enter the kernel) for
+;   the end of the sleep avoids most of that at the cost of burning
+;   CPU time.
+;---------------------------------------------------------------------
+
+sleep_until:
+    prologue_with_vars 2
+
+    alloc_space (Timespec_size * 2)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .deadline   equ     0   ; "const struct timespec *"
+    .spin       equ     8   ; size_t.
+    .target     equ     16  ; Timespec: time to sleep until.
+    .now        equ     (.target + Timespec_size) ; Timespec.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.deadline], rdi
+    mov     [rsp+.spin], rsi
+
+    ;--------------------
+    ; target = deadline - spin
+
+    mov     rax, rsi
+    xor     edx, edx
+    mov     rcx, 1000000000
+    div     rcx
+
+    mov     r8, [rdi+Timespec.tv_sec]
+    mov     r9, [rdi+Timespec.tv_nsec]
+
+    sub     r8, rax
+    sub     r9, rdx
+    jae     .target_set
+
+    add     r9, 1000000000
+    dec     r8
+
+.target_set:
+    ; The spin time is longer than the deadline itself, so the target
+    ; is negative, which clock_nanosleep(2) rejects. (A target that is
+    ; merely in the past makes the sleep return immediately.)
+    cmp     r8, 0
+    jl      .spin_wait
+
+    mov     [rsp+.target+Timespec.tv_sec], r8
+    mov     [rsp+.target+Timespec.tv_nsec], r9
+
+.sleep_again:
+    mov     rdi, CLOCK_MONOTONIC
+    mov     rsi, TIMER_ABSTIME
+    lea     rdx, [rsp+.target]
+    mov     rcx, 0 ; No remainder for an absolute sleep.
+    dcall   clock_nanosleep
+
+    ; Note: clock_nanosleep(2) returns the error rather than setting
+    ; errno.
+    cmp     eax, 0
+    je      .spin_wait
+
+    cmp     eax, EINTR
+    je      .sleep_again
+
+    jmp     .error
+
+.spin_wait:
+    cmp     qword [rsp+.spin], 0
+    je      .success
+
+.spin_again:
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.now]
+    dcall   clock_gettime
+    cmp     eax, 0
+    jne     .error
+
+    mov     rdi, [rsp+.deadline]
+
+    mov     rax, [rsp+.now+Timespec.tv_sec]
+    cmp     rax, [rdi+Timespec.tv_sec]
+    jg      .success
+    jl      .pause
+
+    mov     rax, [rsp+.now+Timespec.tv_nsec]
+    cmp     rax, [rdi+Timespec.tv_nsec]
+    jae     .success
+
+.pause:
+    ; Let the other hyperthread run.
+    pause
+    jmp     .spin_again
+
+.success:
+    mov     rax, 0
+
+.out:
+    free_space (Timespec_size * 2)
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Measure how accurately a sleep wakes up.
+;
+; C prototype equivalent:
+;
+;     int sleep_benchmark(const struct timespec *delay, size_t runs,
+;                         size_t spin);
+;
+; Parameters:
+;
+; - Input: RDI (address) - time to sleep for.
+; - Input: RSI (integer) - number of sleeps (at least 1).
+; - Input: RDX (integer) - nanoseconds to spin for (see
+;   sleep_until()).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; For each sleep, the overshoot (the time between the deadline and
+; the return from sleep_until()) is recorded. The minimum, median,
+; 90th and 99th percentiles and the maximum are then displayed in
+; nanoseconds, for example:
+;
+;                 min      median         p90         p99         max
+;     ns       52013       55811       61230       80114      112070
+;---------------------------------------------------------------------
+
+sleep_benchmark:
+section .rodata
+    .header         db  "            min      median         p90         p99         max",10,0
+    .label          db  "ns",0
+    .first_fmt      db  "%-3s%12lu%12lu%12lu",0
+    .last_fmt       db  "%12lu%12lu",10,0
+cold_rodata
+    .alloc_fmt      db  "sleep: out of memory",10,0
+section .text
+    prologue_with_vars 6
+
+    alloc_space (Timespec_size * 2)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .delay      equ     0   ; "const struct timespec *"
+    .runs       equ     8   ; size_t.
+    .spin       equ     16  ; size_t.
+    .samples    equ     24  ; "uint64_t *": overshoot for each run.
+    .i          equ     32  ; size_t: run.
+    .last       equ     40  ; size_t: index of last sample.
+    .deadline   equ     48  ; Timespec.
+    .now        equ     (.deadline + Timespec_size) ; Timespec.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.delay], rdi
+    mov     [rsp+.runs], rsi
+    mov     [rsp+.spin], rdx
+
+    ;--------------------
+
+    mov     rdi, rsi
+    shl     rdi, 3
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.samples], rax
+    mov     qword [rsp+.i], 0
+
+.next_run:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.runs]
+    jae     .report
+
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.deadline]
+    dcall   clock_gettime
+    cmp     eax, 0
+    jne     .error
+
+    lea     rdi, [rsp+.deadline]
+    mov     rsi, [rsp+.delay]
+    dcall   sleep_add
+
+    lea     rdi, [rsp+.deadline]
+    mov     rsi, [rsp+.spin]
+    dcall   sleep_until
+    cmp     rax, 0
+    jne     .error
+
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.now]
+    dcall   clock_gettime
+    cmp     eax, 0
+    jne     .error
+
+    ; overshoot = now - deadline
+    mov     rax, [rsp+.now+Timespec.tv_sec]
+    sub     rax, [rsp+.deadline+Timespec.tv_sec]
+    imul    rax, rax, 1000000000
+    add     rax, [rsp+.now+Timespec.tv_nsec]
+    sub     rax, [rsp+.deadline+Timespec.tv_nsec]
+
+    mov     rcx, [rsp+.i]
+    mov     rdx, [rsp+.samples]
+    mov     [rdx+rcx*8], rax
+
+    inc     qword [rsp+.i]
+    jmp     .next_run
+
+.report:
+    mov     rdi, [rsp+.samples]
+    mov     rsi, [rsp+.runs]
+    mov     rdx, 8
+    mov     rcx, sleep_compare
+    dcall   qsort
+
+    mov     rax, [rsp+.runs]
+    dec     rax
+    mov     [rsp+.last], rax
+
+    mov     rdi, .header
+    xor     rax, rax
+    dcall   printf
+
+    ; min, median and 90th percentile.
+    mov     rsi, .label
+
+    mov     rax, [rsp+.samples]
+    mov     rdx, [rax]
+
+    mov     rax, [rsp+.last]
+    shr     rax, 1
+    mov     rcx, [rsp+.samples]
+    mov     rcx, [rcx+rax*8]
 
-    mov     rax, [.remainder+Timespec.tv_nsec]
-    mov     [.delay+Timespec.tv_nsec], rax
+    mov     rax, [rsp+.last]
+    imul    rax, rax, 90
+    xor     edx, edx ; Note: clobbers the minimum.
+    mov     r9, 100
+    div     r9
+    mov     r8, [rsp+.samples]
+    mov     r8, [r8+rax*8]
 
-    ; clear remainder
-    mov     qword [.remainder+Timespec.tv_sec], 0
-    mov     qword [.remainder+Timespec.tv_nsec], 0
+    mov     rax, [rsp+.samples]
+    mov     rdx, [rax]
 
-    jmp     .sleep_again
+    mov     rdi, .first_fmt
+    xor     rax, rax
+    dcall   printf
+
+    ; 99th percentile and max.
+    mov     rax, [rsp+.last]
+    imul    rax, rax, 99
+    xor     edx, edx
+    mov     r9, 100
+    div     r9
+    mov     rsi, [rsp+.samples]
+    mov     rsi, [rsi+rax*8]
+
+    mov     rax, [rsp+.last]
+    mov     rdx, [rsp+.samples]
+    mov     rdx, [rdx+rax*8]
+
+    mov     rdi, .last_fmt
+    xor     rax, rax
+    dcall   printf
+
+    mov     rax, 0
+
+.out:
+    free_space (Timespec_size * 2)
+    epilogue_with_vars 6
+    ret
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: qsort(3) comparison function for unsigned 64-bit
+;   values.
+;
+; C prototype equivalent:
+;
+;     int sleep_compare(const void *a, const void *b);
+;
+; Parameters:
+;
+; - Input: RDI (address) - first value.
+; - Input: RSI (address) - second value.
+; - Output: RAX (integer) - -1, 0 or 1 if the first value is less
+;   than, equal to or greater than the second.
+;---------------------------------------------------------------------
+
+sleep_compare:
+    prologue_with_vars 0
+
+    mov     rcx, [rdi]
+    xor     eax, eax
+    cmp     rcx, [rsi]
+    seta    al
+    sbb     eax, 0
+
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,3641 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_sort
+global command_sort
+
+extern asm_getopt
+extern read_block
+extern write_block
+
+extern close
+extern dprintf
+extern free
+extern get_nprocs
+extern getenv
+extern lseek
+extern malloc
+extern memchr
+extern memcmp
+extern memcpy
+extern memmove
+extern mkstemp
+extern mmap
+extern munmap
+extern open
+extern pthread_create
+extern pthread_join
+extern qsort
+extern realloc
+extern snprintf
+extern strtoul
+extern unlink
+
+extern optarg
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_sort:  db  "see sort(1)",10, \
+                        10, \
+                        "Options:",10, \
+                        10, \
+                        "-S <size>    : Use a buffer of <size> bytes (suffixes: b, K (default), M, G).",10, \
+                        "-T <dir>     : Create temporary files in <dir>.",10, \
+                        "-k <n>[,<m>] : Sort on fields <n> to <m> (or to the end of the line).",10, \
+                        "-n           : Compare according to numeric value.",10, \
+                        "-r           : Reverse the result of comparisons.",10, \
+                        "-u           : Only output the first of lines with equal keys.",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign SORT_NUMERIC            (1 << 0)
+%assign SORT_REVERSE            (1 << 1)
+%assign SORT_UNIQUE             (1 << 2)
+
+;---------------------------------------------------------------------
+; Default size of the arena used to hold the input lines and their
+; records. Input that does not fit is sorted in runs written to
+; temporary files.
+SORT_DEFAULT_BUFFER_SIZE    equ     (256 * 1024 * 1024)
+
+; Smallest arena allowed (smaller -S values are rounded up).
+SORT_MIN_BUFFER_SIZE        equ     (64 * 1024)
+
+; Maximum amount of data read into the arena at once.
+SORT_READ_SIZE              equ     (1024 * 1024)
+
+; The records are written to a run when the free space in the arena
+; falls below this value.
+SORT_MIN_READ_SIZE          equ     PAGE_SIZE
+
+; Initial size of the buffer used to read back each run.
+SORT_RUN_BUF_SIZE           equ     IO_READ_BUF_SIZE
+
+; Size of the output buffer.
+SORT_WRITE_BUF_SIZE         equ     IO_READ_BUF_SIZE
+
+; Maximum number of sort threads.
+%assign SORT_MAX_THREADS            16
+
+; Smallest number of records worth giving a thread.
+%assign SORT_MIN_THREAD_RECORDS     16384
+
+; Maximum number of runs. When reached, the runs are merged into a
+; single run (which also bounds the number of open files).
+%assign SORT_MAX_RUNS               32
+
+; Groups of records smaller than this are sorted by insertion sort
+; rather than radix sort.
+%assign SORT_INSERTION_THRESHOLD    16
+
+; Number of key bytes cached in SortRec.prefix.
+%assign SORT_PREFIX_BYTES           8
+
+;---------------------------------------------------------------------
+; A single input line.
+;---------------------------------------------------------------------
+struc SortRec
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .line       resq    1 ; "char *": start of line.
+    .prefix     resq    1 ; uint64_t: key prefix (see sort_make_record()).
+    .length     resd    1 ; uint32_t: line length (excluding the newline).
+    .key        resd    1 ; uint32_t: offset of key in the line.
+    .key_len    resd    1 ; uint32_t: length of key.
+    .unused     resd    1 ; padding.
+endstruc
+
+;---------------------------------------------------------------------
+; Options used by the comparison functions.
+;
+; Notes:
+;
+; - Held in a global since the comparison function used by qsort(3)
+;   cannot be passed any state.
+; - Only written before any threads are started.
+;---------------------------------------------------------------------
+struc SortConfig
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .flags      resq    1 ; SORT_* bitmask.
+    .key_start  resq    1 ; size_t: first key field (1-based), or 0 for whole line.
+    .key_end    resq    1 ; size_t: last key field, or 0 for end of line.
+endstruc
+
+;---------------------------------------------------------------------
+; State of the sort command.
+;---------------------------------------------------------------------
+struc SortState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .arena      resq    1 ; "char *": start of arena.
+    .arena_end  resq    1 ; "char *": end of arena.
+    .data_end   resq    1 ; "char *": end of the line data in the arena.
+    .line_start resq    1 ; "char *": start of the first unprocessed line.
+    .recs       resq    1 ; "SortRec *": records (which grow down from .arena_end).
+    .runs       resq    1 ; "long *": file descriptors of the runs.
+    .nruns      resq    1 ; size_t: number of runs.
+    .tmpdir     resq    1 ; "char *": directory for runs.
+endstruc
+
+;---------------------------------------------------------------------
+; A group of records sorted by a single thread.
+;---------------------------------------------------------------------
+struc SortChunk
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .recs       resq    1 ; "SortRec *"
+    .count      resq    1 ; size_t: number of records.
+    .thread     resq    1 ; pthread_t.
+    .started    resq    1 ; bool: true if .thread needs to be joined.
+endstruc
+
+;---------------------------------------------------------------------
+; A sorted sequence of lines to be merged: either sorted records in
+; memory (.fd is -1), or a run file.
+;---------------------------------------------------------------------
+struc SortSource
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .rec        resb    SortRec_size ; Current line.
+    .done       resq    1 ; bool: true if no lines remain.
+    .fd         resq    1 ; int: run file, or -1 for records.
+    .next       resq    1 ; "SortRec *" or "char *": next record or line.
+    .end        resq    1 ; "SortRec *" or "char *": end of records or data.
+    .buf        resq    1 ; "char *": run file buffer.
+    .size       resq    1 ; size_t: size of .buf.
+endstruc
+
+;---------------------------------------------------------------------
+; Buffered output of sorted lines.
+;---------------------------------------------------------------------
+struc SortWriter
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .fd         resq    1 ; int.
+    .buf        resq    1 ; "char *": output buffer.
+    .len        resq    1 ; size_t: bytes in .buf.
+    .error      resq    1 ; bool: true if an error occurred.
+    .have_prev  resq    1 ; bool: true if .prev is valid (for -u).
+    .prev_buf   resq    1 ; "char *": copy of the previous line.
+    .prev_size  resq    1 ; size_t: size of .prev_buf.
+    .prev       resb    SortRec_size ; Previous line written.
+endstruc
+
+;---------------------------------------------------------------------
+; A parsed number (see sort_parse_number()).
+;---------------------------------------------------------------------
+struc SortNumber
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .neg        resq    1 ; bool: true if negative.
+    .int        resq    1 ; "char *": integer digits (without leading zeros).
+    .int_len    resq    1 ; size_t.
+    .frac       resq    1 ; "char *": fraction digits (without trailing zeros).
+    .frac_len   resq    1 ; size_t.
+endstruc
+
+; Stack space used by sort_records().
+SORT_RECORDS_SPACE  equ (SortWriter_size + \
+                         (SortChunk_size * SORT_MAX_THREADS) + \
+                         (SortSource_size * SORT_MAX_THREADS))
+
+; Stack space used by sort_merge_runs().
+SORT_MERGE_SPACE    equ (SortWriter_size + (SortSource_size * SORT_MAX_RUNS))
+
+section .bss
+    sort_config     resb SortConfig_size
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `sort` command.
+;
+; C prototype equivalent:
+;
+;     int command_sort(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, -1 on error.
+;
+; Notes:
+;
+; - The input is read into a single arena (allocated with mmap(2)
+;   using the -S size). Line data grows up from the start of the arena
+;   and a fixed size record (SortRec) for each line grows down from the
+;   end. Each record caches the first 8 bytes of the key (or the
+;   integer part of the number for -n) as an integer "prefix", so most
+;   comparisons never look at the line data.
+;
+; - When the arena is full, the records are sorted and the lines
+;   written to a temporary file (a "run"). All the runs are then
+;   combined by a k-way merge (see sort_merge()).
+;
+; - The records are sorted by multiple threads, each using an MSD radix
+;   sort on the prefix (see sort_radix()). The sorted groups of
+;   records are combined by the same merge used for the runs.
+;
+; Limitations:
+;
+; - Only the "C" locale collation order is supported.
+; - Only a single key is supported and fields are always separated by
+;   blanks.
+; - Numbers may not contain thousands separators, exponents or a
+;   leading '+'.
+; - Lines must be shorter than 4GiB and fit in the arena.
+; - Lines with equal keys are not output in input order (-s is not
+;   supported).
+; - Errors result in an exit code of 1 (rather than 2).
+;
+; See: sort(1).
+;---------------------------------------------------------------------
+
+command_sort:
+section .rodata
+    .optstring          db  "nruk:S:T:",0
+    .numeric_opt        equ 'n'
+    .reverse_opt        equ 'r'
+    .unique_opt         equ 'u'
+    .key_opt            equ 'k'
+    .size_opt           equ 'S'
+    .tmpdir_opt         equ 'T'
+
+    .tmpdir_env         db  "TMPDIR",0
+    .default_tmpdir_str db  "/tmp",0
+
+    .bad_key_fmt        db  "sort: invalid key: '%s'",10,0
+    .bad_size_fmt       db  "sort: invalid buffer size: '%s'",10,0
+    .mmap_fmt           db  "sort: cannot allocate buffer of %lu bytes",10,0
+
+    .stdin_name         db  "-",0
+
+section .text
+    prologue_with_vars 6
+
+    alloc_space SortState_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .file_idx       equ     16  ; size_t: index into argv of next file.
+    .size           equ     24  ; size_t: size of arena.
+    .ret            equ     32  ; int: return value.
+    .unused         equ     40  ; padding.
+    .state          equ     48  ; SortState.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [sort_config+SortConfig.flags], 0
+    mov     qword [sort_config+SortConfig.key_start], 0
+    mov     qword [sort_config+SortConfig.key_end], 0
+
+    mov     qword [rsp+.size], SORT_DEFAULT_BUFFER_SIZE
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    mov     qword [rsp+.state+SortState.arena], 0
+    mov     qword [rsp+.state+SortState.runs], 0
+    mov     qword [rsp+.state+SortState.nruns], 0
+    mov     qword [rsp+.state+SortState.tmpdir], 0
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    ;------------------------------
+
+    cmp     al, .numeric_opt
+    je      .handle_numeric_opt
+
+    cmp     al, .reverse_opt
+    je      .handle_reverse_opt
+
+    cmp     al, .unique_opt
+    je      .handle_unique_opt
+
+    cmp     al, .key_opt
+    je      .handle_key_opt
+
+    cmp     al, .size_opt
+    je      .handle_size_opt
+
+    cmp     al, .tmpdir_opt
+    je      .handle_tmpdir_opt
+
+    jmp     .error_bad_option
+
+.handle_numeric_opt:
+    or      qword [sort_config+SortConfig.flags], SORT_NUMERIC
+    jmp     .next_arg
+
+.handle_reverse_opt:
+    or      qword [sort_config+SortConfig.flags], SORT_REVERSE
+    jmp     .next_arg
+
+.handle_unique_opt:
+    or      qword [sort_config+SortConfig.flags], SORT_UNIQUE
+    jmp     .next_arg
+
+.handle_key_opt:
+    mov     rdi, [optarg]
+    dcall   sort_parse_key
+    cmp     rax, 0
+    jne     .error_bad_key
+
+    jmp     .next_arg
+
+.handle_size_opt:
+    mov     rdi, [optarg]
+    dcall   sort_parse_size
+    cmp     rax, 0
+    jl      .error_bad_size
+
+    mov     [rsp+.size], rax
+    jmp     .next_arg
+
+.handle_tmpdir_opt:
+    mov     rax, [optarg]
+    mov     [rsp+.state+SortState.tmpdir], rax
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.file_idx], rax
+
+    ;--------------------
+    ; Determine the directory for the runs.
+
+    cmp     qword [rsp+.state+SortState.tmpdir], 0
+    jne     .check_size
+
+    mov     rdi, .tmpdir_env
+    dcall   getenv
+    cmp     rax, 0
+    je      .default_tmpdir
+
+    cmp     byte [rax], 0
+    je      .default_tmpdir
+
+    mov     [rsp+.state+SortState.tmpdir], rax
+    jmp     .check_size
+
+.default_tmpdir:
+    mov     qword [rsp+.state+SortState.tmpdir], .default_tmpdir_str
+
+.check_size:
+    cmp     qword [rsp+.size], SORT_MIN_BUFFER_SIZE
+    jae     .create_arena
+
+    mov     qword [rsp+.size], SORT_MIN_BUFFER_SIZE
+
+.create_arena:
+    ; The pages are only allocated when first used, so a large
+    ; arena costs nothing for small inputs.
+    mov     rdi, 0 ; Let the kernel choose the address.
+    mov     rsi, [rsp+.size]
+    mov     rdx, (PROT_READ|PROT_WRITE)
+    mov     rcx, (MAP_PRIVATE|MAP_ANONYMOUS)
+    mov     r8, -1 ; No file.
+    mov     r9, 0 ; offset.
+    dcall   mmap
+    cmp     rax, MAP_FAILED
+    je      .error_mmap
+
+    mov     [rsp+.state+SortState.arena], rax
+    mov     [rsp+.state+SortState.data_end], rax
+    mov     [rsp+.state+SortState.line_start], rax
+
+    add     rax, [rsp+.size]
+    mov     [rsp+.state+SortState.arena_end], rax
+    mov     [rsp+.state+SortState.recs], rax
+
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    jne     .next_file
+
+    ;--------------------
+    ; No files, so read stdin.
+
+    lea     rdi, [rsp+.state]
+    mov     rsi, STDIN_FD
+    mov     rdx, .stdin_name
+    dcall   sort_fd
+    cmp     rax, 0
+    jne     .cleanup
+
+    jmp     .output
+
+.next_file:
+    mov     rax, [rsp+.file_idx]
+    cmp     rax, [rsp+.argc]
+    je      .output
+
+    mov     rcx, [rsp+.argv]
+    mov     rsi, [rcx+rax*PTR_SIZE]
+    lea     rdi, [rsp+.state]
+    dcall   sort_file
+    cmp     rax, 0
+    jne     .cleanup
+
+    inc     qword [rsp+.file_idx]
+    jmp     .next_file
+
+.output:
+    cmp     qword [rsp+.state+SortState.nruns], 0
+    jne     .merge
+
+    ;--------------------
+    ; Everything fitted in memory.
+
+    lea     rdi, [rsp+.state]
+    mov     rsi, STDOUT_FD
+    dcall   sort_records
+    cmp     rax, 0
+    jne     .cleanup
+
+    jmp     .success
+
+.merge:
+    ; Write the records still in memory as the final run.
+    mov     rax, [rsp+.state+SortState.recs]
+    cmp     rax, [rsp+.state+SortState.arena_end]
+    je      .merge_runs
+
+    lea     rdi, [rsp+.state]
+    dcall   sort_spill
+    cmp     rax, 0
+    jne     .cleanup
+
+.merge_runs:
+    lea     rdi, [rsp+.state]
+    mov     rsi, STDOUT_FD
+    dcall   sort_merge_runs
+    cmp     rax, 0
+    jne     .cleanup
+
+.success:
+    mov     qword [rsp+.ret], CMD_OK
+
+.cleanup:
+    lea     rdi, [rsp+.state]
+    dcall   sort_close_runs
+
+    mov     rdi, [rsp+.state+SortState.arena]
+    cmp     rdi, 0
+    je      .out
+
+    mov     rsi, [rsp+.state+SortState.arena_end]
+    sub     rsi, rdi
+    dcall   munmap
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space SortState_size
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_bad_key:
+    mov     rdi, STDERR_FD
+    mov     rsi, .bad_key_fmt
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+.error_bad_size:
+    mov     rdi, STDERR_FD
+    mov     rsi, .bad_size_fmt
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+.error_mmap:
+    mov     rdi, STDERR_FD
+    mov     rsi, .mmap_fmt
+    mov     rdx, [rsp+.size]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse the argument of the -S option.
+;
+; C prototype equivalent:
+;
+;     ssize_t sort_parse_size(const char *str);
+;
+; Parameters:
+;
+; - Input: RDI (string) - size with optional suffix.
+; - Output: RAX (integer) - size in bytes, or -1 on error.
+;
+; Notes:
+;
+; As for GNU sort(1), a value without a suffix is in KiB.
+;---------------------------------------------------------------------
+
+sort_parse_size:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .str        equ     0   ; "char *"
+    .end        equ     8   ; "char *": first byte after the number.
+
+    ;--------------------
+
+    mov     [rsp+.str], rdi
+
+    ; strtoul(3) accepts leading blanks and a sign, so check for a
+    ; digit first.
+    mov     al, [rdi]
+    sub     al, '0'
+    cmp     al, 9
+    ja      .error
+
+    lea     rsi, [rsp+.end]
+    mov     rdx, BASE_10
+    dcall   strtoul
+
+    mov     rsi, [rsp+.end]
+    movzx   edx, byte [rsi]
+
+    mov     rcx, 10 ; KiB by default.
+
+    cmp     dl, 0
+    je      .scale
+
+    cmp     byte [rsi+1], 0
+    jne     .error ; Trailing garbage.
+
+    mov     rcx, 0
+    cmp     dl, 'b'
+    je      .scale
+
+    mov     rcx, 10
+    cmp     dl, 'K'
+    je      .scale
+
+    cmp     dl, 'k'
+    je      .scale
+
+    mov     rcx, 20
+    cmp     dl, 'M'
+    je      .scale
+
+    cmp     dl, 'm'
+    je      .scale
+
+    mov     rcx, 30
+    cmp     dl, 'G'
+    je      .scale
+
+    cmp     dl, 'g'
+    je      .scale
+
+    jmp     .error
+
+.scale:
+    ; Check for overflow (the result must also be positive).
+    mov     rdx, rax
+    shl     rax, cl
+    js      .error
+
+    mov     r8, rax
+    shr     r8, cl
+    cmp     r8, rdx
+    jne     .error
+
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Parse the argument of the -k option and update
+;   sort_config.
+;
+; C prototype equivalent:
+;
+;     int sort_parse_key(const char *str);
+;
+; Parameters:
+;
+; - Input: RDI (string) - key definition ("<n>" or "<n>,<m>").
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+sort_parse_key:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .str        equ     0   ; "char *"
+    .end        equ     8   ; "char *": first byte after the number.
+
+    ;--------------------
+
+    mov     [rsp+.str], rdi
+
+    mov     al, [rdi]
+    sub     al, '0'
+    cmp     al, 9
+    ja      .error
+
+    lea     rsi, [rsp+.end]
+    mov     rdx, BASE_10
+    dcall   strtoul
+
+    cmp     rax, 0
+    je      .error ; Fields start at 1.
+
+    mov     [sort_config+SortConfig.key_start], rax
+    mov     qword [sort_config+SortConfig.key_end], 0
+
+    mov     rdi, [rsp+.end]
+    cmp     byte [rdi], 0
+    je      .success ; Key extends to the end of the line.
+
+    cmp     byte [rdi], ','
+    jne     .error
+
+    inc     rdi
+    mov     [rsp+.str], rdi
+
+    mov     al, [rdi]
+    sub     al, '0'
+    cmp     al, 9
+    ja      .error
+
+    lea     rsi, [rsp+.end]
+    mov     rdx, BASE_10
+    dcall   strtoul
+
+    mov     rdi, [rsp+.end]
+    cmp     byte [rdi], 0
+    jne     .error
+
+    cmp     rax, [sort_config+SortConfig.key_start]
+    jb      .error
+
+    mov     [sort_config+SortConfig.key_end], rax
+
+.success:
+    xor     rax, rax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Read the lines from the specified file.
+;
+; C prototype equivalent:
+;
+;     int sort_file(SortState *state, const char *file);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Input: RSI (string) - file path ("-" means stdin).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+sort_file:
+section .rodata
+    .open_fmt       db  "sort: cannot read: '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .file       equ     8   ; "char *"
+    .fd         equ    16   ; int.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.file], rsi
+
+    ;--------------------
+
+    mov     qword [rsp+.fd], STDIN_FD
+
+    ; Handle the stdin alias.
+    cmp     byte [rsi], '-'
+    jne     .open_file
+
+    cmp     byte [rsi+1], 0
+    je      .opened
+
+.open_file:
+    mov     rdi, [rsp+.file]
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+.opened:
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    mov     rdx, [rsp+.file]
+    dcall   sort_fd
+    mov     [rsp+.ret], rax
+
+    cmp     qword [rsp+.fd], STDIN_FD
+    je      .done
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.done:
+    mov     rax, [rsp+.ret]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.file]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Read all the lines available from the specified file
+;   descriptor into the arena, creating a record for each.
+;
+; C prototype equivalent:
+;
+;     int sort_fd(SortState *state, int fd, const char *name);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Input: RSI (integer) - file descriptor.
+; - Input: RDX (string) - name of file (for error messages).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - At most half of the free space is filled by each read, leaving
+;   space for the records.
+;
+; - When there is no space left, the records are written to a run
+;   (see sort_spill()).
+;---------------------------------------------------------------------
+
+sort_fd:
+section .rodata
+    .read_fmt       db  "sort: %s: read error",10,0
+    .too_long_fmt   db  "sort: %s: line too long for buffer (see -S)",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .fd         equ     8   ; int.
+    .name       equ    16   ; "char *"
+    .nl         equ    24   ; "char *": end of current line.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+    mov     [rsp+.name], rdx
+
+    ;--------------------
+
+.read_more:
+    mov     rcx, [rsp+.state]
+
+    mov     rdx, [rcx+SortState.recs]
+    sub     rdx, [rcx+SortState.data_end]
+    cmp     rdx, SORT_MIN_READ_SIZE
+    jae     .read
+
+    ; The arena is full, so write out the sorted records.
+    mov     rax, [rcx+SortState.recs]
+    cmp     rax, [rcx+SortState.arena_end]
+    je      .error_too_long ; No records, so a single line fills the arena.
+
+    mov     rdi, rcx
+    dcall   sort_spill
+    cmp     rax, 0
+    jne     .error
+
+    jmp     .read_more
+
+.read:
+    shr     rdx, 1
+    cmp     rdx, SORT_READ_SIZE
+    jbe     .read_size_ok
+
+    mov     rdx, SORT_READ_SIZE
+
+.read_size_ok:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rcx+SortState.data_end]
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .eof
+    jl      .error_read
+
+    mov     rcx, [rsp+.state]
+    add     [rcx+SortState.data_end], rax
+
+.next_line:
+    mov     rcx, [rsp+.state]
+    mov     rdi, [rcx+SortState.line_start]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rcx+SortState.data_end]
+    sub     rdx, rdi
+    dcall   memchr
+    cmp     rax, 0
+    je      .read_more
+
+    mov     [rsp+.nl], rax
+
+    mov     rdi, [rsp+.state]
+    dcall   sort_reserve_record
+    cmp     rax, 0
+    jl      .error
+    jg      .next_line ; Data moved, so find the line again.
+
+    mov     rdx, [rsp+.nl]
+    mov     rcx, [rsp+.state]
+    mov     rsi, [rcx+SortState.line_start]
+    sub     rdx, rsi
+
+    inc     qword [rsp+.nl]
+    mov     rax, [rsp+.nl]
+    mov     [rcx+SortState.line_start], rax
+
+    jmp     .add_record
+
+.eof:
+    ;--------------------
+    ; Handle a final line without a newline.
+
+    mov     rcx, [rsp+.state]
+    mov     rax, [rcx+SortState.data_end]
+    cmp     rax, [rcx+SortState.line_start]
+    je      .success
+
+    mov     rdi, [rsp+.state]
+    dcall   sort_reserve_record
+    cmp     rax, 0
+    jl      .error
+
+    mov     rcx, [rsp+.state]
+    mov     rsi, [rcx+SortState.line_start]
+    mov     rdx, [rcx+SortState.data_end]
+    mov     [rcx+SortState.line_start], rdx
+    sub     rdx, rsi
+
+    mov     qword [rsp+.nl], 0 ; Marks the final line.
+
+.add_record:
+    ; Lengths are stored as 32-bit values.
+    mov     rax, rdx
+    shr     rax, 32
+    jnz     .error_too_long
+
+    sub     qword [rcx+SortState.recs], SortRec_size
+    mov     rdi, [rcx+SortState.recs]
+    dcall   sort_make_record
+
+    cmp     qword [rsp+.nl], 0
+    jne     .next_line
+
+.success:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error_read:
+    mov     rsi, .read_fmt
+    jmp     .show_error
+
+.error_too_long:
+    mov     rsi, .too_long_fmt
+
+.show_error:
+    mov     rdi, STDERR_FD
+    mov     rdx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Ensure there is space in the arena for another record.
+;
+; C prototype equivalent:
+;
+;     int sort_reserve_record(SortState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Output: RAX (integer) - 0 if there is space, 1 if there is
+;   space but the unprocessed line data was moved, or -1 on error.
+;---------------------------------------------------------------------
+
+sort_reserve_record:
+    prologue_with_vars 0
+
+    mov     rax, [rdi+SortState.recs]
+    sub     rax, [rdi+SortState.data_end]
+    cmp     rax, SortRec_size
+    jae     .space
+
+    dcall   sort_spill
+    cmp     rax, 0
+    jne     .error
+
+    mov     rax, 1
+    jmp     .out
+
+.space:
+    xor     rax, rax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Sort the records in the arena, write them to a new run
+;   and empty the arena.
+;
+; C prototype equivalent:
+;
+;     int sort_spill(SortState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Any unprocessed line data is moved to the start of the arena.
+;
+; - If the maximum number of runs is reached, they are merged into a
+;   single run.
+;---------------------------------------------------------------------
+
+sort_spill:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .fd         equ     8   ; int: run file.
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+
+    dcall   sort_create_run
+    cmp     rax, 0
+    jl      .error
+
+    mov     [rsp+.fd], rax
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    dcall   sort_records
+    cmp     rax, 0
+    jne     .error_close
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    dcall   sort_add_run
+    cmp     rax, 0
+    jne     .error
+
+    ;--------------------
+    ; Empty the arena.
+
+    mov     rcx, [rsp+.state]
+
+    mov     rdi, [rcx+SortState.arena]
+    mov     rsi, [rcx+SortState.line_start]
+    mov     rdx, [rcx+SortState.data_end]
+    sub     rdx, rsi
+
+    mov     rax, [rcx+SortState.arena]
+    mov     [rcx+SortState.line_start], rax
+    add     rax, rdx
+    mov     [rcx+SortState.data_end], rax
+
+    mov     rax, [rcx+SortState.arena_end]
+    mov     [rcx+SortState.recs], rax
+
+    dcall   memmove
+
+    ;--------------------
+    ; Limit the number of runs.
+
+    mov     rcx, [rsp+.state]
+    cmp     qword [rcx+SortState.nruns], SORT_MAX_RUNS
+    jb      .success
+
+    mov     rdi, rcx
+    dcall   sort_create_run
+    cmp     rax, 0
+    jl      .error
+
+    mov     [rsp+.fd], rax
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    dcall   sort_merge_runs
+    cmp     rax, 0
+    jne     .error_close
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd]
+    dcall   sort_add_run
+    cmp     rax, 0
+    jne     .error
+
+.success:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error_close:
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Create an (unlinked) temporary file for a run.
+;
+; C prototype equivalent:
+;
+;     int sort_create_run(SortState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Output: RAX (integer) - file descriptor, or -1 on error.
+;
+; Notes:
+;
+; The file is unlinked immediately, so it is removed automatically
+; when closed (even if the command fails).
+;---------------------------------------------------------------------
+
+sort_create_run:
+section .rodata
+    .template_fmt   db  "%s/abox-sort.XXXXXX",0
+    .create_fmt     db  "sort: cannot create temporary file in '%s'",10,0
+section .text
+    prologue_with_vars 2
+
+    alloc_space PATH_MAX
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .fd         equ     8   ; int.
+    .path       equ    16   ; char[PATH_MAX]
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+
+    lea     rdi, [rsp+.path]
+    mov     rsi, PATH_MAX
+    mov     rdx, .template_fmt
+    mov     rax, [rsp+.state]
+    mov     rcx, [rax+SortState.tmpdir]
+    xor     rax, rax
+    dcall   snprintf
+    cdqe
+
+    cmp     rax, PATH_MAX
+    jae     .error
+
+    lea     rdi, [rsp+.path]
+    dcall   mkstemp
+    cdqe
+    cmp     rax, -1
+    je      .error
+
+    mov     [rsp+.fd], rax
+
+    lea     rdi, [rsp+.path]
+    dcall   unlink
+
+    mov     rax, [rsp+.fd]
+
+.out:
+    free_space PATH_MAX
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rdi, STDERR_FD
+    mov     rsi, .create_fmt
+    mov     rax, [rsp+.state]
+    mov     rdx, [rax+SortState.tmpdir]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Add a run to the list of runs.
+;
+; C prototype equivalent:
+;
+;     int sort_add_run(SortState *state, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Input: RSI (integer) - file descriptor of run (which is closed on
+;   error).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+sort_add_run:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .fd         equ     8   ; int.
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+
+    ; Rewind, ready to be merged.
+    mov     rdi, rsi
+    mov     rsi, 0
+    mov     rdx, SEEK_SET
+    dcall   lseek
+    cmp     rax, 0
+    jl      .error
+
+    mov     rcx, [rsp+.state]
+    mov     rdi, [rcx+SortState.runs]
+    mov     rsi, [rcx+SortState.nruns]
+    inc     rsi
+    shl     rsi, 3 ; Convert to bytes.
+    dcall   realloc
+    cmp     rax, 0
+    je      .error
+
+    mov     rcx, [rsp+.state]
+    mov     [rcx+SortState.runs], rax
+
+    mov     rdx, [rcx+SortState.nruns]
+    mov     rsi, [rsp+.fd]
+    mov     [rax+rdx*8], rsi
+    inc     qword [rcx+SortState.nruns]
+
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error:
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Close all the runs.
+;
+; C prototype equivalent:
+;
+;     void sort_close_runs(SortState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Output: None.
+;---------------------------------------------------------------------
+
+sort_close_runs:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .i          equ     8   ; size_t: run index.
+
+    ;--------------------
+
+    mov     [rsp+.state], rdi
+    mov     qword [rsp+.i], 0
+
+.next_run:
+    mov     rcx, [rsp+.state]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rcx+SortState.nruns]
+    je      .free
+
+    mov     rdx, [rcx+SortState.runs]
+    mov     rdi, [rdx+rax*8]
+    dcall   close
+
+    inc     qword [rsp+.i]
+    jmp     .next_run
+
+.free:
+    mov     rdi, [rcx+SortState.runs]
+    dcall   free
+
+    mov     rcx, [rsp+.state]
+    mov     qword [rcx+SortState.runs], 0
+    mov     qword [rcx+SortState.nruns], 0
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Sort the records in the arena and write the lines.
+;
+; C prototype equivalent:
+;
+;     int sort_records(SortState *state, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Input: RSI (integer) - file descriptor to write to.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The records are split into equal groups, each sorted by a separate
+;   thread. The sorted groups are then merged by sort_merge().
+;
+; - If a thread cannot be created, its group is sorted by the calling
+;   thread.
+;---------------------------------------------------------------------
+
+sort_records:
+    prologue_with_vars 8
+
+    alloc_space SORT_RECORDS_SPACE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .fd         equ     8   ; int.
+    .n          equ    16   ; size_t: number of records.
+    .threads    equ    24   ; size_t: number of groups.
+    .per        equ    32   ; size_t: records per group.
+    .i          equ    40   ; size_t: group index.
+    .ret        equ    48   ; int: return value.
+    .unused     equ    56   ; padding.
+    .writer     equ    64   ; SortWriter.
+    .chunks     equ    (.writer + SortWriter_size) ; SortChunk array.
+    .sources    equ    (.chunks + (SortChunk_size * SORT_MAX_THREADS)) ; SortSource array.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+
+    mov     qword [rsp+.ret], -1
+
+    ;--------------------
+
+    lea     rdi, [rsp+.writer]
+    mov     rsi, [rsp+.fd]
+    dcall   sort_writer_init
+    cmp     rax, 0
+    jne     .out
+
+    mov     rcx, [rsp+.state]
+    mov     rax, [rcx+SortState.arena_end]
+    sub     rax, [rcx+SortState.recs]
+    shr     rax, 5 ; Divide by SortRec_size.
+    mov     [rsp+.n], rax
+
+    cmp     rax, 0
+    je      .merged ; Nothing to do.
+
+    ;--------------------
+    ; threads = max(1, min(get_nprocs(), SORT_MAX_THREADS,
+    ;                      n / SORT_MIN_THREAD_RECORDS))
+
+    dcall   get_nprocs
+    cdqe
+    mov     [rsp+.threads], rax
+
+    cmp     qword [rsp+.threads], SORT_MAX_THREADS
+    jle     .cpus_ok
+
+    mov     qword [rsp+.threads], SORT_MAX_THREADS
+
+.cpus_ok:
+    mov     rax, [rsp+.n]
+    shr     rax, 14 ; Divide by SORT_MIN_THREAD_RECORDS.
+
+    cmp     rax, [rsp+.threads]
+    jge     .size_ok
+
+    mov     [rsp+.threads], rax
+
+.size_ok:
+    cmp     qword [rsp+.threads], 1
+    jge     .split
+
+    mov     qword [rsp+.threads], 1
+
+.split:
+    ; per = ceil(n / threads)
+    mov     rax, [rsp+.n]
+    add     rax, [rsp+.threads]
+    dec     rax
+    xor     rdx, rdx
+    div     qword [rsp+.threads]
+    mov     [rsp+.per], rax
+
+    ;--------------------
+    ; Start a thread for each group.
+
+    mov     qword [rsp+.i], 0
+
+.next_chunk:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.threads]
+    je      .join
+
+    ; rbx = &chunks[i]
+    imul    rbx, rax, SortChunk_size
+    lea     rbx, [rsp+.chunks+rbx]
+
+    ; start = i * per
+    imul    rax, [rsp+.per]
+
+    mov     rcx, rax
+    shl     rcx, 5 ; Multiply by SortRec_size.
+    mov     rdx, [rsp+.state]
+    add     rcx, [rdx+SortState.recs]
+    mov     [rbx+SortChunk.recs], rcx
+
+    ; count = min(per, n - start) (or 0 if past the end)
+    mov     rcx, [rsp+.n]
+    sub     rcx, rax
+    jg      .some_left
+
+    xor     rcx, rcx
+
+.some_left:
+    cmp     rcx, [rsp+.per]
+    jle     .got_count
+
+    mov     rcx, [rsp+.per]
+
+.got_count:
+    mov     [rbx+SortChunk.count], rcx
+    mov     qword [rbx+SortChunk.started], 0
+
+    ; The first group is sorted by this thread.
+    cmp     qword [rsp+.i], 0
+    je      .chunk_started
+
+    lea     rdi, [rbx+SortChunk.thread]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, sort_chunk_thread
+    mov     rcx, rbx
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .sort_chunk_here
+
+    mov     qword [rbx+SortChunk.started], 1
+    jmp     .chunk_started
+
+.sort_chunk_here:
+    mov     rdi, rbx
+    dcall   sort_chunk_thread
+
+.chunk_started:
+    inc     qword [rsp+.i]
+    jmp     .next_chunk
+
+    ;--------------------
+    ; Sort the first group, then wait for the threads.
+
+.join:
+    lea     rdi, [rsp+.chunks]
+    dcall   sort_chunk_thread
+
+    mov     qword [rsp+.i], 0
+
+.join_next:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.threads]
+    je      .merge
+
+    imul    rbx, rax, SortChunk_size
+    lea     rbx, [rsp+.chunks+rbx]
+
+    cmp     qword [rbx+SortChunk.started], 0
+    je      .create_source
+
+    mov     rdi, [rbx+SortChunk.thread]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+.create_source:
+    ; rcx = &sources[i]
+    mov     rax, [rsp+.i]
+    imul    rcx, rax, SortSource_size
+    lea     rcx, [rsp+.sources+rcx]
+
+    mov     qword [rcx+SortSource.fd], -1
+    mov     qword [rcx+SortSource.done], 0
+
+    mov     rax, [rbx+SortChunk.recs]
+    mov     [rcx+SortSource.next], rax
+
+    mov     rdx, [rbx+SortChunk.count]
+    shl     rdx, 5 ; Multiply by SortRec_size.
+    add     rax, rdx
+    mov     [rcx+SortSource.end], rax
+
+    inc     qword [rsp+.i]
+    jmp     .join_next
+
+.merge:
+    lea     rdi, [rsp+.sources]
+    mov     rsi, [rsp+.threads]
+    lea     rdx, [rsp+.writer]
+    dcall   sort_merge
+    cmp     rax, 0
+    jne     .finish
+
+.merged:
+    mov     qword [rsp+.ret], 0
+
+.finish:
+    lea     rdi, [rsp+.writer]
+    dcall   sort_writer_finish
+    cmp     rax, 0
+    je      .out
+
+    mov     qword [rsp+.ret], -1
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space SORT_RECORDS_SPACE
+    epilogue_with_vars 8
+    ret
+
+;---------------------------------------------------------------------
+; Description: Thread function to sort a single group of records.
+;
+; C prototype equivalent:
+;
+;     void *sort_chunk_thread(SortChunk *chunk);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortChunk to sort.
+; - Output: RAX (address) - always NULL.
+;---------------------------------------------------------------------
+
+sort_chunk_thread:
+    prologue_with_vars 0
+
+    mov     rsi, [rdi+SortChunk.count]
+    mov     rdi, [rdi+SortChunk.recs]
+    mov     rdx, 0 ; Start with the most significant byte.
+    dcall   sort_radix
+
+    xor     rax, rax
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Sort records using an in-place MSD radix sort on the
+;   record prefixes.
+;
+; C prototype equivalent:
+;
+;     void sort_radix(SortRec *recs, size_t n, size_t level);
+;
+; Parameters:
+;
+; - Input: RDI (address) - records.
+; - Input: RSI (integer) - number of records.
+; - Input: RDX (integer) - prefix byte to sort on (0 is the most
+;   significant byte).
+; - Output: None.
+;
+; Notes:
+;
+; - The records are counted into 256 buckets by the prefix byte, then
+;   permuted in place by following cycles ("American flag sort"), so no
+;   extra memory is required. Each bucket is then sorted on the next
+;   byte.
+;
+; - Small groups are sorted with sort_insertion(). Records whose
+;   prefixes are identical are sorted with qsort(3) using the full
+;   comparison.
+;
+; - If all the records share the same byte, the next byte is used
+;   without permuting.
+;
+; See: "Engineering Radix Sort", McIlroy, Bostic and McIlroy.
+;---------------------------------------------------------------------
+
+sort_radix:
+    prologue_with_vars 6
+
+    alloc_space (256 * 8 * 3)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .recs       equ     0   ; "SortRec *"
+    .n          equ     8   ; size_t.
+    .level      equ    16   ; size_t.
+    .shift      equ    24   ; size_t: bit shift for the current byte.
+    .bucket     equ    32   ; size_t: bucket being recursed into.
+    .unused     equ    40   ; padding.
+    .counts     equ    48   ; size_t[256]: records in each bucket.
+    .heads      equ    (.counts + (256 * 8)) ; size_t[256]: next free slot in bucket.
+    .ends       equ    (.heads + (256 * 8))  ; size_t[256]: end of bucket.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.recs], rdi
+    mov     [rsp+.n], rsi
+    mov     [rsp+.level], rdx
+
+    ;--------------------
+
+.again:
+    cmp     qword [rsp+.n], SORT_INSERTION_THRESHOLD
+    jb      .insertion_sort
+
+    cmp     qword [rsp+.level], SORT_PREFIX_BYTES
+    jae     .compare_sort
+
+    ; shift = 56 - (level * 8)
+    mov     rcx, [rsp+.level]
+    shl     rcx, 3
+    neg     rcx
+    add     rcx, 56
+    mov     [rsp+.shift], rcx
+
+    ;--------------------
+    ; Count the records in each bucket.
+
+    lea     rdi, [rsp+.counts]
+    xor     rax, rax
+    mov     rcx, 256
+    rep     stosq
+
+    mov     rcx, [rsp+.shift]
+    mov     rsi, [rsp+.recs]
+    mov     rdx, [rsp+.n]
+
+.count:
+    mov     rax, [rsi+SortRec.prefix]
+    shr     rax, cl
+    movzx   eax, al
+    inc     qword [rsp+.counts+rax*8]
+
+    add     rsi, SortRec_size
+    dec     rdx
+    jnz     .count
+
+    ; If all the records are in the same bucket, move on to the next
+    ; byte.
+    mov     rsi, [rsp+.recs]
+    mov     rax, [rsi+SortRec.prefix]
+    shr     rax, cl
+    movzx   eax, al
+    mov     rdx, [rsp+.counts+rax*8]
+    cmp     rdx, [rsp+.n]
+    jne     .partition
+
+    inc     qword [rsp+.level]
+    jmp     .again
+
+.partition:
+    ;--------------------
+    ; Calculate the bucket boundaries.
+
+    xor     eax, eax ; Bucket.
+    xor     edx, edx ; Total.
+
+.bounds:
+    mov     [rsp+.heads+rax*8], rdx
+    add     rdx, [rsp+.counts+rax*8]
+    mov     [rsp+.ends+rax*8], rdx
+
+    inc     eax
+    cmp     eax, 256
+    jb      .bounds
+
+    ;--------------------
+    ; Permute the records (no calls, so everything stays in registers):
+    ;
+    ; - rsi: records.
+    ; - rcx: shift.
+    ; - r8: current bucket.
+    ; - xmm0+xmm1: record being placed.
+    ; - r11: prefix of record being placed.
+
+    mov     rsi, [rsp+.recs]
+    xor     r8, r8
+
+.next_slot:
+    mov     r9, [rsp+.heads+r8*8]
+    cmp     r9, [rsp+.ends+r8*8]
+    jae     .next_bucket
+
+    ; Take the record in the next unplaced slot of the bucket.
+    shl     r9, 5 ; Multiply by SortRec_size.
+    movdqu  xmm0, [rsi+r9]
+    movdqu  xmm1, [rsi+r9+16]
+    mov     r11, [rsi+r9+SortRec.prefix]
+
+.place:
+    mov     rax, r11
+    shr     rax, cl
+    movzx   eax, al
+    cmp     rax, r8
+    je      .store
+
+    ; Swap with the record in the next unplaced slot of its bucket.
+    mov     rdx, [rsp+.heads+rax*8]
+    inc     qword [rsp+.heads+rax*8]
+    shl     rdx, 5 ; Multiply by SortRec_size.
+
+    movdqu  xmm2, [rsi+rdx]
+    movdqu  xmm3, [rsi+rdx+16]
+    mov     r11, [rsi+rdx+SortRec.prefix]
+
+    movdqu  [rsi+rdx], xmm0
+    movdqu  [rsi+rdx+16], xmm1
+
+    movdqa  xmm0, xmm2
+    movdqa  xmm1, xmm3
+    jmp     .place
+
+.store:
+    ; The record belongs in the slot it was taken from.
+    mov     rdx, [rsp+.heads+r8*8]
+    inc     qword [rsp+.heads+r8*8]
+    shl     rdx, 5 ; Multiply by SortRec_size.
+
+    movdqu  [rsi+rdx], xmm0
+    movdqu  [rsi+rdx+16], xmm1
+    jmp     .next_slot
+
+.next_bucket:
+    inc     r8
+    cmp     r8, 256
+    jb      .next_slot
+
+    ;--------------------
+    ; Sort each bucket on the next byte.
+
+    inc     qword [rsp+.level]
+    mov     qword [rsp+.bucket], 0
+
+.next_sub_sort:
+    mov     rax, [rsp+.bucket]
+    mov     rsi, [rsp+.counts+rax*8]
+    cmp     rsi, 1
+    jbe     .sub_sorted
+
+    ; The bucket starts at ends[bucket] - counts[bucket].
+    mov     rdi, [rsp+.ends+rax*8]
+    sub     rdi, rsi
+    shl     rdi, 5 ; Multiply by SortRec_size.
+    add     rdi, [rsp+.recs]
+    mov     rdx, [rsp+.level]
+    dcall   sort_radix
+
+.sub_sorted:
+    inc     qword [rsp+.bucket]
+    cmp     qword [rsp+.bucket], 256
+    jb      .next_sub_sort
+
+    jmp     .out
+
+.insertion_sort:
+    mov     rdi, [rsp+.recs]
+    mov     rsi, [rsp+.n]
+    dcall   sort_insertion
+    jmp     .out
+
+.compare_sort:
+    ; The prefixes are identical, so compare the full keys.
+    mov     rdi, [rsp+.recs]
+    mov     rsi, [rsp+.n]
+    mov     rdx, SortRec_size
+    mov     rcx, sort_compare
+    dcall   qsort
+
+.out:
+    free_space (256 * 8 * 3)
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Sort a small number of records using insertion sort.
+;
+; C prototype equivalent:
+;
+;     void sort_insertion(SortRec *recs, size_t n);
+;
+; Parameters:
+;
+; - Input: RDI (address) - records.
+; - Input: RSI (integer) - number of records.
+; - Output: None.
+;---------------------------------------------------------------------
+
+sort_insertion:
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .recs       equ     0   ; "SortRec *"
+    .n          equ     8   ; size_t.
+    .i          equ    16   ; size_t: record to insert.
+    .j          equ    24   ; size_t: insertion position.
+    .rec        equ    32   ; SortRec: record being inserted.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.recs], rdi
+    mov     [rsp+.n], rsi
+
+    ;--------------------
+
+    mov     qword [rsp+.i], 1
+
+.next_record:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.n]
+    jae     .out
+
+    mov     [rsp+.j], rax
+
+    shl     rax, 5 ; Multiply by SortRec_size.
+    add     rax, [rsp+.recs]
+    movdqu  xmm0, [rax]
+    movdqu  xmm1, [rax+16]
+    movdqu  [rsp+.rec], xmm0
+    movdqu  [rsp+.rec+16], xmm1
+
+.shift:
+    cmp     qword [rsp+.j], 0
+    je      .insert
+
+    ; Compare with recs[j-1].
+    mov     rdi, [rsp+.j]
+    dec     rdi
+    shl     rdi, 5 ; Multiply by SortRec_size.
+    add     rdi, [rsp+.recs]
+    lea     rsi, [rsp+.rec]
+    dcall   sort_compare
+    cmp     eax, 0
+    jle     .insert
+
+    ; recs[j] = recs[j-1]
+    mov     rax, [rsp+.j]
+    shl     rax, 5 ; Multiply by SortRec_size.
+    add     rax, [rsp+.recs]
+    movdqu  xmm0, [rax-SortRec_size]
+    movdqu  xmm1, [rax-SortRec_size+16]
+    movdqu  [rax], xmm0
+    movdqu  [rax+16], xmm1
+
+    dec     qword [rsp+.j]
+    jmp     .shift
+
+.insert:
+    mov     rax, [rsp+.j]
+    shl     rax, 5 ; Multiply by SortRec_size.
+    add     rax, [rsp+.recs]
+    movdqu  xmm0, [rsp+.rec]
+    movdqu  xmm1, [rsp+.rec+16]
+    movdqu  [rax], xmm0
+    movdqu  [rax+16], xmm1
+
+    inc     qword [rsp+.i]
+    jmp     .next_record
+
+.out:
+    epilogue_with_vars 8
+    ret
+
+;---------------------------------------------------------------------
+; Description: Fill in a record for a line, finding the key and
+;   calculating the prefix.
+;
+; C prototype equivalent:
+;
+;     void sort_make_record(SortRec *rec, const char *line, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - record to fill in.
+; - Input: RSI (address) - start of line.
+; - Input: RDX (integer) - length of line (excluding the newline).
+; - Output: None.
+;
+; Notes:
+;
+; The prefix is an unsigned integer whose order matches the order of
+; the keys (but equal prefixes do not mean the keys are equal):
+;
+; - By default, it is the first 8 bytes of the key in big-endian
+;   order (padded with zeros).
+; - For -n, it is the integer part of the number (limited to
+;   +/-10^18), with the sign bit flipped so that negative numbers are
+;   smallest.
+; - For -r, all the bits are inverted.
+;---------------------------------------------------------------------
+
+sort_make_record:
+    prologue_with_vars 4
+
+    alloc_space SortNumber_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .rec        equ     0   ; "SortRec *"
+    .line       equ     8   ; "char *"
+    .len        equ    16   ; size_t.
+    .key        equ    24   ; "char *": start of key.
+    .number     equ    32   ; SortNumber.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.rec], rdi
+    mov     [rsp+.line], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    mov     [rdi+SortRec.line], rsi
+    mov     [rdi+SortRec.length], edx
+
+    mov     [rsp+.key], rsi
+
+    mov     rcx, [sort_config+SortConfig.key_start]
+    cmp     rcx, 0
+    je      .got_key ; The whole line.
+
+    ; Skip the fields before the key.
+    mov     rdi, rsi
+    add     rsi, [rsp+.len]
+    mov     rdx, rcx
+    dec     rdx
+    dcall   sort_skip_fields
+    mov     [rsp+.key], rax
+
+    mov     rcx, [sort_config+SortConfig.key_end]
+    cmp     rcx, 0
+    je      .got_key ; The rest of the line.
+
+    ; Find the end of the last key field.
+    mov     rdi, rax
+    mov     rsi, [rsp+.line]
+    add     rsi, [rsp+.len]
+    mov     rdx, rcx
+    sub     rdx, [sort_config+SortConfig.key_start]
+    inc     rdx
+    dcall   sort_skip_fields
+
+    mov     rdx, rax
+    jmp     .set_key
+
+.got_key:
+    mov     rdx, [rsp+.line]
+    add     rdx, [rsp+.len]
+
+.set_key:
+    ; rdx = end of key.
+    mov     rdi, [rsp+.rec]
+    mov     rsi, [rsp+.key]
+
+    sub     rdx, rsi
+    mov     [rdi+SortRec.key_len], edx
+
+    mov     rax, rsi
+    sub     rax, [rsp+.line]
+    mov     [rdi+SortRec.key], eax
+
+    test    qword [sort_config+SortConfig.flags], SORT_NUMERIC
+    jnz     .numeric
+
+    ;--------------------
+    ; Load the first 8 bytes of the key in big-endian order.
+
+    cmp     rdx, SORT_PREFIX_BYTES
+    jb      .short_key
+
+    mov     rax, [rsi]
+    bswap   rax
+    jmp     .got_prefix
+
+.short_key:
+    xor     eax, eax
+    mov     rcx, rdx
+
+.next_byte:
+    cmp     rcx, 0
+    je      .pad
+
+    shl     rax, 8
+    mov     al, [rsi]
+    inc     rsi
+    dec     rcx
+    jmp     .next_byte
+
+.pad:
+    ; Shift the bytes to the top, padding with zeros.
+    mov     rcx, SORT_PREFIX_BYTES
+    sub     rcx, rdx
+    shl     rcx, 3
+    shl     rax, cl
+    jmp     .got_prefix
+
+.numeric:
+    ;--------------------
+    ; Use the integer part of the number.
+
+    mov     rdi, rsi
+    mov     rsi, rdx
+    lea     rdx, [rsp+.number]
+    dcall   sort_parse_number
+
+    mov     rcx, [rsp+.number+SortNumber.int_len]
+    cmp     rcx, 18
+    jbe     .convert
+
+    ; Too big, so use 10^18 (bigger than any 18 digit number).
+    mov     rax, 1000000000
+    imul    rax, rax
+    jmp     .apply_sign
+
+.convert:
+    mov     rsi, [rsp+.number+SortNumber.int]
+    xor     eax, eax
+
+.next_digit:
+    cmp     rcx, 0
+    je      .apply_sign
+
+    imul    rax, rax, 10
+    movzx   edx, byte [rsi]
+    sub     edx, '0'
+    add     rax, rdx
+
+    inc     rsi
+    dec     rcx
+    jmp     .next_digit
+
+.apply_sign:
+    cmp     qword [rsp+.number+SortNumber.neg], 0
+    je      .flip_sign_bit
+
+    neg     rax
+
+.flip_sign_bit:
+    ; Make the order of the unsigned value match the signed value.
+    btc     rax, 63
+
+.got_prefix:
+    test    qword [sort_config+SortConfig.flags], SORT_REVERSE
+    jz      .save_prefix
+
+    not     rax
+
+.save_prefix:
+    mov     rdi, [rsp+.rec]
+    mov     [rdi+SortRec.prefix], rax
+
+    free_space SortNumber_size
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Skip the specified number of fields.
+;
+; C prototype equivalent:
+;
+;     const char *sort_skip_fields(const char *p, const char *end,
+;                                  size_t count);
+;
+; Parameters:
+;
+; - Input: RDI (address) - current position.
+; - Input: RSI (address) - end of line.
+; - Input: RDX (integer) - number of fields to skip.
+; - Output: RAX (address) - position after the fields (or the end of
+;   the line).
+;
+; Notes:
+;
+; As for GNU sort(1), a field consists of any leading blanks followed by
+; non-blank characters.
+;---------------------------------------------------------------------
+
+sort_skip_fields:
+    prologue_with_vars 0
+
+.next_field:
+    cmp     rdx, 0
+    je      .out
+
+.blanks:
+    cmp     rdi, rsi
+    jae     .out
+
+    mov     al, [rdi]
+    cmp     al, ' '
+    je      .blank
+
+    cmp     al, 9 ; '\t'
+    jne     .chars
+
+.blank:
+    inc     rdi
+    jmp     .blanks
+
+.chars:
+    cmp     rdi, rsi
+    jae     .out
+
+    mov     al, [rdi]
+    cmp     al, ' '
+    je      .field_done
+
+    cmp     al, 9 ; '\t'
+    je      .field_done
+
+    inc     rdi
+    jmp     .chars
+
+.field_done:
+    dec     rdx
+    jmp     .next_field
+
+.out:
+    mov     rax, rdi
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Parse a number (for -n).
+;
+; C prototype equivalent:
+;
+;     void sort_parse_number(const char *p, size_t len,
+;                            SortNumber *number);
+;
+; Parameters:
+;
+; - Input: RDI (address) - start of key.
+; - Input: RSI (integer) - length of key.
+; - Input: RDX (address) - SortNumber to fill in.
+; - Output: None.
+;
+; Notes:
+;
+; - Leading blanks are skipped. Anything after the number is ignored,
+;   and a key that does not start with a number is zero.
+;
+; - Leading zeros of the integer part and trailing zeros of the
+;   fraction are removed, so a number is zero if both parts are empty.
+;---------------------------------------------------------------------
+
+sort_parse_number:
+    prologue_with_vars 0
+
+    add     rsi, rdi ; End of key.
+
+    mov     qword [rdx+SortNumber.neg], 0
+    mov     qword [rdx+SortNumber.frac_len], 0
+
+.skip_blanks:
+    cmp     rdi, rsi
+    jae     .int_start
+
+    mov     al, [rdi]
+    cmp     al, ' '
+    je      .blank
+
+    cmp     al, 9 ; '\t'
+    jne     .check_sign
+
+.blank:
+    inc     rdi
+    jmp     .skip_blanks
+
+.check_sign:
+    cmp     al, '-'
+    jne     .skip_zeros
+
+    mov     qword [rdx+SortNumber.neg], 1
+    inc     rdi
+
+.skip_zeros:
+    cmp     rdi, rsi
+    jae     .int_start
+
+    cmp     byte [rdi], '0'
+    jne     .int_start
+
+    inc     rdi
+    jmp     .skip_zeros
+
+.int_start:
+    mov     [rdx+SortNumber.int], rdi
+    mov     rcx, rdi
+
+.int_digits:
+    cmp     rcx, rsi
+    jae     .int_end
+
+    mov     al, [rcx]
+    sub     al, '0'
+    cmp     al, 9
+    ja      .int_end
+
+    inc     rcx
+    jmp     .int_digits
+
+.int_end:
+    mov     rax, rcx
+    sub     rax, rdi
+    mov     [rdx+SortNumber.int_len], rax
+
+    mov     [rdx+SortNumber.frac], rcx
+
+    cmp     rcx, rsi
+    jae     .out
+
+    cmp     byte [rcx], '.'
+    jne     .out
+
+    inc     rcx
+    mov     [rdx+SortNumber.frac], rcx
+    mov     r8, rcx
+
+.frac_digits:
+    cmp     r8, rsi
+    jae     .strip_zeros
+
+    mov     al, [r8]
+    sub     al, '0'
+    cmp     al, 9
+    ja      .strip_zeros
+
+    inc     r8
+    jmp     .frac_digits
+
+.strip_zeros:
+    cmp     r8, rcx
+    jbe     .frac_end
+
+    cmp     byte [r8-1], '0'
+    jne     .frac_end
+
+    dec     r8
+    jmp     .strip_zeros
+
+.frac_end:
+    sub     r8, rcx
+    mov     [rdx+SortNumber.frac_len], r8
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Compare two records.
+;
+; C prototype equivalent:
+;
+;     int sort_compare(const SortRec *a, const SortRec *b);
+;
+; Parameters:
+;
+; - Input: RDI (address) - first record.
+; - Input: RSI (address) - second record.
+; - Output: RAX (integer) - negative if a sorts before b, 0 if
+;   equal, else positive.
+;
+; Notes:
+;
+; - The prefixes are compared first. Only if they are equal are the
+;   keys themselves compared.
+;
+; - As for GNU sort(1), lines with equal keys are compared as whole
+;   lines unless -u is specified.
+;
+; - Also used as the qsort(3) comparison function.
+;---------------------------------------------------------------------
+
+sort_compare:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .a          equ     0   ; "SortRec *"
+    .b          equ     8   ; "SortRec *"
+
+    ;--------------------
+
+    ; Note: The prefixes already take -r into account.
+    mov     rax, [rdi+SortRec.prefix]
+    cmp     rax, [rsi+SortRec.prefix]
+    jb      .less
+    ja      .greater
+
+    mov     [rsp+.a], rdi
+    mov     [rsp+.b], rsi
+
+    ;--------------------
+    ; Compare the keys.
+
+    mov     rax, rdi
+    mov     r8, rsi
+
+    mov     edi, [rax+SortRec.key]
+    add     rdi, [rax+SortRec.line]
+    mov     esi, [rax+SortRec.key_len]
+
+    mov     edx, [r8+SortRec.key]
+    add     rdx, [r8+SortRec.line]
+    mov     ecx, [r8+SortRec.key_len]
+
+    test    qword [sort_config+SortConfig.flags], SORT_NUMERIC
+    jnz     .numeric
+
+    dcall   sort_bytecmp
+    jmp     .check_keys
+
+.numeric:
+    dcall   sort_numcmp
+
+.check_keys:
+    cmp     eax, 0
+    jne     .check_reverse
+
+    ;--------------------
+    ; Compare the whole lines.
+
+    mov     rcx, [sort_config+SortConfig.flags]
+    test    rcx, SORT_UNIQUE
+    jnz     .check_reverse
+
+    test    rcx, SORT_NUMERIC
+    jnz     .compare_lines
+
+    ; The key was the whole line, so they are equal.
+    cmp     qword [sort_config+SortConfig.key_start], 0
+    je      .check_reverse
+
+.compare_lines:
+    mov     rax, [rsp+.a]
+    mov     r8, [rsp+.b]
+
+    mov     rdi, [rax+SortRec.line]
+    mov     esi, [rax+SortRec.length]
+    mov     rdx, [r8+SortRec.line]
+    mov     ecx, [r8+SortRec.length]
+    dcall   sort_bytecmp
+
+.check_reverse:
+    test    qword [sort_config+SortConfig.flags], SORT_REVERSE
+    jz      .out
+
+    neg     eax
+    jmp     .out
+
+.less:
+    mov     eax, -1
+    jmp     .out
+
+.greater:
+    mov     eax, 1
+
+.out:
+    cdqe
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Compare two byte strings.
+;
+; C prototype equivalent:
+;
+;     int sort_bytecmp(const char *a, size_t a_len,
+;                      const char *b, size_t b_len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - first string.
+; - Input: RSI (integer) - length of first string.
+; - Input: RDX (address) - second string.
+; - Input: RCX (integer) - length of second string.
+; - Output: RAX (integer) - -1, 0 or 1 (a shorter string that matches
+;   the start of a longer string is smaller).
+;---------------------------------------------------------------------
+
+sort_bytecmp:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .a_len      equ     0   ; size_t.
+    .b_len      equ     8   ; size_t.
+
+    ;--------------------
+
+    mov     [rsp+.a_len], rsi
+    mov     [rsp+.b_len], rcx
+
+    ; memcmp(a, b, min(a_len, b_len))
+    mov     rsi, rdx
+    mov     rdx, rcx
+    cmp     rdx, [rsp+.a_len]
+    jbe     .compare
+
+    mov     rdx, [rsp+.a_len]
+
+.compare:
+    dcall   memcmp
+    cmp     eax, 0
+    jl      .less
+    jg      .greater
+
+    mov     rax, [rsp+.a_len]
+    cmp     rax, [rsp+.b_len]
+    jb      .less
+    ja      .greater
+
+    xor     eax, eax
+    jmp     .out
+
+.less:
+    mov     eax, -1
+    jmp     .out
+
+.greater:
+    mov     eax, 1
+
+.out:
+    cdqe
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Compare two numbers (for -n).
+;
+; C prototype equivalent:
+;
+;     int sort_numcmp(const char *a, size_t a_len,
+;                     const char *b, size_t b_len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - first key.
+; - Input: RSI (integer) - length of first key.
+; - Input: RDX (address) - second key.
+; - Input: RCX (integer) - length of second key.
+; - Output: RAX (integer) - -1, 0 or 1.
+;
+; Notes:
+;
+; The numbers are compared as strings of digits, so there is no limit
+; on their size or precision.
+;---------------------------------------------------------------------
+
+sort_numcmp:
+    prologue_with_vars 4
+
+    alloc_space (SortNumber_size * 2)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .b          equ     0   ; "char *"
+    .b_len      equ     8   ; size_t.
+    .a_sign     equ    16   ; int: -1, 0 or 1.
+    .b_sign     equ    24   ; int: -1, 0 or 1.
+    .a_num      equ    32   ; SortNumber.
+    .b_num      equ    (.a_num + SortNumber_size) ; SortNumber.
+
+    ;--------------------
+
+    mov     [rsp+.b], rdx
+    mov     [rsp+.b_len], rcx
+
+    lea     rdx, [rsp+.a_num]
+    dcall   sort_parse_number
+
+    mov     rdi, [rsp+.b]
+    mov     rsi, [rsp+.b_len]
+    lea     rdx, [rsp+.b_num]
+    dcall   sort_parse_number
+
+    ;--------------------
+    ; Determine the signs.
+
+    lea     rdi, [rsp+.a_num]
+    dcall   sort_number_sign
+    mov     [rsp+.a_sign], rax
+
+    lea     rdi, [rsp+.b_num]
+    dcall   sort_number_sign
+    mov     [rsp+.b_sign], rax
+
+    cmp     rax, [rsp+.a_sign]
+    jl      .greater ; a has the bigger sign.
+    jg      .less
+
+    cmp     rax, 0
+    je      .equal ; Both zero.
+
+    ;--------------------
+    ; Compare the magnitudes (longer integer parts are bigger).
+
+    mov     rax, [rsp+.a_num+SortNumber.int_len]
+    cmp     rax, [rsp+.b_num+SortNumber.int_len]
+    jb      .smaller
+    ja      .bigger
+
+    mov     rdi, [rsp+.a_num+SortNumber.int]
+    mov     rsi, [rsp+.b_num+SortNumber.int]
+    mov     rdx, rax
+    dcall   memcmp
+    cmp     eax, 0
+    jl      .smaller
+    jg      .bigger
+
+    mov     rdi, [rsp+.a_num+SortNumber.frac]
+    mov     rsi, [rsp+.a_num+SortNumber.frac_len]
+    mov     rdx, [rsp+.b_num+SortNumber.frac]
+    mov     rcx, [rsp+.b_num+SortNumber.frac_len]
+    dcall   sort_bytecmp
+    cmp     rax, 0
+    jl      .smaller
+    jg      .bigger
+
+.equal:
+    xor     eax, eax
+    jmp     .out
+
+.smaller:
+    ; The magnitude of a is smaller, so for negative numbers it is
+    ; bigger.
+    cmp     qword [rsp+.a_sign], 0
+    jl      .greater
+
+.less:
+    mov     rax, -1
+    jmp     .out
+
+.bigger:
+    cmp     qword [rsp+.a_sign], 0
+    jl      .less
+
+.greater:
+    mov     rax, 1
+
+.out:
+    free_space (SortNumber_size * 2)
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Determine the sign of a parsed number.
+;
+; C prototype equivalent:
+;
+;     long sort_number_sign(const SortNumber *number);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortNumber.
+; - Output: RAX (integer) - -1 if negative, 0 if zero, else 1.
+;---------------------------------------------------------------------
+
+sort_number_sign:
+    prologue_with_vars 0
+
+    xor     rax, rax
+
+    cmp     qword [rdi+SortNumber.int_len], 0
+    jne     .not_zero
+
+    cmp     qword [rdi+SortNumber.frac_len], 0
+    je      .out
+
+.not_zero:
+    mov     rax, 1
+
+    cmp     qword [rdi+SortNumber.neg], 0
+    je      .out
+
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Merge sorted sources and write the lines in order.
+;
+; C prototype equivalent:
+;
+;     int sort_merge(SortSource *sources, size_t k, SortWriter *writer);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of sources.
+; - Input: RSI (integer) - number of sources (1 to SORT_MAX_RUNS).
+; - Input: RDX (address) - SortWriter.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The sources are merged using a loser tree (a tournament tree where
+;   each internal node holds the loser of the match at that node, and
+;   tree[0] the overall winner). After writing the winner, only the
+;   path from its leaf to the root needs to be replayed, so each line
+;   costs log2(k) comparisons.
+;
+; - The tree is built by starting with every node holding a
+;   "sentinel" (value k) that beats every source, then adding each
+;   source in turn (see sort_adjust()).
+;
+; See: "The Art of Computer Programming, Volume 3", Knuth, 5.4.1.
+;---------------------------------------------------------------------
+
+sort_merge:
+    prologue_with_vars 6
+
+    alloc_space (SORT_MAX_RUNS * 8)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .sources    equ     0   ; "SortSource *"
+    .k          equ     8   ; size_t.
+    .writer     equ    16   ; "SortWriter *"
+    .i          equ    24   ; size_t: source index.
+    .ret        equ    32   ; int: return value.
+    .unused     equ    40   ; padding.
+    .tree       equ    48   ; size_t[SORT_MAX_RUNS]: loser tree.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.sources], rdi
+    mov     [rsp+.k], rsi
+    mov     [rsp+.writer], rdx
+
+    mov     qword [rsp+.ret], -1
+
+    ;--------------------
+    ; Read the first line of each source.
+
+    mov     qword [rsp+.i], 0
+
+.prime_next:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.k]
+    je      .build
+
+    imul    rdi, rax, SortSource_size
+    add     rdi, [rsp+.sources]
+    dcall   sort_source_next
+    cmp     rax, 0
+    jne     .out
+
+    inc     qword [rsp+.i]
+    jmp     .prime_next
+
+    ;--------------------
+    ; Build the tree.
+
+.build:
+    xor     rax, rax
+    mov     rcx, [rsp+.k]
+
+.fill_sentinel:
+    mov     [rsp+.tree+rax*8], rcx
+    inc     rax
+    cmp     rax, rcx
+    jb      .fill_sentinel
+
+    mov     rax, [rsp+.k]
+    mov     [rsp+.i], rax
+
+.add_source:
+    cmp     qword [rsp+.i], 0
+    je      .next_winner
+
+    dec     qword [rsp+.i]
+
+    mov     rdi, [rsp+.sources]
+    mov     rsi, [rsp+.k]
+    lea     rdx, [rsp+.tree]
+    mov     rcx, [rsp+.i]
+    dcall   sort_adjust
+
+    jmp     .add_source
+
+    ;--------------------
+    ; Write the winner and replace it with its next line.
+
+.next_winner:
+    mov     rax, [rsp+.tree]
+    mov     [rsp+.i], rax
+
+    imul    rbx, rax, SortSource_size
+    add     rbx, [rsp+.sources]
+
+    cmp     qword [rbx+SortSource.done], 0
+    jne     .success ; The best source is empty, so they all are.
+
+    mov     rdi, [rsp+.writer]
+    lea     rsi, [rbx+SortSource.rec]
+    dcall   sort_emit
+
+    mov     rax, [rsp+.writer]
+    cmp     qword [rax+SortWriter.error], 0
+    jne     .out
+
+    mov     rdi, rbx
+    dcall   sort_source_next
+    cmp     rax, 0
+    jne     .out
+
+    mov     rdi, [rsp+.sources]
+    mov     rsi, [rsp+.k]
+    lea     rdx, [rsp+.tree]
+    mov     rcx, [rsp+.i]
+    dcall   sort_adjust
+
+    jmp     .next_winner
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (SORT_MAX_RUNS * 8)
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Replay the matches on the path from a source to the
+;   root of the loser tree.
+;
+; C prototype equivalent:
+;
+;     void sort_adjust(SortSource *sources, size_t k, size_t *tree,
+;                      size_t s);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of sources.
+; - Input: RSI (integer) - number of sources.
+; - Input: RDX (address) - loser tree (k entries).
+; - Input: RCX (integer) - index of source whose line changed.
+; - Output: None.
+;---------------------------------------------------------------------
+
+sort_adjust:
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .sources    equ     0   ; "SortSource *"
+    .k          equ     8   ; size_t.
+    .tree       equ    16   ; "size_t *"
+    .winner     equ    24   ; size_t: current winner.
+    .node       equ    32   ; size_t: tree node.
+    .unused     equ    40   ; padding.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.sources], rdi
+    mov     [rsp+.k], rsi
+    mov     [rsp+.tree], rdx
+    mov     [rsp+.winner], rcx
+
+    ;--------------------
+
+    ; The parent of leaf s is node (s + k) / 2.
+    add     rcx, rsi
+    shr     rcx, 1
+    mov     [rsp+.node], rcx
+
+.next_node:
+    mov     rax, [rsp+.node]
+    cmp     rax, 0
+    je      .done
+
+    ; If the loser stored at this node beats the current winner, swap
+    ; them.
+    mov     rdi, [rsp+.sources]
+    mov     rsi, [rsp+.k]
+    mov     rdx, [rsp+.tree]
+    mov     rdx, [rdx+rax*8]
+    mov     rcx, [rsp+.winner]
+    dcall   sort_beats
+    cmp     rax, 0
+    je      .up
+
+    mov     rax, [rsp+.node]
+    mov     rdx, [rsp+.tree]
+    mov     rcx, [rdx+rax*8]
+    mov     r8, [rsp+.winner]
+    mov     [rdx+rax*8], r8
+    mov     [rsp+.winner], rcx
+
+.up:
+    shr     qword [rsp+.node], 1
+    jmp     .next_node
+
+.done:
+    mov     rdx, [rsp+.tree]
+    mov     rax, [rsp+.winner]
+    mov     [rdx], rax
+
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Determine whether the current line of one source should
+;   be written before that of another.
+;
+; C prototype equivalent:
+;
+;     bool sort_beats(SortSource *sources, size_t k, size_t a, size_t b);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of sources.
+; - Input: RSI (integer) - number of sources (which is also the
+;   sentinel value that beats all sources).
+; - Input: RDX (integer) - index of first source.
+; - Input: RCX (integer) - index of second source.
+; - Output: RAX (integer) - 1 if a beats b, else 0.
+;
+; Notes:
+;
+; - An empty source loses to everything (apart from another empty
+;   source).
+;
+; - Equal lines are ordered by source index, so lines from earlier
+;   sources are written first.
+;---------------------------------------------------------------------
+
+sort_beats:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .a          equ     0   ; size_t.
+    .b          equ     8   ; size_t.
+
+    ;--------------------
+
+    cmp     rdx, rsi
+    je      .wins ; Sentinel.
+
+    cmp     rcx, rsi
+    je      .loses ; Sentinel.
+
+    mov     [rsp+.a], rdx
+    mov     [rsp+.b], rcx
+
+    imul    rdx, rdx, SortSource_size
+    add     rdx, rdi
+
+    imul    rcx, rcx, SortSource_size
+    add     rcx, rdi
+
+    cmp     qword [rdx+SortSource.done], 0
+    jne     .loses
+
+    cmp     qword [rcx+SortSource.done], 0
+    jne     .wins
+
+    lea     rdi, [rdx+SortSource.rec]
+    lea     rsi, [rcx+SortSource.rec]
+    dcall   sort_compare
+    cmp     rax, 0
+    jl      .wins
+    jg      .loses
+
+    mov     rax, [rsp+.a]
+    cmp     rax, [rsp+.b]
+    jb      .wins
+
+.loses:
+    xor     rax, rax
+    jmp     .out
+
+.wins:
+    mov     rax, 1
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Move a source on to its next line.
+;
+; C prototype equivalent:
+;
+;     int sort_source_next(SortSource *src);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortSource.
+; - Output: RAX (integer) - 0 on success (SortSource.done is set if
+;   there are no more lines), or -1 on error.
+;
+; Notes:
+;
+; Run files are read into a buffer which is doubled in size if a line
+; does not fit.
+;---------------------------------------------------------------------
+
+sort_source_next:
+section .rodata
+    .read_fmt       db  "sort: cannot read temporary file",10,0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .src        equ     0   ; "SortSource *"
+    .rem        equ     8   ; size_t: bytes of partial line in buffer.
+
+    ;--------------------
+
+    mov     [rsp+.src], rdi
+
+    cmp     qword [rdi+SortSource.fd], -1
+    jne     .find_line
+
+    ;--------------------
+    ; Records in memory.
+
+    mov     rsi, [rdi+SortSource.next]
+    cmp     rsi, [rdi+SortSource.end]
+    jae     .done
+
+    movdqu  xmm0, [rsi]
+    movdqu  xmm1, [rsi+16]
+    movdqu  [rdi+SortSource.rec], xmm0
+    movdqu  [rdi+SortSource.rec+16], xmm1
+
+    add     qword [rdi+SortSource.next], SortRec_size
+    jmp     .success
+
+    ;--------------------
+    ; Run file.
+
+.find_line:
+    mov     rcx, [rsp+.src]
+    mov     rdi, [rcx+SortSource.next]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, [rcx+SortSource.end]
+    sub     rdx, rdi
+    dcall   memchr
+    cmp     rax, 0
+    je      .refill
+
+    mov     rcx, [rsp+.src]
+    mov     rsi, [rcx+SortSource.next]
+    mov     rdx, rax
+    sub     rdx, rsi
+
+    inc     rax
+    mov     [rcx+SortSource.next], rax
+
+    lea     rdi, [rcx+SortSource.rec]
+    dcall   sort_make_record
+    jmp     .success
+
+.refill:
+    ; Move the partial line to the start of the buffer.
+    mov     rcx, [rsp+.src]
+    mov     rdx, [rcx+SortSource.end]
+    mov     rsi, [rcx+SortSource.next]
+    sub     rdx, rsi
+    mov     [rsp+.rem], rdx
+
+    mov     rdi, [rcx+SortSource.buf]
+    mov     [rcx+SortSource.next], rdi
+    dcall   memmove
+
+    mov     rcx, [rsp+.src]
+    mov     rax, [rsp+.rem]
+    cmp     rax, [rcx+SortSource.size]
+    jb      .read
+
+    ; The buffer is full of a single line, so make it bigger.
+    shl     qword [rcx+SortSource.size], 1
+
+    mov     rdi, [rcx+SortSource.buf]
+    mov     rsi, [rcx+SortSource.size]
+    dcall   realloc
+    cmp     rax, 0
+    je      .error
+
+    mov     rcx, [rsp+.src]
+    mov     [rcx+SortSource.buf], rax
+    mov     [rcx+SortSource.next], rax
+
+.read:
+    mov     rsi, [rcx+SortSource.buf]
+    add     rsi, [rsp+.rem]
+    mov     [rcx+SortSource.end], rsi
+
+    mov     rdi, [rcx+SortSource.fd]
+    mov     rdx, [rcx+SortSource.size]
+    sub     rdx, [rsp+.rem]
+    dcall   read_block
+
+    cmp     rax, 0
+    jl      .error_read
+    je      .eof
+
+    mov     rcx, [rsp+.src]
+    add     [rcx+SortSource.end], rax
+    jmp     .find_line
+
+.eof:
+    mov     rdx, [rsp+.rem]
+    cmp     rdx, 0
+    je      .done
+
+    ; Final line without a newline.
+    mov     rcx, [rsp+.src]
+    mov     rsi, [rcx+SortSource.next]
+    mov     rax, [rcx+SortSource.end]
+    mov     [rcx+SortSource.next], rax
+
+    lea     rdi, [rcx+SortSource.rec]
+    dcall   sort_make_record
+    jmp     .success
+
+.done:
+    mov     rdi, [rsp+.src]
+    mov     qword [rdi+SortSource.done], 1
+
+.success:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Merge all the runs, then close them.
+;
+; C prototype equivalent:
+;
+;     int sort_merge_runs(SortState *state, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortState.
+; - Input: RSI (integer) - file descriptor to write to.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+sort_merge_runs:
+    prologue_with_vars 6
+
+    alloc_space SORT_MERGE_SPACE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SortState *"
+    .fd         equ     8   ; int.
+    .i          equ    16   ; size_t: run index.
+    .ret        equ    24   ; int: return value.
+    .unused     equ    32   ; padding.
+    .writer     equ    40   ; SortWriter.
+    .sources    equ    (.writer + SortWriter_size) ; SortSource array.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+
+    mov     qword [rsp+.ret], -1
+
+    ;--------------------
+    ; Create a source for each run.
+
+    mov     qword [rsp+.i], 0
+
+.next_source:
+    mov     rcx, [rsp+.state]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rcx+SortState.nruns]
+    je      .merge
+
+    imul    rbx, rax, SortSource_size
+    lea     rbx, [rsp+.sources+rbx]
+
+    mov     rdx, [rcx+SortState.runs]
+    mov     rdx, [rdx+rax*8]
+    mov     [rbx+SortSource.fd], rdx
+
+    mov     qword [rbx+SortSource.done], 0
+    mov     qword [rbx+SortSource.size], SORT_RUN_BUF_SIZE
+
+    mov     rdi, SORT_RUN_BUF_SIZE
+    dcall   malloc
+    mov     [rbx+SortSource.buf], rax
+    mov     [rbx+SortSource.next], rax
+    mov     [rbx+SortSource.end], rax
+
+    inc     qword [rsp+.i]
+
+    cmp     rax, 0
+    je      .free_buffers
+
+    jmp     .next_source
+
+.merge:
+    lea     rdi, [rsp+.writer]
+    mov     rsi, [rsp+.fd]
+    dcall   sort_writer_init
+    cmp     rax, 0
+    jne     .free_buffers
+
+    lea     rdi, [rsp+.sources]
+    mov     rcx, [rsp+.state]
+    mov     rsi, [rcx+SortState.nruns]
+    lea     rdx, [rsp+.writer]
+    dcall   sort_merge
+    mov     [rsp+.ret], rax
+
+    lea     rdi, [rsp+.writer]
+    dcall   sort_writer_finish
+    cmp     rax, 0
+    je      .free_buffers
+
+    mov     qword [rsp+.ret], -1
+
+.free_buffers:
+    ; Free the buffers allocated (.i of them).
+    cmp     qword [rsp+.i], 0
+    je      .close_runs
+
+    dec     qword [rsp+.i]
+
+    mov     rax, [rsp+.i]
+    imul    rbx, rax, SortSource_size
+    lea     rbx, [rsp+.sources+rbx]
+
+    mov     rdi, [rbx+SortSource.buf]
+    dcall   free
+
+    jmp     .free_buffers
+
+.close_runs:
+    mov     rdi, [rsp+.state]
+    dcall   sort_close_runs
+
+    mov     rax, [rsp+.ret]
+
+    free_space SORT_MERGE_SPACE
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Initialise a SortWriter.
+;
+; C prototype equivalent:
+;
+;     int sort_writer_init(SortWriter *writer, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortWriter.
+; - Input: RSI (integer) - file descriptor to write to.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+sort_writer_init:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .writer     equ     0   ; "SortWriter *"
+
+    ;--------------------
+
+    mov     [rsp+.writer], rdi
+
+    mov     [rdi+SortWriter.fd], rsi
+    mov     qword [rdi+SortWriter.len], 0
+    mov     qword [rdi+SortWriter.error], 0
+    mov     qword [rdi+SortWriter.have_prev], 0
+    mov     qword [rdi+SortWriter.prev_buf], 0
+    mov     qword [rdi+SortWriter.prev_size], 0
+
+    mov     rdi, SORT_WRITE_BUF_SIZE
+    dcall   malloc
+
+    mov     rdi, [rsp+.writer]
+    mov     [rdi+SortWriter.buf], rax
+
+    cmp     rax, 0
+    je      .error
+
+    xor     rax, rax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Flush and free a SortWriter.
+;
+; C prototype equivalent:
+;
+;     int sort_writer_finish(SortWriter *writer);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortWriter.
+; - Output: RAX (integer) - 0 if all the data was written, or -1 on
+;   error.
+;---------------------------------------------------------------------
+
+sort_writer_finish:
+section .rodata
+    .write_fmt      db  "sort: write error",10,0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .writer     equ     0   ; "SortWriter *"
+
+    ;--------------------
+
+    mov     [rsp+.writer], rdi
+
+    dcall   sort_flush
+
+    mov     rax, [rsp+.writer]
+    mov     rdi, [rax+SortWriter.buf]
+    dcall   free
+
+    mov     rax, [rsp+.writer]
+    mov     rdi, [rax+SortWriter.prev_buf]
+    dcall   free
+
+    mov     rax, [rsp+.writer]
+    cmp     qword [rax+SortWriter.error], 0
+    jne     .error
+
+    xor     rax, rax
+    jmp     .out
+
+.error:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write a line (unless -u is specified and its key is
+;   the same as the previous line).
+;
+; C prototype equivalent:
+;
+;     void sort_emit(SortWriter *writer, const SortRec *rec);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortWriter.
+; - Input: RSI (address) - record of line to write.
+; - Output: None.
+;
+; Notes:
+;
+; For -u, the previous line is copied since the buffer containing it
+; may be reused.
+;---------------------------------------------------------------------
+
+sort_emit:
+section .rodata
+    .newline        db  10
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .writer     equ     0   ; "SortWriter *"
+    .rec        equ     8   ; "SortRec *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.writer], rdi
+    mov     [rsp+.rec], rsi
+
+    ;--------------------
+
+    test    qword [sort_config+SortConfig.flags], SORT_UNIQUE
+    jz      .write
+
+    cmp     qword [rdi+SortWriter.have_prev], 0
+    je      .save
+
+    lea     rdi, [rdi+SortWriter.prev]
+    dcall   sort_compare
+    cmp     rax, 0
+    je      .out ; Duplicate.
+
+.save:
+    ;--------------------
+    ; Remember the line.
+
+    mov     rdi, [rsp+.writer]
+    mov     rsi, [rsp+.rec]
+    mov     esi, [rsi+SortRec.length]
+    cmp     rsi, [rdi+SortWriter.prev_size]
+    jbe     .copy
+
+    mov     [rdi+SortWriter.prev_size], rsi
+    mov     rdi, [rdi+SortWriter.prev_buf]
+    dcall   realloc
+
+    mov     rdi, [rsp+.writer]
+    cmp     rax, 0
+    je      .error
+
+    mov     [rdi+SortWriter.prev_buf], rax
+
+.copy:
+    mov     rsi, [rsp+.rec]
+    movdqu  xmm0, [rsi]
+    movdqu  xmm1, [rsi+16]
+    movdqu  [rdi+SortWriter.prev], xmm0
+    movdqu  [rdi+SortWriter.prev+16], xmm1
+
+    mov     rax, [rdi+SortWriter.prev_buf]
+    mov     [rdi+SortWriter.prev+SortRec.line], rax
+    mov     qword [rdi+SortWriter.have_prev], 1
+
+    mov     edx, [rsi+SortRec.length]
+    mov     rsi, [rsi+SortRec.line]
+    mov     rdi, rax
+    dcall   memcpy
+
+.write:
+    mov     rdi, [rsp+.writer]
+    mov     rax, [rsp+.rec]
+    mov     rsi, [rax+SortRec.line]
+    mov     edx, [rax+SortRec.length]
+    dcall   sort_write
+
+    mov     rdi, [rsp+.writer]
+    mov     rsi, .newline
+    mov     rdx, 1
+    dcall   sort_write
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error:
+    ; Note: The old buffer is still valid.
+    mov     qword [rdi+SortWriter.prev_size], 0
+    mov     qword [rdi+SortWriter.error], 1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Add data to the output buffer.
+;
+; C prototype equivalent:
+;
+;     void sort_write(SortWriter *writer, const void *data, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortWriter.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: None.
+;
+; Notes:
+;
+; - The buffer is flushed when full. Data too big to fit in the buffer
+;   is written directly.
+;
+; - Write errors are recorded in SortWriter.error.
+;---------------------------------------------------------------------
+
+sort_write:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .writer     equ     0   ; "SortWriter *"
+    .data       equ     8   ; "void *"
+    .len        equ    16   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.writer], rdi
+    mov     [rsp+.data], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    mov     rax, [rdi+SortWriter.len]
+    add     rax, rdx
+    cmp     rax, SORT_WRITE_BUF_SIZE
+    jbe     .copy
+
+    dcall   sort_flush
+
+    cmp     qword [rsp+.len], SORT_WRITE_BUF_SIZE
+    jb      .copy
+
+    mov     rax, [rsp+.writer]
+    mov     rdi, [rax+SortWriter.fd]
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    dcall   write_block
+    cmp     rax, 0
+    jge     .out
+
+    mov     rdi, [rsp+.writer]
+    mov     qword [rdi+SortWriter.error], 1
+    jmp     .out
+
+.copy:
+    mov     rax, [rsp+.writer]
+    mov     rdi, [rax+SortWriter.buf]
+    add     rdi, [rax+SortWriter.len]
+    mov     rsi, [rsp+.data]
+    mov     rdx, [rsp+.len]
+    dcall   memcpy
+
+    mov     rax, [rsp+.writer]
+    mov     rdx, [rsp+.len]
+    add     [rax+SortWriter.len], rdx
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the contents of the output buffer.
+;
+; C prototype equivalent:
+;
+;     void sort_flush(SortWriter *writer);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SortWriter.
+; - Output: None.
+;---------------------------------------------------------------------
+
+sort_flush:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .writer     equ     0   ; "SortWriter *"
+
+    ;--------------------
+
+    mov     [rsp+.writer], rdi
+
+    mov     rdx, [rdi+SortWriter.len]
+    cmp     rdx, 0
+    je      .out
+
+    mov     rsi, [rdi+SortWriter.buf]
+    mov     rdi, [rdi+SortWriter.fd]
+    dcall   write_block
+
+    mov     rdi, [rsp+.writer]
+    mov     qword [rdi+SortWriter.len], 0
+
+    cmp     rax, 0
+    jge     .out
+
+    mov     qword [rdi+SortWriter.error], 1
+
+.out:
+    epilogue_with_vars 1
+    ret
@@ -0,0 +1,2011 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_split
+global command_split
+
+extern arena_alloc
+extern arena_free
+extern asm_getopt
+extern asm_memcount
+extern asm_strlen
+extern get_errno
+extern read_block
+extern write_block
+
+extern close
+extern copy_file_range
+extern dprintf
+extern fstat
+extern get_nprocs
+extern lseek
+extern madvise
+extern memcpy
+extern mmap
+extern munmap
+extern open
+extern pread
+extern pthread_create
+extern pthread_join
+
+extern optarg
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_split:  db  "see split(1)",10, \
+                         10, \
+                         "Usage: split [-d] [-a LEN] [-b SIZE | -l LINES | -n CHUNKS] [FILE [PREFIX]]",10, \
+                         10, \
+                         "Options:",10, \
+                         10, \
+                         "-a LEN    : Use suffixes of length LEN (default 2).",10, \
+                         "-b SIZE   : Put SIZE bytes in each output file.",10, \
+                         "-d        : Use numeric suffixes (rather than alphabetic).",10, \
+                         "-l LINES  : Put LINES lines in each output file (default 1000).",10, \
+                         "-n CHUNKS : Split into CHUNKS files of (about) the same size.",10, \
+                         10, \
+                         "SIZE may have a K, M, G or T suffix (powers of 1024).",10, \
+                         "The default PREFIX is 'x'.",0
+
+;---------------------------------------------------------------------
+; How the input is split.
+
+%assign SPLIT_BYTES             0 ; -b: fixed number of bytes.
+%assign SPLIT_LINES             1 ; -l: fixed number of lines.
+%assign SPLIT_CHUNKS            2 ; -n: fixed number of files.
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign SPLIT_NUMERIC           (1 << 0)
+%assign SPLIT_SUFFIX_LEN        (1 << 1)
+%assign SPLIT_MODE_SET          (1 << 2)
+%assign SPLIT_SUFFIX_GROW       (1 << 3) ; Lengthen suffixes as needed.
+
+%assign SPLIT_DEFAULT_LINES     1000
+%assign SPLIT_DEFAULT_SUFFIX    2
+
+; Maximum number of threads creating output files.
+%assign SPLIT_MAX_THREADS       8
+
+; Size of the buffer used to read input that is not a regular file.
+SPLIT_READ_BUF_SIZE     equ     (IO_READ_BUF_SIZE * 4)
+
+; Newlines are counted this many bytes at a time before looking for
+; the exact end of the last line of an output file.
+%assign SPLIT_COUNT_SPAN        4096
+
+; Initial number of entries in SplitState.bounds.
+%assign SPLIT_BOUNDS_INITIAL    1024
+
+; Largest value for a SIZE, LINES or CHUNKS argument.
+SPLIT_MAX_VALUE         equ     (1 << 62)
+
+;---------------------------------------------------------------------
+; State shared by the split functions (and threads).
+;---------------------------------------------------------------------
+struc SplitState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .mode       resq    1 ; SPLIT_BYTES, SPLIT_LINES or SPLIT_CHUNKS.
+    .flags      resq    1 ; SPLIT_* bitmask.
+    .size       resq    1 ; size_t: bytes, lines or number of files.
+    .prefix     resq    1 ; "char *": output file name prefix.
+    .prefix_len resq    1 ; size_t.
+    .suffix_len resq    1 ; size_t.
+    .max_files  resq    1 ; size_t: number of suffixes available.
+    .input      resq    1 ; "char *": name of input for messages.
+    .fd         resq    1 ; int: input file descriptor.
+
+    ; Regular files only.
+    .start      resq    1 ; off_t: input offset to start from.
+    .total      resq    1 ; size_t: bytes to split.
+    .chunk      resq    1 ; size_t: bytes in each -n file.
+    .bounds     resq    1 ; "off_t *": start of each -l file (plus
+                          ; the end of the last one).
+    .capacity   resq    1 ; size_t: entries allocated in .bounds.
+    .count      resq    1 ; size_t: number of output files.
+    .next       resq    1 ; size_t: next file for a thread to create.
+    .failed     resq    1 ; bool: true if any file failed.
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `split` command.
+;
+; C prototype equivalent:
+;
+;     int command_split(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, else -1.
+;
+; Notes:
+;
+; - For regular files, the range of the input for every output file
+;   is worked out first. The files are then created by a pool of
+;   threads, each of which copies the data inside the kernel with
+;   copy_file_range(2) (see split_pieces()).
+;
+; - For '-l', the ends of the lines are found by counting newlines in
+;   the mapped file (see split_find_lines()).
+;
+; - Other input (such as a pipe) is read into a buffer and written to
+;   each file in turn (see split_stream()).
+;
+; Limitations:
+;
+; - '-n' only supports the CHUNKS form (not "K/N", "l/N" or "r/N").
+; - '-C', '-e', '-t', '--additional-suffix' and '--filter' are not
+;   supported.
+;
+; See: split(1).
+;---------------------------------------------------------------------
+
+command_split:
+section .rodata
+    .optstring          db  "a:b:dl:n:",0
+    .suffix_len_opt     equ 'a'
+    .bytes_opt          equ 'b'
+    .numeric_opt        equ 'd'
+    .lines_opt          equ 'l'
+    .chunks_opt         equ 'n'
+
+    .default_prefix     db  "x",0
+    .stdin_name         db  "-",0
+cold_rodata
+    .nomem_msg          db  "split: cannot allocate memory",10,0
+    .one_way_msg        db  "split: cannot split in more than one way",10,0
+    .suffix_len_fmt     db  "split: invalid suffix length: '%s'",10,0
+    .bytes_fmt          db  "split: invalid number of bytes: '%s'",10,0
+    .lines_fmt          db  "split: invalid number of lines: '%s'",10,0
+    .chunks_fmt         db  "split: invalid number of chunks: '%s'",10,0
+    .operand_fmt        db  "split: extra operand '%s'",10,0
+    .prefix_fmt         db  "split: %s: file name too long",10,0
+    .open_fmt           db  "split: %s: cannot open file",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .state          equ     16  ; "SplitState *"
+    .operands       equ     24  ; "char **": FILE and PREFIX.
+    .count          equ     32  ; size_t: number of operands.
+    .ret            equ     40  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    mov     rdi, SplitState_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.state], rax
+
+    ;--------------------
+    ; Set defaults
+
+    mov     rbx, rax
+
+    mov     qword [rbx+SplitState.mode], SPLIT_LINES
+    mov     qword [rbx+SplitState.flags], 0
+    mov     qword [rbx+SplitState.size], SPLIT_DEFAULT_LINES
+    mov     qword [rbx+SplitState.prefix], .default_prefix
+    mov     qword [rbx+SplitState.suffix_len], SPLIT_DEFAULT_SUFFIX
+    mov     qword [rbx+SplitState.input], .stdin_name
+    mov     qword [rbx+SplitState.fd], STDIN_FD
+    mov     qword [rbx+SplitState.bounds], 0
+    mov     qword [rbx+SplitState.failed], 0
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .suffix_len_opt
+    je      .handle_suffix_len_opt
+
+    cmp     al, .bytes_opt
+    je      .handle_bytes_opt
+
+    cmp     al, .numeric_opt
+    je      .handle_numeric_opt
+
+    cmp     al, .lines_opt
+    je      .handle_lines_opt
+
+    cmp     al, .chunks_opt
+    je      .handle_chunks_opt
+
+    jmp     .error_bad_option
+
+.handle_suffix_len_opt:
+    mov     rdi, [optarg]
+    mov     rsi, 0 ; No suffix.
+    dcall   split_parse_value
+    cmp     rax, 0
+    jle     .error_suffix_len
+
+    mov     [rbx+SplitState.suffix_len], rax
+    or      qword [rbx+SplitState.flags], SPLIT_SUFFIX_LEN
+    jmp     .next_arg
+
+.handle_bytes_opt:
+    mov     rdi, [optarg]
+    mov     rsi, 1 ; Allow a suffix.
+    dcall   split_parse_value
+    cmp     rax, 0
+    jle     .error_bytes
+
+    mov     rcx, SPLIT_BYTES
+    jmp     .set_mode
+
+.handle_lines_opt:
+    mov     rdi, [optarg]
+    mov     rsi, 0 ; No suffix.
+    dcall   split_parse_value
+    cmp     rax, 0
+    jle     .error_lines
+
+    mov     rcx, SPLIT_LINES
+    jmp     .set_mode
+
+.handle_chunks_opt:
+    mov     rdi, [optarg]
+    mov     rsi, 0 ; No suffix.
+    dcall   split_parse_value
+    cmp     rax, 0
+    jle     .error_chunks
+
+    mov     rcx, SPLIT_CHUNKS
+
+.set_mode:
+    test    qword [rbx+SplitState.flags], SPLIT_MODE_SET
+    jnz     .error_one_way
+
+    or      qword [rbx+SplitState.flags], SPLIT_MODE_SET
+    mov     [rbx+SplitState.mode], rcx
+    mov     [rbx+SplitState.size], rax
+    jmp     .next_arg
+
+.handle_numeric_opt:
+    or      qword [rbx+SplitState.flags], SPLIT_NUMERIC
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    mov     [rsp+.count], rcx
+
+    mov     rdx, [rsp+.argv]
+    lea     rdx, [rdx+rax*PTR_SIZE]
+    mov     [rsp+.operands], rdx
+
+    cmp     rcx, 2
+    ja      .error_operand
+    jb      .check_input
+
+    mov     rax, [rdx+PTR_SIZE]
+    mov     [rbx+SplitState.prefix], rax
+
+.check_input:
+    cmp     rcx, 0
+    je      .check_names
+
+    mov     rax, [rdx]
+    mov     [rbx+SplitState.input], rax
+
+    ;--------------------
+    ; Work out how many output file names are available.
+
+.check_names:
+    mov     rdi, rbx
+    dcall   split_suffixes
+
+    mov     rdi, [rbx+SplitState.prefix]
+    dcall   asm_strlen
+    mov     [rbx+SplitState.prefix_len], rax
+
+    add     rax, [rbx+SplitState.suffix_len]
+    cmp     rax, PATH_MAX
+    jae     .error_prefix
+
+    ;--------------------
+    ; Open the input.
+
+    mov     rdi, [rbx+SplitState.input]
+    cmp     byte [rdi], '-'
+    jne     .open_input
+
+    cmp     byte [rdi+1], 0
+    je      .split
+
+.open_input:
+    mov     rsi, (O_RDONLY|O_CLOEXEC)
+    dcall   open
+    cmp     eax, 0
+    jl      .error_open
+
+    cdqe
+    mov     [rbx+SplitState.fd], rax
+
+.split:
+    mov     rdi, rbx
+    dcall   split_input
+    cmp     rax, 0
+    je      .close_input
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.close_input:
+    cmp     qword [rbx+SplitState.fd], STDIN_FD
+    je      .out
+
+    mov     rdi, [rbx+SplitState.fd]
+    dcall   close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 6
+    ret
+
+.error_nomem:
+    mov     rdi, STDERR_FD
+    mov     rsi, .nomem_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_one_way:
+    mov     rdi, STDERR_FD
+    mov     rsi, .one_way_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_suffix_len:
+    mov     rsi, .suffix_len_fmt
+    jmp     .error_value
+
+.error_bytes:
+    mov     rsi, .bytes_fmt
+    jmp     .error_value
+
+.error_lines:
+    mov     rsi, .lines_fmt
+    jmp     .error_value
+
+.error_chunks:
+    mov     rsi, .chunks_fmt
+
+.error_value:
+    mov     rdi, STDERR_FD
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_operand:
+    mov     rsi, .operand_fmt
+    mov     rdx, [rdx+2*PTR_SIZE]
+    jmp     .error_msg
+
+.error_prefix:
+    mov     rsi, .prefix_fmt
+    mov     rdx, [rbx+SplitState.prefix]
+    jmp     .error_msg
+
+.error_open:
+    mov     rsi, .open_fmt
+    mov     rdx, [rbx+SplitState.input]
+
+.error_msg:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse a SIZE, LINES, CHUNKS or LEN value.
+;
+; C prototype equivalent:
+;
+;     ssize_t split_parse_value(const char *str, bool allow_suffix);
+;
+; Parameters:
+;
+; - Input: RDI (string) - value.
+; - Input: RSI (integer) - 1 if a K, M, G or T suffix is allowed.
+; - Output: RAX (integer) - value, or -1 if invalid (or larger than
+;   SPLIT_MAX_VALUE).
+;---------------------------------------------------------------------
+
+split_parse_value:
+    prologue_with_vars 0
+
+    xor     eax, eax
+    mov     r8, rdi
+    mov     r9, SPLIT_MAX_VALUE
+
+.next_digit:
+    movzx   edx, byte [rdi]
+    sub     edx, '0'
+    cmp     edx, 9
+    ja      .digits_done
+
+    imul    rax, rax, 10
+    add     rax, rdx
+    cmp     rax, r9
+    ja      .error
+
+    inc     rdi
+    jmp     .next_digit
+
+.digits_done:
+    cmp     rdi, r8
+    je      .error ; No digits.
+
+    movzx   edx, byte [rdi]
+    cmp     dl, 0
+    je      .out
+
+    cmp     rsi, 0
+    je      .error
+
+    cmp     byte [rdi+1], 0
+    jne     .error
+
+    or      dl, 0x20 ; Lower case.
+
+    mov     ecx, 10
+    cmp     dl, 'k'
+    je      .scale
+
+    mov     ecx, 20
+    cmp     dl, 'm'
+    je      .scale
+
+    mov     ecx, 30
+    cmp     dl, 'g'
+    je      .scale
+
+    mov     ecx, 40
+    cmp     dl, 't'
+    jne     .error
+
+.scale:
+    ; Check the value won't exceed the limit.
+    mov     rdx, r9
+    shr     rdx, cl
+    cmp     rax, rdx
+    ja      .error
+
+    shl     rax, cl
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Set the number of output file names available
+;   (SplitState.max_files).
+;
+; C prototype equivalent:
+;
+;     void split_suffixes(SplitState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Output: None.
+;
+; Notes:
+;
+; As for split(1), if the suffix length was not specified:
+;
+; - When splitting into CHUNKS files, it is increased until there are
+;   enough names.
+; - Otherwise, the names never run out since longer suffixes are used
+;   as needed (see split_open()).
+;---------------------------------------------------------------------
+
+split_suffixes:
+    prologue_with_vars 0
+
+    mov     r8, 26
+    test    qword [rdi+SplitState.flags], SPLIT_NUMERIC
+    jz      .count
+
+    mov     r8, 10
+
+.count:
+    ; max_files = base ^ suffix_len (limited to SPLIT_MAX_VALUE).
+    mov     rax, 1
+    mov     rcx, [rdi+SplitState.suffix_len]
+    mov     r9, SPLIT_MAX_VALUE
+
+.next_char:
+    cmp     rcx, 0
+    je      .counted
+
+    imul    rax, r8
+    cmp     rax, r9
+    jbe     .char_done
+
+    mov     rax, r9
+
+.char_done:
+    dec     rcx
+    jmp     .next_char
+
+.counted:
+    mov     [rdi+SplitState.max_files], rax
+
+    test    qword [rdi+SplitState.flags], SPLIT_SUFFIX_LEN
+    jnz     .out
+
+    cmp     qword [rdi+SplitState.mode], SPLIT_CHUNKS
+    je      .check_chunks
+
+    or      qword [rdi+SplitState.flags], SPLIT_SUFFIX_GROW
+    mov     [rdi+SplitState.max_files], r9 ; SPLIT_MAX_VALUE
+    jmp     .out
+
+.check_chunks:
+    cmp     rax, [rdi+SplitState.size]
+    jae     .out
+
+    inc     qword [rdi+SplitState.suffix_len]
+    jmp     .count
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Split the input.
+;
+; C prototype equivalent:
+;
+;     int split_input(SplitState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Splitting a regular file starts from the current offset (as
+;   split(1) does), so "(read x; split ...) < file" works.
+;
+; - Regular files that claim to be empty (such as those in /proc) are
+;   treated like pipes.
+;---------------------------------------------------------------------
+
+split_input:
+cold_rodata
+    .size_fmt       db  "split: %s: cannot determine file size",10,0
+section .text
+    prologue_with_vars 0
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .stat       equ     0   ; Stat_size bytes.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rdi, [rbx+SplitState.fd]
+    lea     rsi, [rsp+.stat]
+    dcall   fstat
+    cmp     eax, 0
+    jne     .stream
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFREG
+    jne     .stream
+
+    cmp     qword [rbx+SplitState.mode], SPLIT_CHUNKS
+    je      .find_start
+
+    cmp     qword [rsp+.stat+Stat.st_size], 0
+    je      .stream
+
+.find_start:
+    mov     rdi, [rbx+SplitState.fd]
+    mov     rsi, 0
+    mov     rdx, SEEK_CUR
+    dcall   lseek
+    cmp     rax, 0
+    jge     .got_start
+
+    xor     eax, eax
+
+.got_start:
+    mov     [rbx+SplitState.start], rax
+
+    ; total = max(size - start, 0)
+    mov     rcx, [rsp+.stat+Stat.st_size]
+    sub     rcx, rax
+    jge     .got_total
+
+    xor     ecx, ecx
+
+.got_total:
+    mov     [rbx+SplitState.total], rcx
+
+    mov     rax, [rbx+SplitState.mode]
+    cmp     rax, SPLIT_LINES
+    je      .lines
+
+    cmp     rax, SPLIT_CHUNKS
+    je      .chunks
+
+    ;--------------------
+    ; count = ceil(total / size)
+
+    mov     rax, [rbx+SplitState.total]
+    add     rax, [rbx+SplitState.size]
+    dec     rax
+    xor     edx, edx
+    div     qword [rbx+SplitState.size]
+    mov     [rbx+SplitState.count], rax
+    jmp     .pieces
+
+.chunks:
+    ; Each file gets total / CHUNKS bytes (at least 1 byte while the
+    ; data lasts) and the last file also gets the remainder.
+    mov     rax, [rbx+SplitState.total]
+    xor     edx, edx
+    div     qword [rbx+SplitState.size]
+    cmp     rax, 0
+    jne     .got_chunk
+
+    mov     rax, 1
+
+.got_chunk:
+    mov     [rbx+SplitState.chunk], rax
+
+    mov     rax, [rbx+SplitState.size]
+    mov     [rbx+SplitState.count], rax
+    jmp     .pieces
+
+.lines:
+    mov     rdi, rbx
+    dcall   split_line_bounds
+    cmp     rax, 0
+    jne     .stream ; The file could not be mapped.
+
+.pieces:
+    mov     rdi, rbx
+    dcall   split_pieces
+    jmp     .out
+
+.stream:
+    cmp     qword [rbx+SplitState.mode], SPLIT_CHUNKS
+    je      .error_size
+
+    mov     rdi, rbx
+    dcall   split_stream
+
+.out:
+    free_space Stat_size
+    epilogue_with_vars 0
+    ret
+
+.error_size:
+    mov     rdi, STDERR_FD
+    mov     rsi, .size_fmt
+    mov     rdx, [rbx+SplitState.input]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Find the start of every output file when splitting a
+;   regular file by lines.
+;
+; C prototype equivalent:
+;
+;     int split_line_bounds(SplitState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Output: RAX (integer) - 0 on success, or -1 if the file could not
+;   be mapped (or memory could not be allocated).
+;
+; Notes:
+;
+; The file is mapped, so its data is only read (by
+; split_find_lines()), never copied. SplitState.bounds gets the
+; offset of the start of each file plus the end of the last one.
+;---------------------------------------------------------------------
+
+split_line_bounds:
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .map        equ     0   ; "char *": mapped file.
+    .map_size   equ     8   ; size_t.
+    .pos        equ    16   ; off_t: start of next file.
+    .end        equ    24   ; off_t: end of data.
+    .lines      equ    32   ; size_t: lines still needed.
+    .ret        equ    40   ; int: return value.
+    .bigger     equ    48   ; "off_t *": replacement bounds array.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     qword [rsp+.ret], -1
+    mov     qword [rbx+SplitState.count], 0
+
+    mov     rax, [rbx+SplitState.start]
+    mov     [rsp+.pos], rax
+    add     rax, [rbx+SplitState.total]
+    mov     [rsp+.end], rax
+    mov     [rsp+.map_size], rax
+
+    mov     qword [rsp+.map], 0
+    cmp     qword [rbx+SplitState.total], 0
+    je      .alloc_bounds
+
+    ; The offset of a mapping must be page aligned, so map from the
+    ; start of the file.
+    mov     rdi, 0 ; Let the kernel choose the address.
+    mov     rsi, [rsp+.map_size]
+    mov     rdx, PROT_READ
+    mov     rcx, MAP_PRIVATE
+    mov     r8, [rbx+SplitState.fd]
+    mov     r9, 0 ; offset.
+    dcall   mmap
+    cmp     rax, MAP_FAILED
+    je      .out
+
+    mov     [rsp+.map], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.map_size]
+    mov     rdx, MADV_SEQUENTIAL
+    dcall   madvise
+
+.alloc_bounds:
+    mov     qword [rbx+SplitState.capacity], SPLIT_BOUNDS_INITIAL
+
+    mov     rdi, (SPLIT_BOUNDS_INITIAL * PTR_SIZE)
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .unmap
+
+    mov     [rbx+SplitState.bounds], rax
+
+    mov     rcx, [rsp+.pos]
+    mov     [rax], rcx
+
+.next_file:
+    mov     rax, [rsp+.pos]
+    cmp     rax, [rsp+.end]
+    jae     .success
+
+    mov     rax, [rbx+SplitState.size]
+    mov     [rsp+.lines], rax
+
+    mov     rdi, [rsp+.map]
+    add     rdi, [rsp+.pos]
+    mov     rsi, [rsp+.end]
+    sub     rsi, [rsp+.pos]
+    lea     rdx, [rsp+.lines]
+    dcall   split_find_lines
+
+    add     [rsp+.pos], rax
+
+    ;--------------------
+    ; Record the end of this file (the start of the next).
+
+    inc     qword [rbx+SplitState.count]
+
+    mov     rax, [rbx+SplitState.count]
+    cmp     rax, [rbx+SplitState.capacity]
+    jb      .save_bound
+
+    mov     rdi, [rbx+SplitState.capacity]
+    shl     rdi, 4 ; Twice as many entries of PTR_SIZE bytes.
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .unmap
+
+    mov     [rsp+.bigger], rax
+
+    mov     rdi, rax
+    mov     rsi, [rbx+SplitState.bounds]
+    mov     rdx, [rbx+SplitState.count]
+    shl     rdx, 3 ; PTR_SIZE
+    dcall   memcpy
+
+    mov     rdi, [rbx+SplitState.bounds]
+    mov     rsi, [rbx+SplitState.capacity]
+    shl     rsi, 3 ; PTR_SIZE
+    dcall   arena_free
+
+    mov     rax, [rsp+.bigger]
+    mov     [rbx+SplitState.bounds], rax
+    shl     qword [rbx+SplitState.capacity], 1
+
+.save_bound:
+    mov     rax, [rbx+SplitState.count]
+    mov     rcx, [rbx+SplitState.bounds]
+    mov     rdx, [rsp+.pos]
+    mov     [rcx+rax*PTR_SIZE], rdx
+    jmp     .next_file
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.unmap:
+    cmp     qword [rsp+.map], 0
+    je      .out
+
+    mov     rdi, [rsp+.map]
+    mov     rsi, [rsp+.map_size]
+    dcall   munmap
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 7
+    ret
+
+;---------------------------------------------------------------------
+; Description: Find the end of a number of lines.
+;
+; C prototype equivalent:
+;
+;     size_t split_find_lines(const char *buf, size_t len,
+;                             size_t *lines);
+;
+; Parameters:
+;
+; - Input: RDI (address) - data.
+; - Input: RSI (integer) - number of bytes of data.
+; - Input+Output: RDX (address) - number of lines wanted (which must
+;   be non-zero). Reduced by the number of lines found.
+; - Output: RAX (integer) - number of bytes up to and including the
+;   newline ending the last line wanted, or all of them if there are
+;   not enough lines.
+;
+; Notes:
+;
+; - Whole spans of SPLIT_COUNT_SPAN bytes are skipped using
+;   asm_memcount() while they cannot contain the last line wanted.
+;
+; - The span that does is then checked 64 bytes at a time: a 64-bit
+;   mask of the newlines in the block is built and a bit cleared for
+;   each line ("x & (x - 1)", as blsr does) until the last one, whose
+;   position is found with tzcnt.
+;
+; - Never reads beyond the end of the data (since it may be the end of
+;   a mapping).
+;---------------------------------------------------------------------
+
+split_find_lines:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .buf        equ     0   ; "char *"
+    .len        equ     8   ; size_t.
+    .lines      equ    16   ; "size_t *"
+    .pos        equ    24   ; size_t: bytes counted so far.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.buf], rdi
+    mov     [rsp+.len], rsi
+    mov     [rsp+.lines], rdx
+
+    mov     qword [rsp+.pos], 0
+
+    ;--------------------
+
+.count_span:
+    mov     rax, [rsp+.len]
+    sub     rax, [rsp+.pos]
+    cmp     rax, SPLIT_COUNT_SPAN
+    jb      .find
+
+    mov     rdi, [rsp+.buf]
+    add     rdi, [rsp+.pos]
+    mov     rsi, 0x0a ; '\n'
+    mov     rdx, SPLIT_COUNT_SPAN
+    dcall   asm_memcount
+
+    ; Does the last line end in this span?
+    mov     rcx, [rsp+.lines]
+    cmp     rax, [rcx]
+    jae     .find
+
+    sub     [rcx], rax
+    add     qword [rsp+.pos], SPLIT_COUNT_SPAN
+    jmp     .count_span
+
+    ;--------------------
+    ; Register usage:
+    ;
+    ; - RDI: data.
+    ; - RSI: offset of the current block.
+    ; - RDX: number of bytes of data.
+    ; - R8: lines still wanted.
+    ; - R9: newlines not yet counted in the current block.
+
+.find:
+    mov     rdi, [rsp+.buf]
+    mov     rsi, [rsp+.pos]
+    mov     rdx, [rsp+.len]
+    mov     rcx, [rsp+.lines]
+    mov     r8, [rcx]
+
+    mov     eax, 0x0a0a0a0a
+    movd    xmm7, eax
+    pshufd  xmm7, xmm7, 0
+
+.next_block:
+    lea     rax, [rsi+64]
+    cmp     rax, rdx
+    ja      .tail
+
+    movdqu  xmm0, [rdi+rsi]
+    movdqu  xmm1, [rdi+rsi+16]
+    movdqu  xmm2, [rdi+rsi+32]
+    movdqu  xmm3, [rdi+rsi+48]
+
+    pcmpeqb xmm0, xmm7
+    pmovmskb r9d, xmm0
+
+    pcmpeqb xmm1, xmm7
+    pmovmskb ecx, xmm1
+    shl     ecx, 16
+    or      r9d, ecx
+
+    pcmpeqb xmm2, xmm7
+    pmovmskb ecx, xmm2
+    shl     rcx, 32
+    or      r9, rcx
+
+    pcmpeqb xmm3, xmm7
+    pmovmskb ecx, xmm3
+    shl     rcx, 48
+    or      r9, rcx
+
+.next_newline:
+    test    r9, r9
+    jz      .block_done
+
+    dec     r8
+    jz      .found_in_block
+
+    lea     rax, [r9-1]
+    and     r9, rax
+    jmp     .next_newline
+
+.found_in_block:
+    tzcnt   rax, r9
+    add     rsi, rax
+    jmp     .found
+
+.block_done:
+    add     rsi, 64
+    jmp     .next_block
+
+    ; Fewer than 64 bytes left.
+.tail:
+    cmp     rsi, rdx
+    jae     .out
+
+    cmp     byte [rdi+rsi], 0x0a ; '\n'
+    jne     .tail_next
+
+    dec     r8
+    jz      .found
+
+.tail_next:
+    inc     rsi
+    jmp     .tail
+
+.found:
+    inc     rsi ; Include the newline.
+
+.out:
+    mov     rcx, [rsp+.lines]
+    mov     [rcx], r8
+
+    mov     rax, rsi
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create the output files for a regular file using
+;   multiple threads.
+;
+; C prototype equivalent:
+;
+;     int split_pieces(SplitState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The files are claimed one at a time by a pool of threads (see
+;   split_worker()). Since each file is copied inside the kernel, the
+;   threads mostly wait for the storage, so several files in flight
+;   at once keeps it busy.
+;
+; - If there are not enough suffixes, as many files as possible are
+;   created before failing (as for split(1)).
+;---------------------------------------------------------------------
+
+split_pieces:
+cold_rodata
+    .exhausted_msg  db  "split: output file suffixes exhausted",10,0
+section .text
+    prologue_with_vars 3
+
+    alloc_space (SPLIT_MAX_THREADS * PTR_SIZE)
+
+    ;--------------------
+    ; Stack offsets.
+
+    .threads    equ     0   ; size_t: number of threads to create.
+    .started    equ     8   ; size_t: number of threads created.
+    .exhausted  equ    16   ; bool: not enough suffixes.
+    .tids       equ    24   ; pthread_t array.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     qword [rbx+SplitState.next], 0
+    mov     qword [rsp+.exhausted], 0
+
+    mov     rax, [rbx+SplitState.count]
+    cmp     rax, [rbx+SplitState.max_files]
+    jbe     .count_ok
+
+    mov     rax, [rbx+SplitState.max_files]
+    mov     [rbx+SplitState.count], rax
+    mov     qword [rsp+.exhausted], 1
+
+.count_ok:
+    ;--------------------
+    ; threads = min(count, get_nprocs(), SPLIT_MAX_THREADS) - 1 (since
+    ; this thread creates files too).
+
+    dcall   get_nprocs
+    cdqe
+
+    cmp     rax, SPLIT_MAX_THREADS
+    jbe     .cpus_ok
+
+    mov     rax, SPLIT_MAX_THREADS
+
+.cpus_ok:
+    cmp     rax, [rbx+SplitState.count]
+    jbe     .threads_dec
+
+    mov     rax, [rbx+SplitState.count]
+
+.threads_dec:
+    cmp     rax, 0
+    je      .threads_ok
+
+    dec     rax
+
+.threads_ok:
+    mov     [rsp+.threads], rax
+    mov     qword [rsp+.started], 0
+
+.start_thread:
+    mov     rax, [rsp+.started]
+    cmp     rax, [rsp+.threads]
+    jae     .threads_started
+
+    lea     rdi, [rsp+.tids+rax*PTR_SIZE]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, split_worker
+    mov     rcx, rbx
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .threads_started ; Make do with the threads we have.
+
+    inc     qword [rsp+.started]
+    jmp     .start_thread
+
+.threads_started:
+    mov     rdi, rbx
+    dcall   split_worker
+
+.join_thread:
+    cmp     qword [rsp+.started], 0
+    je      .joined
+
+    dec     qword [rsp+.started]
+
+    mov     rax, [rsp+.started]
+    mov     rdi, [rsp+.tids+rax*PTR_SIZE]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+    jmp     .join_thread
+
+.joined:
+    cmp     qword [rbx+SplitState.failed], 0
+    jne     .error
+
+    cmp     qword [rsp+.exhausted], 0
+    jne     .error_exhausted
+
+    xor     rax, rax
+
+.out:
+    free_space (SPLIT_MAX_THREADS * PTR_SIZE)
+    epilogue_with_vars 3
+    ret
+
+.error_exhausted:
+    mov     rdi, STDERR_FD
+    mov     rsi, .exhausted_msg
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Thread function to create output files until none
+;   remain.
+;
+; C prototype equivalent:
+;
+;     void *split_worker(SplitState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Output: RAX (address) - always NULL.
+;
+; Notes:
+;
+; - The range of the input for each file is calculated from its
+;   index, except for '-l' which uses SplitState.bounds.
+;
+; - After a failure, the remaining files are not created.
+;---------------------------------------------------------------------
+
+split_worker:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+.next_file:
+    cmp     qword [rbx+SplitState.failed], 0
+    jne     .done
+
+    mov     rax, 1
+    lock xadd [rbx+SplitState.next], rax
+
+    cmp     rax, [rbx+SplitState.count]
+    jae     .done
+
+    mov     rcx, [rbx+SplitState.mode]
+    cmp     rcx, SPLIT_LINES
+    je      .lines
+
+    cmp     rcx, SPLIT_CHUNKS
+    je      .chunks
+
+    ;--------------------
+    ; offset = index * size, length = min(size, total - offset)
+
+    mov     rdx, rax
+    imul    rdx, [rbx+SplitState.size]
+
+    mov     rcx, [rbx+SplitState.total]
+    sub     rcx, rdx
+    cmp     rcx, [rbx+SplitState.size]
+    jbe     .got_range
+
+    mov     rcx, [rbx+SplitState.size]
+    jmp     .got_range
+
+.chunks:
+    ; start = min(index * chunk, total), end = min(start + chunk,
+    ; total) (or total for the last file).
+    mov     r8, [rbx+SplitState.total]
+
+    mov     rdx, rax
+    imul    rdx, [rbx+SplitState.chunk]
+    cmp     rdx, r8
+    jbe     .chunk_start
+
+    mov     rdx, r8
+
+.chunk_start:
+    lea     rcx, [rax+1]
+    cmp     rcx, [rbx+SplitState.count]
+    je      .last_chunk
+
+    mov     rcx, rdx
+    add     rcx, [rbx+SplitState.chunk]
+    cmp     rcx, r8
+    jbe     .chunk_end
+
+.last_chunk:
+    mov     rcx, r8
+
+.chunk_end:
+    sub     rcx, rdx
+    jmp     .got_range
+
+.lines:
+    mov     r8, [rbx+SplitState.bounds]
+    mov     rdx, [r8+rax*PTR_SIZE]
+    mov     rcx, [r8+rax*PTR_SIZE+PTR_SIZE]
+    sub     rcx, rdx
+    sub     rdx, [rbx+SplitState.start] ; Made absolute below.
+
+.got_range:
+    add     rdx, [rbx+SplitState.start]
+
+    mov     rdi, rbx
+    mov     rsi, rax
+    dcall   split_piece
+    cmp     rax, 0
+    je      .next_file
+
+    mov     qword [rbx+SplitState.failed], 1
+
+.done:
+    xor     rax, rax
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create an output file from a range of a regular file.
+;
+; C prototype equivalent:
+;
+;     int split_piece(SplitState *state, size_t index, off_t offset,
+;                     size_t length);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Input: RSI (integer) - index of the output file.
+; - Input: RDX (integer) - offset of the data in the input.
+; - Input: RCX (integer) - number of bytes.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+split_piece:
+cold_rodata
+    .write_fmt      db  "split: %s: write error",10,0
+section .text
+    prologue_with_vars 4
+
+    alloc_space PATH_MAX
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SplitState *"
+    .offset     equ     8   ; off_t.
+    .length     equ    16   ; size_t.
+    .fd         equ    24   ; int: output file.
+    .name       equ    32   ; char[PATH_MAX].
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.offset], rdx
+    mov     [rsp+.length], rcx
+
+    ;--------------------
+
+    lea     rdx, [rsp+.name]
+    dcall   split_open
+    cmp     rax, 0
+    jl      .out
+
+    mov     [rsp+.fd], rax
+
+    mov     rax, [rsp+.state]
+    mov     rdi, [rax+SplitState.fd]
+    mov     rsi, [rsp+.offset]
+    mov     rdx, [rsp+.fd]
+    mov     rcx, [rsp+.length]
+    dcall   split_copy
+    mov     [rsp+.offset], rax ; No longer needed, so reuse to save result.
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+    cmp     qword [rsp+.offset], 0
+    jne     .error_write
+
+    cmp     eax, 0
+    jne     .error_write
+
+.out:
+    free_space PATH_MAX
+    epilogue_with_vars 4
+    ret
+
+.error_write:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    lea     rdx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Create (or truncate) an output file.
+;
+; C prototype equivalent:
+;
+;     int split_open(SplitState *state, size_t index, char *name);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Input: RSI (integer) - index of the output file.
+; - Input: RDX (address) - buffer of PATH_MAX bytes for the file name.
+; - Output: RAX (integer) - file descriptor, or -1 on error.
+;
+; Notes:
+;
+; - The name is the prefix followed by the index written in base 26
+;   (using 'a' to 'z') or base 10 (using '0' to '9') with leading
+;   zeros to make it SplitState.suffix_len characters long.
+;
+; - With SPLIT_SUFFIX_GROW, once the suffixes of one length would
+;   start with the last character ('z' or '9'), that character is
+;   added to the name and the suffix gets one character longer (so
+;   "xyz" is followed by "xzaaa", as for split(1)).
+;
+; - An error message is shown on failure.
+;---------------------------------------------------------------------
+
+split_open:
+cold_rodata
+    .create_fmt     db  "split: %s: cannot create file",10,0
+    .exhausted_msg  db  "split: output file suffixes exhausted",10,0
+section .text
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "SplitState *"
+    .index      equ     8   ; size_t.
+    .name       equ    16   ; "char *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.index], rsi
+    mov     [rsp+.name], rdx
+
+    ;--------------------
+
+    cmp     rsi, [rdi+SplitState.max_files]
+    jae     .error_exhausted
+
+    mov     rax, rdi
+    mov     rdi, rdx
+    mov     rsi, [rax+SplitState.prefix]
+    mov     rdx, [rax+SplitState.prefix_len]
+    dcall   memcpy
+
+    ;--------------------
+    ; Add the suffix (from the end).
+
+    mov     rdi, [rsp+.state]
+    mov     r8, [rsp+.name]
+    add     r8, [rdi+SplitState.prefix_len]
+    mov     rcx, [rdi+SplitState.suffix_len]
+
+    mov     r9, 26
+    mov     r10d, 'a'
+    test    qword [rdi+SplitState.flags], SPLIT_NUMERIC
+    jz      .suffix
+
+    mov     r9, 10
+    mov     r10d, '0'
+
+.suffix:
+    mov     rax, [rsp+.index]
+
+    test    qword [rdi+SplitState.flags], SPLIT_SUFFIX_GROW
+    jz      .terminate
+
+.check_width:
+    ; Suffixes of this length starting with the last character are
+    ; not used, so there are (base - 1) * base^(length - 1) of them.
+    lea     r11, [r9-1]
+    lea     rdx, [rcx-1]
+
+.width_next:
+    cmp     rdx, 0
+    je      .width_done
+
+    imul    r11, r9
+    dec     rdx
+
+    mov     rdi, SPLIT_MAX_VALUE
+    cmp     r11, rdi
+    jbe     .width_next
+
+    mov     r11, rdi
+
+.width_done:
+    cmp     rax, r11
+    jb      .terminate
+
+    ; Move on to the suffixes one character longer, which follow the
+    ; last character.
+    sub     rax, r11
+
+    lea     rdx, [r10+r9-1]
+    mov     [r8], dl
+    inc     r8
+    inc     rcx
+
+    mov     rdx, r8
+    sub     rdx, [rsp+.name]
+    add     rdx, rcx
+    cmp     rdx, PATH_MAX
+    jae     .error_exhausted
+
+    jmp     .check_width
+
+.terminate:
+    mov     byte [r8+rcx], 0
+
+.next_char:
+    cmp     rcx, 0
+    je      .named
+
+    dec     rcx
+    xor     edx, edx
+    div     r9
+    add     edx, r10d
+    mov     [r8+rcx], dl
+    jmp     .next_char
+
+.named:
+    mov     rdi, [rsp+.name]
+    mov     rsi, (O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC)
+    mov     rdx, 666o
+    dcall   open
+    cmp     eax, 0
+    jl      .error_create
+
+    cdqe
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+.error_exhausted:
+    mov     rdi, STDERR_FD
+    mov     rsi, .exhausted_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+.error_create:
+    mov     rdi, STDERR_FD
+    mov     rsi, .create_fmt
+    mov     rdx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy a range of the input to an output file inside the
+;   kernel.
+;
+; C prototype equivalent:
+;
+;     int split_copy(int fd_in, off_t offset, int fd_out, size_t length);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - input file descriptor.
+; - Input: RSI (integer) - offset of the data in the input.
+; - Input: RDX (integer) - output file descriptor (written from its
+;   current offset).
+; - Input: RCX (integer) - number of bytes to copy.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - The input offset is passed explicitly, so the input file offset is
+;   unchanged and the threads can safely share the file descriptor.
+;
+; - If copy_file_range(2) cannot be used for these files, the
+;   remaining data is copied with split_copy_rw().
+;---------------------------------------------------------------------
+
+split_copy:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .off_in     equ     8   ; off_t: updated by copy_file_range(2).
+    .fd_out     equ    16   ; int.
+    .remaining  equ    24   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.off_in], rsi
+    mov     [rsp+.fd_out], rdx
+    mov     [rsp+.remaining], rcx
+
+    ;--------------------
+
+.copy_again:
+    cmp     qword [rsp+.remaining], 0
+    je      .success
+
+    mov     rdi, [rsp+.fd_in]
+    lea     rsi, [rsp+.off_in]
+    mov     rdx, [rsp+.fd_out]
+    mov     rcx, 0 ; Use (and update) the output file offset.
+    mov     r8, [rsp+.remaining]
+    mov     r9, 0 ; flags.
+    dcall   copy_file_range
+
+    cmp     rax, 0
+    je      .success ; EOF (the input has shrunk).
+    jl      .check_error
+
+    ; The input offset has been updated by the kernel.
+    sub     [rsp+.remaining], rax
+    jmp     .copy_again
+
+.check_error:
+    dcall   get_errno
+
+    cmp     rax, EINTR
+    je      .copy_again
+
+    cmp     rax, EXDEV
+    je      .fallback
+
+    cmp     rax, EINVAL
+    je      .fallback
+
+    cmp     rax, ENOSYS
+    je      .fallback
+
+    cmp     rax, EOPNOTSUPP
+    je      .fallback
+
+    cmp     rax, EBADF
+    je      .fallback
+
+    jmp     .error
+
+.fallback:
+    mov     rdi, [rsp+.fd_in]
+    mov     rsi, [rsp+.off_in]
+    mov     rdx, [rsp+.fd_out]
+    mov     rcx, [rsp+.remaining]
+    dcall   split_copy_rw
+    jmp     .out
+
+.success:
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy a range of the input to an output file via a
+;   buffer.
+;
+; C prototype equivalent:
+;
+;     int split_copy_rw(int fd_in, off_t offset, int fd_out,
+;                       size_t length);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - input file descriptor.
+; - Input: RSI (integer) - offset of the data in the input.
+; - Input: RDX (integer) - output file descriptor.
+; - Input: RCX (integer) - number of bytes to copy.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; pread(2) does not use (or change) the input file offset, so this is
+; safe to call from multiple threads.
+;---------------------------------------------------------------------
+
+split_copy_rw:
+    prologue_with_vars 5
+
+    sub     rsp, IO_READ_BUF_SIZE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .offset     equ     8   ; off_t.
+    .fd_out     equ    16   ; int.
+    .remaining  equ    24   ; size_t.
+    .bytes      equ    32   ; ssize_t: bytes in buffer.
+    .buffer     equ    40   ; IO_READ_BUF_SIZE bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.offset], rsi
+    mov     [rsp+.fd_out], rdx
+    mov     [rsp+.remaining], rcx
+
+    ;--------------------
+
+.read_again:
+    cmp     qword [rsp+.remaining], 0
+    je      .success
+
+    mov     rdx, [rsp+.remaining]
+    cmp     rdx, IO_READ_BUF_SIZE
+    jle     .read_size_ok
+
+    mov     rdx, IO_READ_BUF_SIZE
+
+.read_size_ok:
+    mov     rdi, [rsp+.fd_in]
+    lea     rsi, [rsp+.buffer]
+    mov     rcx, [rsp+.offset]
+    dcall   pread
+
+    cmp     rax, 0
+    je      .success ; EOF.
+    jg      .got_data
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .read_again
+    jmp     .error
+
+.got_data:
+    mov     [rsp+.bytes], rax
+
+    mov     rdi, [rsp+.fd_out]
+    lea     rsi, [rsp+.buffer]
+    mov     rdx, rax
+    dcall   write_block
+    cmp     rax, 0
+    jl      .error
+
+    mov     rax, [rsp+.bytes]
+    add     [rsp+.offset], rax
+    sub     [rsp+.remaining], rax
+    jmp     .read_again
+
+.success:
+    mov     rax, 0
+
+.out:
+    add     rsp, IO_READ_BUF_SIZE
+    epilogue_with_vars 5
+    ret
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Split input that is not a regular file by reading it
+;   into a buffer.
+;
+; C prototype equivalent:
+;
+;     int split_stream(SplitState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SplitState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Each block read is written straight from the buffer, split at the
+;   file boundaries (which for '-l' are found by split_find_lines()).
+;
+; - An output file is only created once there is data for it.
+;---------------------------------------------------------------------
+
+split_stream:
+cold_rodata
+    .read_fmt       db  "split: %s: read error",10,0
+    .write_fmt      db  "split: %s: write error",10,0
+    .nomem_msg      db  "split: cannot allocate memory",10,0
+section .text
+    prologue_with_vars 9
+
+    alloc_space PATH_MAX
+
+    ;--------------------
+    ; Stack offsets.
+
+    .buffer     equ     0   ; "char *"
+    .bytes      equ     8   ; size_t: bytes in buffer.
+    .pos        equ    16   ; size_t: bytes of buffer written.
+    .take       equ    24   ; size_t: bytes to write to current file.
+    .fd         equ    32   ; int: current output file (or -1).
+    .index      equ    40   ; size_t: index of next output file.
+    .left       equ    48   ; size_t: bytes or lines still wanted in
+                            ; current output file.
+    .ret        equ    56   ; int: return value.
+    .unused     equ    64   ; padding.
+    .name       equ    72   ; char[PATH_MAX]: current output file.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     qword [rsp+.fd], -1
+    mov     qword [rsp+.index], 0
+    mov     qword [rsp+.ret], -1
+
+    mov     rdi, SPLIT_READ_BUF_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.buffer], rax
+
+.read_again:
+    mov     rdi, [rbx+SplitState.fd]
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, SPLIT_READ_BUF_SIZE
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .success ; EOF.
+    jl      .error_read
+
+    mov     [rsp+.bytes], rax
+    mov     qword [rsp+.pos], 0
+
+.next_part:
+    mov     rax, [rsp+.pos]
+    cmp     rax, [rsp+.bytes]
+    jae     .read_again
+
+    cmp     qword [rsp+.fd], -1
+    jne     .got_file
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.index]
+    lea     rdx, [rsp+.name]
+    dcall   split_open
+    cmp     rax, 0
+    jl      .close_file
+
+    mov     [rsp+.fd], rax
+    inc     qword [rsp+.index]
+
+    mov     rax, [rbx+SplitState.size]
+    mov     [rsp+.left], rax
+
+.got_file:
+    mov     rdx, [rsp+.bytes]
+    sub     rdx, [rsp+.pos]
+
+    cmp     qword [rbx+SplitState.mode], SPLIT_LINES
+    je      .lines
+
+    ; take = min(left, bytes - pos)
+    cmp     rdx, [rsp+.left]
+    jbe     .got_bytes
+
+    mov     rdx, [rsp+.left]
+
+.got_bytes:
+    mov     [rsp+.take], rdx
+    sub     [rsp+.left], rdx
+    jmp     .write
+
+.lines:
+    mov     rdi, [rsp+.buffer]
+    add     rdi, [rsp+.pos]
+    mov     rsi, rdx
+    lea     rdx, [rsp+.left]
+    dcall   split_find_lines
+    mov     [rsp+.take], rax
+
+.write:
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rsp+.buffer]
+    add     rsi, [rsp+.pos]
+    mov     rdx, [rsp+.take]
+    dcall   write_block
+    cmp     rax, 0
+    jl      .error_write
+
+    mov     rax, [rsp+.take]
+    add     [rsp+.pos], rax
+
+    cmp     qword [rsp+.left], 0
+    jne     .next_part
+
+    ; The file is complete.
+    mov     rdi, [rsp+.fd]
+    mov     qword [rsp+.fd], -1
+    dcall   close
+    cmp     eax, 0
+    jne     .error_write
+
+    jmp     .next_part
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.close_file:
+    cmp     qword [rsp+.fd], -1
+    je      .out
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+    cmp     eax, 0
+    jne     .error_close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space PATH_MAX
+    epilogue_with_vars 9
+    ret
+
+.error_close:
+    mov     qword [rsp+.fd], -1
+    mov     qword [rsp+.ret], -1
+    mov     rsi, .write_fmt
+    lea     rdx, [rsp+.name]
+    jmp     .error_msg
+
+.error_nomem:
+    mov     rdi, STDERR_FD
+    mov     rsi, .nomem_msg
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .out
+
+.error_read:
+    mov     rsi, .read_fmt
+    mov     rdx, [rbx+SplitState.input]
+    jmp     .error_buffer
+
+.error_write:
+    mov     rsi, .write_fmt
+    lea     rdx, [rsp+.name]
+
+.error_buffer:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .close_file
+
+.error_msg:
+    mov     rdi, STDERR_FD
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
@@ -9,28 +9,388 @@
 global command_help_sync
 global command_sync
 
+extern asm_getopt
+
+extern close
+extern dprintf
+extern fdatasync
+extern fsync
+extern open
+extern pthread_create
+extern pthread_join
 extern sync
+extern syncfs
 
-section .rodata
-command_help_sync:  db  "see sync(1)",0
+extern optind
 
 %include "header.inc"
 
+cold_rodata
+command_help_sync:  db  "see sync(1)",10, \
+                        10, \
+                        "Options:",10, \
+                        10, \
+                        "-d : Only sync the file data (fdatasync(2)).",10, \
+                        "-f : Sync the filesystems containing the files (syncfs(2)).",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign SYNC_DATA               (1 << 0)
+%assign SYNC_FS                 (1 << 1)
+
+; Maximum number of files synced concurrently (the calling thread
+; plus (SYNC_MAX_THREADS-1) worker threads).
+%assign SYNC_MAX_THREADS        32
+
+;---------------------------------------------------------------------
+; State shared by the sync threads.
+;---------------------------------------------------------------------
+struc SyncState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .files      resq    1 ; "char **": files to sync.
+    .count      resq    1 ; size_t: number of files.
+    .next       resq    1 ; size_t: index of next file to sync (atomic).
+    .flags      resq    1 ; SYNC_* bitmask.
+    .failed     resq    1 ; bool: set if any file could not be synced.
+endstruc
+
 section .text
 
 ;---------------------------------------------------------------------
+; Description: Flush files (or all filesystems) to disk.
+;
+; Notes:
 ;
+; - With no files, all filesystems are synced (sync(2)).
+; - Files are synced concurrently so that the total time is close to
+;   that of the slowest file rather than the sum of all of them.
 ;---------------------------------------------------------------------
 
 command_sync:
+section .rodata
+    .optstring          db  "df",0
+    .data_opt           equ 'd'
+    .fs_opt             equ 'f'
+section .text
+    prologue_with_vars 6
+
+    alloc_space (SyncState_size + (SYNC_MAX_THREADS * PTR_SIZE))
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .flags          equ     16  ; size_t: SYNC_* bitmask.
+    .threads        equ     24  ; size_t: number of threads to create.
+    .started        equ     32  ; size_t: number of threads created.
+    .ret            equ     40  ; int: return value.
+    .state          equ     48  ; SyncState.
+    .tids           equ     (.state + SyncState_size) ; pthread_t array.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.flags], 0
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .data_opt
+    je      .handle_data_opt
+
+    cmp     al, .fs_opt
+    je      .handle_fs_opt
+
+    jmp     .error_bad_option
+
+.handle_data_opt:
+    or      qword [rsp+.flags], SYNC_DATA
+    jmp     .next_arg
+
+.handle_fs_opt:
+    or      qword [rsp+.flags], SYNC_FS
+    jmp     .next_arg
+
+.options_parsed:
+    ; The options are mutually exclusive.
+    cmp     qword [rsp+.flags], (SYNC_DATA|SYNC_FS)
+    je      .error_bad_option
+
+    mov     eax, [optind]
+    cdqe
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    jnz     .sync_files
+
+    ; Syncing just the data requires files.
+    test    qword [rsp+.flags], SYNC_DATA
+    jnz     .error_no_arg
+
+    dcall   sync
+    jmp     .out
+
+.sync_files:
+    mov     rdx, [rsp+.argv]
+    lea     rdx, [rdx+rax*PTR_SIZE]
+
+    mov     [rsp+.state+SyncState.files], rdx
+    mov     [rsp+.state+SyncState.count], rcx
+    mov     qword [rsp+.state+SyncState.next], 0
+    mov     rax, [rsp+.flags]
+    mov     [rsp+.state+SyncState.flags], rax
+    mov     qword [rsp+.state+SyncState.failed], 0
+
+    ;--------------------
+    ; threads = min(files, SYNC_MAX_THREADS) - 1 (since this thread
+    ; syncs files too).
+
+    cmp     rcx, SYNC_MAX_THREADS
+    jbe     .threads_ok
+
+    mov     rcx, SYNC_MAX_THREADS
+
+.threads_ok:
+    dec     rcx
+    mov     [rsp+.threads], rcx
+    mov     qword [rsp+.started], 0
+
+.start_thread:
+    mov     rax, [rsp+.started]
+    cmp     rax, [rsp+.threads]
+    jae     .threads_started
+
+    lea     rdi, [rsp+.tids+rax*PTR_SIZE]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, sync_worker
+    lea     rcx, [rsp+.state]
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .threads_started ; Make do with the threads we have.
+
+    inc     qword [rsp+.started]
+    jmp     .start_thread
+
+.threads_started:
+    lea     rdi, [rsp+.state]
+    dcall   sync_worker
+
+.join_thread:
+    cmp     qword [rsp+.started], 0
+    je      .joined
+
+    dec     qword [rsp+.started]
+
+    mov     rax, [rsp+.started]
+    mov     rdi, [rsp+.tids+rax*PTR_SIZE]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+    jmp     .join_thread
+
+.joined:
+    cmp     qword [rsp+.state+SyncState.failed], 0
+    je      .out
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space (SyncState_size + (SYNC_MAX_THREADS * PTR_SIZE))
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_no_arg:
+    mov     qword [rsp+.ret], CMD_NO_ARG
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Thread function that syncs files until none remain.
+;
+; C prototype equivalent:
+;
+;     void *sync_worker(SyncState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - SyncState.
+; - Output: RAX (address) - always NULL.
+;---------------------------------------------------------------------
+
+sync_worker:
     prologue_with_vars 0
 
-    dcall  sync
+    mov     rbx, rdi
+
+.next_file:
+    ; Claim the next file.
+    mov     eax, 1
+    lock xadd [rbx+SyncState.next], rax
+
+    cmp     rax, [rbx+SyncState.count]
+    jae     .out
+
+    mov     rcx, [rbx+SyncState.files]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+    mov     rsi, [rbx+SyncState.flags]
+    dcall   sync_file
+    cmp     rax, 0
+    je      .next_file
+
+    mov     qword [rbx+SyncState.failed], 1
+    jmp     .next_file
 
 .out:
+    xor     rax, rax
+
     epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Sync a single file.
+;
+; C prototype equivalent:
+;
+;     int sync_file(const char *path, size_t flags);
+;
+; Parameters:
+;
+; - Input: RDI (address) - path of file to sync.
+; - Input: RSI (integer) - SYNC_* bitmask.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Errors are reported on stderr.
+; - Like sync(1), if the file cannot be opened for reading (for
+;   example a write-only file), it is opened for writing instead.
+;---------------------------------------------------------------------
+
+sync_file:
+section .rodata
+    .open_fmt       db  "sync: error opening '%s'",10,0
+    .sync_fmt       db  "sync: error syncing '%s'",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .path       equ     0   ; "char *"
+    .flags      equ     8   ; size_t: SYNC_* bitmask.
+    .fd         equ    16   ; int.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.path], rdi
+    mov     [rsp+.flags], rsi
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+
+    ; Non-blocking so that opening a FIFO does not hang.
+    mov     rsi, (O_RDONLY|O_NONBLOCK|O_CLOEXEC)
+    dcall   open
+    cmp     eax, 0
+    jge     .opened
+
+    mov     rdi, [rsp+.path]
+    mov     rsi, (O_WRONLY|O_NONBLOCK|O_CLOEXEC)
+    dcall   open
+    cmp     eax, 0
+    jl      .error_open
+
+.opened:
+    cdqe
+    mov     [rsp+.fd], rax
 
-    ; sync(2) cannot fail
-    mov    rax, CMD_OK
+    mov     rdi, rax
 
+    test    qword [rsp+.flags], SYNC_DATA
+    jnz     .sync_data
+
+    test    qword [rsp+.flags], SYNC_FS
+    jnz     .sync_fs
+
+    dcall   fsync
+    jmp     .synced
+
+.sync_data:
+    dcall   fdatasync
+    jmp     .synced
+
+.sync_fs:
+    dcall   syncfs
+
+.synced:
+    cmp     eax, 0
+    je      .close
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .sync_fmt
+    mov     rdx, [rsp+.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+
+.close:
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
     ret
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .out
@@ -0,0 +1,845 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_tee
+global command_tee
+
+extern arena_alloc
+extern arena_alloc_aligned
+extern asm_getopt
+extern get_errno
+extern read_block
+extern write_block
+
+extern close
+extern dprintf
+extern fcntl
+extern fstat
+extern open
+extern pipe2
+extern splice
+extern tee
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_tee:   db  "see tee(1)",10, \
+                        10, \
+                        "Options:",10, \
+                        10, \
+                        "-a : Append to the files rather than overwriting them.",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign TEE_APPEND              (1 << 0)
+
+;---------------------------------------------------------------------
+; An output (standard output or a file).
+;---------------------------------------------------------------------
+struc TeeOutput
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .fd         resq    1 ; int: file descriptor, or -1 after an error.
+    .target     resq    1 ; int: pipe that tee(2) copies the input to.
+    .pipe_rd    resq    1 ; int: read end of private pipe, or -1.
+    .pipe_wr    resq    1 ; int: write end of private pipe, or -1.
+    .name       resq    1 ; "char *": name used in error messages.
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Copy stdin to stdout and to each of the specified
+;   files.
+;
+; Notes:
+;
+; - If possible the data is moved between file descriptors by the
+;   kernel (see tee_zero_copy()) so it is never copied into (and back
+;   out of) user space. Otherwise each block read from stdin is
+;   written to every output.
+;
+; - As for tee(1), a file that cannot be opened or written to is
+;   reported but does not stop the other outputs being written to.
+;---------------------------------------------------------------------
+
+command_tee:
+section .rodata
+    .optstring          db  "a",0
+    .append_opt         equ 'a'
+cold_rodata
+    .stdout_name        db  "standard output",0
+    .open_fmt           db  "tee: cannot open '%s'",10,0
+section .text
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .flags          equ     16  ; size_t: TEE_* bitmask.
+    .outputs        equ     24  ; "TeeOutput *": array of outputs.
+    .count          equ     32  ; size_t: number of outputs.
+    .i              equ     40  ; size_t: argument/output index.
+    .ret            equ     48  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.flags], 0
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .append_opt
+    je      .handle_append_opt
+
+    jmp     .error_bad_option
+
+.handle_append_opt:
+    or      qword [rsp+.flags], TEE_APPEND
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+    mov     [rsp+.i], rax
+
+    ;--------------------
+    ; Allocate an output for stdout and each file.
+
+    mov     rdi, [rsp+.argc]
+    sub     rdi, rax
+    inc     rdi
+    imul    rdi, TeeOutput_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.outputs], rax
+
+    mov     qword [rax+TeeOutput.fd], STDOUT_FD
+    mov     qword [rax+TeeOutput.target], STDOUT_FD
+    mov     qword [rax+TeeOutput.pipe_rd], -1
+    mov     qword [rax+TeeOutput.pipe_wr], -1
+    mov     qword [rax+TeeOutput.name], .stdout_name
+
+    mov     qword [rsp+.count], 1
+
+.next_file:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.argc]
+    jae     .files_opened
+
+    mov     rsi, (O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC)
+
+    test    qword [rsp+.flags], TEE_APPEND
+    jz      .open
+
+    mov     rsi, (O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC)
+
+.open:
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE]
+    mov     rdx, 666o
+    dcall   open
+    cmp     eax, 0
+    jl      .error_open
+
+    cdqe
+
+    mov     rbx, [rsp+.count]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     [rbx+TeeOutput.fd], rax
+    mov     [rbx+TeeOutput.target], rax
+    mov     qword [rbx+TeeOutput.pipe_rd], -1
+    mov     qword [rbx+TeeOutput.pipe_wr], -1
+
+    mov     rax, [rsp+.i]
+    mov     rdx, [rsp+.argv]
+    mov     rdx, [rdx+rax*PTR_SIZE]
+    mov     [rbx+TeeOutput.name], rdx
+
+    inc     qword [rsp+.count]
+    jmp     .file_done
+
+.error_open:
+    mov     rax, [rsp+.i]
+    mov     rdx, [rsp+.argv]
+    mov     rdx, [rdx+rax*PTR_SIZE]
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.file_done:
+    inc     qword [rsp+.i]
+    jmp     .next_file
+
+.files_opened:
+    mov     rdi, [rsp+.outputs]
+    mov     rsi, [rsp+.count]
+    mov     rdx, [rsp+.flags]
+    dcall   tee_zero_copy
+    cmp     rax, 0
+    je      .close
+    jl      .failed
+
+    ; The data has to go through user space.
+    mov     rdi, [rsp+.outputs]
+    mov     rsi, [rsp+.count]
+    dcall   tee_copy
+    cmp     rax, 0
+    je      .close
+
+.failed:
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.close:
+    ; Close the files (but not stdout).
+    mov     qword [rsp+.i], 1
+
+.next_close:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.count]
+    jae     .out
+
+    imul    rax, TeeOutput_size
+    add     rax, [rsp+.outputs]
+    mov     rdi, [rax+TeeOutput.fd]
+    cmp     rdi, 0
+    jl      .closed
+
+    dcall   close
+
+.closed:
+    inc     qword [rsp+.i]
+    jmp     .next_close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 7
+    ret
+
+.error:
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Copy stdin to the outputs without the data passing
+;   through user space.
+;
+; C prototype equivalent:
+;
+;     int tee_zero_copy(TeeOutput *outputs, size_t count, size_t flags);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of outputs (stdout first).
+; - Input: RSI (integer) - number of outputs.
+; - Input: RDX (integer) - TEE_* bitmask.
+; - Output: RAX (integer) - 0 on success, -1 on error, or 1 if the
+;   outputs must be written to by tee_copy() instead.
+;
+; Notes:
+;
+; - This requires stdin to be a pipe. For each block of input:
+;
+;   - tee(2) duplicates the data (without consuming it) into stdout
+;     if that is a pipe, and into a private pipe for each other
+;     output apart from the last one. The data in each private pipe
+;     is then moved to its output with splice(2).
+;
+;   - Finally, the data is moved from stdin to the last output with
+;     splice(2), which consumes it.
+;
+;   Duplicating the data only copies references to the pages in the
+;   pipe, not the data itself.
+;
+; - A private pipe is made at least as big as stdin, so that tee(2)
+;   always duplicates the whole block into the (empty) pipe.
+;
+; - The outputs must be regular files, pipes or sockets (other files,
+;   such as terminals, may not support splice(2)).
+;
+; Limitations:
+;
+; - splice(2) does not support files opened with O_APPEND, so the
+;   data is always copied when appending.
+;
+; - Unlike tee_copy(), an error writing to any output stops all
+;   output, since the other outputs cannot then be kept in step.
+;---------------------------------------------------------------------
+
+tee_zero_copy:
+cold_rodata
+    .write_fmt      db  "tee: error writing '%s'",10,0
+section .text
+    prologue_with_vars 9
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .outputs    equ     0   ; "TeeOutput *"
+    .count      equ     8   ; size_t: number of outputs.
+    .i          equ    16   ; size_t: output index.
+    .pipe_size  equ    24   ; size_t: size of the private pipes.
+    .bytes      equ    32   ; size_t: size of the current block.
+    .len        equ    40   ; size_t: bytes to duplicate.
+    .ret        equ    48   ; int: return value.
+    .fds        equ    56   ; int[2]: pipe2(2) result.
+    .stdout_fifo equ   64   ; bool: set if stdout is a pipe.
+    .stat       equ    72   ; Stat.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.outputs], rdi
+    mov     [rsp+.count], rsi
+
+    ; Assume the data must be copied.
+    mov     qword [rsp+.ret], 1
+    mov     qword [rsp+.stdout_fifo], 0
+
+    ;--------------------
+
+    test    rdx, TEE_APPEND
+    jnz     .out
+
+    mov     rdi, STDIN_FD
+    lea     rsi, [rsp+.stat]
+    dcall   fstat
+    cmp     eax, 0
+    jne     .out
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFIFO
+    jne     .out
+
+    ;--------------------
+    ; Check the output file types.
+
+    mov     qword [rsp+.i], 0
+
+.check_output:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.count]
+    jae     .outputs_checked
+
+    imul    rax, TeeOutput_size
+    add     rax, [rsp+.outputs]
+    mov     rdi, [rax+TeeOutput.fd]
+    lea     rsi, [rsp+.stat]
+    dcall   fstat
+    cmp     eax, 0
+    jne     .out
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+
+    cmp     eax, S_IFREG
+    je      .output_ok
+
+    cmp     eax, S_IFSOCK
+    je      .output_ok
+
+    cmp     eax, S_IFIFO
+    jne     .out
+
+    ; Only a pipe can be the target of tee(2). Of the outputs, only
+    ; stdout is used directly since the other outputs are written to
+    ; by splice(2).
+    cmp     qword [rsp+.i], 0
+    jne     .output_ok
+
+    mov     qword [rsp+.stdout_fifo], 1
+
+.output_ok:
+    inc     qword [rsp+.i]
+    jmp     .check_output
+
+.outputs_checked:
+    cmp     qword [rsp+.count], 1
+    je      .splice_only
+
+    ;--------------------
+    ; Create the private pipes.
+
+    mov     rdi, STDIN_FD
+    mov     rsi, F_GETPIPE_SZ
+    xor     rax, rax
+    dcall   fcntl
+    cdqe
+    cmp     rax, IO_READ_BUF_SIZE
+    jge     .pipe_size_ok
+
+    mov     rax, IO_READ_BUF_SIZE
+
+.pipe_size_ok:
+    mov     [rsp+.pipe_size], rax
+
+    mov     qword [rsp+.i], 0
+
+.create_pipe:
+    mov     rax, [rsp+.i]
+    inc     rax
+    cmp     rax, [rsp+.count]
+    jae     .pipes_created
+
+    ; If stdout is a pipe, the data is duplicated straight into it.
+    cmp     qword [rsp+.i], 0
+    jne     .new_pipe
+
+    cmp     qword [rsp+.stdout_fifo], 0
+    jne     .pipe_done
+
+.new_pipe:
+    lea     rdi, [rsp+.fds]
+    mov     rsi, O_CLOEXEC
+    dcall   pipe2
+    cmp     eax, 0
+    jne     .cleanup
+
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     eax, [rsp+.fds]
+    mov     [rbx+TeeOutput.pipe_rd], rax
+    mov     eax, [rsp+.fds+4]
+    mov     [rbx+TeeOutput.pipe_wr], rax
+    mov     [rbx+TeeOutput.target], rax
+
+    mov     rdi, rax
+    mov     rsi, F_SETPIPE_SZ
+    mov     rdx, [rsp+.pipe_size]
+    xor     rax, rax
+    dcall   fcntl
+    cmp     eax, 0
+    jl      .cleanup
+
+.pipe_done:
+    inc     qword [rsp+.i]
+    jmp     .create_pipe
+
+.pipes_created:
+    ; From now on, data is moved so there is no going back.
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Duplicate each block to all but the last output...
+
+.next_block:
+    mov     qword [rsp+.i], 0
+    mov     qword [rsp+.len], IO_READ_BUF_SIZE
+
+.tee_output:
+    mov     rax, [rsp+.i]
+    inc     rax
+    cmp     rax, [rsp+.count]
+    jae     .consume
+
+.tee_again:
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, STDIN_FD
+    mov     rsi, [rbx+TeeOutput.target]
+    mov     rdx, [rsp+.len]
+    xor     rcx, rcx
+    dcall   tee
+    cmp     rax, 0
+    jge     .teed
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .tee_again
+
+    cmp     rax, EAGAIN
+    je      .tee_again
+
+    jmp     .error_write
+
+.teed:
+    cmp     qword [rsp+.i], 0
+    jne     .check_teed
+
+    ; The first output determines the size of the block.
+    cmp     rax, 0
+    je      .cleanup ; EOF
+
+    mov     [rsp+.bytes], rax
+    mov     [rsp+.len], rax
+    jmp     .drain
+
+.check_teed:
+    cmp     rax, [rsp+.bytes]
+    jne     .error_write
+
+.drain:
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, [rbx+TeeOutput.pipe_rd]
+    cmp     rdi, 0
+    jl      .teed_output
+
+    mov     rsi, [rbx+TeeOutput.fd]
+    mov     rdx, [rsp+.bytes]
+    dcall   tee_splice
+    cmp     rax, [rsp+.bytes]
+    jne     .error_write
+
+.teed_output:
+    inc     qword [rsp+.i]
+    jmp     .tee_output
+
+    ;--------------------
+    ; ... then move it to the last one.
+
+.consume:
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, STDIN_FD
+    mov     rsi, [rbx+TeeOutput.fd]
+    mov     rdx, [rsp+.bytes]
+    dcall   tee_splice
+    cmp     rax, [rsp+.bytes]
+    jne     .error_write
+
+    jmp     .next_block
+
+    ;--------------------
+    ; Only stdout, so just move all the data to it.
+
+.splice_only:
+    mov     qword [rsp+.ret], 0
+    mov     qword [rsp+.i], 0
+
+    mov     rdi, STDIN_FD
+    mov     rsi, STDOUT_FD
+    mov     rdx, -1 ; Until EOF.
+    dcall   tee_splice
+    cmp     rax, 0
+    jl      .error_write
+
+    ;--------------------
+    ; Close the private pipes.
+
+.cleanup:
+    mov     qword [rsp+.i], 0
+
+.next_pipe:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.count]
+    jae     .out
+
+    mov     rbx, rax
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, [rbx+TeeOutput.pipe_rd]
+    cmp     rdi, 0
+    jl      .close_wr
+
+    dcall   close
+
+.close_wr:
+    mov     rdi, [rbx+TeeOutput.pipe_wr]
+    cmp     rdi, 0
+    jl      .pipe_closed
+
+    dcall   close
+
+.pipe_closed:
+    inc     qword [rsp+.i]
+    jmp     .next_pipe
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space Stat_size
+    epilogue_with_vars 9
+    ret
+
+.error_write:
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    mov     rdx, [rbx+TeeOutput.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .cleanup
+
+;---------------------------------------------------------------------
+; Description: Move data between file descriptors using splice(2).
+;
+; C prototype equivalent:
+;
+;     ssize_t tee_splice(int fd_in, int fd_out, size_t count);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - file descriptor to move data from (which
+;   must be a pipe).
+; - Input: RSI (integer) - file descriptor to move data to.
+; - Input: RDX (integer) - number of bytes to move (or -1 to move all
+;   the data).
+; - Output: RAX (integer) - number of bytes moved (which is only less
+;   than count at EOF), or -1 on error.
+;---------------------------------------------------------------------
+
+tee_splice:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd_in      equ     0   ; int.
+    .fd_out     equ     8   ; int.
+    .remaining  equ    16   ; size_t: bytes still to move.
+    .total      equ    24   ; size_t: bytes moved.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.fd_in], rdi
+    mov     [rsp+.fd_out], rsi
+    mov     [rsp+.remaining], rdx
+
+    mov     qword [rsp+.total], 0
+
+    ;--------------------
+
+.next:
+    mov     r8, [rsp+.remaining]
+    cmp     r8, 0
+    je      .done
+
+    cmp     r8, IO_READ_BUF_SIZE
+    jbe     .splice
+
+    mov     r8, IO_READ_BUF_SIZE
+
+.splice:
+    mov     rdi, [rsp+.fd_in]
+    xor     rsi, rsi
+    mov     rdx, [rsp+.fd_out]
+    xor     rcx, rcx
+    mov     r9, SPLICE_F_MOVE
+    dcall   splice
+    cmp     rax, 0
+    je      .done ; EOF
+    jg      .moved
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .next
+
+    cmp     rax, EAGAIN
+    je      .next
+
+    mov     rax, -1
+    jmp     .out
+
+.moved:
+    add     [rsp+.total], rax
+    sub     [rsp+.remaining], rax
+    jmp     .next
+
+.done:
+    mov     rax, [rsp+.total]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Copy stdin to the outputs using a buffer.
+;
+; C prototype equivalent:
+;
+;     int tee_copy(TeeOutput *outputs, size_t count);
+;
+; Parameters:
+;
+; - Input: RDI (address) - array of outputs (stdout first).
+; - Input: RSI (integer) - number of outputs.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - An output that cannot be written to is closed and ignored from
+;   then on.
+;---------------------------------------------------------------------
+
+tee_copy:
+cold_rodata
+    .read_fmt       db  "tee: error reading standard input",10,0
+    .write_fmt      db  "tee: error writing '%s'",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .outputs    equ     0   ; "TeeOutput *"
+    .count      equ     8   ; size_t: number of outputs.
+    .buffer     equ    16   ; "char *"
+    .bytes      equ    24   ; size_t: bytes read.
+    .i          equ    32   ; size_t: output index.
+    .ret        equ    40   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.outputs], rdi
+    mov     [rsp+.count], rsi
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+
+    mov     rdi, IO_READ_BUF_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.buffer], rax
+
+.read:
+    mov     rdi, STDIN_FD
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+    cmp     rax, 0
+    je      .out ; EOF
+    jl      .error_read
+
+    mov     [rsp+.bytes], rax
+    mov     qword [rsp+.i], 0
+
+.write:
+    mov     rbx, [rsp+.i]
+    cmp     rbx, [rsp+.count]
+    jae     .read
+
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, [rbx+TeeOutput.fd]
+    cmp     rdi, 0
+    jl      .written ; Failed previously.
+
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.bytes]
+    dcall   write_block
+    cmp     rax, [rsp+.bytes]
+    je      .written
+
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    mov     rdx, [rbx+TeeOutput.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+
+    ; Stop writing to the output (but never close stdout).
+    mov     rbx, [rsp+.i]
+    imul    rbx, TeeOutput_size
+    add     rbx, [rsp+.outputs]
+
+    mov     rdi, [rbx+TeeOutput.fd]
+    mov     qword [rbx+TeeOutput.fd], -1
+
+    cmp     qword [rsp+.i], 0
+    je      .written
+
+    dcall   close
+
+.written:
+    inc     qword [rsp+.i]
+    jmp     .write
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 6
+    ret
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     qword [rsp+.ret], -1
+    jmp     .out
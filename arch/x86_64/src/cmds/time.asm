@@ -0,0 +1,994 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_time
+global command_time
+
+extern arena_alloc
+extern asm_getopt
+extern get_command
+extern get_errno
+extern handle_command
+extern libc_strtol
+
+extern abox_environ
+extern multicall_name
+
+extern clock_gettime
+extern dprintf
+extern fflush
+extern getrusage
+extern posix_spawnp
+extern qsort
+extern strcmp
+extern strerror
+extern strrchr
+extern wait4
+
+extern optarg
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_time:  db  "see time(1)",10, \
+                        10, \
+                        "Options:",10, \
+                        10, \
+                        "-j   : Display the results as JSON.",10, \
+                        "-r N : Run the command N times and display the minimum, median and maximum values.",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign TIME_JSON               (1 << 0)
+
+;---------------------------------------------------------------------
+; Values measured for each run (index into TimeState.samples).
+;
+; Times are in nanoseconds, maxrss in KiB and the others are counts.
+
+%assign TIME_REAL               0
+%assign TIME_USER               1
+%assign TIME_SYS                2
+%assign TIME_MAXRSS             3
+%assign TIME_MINFLT             4
+%assign TIME_MAJFLT             5
+%assign TIME_NVCSW              6
+%assign TIME_NIVCSW             7
+
+%assign TIME_METRICS            8
+
+; Metrics below this index are times.
+%assign TIME_TIMES              (TIME_SYS + 1)
+
+; Maximum number of runs (which limits the memory used for samples to
+; TIME_METRICS * TIME_MAX_RUNS * 8 bytes).
+%assign TIME_MAX_RUNS           1000000
+
+%assign NSECS_PER_SEC           1000000000
+%assign NSECS_PER_USEC          1000
+
+;---------------------------------------------------------------------
+; State for the command being timed.
+;---------------------------------------------------------------------
+struc TimeState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .command    resq    1 ; "Command *": abox command, or NULL.
+    .argc       resq    1 ; size_t: number of command arguments.
+    .argv       resq    1 ; "char **": command and its arguments.
+    .runs       resq    1 ; size_t: number of times to run the command.
+    .flags      resq    1 ; TIME_* bitmask.
+    .samples    resq    1 ; "size_t *": TIME_METRICS arrays of runs values.
+    .failed     resq    1 ; bool: set if any run failed.
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Run a command and display the time and resources it
+;   used.
+;
+; Notes:
+;
+; - The results are written to stderr.
+;
+; - If the command is an abox command it is run in-process by
+;   handle_command() (avoiding a fork and exec). Otherwise it is run
+;   with posix_spawnp(3) and waited for with wait4(2).
+;
+; - With "-r", the samples for each value are sorted so that the
+;   minimum, median and maximum can be displayed.
+;
+; Limitations:
+;
+; - For an in-process command, maxrss is the high-water mark for the
+;   whole abox process (including earlier runs).
+;
+; - Commands flagged CMD_FLAG_EXITS (which call exit(3) rather than
+;   returning) are always forked (with posix_spawnp(3)), never run
+;   in-process.
+;---------------------------------------------------------------------
+
+command_time:
+section .rodata
+    .optstring          db  "jr:",0
+    .json_opt           equ 'j'
+    .runs_opt           equ 'r'
+cold_rodata
+    .runs_fmt           db  "time: invalid number of runs: '%s'",10,0
+section .text
+    prologue_with_vars 3
+
+    alloc_space TimeState_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .run            equ     16  ; size_t: current run.
+    .state          equ     24  ; TimeState.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.state+TimeState.command], 0
+    mov     qword [rsp+.state+TimeState.runs], 1
+    mov     qword [rsp+.state+TimeState.flags], 0
+    mov     qword [rsp+.state+TimeState.failed], 0
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .json_opt
+    je      .handle_json_opt
+
+    cmp     al, .runs_opt
+    je      .handle_runs_opt
+
+    jmp     .error_bad_option
+
+.handle_json_opt:
+    or      qword [rsp+.state+TimeState.flags], TIME_JSON
+    jmp     .next_arg
+
+.handle_runs_opt:
+    mov     rdi, [optarg]
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.state+TimeState.runs]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .error_runs
+
+    mov     rax, [rsp+.state+TimeState.runs]
+    cmp     rax, 1
+    jl      .error_runs
+
+    cmp     rax, TIME_MAX_RUNS
+    jg      .error_runs
+
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    jle     .error_no_arg
+
+    mov     rdx, [rsp+.argv]
+    lea     rdx, [rdx+rax*PTR_SIZE]
+
+    mov     [rsp+.state+TimeState.argc], rcx
+    mov     [rsp+.state+TimeState.argv], rdx
+
+    lea     rdi, [rsp+.state]
+    dcall   time_find_command
+
+    ;--------------------
+    ; Allocate the samples (freed when this command returns).
+
+    mov     rdi, [rsp+.state+TimeState.runs]
+    imul    rdi, (TIME_METRICS * PTR_SIZE)
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.state+TimeState.samples], rax
+
+    mov     qword [rsp+.run], 0
+
+.next_run:
+    mov     rax, [rsp+.run]
+    cmp     rax, [rsp+.state+TimeState.runs]
+    jae     .report
+
+    lea     rdi, [rsp+.state]
+    mov     rsi, rax
+    dcall   time_run
+    cmp     rax, 0
+    jl      .error
+    je      .run_done
+
+    mov     qword [rsp+.state+TimeState.failed], 1
+
+.run_done:
+    inc     qword [rsp+.run]
+    jmp     .next_run
+
+.report:
+    lea     rdi, [rsp+.state]
+    dcall   time_report
+
+    mov     rax, CMD_OK
+
+    cmp     qword [rsp+.state+TimeState.failed], 0
+    je      .out
+
+    mov     rax, CMD_FAILED
+
+.out:
+    free_space TimeState_size
+    epilogue_with_vars 3
+    ret
+
+.error:
+    mov     rax, CMD_FAILED
+    jmp     .out
+
+.error_runs:
+    mov     rdi, STDERR_FD
+    mov     rsi, .runs_fmt
+    mov     rdx, [optarg]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error
+
+.error_bad_option:
+    mov     rax, CMD_BAD_OPT
+    jmp     .out
+
+.error_no_arg:
+    mov     rax, CMD_NO_ARG
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Determine if the command to time is an abox command.
+;
+; C prototype equivalent:
+;
+;     void time_find_command(TimeState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TimeState.
+; - Output: None.
+;
+; Notes:
+;
+; - As for xargs, a command name without a path that matches an abox
+;   command is run in-process, as is "abox CMD" (where the multi-call
+;   binary may be specified with a path). In the latter case the
+;   multi-call name is removed from the arguments.
+;
+; - Commands with CMD_FLAG_EXITS (such as false) are never run
+;   in-process since they would exit before the results are shown.
+;---------------------------------------------------------------------
+
+time_find_command:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "TimeState *"
+    .name       equ     8   ; "char *": command name (without path).
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+
+    ;--------------------
+
+    mov     rax, [rdi+TimeState.argv]
+    mov     rax, [rax]
+    mov     [rsp+.name], rax
+
+    mov     rdi, rax
+    mov     rsi, '/'
+    dcall   strrchr
+    cmp     rax, 0
+    je      .check_multicall
+
+    inc     rax
+    mov     [rsp+.name], rax
+
+.check_multicall:
+    mov     rdi, [rsp+.name]
+    mov     rsi, multicall_name
+    dcall   strcmp
+    cmp     eax, 0
+    jne     .not_multicall
+
+    ; "abox CMD [ARGS]"
+    mov     rbx, [rsp+.state]
+    cmp     qword [rbx+TimeState.argc], 1
+    je      .out
+
+    mov     rax, [rbx+TimeState.argv]
+    mov     rdi, [rax+PTR_SIZE]
+    dcall   get_command
+    cmp     rax, 0
+    je      .out
+
+    test    qword [rax+Command.flags], CMD_FLAG_EXITS
+    jnz     .out
+
+    mov     rbx, [rsp+.state]
+    mov     [rbx+TimeState.command], rax
+    dec     qword [rbx+TimeState.argc]
+    add     qword [rbx+TimeState.argv], PTR_SIZE
+    jmp     .out
+
+.not_multicall:
+    ; Only consider names without a path.
+    mov     rbx, [rsp+.state]
+    mov     rax, [rbx+TimeState.argv]
+    mov     rdi, [rax]
+    cmp     rdi, [rsp+.name]
+    jne     .out
+
+    dcall   get_command
+    cmp     rax, 0
+    je      .out
+
+    test    qword [rax+Command.flags], CMD_FLAG_EXITS
+    jnz     .out
+
+    mov     rbx, [rsp+.state]
+    mov     [rbx+TimeState.command], rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Run the command once and record the time and resources
+;   it used.
+;
+; C prototype equivalent:
+;
+;     int time_run(TimeState *state, size_t run);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TimeState.
+; - Input: RSI (integer) - run number (index into the samples).
+; - Output: RAX (integer) - 0 if the command succeeded, 1 if it
+;   failed, or -1 if it could not be run.
+;
+; Notes:
+;
+; - An in-process command is measured using the difference between
+;   the getrusage(2) values before and after it runs. For an external
+;   command the "before" values are zero since wait4(2) returns the
+;   values for the child alone.
+;
+; - Buffered output is flushed before the end time is taken, so the
+;   cost of writing it is included.
+;---------------------------------------------------------------------
+
+time_run:
+cold_rodata
+    .spawn_fmt      db  "time: cannot run '%s': %s",10,0
+    .wait_fmt       db  "time: error waiting for '%s': %s",10,0
+section .text
+    prologue_with_vars 6
+
+    alloc_space ((2 * Timespec_size) + (2 * Rusage_size))
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "TimeState *"
+    .run        equ     8   ; size_t.
+    .pid        equ    16   ; pid_t.
+    .status     equ    24   ; int: wait status.
+    .ret        equ    32   ; int: return value.
+    .start      equ    48   ; Timespec.
+    .end        equ     (.start + Timespec_size)    ; Timespec.
+    .before     equ     (.end + Timespec_size)      ; Rusage.
+    .after      equ     (.before + Rusage_size)     ; Rusage.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.run], rsi
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+
+    lea     rdi, [rsp+.before]
+    mov     rcx, (Rusage_size / 8)
+    xor     rax, rax
+    rep     stosq
+
+    mov     rbx, [rsp+.state]
+    cmp     qword [rbx+TimeState.command], 0
+    je      .spawn
+
+    ;--------------------
+    ; Run an abox command in-process.
+
+    mov     rdi, RUSAGE_SELF
+    lea     rsi, [rsp+.before]
+    dcall   getrusage
+
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.start]
+    dcall   clock_gettime
+
+    mov     dword [optind], 1
+
+    mov     rbx, [rsp+.state]
+    mov     rdi, [rbx+TimeState.command]
+    mov     rsi, [rbx+TimeState.argc]
+    mov     rdx, [rbx+TimeState.argv]
+    dcall   handle_command
+    cmp     rax, 0
+    je      .flush
+
+    mov     qword [rsp+.ret], 1
+
+.flush:
+    mov     rdi, 0 ; All streams.
+    dcall   fflush
+
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.end]
+    dcall   clock_gettime
+
+    mov     rdi, RUSAGE_SELF
+    lea     rsi, [rsp+.after]
+    dcall   getrusage
+
+    jmp     .record
+
+    ;--------------------
+    ; Run an external command.
+
+.spawn:
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.start]
+    dcall   clock_gettime
+
+    mov     rbx, [rsp+.state]
+    lea     rdi, [rsp+.pid]
+    mov     rax, [rbx+TimeState.argv]
+    mov     rsi, [rax]
+    xor     rdx, rdx
+    xor     rcx, rcx
+    mov     r8, rax
+    mov     r9, [abox_environ]
+    dcall   posix_spawnp
+    cmp     eax, 0
+    jne     .error_spawn
+
+.wait:
+    ; Note: pid_t is 32-bit.
+    mov     edi, [rsp+.pid]
+    lea     rsi, [rsp+.status]
+    xor     rdx, rdx
+    lea     rcx, [rsp+.after]
+    dcall   wait4
+    cmp     eax, 0
+    jg      .waited
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .wait
+
+    mov     rdi, rax
+    dcall   strerror
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .wait_fmt
+    mov     rbx, [rsp+.state]
+    mov     rdx, [rbx+TimeState.argv]
+    mov     rdx, [rdx]
+    mov     rcx, rax
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .error
+
+.waited:
+    mov     rdi, CLOCK_MONOTONIC
+    lea     rsi, [rsp+.end]
+    dcall   clock_gettime
+
+    ; The status is zero only if the process exited normally with
+    ; status 0.
+    mov     eax, [rsp+.status]
+    and     eax, 0xffff
+    jz      .record
+
+    mov     qword [rsp+.ret], 1
+
+.record:
+    ;--------------------
+    ; rbx = address of the sample for the first metric,
+    ; rcx = distance between the samples for consecutive metrics.
+
+    mov     rdx, [rsp+.state]
+    mov     rcx, [rdx+TimeState.runs]
+    shl     rcx, 3
+    mov     rbx, [rsp+.run]
+    shl     rbx, 3
+    add     rbx, [rdx+TimeState.samples]
+
+    ; real
+    mov     rax, [rsp+.end+Timespec.tv_sec]
+    sub     rax, [rsp+.start+Timespec.tv_sec]
+    imul    rax, NSECS_PER_SEC
+    add     rax, [rsp+.end+Timespec.tv_nsec]
+    sub     rax, [rsp+.start+Timespec.tv_nsec]
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    ; user
+    mov     rax, [rsp+.after+Rusage.ru_utime+Timeval.tv_sec]
+    sub     rax, [rsp+.before+Rusage.ru_utime+Timeval.tv_sec]
+    imul    rax, (NSECS_PER_SEC / NSECS_PER_USEC)
+    add     rax, [rsp+.after+Rusage.ru_utime+Timeval.tv_usec]
+    sub     rax, [rsp+.before+Rusage.ru_utime+Timeval.tv_usec]
+    imul    rax, NSECS_PER_USEC
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    ; sys
+    mov     rax, [rsp+.after+Rusage.ru_stime+Timeval.tv_sec]
+    sub     rax, [rsp+.before+Rusage.ru_stime+Timeval.tv_sec]
+    imul    rax, (NSECS_PER_SEC / NSECS_PER_USEC)
+    add     rax, [rsp+.after+Rusage.ru_stime+Timeval.tv_usec]
+    sub     rax, [rsp+.before+Rusage.ru_stime+Timeval.tv_usec]
+    imul    rax, NSECS_PER_USEC
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    ; maxrss (a high-water mark, not a difference).
+    mov     rax, [rsp+.after+Rusage.ru_maxrss]
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    mov     rax, [rsp+.after+Rusage.ru_minflt]
+    sub     rax, [rsp+.before+Rusage.ru_minflt]
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    mov     rax, [rsp+.after+Rusage.ru_majflt]
+    sub     rax, [rsp+.before+Rusage.ru_majflt]
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    mov     rax, [rsp+.after+Rusage.ru_nvcsw]
+    sub     rax, [rsp+.before+Rusage.ru_nvcsw]
+    mov     [rbx], rax
+    add     rbx, rcx
+
+    mov     rax, [rsp+.after+Rusage.ru_nivcsw]
+    sub     rax, [rsp+.before+Rusage.ru_nivcsw]
+    mov     [rbx], rax
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    free_space ((2 * Timespec_size) + (2 * Rusage_size))
+    epilogue_with_vars 6
+    ret
+
+.error_spawn:
+    ; posix_spawnp(3) returns the error number.
+    mov     edi, eax
+    dcall   strerror
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .spawn_fmt
+    mov     rbx, [rsp+.state]
+    mov     rdx, [rbx+TimeState.argv]
+    mov     rdx, [rdx]
+    mov     rcx, rax
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Display the results for all runs.
+;
+; C prototype equivalent:
+;
+;     void time_report(TimeState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TimeState.
+; - Output: None.
+;
+; Notes:
+;
+; - For a single run, one value is displayed per line. Otherwise, the
+;   minimum, median and maximum are displayed. The median of an even
+;   number of runs is the lower of the two middle values.
+;
+; - The JSON format is a single object, with an object containing
+;   "min", "median" and "max" for each value (these are the same for a
+;   single run). Times are in seconds and maxrss is in KiB.
+;---------------------------------------------------------------------
+
+time_report:
+section .rodata
+    ; Metric names, indexed by TIME_* value.
+    .names          db  "real",0,0,0,0
+                    db  "user",0,0,0,0
+                    db  "sys",0,0,0,0,0
+                    db  "maxrss",0,0
+                    db  "minflt",0,0
+                    db  "majflt",0,0
+                    db  "nvcsw",0,0,0
+                    db  "nivcsw",0,0
+    .name_size      equ 8
+
+    .header_fmt     db  "%-7s%15s%15s%15s",10,0
+    .empty          db  0
+    .min            db  "min",0
+    .median         db  "median",0
+    .max            db  "max",0
+    .name_fmt       db  "%-7s",0
+    .newline        db  10,0
+
+    .json_runs_fmt  db  '{"runs":%lu',0
+    .json_name_fmt  db  ',"%s":{',0
+    .json_min       db  '"min":',0
+    .json_median    db  ',"median":',0
+    .json_max       db  ',"max":',0
+    .json_end       db  '}',0
+    .json_done      db  '}',10,0
+    .space          db  " ",0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "TimeState *"
+    .metric     equ     8   ; size_t: TIME_* value.
+    .values     equ    16   ; "size_t *": sorted samples for metric.
+    .count      equ    24   ; size_t: number of samples.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+
+    mov     rax, [rdi+TimeState.runs]
+    mov     [rsp+.count], rax
+
+    ;--------------------
+
+    test    qword [rdi+TimeState.flags], TIME_JSON
+    jnz     .json_header
+
+    cmp     qword [rsp+.count], 1
+    je      .metrics
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .header_fmt
+    mov     rdx, .empty
+    mov     rcx, .min
+    mov     r8, .median
+    mov     r9, .max
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .metrics
+
+.json_header:
+    mov     rdi, STDERR_FD
+    mov     rsi, .json_runs_fmt
+    mov     rdx, [rsp+.count]
+    xor     rax, rax
+    dcall   dprintf
+
+.metrics:
+    mov     qword [rsp+.metric], 0
+
+.next_metric:
+    cmp     qword [rsp+.metric], TIME_METRICS
+    jae     .done
+
+    ; values = samples + (metric * count)
+    mov     rbx, [rsp+.state]
+    mov     rax, [rsp+.metric]
+    imul    rax, [rsp+.count]
+    shl     rax, 3
+    add     rax, [rbx+TimeState.samples]
+    mov     [rsp+.values], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.count]
+    mov     rdx, PTR_SIZE
+    mov     rcx, time_compare
+    dcall   qsort
+
+    mov     rbx, [rsp+.state]
+    test    qword [rbx+TimeState.flags], TIME_JSON
+    jnz     .json_metric
+
+    ;--------------------
+    ; Text format.
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .name_fmt
+    mov     rdx, [rsp+.metric]
+    imul    rdx, .name_size
+    add     rdx, .names
+    xor     rax, rax
+    dcall   dprintf
+
+    ; min
+    mov     rdi, [rsp+.metric]
+    mov     rsi, [rsp+.values]
+    mov     rsi, [rsi]
+    mov     rdx, .space
+    mov     rcx, 0
+    dcall   time_print_value
+
+    cmp     qword [rsp+.count], 1
+    je      .text_end
+
+    ; median
+    mov     rax, [rsp+.count]
+    dec     rax
+    shr     rax, 1
+    mov     rsi, [rsp+.values]
+    mov     rsi, [rsi+rax*PTR_SIZE]
+    mov     rdi, [rsp+.metric]
+    mov     rdx, .space
+    mov     rcx, 0
+    dcall   time_print_value
+
+    ; max
+    mov     rax, [rsp+.count]
+    mov     rsi, [rsp+.values]
+    mov     rsi, [rsi+rax*PTR_SIZE-PTR_SIZE]
+    mov     rdi, [rsp+.metric]
+    mov     rdx, .space
+    mov     rcx, 0
+    dcall   time_print_value
+
+.text_end:
+    mov     rdi, STDERR_FD
+    mov     rsi, .newline
+    xor     rax, rax
+    dcall   dprintf
+
+    inc     qword [rsp+.metric]
+    jmp     .next_metric
+
+    ;--------------------
+    ; JSON format.
+
+.json_metric:
+    mov     rdi, STDERR_FD
+    mov     rsi, .json_name_fmt
+    mov     rdx, [rsp+.metric]
+    imul    rdx, .name_size
+    add     rdx, .names
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rdi, [rsp+.metric]
+    mov     rsi, [rsp+.values]
+    mov     rsi, [rsi]
+    mov     rdx, .json_min
+    mov     rcx, TIME_JSON
+    dcall   time_print_value
+
+    mov     rax, [rsp+.count]
+    dec     rax
+    shr     rax, 1
+    mov     rsi, [rsp+.values]
+    mov     rsi, [rsi+rax*PTR_SIZE]
+    mov     rdi, [rsp+.metric]
+    mov     rdx, .json_median
+    mov     rcx, TIME_JSON
+    dcall   time_print_value
+
+    mov     rax, [rsp+.count]
+    mov     rsi, [rsp+.values]
+    mov     rsi, [rsi+rax*PTR_SIZE-PTR_SIZE]
+    mov     rdi, [rsp+.metric]
+    mov     rdx, .json_max
+    mov     rcx, TIME_JSON
+    dcall   time_print_value
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .json_end
+    xor     rax, rax
+    dcall   dprintf
+
+    inc     qword [rsp+.metric]
+    jmp     .next_metric
+
+.done:
+    mov     rbx, [rsp+.state]
+    test    qword [rbx+TimeState.flags], TIME_JSON
+    jz      .out
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .json_done
+    xor     rax, rax
+    dcall   dprintf
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Display a single measured value on stderr.
+;
+; C prototype equivalent:
+;
+;     void time_print_value(size_t metric, size_t value,
+;                           const char *prefix, size_t flags);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - TIME_* metric.
+; - Input: RSI (integer) - value.
+; - Input: RDX (address) - string to display before the value.
+; - Input: RCX (integer) - TIME_JSON, or 0 for the text format.
+; - Output: None.
+;
+; Notes:
+;
+; - Times (in nanoseconds) are displayed in seconds with microsecond
+;   precision (the precision of the CPU times).
+;
+; - In the text format, values are right aligned in 15 character
+;   columns (including the prefix).
+;---------------------------------------------------------------------
+
+time_print_value:
+section .rodata
+    .time_fmt       db  "%s%7lu.%06lu",0
+    .count_fmt      db  "%s%14lu",0
+    .json_time_fmt  db  "%s%lu.%06lu",0
+    .json_count_fmt db  "%s%lu",0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .prefix     equ     0   ; "char *"
+    .flags      equ     8   ; size_t: TIME_JSON or 0.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.prefix], rdx
+    mov     [rsp+.flags], rcx
+
+    ;--------------------
+
+    cmp     rdi, TIME_TIMES
+    jae     .count
+
+    ; rcx = seconds, r8 = microseconds.
+    mov     rax, rsi
+    xor     rdx, rdx
+    mov     rbx, NSECS_PER_USEC
+    div     rbx
+    xor     rdx, rdx
+    mov     rbx, (NSECS_PER_SEC / NSECS_PER_USEC)
+    div     rbx
+    mov     rcx, rax
+    mov     r8, rdx
+
+    mov     rsi, .time_fmt
+    test    qword [rsp+.flags], TIME_JSON
+    jz      .print
+
+    mov     rsi, .json_time_fmt
+    jmp     .print
+
+.count:
+    mov     rcx, rsi
+
+    mov     rsi, .count_fmt
+    test    qword [rsp+.flags], TIME_JSON
+    jz      .print
+
+    mov     rsi, .json_count_fmt
+
+.print:
+    mov     rdi, STDERR_FD
+    mov     rdx, [rsp+.prefix]
+    xor     rax, rax
+    dcall   dprintf
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: qsort(3) comparison function for unsigned 64-bit
+;   values.
+;
+; C prototype equivalent:
+;
+;     int time_compare(const void *a, const void *b);
+;
+; Parameters:
+;
+; - Input: RDI (address) - first value.
+; - Input: RSI (address) - second value.
+; - Output: RAX (integer) - -1, 0 or 1 if the first value is less
+;   than, equal to or greater than the second.
+;---------------------------------------------------------------------
+
+time_compare:
+    prologue_with_vars 0
+
+    mov     rcx, [rdi]
+    xor     eax, eax
+    cmp     rcx, [rsi]
+    seta    al
+    sbb     eax, 0
+
+    epilogue_with_vars 0
+    ret
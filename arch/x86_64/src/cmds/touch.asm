@@ -16,11 +16,11 @@ extern write
 
 extern get_errno
 
-section .rodata
-command_help_touch:  db  "see touch(1)",0
-
 %include "header.inc"
 
+cold_rodata
+command_help_touch:  db  "see touch(1)",0
+
 section .text
 
 ;---------------------------------------------------------------------
@@ -0,0 +1,1744 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_tr
+global command_tr
+
+extern asm_getopt
+extern asm_strlen
+extern arena_alloc
+extern arena_alloc_aligned
+extern cpu_features
+extern read_block
+extern write_block
+
+extern dprintf
+extern strncmp
+
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_tr:  db  "see tr(1)",10, \
+                      10, \
+                      "Options:",10, \
+                      10, \
+                      "-c : Use the complement of SET1.",10, \
+                      "-d : Delete the characters in SET1.",10, \
+                      "-s : Squeeze repeated characters in the last SET.",10, \
+                      10, \
+                      "Sets may contain ranges (a-z), character classes",10, \
+                      "([:alpha:] etc) and backslash escapes.",0
+
+;---------------------------------------------------------------------
+; Option flags (bitmask).
+
+%assign TR_COMPLEMENT           (1 << 0)
+%assign TR_DELETE               (1 << 1)
+%assign TR_SQUEEZE              (1 << 2)
+%assign TR_TRANSLATE            (1 << 3)
+
+; Number of bytes handled by each call to a SIMD implementation (the
+; length passed must be a multiple of this).
+%assign TR_SIMD_BLOCK           32
+
+; Maximum number of translation map rows (see TrState) for which the
+; SIMD translation is used. Each row costs a compare, a shuffle and a
+; blend per block, so for maps that change most rows (for example
+; "tr '\0-\377' '\1-\377\0'") the scalar table lookup is faster.
+%assign TR_MAX_SIMD_ROWS        8
+
+;---------------------------------------------------------------------
+; Tables built from the sets.
+;
+; The translation map is split into 16 rows of 16 bytes (one row for
+; each value of the high nibble of a byte). Only the rows that are not
+; the identity are translated by the SIMD code: pshufb looks up the
+; low nibble in each such row and the result is used for bytes whose
+; high nibble matches.
+;
+; Deletion uses a bitmap: the .delete_lo (bytes 0x00-0x7f) and
+; .delete_hi (bytes 0x80-0xff) entries for the low nibble of a byte
+; have bit (high nibble % 8) set if the byte is deleted.
+;
+; All the SIMD tables are repeated in both 128-bit lanes.
+;---------------------------------------------------------------------
+struc TrState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .map            resb    256         ; Translation map.
+    .delete         resb    256         ; bool per byte: delete byte.
+    .squeeze        resb    256         ; bool per byte: squeeze byte.
+    .rows           resb    (16 * 32)   ; Map rows that are not the identity.
+    .row_nibbles    resb    (16 * 32)   ; High nibble for each of .rows.
+    .delete_lo      resb    32          ; Bitmap for bytes 0x00-0x7f.
+    .delete_hi      resb    32          ; Bitmap for bytes 0x80-0xff.
+    .row_count      resq    1           ; size_t: number of .rows.
+    .flags          resq    1           ; TR_* bitmask.
+    .last           resq    1           ; Last byte written (-1 for none).
+endstruc
+
+section .bss
+    ; Implementations selected for this CPU by tr_select().
+    translate_impl  resq 1
+    delete_impl     resq 1
+
+    ; For each 8-bit mask of bytes to keep, the pshufb control that
+    ; moves those bytes to the start of an 8-byte group, and the
+    ; number of bytes kept.
+    tr_compact_shuffle  resq 256
+    tr_compact_count    resb 256
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Translate, delete or squeeze characters from stdin to
+;   stdout.
+;---------------------------------------------------------------------
+
+command_tr:
+section .rodata
+    .optstring          db  "cds",0
+    .complement_opt     equ 'c'
+    .delete_opt         equ 'd'
+    .squeeze_opt        equ 's'
+cold_rodata
+    .empty_set2_fmt     db  "tr: when not truncating set1, string2 must be non-empty",10,0
+    .read_fmt           db  "tr: read error",10,0
+    .write_fmt          db  "tr: write error",10,0
+section .text
+    prologue_with_vars 12
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .flags          equ     16  ; size_t: TR_* bitmask.
+    .sets           equ     24  ; size_t: number of sets specified.
+    .set1           equ     32  ; "unsigned char *": expanded SET1.
+    .len1           equ     40  ; size_t.
+    .set2           equ     48  ; "unsigned char *": expanded SET2 (or NULL).
+    .len2           equ     56  ; size_t.
+    .state          equ     64  ; "TrState *"
+    .buffer         equ     72  ; "char *"
+    .bytes          equ     80  ; size_t: bytes to write.
+    .ret            equ     88  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rsp+.flags], 0
+    mov     qword [rsp+.set2], 0
+    mov     qword [rsp+.len2], 0
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .complement_opt
+    je      .handle_complement_opt
+
+    cmp     al, .delete_opt
+    je      .handle_delete_opt
+
+    cmp     al, .squeeze_opt
+    je      .handle_squeeze_opt
+
+    jmp     .error_bad_option
+
+.handle_complement_opt:
+    or      qword [rsp+.flags], TR_COMPLEMENT
+    jmp     .next_arg
+
+.handle_delete_opt:
+    or      qword [rsp+.flags], TR_DELETE
+    jmp     .next_arg
+
+.handle_squeeze_opt:
+    or      qword [rsp+.flags], TR_SQUEEZE
+    jmp     .next_arg
+
+.options_parsed:
+    ;--------------------
+    ; Check the number of sets:
+    ;
+    ; - "-d": SET1.
+    ; - "-d -s": SET1 and SET2.
+    ; - "-s": SET1 and optionally SET2.
+    ; - Otherwise: SET1 and SET2.
+
+    mov     eax, [optind]
+    cdqe
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    mov     [rsp+.sets], rcx
+
+    cmp     rcx, 0
+    je      .error_no_arg
+
+    cmp     rcx, 2
+    ja      .error_bad_arg
+
+    mov     rdx, [rsp+.flags]
+    and     rdx, (TR_DELETE|TR_SQUEEZE)
+
+    cmp     rdx, TR_SQUEEZE
+    je      .sets_ok
+
+    cmp     rdx, TR_DELETE
+    jne     .two_sets
+
+    cmp     rcx, 1
+    jne     .error_bad_arg
+
+    jmp     .sets_ok
+
+.two_sets:
+    cmp     rcx, 2
+    jne     .error_no_arg
+
+.sets_ok:
+    ; Translate if both sets were given (unless deleting).
+    cmp     rcx, 2
+    jne     .expand_set1
+
+    test    qword [rsp+.flags], TR_DELETE
+    jnz     .expand_set1
+
+    or      qword [rsp+.flags], TR_TRANSLATE
+
+.expand_set1:
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE]
+    dcall   tr_expand_arg
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.set1], rax
+    mov     [rsp+.len1], rdx
+
+    test    qword [rsp+.flags], TR_COMPLEMENT
+    jz      .expand_set2
+
+    mov     rdi, [rsp+.set1]
+    mov     rsi, [rsp+.len1]
+    dcall   tr_complement
+    mov     [rsp+.len1], rax
+
+.expand_set2:
+    cmp     qword [rsp+.sets], 2
+    jne     .expanded
+
+    mov     eax, [optind]
+    cdqe
+
+    mov     rdx, [rsp+.argv]
+    mov     rdi, [rdx+rax*PTR_SIZE+PTR_SIZE]
+    dcall   tr_expand_arg
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.set2], rax
+    mov     [rsp+.len2], rdx
+
+    test    qword [rsp+.flags], TR_TRANSLATE
+    jz      .expanded
+
+    cmp     qword [rsp+.len2], 0
+    je      .error_empty_set2
+
+.expanded:
+    ;--------------------
+    ; Build the tables.
+
+    mov     rdi, TrState_size
+    mov     rsi, TR_SIMD_BLOCK
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.state], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.set1]
+    mov     rdx, [rsp+.len1]
+    mov     rcx, [rsp+.set2]
+    mov     r8, [rsp+.len2]
+    mov     r9, [rsp+.flags]
+    dcall   tr_init_state
+
+    ; Nothing to translate if the map is the identity.
+    mov     rax, [rsp+.state]
+    cmp     qword [rax+TrState.row_count], 0
+    jne     .alloc_buffer
+
+    and     qword [rsp+.flags], ~TR_TRANSLATE
+
+.alloc_buffer:
+    mov     rdi, IO_READ_BUF_SIZE
+    mov     rsi, PAGE_SIZE
+    dcall   arena_alloc_aligned
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.buffer], rax
+
+    ;--------------------
+
+.read:
+    mov     rdi, STDIN_FD
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+    cmp     rax, 0
+    je      .out ; EOF
+    jl      .error_read
+
+    mov     [rsp+.bytes], rax
+
+    test    qword [rsp+.flags], TR_TRANSLATE
+    jz      .delete
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.bytes]
+    dcall   tr_translate
+
+.delete:
+    test    qword [rsp+.flags], TR_DELETE
+    jz      .squeeze
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.bytes]
+    dcall   tr_delete
+    mov     [rsp+.bytes], rax
+
+.squeeze:
+    test    qword [rsp+.flags], TR_SQUEEZE
+    jz      .write
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.bytes]
+    dcall   tr_squeeze
+    mov     [rsp+.bytes], rax
+
+.write:
+    cmp     qword [rsp+.bytes], 0
+    je      .read
+
+    mov     rdi, STDOUT_FD
+    mov     rsi, [rsp+.buffer]
+    mov     rdx, [rsp+.bytes]
+    dcall   write_block
+    cmp     rax, [rsp+.bytes]
+    jne     .error_write
+
+    jmp     .read
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 12
+    ret
+
+.error_empty_set2:
+    mov     rdi, STDERR_FD
+    mov     rsi, .empty_set2_fmt
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .error
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .error
+
+.error_write:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+.error:
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+.error_no_arg:
+    mov     qword [rsp+.ret], CMD_NO_ARG
+    jmp     .out
+
+.error_bad_arg:
+    mov     qword [rsp+.ret], CMD_BAD_ARG
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Expand a set argument into a newly allocated buffer.
+;
+; C prototype equivalent:
+;
+;     unsigned char *tr_expand_arg(const char *arg, size_t *len);
+;
+; Parameters:
+;
+; - Input: RDI (string) - set argument.
+; - Output: RAX (address) - expanded set, or NULL on error.
+; - Output: RDX (integer) - number of bytes in the expanded set.
+;
+; Notes:
+;
+; - Errors are reported on stderr.
+; - Each character of the argument expands to at most 256 bytes (for
+;   a range), which bounds the buffer size.
+;---------------------------------------------------------------------
+
+tr_expand_arg:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .arg        equ     0   ; "char *"
+    .set        equ     8   ; "unsigned char *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.arg], rdi
+
+    ;--------------------
+
+    dcall   asm_strlen
+
+    lea     rdi, [rax+1]
+    shl     rdi, 8
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.set], rax
+
+    mov     rdi, [rsp+.arg]
+    mov     rsi, rax
+    dcall   tr_expand_set
+    cmp     rax, -1
+    je      .error
+
+    mov     rdx, rax
+    mov     rax, [rsp+.set]
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error:
+    xor     rax, rax
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Expand the ranges, character classes and escapes in a
+;   set.
+;
+; C prototype equivalent:
+;
+;     ssize_t tr_expand_set(const char *str, unsigned char *set);
+;
+; Parameters:
+;
+; - Input: RDI (string) - set argument.
+; - Input: RSI (address) - buffer for the expanded set.
+; - Output: RAX (integer) - number of bytes in the expanded set, or -1
+;   on error.
+;
+; Notes:
+;
+; - Errors are reported on stderr.
+;
+; Limitations:
+;
+; - Only the C locale classes are supported, and the "[c*n]" and
+;   "[=c=]" forms are not supported.
+;---------------------------------------------------------------------
+
+tr_expand_set:
+section .rodata
+    ; Each class is a count of ranges followed by the (inclusive)
+    ; ranges, in ascending order.
+    .alnum          db  3, '0','9', 'A','Z', 'a','z'
+    .alpha          db  2, 'A','Z', 'a','z'
+    .blank          db  2, 9,9, ' ',' '
+    .cntrl          db  2, 0,31, 127,127
+    .digit          db  1, '0','9'
+    .graph          db  1, 33,126
+    .lower          db  1, 'a','z'
+    .print          db  1, 32,126
+    .punct          db  4, 33,47, 58,64, 91,96, 123,126
+    .space          db  2, 9,13, ' ',' '
+    .upper          db  1, 'A','Z'
+    .xdigit         db  3, '0','9', 'A','F', 'a','f'
+
+    .alnum_name     db  "alnum",0
+    .alpha_name     db  "alpha",0
+    .blank_name     db  "blank",0
+    .cntrl_name     db  "cntrl",0
+    .digit_name     db  "digit",0
+    .graph_name     db  "graph",0
+    .lower_name     db  "lower",0
+    .print_name     db  "print",0
+    .punct_name     db  "punct",0
+    .space_name     db  "space",0
+    .upper_name     db  "upper",0
+    .xdigit_name    db  "xdigit",0
+
+    .classes        dq  .alnum_name, .alnum
+                    dq  .alpha_name, .alpha
+                    dq  .blank_name, .blank
+                    dq  .cntrl_name, .cntrl
+                    dq  .digit_name, .digit
+                    dq  .graph_name, .graph
+                    dq  .lower_name, .lower
+                    dq  .print_name, .print
+                    dq  .punct_name, .punct
+                    dq  .space_name, .space
+                    dq  .upper_name, .upper
+                    dq  .xdigit_name, .xdigit
+                    dq  0, 0
+cold_rodata
+    .class_fmt      db  "tr: invalid character class",10,0
+    .range_fmt      db  "tr: range-endpoints of '%c-%c' are in reverse collating sequence order",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .str        equ     0   ; "char *": next character of argument.
+    .set        equ     8   ; "unsigned char *"
+    .len        equ    16   ; size_t: bytes in set.
+    .first      equ    24   ; int: first character of range.
+    .name_len   equ    32   ; size_t: length of class name.
+    .class      equ    40   ; "void **": current .classes entry.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.str], rdi
+    mov     [rsp+.set], rsi
+
+    mov     qword [rsp+.len], 0
+
+    ;--------------------
+
+.next_char:
+    mov     rsi, [rsp+.str]
+    cmp     byte [rsi], 0
+    je      .done
+
+    ;--------------------
+    ; Handle "[:class:]" (a '[' that does not start a complete class
+    ; is a normal character).
+
+    cmp     byte [rsi], '['
+    jne     .char
+
+    cmp     byte [rsi+1], ':'
+    jne     .char
+
+    lea     rdx, [rsi+2]
+
+.find_class_end:
+    mov     al, [rdx]
+    cmp     al, 0
+    je      .char
+
+    cmp     al, ':'
+    jne     .class_end_next
+
+    cmp     byte [rdx+1], ']'
+    je      .class_end_found
+
+.class_end_next:
+    inc     rdx
+    jmp     .find_class_end
+
+.class_end_found:
+    lea     rax, [rsi+2]
+    sub     rdx, rax
+    mov     [rsp+.name_len], rdx
+
+    mov     qword [rsp+.class], .classes
+
+.next_class:
+    mov     rax, [rsp+.class]
+    mov     rdi, [rax]
+    cmp     rdi, 0
+    je      .error_class
+
+    ; Match the whole name.
+    mov     rdx, [rsp+.name_len]
+    cmp     byte [rdi+rdx], 0
+    jne     .try_next_class
+
+    mov     rsi, [rsp+.str]
+    add     rsi, 2
+    dcall   strncmp
+    cmp     eax, 0
+    je      .class_found
+
+.try_next_class:
+    add     qword [rsp+.class], (2 * PTR_SIZE)
+    jmp     .next_class
+
+.class_found:
+    ; Skip "[:name:]".
+    mov     rax, [rsp+.name_len]
+    add     rax, 4
+    add     [rsp+.str], rax
+
+    mov     rax, [rsp+.class]
+    mov     rsi, [rax+PTR_SIZE]
+    movzx   r8d, byte [rsi]
+    inc     rsi
+
+    mov     rdi, [rsp+.set]
+    add     rdi, [rsp+.len]
+
+.next_range:
+    movzx   ecx, byte [rsi]
+    movzx   edx, byte [rsi+1]
+    add     rsi, 2
+
+.next_class_char:
+    mov     [rdi], cl
+    inc     rdi
+    inc     ecx
+    cmp     ecx, edx
+    jbe     .next_class_char
+
+    dec     r8d
+    jnz     .next_range
+
+    sub     rdi, [rsp+.set]
+    mov     [rsp+.len], rdi
+    jmp     .next_char
+
+    ;--------------------
+    ; Handle a character or range.
+
+.char:
+    lea     rdi, [rsp+.str]
+    dcall   tr_parse_char
+    mov     [rsp+.first], rax
+
+    ; A '-' at the end is a normal character.
+    mov     rsi, [rsp+.str]
+    cmp     byte [rsi], '-'
+    jne     .single
+
+    cmp     byte [rsi+1], 0
+    je      .single
+
+    inc     qword [rsp+.str]
+
+    lea     rdi, [rsp+.str]
+    dcall   tr_parse_char
+
+    mov     rcx, [rsp+.first]
+    cmp     rax, rcx
+    jb      .error_range
+
+    mov     rdi, [rsp+.set]
+    add     rdi, [rsp+.len]
+
+.next_range_char:
+    mov     [rdi], cl
+    inc     rdi
+    inc     ecx
+    cmp     ecx, eax
+    jbe     .next_range_char
+
+    sub     rdi, [rsp+.set]
+    mov     [rsp+.len], rdi
+    jmp     .next_char
+
+.single:
+    mov     rdi, [rsp+.set]
+    add     rdi, [rsp+.len]
+    mov     [rdi], al
+    inc     qword [rsp+.len]
+    jmp     .next_char
+
+.done:
+    mov     rax, [rsp+.len]
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+.error_class:
+    mov     rdi, STDERR_FD
+    mov     rsi, .class_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+.error_range:
+    mov     rdi, STDERR_FD
+    mov     rsi, .range_fmt
+    mov     rdx, [rsp+.first]
+    mov     rcx, rax
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse a (possibly escaped) character.
+;
+; C prototype equivalent:
+;
+;     unsigned char tr_parse_char(const char **str);
+;
+; Parameters:
+;
+; - Input/Output: RDI (address) - pointer to the string, which is
+;   advanced past the character.
+; - Output: RAX (integer) - character.
+;
+; Notes:
+;
+; - Handles "\\", "\a", "\b", "\f", "\n", "\r", "\t", "\v" and "\NNN"
+;   (1 to 3 octal digits). Any other escaped character is itself, and
+;   a trailing backslash is a backslash.
+;---------------------------------------------------------------------
+
+tr_parse_char:
+section .rodata
+    .escapes        db  "a",7, "b",8, "f",12, "n",10, "r",13, "t",9, "v",11, 0
+section .text
+    prologue_with_vars 0
+
+    mov     rsi, [rdi]
+    movzx   eax, byte [rsi]
+    inc     rsi
+
+    cmp     al, '\'
+    jne     .out
+
+    movzx   eax, byte [rsi]
+    cmp     al, 0
+    je      .trailing_backslash
+
+    inc     rsi
+
+    ;--------------------
+    ; Octal
+
+    sub     al, '0'
+    cmp     al, 7
+    ja      .not_octal
+
+    mov     ecx, 2 ; Up to 2 more digits.
+
+.next_digit:
+    movzx   edx, byte [rsi]
+    sub     dl, '0'
+    cmp     dl, 7
+    ja      .out
+
+    ; The value must fit in a byte.
+    mov     r8d, eax
+    shl     r8d, 3
+    or      r8d, edx
+    cmp     r8d, 255
+    ja      .out
+
+    mov     eax, r8d
+    inc     rsi
+    dec     ecx
+    jnz     .next_digit
+
+    jmp     .out
+
+.not_octal:
+    movzx   eax, byte [rsi-1]
+    mov     rdx, .escapes
+
+.next_escape:
+    mov     cl, [rdx]
+    cmp     cl, 0
+    je      .out ; Not special, so the character itself.
+
+    cmp     cl, al
+    je      .escape_found
+
+    add     rdx, 2
+    jmp     .next_escape
+
+.escape_found:
+    movzx   eax, byte [rdx+1]
+    jmp     .out
+
+.trailing_backslash:
+    mov     eax, '\'
+
+.out:
+    mov     [rdi], rsi
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Replace a set with its complement.
+;
+; C prototype equivalent:
+;
+;     size_t tr_complement(unsigned char *set, size_t len);
+;
+; Parameters:
+;
+; - Input/Output: RDI (address) - set (which must have space for 256
+;   bytes).
+; - Input: RSI (integer) - number of bytes in set.
+; - Output: RAX (integer) - number of bytes in the complement.
+;
+; Notes:
+;
+; - The complement is in ascending order (which determines how it is
+;   translated).
+;---------------------------------------------------------------------
+
+tr_complement:
+    prologue_with_vars 0
+    alloc_space 256
+
+    ; Mark the bytes in the set.
+    mov     rdx, rdi
+
+    mov     rdi, rsp
+    mov     rcx, 256
+    xor     eax, eax
+    rep     stosb
+
+    mov     rcx, rsi
+
+.mark:
+    cmp     rcx, 0
+    je      .marked
+
+    movzx   eax, byte [rdx+rcx-1]
+    mov     byte [rsp+rax], 1
+    dec     rcx
+    jmp     .mark
+
+.marked:
+    xor     eax, eax
+    xor     ecx, ecx
+
+.next_byte:
+    cmp     byte [rsp+rcx], 0
+    jne     .skip
+
+    mov     [rdx+rax], cl
+    inc     rax
+
+.skip:
+    inc     ecx
+    cmp     ecx, 256
+    jb      .next_byte
+
+    free_space 256
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Build the tables from the expanded sets.
+;
+; C prototype equivalent:
+;
+;     void tr_init_state(TrState *state,
+;                        const unsigned char *set1, size_t len1,
+;                        const unsigned char *set2, size_t len2,
+;                        size_t flags);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TrState.
+; - Input: RSI (address) - SET1.
+; - Input: RDX (integer) - bytes in SET1.
+; - Input: RCX (address) - SET2 (or NULL).
+; - Input: R8 (integer) - bytes in SET2.
+; - Input: R9 (integer) - TR_* bitmask.
+;
+; Notes:
+;
+; - When translating, SET2 is extended by repeating its last byte.
+; - When a byte appears more than once in SET1, the last translation
+;   is used.
+; - The squeeze set is SET2 if specified, otherwise SET1.
+;---------------------------------------------------------------------
+
+tr_init_state:
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "TrState *"
+    .set1       equ     8   ; "unsigned char *"
+    .len1       equ    16   ; size_t.
+    .set2       equ    24   ; "unsigned char *"
+    .len2       equ    32   ; size_t.
+    .flags      equ    40   ; size_t: TR_* bitmask.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.set1], rsi
+    mov     [rsp+.len1], rdx
+    mov     [rsp+.set2], rcx
+    mov     [rsp+.len2], r8
+    mov     [rsp+.flags], r9
+
+    ;--------------------
+
+    mov     rcx, TrState_size
+    xor     eax, eax
+    rep     stosb
+
+    mov     rbx, [rsp+.state]
+
+    mov     rax, [rsp+.flags]
+    mov     [rbx+TrState.flags], rax
+    mov     qword [rbx+TrState.last], -1
+
+    ; Identity map.
+    xor     ecx, ecx
+
+.identity:
+    mov     [rbx+TrState.map+rcx], cl
+    inc     ecx
+    cmp     ecx, 256
+    jb      .identity
+
+    ;--------------------
+
+    test    qword [rsp+.flags], TR_TRANSLATE
+    jz      .delete
+
+    mov     rsi, [rsp+.set1]
+    mov     rdi, [rsp+.set2]
+    mov     rdx, [rsp+.len2]
+    dec     rdx ; Index of last byte of SET2.
+    xor     ecx, ecx
+
+.translate:
+    cmp     rcx, [rsp+.len1]
+    jae     .delete
+
+    mov     r8, rcx
+    cmp     r8, rdx
+    cmova   r8, rdx
+
+    movzx   eax, byte [rsi+rcx]
+    mov     r8b, [rdi+r8]
+    mov     [rbx+TrState.map+rax], r8b
+
+    inc     rcx
+    jmp     .translate
+
+.delete:
+    test    qword [rsp+.flags], TR_DELETE
+    jz      .squeeze
+
+    mov     rsi, [rsp+.set1]
+    mov     rcx, [rsp+.len1]
+
+.next_delete:
+    cmp     rcx, 0
+    je      .squeeze
+
+    movzx   eax, byte [rsi+rcx-1]
+    mov     byte [rbx+TrState.delete+rax], 1
+    dec     rcx
+    jmp     .next_delete
+
+.squeeze:
+    test    qword [rsp+.flags], TR_SQUEEZE
+    jz      .rows
+
+    mov     rsi, [rsp+.set2]
+    mov     rcx, [rsp+.len2]
+
+    cmp     rsi, 0
+    jne     .next_squeeze
+
+    mov     rsi, [rsp+.set1]
+    mov     rcx, [rsp+.len1]
+
+.next_squeeze:
+    cmp     rcx, 0
+    je      .rows
+
+    movzx   eax, byte [rsi+rcx-1]
+    mov     byte [rbx+TrState.squeeze+rax], 1
+    dec     rcx
+    jmp     .next_squeeze
+
+    ;--------------------
+    ; Record the map rows that are not the identity.
+
+.rows:
+    xor     ecx, ecx ; Row.
+
+.next_row:
+    mov     edx, ecx
+    shl     edx, 4
+    xor     r8d, r8d ; Byte within row.
+
+.check_row:
+    lea     eax, [rdx+r8]
+    cmp     [rbx+TrState.map+rax], al
+    jne     .add_row
+
+    inc     r8d
+    cmp     r8d, 16
+    jb      .check_row
+
+    jmp     .row_done
+
+.add_row:
+    mov     rax, [rbx+TrState.row_count]
+    shl     rax, 5
+    lea     rdi, [rbx+TrState.rows+rax]
+    lea     rsi, [rbx+TrState.row_nibbles+rax]
+
+    movdqu  xmm0, [rbx+TrState.map+rdx]
+    movdqu  [rdi], xmm0
+    movdqu  [rdi+16], xmm0
+
+    xor     r8d, r8d
+
+.fill_nibble:
+    mov     [rsi+r8], cl
+    inc     r8d
+    cmp     r8d, 32
+    jb      .fill_nibble
+
+    inc     qword [rbx+TrState.row_count]
+
+.row_done:
+    inc     ecx
+    cmp     ecx, 16
+    jb      .next_row
+
+    ;--------------------
+    ; Build the deletion bitmap.
+
+    xor     ecx, ecx ; Byte.
+
+.next_bitmap_byte:
+    cmp     byte [rbx+TrState.delete+rcx], 0
+    je      .bitmap_byte_done
+
+    mov     edx, ecx
+    and     edx, 0x0f ; Low nibble.
+
+    mov     r8d, ecx
+    shr     r8d, 4
+    movzx   eax, byte [tr_nibble_bits+r8] ; Bit for high nibble.
+
+    lea     rdi, [rbx+TrState.delete_lo]
+    lea     rsi, [rbx+TrState.delete_hi]
+    cmp     ecx, 0x80
+    cmovae  rdi, rsi
+
+    or      [rdi+rdx], al
+    or      [rdi+rdx+16], al
+
+.bitmap_byte_done:
+    inc     ecx
+    cmp     ecx, 256
+    jb      .next_bitmap_byte
+
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Translate data in place.
+;
+; C prototype equivalent:
+;
+;     void tr_translate(TrState *state, unsigned char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TrState.
+; - Input/Output: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+;---------------------------------------------------------------------
+
+tr_translate:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "TrState *"
+    .buf        equ     8   ; "unsigned char *"
+    .len        equ    16   ; size_t.
+    .bulk       equ    24   ; size_t: bytes for the SIMD implementation.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.buf], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    cmp     qword [translate_impl], 0
+    jne     .selected
+
+    dcall   tr_select
+
+.selected:
+    mov     rax, [translate_impl]
+
+    mov     rdi, [rsp+.state]
+    cmp     qword [rdi+TrState.row_count], TR_MAX_SIMD_ROWS
+    jbe     .impl_ok
+
+    mov     rax, tr_translate_scalar
+
+.impl_ok:
+    mov     rdx, [rsp+.len]
+    and     rdx, ~(TR_SIMD_BLOCK-1)
+    mov     [rsp+.bulk], rdx
+
+    mov     rsi, [rsp+.buf]
+    dcall   rax
+
+    ; Handle the remaining bytes.
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buf]
+    add     rsi, [rsp+.bulk]
+    mov     rdx, [rsp+.len]
+    sub     rdx, [rsp+.bulk]
+    dcall   tr_translate_scalar
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Delete bytes in place.
+;
+; C prototype equivalent:
+;
+;     size_t tr_delete(TrState *state, unsigned char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TrState.
+; - Input/Output: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: RAX (integer) - number of bytes remaining.
+;---------------------------------------------------------------------
+
+tr_delete:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "TrState *"
+    .buf        equ     8   ; "unsigned char *"
+    .len        equ    16   ; size_t.
+    .bulk       equ    24   ; size_t: bytes for the SIMD implementation.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.buf], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    cmp     qword [delete_impl], 0
+    jne     .selected
+
+    dcall   tr_select
+
+.selected:
+    mov     rdx, [rsp+.len]
+    and     rdx, ~(TR_SIMD_BLOCK-1)
+    mov     [rsp+.bulk], rdx
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buf]
+    mov     rcx, rsi
+    mov     rax, [delete_impl]
+    dcall   rax
+
+    ; Handle the remaining bytes.
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.buf]
+    mov     rcx, rsi
+    add     rcx, rax
+    add     rsi, [rsp+.bulk]
+    mov     rdx, [rsp+.len]
+    sub     rdx, [rsp+.bulk]
+    mov     rbx, rax
+    dcall   tr_delete_scalar
+    add     rax, rbx
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Squeeze repeated bytes in place.
+;
+; C prototype equivalent:
+;
+;     size_t tr_squeeze(TrState *state, unsigned char *buf, size_t len);
+;
+; Parameters:
+;
+; - Input/Output: RDI (address) - TrState (.last is updated so that
+;   repeats spanning calls are squeezed).
+; - Input/Output: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: RAX (integer) - number of bytes remaining.
+;---------------------------------------------------------------------
+
+tr_squeeze:
+    prologue_with_vars 0
+
+    mov     r8, rsi ; Start.
+    lea     r9, [rsi+rdx] ; End.
+    mov     rcx, rsi ; Next byte to write.
+    mov     rdx, [rdi+TrState.last]
+
+.next_byte:
+    cmp     rsi, r9
+    jae     .done
+
+    movzx   eax, byte [rsi]
+    inc     rsi
+
+    cmp     rax, rdx
+    jne     .keep
+
+    cmp     byte [rdi+TrState.squeeze+rax], 0
+    jne     .next_byte
+
+.keep:
+    mov     [rcx], al
+    inc     rcx
+    mov     rdx, rax
+    jmp     .next_byte
+
+.done:
+    mov     [rdi+TrState.last], rdx
+
+    mov     rax, rcx
+    sub     rax, r8
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Select the SIMD implementations and build the
+;   compaction tables.
+;
+; C prototype equivalent:
+;
+;     void tr_select(void);
+;---------------------------------------------------------------------
+
+tr_select:
+    prologue_with_vars 0
+
+    ;--------------------
+    ; Compaction tables: for each mask, the indices of its set bits
+    ; followed by 0xff (which makes pshufb write zero).
+
+    xor     ecx, ecx ; Mask.
+
+.next_mask:
+    lea     rdi, [tr_compact_shuffle+rcx*8]
+    mov     qword [rdi], -1
+
+    xor     edx, edx ; Bit.
+    xor     eax, eax ; Bytes kept.
+
+.next_bit:
+    bt      ecx, edx
+    jnc     .bit_done
+
+    mov     [rdi+rax], dl
+    inc     eax
+
+.bit_done:
+    inc     edx
+    cmp     edx, 8
+    jb      .next_bit
+
+    mov     [tr_compact_count+rcx], al
+
+    inc     ecx
+    cmp     ecx, 256
+    jb      .next_mask
+
+    ;--------------------
+    ; Select the implementations.
+
+    dcall   cpu_features
+
+    mov     rcx, tr_translate_scalar
+    mov     rdx, tr_delete_scalar
+
+    test    rax, CPU_FEATURE_SSSE3
+    jz      .selected
+
+    mov     rcx, tr_translate_ssse3
+    mov     rdx, tr_delete_ssse3
+
+    test    rax, CPU_FEATURE_AVX2
+    jz      .selected
+
+    mov     rcx, tr_translate_avx2
+    mov     rdx, tr_delete_avx2
+
+.selected:
+    mov     [translate_impl], rcx
+    mov     [delete_impl], rdx
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Implementations.
+;
+; C prototype equivalents:
+;
+;     void translate(TrState *state, unsigned char *buf, size_t len);
+;     size_t delete(TrState *state, const unsigned char *src,
+;                   size_t len, unsigned char *dst);
+;
+; Parameters:
+;
+; - Input: RDI (address) - TrState.
+; - Input: RSI (address) - data (translated in place).
+; - Input: RDX (integer) - number of bytes of data (a multiple of
+;   TR_SIMD_BLOCK for the SIMD implementations).
+; - Input: RCX (address) - (delete only) output buffer, which may be
+;   the same as the data.
+; - Output: RAX (integer) - (delete only) number of bytes written.
+;
+; Notes:
+;
+; - The SIMD delete implementations compact each 8 bytes using
+;   tr_compact_shuffle and always store 8 bytes. Since the output
+;   never gets ahead of the input, this only overwrites data that has
+;   already been loaded (or output that is later overwritten).
+;---------------------------------------------------------------------
+
+section .rodata
+    tr_nibble_mask      times 32 db 0x0f
+    tr_low_mask         times 32 db 0x8f
+    tr_high_bit         times 32 db 0x80
+
+    ; The bit for each high nibble in the deletion bitmap.
+    tr_nibble_bits      db  1, 2, 4, 8, 16, 32, 64, 128
+                        db  1, 2, 4, 8, 16, 32, 64, 128
+                        db  1, 2, 4, 8, 16, 32, 64, 128
+                        db  1, 2, 4, 8, 16, 32, 64, 128
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Translate a byte at a time.
+;---------------------------------------------------------------------
+
+tr_translate_scalar:
+    prologue_with_vars 0
+
+    lea     rcx, [rsi+rdx]
+
+.next_byte:
+    cmp     rsi, rcx
+    jae     .out
+
+    movzx   eax, byte [rsi]
+    mov     al, [rdi+TrState.map+rax]
+    mov     [rsi], al
+
+    inc     rsi
+    jmp     .next_byte
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Delete a byte at a time.
+;---------------------------------------------------------------------
+
+tr_delete_scalar:
+    prologue_with_vars 0
+
+    mov     r8, rcx ; Start of output.
+    lea     rdx, [rsi+rdx]
+
+.next_byte:
+    cmp     rsi, rdx
+    jae     .out
+
+    movzx   eax, byte [rsi]
+    inc     rsi
+
+    cmp     byte [rdi+TrState.delete+rax], 0
+    jne     .next_byte
+
+    mov     [rcx], al
+    inc     rcx
+    jmp     .next_byte
+
+.out:
+    mov     rax, rcx
+    sub     rax, r8
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Translate 16 bytes at a time using SSSE3.
+;---------------------------------------------------------------------
+
+tr_translate_ssse3:
+    prologue_with_vars 0
+
+    movdqu  xmm5, [tr_nibble_mask]
+
+    mov     r8, [rdi+TrState.row_count]
+    lea     r9, [rsi+rdx]
+
+.next_block:
+    cmp     rsi, r9
+    jae     .out
+
+    movdqu  xmm0, [rsi]
+
+    ; High and low nibbles.
+    movdqa  xmm1, xmm0
+    psrlw   xmm1, 4
+    pand    xmm1, xmm5
+    movdqa  xmm2, xmm0
+    pand    xmm2, xmm5
+
+    lea     r10, [rdi+TrState.rows]
+    lea     r11, [rdi+TrState.row_nibbles]
+    mov     rcx, r8
+
+.next_row:
+    ; Replace the bytes in this row with their entries.
+    movdqu  xmm3, [r11]
+    pcmpeqb xmm3, xmm1
+    movdqu  xmm4, [r10]
+    pshufb  xmm4, xmm2
+    pand    xmm4, xmm3
+    pandn   xmm3, xmm0
+    por     xmm3, xmm4
+    movdqa  xmm0, xmm3
+
+    add     r10, 32
+    add     r11, 32
+    dec     rcx
+    jnz     .next_row
+
+    movdqu  [rsi], xmm0
+
+    add     rsi, 16
+    jmp     .next_block
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Translate 32 bytes at a time using AVX2.
+;---------------------------------------------------------------------
+
+tr_translate_avx2:
+    prologue_with_vars 0
+
+    vmovdqu ymm5, [tr_nibble_mask]
+
+    mov     r8, [rdi+TrState.row_count]
+    lea     r9, [rsi+rdx]
+
+.next_block:
+    cmp     rsi, r9
+    jae     .out
+
+    vmovdqu ymm0, [rsi]
+
+    ; High and low nibbles.
+    vpsrlw  ymm1, ymm0, 4
+    vpand   ymm1, ymm1, ymm5
+    vpand   ymm2, ymm0, ymm5
+
+    lea     r10, [rdi+TrState.rows]
+    lea     r11, [rdi+TrState.row_nibbles]
+    mov     rcx, r8
+
+.next_row:
+    ; Replace the bytes in this row with their entries.
+    vpcmpeqb ymm3, ymm1, [r11]
+    vmovdqu ymm4, [r10]
+    vpshufb ymm4, ymm4, ymm2
+    vpblendvb ymm0, ymm0, ymm4, ymm3
+
+    add     r10, 32
+    add     r11, 32
+    dec     rcx
+    jnz     .next_row
+
+    vmovdqu [rsi], ymm0
+
+    add     rsi, 32
+    jmp     .next_block
+
+.out:
+    vzeroupper
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Delete using SSSE3, checking 16 bytes at a time.
+;---------------------------------------------------------------------
+
+tr_delete_ssse3:
+    prologue_with_vars 0
+
+    movdqu  xmm7, [rdi+TrState.delete_lo]
+    movdqu  xmm6, [rdi+TrState.delete_hi]
+    movdqu  xmm5, [tr_nibble_mask]
+    movdqu  xmm4, [tr_low_mask]
+    movdqu  xmm3, [tr_high_bit]
+    movdqu  xmm8, [tr_nibble_bits]
+
+    mov     r8, rcx ; Start of output.
+    mov     rdi, rcx
+    lea     r9, [rsi+rdx]
+
+.next_block:
+    cmp     rsi, r9
+    jae     .out
+
+    movdqu  xmm0, [rsi]
+
+    ; Look up the bitmap entries for the low nibble (pshufb gives zero
+    ; for the table that does not apply since the index has bit 7
+    ; set).
+    movdqa  xmm1, xmm0
+    pand    xmm1, xmm4
+    movdqa  xmm2, xmm7
+    pshufb  xmm2, xmm1
+    pxor    xmm1, xmm3
+    movdqa  xmm9, xmm6
+    pshufb  xmm9, xmm1
+    por     xmm2, xmm9
+
+    ; Check the bit for the high nibble.
+    movdqa  xmm1, xmm0
+    psrlw   xmm1, 4
+    pand    xmm1, xmm5
+    movdqa  xmm9, xmm8
+    pshufb  xmm9, xmm1
+    pand    xmm2, xmm9
+    pcmpeqb xmm2, xmm9
+
+    pmovmskb eax, xmm2
+    xor     eax, 0xffff ; Bytes to keep.
+
+    cmp     eax, 0xffff
+    jne     .compact
+
+    movdqu  [rdi], xmm0
+    add     rdi, 16
+    add     rsi, 16
+    jmp     .next_block
+
+.compact:
+    cmp     eax, 0
+    jne     .compact_groups
+
+    ; All deleted.
+    add     rsi, 16
+    jmp     .next_block
+
+.compact_groups:
+    mov     r10d, 2
+
+.next_group:
+    movzx   ecx, al
+    movq    xmm1, [rsi]
+    movq    xmm2, [tr_compact_shuffle+rcx*8]
+    pshufb  xmm1, xmm2
+    movq    [rdi], xmm1
+
+    movzx   ecx, byte [tr_compact_count+rcx]
+    add     rdi, rcx
+    add     rsi, 8
+    shr     eax, 8
+    dec     r10d
+    jnz     .next_group
+
+    jmp     .next_block
+
+.out:
+    mov     rax, rdi
+    sub     rax, r8
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Delete using AVX2, checking 32 bytes at a time.
+;---------------------------------------------------------------------
+
+tr_delete_avx2:
+    prologue_with_vars 0
+
+    vmovdqu ymm7, [rdi+TrState.delete_lo]
+    vmovdqu ymm6, [rdi+TrState.delete_hi]
+    vmovdqu ymm5, [tr_nibble_mask]
+    vmovdqu ymm4, [tr_low_mask]
+    vmovdqu ymm3, [tr_high_bit]
+    vmovdqu ymm8, [tr_nibble_bits]
+
+    mov     r8, rcx ; Start of output.
+    mov     rdi, rcx
+    lea     r9, [rsi+rdx]
+
+.next_block:
+    cmp     rsi, r9
+    jae     .out
+
+    vmovdqu ymm0, [rsi]
+
+    ; Look up the bitmap entries for the low nibble (vpshufb gives
+    ; zero for the table that does not apply since the index has bit
+    ; 7 set).
+    vpand   ymm1, ymm0, ymm4
+    vpshufb ymm2, ymm7, ymm1
+    vpxor   ymm1, ymm1, ymm3
+    vpshufb ymm1, ymm6, ymm1
+    vpor    ymm2, ymm2, ymm1
+
+    ; Check the bit for the high nibble.
+    vpsrlw  ymm1, ymm0, 4
+    vpand   ymm1, ymm1, ymm5
+    vpshufb ymm1, ymm8, ymm1
+    vpand   ymm2, ymm2, ymm1
+    vpcmpeqb ymm2, ymm2, ymm1
+
+    vpmovmskb eax, ymm2
+    not     eax ; Bytes to keep.
+
+    cmp     eax, -1
+    jne     .compact
+
+    vmovdqu [rdi], ymm0
+    add     rdi, 32
+    add     rsi, 32
+    jmp     .next_block
+
+.compact:
+    cmp     eax, 0
+    jne     .compact_groups
+
+    ; All deleted.
+    add     rsi, 32
+    jmp     .next_block
+
+.compact_groups:
+    mov     r10d, 4
+
+.next_group:
+    movzx   ecx, al
+    vmovq   xmm1, [rsi]
+    vmovq   xmm2, [tr_compact_shuffle+rcx*8]
+    vpshufb xmm1, xmm1, xmm2
+    vmovq   [rdi], xmm1
+
+    movzx   ecx, byte [tr_compact_count+rcx]
+    add     rdi, rcx
+    add     rsi, 8
+    shr     eax, 8
+    dec     r10d
+    jnz     .next_group
+
+    jmp     .next_block
+
+.out:
+    vzeroupper
+
+    mov     rax, rdi
+    sub     rax, r8
+
+    epilogue_with_vars 0
+    ret
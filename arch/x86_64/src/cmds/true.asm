@@ -13,10 +13,10 @@ global command_help_true
 
 extern exit
 
-section .rodata
+cold_rodata
 command_help_true:  db  "see true(1)",0
 
-section .text
+hot_text true
 
 command_true:
     prologue_with_vars 0
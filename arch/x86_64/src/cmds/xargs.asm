@@ -0,0 +1,2097 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_xargs
+global command_xargs
+
+extern asm_getopt
+extern get_command
+extern get_errno
+extern handle_command
+extern libc_strtol
+extern read_block
+
+extern abox_environ
+extern multicall_name
+
+extern calloc
+extern close
+extern dprintf
+extern dup2
+extern eventfd
+extern fcntl
+extern fflush
+extern free
+extern get_nprocs
+extern malloc
+extern memcpy
+extern open
+extern poll
+extern posix_spawnp
+extern pthread_create
+extern pthread_join
+extern pthread_mutex_destroy
+extern pthread_mutex_init
+extern pthread_mutex_lock
+extern pthread_mutex_unlock
+extern realloc
+extern strcmp
+extern strerror
+extern strlen
+extern strrchr
+extern strstr
+extern syscall
+extern waitpid
+extern write
+
+extern optarg
+extern optind
+
+%include "header.inc"
+
+cold_rodata
+command_help_xargs:  db  "see xargs(1)",10, \
+                         10, \
+                         "Usage: xargs [OPTION]... [COMMAND [INITIAL-ARGS]...]",10, \
+                         10, \
+                         "Options:",10, \
+                         10, \
+                         "-0      : Items are separated by a nul byte (not blanks).",10, \
+                         "-I STR  : Run COMMAND once per input line, replacing STR",10, \
+                         "          in INITIAL-ARGS with the line.",10, \
+                         "-n NUM  : Use at most NUM items per command.",10, \
+                         "-P NUM  : Run up to NUM commands at a time (0 for one per CPU).",10, \
+                         "-s SIZE : Use at most SIZE bytes per command line.",10, \
+                         10, \
+                         "If COMMAND is an abox command (optionally prefixed with the",10, \
+                         "multi-call name), it is run in a thread rather than a new process.",0
+
+; Maximum number of commands run at the same time.
+%assign XARGS_MAX_PROCS         64
+
+; Default maximum size of a command line (bytes).
+%assign XARGS_DEFAULT_SIZE      (128 * 1024)
+
+; Initial size of the item buffer.
+%assign XARGS_BUF_SIZE          4096
+
+;---------------------------------------------------------------------
+; A running command.
+;---------------------------------------------------------------------
+struc XargsJob
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .state      resq    1 ; "XargsState *"
+    .argc       resq    1 ; size_t
+    .argv       resq    1 ; "char **": NULL terminated.
+    .strings    resq    1 ; "char *": buffer .argv entries point into.
+    .pid        resq    1 ; pid_t: process running the command.
+    .thread     resq    1 ; pthread_t: thread running an abox command.
+    .started    resq    1 ; bool: true if .thread was created.
+    .fd         resq    1 ; int: eventfd written when .thread finishes.
+    .ret        resq    1 ; int: result of an abox command.
+endstruc
+
+;---------------------------------------------------------------------
+; xargs state.
+;---------------------------------------------------------------------
+struc XargsState
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    ; Set from the options.
+    .nul        resq    1 ; bool: -0 specified.
+    .replace    resq    1 ; "char *": -I string (or NULL).
+    .max_args   resq    1 ; size_t: -n value (0 for no limit).
+    .max_size   resq    1 ; size_t: -s value.
+    .max_procs  resq    1 ; size_t: -P value.
+
+    ; The command to run.
+    .fixed_argc resq    1 ; size_t: COMMAND and INITIAL-ARGS count.
+    .fixed_argv resq    1 ; "char **": COMMAND and INITIAL-ARGS.
+    .fixed_size resq    1 ; size_t: bytes in .fixed_argv strings (with nuls).
+    .command    resq    1 ; "Command *": abox command (or NULL).
+
+    ; Items read for the next command. Each item is nul terminated.
+    .strings    resq    1 ; "char *"
+    .len        resq    1 ; size_t: bytes used.
+    .cap        resq    1 ; size_t: bytes allocated.
+    .items      resq    1 ; size_t: number of items.
+    .item_start resq    1 ; size_t: offset of the current item.
+
+    .running    resq    1 ; size_t: number of jobs running.
+    .ran        resq    1 ; bool: true once a command has been run.
+    .error      resq    1 ; bool: true if a command failed.
+
+    ; Serialises abox commands, which share the getopt state.
+    .lock       resb    PTHREAD_MUTEX_T_SIZE
+
+    .jobs       resb    (XargsJob_size * XARGS_MAX_PROCS)
+
+    ; Entry n is for job n. The fd is -1 if the job is not in use.
+    .pollfds    resb    (PollFd_size * XARGS_MAX_PROCS)
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Implement the standard `xargs` command.
+;
+; C prototype equivalent:
+;
+;     int command_xargs(int argc, char *argv[]);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - argc.
+; - Input: RSI (address) - argv.
+; - Output: RAX (integer) - 0 on success, -1 on error.
+;
+; Notes:
+;
+; - External commands are started with posix_spawnp(3) (which uses
+;   vfork semantics, so the page tables are not copied). Each process
+;   is tracked by a pidfd, so a single poll(2) call waits for any of
+;   the running commands to finish.
+;
+; - If COMMAND is an abox command it is run by handle_command() in a
+;   thread (which signals an eventfd when done, so it is waited for
+;   in the same way as a process). This avoids a fork and exec per
+;   command.
+;
+; - Commands are run with stdin set to /dev/null (the items are read
+;   from a private copy of stdin). This includes abox commands run
+;   in-process, since they share the file descriptors of xargs. The
+;   original stdin is restored before returning, so that the caller
+;   (for example "time -r N xargs") can read from it again.
+;
+; Limitations:
+;
+; - abox commands share the getopt state so only one runs at a time
+;   (although they do run at the same time as external commands).
+; - The exit status is 1 if any command fails (rather than the
+;   specific values that GNU xargs uses).
+; - No support for -L, -E, -p, -r, -t or -x.
+;
+; See: xargs(1).
+;---------------------------------------------------------------------
+
+command_xargs:
+section .rodata
+    .optstring          db  "0I:n:P:s:",0
+    .nul_opt            equ '0'
+    .replace_opt        equ 'I'
+    .max_args_opt       equ 'n'
+    .max_procs_opt      equ 'P'
+    .max_size_opt       equ 's'
+
+    .default_cmd        db  "echo",0
+    .default_argv       dq  .default_cmd, 0
+    .dev_null           db  "/dev/null",0
+
+    .alloc_fmt          db  "xargs: out of memory",10,0
+    .stdin_fmt          db  "xargs: cannot redirect stdin",10,0
+    .too_long_fmt       db  "xargs: argument line too long",10,0
+section .text
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .state          equ     16  ; "XargsState *"
+    .ret            equ     24  ; int: return value.
+    .value          equ     32  ; size_t: scratch value.
+    .fd_in          equ     40  ; int: input file descriptor.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    mov     qword [rsp+.fd_in], -1
+
+    mov     rdi, 1
+    mov     rsi, XargsState_size
+    dcall   calloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.state], rax
+
+    ;--------------------
+    ; Set defaults
+
+    mov     qword [rax+XargsState.max_size], XARGS_DEFAULT_SIZE
+    mov     qword [rax+XargsState.max_procs], 1
+
+    lea     rdi, [rax+XargsState.lock]
+    xor     rsi, rsi
+    dcall   pthread_mutex_init
+
+    ; Mark all the jobs as unused.
+    mov     rax, [rsp+.state]
+    lea     rdx, [rax+XargsState.pollfds]
+    xor     rcx, rcx
+
+.init_pollfd:
+    mov     dword [rdx+PollFd.fd], -1
+    mov     word [rdx+PollFd.events], POLLIN
+    mov     word [rdx+PollFd.revents], 0
+    add     rdx, PollFd_size
+    inc     rcx
+    cmp     rcx, XARGS_MAX_PROCS
+    jb      .init_pollfd
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    cmp     al, '?'
+    jz      .error_bad_option
+
+    cmp     al, .nul_opt
+    je      .handle_nul_opt
+
+    cmp     al, .replace_opt
+    je      .handle_replace_opt
+
+    cmp     al, .max_args_opt
+    je      .handle_max_args_opt
+
+    cmp     al, .max_procs_opt
+    je      .handle_max_procs_opt
+
+    cmp     al, .max_size_opt
+    je      .handle_max_size_opt
+
+    jmp     .error_bad_option
+
+.handle_nul_opt:
+    mov     rax, [rsp+.state]
+    mov     qword [rax+XargsState.nul], 1
+    jmp     .next_arg
+
+.handle_replace_opt:
+    mov     rcx, [optarg]
+    cmp     byte [rcx], 0
+    je      .error_bad_num
+
+    mov     rax, [rsp+.state]
+    mov     [rax+XargsState.replace], rcx
+    jmp     .next_arg
+
+.handle_max_args_opt:
+    mov     rdi, [optarg]
+    dcall   xargs_parse_number
+    cmp     rax, 1
+    jl      .error_bad_num
+
+    mov     rcx, [rsp+.state]
+    mov     [rcx+XargsState.max_args], rax
+    jmp     .next_arg
+
+.handle_max_size_opt:
+    mov     rdi, [optarg]
+    dcall   xargs_parse_number
+    cmp     rax, 1
+    jl      .error_bad_num
+
+    mov     rcx, [rsp+.state]
+    mov     [rcx+XargsState.max_size], rax
+    jmp     .next_arg
+
+.handle_max_procs_opt:
+    mov     rdi, [optarg]
+    dcall   xargs_parse_number
+    cmp     rax, 0
+    jl      .error_bad_num
+    jg      .check_max_procs
+
+    ; One per CPU.
+    dcall   get_nprocs
+    cdqe
+
+.check_max_procs:
+    cmp     rax, XARGS_MAX_PROCS
+    jle     .set_max_procs
+
+    mov     rax, XARGS_MAX_PROCS
+
+.set_max_procs:
+    cmp     rax, 1
+    jge     .save_max_procs
+
+    mov     rax, 1
+
+.save_max_procs:
+    mov     rcx, [rsp+.state]
+    mov     [rcx+XargsState.max_procs], rax
+    jmp     .next_arg
+
+.options_parsed:
+    mov     eax, [optind]
+    cdqe
+
+    ;--------------------
+    ; Determine the command.
+
+    mov     rbx, [rsp+.state]
+
+    mov     rcx, [rsp+.argc]
+    sub     rcx, rax
+    jnz     .have_command
+
+    mov     qword [rbx+XargsState.fixed_argc], 1
+    mov     qword [rbx+XargsState.fixed_argv], .default_argv
+    jmp     .find_command
+
+.have_command:
+    mov     [rbx+XargsState.fixed_argc], rcx
+    mov     rdx, [rsp+.argv]
+    lea     rdx, [rdx+rax*PTR_SIZE]
+    mov     [rbx+XargsState.fixed_argv], rdx
+
+.find_command:
+    mov     rdi, rbx
+    dcall   xargs_find_command
+
+    ;--------------------
+    ; Determine the size of the fixed part of each command line.
+
+    mov     qword [rsp+.value], 0
+
+.next_fixed:
+    mov     rbx, [rsp+.state]
+    mov     rax, [rsp+.value]
+    cmp     rax, [rbx+XargsState.fixed_argc]
+    je      .fixed_sized
+
+    mov     rcx, [rbx+XargsState.fixed_argv]
+    mov     rdi, [rcx+rax*PTR_SIZE]
+    dcall   strlen
+
+    mov     rbx, [rsp+.state]
+    inc     rax
+    add     [rbx+XargsState.fixed_size], rax
+    inc     qword [rsp+.value]
+    jmp     .next_fixed
+
+.fixed_sized:
+    mov     rax, [rbx+XargsState.fixed_size]
+    cmp     rax, [rbx+XargsState.max_size]
+    ja      .error_too_long
+
+    ;--------------------
+    ; Create the item buffer.
+
+    mov     rdi, XARGS_BUF_SIZE
+    dcall   malloc
+    cmp     rax, 0
+    je      .error_alloc_state
+
+    mov     rbx, [rsp+.state]
+    mov     [rbx+XargsState.strings], rax
+    mov     qword [rbx+XargsState.cap], XARGS_BUF_SIZE
+
+    ;--------------------
+    ; Read the items from a private copy of stdin, and give the
+    ; commands /dev/null instead.
+
+    mov     rdi, STDIN_FD
+    mov     rsi, F_DUPFD_CLOEXEC
+    mov     rdx, 3
+    xor     rax, rax
+    dcall   fcntl
+    cmp     eax, 0
+    jl      .error_stdin
+
+    cdqe
+    mov     [rsp+.fd_in], rax
+
+    mov     rdi, .dev_null
+    mov     rsi, O_RDONLY
+    xor     rax, rax
+    dcall   open
+    cmp     eax, 0
+    jl      .error_stdin
+
+    cdqe
+    mov     [rsp+.value], rax
+
+    mov     rdi, rax
+    mov     rsi, STDIN_FD
+    dcall   dup2
+    cdqe
+    mov     [rsp+.ret], rax
+
+    mov     rdi, [rsp+.value]
+    dcall   close
+
+    cmp     qword [rsp+.ret], 0
+    jl      .error_stdin
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+    ; Run the commands.
+
+    mov     rdi, [rsp+.state]
+    mov     rsi, [rsp+.fd_in]
+    dcall   xargs_read
+    cmp     rax, 0
+    jne     .run_failed
+
+    ; Handle the remaining items.
+    mov     rbx, [rsp+.state]
+    cmp     qword [rbx+XargsState.items], 0
+    jne     .run_remaining
+
+    ; Without any input, the command is still run once (except for -I).
+    cmp     qword [rbx+XargsState.ran], 0
+    jne     .wait
+
+    cmp     qword [rbx+XargsState.replace], 0
+    jne     .wait
+
+.run_remaining:
+    mov     rdi, rbx
+    mov     rsi, [rbx+XargsState.items]
+    mov     rdx, [rbx+XargsState.len]
+    dcall   xargs_dispatch
+    cmp     rax, 0
+    je      .wait
+
+.run_failed:
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.wait:
+    ; Wait for all the commands to finish.
+    mov     rdi, [rsp+.state]
+    cmp     qword [rdi+XargsState.running], 0
+    je      .waited
+
+    dcall   xargs_reap
+    cmp     rax, 0
+    je      .wait
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.waited:
+    mov     rax, [rsp+.state]
+    cmp     qword [rax+XargsState.error], 0
+    je      .cleanup
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+.cleanup:
+    mov     rdi, [rsp+.fd_in]
+    cmp     rdi, 0
+    jl      .free_state
+
+    ; Restore the original stdin (nothing more can be done if this
+    ; fails).
+    mov     rsi, STDIN_FD
+    dcall   dup2
+
+    mov     rdi, [rsp+.fd_in]
+    dcall   close
+
+.free_state:
+    mov     rbx, [rsp+.state]
+    mov     rdi, [rbx+XargsState.strings]
+    dcall   free
+
+    mov     rbx, [rsp+.state]
+    lea     rdi, [rbx+XargsState.lock]
+    dcall   pthread_mutex_destroy
+
+    mov     rdi, [rsp+.state]
+    dcall   free
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 6
+    ret
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .free_state
+
+.error_bad_num:
+    mov     qword [rsp+.ret], CMD_BAD_OPT_VAL
+    jmp     .free_state
+
+.error_too_long:
+    mov     rdi, STDERR_FD
+    mov     rsi, .too_long_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .free_state
+
+.error_stdin:
+    mov     rdi, STDERR_FD
+    mov     rsi, .stdin_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .cleanup
+
+.error_alloc_state:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .free_state
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse a number specified as an option argument.
+;
+; C prototype equivalent:
+;
+;     long xargs_parse_number(const char *str);
+;
+; Parameters:
+;
+; - Input: RDI (string) - number to parse.
+; - Output: RAX (integer) - value, or -1 on error.
+;---------------------------------------------------------------------
+
+xargs_parse_number:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .value      equ     0   ; long: parsed value.
+
+    ;--------------------
+
+    mov     rsi, BASE_10
+    lea     rdx, [rsp+.value]
+    dcall   libc_strtol
+
+    cmp     rax, 0
+    mov     rax, -1
+    jne     .out
+
+    mov     rax, [rsp+.value]
+
+.out:
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Determine if the command to run is an abox command.
+;
+; C prototype equivalent:
+;
+;     void xargs_find_command(XargsState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Output: None.
+;
+; Notes:
+;
+; - A command name without a path that matches an abox command is run
+;   in-process, as is "abox CMD" (where the multi-call binary may be
+;   specified with a path). In the latter case the multi-call name is
+;   removed from the fixed arguments.
+;
+; - xargs itself is never run in-process since the nested instance
+;   would need the lock held by the outer one.
+;
+; - Commands with CMD_FLAG_EXITS (such as false) are never run
+;   in-process since they would exit xargs (abandoning any running
+;   commands and the remaining input).
+;---------------------------------------------------------------------
+
+xargs_find_command:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .name       equ     8   ; "char *": command name (without path).
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+
+    ;--------------------
+
+    mov     rax, [rdi+XargsState.fixed_argv]
+    mov     rax, [rax]
+    mov     [rsp+.name], rax
+
+    mov     rdi, rax
+    mov     rsi, '/'
+    dcall   strrchr
+    cmp     rax, 0
+    je      .check_multicall
+
+    inc     rax
+    mov     [rsp+.name], rax
+
+.check_multicall:
+    mov     rdi, [rsp+.name]
+    mov     rsi, multicall_name
+    dcall   strcmp
+    cmp     eax, 0
+    jne     .not_multicall
+
+    ; "abox CMD [INITIAL-ARGS]"
+    mov     rbx, [rsp+.state]
+    cmp     qword [rbx+XargsState.fixed_argc], 1
+    je      .out
+
+    mov     rax, [rbx+XargsState.fixed_argv]
+    mov     rdi, [rax+PTR_SIZE]
+    dcall   get_command
+    cmp     rax, 0
+    je      .out
+
+    cmp     qword [rax+Command.func], command_xargs
+    je      .out
+
+    test    qword [rax+Command.flags], CMD_FLAG_EXITS
+    jnz     .out
+
+    mov     rbx, [rsp+.state]
+    mov     [rbx+XargsState.command], rax
+    dec     qword [rbx+XargsState.fixed_argc]
+    add     qword [rbx+XargsState.fixed_argv], PTR_SIZE
+    jmp     .out
+
+.not_multicall:
+    ; Only consider names without a path.
+    mov     rbx, [rsp+.state]
+    mov     rax, [rbx+XargsState.fixed_argv]
+    mov     rdi, [rax]
+    cmp     rdi, [rsp+.name]
+    jne     .out
+
+    dcall   get_command
+    cmp     rax, 0
+    je      .out
+
+    cmp     qword [rax+Command.func], command_xargs
+    je      .out
+
+    test    qword [rax+Command.flags], CMD_FLAG_EXITS
+    jnz     .out
+
+    mov     rbx, [rsp+.state]
+    mov     [rbx+XargsState.command], rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Read items and run commands for them.
+;
+; C prototype equivalent:
+;
+;     int xargs_read(XargsState *state, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Input: RSI (integer) - file descriptor to read from.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; Items are separated by:
+;
+; - nul bytes (-0).
+; - newlines (-I), ignoring leading blanks and empty lines.
+; - blanks and newlines (default). Single and double quotes, and
+;   backslash, can be used to include blanks in an item.
+;---------------------------------------------------------------------
+
+xargs_read:
+section .rodata
+    .read_fmt       db  "xargs: read error",10,0
+    .quote_fmt      db  "xargs: unmatched quote",10,0
+section .text
+    ; 8 auto-allocated variables...
+    prologue_with_vars 8
+
+    ; ... and 1 manually allocated one.
+    ;
+    ; Allocate space for read buffer.
+    sub     rsp, IO_READ_BUF_SIZE
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .fd         equ     8   ; int: file descriptor.
+    .bytes      equ     16  ; size_t: bytes in buffer.
+    .i          equ     24  ; size_t: index of next byte in buffer.
+    .quote      equ     32  ; char: quote character in effect (or 0).
+    .escape     equ     40  ; bool: previous character was a backslash.
+    .in_item    equ     48  ; bool: an item has been started.
+    .ret        equ     56  ; int: return value.
+    .buffer     equ     64  ; IO_READ_BUF_SIZE bytes.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.fd], rsi
+
+    ;--------------------
+
+    mov     qword [rsp+.quote], 0
+    mov     qword [rsp+.escape], 0
+    mov     qword [rsp+.in_item], 0
+    mov     qword [rsp+.ret], -1
+
+.read_again:
+    mov     rdi, [rsp+.fd]
+    lea     rsi, [rsp+.buffer]
+    mov     rdx, IO_READ_BUF_SIZE
+    dcall   read_block
+
+    cmp     rax, 0
+    je      .eof
+    jl      .error_read
+
+    mov     [rsp+.bytes], rax
+    mov     qword [rsp+.i], 0
+
+.next_byte:
+    mov     rcx, [rsp+.i]
+    cmp     rcx, [rsp+.bytes]
+    je      .read_again
+
+    movzx   eax, byte [rsp+.buffer+rcx]
+    inc     qword [rsp+.i]
+
+    mov     rbx, [rsp+.state]
+
+    cmp     qword [rbx+XargsState.nul], 0
+    jne     .nul_mode
+
+    cmp     qword [rbx+XargsState.replace], 0
+    jne     .line_mode
+
+    ;--------------------
+    ; Blank separated items.
+
+    cmp     qword [rsp+.escape], 0
+    jne     .escaped
+
+    cmp     qword [rsp+.quote], 0
+    jne     .quoted
+
+    cmp     al, ' '
+    je      .blank
+
+    cmp     al, 9 ; '\t'
+    je      .blank
+
+    cmp     al, NL
+    je      .blank
+
+    cmp     al, '\'
+    je      .backslash
+
+    cmp     al, "'"
+    je      .start_quote
+
+    cmp     al, '"'
+    je      .start_quote
+
+    jmp     .append
+
+.backslash:
+    mov     qword [rsp+.escape], 1
+    mov     qword [rsp+.in_item], 1
+    jmp     .next_byte
+
+.escaped:
+    mov     qword [rsp+.escape], 0
+    jmp     .append
+
+.start_quote:
+    mov     [rsp+.quote], rax
+    mov     qword [rsp+.in_item], 1
+    jmp     .next_byte
+
+.quoted:
+    cmp     rax, [rsp+.quote]
+    jne     .check_quoted_nl
+
+    mov     qword [rsp+.quote], 0
+    jmp     .next_byte
+
+.check_quoted_nl:
+    cmp     al, NL
+    je      .error_quote
+
+    jmp     .append
+
+.blank:
+    cmp     qword [rsp+.in_item], 0
+    je      .next_byte
+
+    jmp     .end_item
+
+    ;--------------------
+    ; Nul separated items.
+
+.nul_mode:
+    cmp     al, 0
+    je      .end_item
+
+    jmp     .append
+
+    ;--------------------
+    ; Newline separated items.
+
+.line_mode:
+    cmp     al, NL
+    je      .blank
+
+    cmp     qword [rsp+.in_item], 0
+    jne     .append
+
+    ; Ignore leading blanks.
+    cmp     al, ' '
+    je      .next_byte
+
+    cmp     al, 9 ; '\t'
+    je      .next_byte
+
+    ;--------------------
+
+.append:
+    mov     qword [rsp+.in_item], 1
+
+    mov     rdi, rbx
+    mov     rsi, rax
+    dcall   xargs_append
+    cmp     rax, 0
+    jne     .out
+
+    jmp     .next_byte
+
+.end_item:
+    mov     qword [rsp+.in_item], 0
+
+    mov     rdi, rbx
+    dcall   xargs_end_item
+    cmp     rax, 0
+    jne     .out
+
+    jmp     .next_byte
+
+.eof:
+    cmp     qword [rsp+.quote], 0
+    jne     .error_quote
+
+    cmp     qword [rsp+.in_item], 0
+    je      .success
+
+    mov     rdi, [rsp+.state]
+    dcall   xargs_end_item
+    cmp     rax, 0
+    jne     .out
+
+.success:
+    mov     qword [rsp+.ret], 0
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    add     rsp, IO_READ_BUF_SIZE
+    epilogue_with_vars 8
+    ret
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+.error_quote:
+    mov     rdi, STDERR_FD
+    mov     rsi, .quote_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Add a byte to the current item.
+;
+; C prototype equivalent:
+;
+;     int xargs_append(XargsState *state, char c);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Input: RSI (integer) - byte to add.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+xargs_append:
+section .rodata
+    .alloc_fmt      db  "xargs: out of memory",10,0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .c          equ     8   ; char: byte to add.
+
+    ;--------------------
+
+    mov     rbx, rdi
+
+    mov     rcx, [rbx+XargsState.len]
+    cmp     rcx, [rbx+XargsState.cap]
+    jb      .store
+
+    ;--------------------
+    ; Double the size of the buffer.
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.c], rsi
+
+    mov     rdi, [rbx+XargsState.strings]
+    mov     rsi, [rbx+XargsState.cap]
+    shl     rsi, 1
+    dcall   realloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     rbx, [rsp+.state]
+    mov     [rbx+XargsState.strings], rax
+    shl     qword [rbx+XargsState.cap], 1
+
+    mov     rsi, [rsp+.c]
+    mov     rcx, [rbx+XargsState.len]
+
+.store:
+    mov     rax, [rbx+XargsState.strings]
+    mov     [rax+rcx], sil
+    inc     qword [rbx+XargsState.len]
+
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Complete the current item, running the command if
+;   a limit has been reached.
+;
+; C prototype equivalent:
+;
+;     int xargs_end_item(XargsState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+xargs_end_item:
+section .rodata
+    .too_long_fmt   db  "xargs: argument line too long",10,0
+section .text
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+
+    ;--------------------
+
+    xor     rsi, rsi
+    dcall   xargs_append
+    cmp     rax, 0
+    jne     .out
+
+    mov     rbx, [rsp+.state]
+    inc     qword [rbx+XargsState.items]
+
+    ; -I runs the command for every item.
+    cmp     qword [rbx+XargsState.replace], 0
+    jne     .run_all
+
+    ;--------------------
+    ; Check the size limit.
+
+.check_size:
+    mov     rax, [rbx+XargsState.fixed_size]
+    add     rax, [rbx+XargsState.len]
+    cmp     rax, [rbx+XargsState.max_size]
+    jbe     .check_count
+
+    cmp     qword [rbx+XargsState.items], 1
+    je      .error_too_long
+
+    ; Run the command for the previous items, leaving this one for
+    ; the next command.
+    mov     rdi, rbx
+    mov     rsi, [rbx+XargsState.items]
+    dec     rsi
+    mov     rdx, [rbx+XargsState.item_start]
+    dcall   xargs_dispatch
+    cmp     rax, 0
+    jne     .out
+
+    ; The item must also fit on its own.
+    mov     rbx, [rsp+.state]
+    jmp     .check_size
+
+.check_count:
+    mov     rax, [rbx+XargsState.max_args]
+    cmp     rax, 0
+    je      .done
+
+    cmp     [rbx+XargsState.items], rax
+    jb      .done
+
+.run_all:
+    mov     rdi, rbx
+    mov     rsi, [rbx+XargsState.items]
+    mov     rdx, [rbx+XargsState.len]
+    dcall   xargs_dispatch
+    cmp     rax, 0
+    jne     .out
+
+    mov     rbx, [rsp+.state]
+
+.done:
+    mov     rax, [rbx+XargsState.len]
+    mov     [rbx+XargsState.item_start], rax
+
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 1
+    ret
+
+.error_too_long:
+    mov     rdi, STDERR_FD
+    mov     rsi, .too_long_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Run the command for the first items read.
+;
+; C prototype equivalent:
+;
+;     int xargs_dispatch(XargsState *state, size_t items, size_t bytes);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Input: RSI (integer) - number of items to use.
+; - Input: RDX (integer) - bytes used by the items.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - If XargsState.max_procs commands are already running, waits for
+;   one of them to finish first.
+;
+; - The item buffer is given to the job, and any remaining items are
+;   copied to a new buffer.
+;---------------------------------------------------------------------
+
+xargs_dispatch:
+section .rodata
+    .alloc_fmt      db  "xargs: out of memory",10,0
+section .text
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .items      equ     8   ; size_t: items to use.
+    .bytes      equ    16   ; size_t: bytes used by items.
+    .slot       equ    24   ; size_t: index of job.
+    .job        equ    32   ; "XargsJob *"
+    .strings    equ    40   ; "char *": strings for job.
+    .argv       equ    48   ; "char **"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.items], rsi
+    mov     [rsp+.bytes], rdx
+
+    mov     qword [rsp+.strings], 0
+    mov     qword [rsp+.argv], 0
+
+    ;--------------------
+    ; Wait for a free job.
+
+.check_running:
+    mov     rbx, [rsp+.state]
+    mov     rax, [rbx+XargsState.running]
+    cmp     rax, [rbx+XargsState.max_procs]
+    jb      .find_slot
+
+    mov     rdi, rbx
+    dcall   xargs_reap
+    cmp     rax, 0
+    jne     .out
+
+    jmp     .check_running
+
+.find_slot:
+    xor     rcx, rcx
+    lea     rdx, [rbx+XargsState.pollfds]
+
+.next_slot:
+    cmp     dword [rdx+rcx*PollFd_size+PollFd.fd], -1
+    je      .found_slot
+
+    inc     rcx
+    jmp     .next_slot
+
+.found_slot:
+    mov     [rsp+.slot], rcx
+
+    imul    rax, rcx, XargsJob_size
+    lea     rax, [rbx+XargsState.jobs+rax]
+    mov     [rsp+.job], rax
+
+    mov     [rax+XargsJob.state], rbx
+
+    ;--------------------
+    ; Get the strings for the job.
+
+    cmp     qword [rbx+XargsState.replace], 0
+    je      .take_items
+
+    mov     rdi, rbx
+    dcall   xargs_replace
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.strings], rax
+
+    mov     rbx, [rsp+.state]
+    mov     qword [rbx+XargsState.len], 0
+    mov     qword [rbx+XargsState.items], 0
+
+    mov     rcx, [rbx+XargsState.fixed_argc]
+    mov     rax, [rsp+.job]
+    mov     [rax+XargsJob.argc], rcx
+    jmp     .build_argv
+
+.take_items:
+    ; Move any remaining items to a new buffer.
+    mov     rdi, [rbx+XargsState.cap]
+    dcall   malloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     rbx, [rsp+.state]
+    mov     rcx, [rbx+XargsState.strings]
+    mov     [rsp+.strings], rcx
+    mov     [rbx+XargsState.strings], rax
+
+    mov     rdi, rax
+    mov     rsi, [rsp+.strings]
+    add     rsi, [rsp+.bytes]
+    mov     rdx, [rbx+XargsState.len]
+    sub     rdx, [rsp+.bytes]
+    mov     [rbx+XargsState.len], rdx
+    dcall   memcpy
+
+    mov     rbx, [rsp+.state]
+    mov     rax, [rsp+.items]
+    sub     [rbx+XargsState.items], rax
+
+    mov     rcx, [rbx+XargsState.fixed_argc]
+    add     rcx, rax
+    mov     rax, [rsp+.job]
+    mov     [rax+XargsJob.argc], rcx
+
+.build_argv:
+    ;--------------------
+    ; Create the argument array.
+
+    mov     rax, [rsp+.job]
+    mov     rdi, [rax+XargsJob.argc]
+    inc     rdi
+    shl     rdi, 3 ; * PTR_SIZE
+    dcall   malloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.argv], rax
+
+    mov     rbx, [rsp+.state]
+    mov     rdi, rax
+    xor     rcx, rcx ; Entries set.
+
+    ; With -I all the entries are in the strings.
+    cmp     qword [rbx+XargsState.replace], 0
+    jne     .add_strings
+
+    ; Start with the command and initial arguments.
+    mov     rsi, [rbx+XargsState.fixed_argv]
+
+.next_fixed:
+    cmp     rcx, [rbx+XargsState.fixed_argc]
+    je      .add_strings
+
+    mov     rax, [rsi+rcx*PTR_SIZE]
+    mov     [rdi+rcx*PTR_SIZE], rax
+    inc     rcx
+    jmp     .next_fixed
+
+.add_strings:
+    mov     rdx, [rsp+.job]
+    mov     rsi, [rsp+.strings]
+
+.next_string:
+    cmp     rcx, [rdx+XargsJob.argc]
+    je      .terminate
+
+    mov     [rdi+rcx*PTR_SIZE], rsi
+    inc     rcx
+
+    ; Find the start of the next string.
+.skip_string:
+    lodsb
+    cmp     al, 0
+    jne     .skip_string
+
+    jmp     .next_string
+
+.terminate:
+    mov     qword [rdi+rcx*PTR_SIZE], 0
+
+    mov     rax, [rsp+.argv]
+    mov     [rdx+XargsJob.argv], rax
+    mov     rax, [rsp+.strings]
+    mov     [rdx+XargsJob.strings], rax
+
+    ;--------------------
+    ; Start the command.
+
+    mov     rbx, [rsp+.state]
+    mov     qword [rbx+XargsState.ran], 1
+
+    mov     rdi, rbx
+    mov     rsi, [rsp+.slot]
+    dcall   xargs_start
+    cmp     rax, 0
+    jl      .free_job
+    jg      .finished
+
+    mov     rbx, [rsp+.state]
+    inc     qword [rbx+XargsState.running]
+
+    xor     rax, rax
+    jmp     .out
+
+.finished:
+    ; The command has already completed.
+    xor     rax, rax
+
+.free_job:
+    mov     [rsp+.items], rax ; Reuse as the return value.
+
+    mov     rdi, [rsp+.argv]
+    dcall   free
+
+    mov     rdi, [rsp+.strings]
+    dcall   free
+
+    mov     rax, [rsp+.items]
+
+.out:
+    epilogue_with_vars 7
+    ret
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .free_job
+
+;---------------------------------------------------------------------
+; Description: Create the arguments for -I by replacing the
+;   replacement string in the fixed arguments with the item.
+;
+; C prototype equivalent:
+;
+;     char *xargs_replace(XargsState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Output: RAX (address) - buffer containing XargsState.fixed_argc
+;   nul terminated strings (to be freed by the caller), or NULL on
+;   error.
+;---------------------------------------------------------------------
+
+xargs_replace:
+    prologue_with_vars 5
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .size       equ     8   ; size_t: bytes required.
+    .buffer     equ    16   ; "char *"
+    .i          equ    24   ; size_t: index of fixed argument.
+    .replen     equ    32   ; size_t: length of replacement string.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+
+    ;--------------------
+
+    mov     rdi, [rdi+XargsState.replace]
+    dcall   strlen
+    mov     [rsp+.replen], rax
+
+    ; Determine the size required (first pass), then create the
+    ; strings (second pass).
+    mov     qword [rsp+.buffer], 0
+
+.pass:
+    mov     qword [rsp+.size], 0
+    mov     qword [rsp+.i], 0
+
+.next_arg:
+    mov     rbx, [rsp+.state]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rbx+XargsState.fixed_argc]
+    je      .pass_done
+
+    mov     rdi, [rsp+.buffer]
+    cmp     rdi, 0
+    je      .replace_arg
+
+    add     rdi, [rsp+.size]
+
+.replace_arg:
+    mov     rsi, [rbx+XargsState.fixed_argv]
+    mov     rsi, [rsi+rax*PTR_SIZE]
+    mov     rdx, [rbx+XargsState.replace]
+    mov     rcx, [rsp+.replen]
+    mov     r8, [rbx+XargsState.strings]
+    mov     r9, [rbx+XargsState.len]
+    dec     r9 ; Remove terminator.
+    dcall   xargs_replace_arg
+
+    add     [rsp+.size], rax
+    inc     qword [rsp+.i]
+    jmp     .next_arg
+
+.pass_done:
+    cmp     qword [rsp+.buffer], 0
+    jne     .done
+
+    mov     rdi, [rsp+.size]
+    dcall   malloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.buffer], rax
+    jmp     .pass
+
+.done:
+    mov     rax, [rsp+.buffer]
+
+.out:
+    epilogue_with_vars 5
+    ret
+
+;---------------------------------------------------------------------
+; Description: Copy a string, replacing every occurrence of
+;   a substring.
+;
+; C prototype equivalent:
+;
+;     size_t xargs_replace_arg(char *dest, const char *str,
+;                              const char *old, size_t old_len,
+;                              const char *new, size_t new_len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - destination (or NULL to only calculate the
+;   size).
+; - Input: RSI (string) - string to copy.
+; - Input: RDX (string) - string to replace.
+; - Input: RCX (integer) - length of string to replace.
+; - Input: R8 (address) - replacement.
+; - Input: R9 (integer) - length of replacement.
+; - Output: RAX (integer) - bytes required (including the terminator).
+;---------------------------------------------------------------------
+
+xargs_replace_arg:
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .dest       equ     0   ; "char *"
+    .str        equ     8   ; "char *"
+    .old        equ    16   ; "char *"
+    .old_len    equ    24   ; size_t
+    .new        equ    32   ; "char *"
+    .new_len    equ    40   ; size_t
+    .size       equ    48   ; size_t: bytes required.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.dest], rdi
+    mov     [rsp+.str], rsi
+    mov     [rsp+.old], rdx
+    mov     [rsp+.old_len], rcx
+    mov     [rsp+.new], r8
+    mov     [rsp+.new_len], r9
+
+    mov     qword [rsp+.size], 0
+
+    ;--------------------
+
+.next_match:
+    mov     rdi, [rsp+.str]
+    mov     rsi, [rsp+.old]
+    dcall   strstr
+    cmp     rax, 0
+    je      .copy_rest
+
+    ; rbx = bytes before the match.
+    mov     rbx, rax
+    sub     rbx, [rsp+.str]
+
+    mov     rdi, [rsp+.dest]
+    cmp     rdi, 0
+    je      .skip_copy
+
+    ; Copy the bytes before the match, then the replacement.
+    add     rdi, [rsp+.size]
+    mov     rsi, [rsp+.str]
+    mov     rcx, rbx
+    rep     movsb
+
+    mov     rsi, [rsp+.new]
+    mov     rcx, [rsp+.new_len]
+    rep     movsb
+
+.skip_copy:
+    add     rbx, [rsp+.new_len]
+    add     [rsp+.size], rbx
+
+    ; Move past the match.
+    mov     rax, [rsp+.str]
+    add     rax, rbx
+    sub     rax, [rsp+.new_len]
+    add     rax, [rsp+.old_len]
+    mov     [rsp+.str], rax
+    jmp     .next_match
+
+.copy_rest:
+    mov     rdi, [rsp+.str]
+    dcall   strlen
+    inc     rax ; Include the terminator.
+    mov     rbx, rax
+
+    mov     rdi, [rsp+.dest]
+    cmp     rdi, 0
+    je      .done
+
+    add     rdi, [rsp+.size]
+    mov     rsi, [rsp+.str]
+    mov     rcx, rbx
+    rep     movsb
+
+.done:
+    mov     rax, [rsp+.size]
+    add     rax, rbx
+
+    epilogue_with_vars 7
+    ret
+
+;---------------------------------------------------------------------
+; Description: Start the command for a job.
+;
+; C prototype equivalent:
+;
+;     int xargs_start(XargsState *state, size_t slot);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Input: RSI (integer) - index of job (XargsJob.argv is set).
+; - Output: RAX (integer) - 0 if the command is running, 1 if it has
+;   already finished, or -1 if it could not be run.
+;
+; Notes:
+;
+; - When the command is running, the fd of the job's PollFd is set to
+;   a pidfd (for a process), or an eventfd (for an abox command).
+;
+; - If a thread cannot be created, the abox command is run by the
+;   calling thread. If the kernel does not support pidfds, the
+;   process is waited for immediately.
+;---------------------------------------------------------------------
+
+xargs_start:
+section .rodata
+    .spawn_fmt      db  "xargs: %s: %s",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .slot       equ     8   ; size_t: index of job.
+    .job        equ    16   ; "XargsJob *"
+    .status     equ    24   ; int: process exit status.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.slot], rsi
+
+    imul    rax, rsi, XargsJob_size
+    lea     rax, [rdi+XargsState.jobs+rax]
+    mov     [rsp+.job], rax
+
+    mov     qword [rax+XargsJob.started], 0
+    mov     qword [rax+XargsJob.fd], -1
+    mov     qword [rax+XargsJob.pid], 0
+    mov     qword [rax+XargsJob.ret], 0
+
+    ;--------------------
+
+    cmp     qword [rdi+XargsState.command], 0
+    je      .spawn
+
+    ;--------------------
+    ; Run the abox command in a thread.
+
+    mov     rdi, 0
+    mov     rsi, EFD_CLOEXEC
+    dcall   eventfd
+    cmp     eax, 0
+    jl      .run_inline
+
+    cdqe
+    mov     rbx, [rsp+.job]
+    mov     [rbx+XargsJob.fd], rax
+
+    lea     rdi, [rbx+XargsJob.thread]
+    xor     rsi, rsi
+    mov     rdx, xargs_builtin_thread
+    mov     rcx, rbx
+    dcall   pthread_create
+    cmp     rax, 0
+    jne     .no_thread
+
+    mov     rbx, [rsp+.job]
+    mov     qword [rbx+XargsJob.started], 1
+    mov     rax, [rbx+XargsJob.fd]
+    jmp     .running
+
+.no_thread:
+    mov     rbx, [rsp+.job]
+    mov     rdi, [rbx+XargsJob.fd]
+    dcall   close
+
+    mov     rbx, [rsp+.job]
+    mov     qword [rbx+XargsJob.fd], -1
+
+.run_inline:
+    mov     rdi, [rsp+.job]
+    dcall   xargs_builtin_thread
+
+    mov     rbx, [rsp+.job]
+    cmp     qword [rbx+XargsJob.ret], 0
+    je      .finished
+
+    jmp     .failed
+
+    ;--------------------
+    ; Run an external command.
+
+.spawn:
+    mov     rbx, [rsp+.job]
+    lea     rdi, [rbx+XargsJob.pid]
+    mov     rax, [rbx+XargsJob.argv]
+    mov     rsi, [rax]
+    xor     rdx, rdx
+    xor     rcx, rcx
+    mov     r8, rax
+    mov     r9, [abox_environ]
+    dcall   posix_spawnp
+    cmp     eax, 0
+    jne     .error_spawn
+
+    ; Note: pid_t is 32-bit.
+    mov     rbx, [rsp+.job]
+    mov     eax, [rbx+XargsJob.pid]
+    mov     [rbx+XargsJob.pid], rax
+
+    mov     rdi, SYS_pidfd_open
+    mov     rsi, rax
+    xor     rdx, rdx
+    xor     rax, rax
+    dcall   syscall
+    cmp     rax, 0
+    jl      .wait_now
+
+.running:
+    mov     rdi, [rsp+.state]
+    mov     rcx, [rsp+.slot]
+    lea     rdx, [rdi+XargsState.pollfds]
+    mov     [rdx+rcx*PollFd_size+PollFd.fd], eax
+    mov     word [rdx+rcx*PollFd_size+PollFd.revents], 0
+
+    xor     rax, rax
+    jmp     .out
+
+.wait_now:
+    ; No pidfd support, so just wait for the process.
+    mov     rbx, [rsp+.job]
+    mov     rdi, [rbx+XargsJob.pid]
+    lea     rsi, [rsp+.status]
+    dcall   xargs_waitpid
+    cmp     rax, 0
+    jne     .failed
+
+.finished:
+    mov     rax, 1
+    jmp     .out
+
+.failed:
+    mov     rax, [rsp+.state]
+    mov     qword [rax+XargsState.error], 1
+    mov     rax, 1
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.error_spawn:
+    mov     edi, eax
+    dcall   strerror
+
+    mov     rbx, [rsp+.job]
+    mov     rdx, [rbx+XargsJob.argv]
+    mov     rdx, [rdx]
+    mov     rcx, rax
+    mov     rdi, STDERR_FD
+    mov     rsi, .spawn_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, [rsp+.state]
+    mov     qword [rax+XargsState.error], 1
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Thread function that runs an abox command.
+;
+; C prototype equivalent:
+;
+;     void *xargs_builtin_thread(XargsJob *job);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsJob.
+; - Output: RAX (address) - always NULL.
+;
+; Notes:
+;
+; - Commands are serialised by XargsState.lock as they all use the
+;   same getopt state (which is reset for each command).
+;
+; - Sets XargsJob.ret and then signals XargsJob.fd (if set).
+;---------------------------------------------------------------------
+
+xargs_builtin_thread:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .job        equ     0   ; "XargsJob *"
+    .value      equ     8   ; uint64_t: eventfd value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.job], rdi
+
+    ;--------------------
+
+    mov     rax, [rdi+XargsJob.state]
+    lea     rdi, [rax+XargsState.lock]
+    dcall   pthread_mutex_lock
+
+    mov     dword [optind], 1
+
+    mov     rbx, [rsp+.job]
+    mov     rax, [rbx+XargsJob.state]
+    mov     rdi, [rax+XargsState.command]
+    mov     rsi, [rbx+XargsJob.argc]
+    mov     rdx, [rbx+XargsJob.argv]
+    dcall   handle_command
+
+    mov     rbx, [rsp+.job]
+    mov     [rbx+XargsJob.ret], rax
+
+    ; Ensure buffered output is written before the next command
+    ; runs.
+    xor     rdi, rdi
+    dcall   fflush
+
+    mov     rbx, [rsp+.job]
+    mov     rax, [rbx+XargsJob.state]
+    lea     rdi, [rax+XargsState.lock]
+    dcall   pthread_mutex_unlock
+
+    mov     rbx, [rsp+.job]
+    mov     rdi, [rbx+XargsJob.fd]
+    cmp     rdi, 0
+    jl      .out
+
+    mov     qword [rsp+.value], 1
+    lea     rsi, [rsp+.value]
+    mov     rdx, 8
+    dcall   write
+
+.out:
+    xor     rax, rax
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Wait for at least one running command to finish.
+;
+; C prototype equivalent:
+;
+;     int xargs_reap(XargsState *state);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; A command that fails sets XargsState.error.
+;---------------------------------------------------------------------
+
+xargs_reap:
+section .rodata
+    .poll_fmt       db  "xargs: poll failed",10,0
+section .text
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .slot       equ     8   ; size_t: index of job.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+
+    ;--------------------
+
+.poll:
+    mov     rbx, [rsp+.state]
+    lea     rdi, [rbx+XargsState.pollfds]
+    mov     rsi, [rbx+XargsState.max_procs]
+    mov     rdx, -1
+    dcall   poll
+    cmp     eax, 0
+    jg      .polled
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .poll
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .poll_fmt
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+.polled:
+    mov     qword [rsp+.slot], 0
+
+.next_slot:
+    mov     rbx, [rsp+.state]
+    mov     rcx, [rsp+.slot]
+    cmp     rcx, [rbx+XargsState.max_procs]
+    je      .done
+
+    lea     rdx, [rbx+XargsState.pollfds]
+    cmp     dword [rdx+rcx*PollFd_size+PollFd.fd], -1
+    je      .skip
+
+    cmp     word [rdx+rcx*PollFd_size+PollFd.revents], 0
+    je      .skip
+
+    mov     rdi, rbx
+    mov     rsi, rcx
+    dcall   xargs_finish
+
+.skip:
+    inc     qword [rsp+.slot]
+    jmp     .next_slot
+
+.done:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Collect the result of a job whose command has finished
+;   and release the job.
+;
+; C prototype equivalent:
+;
+;     void xargs_finish(XargsState *state, size_t slot);
+;
+; Parameters:
+;
+; - Input: RDI (address) - XargsState.
+; - Input: RSI (integer) - index of job.
+; - Output: None.
+;---------------------------------------------------------------------
+
+xargs_finish:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .state      equ     0   ; "XargsState *"
+    .slot       equ     8   ; size_t: index of job.
+    .job        equ    16   ; "XargsJob *"
+    .status     equ    24   ; int: process exit status.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.state], rdi
+    mov     [rsp+.slot], rsi
+
+    imul    rax, rsi, XargsJob_size
+    lea     rax, [rdi+XargsState.jobs+rax]
+    mov     [rsp+.job], rax
+
+    ;--------------------
+
+    cmp     qword [rax+XargsJob.started], 0
+    je      .wait_process
+
+    mov     rdi, [rax+XargsJob.thread]
+    xor     rsi, rsi
+    dcall   pthread_join
+
+    mov     rbx, [rsp+.job]
+    mov     rax, [rbx+XargsJob.ret]
+    jmp     .check_result
+
+.wait_process:
+    mov     rdi, [rax+XargsJob.pid]
+    lea     rsi, [rsp+.status]
+    dcall   xargs_waitpid
+
+.check_result:
+    cmp     rax, 0
+    je      .release
+
+    mov     rbx, [rsp+.state]
+    mov     qword [rbx+XargsState.error], 1
+
+.release:
+    mov     rbx, [rsp+.state]
+    mov     rcx, [rsp+.slot]
+    lea     rdx, [rbx+XargsState.pollfds]
+    mov     edi, [rdx+rcx*PollFd_size+PollFd.fd]
+    mov     dword [rdx+rcx*PollFd_size+PollFd.fd], -1
+    mov     word [rdx+rcx*PollFd_size+PollFd.revents], 0
+    dcall   close
+
+    mov     rbx, [rsp+.job]
+    mov     rdi, [rbx+XargsJob.argv]
+    dcall   free
+
+    mov     rbx, [rsp+.job]
+    mov     rdi, [rbx+XargsJob.strings]
+    dcall   free
+
+    mov     rbx, [rsp+.state]
+    dec     qword [rbx+XargsState.running]
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Wait for a process to exit.
+;
+; C prototype equivalent:
+;
+;     int xargs_waitpid(pid_t pid, int *status);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - process ID.
+; - Input: RSI (address) - location to store the wait status.
+; - Output: RAX (integer) - 0 if the process exited with status 0,
+;   else -1.
+;---------------------------------------------------------------------
+
+xargs_waitpid:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pid        equ     0   ; pid_t
+    .status     equ     8   ; "int *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.pid], rdi
+    mov     [rsp+.status], rsi
+
+    ;--------------------
+
+.wait:
+    mov     rdi, [rsp+.pid]
+    mov     rsi, [rsp+.status]
+    xor     rdx, rdx
+    dcall   waitpid
+    cmp     eax, 0
+    jg      .waited
+
+    dcall   get_errno
+    cmp     rax, EINTR
+    je      .wait
+
+    mov     rax, -1
+    jmp     .out
+
+.waited:
+    ; The status is zero only if the process exited normally with
+    ; status 0.
+    mov     rax, [rsp+.status]
+    mov     eax, [rax]
+    and     eax, 0xffff
+    jz      .out
+
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 2
+    ret
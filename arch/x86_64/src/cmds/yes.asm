@@ -10,7 +10,6 @@ global command_help_yes
 global command_yes
 
 extern close
-extern free
 extern write
 
 extern alloc_args_buffer
@@ -19,7 +18,7 @@ extern print_nl
 
 %include "header.inc"
 
-section .rodata
+cold_rodata
 command_help_yes:   db  "see yes(1)",0
 
 section .text
@@ -53,7 +52,10 @@ section .text
 ;           arguments into it with the delimiters.
 ;
 ; Option 4: Iterate over the argv array and build up a buffer dynamically
-;           using asprintf(3). This implementation uses this approach.
+;           using asprintf(3).
+;
+; This implementation uses option 3, with the buffer allocated from the
+; arena (so there is nothing to free when the command is killed).
 ;---------------------------------------------------------------------
 
 command_yes:
@@ -124,11 +126,6 @@ section .text
     dcall   write
     jmp     .write_custom_output
 
-    ; Deallocate
-    ; TODO: FIXME: never called - use atexit/sigaction to clean up on signal?
-    mov     rdi, [rsp+.buf]
-    dcall   free
-
 .write_default_output:
     mov     rdi, STDOUT_FD
     mov     rsi, .default_msg
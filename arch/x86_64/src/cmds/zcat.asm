@@ -0,0 +1,657 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+global command_help_zcat
+global command_zcat
+
+extern arena_alloc
+extern asm_getopt
+extern inflate_byte
+extern inflate_init
+extern inflate_input
+extern inflate_stream
+
+extern close
+extern dprintf
+extern open
+
+extern optind
+
+%include "header.inc"
+%include "inflate.inc"
+
+cold_rodata
+command_help_zcat:  db  "see zcat(1)",10, \
+                        10, \
+                        "Usage: zcat [FILE]...",10, \
+                        10, \
+                        "Decompress gzip files to standard output.",10, \
+                        "With no FILE, or when FILE is -, read standard input.",0
+
+;---------------------------------------------------------------------
+; gzip (RFC 1952) member header.
+
+%assign GZIP_ID1                0x1f
+%assign GZIP_ID2                0x8b
+%assign GZIP_CM_DEFLATE         8
+
+; Header flags.
+%assign GZIP_FHCRC              (1 << 1)
+%assign GZIP_FEXTRA             (1 << 2)
+%assign GZIP_FNAME              (1 << 3)
+%assign GZIP_FCOMMENT           (1 << 4)
+%assign GZIP_FRESERVED          0xe0
+
+; Bytes of MTIME, XFL and OS.
+%assign GZIP_FIXED_FIELDS       6
+
+; Value returned by zcat_file() when no more files should be
+; processed.
+%assign ZCAT_FATAL              -2
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Decompress gzip files to stdout.
+;---------------------------------------------------------------------
+
+command_zcat:
+section .rodata
+    .optstring          db  "",0
+    .stdin_path         db  "-",0
+cold_rodata
+    .nomem_msg          db  "zcat: cannot allocate memory",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .argc           equ      0  ; int.
+    .argv           equ      8  ; "char **"
+    .inf            equ     16  ; "Inflate *"
+    .ret            equ     24  ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.argc], rdi
+    mov     [rsp+.argv], rsi
+
+    mov     qword [rsp+.ret], CMD_OK
+
+    ;--------------------
+
+.next_arg:
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
+    mov     rdx, .optstring
+
+    ; Note: No call to consume_program_name as
+    ; getopt expects to find argc+argv unmolested!
+    dcall   asm_getopt
+
+    cmp     eax, -1 ; End of options
+    jz      .options_parsed
+
+    cmp     ax, '--' ; End of options
+    jz      .options_parsed
+
+    ; There are no options.
+    jmp     .error_bad_option
+
+.options_parsed:
+    mov     rdi, Inflate_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_nomem
+
+    mov     [rsp+.inf], rax
+
+    mov     rdi, rax
+    mov     rsi, STDOUT_FD
+    dcall   inflate_init
+    cmp     rax, 0
+    jne     .error_nomem
+
+    mov     eax, [optind]
+    cdqe
+
+    cmp     rax, [rsp+.argc]
+    jb      .next_file
+
+    ; No files so use stdin.
+    mov     rdi, [rsp+.inf]
+    mov     rsi, .stdin_path
+    dcall   zcat_file
+    cmp     rax, 0
+    je      .out
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.next_file:
+    mov     rdx, [rsp+.argv]
+    mov     rsi, [rdx+rax*PTR_SIZE]
+    mov     rdi, [rsp+.inf]
+    dcall   zcat_file
+    cmp     rax, 0
+    je      .file_done
+
+    mov     qword [rsp+.ret], CMD_FAILED
+
+    cmp     rax, ZCAT_FATAL
+    je      .out
+
+.file_done:
+    inc     dword [optind]
+    mov     eax, [optind]
+    cdqe
+    cmp     rax, [rsp+.argc]
+    jb      .next_file
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_nomem:
+    mov     rdi, STDERR_FD
+    mov     rsi, .nomem_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], CMD_FAILED
+    jmp     .out
+
+.error_bad_option:
+    mov     qword [rsp+.ret], CMD_BAD_OPT
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Decompress all the gzip members in a file to stdout.
+;
+; C prototype equivalent:
+;
+;     int zcat_file(Inflate *inf, const char *path);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Input: RSI (string) - file path ("-" means stdin).
+; - Output: RAX (integer) - 0 on success, -1 on error, or ZCAT_FATAL
+;   if the output could not be written.
+;
+; Notes:
+;
+; - Like gzip(1), a file may contain any number of members (for
+;   example created by concatenating gzip files) and the output is the
+;   concatenation of their data. Zero bytes after the last member
+;   (such as tape padding) are ignored.
+;
+; - The data decoded before an error is still written.
+;
+; Limitations:
+;
+; - The header CRC (FHCRC) is not checked.
+;
+; See: RFC 1952.
+;---------------------------------------------------------------------
+
+zcat_file:
+section .rodata
+    .stdin_name     db  "stdin",0
+cold_rodata
+    .open_fmt       db  "zcat: %s: cannot open file",10,0
+    .format_fmt     db  "zcat: %s: not in gzip format",10,0
+    .method_fmt     db  "zcat: %s: unknown method %d -- not supported",10,0
+    .flags_fmt      db  "zcat: %s: has flags 0x%x -- not supported",10,0
+    .eof_fmt        db  "zcat: %s: unexpected end of file",10,0
+    .invalid_fmt    db  "zcat: %s: invalid compressed data--format violated",10,0
+    .crc_fmt        db  "zcat: %s: invalid compressed data--crc error",10,0
+    .length_fmt     db  "zcat: %s: invalid compressed data--length error",10,0
+    .garbage_fmt    db  "zcat: %s: decompression OK, trailing garbage ignored",10,0
+    .read_fmt       db  "zcat: %s: read error",10,0
+    .write_msg      db  "zcat: write error",10,0
+section .text
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .inf        equ     0   ; "Inflate *"
+    .path       equ     8   ; "char *"
+    .name       equ    16   ; "char *": name to display.
+    .fd         equ    24   ; int.
+    .members    equ    32   ; size_t: members decompressed.
+    .flags      equ    40   ; uint8_t: header flags.
+    .ret        equ    48   ; int: return value.
+
+    ;--------------------
+
+    mov     [rsp+.inf], rdi
+    mov     [rsp+.path], rsi
+    mov     [rsp+.name], rsi
+
+    mov     qword [rsp+.members], 0
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Handle the stdin alias.
+
+    mov     qword [rsp+.fd], STDIN_FD
+
+    cmp     byte [rsi], '-'
+    jne     .open_file
+
+    cmp     byte [rsi+1], 0
+    jne     .open_file
+
+    mov     qword [rsp+.name], .stdin_name
+    jmp     .opened
+
+.open_file:
+    mov     rdi, rsi
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+.opened:
+    mov     rdi, [rsp+.inf]
+    mov     rsi, [rsp+.fd]
+    dcall   inflate_input
+
+.next_member:
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, INFLATE_ERR_EOF
+    je      .at_eof
+
+    cmp     rax, 0
+    jl      .error_result
+
+    cmp     qword [rsp+.members], 0
+    je      .check_magic
+
+    cmp     rax, 0
+    je      .skip_zeros
+
+.check_magic:
+    cmp     rax, GZIP_ID1
+    jne     .not_gzip
+
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, 0
+    jl      .error_result
+
+    cmp     rax, GZIP_ID2
+    jne     .not_gzip
+
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, 0
+    jl      .error_result
+
+    cmp     rax, GZIP_CM_DEFLATE
+    jne     .error_method
+
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, 0
+    jl      .error_result
+
+    mov     [rsp+.flags], rax
+
+    test    rax, GZIP_FRESERVED
+    jnz     .error_flags
+
+    mov     rdi, [rsp+.inf]
+    mov     rsi, GZIP_FIXED_FIELDS
+    dcall   zcat_skip
+    cmp     rax, 0
+    jl      .error_result
+
+    ;--------------------
+    ; Optional fields.
+
+    test    qword [rsp+.flags], GZIP_FEXTRA
+    jz      .no_extra
+
+    mov     rdi, [rsp+.inf]
+    mov     rsi, 2
+    dcall   zcat_le
+    cmp     rax, 0
+    jl      .error_result
+
+    mov     rdi, [rsp+.inf]
+    mov     rsi, rax
+    dcall   zcat_skip
+    cmp     rax, 0
+    jl      .error_result
+
+.no_extra:
+    test    qword [rsp+.flags], GZIP_FNAME
+    jz      .no_name
+
+    mov     rdi, [rsp+.inf]
+    dcall   zcat_skip_string
+    cmp     rax, 0
+    jl      .error_result
+
+.no_name:
+    test    qword [rsp+.flags], GZIP_FCOMMENT
+    jz      .no_comment
+
+    mov     rdi, [rsp+.inf]
+    dcall   zcat_skip_string
+    cmp     rax, 0
+    jl      .error_result
+
+.no_comment:
+    test    qword [rsp+.flags], GZIP_FHCRC
+    jz      .no_header_crc
+
+    mov     rdi, [rsp+.inf]
+    mov     rsi, 2
+    dcall   zcat_skip
+    cmp     rax, 0
+    jl      .error_result
+
+.no_header_crc:
+    ;--------------------
+    ; Compressed data.
+
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_stream
+    cmp     rax, 0
+    jl      .error_result
+
+    ;--------------------
+    ; Trailer: CRC32 and ISIZE (the size modulo 2^32).
+
+    mov     rdi, [rsp+.inf]
+    mov     rsi, 4
+    dcall   zcat_le
+    cmp     rax, 0
+    jl      .error_result
+
+    mov     rdx, [rsp+.inf]
+    mov     ecx, [rdx+Inflate.crc]
+    not     ecx
+    cmp     eax, ecx
+    jne     .error_crc
+
+    mov     rdi, [rsp+.inf]
+    mov     rsi, 4
+    dcall   zcat_le
+    cmp     rax, 0
+    jl      .error_result
+
+    mov     rdx, [rsp+.inf]
+    cmp     eax, [rdx+Inflate.size]
+    jne     .error_length
+
+    inc     qword [rsp+.members]
+    jmp     .next_member
+
+.skip_zeros:
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, INFLATE_ERR_EOF
+    je      .done
+
+    cmp     rax, 0
+    jl      .error_result
+    je      .skip_zeros
+
+    mov     rsi, .garbage_fmt
+    jmp     .error_report
+
+.at_eof:
+    ; An empty file is not a valid gzip file.
+    cmp     qword [rsp+.members], 0
+    jne     .done
+
+    mov     rsi, .eof_fmt
+    jmp     .error_report
+
+.not_gzip:
+    ; Something other than a member after the first one.
+    cmp     qword [rsp+.members], 0
+    je      .error_format
+
+    mov     rsi, .garbage_fmt
+    jmp     .error_report
+
+.error_format:
+    mov     rsi, .format_fmt
+    jmp     .error_report
+
+.error_method:
+    mov     rdi, STDERR_FD
+    mov     rsi, .method_fmt
+    mov     rdx, [rsp+.name]
+    mov     rcx, rax
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .failed
+
+.error_flags:
+    mov     rdi, STDERR_FD
+    mov     rsi, .flags_fmt
+    mov     rdx, [rsp+.name]
+    mov     rcx, rax
+    xor     rax, rax
+    dcall   dprintf
+    jmp     .failed
+
+.error_crc:
+    mov     rsi, .crc_fmt
+    jmp     .error_report
+
+.error_length:
+    mov     rsi, .length_fmt
+    jmp     .error_report
+
+.error_result:
+    ; Report an INFLATE_ERR_* value.
+    cmp     rax, INFLATE_ERR_WRITE
+    je      .error_write
+
+    mov     rsi, .invalid_fmt
+    cmp     rax, INFLATE_ERR_FORMAT
+    je      .error_report
+
+    mov     rsi, .eof_fmt
+    cmp     rax, INFLATE_ERR_EOF
+    je      .error_report
+
+    mov     rsi, .read_fmt
+
+.error_report:
+    mov     rdi, STDERR_FD
+    mov     rdx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+.failed:
+    mov     qword [rsp+.ret], -1
+
+.done:
+    cmp     qword [rsp+.fd], STDIN_FD
+    je      .closed
+
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.closed:
+    mov     rax, [rsp+.ret]
+
+.out:
+    epilogue_with_vars 7
+    ret
+
+.error_write:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_msg
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], ZCAT_FATAL
+    jmp     .done
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rsp+.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Read a little-endian value.
+;
+; C prototype equivalent:
+;
+;     int64_t zcat_le(Inflate *inf, size_t bytes);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Input: RSI (integer) - number of bytes (at most 4).
+; - Output: RAX (integer) - value, or INFLATE_ERR_*.
+;---------------------------------------------------------------------
+
+zcat_le:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .inf        equ     0   ; "Inflate *"
+    .bytes      equ     8   ; size_t: bytes remaining.
+    .value      equ    16   ; uint32_t.
+    .shift      equ    24   ; size_t: bit position of next byte.
+
+    ;--------------------
+
+    mov     [rsp+.inf], rdi
+    mov     [rsp+.bytes], rsi
+    mov     qword [rsp+.value], 0
+    mov     qword [rsp+.shift], 0
+
+.next_byte:
+    cmp     qword [rsp+.bytes], 0
+    je      .done
+
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, 0
+    jl      .out
+
+    mov     rcx, [rsp+.shift]
+    shl     rax, cl
+    or      [rsp+.value], rax
+
+    add     qword [rsp+.shift], 8
+    dec     qword [rsp+.bytes]
+    jmp     .next_byte
+
+.done:
+    mov     rax, [rsp+.value]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Skip the specified number of input bytes.
+;
+; C prototype equivalent:
+;
+;     int zcat_skip(Inflate *inf, size_t bytes);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Input: RSI (integer) - number of bytes.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_*.
+;---------------------------------------------------------------------
+
+zcat_skip:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .inf        equ     0   ; "Inflate *"
+    .bytes      equ     8   ; size_t: bytes remaining.
+
+    ;--------------------
+
+    mov     [rsp+.inf], rdi
+    mov     [rsp+.bytes], rsi
+
+.next_byte:
+    xor     eax, eax
+    cmp     qword [rsp+.bytes], 0
+    je      .out
+
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, 0
+    jl      .out
+
+    dec     qword [rsp+.bytes]
+    jmp     .next_byte
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Skip a nul-terminated string.
+;
+; C prototype equivalent:
+;
+;     int zcat_skip_string(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_*.
+;---------------------------------------------------------------------
+
+zcat_skip_string:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .inf        equ     0   ; "Inflate *"
+
+    ;--------------------
+
+    mov     [rsp+.inf], rdi
+
+.next_byte:
+    mov     rdi, [rsp+.inf]
+    dcall   inflate_byte
+    cmp     rax, 0
+    jg      .next_byte
+
+    epilogue_with_vars 1
+    ret
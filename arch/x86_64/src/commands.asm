@@ -7,6 +7,8 @@
 ;---------------------------------------------------------------------
 
 global get_and_handle_command
+global get_command
+global handle_command
 global list_commands
 
 %include "header.inc"
@@ -16,11 +18,13 @@ extern printf
 extern strcmp
 extern write
 
+extern arena_mark
+extern arena_release
 extern commands
 extern commands_count
 extern handle_version
 
-section .text
+hot_text startup
 
 ;---------------------------------------------------------------------
 ; Description: Determine the Command from argv and run it's handler.
@@ -39,10 +43,10 @@ section .text
 ;---------------------------------------------------------------------
 
 get_and_handle_command:
-section .rodata
+cold_rodata
     .errInvalidCmd       db  "ERROR: invalid command",10
     .errInvalidCmd_len   equ $-.errInvalidCmd
-section .text
+hot_text startup
     prologue_with_vars 3
 
     ;--------------------
@@ -122,6 +126,8 @@ section .text
     epilogue_with_vars 3
     ret
 
+cold_text
+
 .error_cmd_name_invalid:
     mov     rdi, STDERR_FD
     mov     rsi, .errInvalidCmd
@@ -131,6 +137,8 @@ section .text
     mov     rax, CMD_INVALID
     jmp     .out
 
+hot_text startup
+
 ;---------------------------------------------------------------------
 ; Description: Execute the handler for the specified Command.
 ;
@@ -164,6 +172,9 @@ section .text
 ;
 ; Notes:
 ;
+; - Memory the Command allocates from the arena (see arena.asm) is
+;   released when the Command returns.
+;
 ; - This function handles displaying the appropriate error message for
 ;   most of the command error scenarios listed above.
 ;
@@ -189,7 +200,7 @@ section .text
 ;---------------------------------------------------------------------
 
 handle_command:
-section .rodata
+cold_rodata
     .errBadCmd            db  "ERROR: invalid command",10
     .errBadCmd_len        equ $-.errBadCmd
 
@@ -212,23 +223,51 @@ section .rodata
     .errBadCmdArg         db  "ERROR: invalid command argument",10
     .errBadCmdArg_len     equ $-.errBadCmdArg
 
-section .text
-    prologue_with_vars 0
+hot_text startup
+    prologue_with_vars 5
+
+    ;--------------------
+    ; Stack offsets.
+
+    .command    equ     0   ; "Command *"
+    .argc       equ     8   ; size_t.
+    .argv       equ    16   ; "char **"
+    .mark       equ    24   ; "void *": arena state before the command.
+    .ret        equ    32   ; int: value returned by the command.
+
+    ;--------------------
 
     cmp     rdi, 0
     je     .error_invalid_cmd
 
+    ; Save args
+    mov     [rsp+.command], rdi
+    mov     [rsp+.argc], rsi
+    mov     [rsp+.argv], rdx
+
+    dcall   arena_mark
+    mov     [rsp+.mark], rax
+
     ; Load the handler address
-    mov     rax, [rdi+Command.func]
+    mov     rax, [rsp+.command]
+    mov     rax, [rax+Command.func]
 
     ; Arrange the arguments for the handler.
-    mov     rdi, rsi
-    mov     rsi, rdx
+    mov     rdi, [rsp+.argc]
+    mov     rsi, [rsp+.argv]
 
     ; Call the Command handler
 
     dcall   rax
 
+    mov     [rsp+.ret], rax
+
+    ; Release the memory used by the Command.
+    mov     rdi, [rsp+.mark]
+    dcall   arena_release
+
+    mov     rax, [rsp+.ret]
+
     cmp     rax, CMD_OK
     je      .success
 
@@ -260,9 +299,11 @@ section .text
     mov     rax, 0
 
 .out:
-    epilogue_with_vars 0
+    epilogue_with_vars 5
     ret
 
+cold_text
+
 .error_invalid_cmd:
     mov     rdi, STDERR_FD
     mov     rsi, .errBadCmd
@@ -317,13 +358,15 @@ section .text
     mov     rax, CMD_BAD_ARG
     jmp     .out
 
+hot_text startup
+
 .error:
 .error_cmd_failed:
     mov     rax, CMD_FAILED
     jmp     .out
 
 ;---------------------------------------------------------------------
-; Description: .
+; Description: Find the Command with the specified name.
 ;
 ; C prototype equivalent:
 ;
@@ -418,6 +461,8 @@ get_command:
 ;
 ;---------------------------------------------------------------------
 
+cold_text
+
 list_commands:
     prologue_with_vars 2
 
@@ -482,12 +527,15 @@ list_commands:
 ; this function can immediately exit.
 ;---------------------------------------------------------------------
 
+hot_text startup
+
 handle_cmd_help:
-section .rodata
+hot_rodata
     .short_help_opt     equ  '-h'
     .long_help_opt      db   "--help",0
+cold_rodata
     .fmt                db   "Usage: %s",10,0
-section .text
+hot_text startup
     prologue_with_vars 1
 
     ;--------------------
@@ -525,6 +573,8 @@ section .text
     epilogue_with_vars 1
     ret
 
+cold_text
+
 .show_cmd_help:
     mov     rdi, .fmt
     mov     rax, [rsp+.command]
@@ -36,7 +36,8 @@ extern show_version
 ;---------------------------------------------------------------------
 ; Constants
 
-section .rodata
+; Only used when handling options (rather than commands).
+cold_rodata
     short_help_opt      equ '-h'
     long_help_opt       db  "--help",0
 
@@ -55,6 +56,7 @@ section .rodata
     "   or: %s [-l, --list]",10, \
     "   or: %s [-v, --version]",10,0
 
+hot_rodata
     ; Used for commands like cat(1) and head(1).
     stdin_alias    db  "-",0
 
@@ -78,7 +80,7 @@ section .bss
 
 ;---------------------------------------------------------------------
 
-section .text
+hot_text startup
 
 ;---------------------------------------------------------------------
 ; Description: Entry point.
@@ -167,13 +169,18 @@ main:
 
     jmp     .call_handle_command
 
+    ;------------------------------------------------------------
+    ; Option handling (cold).
+
+cold_text
+
     ; Handle the help option on behalf of the Command
     ; as a convenience.
     ; FIXME: this should be handled by calling handle_cmd_help!
 .handle_command_help:
-section .rodata
+cold_rodata
     .help_fmt     db "Usage: %s",10,0
-section .text
+cold_text
 
     mov     rax, [command]
     mov     rdi, .help_fmt
@@ -233,6 +240,8 @@ section .text
 
     jmp     .errInvalidOption
 
+hot_text startup
+
 .success:
     mov     rdi, EXIT_SUCCESS
 
@@ -295,6 +304,8 @@ section .text
 
     jmp     .call_handle_command
 
+cold_text
+
 .errInvalidOption:
     mov     rdi, STDERR_FD
     mov     rsi, errInvalidOpt
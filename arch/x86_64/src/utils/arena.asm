@@ -0,0 +1,418 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+; Description: A bump (arena) allocator for memory used by commands.
+;
+; Memory is taken from large chunks allocated with mmap(2) by simply
+; advancing a pointer, so an allocation has no header and takes no
+; lock. Memory is not returned to the arena individually: instead,
+; everything allocated after an arena_mark() call is released by a
+; single arena_release() call. handle_command() does this around each
+; command, so a command need not free what it allocates.
+;
+; Blocks that a long running loop no longer needs can be passed to
+; arena_free() which puts them on a free list for reuse by later
+; allocations of a similar size.
+;
+; Notes:
+;
+; - The arena is not thread-safe: it must only be used by one thread
+;   at a time.
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global arena_alloc
+global arena_alloc_aligned
+global arena_free
+global arena_mark
+global arena_release
+
+extern mmap
+extern munmap
+
+; Size of a chunk (allocations bigger than this get a chunk of their
+; own).
+%assign ARENA_CHUNK_SIZE        (256 * 1024)
+
+; Minimum (and default) alignment of an allocation.
+%assign ARENA_MIN_ALIGN         16
+
+; Number of free lists. List n holds blocks of at least (1 << n)
+; bytes.
+%assign ARENA_FREE_LISTS        48
+
+;---------------------------------------------------------------------
+; Header at the start of each chunk.
+;---------------------------------------------------------------------
+struc ArenaChunk
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .prev       resq    1 ; "ArenaChunk *": previously allocated chunk.
+    .size       resq    1 ; size_t: bytes mapped (including header).
+endstruc
+
+section .bss
+    arena_chunk         resq    1   ; "ArenaChunk *": current chunk.
+    arena_ptr           resq    1   ; "char *": next free byte.
+    arena_end           resq    1   ; "char *": end of current chunk.
+
+    ; Heads of the free lists. The first 8 bytes of a free block
+    ; point to the next block in the list.
+    arena_free_lists    resq    ARENA_FREE_LISTS
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Allocate memory from the arena.
+;
+; C prototype equivalent:
+;
+;     void *arena_alloc(size_t size);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - number of bytes required.
+; - Output: RAX (address) - ARENA_MIN_ALIGN aligned memory, or NULL
+;   on error.
+;
+; Notes:
+;
+; The memory is not cleared (although memory that has not been used
+; before is zero since it comes straight from mmap(2)).
+;---------------------------------------------------------------------
+
+arena_alloc:
+    prologue_with_vars 0
+
+    mov     rsi, ARENA_MIN_ALIGN
+    dcall   arena_alloc_aligned
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Allocate aligned memory from the arena.
+;
+; C prototype equivalent:
+;
+;     void *arena_alloc_aligned(size_t size, size_t alignment);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - number of bytes required.
+; - Input: RSI (integer) - alignment (a power of two). Values below
+;   ARENA_MIN_ALIGN are treated as ARENA_MIN_ALIGN.
+; - Output: RAX (address) - aligned memory, or NULL on error.
+;
+; Notes:
+;
+; - Page aligned buffers (alignment PAGE_SIZE) are suitable for I/O.
+;
+; - Blocks on the free lists are only used for ARENA_MIN_ALIGN
+;   allocations. A free block of at least the next power of two is
+;   used, so any block on the list is big enough.
+;---------------------------------------------------------------------
+
+arena_alloc_aligned:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .size       equ     0   ; size_t: bytes required.
+    .align      equ     8   ; size_t: alignment.
+    .chunk_size equ    16   ; size_t: bytes to map for a new chunk.
+
+    ;--------------------
+    ; Round the size up to the minimum alignment (this also ensures
+    ; a block is big enough to be put on a free list).
+
+    add     rdi, (ARENA_MIN_ALIGN - 1)
+    jc      .error
+    and     rdi, ~(ARENA_MIN_ALIGN - 1)
+    jnz     .size_ok
+
+    mov     rdi, ARENA_MIN_ALIGN
+
+.size_ok:
+    mov     [rsp+.size], rdi
+
+    cmp     rsi, ARENA_MIN_ALIGN
+    jae     .align_ok
+
+    mov     rsi, ARENA_MIN_ALIGN
+
+.align_ok:
+    mov     [rsp+.align], rsi
+
+    cmp     rsi, ARENA_MIN_ALIGN
+    jne     .bump
+
+    ;--------------------
+    ; Check the free list for the next power of two.
+
+    ; list = ceil(log2(size))
+    mov     rcx, rdi
+    dec     rcx
+    bsr     rcx, rcx
+    inc     rcx
+
+    cmp     rcx, ARENA_FREE_LISTS
+    jae     .bump
+
+    mov     rax, [arena_free_lists+rcx*8]
+    cmp     rax, 0
+    je      .bump
+
+    ; Unlink the block.
+    mov     rdx, [rax]
+    mov     [arena_free_lists+rcx*8], rdx
+    jmp     .out
+
+.bump:
+    ;--------------------
+    ; Allocate from the current chunk if possible.
+
+    mov     rax, [arena_ptr]
+    cmp     rax, 0
+    je      .new_chunk
+
+    ; Align the pointer.
+    mov     rcx, [rsp+.align]
+    dec     rcx
+    add     rax, rcx
+    not     rcx
+    and     rax, rcx
+
+    mov     rdx, rax
+    add     rdx, [rsp+.size]
+    jc      .new_chunk
+    cmp     rdx, [arena_end]
+    ja      .new_chunk
+
+    mov     [arena_ptr], rdx
+    jmp     .out
+
+.new_chunk:
+    ;--------------------
+    ; chunk_size = max(ARENA_CHUNK_SIZE,
+    ;                  round_up(header + align + size, PAGE_SIZE))
+
+    mov     rax, [rsp+.size]
+    add     rax, [rsp+.align]
+    jc      .error
+    add     rax, (ArenaChunk_size + PAGE_SIZE - 1)
+    jc      .error
+    and     rax, ~(PAGE_SIZE - 1)
+
+    cmp     rax, ARENA_CHUNK_SIZE
+    jae     .map
+
+    mov     rax, ARENA_CHUNK_SIZE
+
+.map:
+    mov     [rsp+.chunk_size], rax
+
+    mov     rdi, 0 ; Let the kernel choose the address.
+    mov     rsi, rax
+    mov     rdx, (PROT_READ|PROT_WRITE)
+    mov     rcx, (MAP_PRIVATE|MAP_ANONYMOUS)
+    mov     r8, -1 ; No file.
+    mov     r9, 0 ; offset.
+    dcall   mmap
+    cmp     rax, MAP_FAILED
+    je      .error
+
+    ; Link the chunk and make it the current one.
+    mov     rcx, [arena_chunk]
+    mov     [rax+ArenaChunk.prev], rcx
+    mov     rcx, [rsp+.chunk_size]
+    mov     [rax+ArenaChunk.size], rcx
+    mov     [arena_chunk], rax
+
+    lea     rdx, [rax+rcx]
+    mov     [arena_end], rdx
+
+    lea     rdx, [rax+ArenaChunk_size]
+    mov     [arena_ptr], rdx
+    jmp     .bump
+
+.out:
+    epilogue_with_vars 3
+    ret
+
+.error:
+    mov     rax, 0
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Return a block to the arena for reuse.
+;
+; C prototype equivalent:
+;
+;     void arena_free(void *ptr, size_t size);
+;
+; Parameters:
+;
+; - Input: RDI (address) - block returned by arena_alloc() (or NULL).
+; - Input: RSI (integer) - size specified when the block was
+;   allocated.
+; - Output: None.
+;
+; Notes:
+;
+; - Calling this function is optional: all blocks are released by
+;   arena_release() anyway.
+;
+; - The block is added to the free list for the largest power of two
+;   that is not bigger than the block.
+;---------------------------------------------------------------------
+
+arena_free:
+    prologue_with_vars 0
+
+    cmp     rdi, 0
+    je      .out
+
+    ; The allocated size was rounded up to ARENA_MIN_ALIGN.
+    add     rsi, (ARENA_MIN_ALIGN - 1)
+    and     rsi, ~(ARENA_MIN_ALIGN - 1)
+    jz      .out
+
+    ; list = floor(log2(size))
+    bsr     rcx, rsi
+
+    cmp     rcx, ARENA_FREE_LISTS
+    jae     .out
+
+    mov     rax, [arena_free_lists+rcx*8]
+    mov     [rdi], rax
+    mov     [arena_free_lists+rcx*8], rdi
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Return a value representing the current state of the
+;   arena, for use with arena_release().
+;
+; C prototype equivalent:
+;
+;     void *arena_mark(void);
+;
+; Parameters:
+;
+; - Output: RAX (address) - mark.
+;---------------------------------------------------------------------
+
+arena_mark:
+    prologue_with_vars 0
+
+    mov     rax, [arena_ptr]
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Release all the memory allocated since the specified
+;   mark.
+;
+; C prototype equivalent:
+;
+;     void arena_release(void *mark);
+;
+; Parameters:
+;
+; - Input: RDI (address) - value returned by arena_mark().
+; - Output: None.
+;
+; Notes:
+;
+; - Marks can be nested: releasing a mark also releases any later
+;   marks.
+;
+; - Chunks allocated since the mark are unmapped, except that the
+;   first chunk is always kept (but emptied), so that later commands
+;   do not need to map it again.
+;
+; - The free lists are emptied since they may hold blocks allocated
+;   after the mark.
+;---------------------------------------------------------------------
+
+arena_release:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .mark       equ     0   ; "char *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.mark], rdi
+
+    ;--------------------
+
+    mov     rdi, arena_free_lists
+    mov     rcx, ARENA_FREE_LISTS
+    xor     rax, rax
+    rep     stosq
+
+.next_chunk:
+    mov     rbx, [arena_chunk]
+    cmp     rbx, 0
+    je      .out
+
+    ; Is the mark in this chunk?
+    mov     rax, [rsp+.mark]
+    lea     rcx, [rbx+ArenaChunk_size]
+    cmp     rax, rcx
+    jb      .not_here
+
+    mov     rcx, [rbx+ArenaChunk.size]
+    add     rcx, rbx
+    cmp     rax, rcx
+    ja      .not_here
+
+    mov     [arena_ptr], rax
+    jmp     .out
+
+.not_here:
+    cmp     qword [rbx+ArenaChunk.prev], 0
+    jne     .unmap
+
+    ; Keep the first chunk.
+    lea     rax, [rbx+ArenaChunk_size]
+    mov     [arena_ptr], rax
+    jmp     .out
+
+.unmap:
+    mov     rax, [rbx+ArenaChunk.prev]
+    mov     [arena_chunk], rax
+
+    mov     rcx, [rax+ArenaChunk.size]
+    add     rcx, rax
+    mov     [arena_end], rcx
+
+    mov     rdi, rbx
+    mov     rsi, [rbx+ArenaChunk.size]
+    dcall   munmap
+
+    jmp     .next_chunk
+
+.out:
+    epilogue_with_vars 1
+    ret
@@ -11,11 +11,9 @@
 global alloc_args_buffer
 global argv_bytes
 
+extern arena_alloc
 extern asm_strlen
 
-extern calloc
-extern stpcpy
-
 ;---------------------------------------------------------------------
 ; Description: Count total number of bytes in argv array.
 ;
@@ -100,7 +98,8 @@ argv_bytes:
 ;
 ; Notes:
 ;
-; - The caller is responsible for freeing the allocated bytes.
+; - The buffer is allocated from the arena, so is released when the
+;   command returns (see arena_release()).
 ; - On success, the RDX register will contain an updated count of the
 ;   number of bytes in the returned buffer (including the separator
 ;   characters and the newline character (but not the trailing null
@@ -198,56 +197,45 @@ alloc_args_buffer:
 
     inc     rdi ; Now, add space for the terminating byte.
 
-    mov     rsi, 1 ; sizeof(char)
-    dcall   calloc
+    dcall   arena_alloc
     cmp     rax, 0
     je      .error
 
     mov     [rsp+.buf], rax ; Save address.
     mov     [rsp+.p], rax   ; Set p = address.
 
-    ; Fill the buffer with spaces. This is inefficient as we
-    ; only need a single space between each arg,
-    ; but it keeps the logic simple.
-    mov     eax, .sep
-
-    mov     rax, [rsp+.bytes]
-    mov     rcx, [rax] ; Dereference int pointer.
-
-    ; Reduce the byte count to avoid overwriting the newline and
-    ; the terminating null.
-    sub     rcx, 2
-
-    mov     rdi, [rsp+.p]
-    rep     stosb
+    ; Add the terminating null (the arena memory may have been used
+    ; before, so every byte must be written).
+    mov     rdi, rax
+    mov     rdx, [rsp+.bytes]
+    add     rdi, [rdx]
+    mov     byte [rdi], 0
 
 .next_arg:
     cmp     qword [rsp+.argc], 0 ; Any arguments remaining?
     je      .done  ; No, so exit.
 
-    ; Set destination
-    mov     rdi, [rsp+.p]
-
     ; Get next argv[n] value.
     mov     rax, [rsp+.argv]
+    mov     rdi, [rax]
+    dcall   asm_strlen
 
-    ; Set source
+    ; Copy the argument string from argv into the buffer, followed
+    ; by a separator (which is written even if the argument is
+    ; empty).
+    mov     rcx, rax
+    mov     rdi, [rsp+.p]
+    mov     rax, [rsp+.argv]
     mov     rsi, [rax]
+    rep     movsb
 
-    ; Copy the argument string from argv into the buffer
-    ; that we've filled with spaces.
-    dcall    stpcpy
-
-    ; Overwrite the null with the separator.
-    mov     byte [rax], .sep
-    inc     rax ; Jump over the separator.
+    mov     byte [rdi], .sep
+    inc     rdi
 
     ;------------------------------
     ; Update values
 
-    ; stpcpy(3) returns the address of the trailing nul terminator,
-    ; so set the pointer, to that value to move along the buffer.
-    mov     [rsp+.p], rax
+    mov     [rsp+.p], rdi
 
     dec     qword [rsp+.argc]     ; argc--
     add     qword [rsp+.argv], 8  ; argv++
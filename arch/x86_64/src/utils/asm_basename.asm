@@ -9,6 +9,7 @@
 %include "header.inc"
 
 global asm_basename
+global asm_basename_len
 
 extern asm_strlen
 
@@ -26,31 +27,23 @@ extern asm_strlen
 ; - Input: RDI (address) - Address of argv[0] string.
 ; - Output: RAX (address) - 0 on error, or valid address.
 ;
-; Notes: The input path may be modified by this call.
+; Notes: The input path may be modified by this call (a trailing slash
+;   is replaced with a nul byte).
+;
+; See: asm_basename_len().
 ;---------------------------------------------------------------------
 
 asm_basename:
 section .rodata
     .dot     db      ".",0
 section .text
-    prologue_with_vars 3
+    prologue_with_vars 2
 
     ;--------------------
     ; Stack offsets.
 
     .path       equ     0   ; "char *" address.
-    .p          equ     8   ; "char *" address: Used to iterate through string.
-    .len        equ    16   ; size_t: Length of path string.
-
-    ;--------------------
-    ; Setup
-
-    mov     qword [rsp+.len], 0
-
-    ;--------------------
-    ; Save args
-
-    mov     [rsp+.path], rdi
+    .len        equ     8   ; size_t: Length of basename.
 
     ;--------------------
     ; Initial pathological checks.
@@ -60,100 +53,153 @@ section .text
     je      .return_dot
 
     ; *path == '\0'.
-    mov     rax, [rdi]
-    cmp     al, 0
+    cmp     byte [rdi], 0
     je      .return_dot
 
-    cmp     al, '/'
-    jne     .not_single_slash
-
-    cmp     ah, 0
-    jne     .not_single_slash
-
-    ; path == "/", so return the entire path.
-    mov     rax, [rsp+.path]
-    jmp     .out
-
-.not_single_slash:
     ;--------------------
-    ; Calculate length of path
-
-    mov     rdi, [rsp+.path]
-    dcall   asm_strlen
-    mov     [rsp+.len], rax
-
-    ;--------------------
-    ; Set p = strlen(path) - 1
+    ; Save args
 
-    mov     rbx, [rsp+.path]
-    add     rbx, [rsp+.len]
-    dec     rbx
-    mov     [rsp+.p], rbx
+    mov     [rsp+.path], rdi
 
     ;--------------------
-    ; Start scanning backwards through the string.
-
-    mov     rax, [rsp+.p]
 
-.prev_trailing_byte:
-    cmp     rax, [rsp+.path]
-    je      .out ; We hit the start of the string, so just return it.
-
-    mov     rbx, [rax]
-    cmp     bl, '/'
-    jne     .not_a_slash
-
-    ; Overwrite the trailing slash
-    mov     qword [rax], 0
+    dcall   asm_strlen
 
-    dec     rax
-    jmp     .prev_trailing_byte
+    mov     rdi, [rsp+.path]
+    mov     rsi, rax
+    lea     rdx, [rsp+.len]
+    dcall   asm_basename_len
 
-.not_a_slash:
-.prev_non_slash_char:
-    cmp     rax, [rsp+.path]
+    ; Remove any trailing slashes.
+    mov     rcx, [rsp+.len]
+    mov     byte [rax+rcx], 0
 
-    jne     .not_at_start_of_string
+.out:
+    epilogue_with_vars 2
+    ret
 
-.got_to_start_of_string:
-    ; We've got to the beginning of the path,
-    ; which is a special case if it starts with a slash.
+.return_dot:
+    mov     rax, .dot
+    jmp     .out
 
-    mov     rbx, [rax]
-    cmp     bl, '/'
+;---------------------------------------------------------------------
+; Description: Find the basename within a path without modifying it.
+;
+; C prototype equivalent:
+;
+;     const char *asm_basename_len(const char *path, size_t len,
+;                                  size_t *name_len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - path (which does not need to be nul
+;   terminated).
+; - Input: RSI (integer) - length of path.
+; - Input: RDX (address) - set to the length of the basename.
+; - Output: RAX (address) - start of the basename within path.
+;
+; Notes:
+;
+; - Trailing slashes are not part of the basename. If the path only
+;   contains slashes, the basename is the first slash. An empty path has
+;   an empty basename.
+;
+; - The trailing slashes are skipped a byte at a time (there is rarely
+;   more than one). The last slash before the name is then found by
+;   scanning backwards 16 bytes at a time: PCMPEQB and PMOVMSKB give a
+;   bitmask of the slashes in a block, and BSR finds the last one.
+;
+; - The blocks are 16 byte aligned loads, so never cross a page
+;   boundary even though the first block may start before the path
+;   (the bits for bytes outside of the path are masked off).
+;
+; - Only requires SSE2.
+;---------------------------------------------------------------------
 
-    ; Yes, it starts with a slash so don't adjust the
-    ; offset as we need to return the byte after the slash.
-    je      .done
+asm_basename_len:
+    prologue_with_vars 0
 
-    ; The first byte is not a slash, so move 1 byte *before* the start
-    ; of the string (since .done will move back 1 byte).
-    dec     rax
-    jmp     .done
+    ; rdi: path, rsi: end of name, rdx: name_len, r11: path length.
+    mov     r11, rsi
+    add     rsi, rdi
 
-.not_at_start_of_string:
+    ;--------------------
+    ; Skip trailing slashes.
 
-    ; We've now removed all trailing slashes.
+.prev_trailing_byte:
+    cmp     rsi, rdi
+    je      .empty_or_slashes
 
-    mov     rbx, [rax]
-    cmp     bl, '/'
+    cmp     byte [rsi-1], '/'
+    jne     .find_slash
 
-    ; And we've just found the first leading slash,
-    ; so we've found the basename value.
-    je      .done
+    dec     rsi
+    jmp     .prev_trailing_byte
 
-    dec     rax
-    jmp     .prev_non_slash_char
+.find_slash:
+    ; Broadcast '/' to all the bytes of xmm7.
+    mov     eax, 0x2f2f2f2f
+    movd    xmm7, eax
+    pshufd  xmm7, xmm7, 0
+
+    ; r8: current block, r9: end of unscanned bytes.
+    mov     r9, rsi
+
+.prev_block:
+    lea     r8, [r9-1]
+    and     r8, -16
+
+    movdqa  xmm0, [r8]
+    pcmpeqb xmm0, xmm7
+    pmovmskb eax, xmm0
+
+    ; Ignore bytes at or after the end.
+    mov     rcx, r9
+    sub     rcx, r8
+    mov     r10d, 1
+    shl     r10d, cl
+    dec     r10d
+    and     eax, r10d
+
+    cmp     r8, rdi
+    jae     .check_block
+
+    ; Ignore bytes before the start of the path.
+    mov     rcx, rdi
+    sub     rcx, r8
+    shr     eax, cl
+    shl     eax, cl
+
+.check_block:
+    test    eax, eax
+    jnz     .found_slash
+
+    mov     r9, r8
+    cmp     r9, rdi
+    ja      .prev_block
+
+    ; No slash, so the whole path (less trailing slashes) is the name.
+    mov     rax, rdi
+    jmp     .set_len
+
+.found_slash:
+    bsr     eax, eax
+    lea     rax, [r8+rax+1]
+
+.set_len:
+    sub     rsi, rax
+    mov     [rdx], rsi
+
+    epilogue_with_vars 0
+    ret
 
-.done:
-    ; We currently have the address of the last leading slash, so move
-    ; to the next char so we can return the basename.
-    inc     rax
+.empty_or_slashes:
+    ; The path is empty, or just slashes (so the name is "/").
+    mov     rax, rdi
+    xor     ecx, ecx
+    cmp     r11, 0
+    setne   cl
+    mov     [rdx], rcx
 
-.out:
-    epilogue_with_vars 3
+    epilogue_with_vars 0
     ret
-
-.return_dot:
-    mov     rax, .dot
-    jmp     .out
@@ -9,9 +9,10 @@
 %include "header.inc"
 
 global asm_memcmp
+global asm_memdiff
 
 ;---------------------------------------------------------------------
-; Description: .
+; Description: Compare two blocks of memory.
 ;
 ; C prototype equivalent:
 ;
@@ -22,59 +23,160 @@ global asm_memcmp
 ; - Input: RDI (integer) - 1st memory address.
 ; - Input: RSI (integer) - 2nd memory address.
 ; - Input: RDX (integer) - Number of bytes to consider.
-; - Output: RAX (integer) - 0 on success, or -1 or +1 on error.
+; - Output: RAX (integer) - 0 if the blocks are equal, else a negative
+;   value if the first differing byte in s1 is less than the
+;   corresponding byte in s2, or a positive value otherwise.
 ;
 ; Notes:
 ;
-; Limitations:
-;
-; See:
+; Like memcmp(3), the bytes are compared as unsigned values.
 ;
+; See: memcmp(3), asm_memdiff().
 ;---------------------------------------------------------------------
 
 asm_memcmp:
     prologue_with_vars 0
 
-    mov     rcx, [rsp+rdx]
-
-    cld     ; ensure we count "up"
-
-    repe    cmpsb
+    mov     r10, rdi
+    mov     r11, rsi
 
-    ; ZF should be set if the comparision was successful. If not, the
-    ; strings differ.
-    ;
-    ; FIX ME: This seems wrong?
-    jnz     .not_equal
-
-    ; Now check to ensure we checked all the bytes requested.
-    cmp     rcx, 0
-    jne     .not_equal
+    dcall   asm_memdiff
 
+    cmp     rax, rdx
     je      .equal
 
-.not_equal:
-    ; cmpsb always increments rdi and rsi. So if the values are
-    ; different, we need to move back one byte to access the first
-    ; differing bytes and calculate the difference between the
-    ; differing bytes.
-    ;
-    ; Equivalent to the following C code:
-    ;
-    ;   int rax = *(rdi-1); /* get first differing byte in s1 */
-    ;   int rcx = *(rsi-1); /* get first differing byte in s2 */
-    ;   int result = rax - rcx;
-
-    movzx   rax, byte [rdi-1]
-    movzx   rcx, byte [rsi-1]
-    sub     rax, rcx
+    movzx   ecx, byte [r11+rax]
+    movzx   eax, byte [r10+rax]
+    sub     eax, ecx
+    movsx   rax, eax
     jmp     .out
 
 .equal:
     xor     rax, rax
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Find the first byte that differs between two blocks of
+;   memory.
+;
+; C prototype equivalent:
+;
+;     size_t asm_memdiff(const void *s1, const void *s2, size_t n);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - 1st memory address.
+; - Input: RSI (integer) - 2nd memory address.
+; - Input: RDX (integer) - Number of bytes to consider.
+; - Output: RAX (integer) - offset of the first differing byte, or 'n'
+;   if the blocks are equal.
+;
+; Notes:
+;
+; - Compares 32 bytes per iteration as two 16 byte vectors. PCMPEQB
+;   sets equal bytes to 0xff, so the blocks match if the PMOVMSKB mask
+;   of both results ANDed together is 0xffff. On a mismatch, the
+;   inverted masks give a bit for each differing byte and BSF finds the
+;   first one.
+;
+; - Never reads beyond 'n' bytes: a final partial vector is compared
+;   by loading the last 16 bytes (overlapping bytes already known to be
+;   equal), and blocks shorter than 16 bytes are compared a byte at a
+;   time.
+;
+; - Only requires SSE2.
+;
+; - Preserves RDX, R10 and R11 (see asm_memcmp()).
+;
+; See: asm_memcmp().
+;---------------------------------------------------------------------
+
+asm_memdiff:
+    prologue_with_vars 0
+
+    xor     eax, eax ; Offset.
+
+    cmp     rdx, 16
+    jb      .bytes
+
+    cmp     rdx, 32
+    jb      .check_vector
+
+.next_block:
+    movdqu  xmm0, [rdi+rax]
+    movdqu  xmm1, [rsi+rax]
+    movdqu  xmm2, [rdi+rax+16]
+    movdqu  xmm3, [rsi+rax+16]
+    pcmpeqb xmm0, xmm1
+    pcmpeqb xmm2, xmm3
+    movdqa  xmm1, xmm0
+    pand    xmm1, xmm2
+    pmovmskb ecx, xmm1
+    cmp     ecx, 0xffff
+    jne     .block_differs
+
+    add     rax, 32
+    lea     rcx, [rax+32]
+    cmp     rcx, rdx
+    jbe     .next_block
+
+.check_vector:
+    ; At least 16 bytes remaining?
+    lea     rcx, [rax+16]
+    cmp     rcx, rdx
+    ja      .last_vector
+
+    movdqu  xmm0, [rdi+rax]
+    movdqu  xmm1, [rsi+rax]
+    pcmpeqb xmm0, xmm1
+    pmovmskb ecx, xmm0
+    xor     ecx, 0xffff
+    jnz     .found
+
+    add     rax, 16
+
+.last_vector:
+    cmp     rax, rdx
+    je      .out
+
+    ; Compare the last 16 bytes.
+    lea     rax, [rdx-16]
+
+    movdqu  xmm0, [rdi+rax]
+    movdqu  xmm1, [rsi+rax]
+    pcmpeqb xmm0, xmm1
+    pmovmskb ecx, xmm0
+    xor     ecx, 0xffff
+    jnz     .found
+
+    mov     rax, rdx
     jmp     .out
 
-    ;--------------------
+.block_differs:
+    pmovmskb ecx, xmm0
+    pmovmskb r8d, xmm2
+    shl     r8d, 16
+    or      ecx, r8d
+    not     ecx
+
+.found:
+    bsf     ecx, ecx
+    add     rax, rcx
+    jmp     .out
+
+.bytes:
+    cmp     rax, rdx
+    je      .out
+
+    movzx   ecx, byte [rdi+rax]
+    cmp     cl, [rsi+rax]
+    jne     .out
+
+    inc     rax
+    jmp     .bytes
 
 .out:
     epilogue_with_vars 0
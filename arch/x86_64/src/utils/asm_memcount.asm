@@ -0,0 +1,111 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global asm_memcount
+
+; Maximum number of blocks whose matches can be accumulated in the
+; byte counters before they must be summed (since each byte counter
+; can only count to 255).
+%assign MEMCOUNT_BATCH_BLOCKS   255
+
+;---------------------------------------------------------------------
+; Description: Count the occurrences of a byte in a block of memory.
+;
+; C prototype equivalent:
+;
+;     size_t asm_memcount(const void *s, int c, size_t n);
+;
+; Parameters:
+;
+; - Input: RDI (address) - memory block.
+; - Input: RSI (integer) - byte to count.
+; - Input: RDX (integer) - number of bytes in block.
+; - Output: RAX (integer) - number of bytes equal to 'c'.
+;
+; Notes:
+;
+; - Used to count lines (for example, for line numbers) without
+;   finding each line.
+;
+; - Blocks of 16 bytes are compared at once. PCMPEQB sets matching
+;   bytes to 0xff (-1), so subtracting the result from a register of
+;   byte counters adds 1 to the counter for each match. Every 255
+;   blocks (before the counters can overflow), PSADBW sums the 16
+;   counters.
+;
+; - Only requires SSE2.
+;---------------------------------------------------------------------
+
+asm_memcount:
+    prologue_with_vars 0
+
+    xor     r8, r8 ; Total.
+
+    ; Broadcast the byte to all the bytes of xmm7.
+    movzx   eax, sil
+    imul    eax, eax, 0x01010101
+    movd    xmm7, eax
+    pshufd  xmm7, xmm7, 0
+
+    pxor    xmm5, xmm5 ; Zero (for psadbw).
+
+.next_batch:
+    cmp     rdx, 16
+    jb      .tail
+
+    mov     rcx, MEMCOUNT_BATCH_BLOCKS
+    pxor    xmm1, xmm1 ; Byte counters.
+
+.next_block:
+    movdqu  xmm0, [rdi]
+    pcmpeqb xmm0, xmm7
+    psubb   xmm1, xmm0
+
+    add     rdi, 16
+    sub     rdx, 16
+
+    cmp     rdx, 16
+    jb      .sum_batch
+
+    dec     rcx
+    jnz     .next_block
+
+.sum_batch:
+    ; Sum the byte counters into two 64-bit values.
+    psadbw  xmm1, xmm5
+
+    movq    rax, xmm1
+    add     r8, rax
+
+    pshufd  xmm1, xmm1, 0xee ; Move the high qword to the low qword.
+    movq    rax, xmm1
+    add     r8, rax
+
+    jmp     .next_batch
+
+.tail:
+    test    rdx, rdx
+    jz      .out
+
+    cmp     [rdi], sil
+    jne     .tail_skip
+
+    inc     r8
+
+.tail_skip:
+    inc     rdi
+    dec     rdx
+    jmp     .tail
+
+.out:
+    mov     rax, r8
+
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,224 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global asm_memmem
+
+extern asm_memcmp
+
+;---------------------------------------------------------------------
+; Description: Find the first occurrence of a byte sequence (the
+;   needle) in a block of memory (the haystack).
+;
+; C prototype equivalent:
+;
+;     void *asm_memmem(const void *haystack, size_t haystack_len,
+;                      const void *needle, size_t needle_len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - haystack.
+; - Input: RSI (integer) - number of bytes in haystack.
+; - Input: RDX (address) - needle.
+; - Input: RCX (integer) - number of bytes in needle.
+; - Output: RAX (address) - address of the first match in the
+;   haystack, or 0 if not found. An empty needle matches the start of
+;   the haystack.
+;
+; Notes:
+;
+; - Candidate positions are found 16 at a time by comparing the first
+;   byte of the needle with 16 haystack bytes, and the last byte of the
+;   needle with the 16 haystack bytes (needle_len - 1) bytes further on.
+;   Only positions where both bytes match are checked using
+;   asm_memcmp(). Checking two bytes that are far apart rejects almost
+;   all false positives, even for common first bytes.
+;
+; - The remaining (fewer than 16) positions are checked one at a time.
+;
+; - Unaligned loads are used, but never beyond the end of the
+;   haystack.
+;
+; See: memmem(3), "SIMD-friendly algorithms for substring searching",
+; Wojciech Mula.
+;---------------------------------------------------------------------
+
+asm_memmem:
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .haystack   equ     0   ; "void *"
+    .hlen       equ     8   ; size_t
+    .needle     equ    16   ; "void *"
+    .nlen       equ    24   ; size_t
+    .p          equ    32   ; "void *": current block of the haystack.
+    .last       equ    40   ; "void *": last possible match position.
+    .mask       equ    48   ; unsigned int: remaining candidates in block.
+    .candidate  equ    56   ; "void *": position being checked.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.haystack], rdi
+    mov     [rsp+.hlen], rsi
+    mov     [rsp+.needle], rdx
+    mov     [rsp+.nlen], rcx
+
+    ;--------------------
+    ; Checks
+
+    mov     rax, rdi
+    test    rcx, rcx
+    jz      .out ; Empty needle.
+
+    cmp     rcx, rsi
+    ja      .not_found ; Needle longer than haystack.
+
+    ; last = haystack + hlen - nlen
+    lea     r8, [rdi+rsi]
+    sub     r8, rcx
+    mov     [rsp+.last], r8
+
+    mov     [rsp+.p], rdi
+
+.setup:
+    ;--------------------
+    ; Broadcast the first and last needle bytes to all the bytes
+    ; of xmm6 and xmm7 respectively.
+
+    mov     rsi, [rsp+.needle]
+    mov     rcx, [rsp+.nlen]
+
+    movzx   eax, byte [rsi]
+    imul    eax, eax, 0x01010101
+    movd    xmm6, eax
+    pshufd  xmm6, xmm6, 0
+
+    movzx   eax, byte [rsi+rcx-1]
+    imul    eax, eax, 0x01010101
+    movd    xmm7, eax
+    pshufd  xmm7, xmm7, 0
+
+    mov     rdi, [rsp+.p]
+    mov     r8, [rsp+.last]
+
+    ;--------------------
+    ; Fast path (no calls, so everything stays in registers):
+    ;
+    ; - rdi: current block.
+    ; - rcx: needle length.
+    ; - r8: last possible match position.
+
+.next_block:
+    ; Need 16 complete candidate positions.
+    lea     rax, [rdi+15]
+    cmp     rax, r8
+    ja      .tail
+
+    movdqu  xmm0, [rdi]
+    movdqu  xmm1, [rdi+rcx-1]
+    pcmpeqb xmm0, xmm6
+    pcmpeqb xmm1, xmm7
+    pand    xmm0, xmm1
+    pmovmskb eax, xmm0
+
+    test    eax, eax
+    jnz     .candidates
+
+    add     rdi, 16
+    jmp     .next_block
+
+.candidates:
+    mov     [rsp+.p], rdi
+    mov     [rsp+.mask], rax
+
+.next_candidate:
+    mov     rax, [rsp+.mask]
+    bsf     rcx, rax
+
+    ; Clear the lowest set bit.
+    lea     rdx, [rax-1]
+    and     rax, rdx
+    mov     [rsp+.mask], rax
+
+    mov     rdi, [rsp+.p]
+    add     rdi, rcx
+    mov     [rsp+.candidate], rdi
+
+    ; For needles of up to 2 bytes, the filter is an exact match.
+    mov     rdx, [rsp+.nlen]
+    cmp     rdx, 2
+    jbe     .found
+
+    ; Compare the bytes between the first and last.
+    inc     rdi
+    mov     rsi, [rsp+.needle]
+    inc     rsi
+    sub     rdx, 2
+    dcall   asm_memcmp
+    cmp     rax, 0
+    je      .found
+
+    cmp     qword [rsp+.mask], 0
+    jne     .next_candidate
+
+    ; The call clobbered the registers, so set them up again.
+    add     qword [rsp+.p], 16
+    jmp     .setup
+
+    ;--------------------
+    ; Slow path for the final positions.
+
+.tail:
+    mov     [rsp+.p], rdi
+
+.tail_next:
+    mov     rdi, [rsp+.p]
+    cmp     rdi, [rsp+.last]
+    ja      .not_found
+
+    mov     rsi, [rsp+.needle]
+    mov     rdx, [rsp+.nlen]
+
+    mov     al, [rdi]
+    cmp     al, [rsi]
+    jne     .tail_skip
+
+    mov     al, [rdi+rdx-1]
+    cmp     al, [rsi+rdx-1]
+    jne     .tail_skip
+
+    mov     [rsp+.candidate], rdi
+
+    cmp     rdx, 2
+    jbe     .found
+
+    inc     rdi
+    inc     rsi
+    sub     rdx, 2
+    dcall   asm_memcmp
+    cmp     rax, 0
+    je      .found
+
+.tail_skip:
+    inc     qword [rsp+.p]
+    jmp     .tail_next
+
+.found:
+    mov     rax, [rsp+.candidate]
+    jmp     .out
+
+.not_found:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 8
+    ret
@@ -0,0 +1,912 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+; Description: Base64 encoding and decoding (RFC 4648).
+;
+; The bulk of the data is handled by a SIMD implementation chosen for
+; the CPU (AVX2 or SSSE3), based on the pshufb lookup techniques
+; described in:
+;
+; - "Faster Base64 Encoding and Decoding Using AVX2 Instructions",
+;   Wojciech Muła and Daniel Lemire, ACM TOPS 2018.
+;
+; The SIMD code stops at anything it cannot handle (padding, newlines
+; and invalid characters, or too little data), leaving the rest to a
+; scalar implementation.
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global base64_decode
+global base64_decode_final
+global base64_encode
+
+extern cpu_features
+
+;---------------------------------------------------------------------
+; Values in the decode table (besides 0-63).
+
+%assign BASE64_PAD              0x40 ; '='
+%assign BASE64_NEWLINE          0x80 ; '\n' (ignored)
+%assign BASE64_INVALID          0xff
+
+section .bss
+    ; Implementations selected for this CPU by base64_select().
+    encode_impl     resq 1
+    decode_impl     resq 1
+
+    ; Maps a character to its value (or one of the BASE64_* values).
+    decode_table    resb 256
+
+section .rodata
+    base64_alphabet db  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Encode data as base64.
+;
+; C prototype equivalent:
+;
+;     size_t base64_encode(const void *src, size_t len, char *dst);
+;
+; Parameters:
+;
+; - Input: RDI (address) - data to encode.
+; - Input: RSI (integer) - number of bytes of data.
+; - Input: RDX (address) - buffer for the encoded data, which must be
+;   at least (4 * ((len + 2) / 3)) bytes.
+; - Output: RAX (integer) - number of characters written.
+;
+; Notes:
+;
+; - If len is not a multiple of 3, the final group is padded with '='.
+;   So to encode a stream in pieces, all but the last piece must be a
+;   multiple of 3 bytes.
+;
+; - The output is not terminated.
+;---------------------------------------------------------------------
+
+base64_encode:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .src        equ     0   ; "const unsigned char *"
+    .len        equ     8   ; size_t: bytes remaining.
+    .dst        equ    16   ; "char *": next character.
+    .dst_start  equ    24   ; "char *"
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.src], rdi
+    mov     [rsp+.len], rsi
+    mov     [rsp+.dst], rdx
+    mov     [rsp+.dst_start], rdx
+
+    ;--------------------
+
+    cmp     qword [encode_impl], 0
+    jne     .selected
+
+    dcall   base64_select
+
+.selected:
+    mov     rdi, [rsp+.src]
+    mov     rsi, [rsp+.len]
+    mov     rdx, [rsp+.dst]
+    mov     rax, [encode_impl]
+    dcall   rax
+
+    ; Consumed a multiple of 3 bytes, so wrote (rax / 3) * 4 chars.
+    add     [rsp+.src], rax
+    sub     [rsp+.len], rax
+
+    xor     rdx, rdx
+    mov     rcx, 3
+    div     rcx
+    shl     rax, 2
+    add     [rsp+.dst], rax
+
+    ;--------------------
+    ; Encode the remaining groups.
+
+    mov     rsi, [rsp+.src]
+    mov     rcx, [rsp+.len]
+    mov     rdi, [rsp+.dst]
+
+.next_group:
+    cmp     rcx, 3
+    jb      .tail
+
+    ; eax = (b0 << 16) | (b1 << 8) | b2
+    movzx   eax, byte [rsi]
+    shl     eax, 8
+    mov     al, [rsi+1]
+    shl     eax, 8
+    mov     al, [rsi+2]
+
+    mov     edx, eax
+    shr     edx, 18
+    mov     dl, [base64_alphabet+rdx]
+    mov     [rdi], dl
+
+    mov     edx, eax
+    shr     edx, 12
+    and     edx, 0x3f
+    mov     dl, [base64_alphabet+rdx]
+    mov     [rdi+1], dl
+
+    mov     edx, eax
+    shr     edx, 6
+    and     edx, 0x3f
+    mov     dl, [base64_alphabet+rdx]
+    mov     [rdi+2], dl
+
+    and     eax, 0x3f
+    mov     al, [base64_alphabet+rax]
+    mov     [rdi+3], al
+
+    add     rsi, 3
+    sub     rcx, 3
+    add     rdi, 4
+    jmp     .next_group
+
+.tail:
+    cmp     rcx, 0
+    je      .done
+
+    ; eax = (b0 << 16) | (b1 << 8), where b1 is 0 if absent.
+    movzx   eax, byte [rsi]
+    shl     eax, 8
+    cmp     rcx, 2
+    jb      .tail_loaded
+
+    mov     al, [rsi+1]
+
+.tail_loaded:
+    shl     eax, 8
+
+    mov     edx, eax
+    shr     edx, 18
+    mov     dl, [base64_alphabet+rdx]
+    mov     [rdi], dl
+
+    mov     edx, eax
+    shr     edx, 12
+    and     edx, 0x3f
+    mov     dl, [base64_alphabet+rdx]
+    mov     [rdi+1], dl
+
+    mov     byte [rdi+2], '='
+    mov     byte [rdi+3], '='
+
+    cmp     rcx, 2
+    jb      .tail_done
+
+    mov     edx, eax
+    shr     edx, 6
+    and     edx, 0x3f
+    mov     dl, [base64_alphabet+rdx]
+    mov     [rdi+2], dl
+
+.tail_done:
+    add     rdi, 4
+
+.done:
+    mov     rax, rdi
+    sub     rax, [rsp+.dst_start]
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Decode base64 data.
+;
+; C prototype equivalent:
+;
+;     size_t base64_decode(Base64Decoder *decoder, const char *src,
+;                          size_t len, void *dst);
+;
+; Parameters:
+;
+; - Input: RDI (address) - decoder state (zeroed before the first
+;   call).
+; - Input: RSI (address) - encoded data.
+; - Input: RDX (integer) - number of characters of encoded data.
+; - Input: RCX (address) - buffer for the decoded data, which must be
+;   at least (3 * ((len + 3) / 4)) bytes.
+; - Output: RAX (integer) - number of bytes written.
+;
+; Notes:
+;
+; - The data may be passed in pieces of any size: an incomplete group
+;   of 4 characters is saved in the decoder for the next call. Call
+;   base64_decode_final() after the last piece.
+;
+; - Newlines are ignored.
+;
+; - On invalid input, Base64Decoder.invalid is set and decoding stops.
+;   Like GNU base64(1), the bytes that can be decoded from the group
+;   containing the invalid character are still written.
+;
+; - Each group is decoded separately, so padding may appear at the
+;   end of any group (concatenated encodings are accepted).
+;---------------------------------------------------------------------
+
+base64_decode:
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .decoder    equ     0   ; "Base64Decoder *"
+    .src        equ     8   ; "const char *": next character.
+    .end        equ    16   ; "const char *": end of data.
+    .dst        equ    24   ; "unsigned char *": next byte.
+    .dst_start  equ    32   ; "unsigned char *"
+    .scalar     equ    40   ; bool: set to avoid the SIMD code.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.decoder], rdi
+    mov     [rsp+.src], rsi
+    add     rdx, rsi
+    mov     [rsp+.end], rdx
+    mov     [rsp+.dst], rcx
+    mov     [rsp+.dst_start], rcx
+
+    mov     qword [rsp+.scalar], 0
+
+    ;--------------------
+
+    cmp     qword [decode_impl], 0
+    jne     .next
+
+    dcall   base64_select
+
+.next:
+    mov     rsi, [rsp+.src]
+    cmp     rsi, [rsp+.end]
+    jae     .done
+
+    mov     rbx, [rsp+.decoder]
+    cmp     dword [rbx+Base64Decoder.count], 0
+    jne     .scalar_char
+
+    cmp     qword [rsp+.scalar], 0
+    jne     .scalar_char
+
+    ;--------------------
+    ; Decode as many whole blocks as possible with SIMD.
+
+    mov     rdi, rsi
+    mov     rsi, [rsp+.end]
+    sub     rsi, rdi
+    mov     rdx, [rsp+.dst]
+    mov     rax, [decode_impl]
+    dcall   rax
+
+    ; Consumed a multiple of 4 chars, so wrote (rax / 4) * 3 bytes.
+    add     [rsp+.src], rax
+    shr     rax, 2
+    lea     rax, [rax+rax*2]
+    add     [rsp+.dst], rax
+
+    ; The SIMD code stopped at a block it could not handle, so handle
+    ; at least up to the next newline (or other special character)
+    ; with the scalar code.
+    mov     qword [rsp+.scalar], 1
+    jmp     .next
+
+    ;--------------------
+    ; Handle a single character.
+
+.scalar_char:
+    movzx   eax, byte [rsi]
+    inc     qword [rsp+.src]
+
+    movzx   edx, byte [decode_table+rax]
+
+    cmp     edx, BASE64_NEWLINE
+    je      .newline
+
+    cmp     edx, BASE64_INVALID
+    je      .invalid
+
+    mov     rbx, [rsp+.decoder]
+    mov     ecx, [rbx+Base64Decoder.count]
+
+    cmp     edx, BASE64_PAD
+    jne     .check_after_pad
+
+    ; Padding is only valid for the last 2 characters of a group.
+    cmp     ecx, 2
+    jb      .invalid
+    jmp     .save_char
+
+.check_after_pad:
+    ; Only padding can follow padding.
+    cmp     ecx, 3
+    jne     .save_char
+
+    cmp     byte [rbx+Base64Decoder.quad+2], '='
+    je      .invalid
+
+.save_char:
+    mov     [rbx+Base64Decoder.quad+rcx], al
+    inc     ecx
+    mov     [rbx+Base64Decoder.count], ecx
+
+    cmp     ecx, 4
+    jb      .next
+
+    ;--------------------
+    ; Decode the complete group.
+
+    mov     dword [rbx+Base64Decoder.count], 0
+    mov     rdi, [rsp+.dst]
+
+    ; eax = (v0 << 18) | (v1 << 12) | (v2 << 6) | v3, where the value
+    ; of '=' is treated as 0.
+    xor     eax, eax
+    xor     ecx, ecx
+
+.next_value:
+    movzx   edx, byte [rbx+Base64Decoder.quad+rcx]
+    movzx   edx, byte [decode_table+rdx]
+    and     edx, 0x3f
+    shl     eax, 6
+    or      eax, edx
+    inc     ecx
+    cmp     ecx, 4
+    jb      .next_value
+
+    mov     edx, eax
+    shr     edx, 16
+    mov     [rdi], dl
+    inc     rdi
+
+    cmp     byte [rbx+Base64Decoder.quad+2], '='
+    je      .group_done
+
+    mov     edx, eax
+    shr     edx, 8
+    mov     [rdi], dl
+    inc     rdi
+
+    cmp     byte [rbx+Base64Decoder.quad+3], '='
+    je      .group_done
+
+    mov     [rdi], al
+    inc     rdi
+
+.group_done:
+    mov     [rsp+.dst], rdi
+    jmp     .next
+
+.newline:
+    mov     qword [rsp+.scalar], 0
+    jmp     .next
+
+.invalid:
+    ; Write what can be decoded from the incomplete group.
+    mov     rdi, rbx
+    mov     rsi, [rsp+.dst]
+    dcall   base64_decode_final
+    add     [rsp+.dst], rax
+
+    ; (Only set by base64_decode_final() for an incomplete group.)
+    mov     rbx, [rsp+.decoder]
+    mov     dword [rbx+Base64Decoder.invalid], 1
+
+.done:
+    mov     rax, [rsp+.dst]
+    sub     rax, [rsp+.dst_start]
+
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Finish decoding base64 data.
+;
+; C prototype equivalent:
+;
+;     size_t base64_decode_final(Base64Decoder *decoder, void *dst);
+;
+; Parameters:
+;
+; - Input: RDI (address) - decoder state.
+; - Input: RSI (address) - buffer for the decoded data (at least 2
+;   bytes).
+; - Output: RAX (integer) - number of bytes written.
+;
+; Notes:
+;
+; - If the data ended part way through a group, the input is invalid
+;   (Base64Decoder.invalid is set), but as for GNU base64(1), any
+;   complete bytes in the group are still written.
+;---------------------------------------------------------------------
+
+base64_decode_final:
+    prologue_with_vars 0
+
+    xor     rax, rax
+
+    mov     ecx, [rdi+Base64Decoder.count]
+    cmp     ecx, 0
+    je      .out
+
+    mov     dword [rdi+Base64Decoder.count], 0
+    mov     dword [rdi+Base64Decoder.invalid], 1
+
+    cmp     ecx, 2
+    jb      .out
+
+    ; First byte: (v0 << 2) | (v1 >> 4).
+    movzx   edx, byte [rdi+Base64Decoder.quad]
+    movzx   r8d, byte [decode_table+rdx]
+    shl     r8d, 2
+    movzx   edx, byte [rdi+Base64Decoder.quad+1]
+    movzx   r9d, byte [decode_table+rdx]
+    mov     edx, r9d
+    shr     edx, 4
+    or      r8d, edx
+    mov     [rsi], r8b
+    inc     rax
+
+    cmp     ecx, 3
+    jb      .out
+
+    cmp     byte [rdi+Base64Decoder.quad+2], '='
+    je      .out
+
+    ; Second byte: (v1 << 4) | (v2 >> 2).
+    shl     r9d, 4
+    movzx   edx, byte [rdi+Base64Decoder.quad+2]
+    movzx   edx, byte [decode_table+rdx]
+    shr     edx, 2
+    or      r9d, edx
+    mov     [rsi+1], r9b
+    inc     rax
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create the decode table and select the implementations
+;   to use for this CPU.
+;
+; C prototype equivalent:
+;
+;     void base64_select(void);
+;
+; Parameters: None.
+;
+; Notes:
+;
+; - Safe to call from multiple threads (the result is always the
+;   same).
+;---------------------------------------------------------------------
+
+base64_select:
+    prologue_with_vars 0
+
+    ;--------------------
+    ; Create the decode table.
+
+    mov     rdi, decode_table
+    mov     rcx, 256
+    mov     al, BASE64_INVALID
+    rep     stosb
+
+    xor     ecx, ecx
+
+.next_char:
+    movzx   eax, byte [base64_alphabet+rcx]
+    mov     [decode_table+rax], cl
+    inc     ecx
+    cmp     ecx, 64
+    jb      .next_char
+
+    mov     byte [decode_table+'='], BASE64_PAD
+    mov     byte [decode_table+NL], BASE64_NEWLINE
+
+    ;--------------------
+    ; Select the implementations.
+
+    dcall   cpu_features
+
+    mov     rcx, base64_encode_none
+    mov     rdx, base64_decode_none
+
+    test    rax, CPU_FEATURE_SSSE3
+    jz      .selected
+
+    mov     rcx, base64_encode_ssse3
+    mov     rdx, base64_decode_ssse3
+
+    test    rax, CPU_FEATURE_AVX2
+    jz      .selected
+
+    mov     rcx, base64_encode_avx2
+    mov     rdx, base64_decode_avx2
+
+.selected:
+    mov     [encode_impl], rcx
+    mov     [decode_impl], rdx
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; SIMD implementations.
+;
+; C prototype equivalents:
+;
+;     size_t encode(const void *src, size_t len, char *dst);
+;     size_t decode(const char *src, size_t len, void *dst);
+;
+; Parameters:
+;
+; - Input: RDI (address) - data.
+; - Input: RSI (integer) - number of bytes of data.
+; - Input: RDX (address) - output buffer.
+; - Output: RAX (integer) - number of bytes of data consumed (a
+;   multiple of 3 for encoding and 4 for decoding).
+;
+; Notes:
+;
+; - Neither reads nor writes beyond the data it consumes (blocks are
+;   only handled if the loads stay within the data).
+;
+; - Decoding stops at the first block containing a character outside
+;   the base64 alphabet (including '=' and newlines).
+;---------------------------------------------------------------------
+
+;---------------------------------------------------------------------
+; Encoding constants (see Muła and Lemire, section 3).
+
+section .rodata
+    ; Arrange the bytes of each 3 byte group so that each 32-bit
+    ; element is [b1, b0, b2, b1].
+    encode_shuffle      db  1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10
+                        db  1,0,2,1, 4,3,5,4, 7,6,8,7, 10,9,11,10
+
+    ; Used to move the 6-bit fields of each 32-bit element into
+    ; separate bytes.
+    encode_mask_ac      times 8 dd 0x0fc0fc00
+    encode_mul_ac       times 8 dd 0x04000040
+    encode_mask_bd      times 8 dd 0x003f03f0
+    encode_mul_bd       times 8 dd 0x01000010
+
+    ; Index values are mapped to a lookup table index (0 for 26-51,
+    ; 1-12 for 52-63 and 13 for 0-25) and the table entry is added to
+    ; the value to give the character.
+    encode_51           times 32 db 51
+    encode_26           times 32 db 26
+    encode_13           times 32 db 13
+    encode_offsets      db  'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52
+                        db  '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '+'-62
+                        db  '/'-63, 'A', 0, 0
+                        db  'a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52
+                        db  '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '+'-62
+                        db  '/'-63, 'A', 0, 0
+
+;---------------------------------------------------------------------
+; Decoding constants (see Muła and Lemire, section 4).
+
+    ; A character is invalid if the entries for its low and high
+    ; nibbles have a bit in common.
+    decode_lut_lo       db  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11
+                        db  0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+                        db  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11
+                        db  0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+    decode_lut_hi       db  0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08
+                        db  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+                        db  0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08
+                        db  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+
+    ; Value to add to a (valid) character, indexed by its high nibble
+    ; (plus 0xff for '/').
+    decode_lut_roll     db  0, 16, 19, 4, -65, -65, -71, -71
+                        db  0, 0, 0, 0, 0, 0, 0, 0
+                        db  0, 16, 19, 4, -65, -65, -71, -71
+                        db  0, 0, 0, 0, 0, 0, 0, 0
+
+    decode_slash        times 32 db '/'
+    decode_nibble_mask  times 32 db 0x0f
+
+    ; Combine the 6-bit values into 24-bit groups.
+    decode_mul_ab       times 8 dd 0x01400140
+    decode_mul_abcd     times 8 dd 0x00011000
+
+    ; Move the 3 bytes of each 32-bit element together.
+    decode_pack         db  2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1
+                        db  2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1
+
+    ; Move the 12 bytes from each 128-bit lane together.
+    decode_permute      dd  0, 1, 2, 4, 5, 6, 3, 7
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Encode using only scalar code (does nothing).
+;---------------------------------------------------------------------
+
+base64_encode_none:
+    prologue_with_vars 0
+
+    xor     rax, rax
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Decode using only scalar code (does nothing).
+;---------------------------------------------------------------------
+
+base64_decode_none:
+    prologue_with_vars 0
+
+    xor     rax, rax
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Encode 12 bytes (16 characters) at a time using SSSE3.
+;
+; Notes: Loads 16 bytes for each block, so stops 4 bytes before the
+;   end of the data.
+;---------------------------------------------------------------------
+
+base64_encode_ssse3:
+    prologue_with_vars 0
+
+    movdqu  xmm7, [encode_shuffle]
+    movdqu  xmm6, [encode_mask_ac]
+    movdqu  xmm5, [encode_mul_ac]
+    movdqu  xmm4, [encode_mask_bd]
+    movdqu  xmm3, [encode_mul_bd]
+    movdqu  xmm10, [encode_51]
+    movdqu  xmm11, [encode_26]
+    movdqu  xmm12, [encode_13]
+    movdqu  xmm13, [encode_offsets]
+
+    xor     rax, rax
+
+.next_block:
+    lea     rcx, [rax+16]
+    cmp     rcx, rsi
+    ja      .out
+
+    movdqu  xmm0, [rdi+rax]
+    pshufb  xmm0, xmm7
+
+    ; Split into 6-bit values.
+    movdqa  xmm8, xmm0
+    pand    xmm8, xmm6
+    pmulhuw xmm8, xmm5
+    pand    xmm0, xmm4
+    pmullw  xmm0, xmm3
+    por     xmm0, xmm8
+
+    ; Translate to characters.
+    movdqa  xmm8, xmm0
+    psubusb xmm8, xmm10
+    movdqa  xmm9, xmm11
+    pcmpgtb xmm9, xmm0
+    pand    xmm9, xmm12
+    por     xmm8, xmm9
+    movdqa  xmm9, xmm13
+    pshufb  xmm9, xmm8
+    paddb   xmm0, xmm9
+
+    movdqu  [rdx], xmm0
+
+    add     rax, 12
+    add     rdx, 16
+    jmp     .next_block
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Encode 24 bytes (32 characters) at a time using AVX2.
+;
+; Notes: Each 128-bit lane is loaded separately (with 16 byte loads
+;   12 bytes apart), so stops 4 bytes before the end of the data.
+;---------------------------------------------------------------------
+
+base64_encode_avx2:
+    prologue_with_vars 0
+
+    vmovdqu ymm7, [encode_shuffle]
+    vmovdqu ymm6, [encode_mask_ac]
+    vmovdqu ymm5, [encode_mul_ac]
+    vmovdqu ymm4, [encode_mask_bd]
+    vmovdqu ymm3, [encode_mul_bd]
+    vmovdqu ymm10, [encode_51]
+    vmovdqu ymm11, [encode_26]
+    vmovdqu ymm12, [encode_13]
+    vmovdqu ymm13, [encode_offsets]
+
+    xor     rax, rax
+
+.next_block:
+    lea     rcx, [rax+28]
+    cmp     rcx, rsi
+    ja      .out
+
+    vmovdqu xmm0, [rdi+rax]
+    vinserti128 ymm0, ymm0, [rdi+rax+12], 1
+    vpshufb ymm0, ymm0, ymm7
+
+    ; Split into 6-bit values.
+    vpand   ymm8, ymm0, ymm6
+    vpmulhuw ymm8, ymm8, ymm5
+    vpand   ymm0, ymm0, ymm4
+    vpmullw ymm0, ymm0, ymm3
+    vpor    ymm0, ymm0, ymm8
+
+    ; Translate to characters.
+    vpsubusb ymm8, ymm0, ymm10
+    vpcmpgtb ymm9, ymm11, ymm0
+    vpand   ymm9, ymm9, ymm12
+    vpor    ymm8, ymm8, ymm9
+    vpshufb ymm9, ymm13, ymm8
+    vpaddb  ymm0, ymm0, ymm9
+
+    vmovdqu [rdx], ymm0
+
+    add     rax, 24
+    add     rdx, 32
+    jmp     .next_block
+
+.out:
+    vzeroupper
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Decode 16 characters (12 bytes) at a time using SSSE3.
+;---------------------------------------------------------------------
+
+base64_decode_ssse3:
+    prologue_with_vars 0
+
+    movdqu  xmm15, [decode_lut_lo]
+    movdqu  xmm14, [decode_lut_hi]
+    movdqu  xmm13, [decode_lut_roll]
+    movdqu  xmm12, [decode_slash]
+    movdqu  xmm11, [decode_nibble_mask]
+    movdqu  xmm10, [decode_mul_ab]
+    movdqu  xmm9, [decode_mul_abcd]
+    movdqu  xmm8, [decode_pack]
+
+    xor     rax, rax
+
+.next_block:
+    lea     rcx, [rax+16]
+    cmp     rcx, rsi
+    ja      .out
+
+    movdqu  xmm0, [rdi+rax]
+
+    ; xmm1 = high nibbles, xmm2 = low nibbles.
+    movdqa  xmm1, xmm0
+    psrld   xmm1, 4
+    pand    xmm1, xmm11
+    movdqa  xmm2, xmm0
+    pand    xmm2, xmm11
+
+    ; Validate.
+    movdqa  xmm3, xmm15
+    pshufb  xmm3, xmm2
+    movdqa  xmm4, xmm14
+    pshufb  xmm4, xmm1
+    pand    xmm3, xmm4
+    pxor    xmm4, xmm4
+    pcmpeqb xmm3, xmm4
+    pmovmskb ecx, xmm3
+    cmp     ecx, 0xffff
+    jne     .out
+
+    ; Translate to 6-bit values.
+    movdqa  xmm3, xmm0
+    pcmpeqb xmm3, xmm12
+    paddb   xmm3, xmm1
+    movdqa  xmm4, xmm13
+    pshufb  xmm4, xmm3
+    paddb   xmm0, xmm4
+
+    ; Pack.
+    pmaddubsw xmm0, xmm10
+    pmaddwd xmm0, xmm9
+    pshufb  xmm0, xmm8
+
+    movq    [rdx], xmm0
+    psrldq  xmm0, 8
+    movd    [rdx+8], xmm0
+
+    add     rax, 16
+    add     rdx, 12
+    jmp     .next_block
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Decode 32 characters (24 bytes) at a time using AVX2.
+;---------------------------------------------------------------------
+
+base64_decode_avx2:
+    prologue_with_vars 0
+
+    vmovdqu ymm15, [decode_lut_lo]
+    vmovdqu ymm14, [decode_lut_hi]
+    vmovdqu ymm13, [decode_lut_roll]
+    vmovdqu ymm12, [decode_slash]
+    vmovdqu ymm11, [decode_nibble_mask]
+    vmovdqu ymm10, [decode_mul_ab]
+    vmovdqu ymm9, [decode_mul_abcd]
+    vmovdqu ymm8, [decode_pack]
+    vmovdqu ymm7, [decode_permute]
+
+    xor     rax, rax
+
+.next_block:
+    lea     rcx, [rax+32]
+    cmp     rcx, rsi
+    ja      .out
+
+    vmovdqu ymm0, [rdi+rax]
+
+    ; ymm1 = high nibbles, ymm2 = low nibbles.
+    vpsrld  ymm1, ymm0, 4
+    vpand   ymm1, ymm1, ymm11
+    vpand   ymm2, ymm0, ymm11
+
+    ; Validate.
+    vpshufb ymm3, ymm15, ymm2
+    vpshufb ymm4, ymm14, ymm1
+    vptest  ymm3, ymm4
+    jnz     .out
+
+    ; Translate to 6-bit values.
+    vpcmpeqb ymm3, ymm0, ymm12
+    vpaddb  ymm3, ymm3, ymm1
+    vpshufb ymm4, ymm13, ymm3
+    vpaddb  ymm0, ymm0, ymm4
+
+    ; Pack.
+    vpmaddubsw ymm0, ymm0, ymm10
+    vpmaddwd ymm0, ymm0, ymm9
+    vpshufb ymm0, ymm0, ymm8
+    vpermd  ymm0, ymm7, ymm0
+
+    vmovdqu [rdx], xmm0
+    vextracti128 xmm1, ymm0, 1
+    vmovq   [rdx+16], xmm1
+
+    add     rax, 32
+    add     rdx, 24
+    jmp     .next_block
+
+.out:
+    vzeroupper
+
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,571 @@
+/*--------------------------------------------------------------------
+ * vim:set noexpandtab:
+ *--------------------------------------------------------------------
+ * Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *--------------------------------------------------------------------
+ * Description: Microbenchmarks for the asm utility routines.
+ *
+ * Each routine is timed against its glibc equivalent for a range of
+ * input sizes and buffer alignments. Every call is timed individually
+ * with rdtscp (serialised by lfence) after a warm up phase, and the
+ * median and 99th percentile cycle counts (less the timer overhead)
+ * are written as CSV.
+ *
+ * Notes:
+ *
+ * - Cycle counts are in TSC ticks which, on CPUs with an invariant
+ *   TSC, run at a constant rate rather than the current core clock.
+ *   Disable frequency scaling for stable results.
+ *--------------------------------------------------------------------
+ */
+
+#define _GNU_SOURCE /* for sched_getcpu */
+#include <errno.h>
+#include <getopt.h>
+#include <libgen.h> /* basename(3) */
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Largest input size */
+#define BENCH_MAX_SIZE              (1024 * 1024)
+
+/* Buffers are allocated with this alignment, then offset by one of
+ * the bench_aligns values.
+ */
+#define BENCH_BUF_ALIGN             64
+
+/* Default number of timed calls for each size and alignment */
+#define BENCH_DEFAULT_REPS          1000
+
+/* Fewer calls are made for large sizes (so that each test takes
+ * roughly the same time), but never fewer than this.
+ */
+#define BENCH_MIN_REPS              25
+
+/* Total bytes to process for each size (which determines the number
+ * of calls for large sizes).
+ */
+#define BENCH_BYTES_PER_TEST        (16 * 1024 * 1024)
+
+/* Default number of untimed calls made before timing starts */
+#define BENCH_DEFAULT_WARMUP        100
+
+/* Maximum number of digits for the strtol benchmarks (LONG_MAX has
+ * 19 digits).
+ */
+#define BENCH_MAX_DIGITS            16
+
+/* Maximum number of options for the getopt benchmarks */
+#define BENCH_MAX_OPTIONS           4096
+
+extern char *asm_basename(char *path);
+extern char *asm_strchr(const char *s, int c);
+extern int asm_getopt(int argc, char *const argv[], const char *optstring);
+extern int asm_memcmp(const void *s1, const void *s2, size_t n);
+extern int libc_strtol(const char *str, int base, long *result);
+extern size_t asm_strlen(const char *msg);
+
+/* Data passed to a benchmark function */
+typedef struct bench_data {
+    char *s;            /* Input buffer */
+    char *s2;           /* Second input buffer (for comparisons) */
+    size_t size;        /* Size of input */
+    int argc;           /* Number of elements in argv */
+    char **argv;        /* Arguments (for getopt) */
+} BenchData;
+
+typedef uintptr_t (*bench_func)(BenchData *d);
+typedef void (*setup_func)(BenchData *d);
+
+typedef struct bench_routine {
+    const char *name;       /* Name of asm routine */
+    setup_func setup;       /* Prepares BenchData for a size */
+    bench_func asm_fp;      /* Calls the asm routine */
+    bench_func libc_fp;     /* Calls the glibc equivalent */
+    size_t max_size;        /* Largest size meaningful for routine */
+    bool aligned;           /* Set if alignment affects the routine */
+} BenchRoutine;
+
+/* Offsets from a BENCH_BUF_ALIGN aligned address */
+static const size_t bench_aligns[] = { 0, 1, 15, 31 };
+
+/* Results are stored here to stop calls being optimised away */
+static volatile uintptr_t bench_sink;
+
+static char *bench_buf;
+static char *bench_buf2;
+
+static char *bench_argv[BENCH_MAX_OPTIONS + 2];
+
+/*--------------------------------------------------------------------
+ * Timing
+ *--------------------------------------------------------------------
+ */
+
+static inline uint64_t
+read_tsc(void)
+{
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t aux;
+
+    /* rdtscp waits for earlier instructions to complete and the
+     * lfence stops later instructions starting before the counter
+     * is read.
+     */
+    __asm__ volatile("rdtscp\n\t"
+            "lfence"
+            : "=a" (lo), "=d" (hi), "=c" (aux)
+            :
+            : "memory");
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Return the value at the specified percentile of the sorted samples */
+static uint64_t
+percentile(uint64_t *samples, size_t count, size_t pc)
+{
+    size_t i = ((count - 1) * pc) / 100;
+
+    return samples[i];
+}
+
+static uint64_t
+timer_overhead(uint64_t *samples, size_t reps)
+{
+    for (size_t i = 0; i < reps; i++) {
+        uint64_t start = read_tsc();
+        uint64_t end = read_tsc();
+
+        samples[i] = end - start;
+    }
+
+    qsort(samples, reps, sizeof(uint64_t), cmp_u64);
+
+    return percentile(samples, reps, 50);
+}
+
+/* Time fp and set the median and 99th percentile cycle counts */
+static void
+run_bench(bench_func fp, BenchData *d,
+        uint64_t *samples, size_t reps, size_t warmup,
+        uint64_t overhead,
+        uint64_t *median, uint64_t *p99)
+{
+    for (size_t i = 0; i < warmup; i++) {
+        bench_sink = fp(d);
+    }
+
+    for (size_t i = 0; i < reps; i++) {
+        uint64_t start = read_tsc();
+        bench_sink = fp(d);
+        uint64_t end = read_tsc();
+
+        uint64_t cycles = end - start;
+
+        samples[i] = (cycles > overhead) ? cycles - overhead : 0;
+    }
+
+    qsort(samples, reps, sizeof(uint64_t), cmp_u64);
+
+    *median = percentile(samples, reps, 50);
+    *p99 = percentile(samples, reps, 99);
+}
+
+/*--------------------------------------------------------------------
+ * Setup functions
+ *--------------------------------------------------------------------
+ */
+
+/* String of size bytes (not including the terminator) */
+static void
+setup_string(BenchData *d)
+{
+    memset(d->s, 'x', d->size);
+    d->s[d->size] = '\0';
+}
+
+/* String whose last byte is the byte to search for */
+static void
+setup_strchr(BenchData *d)
+{
+    setup_string(d);
+    d->s[d->size - 1] = 'y';
+}
+
+/* Two identical buffers (the worst case since all bytes compared) */
+static void
+setup_memcmp(BenchData *d)
+{
+    memset(d->s, 'x', d->size);
+    memset(d->s2, 'x', d->size);
+}
+
+/* Path of size bytes made up of "dir/" elements */
+static void
+setup_basename(BenchData *d)
+{
+    for (size_t i = 0; i < d->size; i++) {
+        d->s[i] = ((i % 4) == 3) ? '/' : 'd';
+    }
+
+    /* Avoid a trailing slash (which basename(3) would remove) */
+    d->s[d->size - 1] = 'f';
+    d->s[d->size] = '\0';
+}
+
+/* Decimal number of size digits */
+static void
+setup_strtol(BenchData *d)
+{
+    for (size_t i = 0; i < d->size; i++) {
+        d->s[i] = '1' + (i % 9);
+    }
+
+    d->s[d->size] = '\0';
+}
+
+/* Command line with size options */
+static void
+setup_getopt(BenchData *d)
+{
+    static char prog[] = "bench";
+    static char opt[] = "-a";
+
+    bench_argv[0] = prog;
+
+    for (size_t i = 1; i <= d->size; i++) {
+        bench_argv[i] = opt;
+    }
+
+    bench_argv[d->size + 1] = NULL;
+
+    d->argc = (int)d->size + 1;
+    d->argv = bench_argv;
+}
+
+/*--------------------------------------------------------------------
+ * Benchmark functions
+ *--------------------------------------------------------------------
+ */
+
+static uintptr_t
+bench_asm_strlen(BenchData *d)
+{
+    return asm_strlen(d->s);
+}
+
+static uintptr_t
+bench_libc_strlen(BenchData *d)
+{
+    return strlen(d->s);
+}
+
+static uintptr_t
+bench_asm_strchr(BenchData *d)
+{
+    return (uintptr_t)asm_strchr(d->s, 'y');
+}
+
+static uintptr_t
+bench_libc_strchr(BenchData *d)
+{
+    return (uintptr_t)strchr(d->s, 'y');
+}
+
+static uintptr_t
+bench_asm_memcmp(BenchData *d)
+{
+    return (uintptr_t)asm_memcmp(d->s, d->s2, d->size);
+}
+
+static uintptr_t
+bench_libc_memcmp(BenchData *d)
+{
+    return (uintptr_t)memcmp(d->s, d->s2, d->size);
+}
+
+static uintptr_t
+bench_asm_basename(BenchData *d)
+{
+    return (uintptr_t)asm_basename(d->s);
+}
+
+static uintptr_t
+bench_libc_basename(BenchData *d)
+{
+    return (uintptr_t)basename(d->s);
+}
+
+static uintptr_t
+bench_asm_strtol(BenchData *d)
+{
+    long result = 0;
+
+    (void)libc_strtol(d->s, 10, &result);
+
+    return (uintptr_t)result;
+}
+
+static uintptr_t
+bench_libc_strtol(BenchData *d)
+{
+    char *end = NULL;
+
+    return (uintptr_t)strtol(d->s, &end, 10);
+}
+
+static uintptr_t
+bench_asm_getopt(BenchData *d)
+{
+    uintptr_t count = 0;
+
+    optind = 1;
+
+    while (asm_getopt(d->argc, d->argv, "a") != -1) {
+        count++;
+    }
+
+    return count;
+}
+
+static uintptr_t
+bench_libc_getopt(BenchData *d)
+{
+    uintptr_t count = 0;
+
+    /* Zero forces GNU getopt to reinitialise its internal state */
+    optind = 0;
+
+    while (getopt(d->argc, d->argv, "a") != -1) {
+        count++;
+    }
+
+    return count;
+}
+
+static BenchRoutine routines[] = {
+    { "asm_strlen", setup_string, bench_asm_strlen, bench_libc_strlen, BENCH_MAX_SIZE, true },
+    { "asm_strchr", setup_strchr, bench_asm_strchr, bench_libc_strchr, BENCH_MAX_SIZE, true },
+    { "asm_memcmp", setup_memcmp, bench_asm_memcmp, bench_libc_memcmp, BENCH_MAX_SIZE, true },
+    { "asm_basename", setup_basename, bench_asm_basename, bench_libc_basename, BENCH_MAX_SIZE, true },
+    { "libc_strtol", setup_strtol, bench_asm_strtol, bench_libc_strtol, BENCH_MAX_DIGITS, false },
+    { "asm_getopt", setup_getopt, bench_asm_getopt, bench_libc_getopt, BENCH_MAX_OPTIONS, false },
+};
+
+/*--------------------------------------------------------------------
+ * Main
+ *--------------------------------------------------------------------
+ */
+
+static void
+usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-c cpu] [-m max_size] [-n reps] [-o file] "
+            "[-r routine] [-w warmup]\n",
+            prog);
+}
+
+static int
+pin_cpu(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void
+bench_routine(FILE *out, const BenchRoutine *r,
+        size_t max_size, size_t max_reps, size_t warmup,
+        uint64_t *samples, uint64_t overhead)
+{
+    size_t aligns = r->aligned
+        ? sizeof(bench_aligns) / sizeof(bench_aligns[0])
+        : 1;
+
+    if (max_size > r->max_size) {
+        max_size = r->max_size;
+    }
+
+    for (size_t size = 1; size <= max_size; size *= 2) {
+        size_t reps = BENCH_BYTES_PER_TEST / size;
+
+        if (reps > max_reps) {
+            reps = max_reps;
+        }
+
+        if (reps < BENCH_MIN_REPS) {
+            reps = BENCH_MIN_REPS;
+        }
+
+        for (size_t a = 0; a < aligns; a++) {
+            BenchData d = {
+                .s = bench_buf + bench_aligns[a],
+                .s2 = bench_buf2 + bench_aligns[a],
+                .size = size,
+            };
+
+            uint64_t asm_median, asm_p99;
+            uint64_t libc_median, libc_p99;
+
+            r->setup(&d);
+
+            run_bench(r->asm_fp, &d, samples, reps, warmup, overhead,
+                    &asm_median, &asm_p99);
+
+            run_bench(r->libc_fp, &d, samples, reps, warmup, overhead,
+                    &libc_median, &libc_p99);
+
+            fprintf(out, "%s,%zu,%zu,%zu,%lu,%lu,%lu,%lu,%.3f\n",
+                    r->name,
+                    size,
+                    bench_aligns[a],
+                    reps,
+                    (unsigned long)asm_median,
+                    (unsigned long)asm_p99,
+                    (unsigned long)libc_median,
+                    (unsigned long)libc_p99,
+                    asm_median
+                        ? (double)libc_median / (double)asm_median
+                        : 0.0);
+
+            fflush(out);
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    int cpu = -1;
+    size_t max_size = BENCH_MAX_SIZE;
+    size_t reps = BENCH_DEFAULT_REPS;
+    size_t warmup = BENCH_DEFAULT_WARMUP;
+    const char *file = NULL;
+    const char *only = NULL;
+    FILE *out = stdout;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:hm:n:o:r:w:")) != -1) {
+        switch (opt) {
+        case 'c':
+            cpu = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        case 'm':
+            max_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            reps = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            file = optarg;
+            break;
+        case 'r':
+            only = optarg;
+            break;
+        case 'w':
+            warmup = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (! max_size || max_size > BENCH_MAX_SIZE || ! reps) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (reps < BENCH_MIN_REPS) {
+        reps = BENCH_MIN_REPS;
+    }
+
+    if (cpu < 0) {
+        cpu = sched_getcpu();
+    }
+
+    if (cpu >= 0 && pin_cpu(cpu) < 0) {
+        fprintf(stderr, "ERROR: cannot pin to cpu %d: %s\n",
+                cpu, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    if (file) {
+        out = fopen(file, "w");
+
+        if (! out) {
+            fprintf(stderr, "ERROR: cannot open '%s': %s\n",
+                    file, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Allow for the largest alignment offset and a terminator */
+    size_t buf_size = BENCH_MAX_SIZE + (2 * BENCH_BUF_ALIGN);
+
+    bench_buf = aligned_alloc(BENCH_BUF_ALIGN, buf_size);
+    bench_buf2 = aligned_alloc(BENCH_BUF_ALIGN, buf_size);
+
+    uint64_t *samples = calloc(reps, sizeof(uint64_t));
+
+    if (! bench_buf || ! bench_buf2 || ! samples) {
+        fprintf(stderr, "ERROR: no memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Touch the buffers so page faults are not timed */
+    memset(bench_buf, 0, buf_size);
+    memset(bench_buf2, 0, buf_size);
+
+    uint64_t overhead = timer_overhead(samples, reps);
+
+    fprintf(out, "# cpu=%d timer_overhead=%lu\n",
+            cpu, (unsigned long)overhead);
+
+    fprintf(out, "routine,size,align,reps,"
+            "asm_median,asm_p99,glibc_median,glibc_p99,speedup\n");
+
+    for (size_t i = 0; i < sizeof(routines) / sizeof(routines[0]); i++) {
+        const BenchRoutine *r = &routines[i];
+
+        if (only && strcmp(only, r->name)) {
+            continue;
+        }
+
+        bench_routine(out, r, max_size, reps, warmup, samples, overhead);
+    }
+
+    if (file) {
+        fclose(out);
+    }
+
+    free(samples);
+    free(bench_buf);
+    free(bench_buf2);
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,180 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global cpu_features
+
+; Set in the cached value once the features have been detected.
+%assign CPU_FEATURES_DETECTED   (1 << 30)
+
+;---------------------------------------------------------------------
+; CPUID bits.
+
+; Leaf 1, ECX.
+%assign CPUID_1_ECX_PCLMUL      (1 << 1)
+%assign CPUID_1_ECX_SSSE3       (1 << 9)
+%assign CPUID_1_ECX_SSE42       (1 << 20)
+%assign CPUID_1_ECX_POPCNT      (1 << 23)
+%assign CPUID_1_ECX_OSXSAVE     (1 << 27)
+%assign CPUID_1_ECX_AVX         (1 << 28)
+
+; Leaf 7 (sub-leaf 0), EBX.
+%assign CPUID_7_EBX_BMI1        (1 << 3)
+%assign CPUID_7_EBX_AVX2        (1 << 5)
+%assign CPUID_7_EBX_BMI2        (1 << 8)
+
+; XCR0 bits showing the OS saves the SSE and AVX registers.
+%assign XCR0_SSE_AVX            0x6
+
+section .bss
+    cached_features     resq 1
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Determine which optional instruction set extensions
+;   the CPU (and OS) supports.
+;
+; C prototype equivalent:
+;
+;     unsigned int cpu_features(void);
+;
+; Parameters:
+;
+; - Output: RAX (integer) - bitmask of CPU_FEATURE_* values.
+;
+; Notes:
+;
+; - The CPUID instruction is slow (and causes a VM exit when running
+;   under a hypervisor), so the result is cached.
+;
+; - It is safe to call this function from multiple threads: at worst,
+;   the features are detected more than once.
+;
+; - AVX2 is only reported if the OS saves the YMM registers on a
+;   context switch.
+;
+; See: "Intel 64 and IA-32 Architectures Software Developer's Manual",
+; CPUID instruction.
+;---------------------------------------------------------------------
+
+cpu_features:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .features       equ     0   ; unsigned int: CPU_FEATURE_* bitmask.
+    .max_leaf       equ     8   ; unsigned int.
+    .avx            equ    16   ; bool: true if AVX state is usable.
+
+    ;--------------------
+
+    mov     rax, [cached_features]
+    test    rax, CPU_FEATURES_DETECTED
+    jnz     .out
+
+    mov     qword [rsp+.features], 0
+    mov     qword [rsp+.avx], 0
+
+    ; Determine the highest supported leaf.
+    xor     eax, eax
+    cpuid
+    mov     [rsp+.max_leaf], rax
+
+    ;--------------------
+    ; Leaf 1.
+
+    mov     eax, 1
+    xor     ecx, ecx
+    cpuid
+
+    test    ecx, CPUID_1_ECX_SSSE3
+    jz      .no_ssse3
+
+    or      qword [rsp+.features], CPU_FEATURE_SSSE3
+
+.no_ssse3:
+    test    ecx, CPUID_1_ECX_SSE42
+    jz      .no_sse42
+
+    or      qword [rsp+.features], CPU_FEATURE_SSE42
+
+.no_sse42:
+    test    ecx, CPUID_1_ECX_PCLMUL
+    jz      .no_pclmul
+
+    or      qword [rsp+.features], CPU_FEATURE_PCLMUL
+
+.no_pclmul:
+    test    ecx, CPUID_1_ECX_POPCNT
+    jz      .no_popcnt
+
+    or      qword [rsp+.features], CPU_FEATURE_POPCNT
+
+.no_popcnt:
+    ;--------------------
+    ; Check the OS supports the AVX state before looking for AVX2.
+    ; (xgetbv faults unless OSXSAVE is set).
+
+    mov     edx, ecx
+    and     edx, (CPUID_1_ECX_OSXSAVE|CPUID_1_ECX_AVX)
+    cmp     edx, (CPUID_1_ECX_OSXSAVE|CPUID_1_ECX_AVX)
+    jne     .no_avx
+
+    xor     ecx, ecx ; XCR0
+    xgetbv
+    and     eax, XCR0_SSE_AVX
+    cmp     eax, XCR0_SSE_AVX
+    jne     .no_avx
+
+    mov     qword [rsp+.avx], 1
+
+.no_avx:
+    ;--------------------
+    ; Leaf 7 (sub-leaf 0).
+
+    mov     eax, [rsp+.max_leaf]
+    cmp     eax, 7
+    jb      .done
+
+    mov     eax, 7
+    xor     ecx, ecx
+    cpuid
+
+    test    ebx, CPUID_7_EBX_BMI1
+    jz      .no_bmi1
+
+    or      qword [rsp+.features], CPU_FEATURE_BMI1
+
+.no_bmi1:
+    test    ebx, CPUID_7_EBX_BMI2
+    jz      .no_bmi2
+
+    or      qword [rsp+.features], CPU_FEATURE_BMI2
+
+.no_bmi2:
+    test    ebx, CPUID_7_EBX_AVX2
+    jz      .done
+
+    cmp     qword [rsp+.avx], 1
+    jne     .done
+
+    or      qword [rsp+.features], CPU_FEATURE_AVX2
+
+.done:
+    mov     rax, [rsp+.features]
+    or      rax, CPU_FEATURES_DETECTED
+    mov     [cached_features], rax
+
+.out:
+    and     eax, ~CPU_FEATURES_DETECTED
+
+    epilogue_with_vars 3
+    ret
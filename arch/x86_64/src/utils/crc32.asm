@@ -0,0 +1,893 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global crc32_posix_update
+global crc32_posix_final
+global crc32c_update
+global crc32_update
+
+extern cpu_features
+
+;---------------------------------------------------------------------
+; Generator polynomials.
+
+; CRC-32 (as used by POSIX cksum), MSB-first form.
+%assign CRC32_POSIX_POLY        0x04C11DB7
+
+; CRC-32C (Castagnoli), reflected (LSB-first) form.
+%assign CRC32C_POLY_REFLECTED   0x82F63B78
+
+; CRC-32 (as used by gzip and zlib), reflected (LSB-first) form.
+%assign CRC32_POLY_REFLECTED    0xEDB88320
+
+;---------------------------------------------------------------------
+; Folding constants for crc32_posix_clmul() (x^n mod P).
+
+%assign CRC32_POSIX_X576        0x8833794c
+%assign CRC32_POSIX_X512        0xe6228b11
+%assign CRC32_POSIX_X192        0xc5b9cd4c
+%assign CRC32_POSIX_X128        0xe8a45605
+
+;---------------------------------------------------------------------
+; Number of bytes in each of the three streams crc32c_sse42_3way()
+; processes together.
+%assign CRC32C_STREAM_SIZE      1024
+
+; Shift constants for combining the streams: x^(8*n - 33) mod P
+; (reflected) for n = CRC32C_STREAM_SIZE and 2*CRC32C_STREAM_SIZE.
+%assign CRC32C_SHIFT_1_STREAM   0x170076fa
+%assign CRC32C_SHIFT_2_STREAMS  0xa51b6135
+
+;---------------------------------------------------------------------
+; Description: Fold a 128-bit CRC accumulator forward over the
+;   specified distance and add in the next (byte-swapped) block.
+;
+; Parameters:
+;
+; 1: Accumulator xmm register (updated).
+; 2: xmm register holding the fold constants (low qword: multiplier
+;    for low half, high qword: multiplier for high half).
+; 3: xmm register containing the next block.
+;
+; Notes: Clobbers xmm9.
+;---------------------------------------------------------------------
+
+%macro crc_fold 3
+    movdqa      xmm9, %1
+    pclmulqdq   %1, %2, 0x00
+    pclmulqdq   xmm9, %2, 0x11
+    pxor        %1, xmm9
+    pxor        %1, %3
+%endmacro
+
+section .bss
+    ; Implementations selected for this CPU by crc32_select().
+    posix_impl      resq 1
+    crc32c_impl     resq 1
+    crc32_impl      resq 1
+
+    posix_table     resd 256
+    crc32c_table    resd 256
+
+    ; Slicing-by-8 tables for crc32_slice8(): table n gives the CRC
+    ; of a byte followed by n zero bytes.
+    crc32_table     resd (256 * 8)
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Update a POSIX (cksum) CRC-32 with the specified data.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32_posix_update(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - current CRC value (0 initially).
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: RAX (integer) - updated CRC value.
+;
+; Notes:
+;
+; - Call crc32_posix_final() once all the data has been processed.
+;
+; - The fastest implementation the CPU supports is used.
+;
+; See: cksum(1).
+;---------------------------------------------------------------------
+
+crc32_posix_update:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .crc        equ     0   ; uint32_t.
+    .buf        equ     8   ; "void *"
+    .len        equ    16   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.crc], rdi
+    mov     [rsp+.buf], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    cmp     qword [posix_impl], 0
+    jne     .selected
+
+    dcall   crc32_select
+
+.selected:
+    mov     rdi, [rsp+.crc]
+    mov     rsi, [rsp+.buf]
+    mov     rdx, [rsp+.len]
+    mov     rax, [posix_impl]
+    dcall   rax
+
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Calculate the final POSIX (cksum) CRC-32 value.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32_posix_final(uint32_t crc, uint64_t length);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - CRC value returned by crc32_posix_update().
+; - Input: RSI (integer) - total number of bytes of data.
+; - Output: RAX (integer) - final CRC value (as displayed by cksum(1)).
+;
+; Notes:
+;
+; POSIX requires the length to be included in the CRC, using the
+; minimum number of bytes, least significant byte first. The result is
+; then inverted.
+;---------------------------------------------------------------------
+
+crc32_posix_final:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .crc        equ     0   ; uint32_t.
+    .bytes      equ     8   ; char[8]: encoded length.
+
+    ;--------------------
+
+    mov     [rsp+.crc], rdi
+
+    ; The length is already in the required byte order.
+    mov     [rsp+.bytes], rsi
+
+    ; Calculate the number of bytes needed (0 for a zero length).
+    xor     rdx, rdx
+
+.count_bytes:
+    test    rsi, rsi
+    jz      .counted
+
+    inc     rdx
+    shr     rsi, 8
+    jmp     .count_bytes
+
+.counted:
+    mov     rdi, [rsp+.crc]
+    lea     rsi, [rsp+.bytes]
+    dcall   crc32_posix_update
+
+    not     eax
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Update a CRC-32C (Castagnoli) value with the specified
+;   data.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32c_update(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - current CRC value.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: RAX (integer) - updated CRC value.
+;
+; Notes:
+;
+; - This function does not invert the CRC: to calculate the standard
+;   CRC-32C, start with 0xffffffff and invert the final value.
+;
+; - The fastest implementation the CPU supports is used.
+;---------------------------------------------------------------------
+
+crc32c_update:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .crc        equ     0   ; uint32_t.
+    .buf        equ     8   ; "void *"
+    .len        equ    16   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.crc], rdi
+    mov     [rsp+.buf], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    cmp     qword [crc32c_impl], 0
+    jne     .selected
+
+    dcall   crc32_select
+
+.selected:
+    mov     rdi, [rsp+.crc]
+    mov     rsi, [rsp+.buf]
+    mov     rdx, [rsp+.len]
+    mov     rax, [crc32c_impl]
+    dcall   rax
+
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Update a CRC-32 (as used by gzip(1) and zlib) with the
+;   specified data.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32_update(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - current CRC value.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data.
+; - Output: RAX (integer) - updated CRC value.
+;
+; Notes:
+;
+; - This function does not invert the CRC: to calculate the standard
+;   CRC-32, start with 0xffffffff and invert the final value.
+;
+; See: RFC 1952.
+;---------------------------------------------------------------------
+
+crc32_update:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .crc        equ     0   ; uint32_t.
+    .buf        equ     8   ; "void *"
+    .len        equ    16   ; size_t.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.crc], rdi
+    mov     [rsp+.buf], rsi
+    mov     [rsp+.len], rdx
+
+    ;--------------------
+
+    cmp     qword [crc32_impl], 0
+    jne     .selected
+
+    dcall   crc32_select
+
+.selected:
+    mov     rdi, [rsp+.crc]
+    mov     rsi, [rsp+.buf]
+    mov     rdx, [rsp+.len]
+    mov     rax, [crc32_impl]
+    dcall   rax
+
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create the CRC lookup tables and select the
+;   implementations to use for this CPU.
+;
+; C prototype equivalent:
+;
+;     void crc32_select(void);
+;
+; Parameters: None.
+;
+; Notes:
+;
+; - The tables are always created since the hardware implementations
+;   use them to handle small amounts of data.
+;
+; - Safe to call from multiple threads (the result is always the
+;   same).
+;---------------------------------------------------------------------
+
+crc32_select:
+    prologue_with_vars 0
+
+    ;--------------------
+    ; Create the tables.
+
+    xor     r8, r8 ; Table index.
+
+.next_entry:
+    ; MSB-first entry.
+    mov     eax, r8d
+    shl     eax, 24
+    mov     rcx, 8
+
+.posix_bit:
+    shl     eax, 1
+    jnc     .posix_no_xor
+
+    xor     eax, CRC32_POSIX_POLY
+
+.posix_no_xor:
+    dec     rcx
+    jnz     .posix_bit
+
+    mov     [posix_table+r8*4], eax
+
+    ; Reflected entry.
+    mov     eax, r8d
+    mov     rcx, 8
+
+.crc32c_bit:
+    shr     eax, 1
+    jnc     .crc32c_no_xor
+
+    xor     eax, CRC32C_POLY_REFLECTED
+
+.crc32c_no_xor:
+    dec     rcx
+    jnz     .crc32c_bit
+
+    mov     [crc32c_table+r8*4], eax
+
+    ; gzip entry (also reflected).
+    mov     eax, r8d
+    mov     rcx, 8
+
+.crc32_bit:
+    shr     eax, 1
+    jnc     .crc32_no_xor
+
+    xor     eax, CRC32_POLY_REFLECTED
+
+.crc32_no_xor:
+    dec     rcx
+    jnz     .crc32_bit
+
+    mov     [crc32_table+r8*4], eax
+
+    inc     r8
+    cmp     r8, 256
+    jb      .next_entry
+
+    ; Create the remaining slicing tables:
+    ;
+    ;   table[n][i] = (table[n-1][i] >> 8) ^ table[0][table[n-1][i] & 0xff]
+    ;
+    ; (r8 indexes all of the tables as a single array).
+    mov     r8, 256
+
+.next_slice_entry:
+    mov     eax, [crc32_table+r8*4-(256*4)]
+    movzx   ecx, al
+    shr     eax, 8
+    xor     eax, [crc32_table+rcx*4]
+    mov     [crc32_table+r8*4], eax
+
+    inc     r8
+    cmp     r8, (256 * 8)
+    jb      .next_slice_entry
+
+    ;--------------------
+    ; Select the implementations.
+
+    dcall   cpu_features
+    mov     rdx, rax
+
+    mov     rcx, crc32_posix_table
+
+    mov     rax, rdx
+    and     rax, (CPU_FEATURE_PCLMUL|CPU_FEATURE_SSSE3)
+    cmp     rax, (CPU_FEATURE_PCLMUL|CPU_FEATURE_SSSE3)
+    jne     .posix_selected
+
+    mov     rcx, crc32_posix_clmul
+
+.posix_selected:
+    mov     [posix_impl], rcx
+
+    mov     rcx, crc32c_table_update
+
+    test    rdx, CPU_FEATURE_SSE42
+    jz      .crc32c_selected
+
+    mov     rcx, crc32c_sse42
+
+    ; Combining the streams requires PCLMULQDQ.
+    test    rdx, CPU_FEATURE_PCLMUL
+    jz      .crc32c_selected
+
+    mov     rcx, crc32c_sse42_3way
+
+.crc32c_selected:
+    mov     [crc32c_impl], rcx
+
+    mov     qword [crc32_impl], crc32_slice8
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Table-driven (byte at a time) POSIX CRC-32.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32_posix_table(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters: See crc32_posix_update().
+;
+; Notes: The tables must have been created by crc32_select().
+;---------------------------------------------------------------------
+
+crc32_posix_table:
+    prologue_with_vars 0
+
+    mov     eax, edi
+
+.next_byte:
+    test    rdx, rdx
+    jz      .out
+
+    ; crc = (crc << 8) ^ table[(crc >> 24) ^ byte]
+    movzx   ecx, byte [rsi]
+    mov     r8d, eax
+    shr     r8d, 24
+    xor     ecx, r8d
+    shl     eax, 8
+    xor     eax, [posix_table+rcx*4]
+
+    inc     rsi
+    dec     rdx
+    jmp     .next_byte
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: POSIX CRC-32 using carry-less multiplication.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32_posix_clmul(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters: See crc32_posix_update().
+;
+; Notes:
+;
+; - Requires PCLMULQDQ and SSSE3 (for PSHUFB).
+;
+; - Each 16-byte block is byte-swapped so that the first byte of data
+;   is in the most significant byte. A 128-bit register then holds the
+;   data as a polynomial in exactly the form the CRC is defined on
+;   (with no bit reflection), and the product PCLMULQDQ returns needs
+;   no adjustment.
+;
+; - Four accumulators are folded forwards 512 bits at a time:
+;
+;     acc' = hi(acc) * (x^576 mod P) + lo(acc) * (x^512 mod P) + next
+;
+;   which leaves the remainder unchanged but keeps the accumulators at
+;   128 bits. The four accumulators hide the latency of PCLMULQDQ.
+;
+; - Once the full blocks have been folded into a single accumulator,
+;   the remainder of that 128-bit value (and any trailing bytes) is
+;   calculated using crc32_posix_table().
+;
+; See: "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+; Instruction", Intel (2009).
+;---------------------------------------------------------------------
+
+crc32_posix_clmul:
+section .rodata
+    ; PSHUFB mask to reverse the bytes in a register.
+    .bswap_mask     db  15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0
+
+    .fold_512       dq  CRC32_POSIX_X512, CRC32_POSIX_X576
+    .fold_128       dq  CRC32_POSIX_X128, CRC32_POSIX_X192
+
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .buf        equ     0   ; "void *"
+    .len        equ     8   ; size_t.
+    .block      equ    16   ; 16 bytes: final accumulator value.
+
+    ;--------------------
+
+    cmp     rdx, 64
+    jae     .fold
+
+    ; Too small to be worth folding.
+    dcall   crc32_posix_table
+    jmp     .out
+
+.fold:
+    movdqu  xmm7, [.bswap_mask]
+    movdqu  xmm6, [.fold_512]
+    movdqu  xmm5, [.fold_128]
+
+    movdqu  xmm0, [rsi]
+    movdqu  xmm1, [rsi+16]
+    movdqu  xmm2, [rsi+32]
+    movdqu  xmm3, [rsi+48]
+    pshufb  xmm0, xmm7
+    pshufb  xmm1, xmm7
+    pshufb  xmm2, xmm7
+    pshufb  xmm3, xmm7
+
+    ; Continuing a CRC is equivalent to XORing the current value into
+    ; the first 4 bytes of the data.
+    movd    xmm4, edi
+    pslldq  xmm4, 12
+    pxor    xmm0, xmm4
+
+    add     rsi, 64
+    sub     rdx, 64
+
+.fold_64:
+    cmp     rdx, 64
+    jb      .fold_accumulators
+
+    movdqu  xmm8, [rsi]
+    pshufb  xmm8, xmm7
+    crc_fold xmm0, xmm6, xmm8
+
+    movdqu  xmm8, [rsi+16]
+    pshufb  xmm8, xmm7
+    crc_fold xmm1, xmm6, xmm8
+
+    movdqu  xmm8, [rsi+32]
+    pshufb  xmm8, xmm7
+    crc_fold xmm2, xmm6, xmm8
+
+    movdqu  xmm8, [rsi+48]
+    pshufb  xmm8, xmm7
+    crc_fold xmm3, xmm6, xmm8
+
+    add     rsi, 64
+    sub     rdx, 64
+    jmp     .fold_64
+
+.fold_accumulators:
+    crc_fold xmm0, xmm5, xmm1
+    crc_fold xmm0, xmm5, xmm2
+    crc_fold xmm0, xmm5, xmm3
+
+.fold_16:
+    cmp     rdx, 16
+    jb      .reduce
+
+    movdqu  xmm8, [rsi]
+    pshufb  xmm8, xmm7
+    crc_fold xmm0, xmm5, xmm8
+
+    add     rsi, 16
+    sub     rdx, 16
+    jmp     .fold_16
+
+.reduce:
+    mov     [rsp+.buf], rsi
+    mov     [rsp+.len], rdx
+
+    ; Convert the accumulator back to data order.
+    pshufb  xmm0, xmm7
+    movdqu  [rsp+.block], xmm0
+
+    xor     rdi, rdi
+    lea     rsi, [rsp+.block]
+    mov     rdx, 16
+    dcall   crc32_posix_table
+
+    ; Handle the trailing bytes.
+    mov     rdi, rax
+    mov     rsi, [rsp+.buf]
+    mov     rdx, [rsp+.len]
+    dcall   crc32_posix_table
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Table-driven (byte at a time) CRC-32C.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32c_table_update(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters: See crc32c_update().
+;
+; Notes: The tables must have been created by crc32_select().
+;---------------------------------------------------------------------
+
+crc32c_table_update:
+    prologue_with_vars 0
+
+    mov     eax, edi
+
+.next_byte:
+    test    rdx, rdx
+    jz      .out
+
+    ; crc = (crc >> 8) ^ table[(crc ^ byte) & 0xff]
+    movzx   ecx, byte [rsi]
+    xor     cl, al
+    shr     eax, 8
+    xor     eax, [crc32c_table+rcx*4]
+
+    inc     rsi
+    dec     rdx
+    jmp     .next_byte
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: CRC-32C using the SSE4.2 CRC32 instruction.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32c_sse42(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters: See crc32c_update().
+;
+; Notes: Requires SSE4.2.
+;---------------------------------------------------------------------
+
+crc32c_sse42:
+    prologue_with_vars 0
+
+    mov     eax, edi
+
+.next_qword:
+    cmp     rdx, 8
+    jb      .next_byte
+
+    crc32   rax, qword [rsi]
+    add     rsi, 8
+    sub     rdx, 8
+    jmp     .next_qword
+
+.next_byte:
+    test    rdx, rdx
+    jz      .out
+
+    crc32   eax, byte [rsi]
+    inc     rsi
+    dec     rdx
+    jmp     .next_byte
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: CRC-32C using the SSE4.2 CRC32 instruction on three
+;   streams at once.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32c_sse42_3way(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters: See crc32c_update().
+;
+; Notes:
+;
+; - Requires SSE4.2 and PCLMULQDQ.
+;
+; - The CRC32 instruction has a latency of 3 cycles but a throughput
+;   of 1 per cycle, so a single dependency chain only uses a third of
+;   its capacity. Hence, each 3 * CRC32C_STREAM_SIZE byte block is
+;   split into three streams which are processed together (the first
+;   continuing the current CRC, the others starting from zero).
+;
+; - The streams are then combined by shifting the CRC of the first
+;   stream over the data of the other two (and the second over the
+;   third). For a reflected 32-bit CRC "c", the product
+;   PCLMULQDQ(c, x^(8n-33) mod P) is a 64-bit value which the CRC32
+;   instruction reduces to (c * x^(8n)) mod P.
+;
+; - Any remaining data is handled by crc32c_sse42().
+;
+; See: "Fast CRC Computation for iSCSI Polynomial Using CRC32
+; Instruction", Intel (2011).
+;---------------------------------------------------------------------
+
+crc32c_sse42_3way:
+    prologue_with_vars 0
+
+    mov     eax, edi
+
+.next_block:
+    cmp     rdx, (3 * CRC32C_STREAM_SIZE)
+    jb      .tail
+
+    xor     r8, r8 ; Second stream CRC.
+    xor     r9, r9 ; Third stream CRC.
+    xor     rcx, rcx ; Offset within each stream.
+
+.next_qword:
+    crc32   rax, qword [rsi+rcx]
+    crc32   r8, qword [rsi+rcx+CRC32C_STREAM_SIZE]
+    crc32   r9, qword [rsi+rcx+(2 * CRC32C_STREAM_SIZE)]
+
+    add     rcx, 8
+    cmp     rcx, CRC32C_STREAM_SIZE
+    jb      .next_qword
+
+    ;--------------------
+    ; crc = shift(crc, 2 streams) ^ shift(crc2, 1 stream) ^ crc3
+
+    movq    xmm0, rax
+    movq    xmm1, r8
+
+    mov     r10, CRC32C_SHIFT_2_STREAMS
+    movq    xmm2, r10
+    mov     r10, CRC32C_SHIFT_1_STREAM
+    movq    xmm3, r10
+
+    pclmulqdq xmm0, xmm2, 0x00
+    pclmulqdq xmm1, xmm3, 0x00
+    pxor    xmm0, xmm1
+    movq    r10, xmm0
+
+    xor     eax, eax
+    crc32   rax, r10
+    xor     eax, r9d
+
+    add     rsi, (3 * CRC32C_STREAM_SIZE)
+    sub     rdx, (3 * CRC32C_STREAM_SIZE)
+    jmp     .next_block
+
+.tail:
+    mov     edi, eax
+    dcall   crc32c_sse42
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: CRC-32 (gzip) using slicing-by-8 tables.
+;
+; C prototype equivalent:
+;
+;     uint32_t crc32_slice8(uint32_t crc, const void *buf, size_t len);
+;
+; Parameters: See crc32_update().
+;
+; Notes:
+;
+; - The tables must have been created by crc32_select().
+;
+; - Each aligned qword is XORed with the CRC and then reduced with
+;   eight independent table lookups (one per byte), rather than the
+;   eight dependent lookups a byte at a time implementation requires.
+;
+; Limitations:
+;
+; - A PCLMULQDQ implementation (like crc32_posix_clmul()) would be
+;   faster for large buffers.
+;---------------------------------------------------------------------
+
+crc32_slice8:
+    prologue_with_vars 0
+
+    mov     eax, edi
+
+.next_head_byte:
+    test    rdx, rdx
+    jz      .out
+
+    test    sil, 7
+    jz      .next_qword
+
+    ; crc = (crc >> 8) ^ table[(crc ^ byte) & 0xff]
+    movzx   ecx, byte [rsi]
+    xor     cl, al
+    shr     eax, 8
+    xor     eax, [crc32_table+rcx*4]
+
+    inc     rsi
+    dec     rdx
+    jmp     .next_head_byte
+
+.next_qword:
+    cmp     rdx, 8
+    jb      .next_tail_byte
+
+    ; The upper half of rax is clear.
+    mov     r8, [rsi]
+    xor     r8, rax
+
+    ; The first byte has the most bytes following it.
+    movzx   ecx, r8b
+    mov     eax, [crc32_table+(7*1024)+rcx*4]
+
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+(6*1024)+rcx*4]
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+(5*1024)+rcx*4]
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+(4*1024)+rcx*4]
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+(3*1024)+rcx*4]
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+(2*1024)+rcx*4]
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+(1*1024)+rcx*4]
+    shr     r8, 8
+    movzx   ecx, r8b
+    xor     eax, [crc32_table+rcx*4]
+
+    add     rsi, 8
+    sub     rdx, 8
+    jmp     .next_qword
+
+.next_tail_byte:
+    test    rdx, rdx
+    jz      .out
+
+    movzx   ecx, byte [rsi]
+    xor     cl, al
+    shr     eax, 8
+    xor     eax, [crc32_table+rcx*4]
+
+    inc     rsi
+    dec     rdx
+    jmp     .next_tail_byte
+
+.out:
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,118 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global futex_wait
+global futex_wake
+
+;---------------------------------------------------------------------
+; Description: Block the calling thread while the 32-bit value at the
+;   specified address still contains the value the caller last saw.
+;
+; C prototype equivalent:
+;
+;     int futex_wait(uint32_t *addr, uint32_t expected);
+;
+; Parameters:
+;
+; - Input: RDI (address) - address of 32-bit futex word.
+; - Input: RSI (integer) - value the caller last observed at the address.
+; - Output: RAX (integer) - 0 on success, or a negative errno value
+;   on error.
+;
+; Notes:
+;
+; - libc does not provide a futex(2) wrapper, so this function makes
+;   the system call directly.
+;
+; - The kernel compares the value at the address with the expected
+;   value atomically before sleeping. Hence, if another thread changes
+;   the value (and calls futex_wake()) between the caller checking its
+;   condition and calling this function, the call returns immediately
+;   rather than missing the wakeup.
+;
+; - Wakeups can be spurious, so callers must re-check their condition
+;   in a loop. For this reason, EAGAIN (the value had already changed)
+;   and EINTR (a signal arrived) are both treated as success.
+;
+; See: futex(2).
+;---------------------------------------------------------------------
+
+futex_wait:
+    prologue_with_vars 0
+
+    ; futex(addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+    ;
+    ; XXX: Note that the 4th system call argument is passed in r10,
+    ; not rcx (which the syscall instruction overwrites).
+    mov     edx, esi               ; expected value.
+    mov     rsi, FUTEX_WAIT_PRIVATE
+    xor     r10, r10               ; No timeout (wait forever).
+    xor     r8, r8
+    xor     r9, r9
+
+    mov     rax, SYS_futex
+    syscall
+
+    cmp     rax, 0
+    je      .out
+
+    cmp     rax, -EAGAIN
+    je      .success
+
+    cmp     rax, -EINTR
+    je      .success
+
+    jmp     .out    ; Return the negative errno value.
+
+.success:
+    xor     rax, rax
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Wake up threads blocked in futex_wait() on the specified
+;   address.
+;
+; C prototype equivalent:
+;
+;     int futex_wake(uint32_t *addr, int count);
+;
+; Parameters:
+;
+; - Input: RDI (address) - address of 32-bit futex word.
+; - Input: RSI (integer) - maximum number of waiters to wake.
+; - Output: RAX (integer) - number of waiters woken, or a negative
+;   errno value on error.
+;
+; Notes:
+;
+; The caller must update the value at the address *before* calling
+; this function.
+;
+; See: futex(2).
+;---------------------------------------------------------------------
+
+futex_wake:
+    prologue_with_vars 0
+
+    ; futex(addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+    mov     edx, esi               ; count.
+    mov     rsi, FUTEX_WAKE_PRIVATE
+    xor     r10, r10
+    xor     r8, r8
+    xor     r9, r9
+
+    mov     rax, SYS_futex
+    syscall
+
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,1135 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+; Description: Hex dump formatter used by od and hexdump.
+;
+; The input files are treated as a single stream which is shown
+; HEXFMT_LINE_BYTES bytes per line. Whole lines are formatted directly
+; into a large output buffer that is written with write_block() once
+; it is full.
+;
+; Notes:
+;
+; - With SSSE3, the hex digits of a line are looked up 16 bytes at a
+;   time with pshufb (one lookup for the high nibbles, one for the low
+;   nibbles) and pshufb then spreads the digits out into " xx" fields.
+;   Without SSSE3, the digits are looked up a byte at a time.
+;
+; - The printable characters for HEXFMT_STYLE_CANONICAL are selected
+;   with SSE2 compares, replacing the other bytes with '.'.
+;
+; - Bytes to skip are seeked over in regular files, so they are never
+;   read.
+;---------------------------------------------------------------------
+
+%include "header.inc"
+%include "hexfmt.inc"
+
+global hexfmt_files
+global hexfmt_init
+global hexfmt_parse_bytes
+
+extern arena_alloc
+extern cpu_features
+extern libc_strtol
+extern read_block
+extern write_block
+
+extern close
+extern dprintf
+extern fstat
+extern lseek
+extern open
+
+; Value returned by hexfmt_file() when no more files should be
+; processed.
+%assign HEXFMT_FATAL            -2
+
+section .rodata
+    hexfmt_digits           db  "0123456789abcdef"
+    hexfmt_nibble_mask      times 16 db 0x0f
+
+    ; pshufb controls to spread the 16 digits of 8 bytes into the
+    ; first 16 and remaining 8 bytes of 8 " xx" fields (0x80 gives a
+    ; zero byte, which is then replaced by a space).
+    hexfmt_spread_first     db  0x80, 0, 1, 0x80, 2, 3, 0x80, 4
+                            db  5, 0x80, 6, 7, 0x80, 8, 9, 0x80
+    hexfmt_spread_second    db  10, 11, 0x80, 12, 13, 0x80, 14, 15
+                            times 8 db 0x80
+
+    hexfmt_spaces_first     db  ' ', 0, 0, ' ', 0, 0, ' ', 0
+                            db  0, ' ', 0, 0, ' ', 0, 0, ' '
+    hexfmt_spaces_second    db  0, 0, ' ', 0, 0, ' ', 0, 0
+                            times 8 db 0
+
+    hexfmt_spaces           times 16 db ' '
+    hexfmt_dots             times 16 db '.'
+
+    ; Printable characters are greater than hexfmt_control and less
+    ; than hexfmt_delete (as signed bytes, so 0x80-0xff are excluded).
+    hexfmt_control          times 16 db 0x1f
+    hexfmt_delete           times 16 db 0x7f
+
+    hexfmt_stdin_name       db  "-",0
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Initialise a formatter.
+;
+; C prototype equivalent:
+;
+;     int hexfmt_init(HexFmt *hf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - HexFmt.
+; - Output: RAX (integer) - 0 on success, or -1 if the buffers could
+;   not be allocated.
+;
+; Notes:
+;
+; All the settings are cleared (with no limit): the caller must then
+; set the fields that are "Set by the caller".
+;---------------------------------------------------------------------
+
+hexfmt_init:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rcx, HexFmt_size / 8
+    xor     eax, eax
+    rep     stosq
+
+    mov     qword [rbx+HexFmt.limit], -1
+
+    ; Allow the partial line at the end of the data to be moved with
+    ; a single 16 byte load.
+    mov     rdi, (HEXFMT_IN_SIZE + HEXFMT_LINE_BYTES)
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rbx+HexFmt.in_buf], rax
+
+    mov     rdi, HEXFMT_OUT_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rbx+HexFmt.out_buf], rax
+    mov     [rbx+HexFmt.out_pos], rax
+    add     rax, (HEXFMT_OUT_SIZE - HEXFMT_LINE_MAX)
+    mov     [rbx+HexFmt.out_limit], rax
+
+    xor     eax, eax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Dump the specified files (as a single stream) to
+;   stdout.
+;
+; C prototype equivalent:
+;
+;     int hexfmt_files(HexFmt *hf, char *names[], size_t count);
+;
+; Parameters:
+;
+; - Input: RDI (address) - HexFmt.
+; - Input: RSI (address) - file names ("-" means stdin).
+; - Input: RDX (integer) - number of names (0 means stdin).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; - Files that cannot be read are reported and the remaining files
+;   are still dumped, but the call fails.
+;
+; - Lines repeating the previous line are shown as a single "*" line
+;   unless HEXFMT_VERBOSE is set.
+;
+; - The offset after the last byte is shown on a line of its own
+;   (unless .radix is 0).
+;---------------------------------------------------------------------
+
+hexfmt_files:
+cold_rodata
+    .skip_fmt       db  "%s: cannot skip past end of combined input",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .names      equ     0   ; "char **"
+    .count      equ     8   ; size_t.
+    .i          equ     16  ; size_t: index of next name.
+    .ret        equ     24  ; int: return value.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     [rsp+.names], rsi
+    mov     [rsp+.count], rdx
+    mov     qword [rsp+.i], 0
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Settings derived from those of the caller.
+
+    xor     eax, eax
+    cmp     qword [rbx+HexFmt.style], HEXFMT_STYLE_CANONICAL
+    sete    al
+    mov     [rbx+HexFmt.gap], rax
+
+    dcall   cpu_features
+    test    rax, CPU_FEATURE_SSSE3
+    jz      .files
+
+    or      qword [rbx+HexFmt.flags], HEXFMT_SSSE3
+
+    ; Hex addresses of up to 8 digits can be converted using SIMD.
+    cmp     qword [rbx+HexFmt.radix], 16
+    jne     .files
+
+    mov     rcx, [rbx+HexFmt.width]
+    cmp     rcx, 8
+    ja      .files
+
+    shl     rcx, 2 ; Bits shown.
+    mov     eax, 1
+    shl     rax, cl
+    mov     [rbx+HexFmt.fast_limit], rax
+
+    mov     rcx, 8
+    sub     rcx, [rbx+HexFmt.width]
+    shl     rcx, 3 ; Bits of the digits not shown.
+    mov     [rbx+HexFmt.fast_shift], rcx
+
+.files:
+    cmp     qword [rsp+.count], 0
+    jne     .next_file
+
+    mov     rdi, rbx
+    mov     rsi, hexfmt_stdin_name
+    dcall   hexfmt_file
+    cmp     rax, 0
+    je      .files_done
+
+    mov     qword [rsp+.ret], -1
+
+    cmp     rax, HEXFMT_FATAL
+    je      .out
+
+    jmp     .files_done
+
+.next_file:
+    ; Don't open files once enough has been shown.
+    cmp     qword [rbx+HexFmt.limit], 0
+    je      .files_done
+
+    mov     rax, [rsp+.i]
+    mov     rdx, [rsp+.names]
+    mov     rsi, [rdx+rax*PTR_SIZE]
+    mov     rdi, rbx
+    dcall   hexfmt_file
+    cmp     rax, 0
+    je      .file_done
+
+    mov     qword [rsp+.ret], -1
+
+    cmp     rax, HEXFMT_FATAL
+    je      .out
+
+.file_done:
+    inc     qword [rsp+.i]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.count]
+    jb      .next_file
+
+.files_done:
+    cmp     qword [rbx+HexFmt.skip], 0
+    je      .last_line
+
+    test    qword [rbx+HexFmt.flags], HEXFMT_SKIP_ERROR
+    jz      .last_line
+
+    mov     rdi, STDERR_FD
+    mov     rsi, .skip_fmt
+    mov     rdx, [rbx+HexFmt.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+.last_line:
+    ; Show the final partial line.
+    mov     rdx, [rbx+HexFmt.in_len]
+    cmp     rdx, 0
+    je      .end_address
+
+    mov     rdi, rbx
+    mov     rsi, [rbx+HexFmt.in_buf]
+    dcall   hexfmt_lines
+    cmp     rax, 0
+    jne     .error
+
+.end_address:
+    cmp     qword [rbx+HexFmt.radix], 0
+    je      .flush
+
+    cmp     qword [rbx+HexFmt.address], 0
+    jne     .show_end
+
+    test    qword [rbx+HexFmt.flags], HEXFMT_OMIT_EMPTY_END
+    jnz     .flush
+
+.show_end:
+    mov     rdi, [rbx+HexFmt.out_pos]
+    cmp     rdi, [rbx+HexFmt.out_limit]
+    jb      .format_end
+
+    mov     rdi, rbx
+    dcall   hexfmt_flush
+    cmp     rax, 0
+    jne     .error
+
+.format_end:
+    mov     rdi, [rbx+HexFmt.out_pos]
+    mov     rsi, [rbx+HexFmt.address]
+    mov     rdx, [rbx+HexFmt.radix]
+    mov     rcx, [rbx+HexFmt.width]
+    dcall   hexfmt_number
+
+    mov     byte [rax], NL
+    inc     rax
+    mov     [rbx+HexFmt.out_pos], rax
+
+.flush:
+    mov     rdi, rbx
+    dcall   hexfmt_flush
+    cmp     rax, 0
+    je      .out
+
+.error:
+    mov     qword [rsp+.ret], -1
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Dump a file.
+;
+; C prototype equivalent:
+;
+;     int hexfmt_file(HexFmt *hf, const char *name);
+;
+; Parameters:
+;
+; - Input: RDI (address) - HexFmt.
+; - Input: RSI (string) - file name ("-" means stdin).
+; - Output: RAX (integer) - 0 on success, -1 on error, or HEXFMT_FATAL
+;   if the output could not be written.
+;
+; Notes:
+;
+; Only whole lines are shown: the bytes of a final partial line are
+; left at the start of .in_buf (to be completed by the next file).
+;---------------------------------------------------------------------
+
+hexfmt_file:
+cold_rodata
+    .open_fmt       db  "%s: %s: cannot open file",10,0
+    .read_fmt       db  "%s: %s: read error",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .name       equ     0   ; "char *"
+    .fd         equ     8   ; int.
+    .full       equ     16  ; size_t: bytes of whole lines read.
+    .ret        equ     24  ; int: return value.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     [rsp+.name], rsi
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Handle the stdin alias.
+
+    mov     qword [rsp+.fd], STDIN_FD
+
+    cmp     byte [rsi], '-'
+    jne     .open_file
+
+    cmp     byte [rsi+1], 0
+    je      .opened
+
+.open_file:
+    mov     rdi, rsi
+    mov     rsi, O_RDONLY
+    dcall   open
+    cdqe
+    mov     [rsp+.fd], rax
+    cmp     rax, -1
+    je      .error_open
+
+.opened:
+    mov     rdi, rbx
+    mov     rsi, [rsp+.fd]
+    dcall   hexfmt_skip
+    cmp     rax, 0
+    jne     .error_read
+
+.next_block:
+    ; Read as much as will fit (but no more than will be shown).
+    mov     rdx, HEXFMT_IN_SIZE
+    sub     rdx, [rbx+HexFmt.in_len]
+
+    mov     rax, [rbx+HexFmt.limit]
+    cmp     rdx, rax
+    cmova   rdx, rax
+
+    cmp     rdx, 0
+    je      .close
+
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rbx+HexFmt.in_buf]
+    add     rsi, [rbx+HexFmt.in_len]
+    dcall   read_block
+    cmp     rax, 0
+    jl      .error_read
+    je      .close
+
+    sub     [rbx+HexFmt.limit], rax
+
+    add     rax, [rbx+HexFmt.in_len]
+    mov     rdx, rax
+    and     rdx, -HEXFMT_LINE_BYTES
+    sub     rax, rdx
+    mov     [rbx+HexFmt.in_len], rax
+    mov     [rsp+.full], rdx
+
+    cmp     rdx, 0
+    je      .next_block
+
+    mov     rdi, rbx
+    mov     rsi, [rbx+HexFmt.in_buf]
+    dcall   hexfmt_lines
+    cmp     rax, 0
+    jne     .error_write
+
+    ; Move the partial line to the start of the buffer.
+    mov     rsi, [rbx+HexFmt.in_buf]
+    mov     rdx, [rsp+.full]
+    movdqu  xmm0, [rsi+rdx]
+    movdqu  [rsi], xmm0
+    jmp     .next_block
+
+.error_read:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    mov     rdx, [rbx+HexFmt.name]
+    mov     rcx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .close
+
+.error_write:
+    mov     qword [rsp+.ret], HEXFMT_FATAL
+
+.close:
+    mov     rdi, [rsp+.fd]
+    cmp     rdi, STDIN_FD
+    jle     .out
+
+    dcall   close
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_open:
+    mov     rdi, STDERR_FD
+    mov     rsi, .open_fmt
+    mov     rdx, [rbx+HexFmt.name]
+    mov     rcx, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     qword [rsp+.ret], -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Skip the bytes still to be skipped in a file.
+;
+; C prototype equivalent:
+;
+;     int hexfmt_skip(HexFmt *hf, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - HexFmt.
+; - Input: RSI (integer) - file descriptor.
+; - Output: RAX (integer) - 0 on success, or -1 on read error.
+;
+; Notes:
+;
+; - Regular files are seeked over (to the end of the file at most),
+;   everything else is read and discarded.
+;
+; - The skipped bytes are removed from .skip and added to .address.
+;---------------------------------------------------------------------
+
+hexfmt_skip:
+    prologue_with_vars 2
+
+    alloc_space Stat_size
+
+    ;--------------------
+    ; Stack offsets.
+
+    .fd         equ     0   ; int.
+    .n          equ     8   ; size_t: bytes to seek over.
+    .stat       equ     16  ; Stat_size bytes.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     [rsp+.fd], rsi
+
+    cmp     qword [rbx+HexFmt.skip], 0
+    je      .success
+
+    mov     rdi, [rsp+.fd]
+    lea     rsi, [rsp+.stat]
+    dcall   fstat
+    cmp     eax, 0
+    jne     .next_read
+
+    mov     eax, [rsp+.stat+Stat.st_mode]
+    and     eax, S_IFMT
+    cmp     eax, S_IFREG
+    jne     .next_read
+
+    ; Some regular files (such as those in /proc) claim to be empty,
+    ; so only trust the size of non-empty files.
+    cmp     qword [rsp+.stat+Stat.st_size], 0
+    jle     .next_read
+
+    ; The file may not be at its start (stdin).
+    mov     rdi, [rsp+.fd]
+    xor     esi, esi
+    mov     rdx, SEEK_CUR
+    dcall   lseek
+    cmp     rax, 0
+    jl      .next_read
+
+    ; Skip min(skip, bytes left in the file).
+    mov     edx, 0
+    mov     rcx, [rsp+.stat+Stat.st_size]
+    sub     rcx, rax
+    cmovl   rcx, rdx
+
+    mov     rsi, [rbx+HexFmt.skip]
+    cmp     rsi, rcx
+    cmova   rsi, rcx
+    mov     [rsp+.n], rsi
+
+    mov     rdi, [rsp+.fd]
+    mov     rdx, SEEK_CUR
+    dcall   lseek
+    cmp     rax, 0
+    jl      .next_read
+
+    mov     rax, [rsp+.n]
+    sub     [rbx+HexFmt.skip], rax
+    add     [rbx+HexFmt.address], rax
+    jmp     .success
+
+.next_read:
+    mov     rdx, [rbx+HexFmt.skip]
+    cmp     rdx, 0
+    je      .success
+
+    mov     rax, HEXFMT_IN_SIZE
+    cmp     rdx, rax
+    cmova   rdx, rax
+
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rbx+HexFmt.in_buf]
+    dcall   read_block
+    cmp     rax, 0
+    jl      .error
+    je      .success
+
+    sub     [rbx+HexFmt.skip], rax
+    add     [rbx+HexFmt.address], rax
+    jmp     .next_read
+
+.success:
+    xor     eax, eax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    free_space Stat_size
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Format lines into the output buffer.
+;
+; C prototype equivalent:
+;
+;     int hexfmt_lines(HexFmt *hf, const char *data, size_t len);
+;
+; Parameters:
+;
+; - Input: RDI (address) - HexFmt.
+; - Input: RSI (address) - data.
+; - Input: RDX (integer) - number of bytes of data (only the final
+;   call may pass a length that is not a multiple of
+;   HEXFMT_LINE_BYTES).
+; - Output: RAX (integer) - 0 on success, or -1 on write error.
+;
+; Notes:
+;
+; - A line is formatted as: the address (if any), a space (and
+;   another for HEXFMT_STYLE_CANONICAL), the " xx" fields for the
+;   first 8 bytes, .gap spaces, the fields for the next 8 bytes, then
+;   either a newline or "  |", the characters and "|\n".
+;
+; - Whole 16 byte vectors are stored, so a line may be followed by
+;   junk, which is overwritten by the next line (the output buffer
+;   always has HEXFMT_LINE_MAX bytes free at the start of a line).
+;
+; - A partial line is copied to .last and padded with zero bytes so
+;   that it can be formatted like a whole line: the fields of the
+;   missing bytes are then removed.
+;---------------------------------------------------------------------
+
+hexfmt_lines:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .end        equ     0   ; "char *": end of the data.
+    .src        equ     8   ; "char *": next line.
+    .line       equ     16  ; "char *": current line.
+    .len        equ     24  ; size_t: bytes in the current line.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    add     rdx, rsi
+    mov     [rsp+.end], rdx
+
+    mov     rdi, [rbx+HexFmt.out_pos]
+
+    ; Registers:
+    ;
+    ; rsi: next line.
+    ; rdi: output position.
+    ; r8:  bytes in the current line.
+    ; r9:  current line.
+    ; r10: start of the " xx" fields.
+
+.next_line:
+    mov     rcx, [rsp+.end]
+    sub     rcx, rsi
+    jz      .success
+
+    cmp     rdi, [rbx+HexFmt.out_limit]
+    jae     .flush
+
+    cmp     rcx, HEXFMT_LINE_BYTES
+    jb      .partial
+
+    mov     r9, rsi
+    mov     r8, HEXFMT_LINE_BYTES
+    add     rsi, r8
+
+    test    qword [rbx+HexFmt.flags], HEXFMT_VERBOSE
+    jnz     .show
+
+    cmp     qword [rbx+HexFmt.have_prev], 0
+    je      .show
+
+    movdqu  xmm0, [r9]
+    movdqu  xmm1, [rbx+HexFmt.prev]
+    pcmpeqb xmm1, xmm0
+    pmovmskb eax, xmm1
+    cmp     eax, 0xffff
+    jne     .show
+
+    ; The line repeats the previous line.
+    add     qword [rbx+HexFmt.address], HEXFMT_LINE_BYTES
+
+    cmp     qword [rbx+HexFmt.starred], 0
+    jne     .next_line
+
+    mov     qword [rbx+HexFmt.starred], 1
+
+    mov     byte [rdi], '*'
+    mov     byte [rdi+1], NL
+    add     rdi, 2
+    jmp     .next_line
+
+.show:
+    movdqu  xmm0, [r9]
+    movdqu  [rbx+HexFmt.prev], xmm0
+    mov     qword [rbx+HexFmt.have_prev], 1
+    mov     qword [rbx+HexFmt.starred], 0
+    jmp     .address
+
+.partial:
+    lea     r9, [rbx+HexFmt.last]
+    mov     r8, rcx
+
+    pxor    xmm0, xmm0
+    movdqu  [r9], xmm0
+
+    xor     edx, edx
+
+.next_partial_byte:
+    mov     al, [rsi+rdx]
+    mov     [r9+rdx], al
+    inc     rdx
+    cmp     rdx, rcx
+    jb      .next_partial_byte
+
+    add     rsi, rcx
+
+.address:
+    mov     rax, [rbx+HexFmt.address]
+    add     [rbx+HexFmt.address], r8
+
+    cmp     rax, [rbx+HexFmt.fast_limit]
+    jae     .slow_address
+
+    ; Convert the (big endian) address like the data below: the 8
+    ; digits end up in rax with the most significant first.
+    bswap   eax
+    movd    xmm1, eax
+    movdqa  xmm2, xmm1
+    psrlw   xmm2, 4
+    movdqu  xmm3, [hexfmt_nibble_mask]
+    pand    xmm1, xmm3
+    pand    xmm2, xmm3
+    movdqu  xmm3, [hexfmt_digits]
+    movdqa  xmm4, xmm3
+    pshufb  xmm3, xmm2
+    pshufb  xmm4, xmm1
+    punpcklbw xmm3, xmm4
+    movq    rax, xmm3
+
+    ; Remove the leading zero digits not shown.
+    mov     rcx, [rbx+HexFmt.fast_shift]
+    shr     rax, cl
+    mov     [rdi], rax
+    add     rdi, [rbx+HexFmt.width]
+    jmp     .fields
+
+.slow_address:
+    cmp     qword [rbx+HexFmt.radix], 0
+    je      .fields
+
+    mov     [rsp+.src], rsi
+    mov     [rsp+.line], r9
+    mov     [rsp+.len], r8
+
+    mov     rsi, rax
+    mov     rdx, [rbx+HexFmt.radix]
+    mov     rcx, [rbx+HexFmt.width]
+    dcall   hexfmt_number
+    mov     rdi, rax
+
+    mov     rsi, [rsp+.src]
+    mov     r9, [rsp+.line]
+    mov     r8, [rsp+.len]
+
+.fields:
+    mov     byte [rdi], ' '
+    add     rdi, [rbx+HexFmt.gap]
+    mov     r10, rdi
+
+    test    qword [rbx+HexFmt.flags], HEXFMT_SSSE3
+    jz      .scalar_fields
+
+    ;--------------------
+    ; Look up the digits of all the bytes.
+
+    movdqu  xmm0, [r9]
+    movdqu  xmm7, [hexfmt_nibble_mask]
+    movdqa  xmm1, xmm0
+    psrlw   xmm1, 4
+    pand    xmm1, xmm7 ; High nibbles.
+    pand    xmm7, xmm0 ; Low nibbles.
+
+    movdqu  xmm2, [hexfmt_digits]
+    movdqa  xmm3, xmm2
+    pshufb  xmm2, xmm1
+    pshufb  xmm3, xmm7
+
+    movdqa  xmm4, xmm2
+    punpcklbw xmm4, xmm3 ; Digits of bytes 0-7.
+    punpckhbw xmm2, xmm3 ; Digits of bytes 8-15.
+
+    ;--------------------
+    ; Spread the digits of each group of 8 bytes into 24 bytes.
+
+    movdqu  xmm5, [hexfmt_spread_first]
+    movdqu  xmm6, [hexfmt_spread_second]
+    movdqu  xmm7, [hexfmt_spaces_first]
+    movdqu  xmm8, [hexfmt_spaces_second]
+
+    movdqa  xmm1, xmm4
+    pshufb  xmm1, xmm5
+    por     xmm1, xmm7
+    pshufb  xmm4, xmm6
+    por     xmm4, xmm8
+    movdqu  [rdi], xmm1
+    movdqu  [rdi+16], xmm4
+    add     rdi, 24
+
+    mov     byte [rdi], ' '
+    add     rdi, [rbx+HexFmt.gap]
+
+    movdqa  xmm1, xmm2
+    pshufb  xmm1, xmm5
+    por     xmm1, xmm7
+    pshufb  xmm2, xmm6
+    por     xmm2, xmm8
+    movdqu  [rdi], xmm1
+    movdqu  [rdi+16], xmm2
+    add     rdi, 24
+
+    jmp     .fields_done
+
+.scalar_fields:
+    xor     ecx, ecx
+
+.next_scalar_byte:
+    movzx   eax, byte [r9+rcx]
+    mov     edx, eax
+    shr     edx, 4
+    and     eax, 0x0f
+    movzx   edx, byte [hexfmt_digits+rdx]
+    movzx   eax, byte [hexfmt_digits+rax]
+
+    mov     byte [rdi], ' '
+    mov     [rdi+1], dl
+    mov     [rdi+2], al
+    add     rdi, 3
+
+    inc     ecx
+    cmp     ecx, 8
+    jne     .scalar_byte_done
+
+    mov     byte [rdi], ' '
+    add     rdi, [rbx+HexFmt.gap]
+
+.scalar_byte_done:
+    cmp     ecx, HEXFMT_LINE_BYTES
+    jb      .next_scalar_byte
+
+.fields_done:
+    cmp     qword [rbx+HexFmt.style], HEXFMT_STYLE_CANONICAL
+    je      .canonical
+
+    ; End the line after the field of the last byte.
+    lea     rdi, [r8+r8*2]
+    add     rdi, r10
+    mov     byte [rdi], NL
+    inc     rdi
+    jmp     .next_line
+
+.canonical:
+    cmp     r8, HEXFMT_LINE_BYTES
+    je      .characters
+
+    ; Blank the fields of the missing bytes (and the gap if the
+    ; second group is missing).
+    lea     rax, [r8+r8*2]
+    add     rax, r10
+
+    cmp     r8, 8
+    jbe     .blank
+
+    inc     rax ; Keep the gap.
+
+.blank:
+    movdqu  xmm1, [hexfmt_spaces]
+    movdqu  [rax], xmm1
+    movdqu  [rax+16], xmm1
+    movdqu  [rax+32], xmm1
+
+.characters:
+    ; Replace the bytes that are not printable with dots.
+    movdqu  xmm0, [r9]
+    movdqu  xmm1, [hexfmt_control]
+    movdqu  xmm2, [hexfmt_delete]
+    movdqa  xmm3, xmm0
+    pcmpgtb xmm3, xmm1
+    pcmpgtb xmm2, xmm0
+    pand    xmm3, xmm2 ; Printable bytes.
+
+    movdqu  xmm1, [hexfmt_dots]
+    pand    xmm0, xmm3
+    pandn   xmm3, xmm1
+    por     xmm0, xmm3
+
+    mov     byte [rdi], ' '
+    mov     byte [rdi+1], ' '
+    mov     byte [rdi+2], '|'
+    movdqu  [rdi+3], xmm0
+
+    lea     rdi, [rdi+r8+3]
+    mov     byte [rdi], '|'
+    mov     byte [rdi+1], NL
+    add     rdi, 2
+    jmp     .next_line
+
+.flush:
+    mov     [rbx+HexFmt.out_pos], rdi
+    mov     [rsp+.src], rsi
+
+    mov     rdi, rbx
+    dcall   hexfmt_flush
+    cmp     rax, 0
+    jne     .out
+
+    mov     rsi, [rsp+.src]
+    mov     rdi, [rbx+HexFmt.out_pos]
+    jmp     .next_line
+
+.success:
+    mov     [rbx+HexFmt.out_pos], rdi
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Format a number with at least the specified number of
+;   digits.
+;
+; C prototype equivalent:
+;
+;     char *hexfmt_number(char *out, size_t value, int radix, int width);
+;
+; Parameters:
+;
+; - Input: RDI (address) - output buffer.
+; - Input: RSI (integer) - value.
+; - Input: RDX (integer) - radix (8, 10 or 16).
+; - Input: RCX (integer) - minimum number of digits.
+; - Output: RAX (address) - the byte after the last digit.
+;
+; Notes:
+;
+; Octal and hex digits are extracted with shifts (not division).
+;---------------------------------------------------------------------
+
+hexfmt_number:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .digits     equ     0   ; 24 bytes (filled from the end).
+
+    ;--------------------
+
+    mov     rax, rsi
+    mov     r8, rdx
+    mov     r11, rcx
+
+    lea     r9, [rsp+.digits+24] ; End of the digits.
+    mov     r10, r9
+
+    cmp     r8, 10
+    je      .next_decimal
+
+    bsf     rcx, r8 ; Bits per digit.
+    dec     r8      ; Digit mask.
+
+.next_bits:
+    mov     rdx, rax
+    and     rdx, r8
+    movzx   edx, byte [hexfmt_digits+rdx]
+    dec     r10
+    mov     [r10], dl
+
+    shr     rax, cl
+    jnz     .next_bits
+
+    jmp     .pad
+
+.next_decimal:
+    xor     edx, edx
+    div     r8
+    movzx   edx, byte [hexfmt_digits+rdx]
+    dec     r10
+    mov     [r10], dl
+
+    cmp     rax, 0
+    jne     .next_decimal
+
+.pad:
+    mov     rcx, r9
+    sub     rcx, r10 ; Digits.
+
+.next_pad:
+    cmp     rcx, r11
+    jae     .copy
+
+    mov     byte [rdi], '0'
+    inc     rdi
+    inc     rcx
+    jmp     .next_pad
+
+.copy:
+    mov     rsi, r10
+    mov     rcx, r9
+    sub     rcx, r10
+    rep     movsb
+
+    mov     rax, rdi
+
+    epilogue_with_vars 3
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the output buffer to stdout.
+;
+; C prototype equivalent:
+;
+;     int hexfmt_flush(HexFmt *hf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - HexFmt.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;---------------------------------------------------------------------
+
+hexfmt_flush:
+cold_rodata
+    .write_fmt      db  "%s: write error",10,0
+section .text
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rsi, [rbx+HexFmt.out_buf]
+    mov     rdx, [rbx+HexFmt.out_pos]
+    sub     rdx, rsi
+    jz      .success
+
+    mov     rdi, STDOUT_FD
+    dcall   write_block
+    cmp     rax, 0
+    jl      .error_write
+
+    mov     rax, [rbx+HexFmt.out_buf]
+    mov     [rbx+HexFmt.out_pos], rax
+
+.success:
+    xor     eax, eax
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+.error_write:
+    mov     rdi, STDERR_FD
+    mov     rsi, .write_fmt
+    mov     rdx, [rbx+HexFmt.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Parse a number of bytes (an offset or length).
+;
+; C prototype equivalent:
+;
+;     long hexfmt_parse_bytes(const char *str);
+;
+; Parameters:
+;
+; - Input: RDI (string) - value to parse.
+; - Output: RAX (integer) - number of bytes, or -1 if the value is
+;   invalid.
+;
+; Notes:
+;
+; Like od(1) and hexdump(1), the value may be decimal, hex ("0x"
+; prefix) or octal ("0" prefix).
+;
+; Limitations:
+;
+; - Multiplier suffixes (such as "k") are not supported.
+;---------------------------------------------------------------------
+
+hexfmt_parse_bytes:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .value      equ     0   ; long.
+
+    ;--------------------
+
+    mov     rsi, 0 ; Determine the base from the prefix.
+    lea     rdx, [rsp+.value]
+    dcall   libc_strtol
+    cmp     rax, 0
+    jne     .error
+
+    mov     rax, [rsp+.value]
+    cmp     rax, 0
+    jge     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 1
+    ret
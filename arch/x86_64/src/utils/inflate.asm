@@ -0,0 +1,1847 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+; Description: A streaming DEFLATE (RFC 1951) decoder.
+;
+; Input is read with read_block() as it is needed and output is
+; written with write_block() each time INFLATE_OUT_SIZE bytes have
+; been decoded. The output buffer also holds the window: once it has
+; been written, the last INFLATE_WINDOW_SIZE bytes are moved to the
+; start of the buffer so that matches can always be copied directly
+; from earlier output.
+;
+; Notes:
+;
+; - Input is consumed through a 64-bit bit buffer which is refilled
+;   with a single (unaligned) 8 byte load whenever possible, so that
+;   a whole literal/length and distance pair can be decoded without
+;   checking for more input.
+;
+; - Codes are decoded with two level lookup tables (in the same form
+;   as zlib): the first INFLATE_*_BITS bits of the input index the
+;   first level table, which either gives the symbol directly or
+;   points to a second level table for the remaining bits of a longer
+;   code.
+;
+; See: RFC 1951, zlib's inftrees.c.
+;---------------------------------------------------------------------
+
+%include "header.inc"
+%include "inflate.inc"
+
+global inflate_byte
+global inflate_init
+global inflate_input
+global inflate_stream
+
+extern arena_alloc
+extern crc32_update
+extern read_block
+extern write_block
+
+;---------------------------------------------------------------------
+; Types of code for inflate_build().
+
+%assign INFLATE_TYPE_CODES      0 ; Code length codes.
+%assign INFLATE_TYPE_LITLEN     1 ; Literal/length codes.
+%assign INFLATE_TYPE_DIST       2 ; Distance codes.
+
+; Maximum number of bits needed to decode a length and distance
+; (15 + 5 extra + 15 + 13 extra).
+%assign INFLATE_MAX_MATCH_BITS  48
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Initialise a decoder.
+;
+; C prototype equivalent:
+;
+;     int inflate_init(Inflate *inf, int out_fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Input: RSI (integer) - file descriptor to write the output to.
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; The buffers are allocated from the arena.
+;---------------------------------------------------------------------
+
+inflate_init:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    ; Clear everything but the tables.
+    mov     rcx, Inflate.litlen / 8
+    xor     eax, eax
+    rep     stosq
+
+    mov     [rbx+Inflate.out_fd], rsi
+
+    mov     rdi, INFLATE_IN_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rbx+Inflate.in_buf], rax
+
+    mov     rdi, (INFLATE_WINDOW_SIZE + INFLATE_OUT_SIZE + INFLATE_OUT_SLACK)
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rbx+Inflate.out_buf], rax
+    mov     [rbx+Inflate.out_pos], rax
+    mov     [rbx+Inflate.out_flushed], rax
+    mov     [rbx+Inflate.out_start], rax
+    add     rax, (INFLATE_WINDOW_SIZE + INFLATE_OUT_SIZE)
+    mov     [rbx+Inflate.out_limit], rax
+
+    xor     eax, eax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Start reading from the specified file.
+;
+; C prototype equivalent:
+;
+;     void inflate_input(Inflate *inf, int fd);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Input: RSI (integer) - file descriptor to read.
+; - Output: None.
+;---------------------------------------------------------------------
+
+inflate_input:
+    prologue_with_vars 0
+
+    mov     [rdi+Inflate.fd], rsi
+
+    mov     rax, [rdi+Inflate.in_buf]
+    mov     [rdi+Inflate.in_pos], rax
+    mov     [rdi+Inflate.in_end], rax
+    sub     rax, 8
+    mov     [rdi+Inflate.in_fast], rax
+
+    xor     eax, eax
+    mov     [rdi+Inflate.eof], rax
+    mov     [rdi+Inflate.overrun], rax
+    mov     [rdi+Inflate.bitbuf], rax
+    mov     [rdi+Inflate.bitcnt], rax
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Return the next byte of input.
+;
+; C prototype equivalent:
+;
+;     int inflate_byte(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - byte value, INFLATE_ERR_EOF if there is no
+;   more input, or INFLATE_ERR_READ.
+;
+; Notes:
+;
+; Any bits before the next byte boundary are discarded (so this is
+; used to read the data around a DEFLATE stream).
+;---------------------------------------------------------------------
+
+inflate_byte:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    ; Discard the partial byte.
+    mov     rcx, [rbx+Inflate.bitcnt]
+    and     ecx, 7
+    shr     qword [rbx+Inflate.bitbuf], cl
+    sub     [rbx+Inflate.bitcnt], rcx
+
+    mov     rax, [rbx+Inflate.bitcnt]
+    cmp     rax, 0
+    je      .from_buffer
+
+    ; The bytes loaded after EOF are the last in the bit buffer.
+    shr     rax, 3
+    cmp     rax, [rbx+Inflate.overrun]
+    jbe     .error_eof
+
+    movzx   eax, byte [rbx+Inflate.bitbuf]
+    shr     qword [rbx+Inflate.bitbuf], 8
+    sub     qword [rbx+Inflate.bitcnt], 8
+    jmp     .out
+
+.from_buffer:
+    ; The bit buffer may hold the bytes at .in_pos which are about to
+    ; be consumed directly.
+    mov     qword [rbx+Inflate.bitbuf], 0
+
+    mov     rax, [rbx+Inflate.in_pos]
+    cmp     rax, [rbx+Inflate.in_end]
+    jb      .take_byte
+
+    mov     rdi, rbx
+    dcall   inflate_fill
+    cmp     rax, 0
+    jl      .out
+    je      .error_eof
+
+    mov     rax, [rbx+Inflate.in_pos]
+
+.take_byte:
+    inc     qword [rbx+Inflate.in_pos]
+    movzx   eax, byte [rax]
+    jmp     .out
+
+.error_eof:
+    mov     rax, INFLATE_ERR_EOF
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Decode a complete DEFLATE stream.
+;
+; C prototype equivalent:
+;
+;     int inflate_stream(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_*.
+;
+; Notes:
+;
+; - All of the output (even on error) has been written on return,
+;   and .crc and .size describe the output of this stream.
+;
+; - Matches may not refer to output of an earlier stream.
+;
+; - A decoding error which occurs after the end of the input has been
+;   reached is reported as INFLATE_ERR_EOF (since the stream is
+;   truncated).
+;---------------------------------------------------------------------
+
+inflate_stream:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .final      equ     0   ; bool: processing the last block.
+    .result     equ     8   ; int.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     eax, 0xffffffff
+    mov     [rbx+Inflate.crc], rax
+    mov     qword [rbx+Inflate.size], 0
+    mov     rax, [rbx+Inflate.out_pos]
+    mov     [rbx+Inflate.out_start], rax
+
+.next_block:
+    ; BFINAL (1 bit) and BTYPE (2 bits).
+    mov     rdi, rbx
+    mov     rsi, 3
+    dcall   inflate_bits
+    cmp     rax, 0
+    jl      .error
+
+    mov     rcx, rax
+    and     rcx, 1
+    mov     [rsp+.final], rcx
+
+    shr     rax, 1
+    cmp     rax, 1
+    jb      .stored
+    je      .fixed
+
+    cmp     rax, 2
+    jne     .error_format
+
+    mov     rdi, rbx
+    dcall   inflate_dynamic
+    cmp     rax, 0
+    jl      .error
+    jmp     .codes
+
+.stored:
+    mov     rdi, rbx
+    dcall   inflate_stored
+    cmp     rax, 0
+    jl      .error
+    jmp     .block_done
+
+.fixed:
+    mov     rdi, rbx
+    dcall   inflate_fixed
+    cmp     rax, 0
+    jl      .error
+
+.codes:
+    mov     rdi, rbx
+    dcall   inflate_codes
+    cmp     rax, 0
+    jl      .error
+
+.block_done:
+    cmp     qword [rsp+.final], 0
+    je      .next_block
+
+    ; The zero bytes loaded after EOF must not have been consumed.
+    mov     rax, [rbx+Inflate.overrun]
+    shl     rax, 3
+    cmp     rax, [rbx+Inflate.bitcnt]
+    ja      .error_eof
+
+    mov     rdi, rbx
+    dcall   inflate_flush
+    jmp     .out
+
+.error_format:
+    mov     rax, INFLATE_ERR_FORMAT
+    jmp     .error
+
+.error_eof:
+    mov     rax, INFLATE_ERR_EOF
+
+.error:
+    mov     [rsp+.result], rax
+
+    cmp     rax, INFLATE_ERR_FORMAT
+    jne     .flush_on_error
+
+    ; Invalid data which follows the end of the input is simply
+    ; missing.
+    mov     rax, [rbx+Inflate.overrun]
+    shl     rax, 3
+    cmp     rax, [rbx+Inflate.bitcnt]
+    jbe     .flush_on_error
+
+    mov     qword [rsp+.result], INFLATE_ERR_EOF
+
+.flush_on_error:
+    ; Write what has been decoded (but report the original error).
+    mov     rdi, rbx
+    dcall   inflate_flush
+
+    mov     rax, [rsp+.result]
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Read the next block of input.
+;
+; C prototype equivalent:
+;
+;     ssize_t inflate_fill(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - number of bytes read, 0 at EOF, or
+;   INFLATE_ERR_READ.
+;
+; Notes:
+;
+; Any unconsumed data in the input buffer is discarded.
+;---------------------------------------------------------------------
+
+inflate_fill:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    xor     eax, eax
+    cmp     qword [rbx+Inflate.eof], 0
+    jne     .out
+
+    mov     rdi, [rbx+Inflate.fd]
+    mov     rsi, [rbx+Inflate.in_buf]
+    mov     rdx, INFLATE_IN_SIZE
+    dcall   read_block
+    cmp     rax, 0
+    jl      .error_read
+    jg      .got_data
+
+    mov     qword [rbx+Inflate.eof], 1
+    jmp     .out
+
+.got_data:
+    mov     rcx, [rbx+Inflate.in_buf]
+    mov     [rbx+Inflate.in_pos], rcx
+    add     rcx, rax
+    mov     [rbx+Inflate.in_end], rcx
+    sub     rcx, 8
+    mov     [rbx+Inflate.in_fast], rcx
+    jmp     .out
+
+.error_read:
+    mov     rax, INFLATE_ERR_READ
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Load input into the bit buffer a byte at a time until
+;   it holds at least 56 bits.
+;
+; C prototype equivalent:
+;
+;     int inflate_refill(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_*.
+;
+; Notes:
+;
+; - At EOF, up to 8 zero bytes are loaded (and counted in .overrun)
+;   so that the end of the stream can be decoded without the decoder
+;   having to check how many bits remain. Needing more than that means
+;   the stream is truncated.
+;
+; - inflate_codes() only calls this when fewer than 8 bytes remain in
+;   the input buffer.
+;---------------------------------------------------------------------
+
+inflate_refill:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+.next_byte:
+    ; Never more than 63 bits (so a shift by the count is valid).
+    mov     rcx, [rbx+Inflate.bitcnt]
+    cmp     rcx, 56
+    jae     .success
+
+    mov     rdx, [rbx+Inflate.in_pos]
+    cmp     rdx, [rbx+Inflate.in_end]
+    jae     .empty
+
+    movzx   eax, byte [rdx]
+    inc     qword [rbx+Inflate.in_pos]
+
+.load:
+    shl     rax, cl
+    or      [rbx+Inflate.bitbuf], rax
+    add     qword [rbx+Inflate.bitcnt], 8
+    jmp     .next_byte
+
+.empty:
+    cmp     qword [rbx+Inflate.eof], 0
+    jne     .pad
+
+    mov     rdi, rbx
+    dcall   inflate_fill
+    cmp     rax, 0
+    jl      .out
+    jg      .next_byte
+
+.pad:
+    cmp     qword [rbx+Inflate.overrun], 8
+    jae     .error_eof
+
+    inc     qword [rbx+Inflate.overrun]
+    mov     rcx, [rbx+Inflate.bitcnt]
+    xor     eax, eax
+    jmp     .load
+
+.success:
+    xor     eax, eax
+    jmp     .out
+
+.error_eof:
+    mov     rax, INFLATE_ERR_EOF
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Consume the specified number of bits.
+;
+; C prototype equivalent:
+;
+;     int inflate_bits(Inflate *inf, size_t count);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Input: RSI (integer) - number of bits (at most 32).
+; - Output: RAX (integer) - value of the bits (first bit in the least
+;   significant bit), or INFLATE_ERR_*.
+;---------------------------------------------------------------------
+
+inflate_bits:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .count      equ     0   ; size_t.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+    mov     [rsp+.count], rsi
+
+    cmp     rsi, [rbx+Inflate.bitcnt]
+    jbe     .available
+
+    dcall   inflate_refill
+    cmp     rax, 0
+    jl      .out
+
+.available:
+    mov     rcx, [rsp+.count]
+    mov     eax, 1
+    shl     rax, cl
+    dec     rax
+    and     rax, [rbx+Inflate.bitbuf]
+
+    shr     qword [rbx+Inflate.bitbuf], cl
+    sub     [rbx+Inflate.bitcnt], rcx
+
+.out:
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Write the decoded output, and move the window to the
+;   start of the buffer if the output limit has been reached.
+;
+; C prototype equivalent:
+;
+;     int inflate_flush(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_WRITE.
+;
+; Notes:
+;
+; The CRC and size are updated with the data written.
+;---------------------------------------------------------------------
+
+inflate_flush:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rdx, [rbx+Inflate.out_pos]
+    sub     rdx, [rbx+Inflate.out_flushed]
+    jz      .written
+
+    add     [rbx+Inflate.size], rdx
+
+    mov     rdi, [rbx+Inflate.crc]
+    mov     rsi, [rbx+Inflate.out_flushed]
+    dcall   crc32_update
+    mov     [rbx+Inflate.crc], rax
+
+    mov     rdi, [rbx+Inflate.out_fd]
+    mov     rsi, [rbx+Inflate.out_flushed]
+    mov     rdx, [rbx+Inflate.out_pos]
+    sub     rdx, rsi
+    dcall   write_block
+    cmp     rax, 0
+    jl      .error_write
+
+    mov     rax, [rbx+Inflate.out_pos]
+    mov     [rbx+Inflate.out_flushed], rax
+
+.written:
+    mov     rax, [rbx+Inflate.out_pos]
+    cmp     rax, [rbx+Inflate.out_limit]
+    jb      .success
+
+    ; Keep the window.
+    mov     rdi, [rbx+Inflate.out_buf]
+    lea     rsi, [rax-INFLATE_WINDOW_SIZE]
+    mov     rcx, INFLATE_WINDOW_SIZE
+    rep     movsb
+
+    ; rdi is now the end of the window.
+    mov     [rbx+Inflate.out_pos], rdi
+    mov     [rbx+Inflate.out_flushed], rdi
+
+    ; Move the start of the stream back by the same amount (but not
+    ; beyond the start of the buffer).
+    sub     rax, rdi
+    mov     rcx, [rbx+Inflate.out_start]
+    sub     rcx, rax
+    mov     rdx, [rbx+Inflate.out_buf]
+    cmp     rcx, rdx
+    cmovb   rcx, rdx
+    mov     [rbx+Inflate.out_start], rcx
+
+.success:
+    xor     eax, eax
+    jmp     .out
+
+.error_write:
+    mov     rax, INFLATE_ERR_WRITE
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Copy a stored (uncompressed) block to the output.
+;
+; C prototype equivalent:
+;
+;     int inflate_stored(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate (positioned after the block header).
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_*.
+;---------------------------------------------------------------------
+
+inflate_stored:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .len        equ     0   ; size_t: bytes remaining.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    ; Skip to a byte boundary.
+    mov     rcx, [rbx+Inflate.bitcnt]
+    and     ecx, 7
+    shr     qword [rbx+Inflate.bitbuf], cl
+    sub     [rbx+Inflate.bitcnt], rcx
+
+    ; LEN and NLEN (its one's complement).
+    mov     rdi, rbx
+    mov     rsi, 32
+    dcall   inflate_bits
+    cmp     rax, 0
+    jl      .out
+
+    mov     rcx, rax
+    shr     rcx, 16
+    xor     ecx, eax
+    cmp     cx, 0xffff
+    jne     .error_format
+
+    and     eax, 0xffff
+    mov     [rsp+.len], rax
+
+.next:
+    cmp     qword [rsp+.len], 0
+    je      .success
+
+    mov     rax, [rbx+Inflate.out_pos]
+    cmp     rax, [rbx+Inflate.out_limit]
+    jb      .have_space
+
+    mov     rdi, rbx
+    dcall   inflate_flush
+    cmp     rax, 0
+    jl      .out
+
+.have_space:
+    ; Take whole bytes from the bit buffer first.
+    mov     rax, [rbx+Inflate.bitcnt]
+    cmp     rax, 0
+    je      .from_buffer
+
+    shr     rax, 3
+    cmp     rax, [rbx+Inflate.overrun]
+    jbe     .error_eof
+
+    mov     rdx, [rbx+Inflate.out_pos]
+    mov     al, [rbx+Inflate.bitbuf]
+    mov     [rdx], al
+    inc     qword [rbx+Inflate.out_pos]
+
+    shr     qword [rbx+Inflate.bitbuf], 8
+    sub     qword [rbx+Inflate.bitcnt], 8
+    dec     qword [rsp+.len]
+    jmp     .next
+
+.from_buffer:
+    mov     qword [rbx+Inflate.bitbuf], 0
+
+    mov     rsi, [rbx+Inflate.in_pos]
+    cmp     rsi, [rbx+Inflate.in_end]
+    jb      .copy
+
+    mov     rdi, rbx
+    dcall   inflate_fill
+    cmp     rax, 0
+    jl      .out
+    je      .error_eof
+
+    mov     rsi, [rbx+Inflate.in_pos]
+
+.copy:
+    ; Copy as much as the input, output and block allow.
+    mov     rcx, [rbx+Inflate.in_end]
+    sub     rcx, rsi
+
+    mov     rax, [rbx+Inflate.out_limit]
+    sub     rax, [rbx+Inflate.out_pos]
+    cmp     rcx, rax
+    cmova   rcx, rax
+
+    mov     rax, [rsp+.len]
+    cmp     rcx, rax
+    cmova   rcx, rax
+
+    sub     [rsp+.len], rcx
+    add     [rbx+Inflate.in_pos], rcx
+
+    mov     rdi, [rbx+Inflate.out_pos]
+    rep     movsb
+    mov     [rbx+Inflate.out_pos], rdi
+    jmp     .next
+
+.success:
+    xor     eax, eax
+    jmp     .out
+
+.error_format:
+    mov     rax, INFLATE_ERR_FORMAT
+    jmp     .out
+
+.error_eof:
+    mov     rax, INFLATE_ERR_EOF
+
+.out:
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create the tables for the fixed Huffman codes.
+;
+; C prototype equivalent:
+;
+;     int inflate_fixed(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_FORMAT.
+;
+; Notes:
+;
+; Nothing is done if the tables already hold the fixed codes.
+;---------------------------------------------------------------------
+
+inflate_fixed:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    xor     eax, eax
+    cmp     qword [rbx+Inflate.fixed], 0
+    jne     .out
+
+    ; Literal/length code lengths.
+    lea     rdi, [rbx+Inflate.lens]
+    mov     al, 8
+    mov     rcx, 144
+    rep     stosb
+    mov     al, 9
+    mov     rcx, (256 - 144)
+    rep     stosb
+    mov     al, 7
+    mov     rcx, (280 - 256)
+    rep     stosb
+    mov     al, 8
+    mov     rcx, (288 - 280)
+    rep     stosb
+
+    lea     rdi, [rbx+Inflate.litlen]
+    lea     rsi, [rbx+Inflate.lens]
+    mov     rdx, 288
+    mov     rcx, INFLATE_TYPE_LITLEN
+    dcall   inflate_build
+    cmp     rax, 0
+    jl      .out
+
+    ; Distance code lengths.
+    lea     rdi, [rbx+Inflate.lens]
+    mov     al, 5
+    mov     rcx, 32
+    rep     stosb
+
+    lea     rdi, [rbx+Inflate.dist]
+    lea     rsi, [rbx+Inflate.lens]
+    mov     rdx, 32
+    mov     rcx, INFLATE_TYPE_DIST
+    dcall   inflate_build
+    cmp     rax, 0
+    jl      .out
+
+    mov     qword [rbx+Inflate.fixed], 1
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Read the code lengths of a dynamic Huffman block and
+;   create its tables.
+;
+; C prototype equivalent:
+;
+;     int inflate_dynamic(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate (positioned after the block header).
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_*.
+;---------------------------------------------------------------------
+
+inflate_dynamic:
+section .rodata
+    ; Order the code length code lengths are stored in.
+    .order      db  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .nlitlen    equ     0   ; size_t: number of literal/length codes.
+    .total      equ     8   ; size_t: number of code lengths.
+    .nclens     equ    16   ; size_t: number of code length code lengths.
+    .i          equ    24   ; size_t: index of next length.
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     qword [rbx+Inflate.fixed], 0
+
+    ; HLIT (5 bits), HDIST (5 bits) and HCLEN (4 bits).
+    mov     rsi, 14
+    dcall   inflate_bits
+    cmp     rax, 0
+    jl      .out
+
+    mov     rcx, rax
+    and     rcx, 0x1f
+    add     rcx, 257
+    mov     [rsp+.nlitlen], rcx
+    cmp     rcx, 286
+    ja      .error_format
+
+    mov     rdx, rax
+    shr     rdx, 5
+    and     rdx, 0x1f
+    inc     rdx
+    cmp     rdx, 30
+    ja      .error_format
+
+    add     rcx, rdx
+    mov     [rsp+.total], rcx
+
+    shr     rax, 10
+    add     rax, 4
+    mov     [rsp+.nclens], rax
+
+    ;--------------------
+    ; Code length code lengths.
+
+    lea     rdi, [rbx+Inflate.lens]
+    xor     eax, eax
+    mov     rcx, 19
+    rep     stosb
+
+    mov     qword [rsp+.i], 0
+
+.next_clen:
+    mov     rdi, rbx
+    mov     rsi, 3
+    dcall   inflate_bits
+    cmp     rax, 0
+    jl      .out
+
+    mov     rcx, [rsp+.i]
+    movzx   ecx, byte [.order+rcx]
+    mov     [rbx+Inflate.lens+rcx], al
+
+    inc     qword [rsp+.i]
+    mov     rcx, [rsp+.i]
+    cmp     rcx, [rsp+.nclens]
+    jb      .next_clen
+
+    lea     rdi, [rbx+Inflate.codes]
+    lea     rsi, [rbx+Inflate.lens]
+    mov     rdx, 19
+    mov     rcx, INFLATE_TYPE_CODES
+    dcall   inflate_build
+    cmp     rax, 0
+    jl      .out
+
+    ;--------------------
+    ; Literal/length and distance code lengths.
+
+    mov     qword [rsp+.i], 0
+
+.next_len:
+    mov     rcx, [rsp+.i]
+    cmp     rcx, [rsp+.total]
+    jae     .lens_done
+
+    ; Enough for the longest code and the most extra bits.
+    cmp     qword [rbx+Inflate.bitcnt], (INFLATE_CODES_BITS * 2)
+    jae     .decode_len
+
+    mov     rdi, rbx
+    dcall   inflate_refill
+    cmp     rax, 0
+    jl      .out
+
+.decode_len:
+    mov     rax, [rbx+Inflate.bitbuf]
+    and     eax, (INFLATE_CODES_ENOUGH - 1)
+    mov     eax, [rbx+Inflate.codes+rax*4]
+
+    test    eax, (INFLATE_ENTRY_LITERAL << 8)
+    jz      .error_format
+
+    mov     ecx, eax
+    and     ecx, 0xf
+    shr     qword [rbx+Inflate.bitbuf], cl
+    sub     [rbx+Inflate.bitcnt], rcx
+
+    shr     eax, 16
+    cmp     eax, 16
+    jae     .repeat
+
+    mov     rcx, [rsp+.i]
+    mov     [rbx+Inflate.lens+rcx], al
+    inc     qword [rsp+.i]
+    jmp     .next_len
+
+.repeat:
+    ; Set rdx to the length to repeat, rcx to the number of extra
+    ; bits and r8 to the minimum repeat count.
+    xor     edx, edx
+
+    cmp     eax, 17
+    je      .repeat_zero_short
+    ja      .repeat_zero_long
+
+    ; Repeat the previous length.
+    mov     rcx, [rsp+.i]
+    cmp     rcx, 0
+    je      .error_format
+
+    movzx   edx, byte [rbx+Inflate.lens+rcx-1]
+    mov     ecx, 2
+    mov     r8, 3
+    jmp     .repeat_count
+
+.repeat_zero_short:
+    mov     ecx, 3
+    mov     r8, 3
+    jmp     .repeat_count
+
+.repeat_zero_long:
+    mov     ecx, 7
+    mov     r8, 11
+
+.repeat_count:
+    mov     eax, 1
+    shl     eax, cl
+    dec     eax
+    and     rax, [rbx+Inflate.bitbuf]
+    shr     qword [rbx+Inflate.bitbuf], cl
+    sub     [rbx+Inflate.bitcnt], rcx
+    add     rax, r8
+
+    mov     rcx, [rsp+.i]
+    add     rcx, rax
+    cmp     rcx, [rsp+.total]
+    ja      .error_format
+
+    mov     [rsp+.i], rcx
+
+    lea     rdi, [rbx+Inflate.lens+rcx]
+    sub     rdi, rax
+    mov     rcx, rax
+    mov     eax, edx
+    rep     stosb
+    jmp     .next_len
+
+.lens_done:
+    ; There must be an end of block code.
+    cmp     byte [rbx+Inflate.lens+256], 0
+    je      .error_format
+
+    lea     rdi, [rbx+Inflate.litlen]
+    lea     rsi, [rbx+Inflate.lens]
+    mov     rdx, [rsp+.nlitlen]
+    mov     rcx, INFLATE_TYPE_LITLEN
+    dcall   inflate_build
+    cmp     rax, 0
+    jl      .out
+
+    lea     rdi, [rbx+Inflate.dist]
+    lea     rsi, [rbx+Inflate.lens]
+    add     rsi, [rsp+.nlitlen]
+    mov     rdx, [rsp+.total]
+    sub     rdx, [rsp+.nlitlen]
+    mov     rcx, INFLATE_TYPE_DIST
+    dcall   inflate_build
+    jmp     .out
+
+.error_format:
+    mov     rax, INFLATE_ERR_FORMAT
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Create a decoding table from a set of code lengths.
+;
+; C prototype equivalent:
+;
+;     int inflate_build(uint32_t *table, const uint8_t *lens,
+;                       size_t count, int type);
+;
+; Parameters:
+;
+; - Input: RDI (address) - table (of the size for the type).
+; - Input: RSI (address) - code length of each symbol (0 if unused).
+; - Input: RDX (integer) - number of symbols.
+; - Input: RCX (integer) - INFLATE_TYPE_*.
+; - Output: RAX (integer) - 0 on success, or INFLATE_ERR_FORMAT if the
+;   lengths do not describe a valid code.
+;
+; Notes:
+;
+; - The codes are assigned canonically (RFC 1951 section 3.2.2) in
+;   order of length, then symbol, and stored bit-reversed since the
+;   first bit of a code is the least significant bit of the input.
+;
+; - A code no longer than the first level bits fills every first level
+;   entry that starts with it. Longer codes sharing the same first
+;   level bits share a second level table which is just large enough
+;   for them (the tables follow the first level table).
+;
+; - As with zlib, an over-subscribed set of lengths is rejected, as
+;   is an incomplete set, except for a single code of length 1. No
+;   codes at all is valid (for example, a block with no distances):
+;   decoding any code then fails.
+;
+; See: zlib's inftrees.c.
+;---------------------------------------------------------------------
+
+inflate_build:
+section .rodata
+    ; Indexed by type.
+    .root_table     dq  INFLATE_CODES_BITS, INFLATE_LITLEN_BITS, INFLATE_DIST_BITS
+    .enough_table   dq  INFLATE_CODES_ENOUGH, INFLATE_LITLEN_ENOUGH, INFLATE_DIST_ENOUGH
+
+    ; Base and extra bits of length symbols 257-285.
+    .length_base    dw  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, \
+                        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    .length_extra   db  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, \
+                        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+
+    ; Base and extra bits of distance symbols 0-29.
+    .dist_base      dw  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, \
+                        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, \
+                        8193, 12289, 16385, 24577
+    .dist_extra     db  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, \
+                        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+
+section .text
+    prologue_with_vars 15
+
+    alloc_space (32 + 32 + (288 * 2))
+
+    ;--------------------
+    ; Stack offsets.
+
+    .table      equ     0   ; "uint32_t *"
+    .lens       equ     8   ; "uint8_t *"
+    .n          equ    16   ; size_t: number of symbols.
+    .type       equ    24   ; int.
+    .root       equ    32   ; size_t: first level bits.
+    .max        equ    40   ; size_t: longest code length.
+    .huff       equ    48   ; size_t: current code (bit-reversed).
+    .next       equ    56   ; size_t: index of current table.
+    .curr       equ    64   ; size_t: bits indexing current table.
+    .drop       equ    72   ; size_t: bits of code before current table.
+    .low        equ    80   ; size_t: first level index of current
+                            ; second level table (or -1).
+    .len        equ    88   ; size_t: length of current code.
+    .sym        equ    96   ; size_t: index into .work.
+    .entry      equ   104   ; uint32_t: entry being stored.
+    .left       equ   112   ; ssize_t: unused codes.
+    .count      equ   120   ; uint16_t[16]: codes of each length.
+    .offs       equ   152   ; uint16_t[16]: .work index of each length.
+    .work       equ   184   ; uint16_t[288]: symbols sorted by code.
+
+    ;--------------------
+
+    mov     [rsp+.table], rdi
+    mov     [rsp+.lens], rsi
+    mov     [rsp+.n], rdx
+    mov     [rsp+.type], rcx
+
+    mov     rax, [.root_table+rcx*8]
+    mov     [rsp+.root], rax
+
+    ; Mark every first level entry invalid (so codes that are not
+    ; assigned fail to decode).
+    mov     rcx, rax
+    mov     eax, 1
+    shl     rax, cl
+    mov     rcx, rax
+    xor     eax, eax
+    rep     stosd
+
+    ;--------------------
+    ; Count the codes of each length.
+
+    lea     rdi, [rsp+.count]
+    mov     rcx, 16
+    xor     eax, eax
+    rep     stosw
+
+    xor     ecx, ecx
+
+.count_next:
+    cmp     rcx, [rsp+.n]
+    jae     .counted
+
+    movzx   eax, byte [rsi+rcx]
+    inc     word [rsp+.count+rax*2]
+    inc     rcx
+    jmp     .count_next
+
+.counted:
+    mov     rcx, 15
+
+.find_max:
+    cmp     word [rsp+.count+rcx*2], 0
+    jne     .found_max
+
+    dec     rcx
+    jnz     .find_max
+
+    ; No codes.
+    xor     eax, eax
+    jmp     .out
+
+.found_max:
+    mov     [rsp+.max], rcx
+
+    ; Check the lengths are neither over-subscribed nor incomplete.
+    mov     rax, 1
+    mov     rcx, 1
+
+.check_len:
+    shl     rax, 1
+    movzx   edx, word [rsp+.count+rcx*2]
+    sub     rax, rdx
+    jl      .error_format
+
+    inc     rcx
+    cmp     rcx, 15
+    jbe     .check_len
+
+    cmp     rax, 0
+    je      .complete
+
+    cmp     qword [rsp+.type], INFLATE_TYPE_CODES
+    je      .error_format
+
+    cmp     qword [rsp+.max], 1
+    jne     .error_format
+
+.complete:
+    ;--------------------
+    ; Sort the symbols by code length (then by symbol).
+
+    mov     word [rsp+.offs+2], 0
+    mov     rcx, 1
+
+.next_offset:
+    mov     ax, [rsp+.offs+rcx*2]
+    add     ax, [rsp+.count+rcx*2]
+    mov     [rsp+.offs+rcx*2+2], ax
+
+    inc     rcx
+    cmp     rcx, 15
+    jb      .next_offset
+
+    mov     rsi, [rsp+.lens]
+    xor     ecx, ecx
+
+.sort_next:
+    cmp     rcx, [rsp+.n]
+    jae     .sorted
+
+    movzx   eax, byte [rsi+rcx]
+    cmp     eax, 0
+    je      .sort_skip
+
+    movzx   edx, word [rsp+.offs+rax*2]
+    mov     [rsp+.work+rdx*2], cx
+    inc     word [rsp+.offs+rax*2]
+
+.sort_skip:
+    inc     rcx
+    jmp     .sort_next
+
+.sorted:
+    ;--------------------
+    ; Fill the tables.
+
+    xor     eax, eax
+    mov     [rsp+.huff], rax
+    mov     [rsp+.next], rax
+    mov     [rsp+.drop], rax
+    mov     [rsp+.sym], rax
+    mov     qword [rsp+.low], -1
+
+    mov     rax, [rsp+.root]
+    mov     [rsp+.curr], rax
+
+    ; The first symbol has the shortest code.
+    movzx   eax, word [rsp+.work]
+    movzx   eax, byte [rsi+rax]
+    mov     [rsp+.len], rax
+
+.next_symbol:
+    ;--------------------
+    ; Create the entry for the symbol (without the code length).
+
+    mov     rcx, [rsp+.sym]
+    movzx   ecx, word [rsp+.work+rcx*2]
+
+    cmp     qword [rsp+.type], INFLATE_TYPE_DIST
+    je      .dist_symbol
+
+    cmp     ecx, 256
+    jb      .literal_symbol
+    je      .end_symbol
+
+    sub     ecx, 257
+    cmp     ecx, 29
+    jae     .invalid_symbol
+
+    movzx   eax, word [.length_base+rcx*2]
+    shl     eax, 16
+    movzx   edx, byte [.length_extra+rcx]
+    jmp     .length_symbol
+
+.dist_symbol:
+    cmp     ecx, 30
+    jae     .invalid_symbol
+
+    movzx   eax, word [.dist_base+rcx*2]
+    shl     eax, 16
+    movzx   edx, byte [.dist_extra+rcx]
+
+.length_symbol:
+    shl     edx, 4
+    or      eax, edx
+    or      eax, (INFLATE_ENTRY_LENGTH << 8)
+    jmp     .have_entry
+
+.literal_symbol:
+    mov     eax, ecx
+    shl     eax, 16
+    or      eax, (INFLATE_ENTRY_LITERAL << 8)
+    jmp     .have_entry
+
+.end_symbol:
+    mov     eax, (INFLATE_ENTRY_END << 8)
+    jmp     .have_entry
+
+.invalid_symbol:
+    xor     eax, eax
+
+.have_entry:
+    ; Bits of the code in the current table.
+    mov     rcx, [rsp+.len]
+    sub     rcx, [rsp+.drop]
+    or      eax, ecx
+    mov     [rsp+.entry], eax
+
+    ;--------------------
+    ; Store the entry at every index that starts with the code:
+    ;
+    ;   incr = 1 << (len - drop)
+    ;   fill = 1 << curr
+    ;   do { fill -= incr; table[next + (huff >> drop) + fill] = entry; } while (fill)
+
+    mov     r9d, 1
+    shl     r9, cl ; incr.
+
+    mov     rcx, [rsp+.curr]
+    mov     r10d, 1
+    shl     r10, cl ; fill.
+
+    mov     rdx, [rsp+.huff]
+    mov     rcx, [rsp+.drop]
+    shr     rdx, cl
+    add     rdx, [rsp+.next]
+    shl     rdx, 2
+    add     rdx, [rsp+.table]
+
+.fill:
+    sub     r10, r9
+    mov     [rdx+r10*4], eax
+    jnz     .fill
+
+    ;--------------------
+    ; Increment the bit-reversed code:
+    ;
+    ;   incr = 1 << (len - 1)
+    ;   while (huff & incr) incr >>= 1
+    ;   huff = incr ? (huff & (incr - 1)) + incr : 0
+
+    mov     rcx, [rsp+.len]
+    dec     rcx
+    mov     edx, 1
+    shl     rdx, cl
+    mov     rax, [rsp+.huff]
+
+.reverse_carry:
+    test    rax, rdx
+    jz      .reverse_carried
+
+    shr     rdx, 1
+    jmp     .reverse_carry
+
+.reverse_carried:
+    test    rdx, rdx
+    jz      .reverse_wrapped
+
+    lea     rcx, [rdx-1]
+    and     rax, rcx
+    add     rax, rdx
+    jmp     .reversed
+
+.reverse_wrapped:
+    xor     eax, eax
+
+.reversed:
+    mov     [rsp+.huff], rax
+
+    ;--------------------
+    ; Move to the next symbol.
+
+    inc     qword [rsp+.sym]
+
+    mov     rcx, [rsp+.len]
+    dec     word [rsp+.count+rcx*2]
+    jnz     .same_length
+
+    cmp     rcx, [rsp+.max]
+    je      .success
+
+    mov     rcx, [rsp+.sym]
+    movzx   ecx, word [rsp+.work+rcx*2]
+    mov     rsi, [rsp+.lens]
+    movzx   ecx, byte [rsi+rcx]
+    mov     [rsp+.len], rcx
+
+.same_length:
+    ; Start a new second level table when a long code no longer shares
+    ; the first level bits of the previous one.
+    mov     rcx, [rsp+.len]
+    cmp     rcx, [rsp+.root]
+    jbe     .next_symbol
+
+    mov     rcx, [rsp+.root]
+    mov     eax, 1
+    shl     rax, cl
+    dec     rax
+    and     rax, [rsp+.huff]
+    cmp     rax, [rsp+.low]
+    je      .next_symbol
+
+    cmp     qword [rsp+.drop], 0
+    jne     .have_drop
+
+    mov     [rsp+.drop], rcx
+
+.have_drop:
+    ; Skip the table just filled.
+    mov     rcx, [rsp+.curr]
+    mov     eax, 1
+    shl     rax, cl
+    add     [rsp+.next], rax
+
+    ; Find the number of bits needed for the codes that share these
+    ; first level bits:
+    ;
+    ;   curr = len - drop; left = 1 << curr
+    ;   while (curr + drop < max) {
+    ;       left -= count[curr + drop];
+    ;       if (left <= 0) break;
+    ;       curr++; left <<= 1;
+    ;   }
+
+    mov     rcx, [rsp+.len]
+    sub     rcx, [rsp+.drop]
+    mov     eax, 1
+    shl     rax, cl
+
+.size_table:
+    mov     rdx, rcx
+    add     rdx, [rsp+.drop]
+    cmp     rdx, [rsp+.max]
+    jae     .sized
+
+    movzx   edx, word [rsp+.count+rdx*2]
+    sub     rax, rdx
+    jle     .sized
+
+    inc     rcx
+    shl     rax, 1
+    jmp     .size_table
+
+.sized:
+    mov     [rsp+.curr], rcx
+
+    ; Check the table fits.
+    mov     eax, 1
+    shl     rax, cl
+    add     rax, [rsp+.next]
+    mov     rdx, [rsp+.type]
+    cmp     rax, [.enough_table+rdx*8]
+    ja      .error_format
+
+    ; Point the first level entry at the new table.
+    mov     rcx, [rsp+.root]
+    mov     eax, 1
+    shl     rax, cl
+    dec     rax
+    and     rax, [rsp+.huff]
+    mov     [rsp+.low], rax
+
+    mov     edx, [rsp+.next]
+    shl     edx, 16
+    or      edx, (INFLATE_ENTRY_SUBTABLE << 8)
+    mov     r8, [rsp+.curr]
+    shl     r8d, 4
+    or      edx, r8d
+    or      edx, ecx
+
+    mov     rdi, [rsp+.table]
+    mov     [rdi+rax*4], edx
+    jmp     .next_symbol
+
+.success:
+    xor     eax, eax
+    jmp     .out
+
+.error_format:
+    mov     rax, INFLATE_ERR_FORMAT
+
+.out:
+    free_space (32 + 32 + (288 * 2))
+    epilogue_with_vars 15
+    ret
+
+;---------------------------------------------------------------------
+; Description: Decode the codes of a compressed block.
+;
+; C prototype equivalent:
+;
+;     int inflate_codes(Inflate *inf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Inflate (with the tables for the block).
+; - Output: RAX (integer) - 0 at the end of the block, or
+;   INFLATE_ERR_*.
+;
+; Notes:
+;
+; - The state is kept in registers while decoding:
+;
+;     rbx: bit buffer.
+;     r8:  number of bits in the bit buffer.
+;     rsi: input position.
+;     rdi: output position.
+;     r11: Inflate.
+;
+; - The bit buffer is refilled (to at least 56 bits) before each
+;   symbol, which is enough for a whole match, so decoding never
+;   needs to check for more input. After a literal, the next symbol
+;   is decoded without refilling if enough bits remain.
+;
+; - Near the end of the input, every symbol is followed by a check
+;   that it did not use the zero bytes loaded after EOF (see
+;   inflate_refill()). If it did, the stream is truncated and the
+;   output of that symbol is discarded.
+;
+; - Output is only flushed between symbols: since a symbol is only
+;   decoded below .out_limit, a match (or over-copy) can never reach
+;   the end of the buffer.
+;
+; - Matches are copied in 16 (or 8) byte chunks, which is safe when
+;   the chunk is no longer than the distance since the source is then
+;   always output that has already been written. Shorter distances
+;   store 8 bytes but only advance by the distance (after which the
+;   next 8 bytes are again correct), except for a distance of 1 which
+;   stores the byte repeated 8 times. Chunks may write beyond the end
+;   of the match, into the space which follows.
+;---------------------------------------------------------------------
+
+inflate_codes:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .inf        equ     0   ; "Inflate *"
+    .sym_out    equ     8   ; "char *": output position before the
+                            ; last symbol decoded by the slow path.
+
+    ;--------------------
+
+    mov     [rsp+.inf], rdi
+    mov     r11, rdi
+
+    mov     rbx, [r11+Inflate.bitbuf]
+    mov     r8, [r11+Inflate.bitcnt]
+    mov     rsi, [r11+Inflate.in_pos]
+    mov     rdi, [r11+Inflate.out_pos]
+    mov     [rsp+.sym_out], rdi
+
+.next_symbol:
+    cmp     rsi, [r11+Inflate.in_fast]
+    ja      .slow_refill
+
+    ; Load 8 bytes above the current bits and consume the whole bytes
+    ; that fit (the bits above the count are then the next bits of
+    ; the stream).
+    mov     rax, [rsi]
+    mov     ecx, r8d
+    shl     rax, cl
+    or      rbx, rax
+
+    mov     eax, 63
+    sub     eax, r8d
+    shr     eax, 3
+    add     rsi, rax
+    lea     r8d, [r8+rax*8]
+
+.refilled:
+    cmp     rdi, [r11+Inflate.out_limit]
+    jae     .flush
+
+.decode:
+    mov     eax, ebx
+    and     eax, ((1 << INFLATE_LITLEN_BITS) - 1)
+    mov     eax, [r11+Inflate.litlen+rax*4]
+
+.litlen_entry:
+    mov     ecx, eax
+    and     ecx, 0xf
+
+    test    eax, (INFLATE_ENTRY_LITERAL << 8)
+    jz      .not_literal
+
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    shr     eax, 16
+    mov     [rdi], al
+    inc     rdi
+
+    cmp     r8d, INFLATE_MAX_MATCH_BITS
+    jb      .next_symbol
+
+    ; Near the end of the input, check each symbol.
+    cmp     rsi, [r11+Inflate.in_fast]
+    ja      .slow_refill
+
+    cmp     rdi, [r11+Inflate.out_limit]
+    jb      .decode
+    jmp     .flush
+
+.not_literal:
+    test    eax, (INFLATE_ENTRY_LENGTH << 8)
+    jz      .not_length
+
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    ; r9 = base length + extra bits.
+    mov     ecx, eax
+    shr     ecx, 4
+    and     ecx, 0xf
+    mov     edx, 1
+    shl     edx, cl
+    dec     edx
+    and     edx, ebx
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    shr     eax, 16
+    lea     r9d, [rax+rdx]
+
+    ;--------------------
+    ; Distance.
+
+    mov     eax, ebx
+    and     eax, ((1 << INFLATE_DIST_BITS) - 1)
+    mov     eax, [r11+Inflate.dist+rax*4]
+
+    mov     ecx, eax
+    and     ecx, 0xf
+
+    test    eax, (INFLATE_ENTRY_SUBTABLE << 8)
+    jz      .dist_entry
+
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    mov     ecx, eax
+    shr     ecx, 4
+    and     ecx, 0xf
+    mov     edx, 1
+    shl     edx, cl
+    dec     edx
+    and     edx, ebx
+
+    shr     eax, 16
+    add     eax, edx
+    mov     eax, [r11+Inflate.dist+rax*4]
+
+    mov     ecx, eax
+    and     ecx, 0xf
+
+.dist_entry:
+    test    eax, (INFLATE_ENTRY_LENGTH << 8)
+    jz      .error_format
+
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    ; r10 = base distance + extra bits.
+    mov     ecx, eax
+    shr     ecx, 4
+    and     ecx, 0xf
+    mov     edx, 1
+    shl     edx, cl
+    dec     edx
+    and     edx, ebx
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    shr     eax, 16
+    lea     r10d, [rax+rdx]
+
+    ; rax = source.
+    mov     rax, rdi
+    sub     rax, r10
+    cmp     rax, [r11+Inflate.out_start]
+    jb      .error_format
+
+    ;--------------------
+    ; Copy the match.
+
+    cmp     r10, 16
+    jb      .copy_near
+
+.copy_16:
+    movdqu  xmm0, [rax]
+    movdqu  [rdi], xmm0
+    add     rax, 16
+    add     rdi, 16
+    sub     r9, 16
+    jg      .copy_16
+
+    ; Undo the over-copy.
+    add     rdi, r9
+    jmp     .next_symbol
+
+.copy_near:
+    cmp     r10, 8
+    jb      .copy_short
+
+.copy_8:
+    mov     rdx, [rax]
+    mov     [rdi], rdx
+    add     rax, 8
+    add     rdi, 8
+    sub     r9, 8
+    jg      .copy_8
+
+    add     rdi, r9
+    jmp     .next_symbol
+
+.copy_short:
+    cmp     r10, 1
+    je      .copy_repeat
+
+.copy_pattern:
+    mov     rdx, [rax]
+    mov     [rdi], rdx
+    add     rax, r10
+    add     rdi, r10
+    sub     r9, r10
+    jg      .copy_pattern
+
+    add     rdi, r9
+    jmp     .next_symbol
+
+.copy_repeat:
+    movzx   edx, byte [rax]
+    mov     rcx, 0x0101010101010101
+    imul    rdx, rcx
+
+.copy_repeat_next:
+    mov     [rdi], rdx
+    add     rdi, 8
+    sub     r9, 8
+    jg      .copy_repeat_next
+
+    add     rdi, r9
+    jmp     .next_symbol
+
+.not_length:
+    test    eax, (INFLATE_ENTRY_SUBTABLE << 8)
+    jz      .not_subtable
+
+    ; Consume the first level bits and look up the rest of the code.
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    mov     ecx, eax
+    shr     ecx, 4
+    and     ecx, 0xf
+    mov     edx, 1
+    shl     edx, cl
+    dec     edx
+    and     edx, ebx
+
+    shr     eax, 16
+    add     eax, edx
+    mov     eax, [r11+Inflate.litlen+rax*4]
+    jmp     .litlen_entry
+
+.not_subtable:
+    test    eax, (INFLATE_ENTRY_END << 8)
+    jz      .error_format
+
+    shr     rbx, cl
+    sub     r8d, ecx
+
+    xor     eax, eax
+    jmp     .out
+
+.slow_refill:
+    ; The zero bytes loaded after EOF must not have been consumed by
+    ; the last symbol.
+    mov     rax, [r11+Inflate.overrun]
+    shl     rax, 3
+    cmp     rax, r8
+    ja      .truncated
+
+    mov     [rsp+.sym_out], rdi
+
+    mov     [r11+Inflate.bitbuf], rbx
+    mov     [r11+Inflate.bitcnt], r8
+    mov     [r11+Inflate.in_pos], rsi
+    mov     [r11+Inflate.out_pos], rdi
+
+    mov     rdi, r11
+    dcall   inflate_refill
+    cmp     rax, 0
+    jl      .error
+
+    mov     r11, [rsp+.inf]
+    mov     rbx, [r11+Inflate.bitbuf]
+    mov     r8, [r11+Inflate.bitcnt]
+    mov     rsi, [r11+Inflate.in_pos]
+    mov     rdi, [r11+Inflate.out_pos]
+    jmp     .refilled
+
+.flush:
+    mov     [r11+Inflate.bitbuf], rbx
+    mov     [r11+Inflate.bitcnt], r8
+    mov     [r11+Inflate.in_pos], rsi
+    mov     [r11+Inflate.out_pos], rdi
+
+    mov     rdi, r11
+    dcall   inflate_flush
+    cmp     rax, 0
+    jl      .error
+
+    mov     r11, [rsp+.inf]
+    mov     rbx, [r11+Inflate.bitbuf]
+    mov     r8, [r11+Inflate.bitcnt]
+    mov     rsi, [r11+Inflate.in_pos]
+    mov     rdi, [r11+Inflate.out_pos]
+
+    ; The output has moved.
+    mov     [rsp+.sym_out], rdi
+    jmp     .decode
+
+.truncated:
+    mov     rdi, [rsp+.sym_out]
+    mov     rax, INFLATE_ERR_EOF
+    jmp     .out
+
+.error_format:
+    mov     rax, INFLATE_ERR_FORMAT
+
+.out:
+    mov     r11, [rsp+.inf]
+    mov     [r11+Inflate.bitbuf], rbx
+    mov     [r11+Inflate.bitcnt], r8
+    mov     [r11+Inflate.in_pos], rsi
+    mov     [r11+Inflate.out_pos], rdi
+
+.error:
+    epilogue_with_vars 2
+    ret
@@ -0,0 +1,492 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+
+global inode_set_add
+global inode_set_free
+global inode_set_new
+
+extern aligned_alloc
+extern calloc
+extern free
+extern memset
+extern pthread_mutex_destroy
+extern pthread_mutex_init
+extern pthread_mutex_lock
+extern pthread_mutex_unlock
+
+; Number of independently locked parts of the set.
+%assign INODE_SET_STRIPE_BITS       6
+%assign INODE_SET_STRIPES           (1 << INODE_SET_STRIPE_BITS)
+
+; Initial number of slots in a stripe (must be a power of two).
+%assign INODE_SET_INITIAL_SLOTS     64
+
+; Multiplier used by inode_set_hash() (from MurmurHash2).
+%assign INODE_SET_HASH_MULTIPLIER   0x5bd1e995
+
+;---------------------------------------------------------------------
+; A single slot of a stripe table. A slot is unused if .ino is zero
+; (which is never a valid inode number).
+;---------------------------------------------------------------------
+struc InodeSlot
+    .dev        resq    1 ; uint64_t: device number.
+    .ino        resq    1 ; uint64_t: inode number.
+endstruc
+
+;---------------------------------------------------------------------
+; An open addressed hash table holding part of the set, with its own
+; lock. Each stripe fills a cache line, so threads using different
+; stripes do not slow each other down.
+;---------------------------------------------------------------------
+struc InodeStripe
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    .lock       resb    PTHREAD_MUTEX_T_SIZE ; pthread_mutex_t.
+    .slots      resq    1 ; "InodeSlot *": table.
+    .count      resq    1 ; size_t: number of used slots.
+    .mask       resq    1 ; size_t: number of slots - 1.
+endstruc
+
+; The whole set.
+INODE_SET_SIZE      equ     (InodeStripe_size * INODE_SET_STRIPES)
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Create a set of (device, inode) pairs that can be
+;   updated by multiple threads at once.
+;
+; C prototype equivalent:
+;
+;     InodeSet *inode_set_new(void);
+;
+; Parameters:
+;
+; - Output: RAX (address) - new set, or 0 on error.
+;
+; Notes:
+;
+; - Used to find hard links to files that have already been seen.
+;
+; - The set is split into stripes, each with its own lock, so threads
+;   adding different inodes rarely wait for each other.
+;
+; See: inode_set_add(), inode_set_free().
+;---------------------------------------------------------------------
+
+inode_set_new:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .set        equ     0   ; "InodeSet *"
+    .i          equ     8   ; size_t: stripe index.
+
+    ;--------------------
+
+    mov     rdi, CACHE_LINE_SIZE
+    mov     rsi, INODE_SET_SIZE
+    dcall   aligned_alloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.set], rax
+
+    mov     rdi, rax
+    mov     rsi, 0
+    mov     rdx, INODE_SET_SIZE
+    dcall   memset
+
+    mov     qword [rsp+.i], 0
+
+.next_stripe:
+    mov     rax, [rsp+.i]
+    cmp     rax, INODE_SET_STRIPES
+    je      .done
+
+    imul    rdi, rax, InodeStripe_size
+    add     rdi, [rsp+.set]
+    add     rdi, InodeStripe.lock
+    mov     rsi, 0 ; Default attributes.
+    dcall   pthread_mutex_init
+
+    inc     qword [rsp+.i]
+    jmp     .next_stripe
+
+.done:
+    mov     rax, [rsp+.set]
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Free a set created by inode_set_new().
+;
+; C prototype equivalent:
+;
+;     void inode_set_free(InodeSet *set);
+;
+; Parameters:
+;
+; - Input: RDI (address) - set (may be 0).
+; - Output: None.
+;---------------------------------------------------------------------
+
+inode_set_free:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .set        equ     0   ; "InodeSet *"
+    .i          equ     8   ; size_t: stripe index.
+
+    ;--------------------
+
+    cmp     rdi, 0
+    je      .out
+
+    mov     [rsp+.set], rdi
+    mov     qword [rsp+.i], 0
+
+.next_stripe:
+    mov     rax, [rsp+.i]
+    cmp     rax, INODE_SET_STRIPES
+    je      .free_set
+
+    imul    rbx, rax, InodeStripe_size
+    add     rbx, [rsp+.set]
+
+    mov     rdi, [rbx+InodeStripe.slots]
+    dcall   free
+
+    lea     rdi, [rbx+InodeStripe.lock]
+    dcall   pthread_mutex_destroy
+
+    inc     qword [rsp+.i]
+    jmp     .next_stripe
+
+.free_set:
+    mov     rdi, [rsp+.set]
+    dcall   free
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Add a (device, inode) pair to a set.
+;
+; C prototype equivalent:
+;
+;     int inode_set_add(InodeSet *set, uint64_t dev, uint64_t ino);
+;
+; Parameters:
+;
+; - Input: RDI (address) - set.
+; - Input: RSI (integer) - device number.
+; - Input: RDX (integer) - inode number (must not be zero).
+; - Output: RAX (integer) - 1 if the pair was added, 0 if it was
+;   already in the set, or -1 on error.
+;
+; Notes:
+;
+; - The low bits of the hash select the stripe and the remaining bits
+;   the starting slot, so the slots used in each stripe are still
+;   evenly spread.
+;
+; - A stripe table is doubled in size when half full, which keeps the
+;   linear probe sequences short.
+;---------------------------------------------------------------------
+
+inode_set_add:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .dev        equ     0   ; uint64_t
+    .ino        equ     8   ; uint64_t
+    .hash       equ    16   ; uint64_t
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.dev], rsi
+    mov     [rsp+.ino], rdx
+
+    ;--------------------
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rdi, rsi
+    mov     rsi, rdx
+    dcall   inode_set_hash
+    mov     [rsp+.hash], rax
+
+    ; rbx = &set->stripes[hash % INODE_SET_STRIPES]
+    and     rax, (INODE_SET_STRIPES - 1)
+    imul    rax, rax, InodeStripe_size
+    add     rbx, rax
+
+    lea     rdi, [rbx+InodeStripe.lock]
+    dcall   pthread_mutex_lock
+
+    ;--------------------
+    ; Grow the table if it is half full (or does not exist yet).
+
+    cmp     qword [rbx+InodeStripe.slots], 0
+    je      .grow
+
+    mov     rax, [rbx+InodeStripe.count]
+    shl     rax, 1
+    cmp     rax, [rbx+InodeStripe.mask]
+    jbe     .find
+
+.grow:
+    mov     rdi, rbx
+    dcall   inode_set_grow
+    cmp     rax, 0
+    jne     .error
+
+.find:
+    ;--------------------
+    ; Linear probe for the pair or an unused slot.
+
+    mov     rdi, [rbx+InodeStripe.slots]
+    mov     r8, [rbx+InodeStripe.mask]
+    mov     rsi, [rsp+.dev]
+    mov     rdx, [rsp+.ino]
+
+    mov     rcx, [rsp+.hash]
+    shr     rcx, INODE_SET_STRIPE_BITS
+    and     rcx, r8
+
+.probe:
+    mov     rax, rcx
+    shl     rax, 4 ; Multiply by InodeSlot_size.
+
+    mov     r9, [rdi+rax+InodeSlot.ino]
+    cmp     r9, 0
+    je      .insert
+
+    cmp     r9, rdx
+    jne     .next_slot
+
+    cmp     [rdi+rax+InodeSlot.dev], rsi
+    je      .found
+
+.next_slot:
+    inc     rcx
+    and     rcx, r8
+    jmp     .probe
+
+.insert:
+    mov     [rdi+rax+InodeSlot.dev], rsi
+    mov     [rdi+rax+InodeSlot.ino], rdx
+    inc     qword [rbx+InodeStripe.count]
+
+    mov     qword [rsp+.ret], 1
+    jmp     .unlock
+
+.found:
+    mov     qword [rsp+.ret], 0
+    jmp     .unlock
+
+.error:
+    mov     qword [rsp+.ret], -1
+
+.unlock:
+    lea     rdi, [rbx+InodeStripe.lock]
+    dcall   pthread_mutex_unlock
+
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Double the size of a stripe table (or create it).
+;
+; C prototype equivalent:
+;
+;     int inode_set_grow(InodeStripe *stripe);
+;
+; Parameters:
+;
+; - Input: RDI (address) - locked stripe.
+; - Output: RAX (integer) - 0 on success, or -1 on error (the
+;   stripe is unchanged).
+;---------------------------------------------------------------------
+
+inode_set_grow:
+    prologue_with_vars 6
+
+    ;--------------------
+    ; Stack offsets.
+
+    .stripe     equ     0   ; "InodeStripe *"
+    .old        equ     8   ; "InodeSlot *": old table.
+    .old_slots  equ    16   ; size_t: number of slots in old table.
+    .new        equ    24   ; "InodeSlot *": new table.
+    .mask       equ    32   ; size_t: new mask.
+    .i          equ    40   ; size_t: old slot index.
+
+    ;--------------------
+
+    mov     [rsp+.stripe], rdi
+
+    mov     rax, [rdi+InodeStripe.slots]
+    mov     [rsp+.old], rax
+
+    mov     qword [rsp+.old_slots], 0
+    mov     rsi, INODE_SET_INITIAL_SLOTS
+
+    cmp     rax, 0
+    je      .alloc
+
+    mov     rsi, [rdi+InodeStripe.mask]
+    inc     rsi
+    mov     [rsp+.old_slots], rsi
+    shl     rsi, 1
+
+.alloc:
+    mov     rax, rsi
+    dec     rax
+    mov     [rsp+.mask], rax
+
+    mov     rdi, rsi
+    mov     rsi, InodeSlot_size
+    dcall   calloc
+    cmp     rax, 0
+    je      .error
+
+    mov     [rsp+.new], rax
+
+    ;--------------------
+    ; Move the pairs to the new table.
+
+    mov     qword [rsp+.i], 0
+
+.next_old:
+    mov     rax, [rsp+.i]
+    cmp     rax, [rsp+.old_slots]
+    je      .done
+
+    shl     rax, 4 ; Multiply by InodeSlot_size.
+    add     rax, [rsp+.old]
+
+    mov     rdi, [rax+InodeSlot.dev]
+    mov     rsi, [rax+InodeSlot.ino]
+    cmp     rsi, 0
+    je      .old_done
+
+    dcall   inode_set_hash
+
+    mov     rcx, rax
+    shr     rcx, INODE_SET_STRIPE_BITS
+
+    mov     rax, [rsp+.i]
+    shl     rax, 4 ; Multiply by InodeSlot_size.
+    add     rax, [rsp+.old]
+    movdqu  xmm0, [rax]
+
+    mov     rdi, [rsp+.new]
+    mov     r8, [rsp+.mask]
+
+.probe:
+    and     rcx, r8
+    mov     rdx, rcx
+    shl     rdx, 4 ; Multiply by InodeSlot_size.
+
+    cmp     qword [rdi+rdx+InodeSlot.ino], 0
+    je      .move
+
+    inc     rcx
+    jmp     .probe
+
+.move:
+    movdqu  [rdi+rdx], xmm0
+
+.old_done:
+    inc     qword [rsp+.i]
+    jmp     .next_old
+
+.done:
+    mov     rdi, [rsp+.old]
+    dcall   free
+
+    mov     rdi, [rsp+.stripe]
+    mov     rax, [rsp+.new]
+    mov     [rdi+InodeStripe.slots], rax
+    mov     rax, [rsp+.mask]
+    mov     [rdi+InodeStripe.mask], rax
+
+    xor     rax, rax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 6
+    ret
+
+;---------------------------------------------------------------------
+; Description: Calculate the hash of a (device, inode) pair.
+;
+; C prototype equivalent:
+;
+;     uint64_t inode_set_hash(uint64_t dev, uint64_t ino);
+;
+; Parameters:
+;
+; - Input: RDI (integer) - device number.
+; - Input: RSI (integer) - inode number.
+; - Output: RAX (integer) - hash.
+;
+; Notes:
+;
+; Inode numbers are often sequential, so the bits are mixed to ensure
+; the low bits (which select the stripe) vary.
+;---------------------------------------------------------------------
+
+inode_set_hash:
+    prologue_with_vars 0
+
+    mov     rax, rdi
+    rol     rax, 32
+    xor     rax, rsi
+
+    mov     rdx, rax
+    shr     rdx, 33
+    xor     rax, rdx
+    imul    rax, rax, INODE_SET_HASH_MULTIPLIER
+
+    mov     rdx, rax
+    shr     rdx, 29
+    xor     rax, rdx
+    imul    rax, rax, INODE_SET_HASH_MULTIPLIER
+
+    mov     rdx, rax
+    shr     rdx, 32
+    xor     rax, rdx
+
+    epilogue_with_vars 0
+    ret
@@ -0,0 +1,1067 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+%include "prefetch.inc"
+
+global prefetch_end
+global prefetch_next
+global prefetch_read
+global prefetch_start
+
+extern arena_alloc
+extern futex_wait
+extern futex_wake
+extern read_block
+
+extern close
+extern free
+extern malloc
+extern open
+extern posix_fadvise
+extern pthread_create
+extern pthread_join
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Start reading a set of files in parallel.
+;
+; C prototype equivalent:
+;
+;     int prefetch_start(Prefetch *pf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch (with .paths, .count, .nthreads,
+;   .limit and .max_bytes set).
+; - Output: RAX (integer) - 0 on success, or -1 if no reader thread
+;   could be started (in which case nothing has been read and the
+;   caller should read the files itself).
+;
+; Notes:
+;
+; - Each reader thread takes the next unread file (in argument
+;   order), opens it and reads it into a list of PrefetchBlock's,
+;   then moves on to the next file. So up to .nthreads files are read
+;   at the same time, which hides the latency of slow storage.
+;
+; - The data is consumed (on the calling thread) strictly in argument
+;   order by calling prefetch_read() until it returns 0 (or an error)
+;   and then prefetch_next() for each file.
+;
+; - The total size of the blocks that have been read but not yet
+;   consumed is capped at .limit. A reader that would exceed the cap
+;   sleeps until the consumer frees some blocks, unless the consumer
+;   is waiting for the file it is reading. Readers check the cap
+;   independently, so it can be exceeded by up to one block per
+;   thread.
+;
+; - Files named "-" are read from stdin by prefetch_read() (on the
+;   calling thread) when their turn comes.
+;
+; - prefetch_end() must be called to stop the threads and free
+;   everything, even if the files have not all been consumed.
+;
+; - The file and thread arrays are allocated from the arena (so this
+;   function must be called on the thread that owns it). The data
+;   blocks are allocated with malloc(3) since the reader threads
+;   allocate them while the consumer is running (and the arena is not
+;   thread-safe), and each block is freed as soon as it is consumed to
+;   keep the buffered data under .limit. The stdin buffer is the same
+;   size as a block, so it also uses malloc(3).
+;
+; See: prefetch_read(), prefetch_next(), prefetch_end().
+;---------------------------------------------------------------------
+
+prefetch_start:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+    .i          equ     8   ; size_t: file or thread index.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.pf], rdi
+
+    ;--------------------
+
+    xor     eax, eax
+    mov     [rdi+Prefetch.files], rax
+    mov     [rdi+Prefetch.threads], rax
+    mov     [rdi+Prefetch.started], rax
+    mov     [rdi+Prefetch.buffer], rax
+    mov     [rdi+Prefetch.turn], rax
+    mov     [rdi+Prefetch.claim], rax
+    mov     [rdi+Prefetch.used], rax
+    mov     [rdi+Prefetch.stop], rax
+    mov     [rdi+Prefetch.seq], eax
+    mov     [rdi+Prefetch.sleepers], eax
+
+    cmp     qword [rdi+Prefetch.limit], 0
+    jne     .limit_set
+
+    mov     qword [rdi+Prefetch.limit], PREFETCH_DEFAULT_LIMIT
+
+.limit_set:
+    ;--------------------
+    ; nthreads = min(nthreads, count, PREFETCH_MAX_THREADS)
+
+    mov     rax, [rdi+Prefetch.nthreads]
+    cmp     rax, [rdi+Prefetch.count]
+    jbe     .count_ok
+
+    mov     rax, [rdi+Prefetch.count]
+
+.count_ok:
+    cmp     rax, PREFETCH_MAX_THREADS
+    jbe     .max_ok
+
+    mov     rax, PREFETCH_MAX_THREADS
+
+.max_ok:
+    cmp     rax, 0
+    je      .error
+
+    mov     [rdi+Prefetch.nthreads], rax
+
+    ;--------------------
+    ; Create the files, each heading an empty list of blocks.
+
+    imul    rdi, [rdi+Prefetch.count], PrefetchFile_size
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error
+
+    mov     rdi, [rsp+.pf]
+    mov     [rdi+Prefetch.files], rax
+
+    ; Clear the files (arena memory may have been used before).
+    mov     rdi, rax
+    mov     rax, [rsp+.pf]
+    imul    rcx, [rax+Prefetch.count], PrefetchFile_size
+    xor     eax, eax
+    cld
+    rep     stosb
+
+    mov     qword [rsp+.i], 0
+
+.next_file:
+    mov     rdi, [rsp+.pf]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Prefetch.count]
+    je      .files_ready
+
+    imul    rbx, rax, PrefetchFile_size
+    add     rbx, [rdi+Prefetch.files]
+
+    mov     [rbx+PrefetchFile.last], rbx
+    mov     [rbx+PrefetchFile.prev], rbx
+
+    inc     qword [rsp+.i]
+    jmp     .next_file
+
+.files_ready:
+    ;--------------------
+    ; Start the threads.
+
+    mov     rdi, [rdi+Prefetch.nthreads]
+    shl     rdi, 3 ; * PTR_SIZE
+    dcall   arena_alloc
+    cmp     rax, 0
+    je      .error_clear
+
+    mov     rdi, [rsp+.pf]
+    mov     [rdi+Prefetch.threads], rax
+
+.next_thread:
+    mov     rdi, [rsp+.pf]
+    mov     rax, [rdi+Prefetch.started]
+    cmp     rax, [rdi+Prefetch.nthreads]
+    je      .success
+
+    mov     rcx, rdi
+    mov     rdi, [rdi+Prefetch.threads]
+    lea     rdi, [rdi+rax*PTR_SIZE]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, prefetch_worker
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .threads_started ; Make do with the threads already running.
+
+    mov     rdi, [rsp+.pf]
+    inc     qword [rdi+Prefetch.started]
+    jmp     .next_thread
+
+.threads_started:
+    mov     rdi, [rsp+.pf]
+    cmp     qword [rdi+Prefetch.started], 0
+    je      .error_clear
+
+.success:
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 2
+    ret
+
+.error_clear:
+    ; The arrays are released with the rest of the arena.
+    mov     rdi, [rsp+.pf]
+    mov     qword [rdi+Prefetch.files], 0
+    mov     qword [rdi+Prefetch.threads], 0
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Get the next block of data of the file being consumed.
+;
+; C prototype equivalent:
+;
+;     ssize_t prefetch_read(Prefetch *pf, char **data);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Output: RSI (address) - set to the address of the data.
+; - Output: RAX (integer) - number of bytes of data, 0 at the end of
+;   the file, -1 on read error, or PREFETCH_OPEN_FAILED if the file
+;   could not be opened.
+;
+; Notes:
+;
+; - Waits (on a futex) if the file's reader has not yet got that far.
+;
+; - The data remains valid until the next call to prefetch_read() or
+;   prefetch_next(). The previous block is freed by this call.
+;
+; - The handshake with the reader is the same as the one used by
+;   cat(1) in pipelined mode: the consumer announces that it is about
+;   to sleep (with xchg) and then checks again, while the reader adds
+;   the block, then increments the futex word (with a lock prefix) and
+;   only then checks whether the consumer is asleep.
+;---------------------------------------------------------------------
+
+prefetch_read:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+    .data       equ     8   ; "char **"
+    .seq        equ    16   ; uint32_t: futex value before checking.
+    .bytes      equ    24   ; ssize_t: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.pf], rdi
+    mov     [rsp+.data], rsi
+
+    ;--------------------
+
+    mov     rax, [rdi+Prefetch.turn]
+    cmp     rax, [rdi+Prefetch.count]
+    jae     .no_more_files
+
+    mov     rcx, [rdi+Prefetch.paths]
+    mov     rcx, [rcx+rax*PTR_SIZE]
+
+    cmp     byte [rcx], stdin_filename
+    jne     .not_stdin
+
+    cmp     byte [rcx+1], 0
+    je      .stdin
+
+.not_stdin:
+    imul    rbx, rax, PrefetchFile_size
+    add     rbx, [rdi+Prefetch.files]
+
+.check:
+    mov     eax, [rbx+PrefetchFile.published]
+    mov     [rsp+.seq], rax
+
+    mov     rax, [rbx+PrefetchFile.prev]
+    cmp     qword [rax+PrefetchBlock.next], 0
+    jne     .take
+
+    cmp     qword [rbx+PrefetchFile.done], 0
+    jne     .finished
+
+    ; The reader may be waiting for memory, which it can now have
+    ; (see prefetch_can_reserve()).
+    mov     rdi, [rsp+.pf]
+    dcall   prefetch_wake
+
+    ; Nothing to take yet, so announce that we are about to sleep
+    ; (xchg acts as a full memory barrier)...
+    mov     eax, 1
+    xchg    eax, [rbx+PrefetchFile.waiting]
+
+    ; ... and check again in case the reader added a block in the
+    ; meantime.
+    mov     rax, [rbx+PrefetchFile.prev]
+    cmp     qword [rax+PrefetchBlock.next], 0
+    jne     .stop_waiting
+
+    cmp     qword [rbx+PrefetchFile.done], 0
+    jne     .stop_waiting
+
+    lea     rdi, [rbx+PrefetchFile.published]
+    mov     rsi, [rsp+.seq]
+    dcall   futex_wait
+
+.stop_waiting:
+    mov     dword [rbx+PrefetchFile.waiting], 0
+    jmp     .check
+
+.take:
+    ; rax is the block that was taken last time (or the file itself).
+    mov     rcx, [rax+PrefetchBlock.next]
+    mov     [rbx+PrefetchFile.prev], rcx
+
+    mov     rdx, [rcx+PrefetchBlock.bytes]
+    mov     [rsp+.bytes], rdx
+
+    lea     rdx, [rcx+PrefetchBlock.data]
+    mov     rsi, [rsp+.data]
+    mov     [rsi], rdx
+
+    ; Now the reader can no longer link a block onto the previous
+    ; block, so free it.
+    cmp     rax, rbx
+    je      .taken
+
+    mov     rdi, rax
+    dcall   free
+
+    mov     rdi, [rsp+.pf]
+    mov     rsi, PREFETCH_BLOCK_SIZE
+    dcall   prefetch_unreserve
+
+.taken:
+    mov     rax, [rsp+.bytes]
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.finished:
+    mov     rax, [rbx+PrefetchFile.result]
+    jmp     .out
+
+.no_more_files:
+    mov     rax, 0
+    jmp     .out
+
+.stdin:
+    ; Read stdin in turn on this thread, so it is only ever read once
+    ; and in order, however many times it is specified.
+    cmp     qword [rdi+Prefetch.buffer], 0
+    jne     .read_stdin
+
+    mov     rdi, PREFETCH_BLOCK_SIZE
+    dcall   malloc
+    cmp     rax, 0
+    je      .error
+
+    mov     rdi, [rsp+.pf]
+    mov     [rdi+Prefetch.buffer], rax
+
+.read_stdin:
+    mov     rsi, [rdi+Prefetch.buffer]
+    mov     rax, [rsp+.data]
+    mov     [rax], rsi
+
+    mov     rdi, STDIN_FD
+    mov     rdx, PREFETCH_BLOCK_SIZE
+    dcall   read_block
+    jmp     .out
+
+.error:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Finish with the file being consumed and move on to the
+;   next one.
+;
+; C prototype equivalent:
+;
+;     void prefetch_next(Prefetch *pf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Output: None.
+;
+; Notes:
+;
+; - The file does not have to have been consumed completely: the
+;   reader is told to stop and any data it has already read is freed
+;   (by this function or the reader, whichever finishes with the file
+;   last).
+;---------------------------------------------------------------------
+
+prefetch_next:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+
+    ;--------------------
+
+    mov     [rsp+.pf], rdi
+
+    mov     rax, [rdi+Prefetch.turn]
+    cmp     rax, [rdi+Prefetch.count]
+    jae     .out
+
+    imul    rbx, rax, PrefetchFile_size
+    add     rbx, [rdi+Prefetch.files]
+
+    mov     qword [rbx+PrefetchFile.stop], 1
+
+    ; If the reader has already finished with the file, the blocks
+    ; are ours to free (the lock prefix makes .prev visible to the
+    ; reader otherwise).
+    mov     eax, 1
+    lock xadd [rbx+PrefetchFile.detach], rax
+    cmp     rax, 1
+    jne     .advance
+
+    mov     rsi, rbx
+    dcall   prefetch_free_blocks
+
+.advance:
+    ; Readers waiting for memory may be reading the new turn's file
+    ; (or the file just stopped), so wake them.
+    mov     rdi, [rsp+.pf]
+    inc     qword [rdi+Prefetch.turn]
+
+    dcall   prefetch_wake
+
+.out:
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Stop reading, wait for the reader threads and free
+;   the data still buffered.
+;
+; C prototype equivalent:
+;
+;     void prefetch_end(Prefetch *pf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Output: None.
+;---------------------------------------------------------------------
+
+prefetch_end:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+    .i          equ     8   ; size_t: thread or file index.
+
+    ;--------------------
+
+    mov     [rsp+.pf], rdi
+
+    mov     qword [rdi+Prefetch.stop], 1
+    dcall   prefetch_wake
+
+    mov     qword [rsp+.i], 0
+
+.next_thread:
+    mov     rdi, [rsp+.pf]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Prefetch.started]
+    je      .joined
+
+    mov     rdi, [rdi+Prefetch.threads]
+    mov     rdi, [rdi+rax*PTR_SIZE]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+    inc     qword [rsp+.i]
+    jmp     .next_thread
+
+.joined:
+    ;--------------------
+    ; Free any blocks left over (freeing is idempotent).
+
+    mov     qword [rsp+.i], 0
+
+.next_file:
+    mov     rdi, [rsp+.pf]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Prefetch.count]
+    je      .free
+
+    imul    rsi, rax, PrefetchFile_size
+    add     rsi, [rdi+Prefetch.files]
+    dcall   prefetch_free_blocks
+
+    inc     qword [rsp+.i]
+    jmp     .next_file
+
+.free:
+    ; The file and thread arrays are released with the rest of the
+    ; arena.
+    mov     rdi, [rdi+Prefetch.buffer]
+    dcall   free
+
+    mov     rdi, [rsp+.pf]
+    mov     qword [rdi+Prefetch.files], 0
+    mov     qword [rdi+Prefetch.threads], 0
+    mov     qword [rdi+Prefetch.buffer], 0
+    mov     qword [rdi+Prefetch.started], 0
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Reader thread: read files until there are none left.
+;
+; C prototype equivalent:
+;
+;     void *prefetch_worker(Prefetch *pf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Output: RAX (address) - always NULL.
+;---------------------------------------------------------------------
+
+prefetch_worker:
+    prologue_with_vars 1
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+
+    ;--------------------
+
+    mov     [rsp+.pf], rdi
+
+.next_file:
+    mov     rdi, [rsp+.pf]
+    cmp     qword [rdi+Prefetch.stop], 0
+    jne     .out
+
+    ; Claim the next file.
+    mov     eax, 1
+    lock xadd [rdi+Prefetch.claim], rax
+    cmp     rax, [rdi+Prefetch.count]
+    jae     .out
+
+    mov     rsi, rax
+    dcall   prefetch_file
+    jmp     .next_file
+
+.out:
+    xor     rax, rax
+
+    epilogue_with_vars 1
+    ret
+
+;---------------------------------------------------------------------
+; Description: Read a file into a list of blocks (on a reader thread).
+;
+; C prototype equivalent:
+;
+;     void prefetch_file(Prefetch *pf, size_t index);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Input: RSI (integer) - index of file.
+; - Output: None.
+;
+; Notes:
+;
+; - Reading stops early if the consumer or prefetch_end() says so,
+;   or after Prefetch.max_bytes bytes.
+;
+; - read_block() only returns less than a full block at the end of
+;   the file, so a short block ends the file without another read.
+;---------------------------------------------------------------------
+
+prefetch_file:
+    prologue_with_vars 7
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+    .index      equ     8   ; size_t: index of file.
+    .file       equ    16   ; "PrefetchFile *"
+    .fd         equ    24   ; int: file descriptor.
+    .block      equ    32   ; "PrefetchBlock *": block being read.
+    .total      equ    40   ; size_t: bytes read.
+    .result     equ    48   ; ssize_t: PrefetchFile.result value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.pf], rdi
+    mov     [rsp+.index], rsi
+
+    ;--------------------
+
+    imul    rax, rsi, PrefetchFile_size
+    add     rax, [rdi+Prefetch.files]
+    mov     [rsp+.file], rax
+
+    mov     qword [rsp+.total], 0
+
+    mov     rcx, [rdi+Prefetch.paths]
+    mov     rdi, [rcx+rsi*PTR_SIZE]
+
+    ; Stdin is read by the consumer (see prefetch_read()).
+    cmp     byte [rdi], stdin_filename
+    jne     .open_file
+
+    cmp     byte [rdi+1], 0
+    je      .out
+
+.open_file:
+    mov     rsi, O_RDONLY
+    dcall   open
+
+    ; open(2) returns an int, so sign extend it.
+    cdqe
+    cmp     rax, -1
+    je      .error_open
+
+    mov     [rsp+.fd], rax
+
+    ; Advisory only, so ignore failures.
+    mov     rdi, rax
+    mov     rsi, 0 ; offset.
+    mov     rdx, 0 ; length (0 means "to the end of the file").
+    mov     rcx, POSIX_FADV_SEQUENTIAL
+    dcall   posix_fadvise
+
+.next_block:
+    mov     qword [rsp+.result], 0
+
+    mov     rdi, [rsp+.pf]
+    mov     rbx, [rsp+.file]
+
+    cmp     qword [rbx+PrefetchFile.stop], 0
+    jne     .close
+
+    mov     rax, [rdi+Prefetch.max_bytes]
+    cmp     rax, 0
+    je      .reserve
+
+    cmp     [rsp+.total], rax
+    jae     .close
+
+.reserve:
+    ; Wait until there is room for another block.
+    mov     rsi, rbx
+    mov     rdx, [rsp+.index]
+    dcall   prefetch_reserve
+    cmp     rax, 0
+    jne     .close
+
+    mov     rdi, (PrefetchBlock_size + PREFETCH_BLOCK_SIZE)
+    dcall   malloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     [rsp+.block], rax
+
+    mov     rdi, [rsp+.fd]
+    lea     rsi, [rax+PrefetchBlock.data]
+    mov     rdx, PREFETCH_BLOCK_SIZE
+    dcall   read_block
+    cmp     rax, 0
+    jle     .read_end
+
+    add     [rsp+.total], rax
+
+    mov     rcx, [rsp+.block]
+    mov     [rcx+PrefetchBlock.bytes], rax
+    mov     qword [rcx+PrefetchBlock.next], 0
+
+    ; Add the block to the end of the list, then publish it. The lock
+    ; prefix makes this a full barrier (see prefetch_read()).
+    mov     rbx, [rsp+.file]
+    mov     rax, [rbx+PrefetchFile.last]
+    mov     [rax+PrefetchBlock.next], rcx
+    mov     [rbx+PrefetchFile.last], rcx
+
+    lock inc dword [rbx+PrefetchFile.published]
+
+    cmp     dword [rbx+PrefetchFile.waiting], 0
+    je      .published
+
+    lea     rdi, [rbx+PrefetchFile.published]
+    mov     esi, 1
+    dcall   futex_wake
+
+.published:
+    mov     rcx, [rsp+.block]
+    cmp     qword [rcx+PrefetchBlock.bytes], PREFETCH_BLOCK_SIZE
+    jb      .close ; EOF.
+
+    jmp     .next_block
+
+.read_end:
+    ; EOF (0) or read error (-1).
+    mov     [rsp+.result], rax
+
+    mov     rdi, [rsp+.block]
+    dcall   free
+
+    mov     rdi, [rsp+.pf]
+    mov     rsi, PREFETCH_BLOCK_SIZE
+    dcall   prefetch_unreserve
+
+.close:
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.done:
+    ; Publish the result.
+    mov     rbx, [rsp+.file]
+    mov     rax, [rsp+.result]
+    mov     [rbx+PrefetchFile.result], rax
+    mov     qword [rbx+PrefetchFile.done], 1
+
+    lock inc dword [rbx+PrefetchFile.published]
+
+    cmp     dword [rbx+PrefetchFile.waiting], 0
+    je      .detach
+
+    lea     rdi, [rbx+PrefetchFile.published]
+    mov     esi, 1
+    dcall   futex_wake
+
+.detach:
+    ; If the consumer has already finished with the file, the blocks
+    ; are ours to free.
+    mov     rbx, [rsp+.file]
+    mov     eax, 1
+    lock xadd [rbx+PrefetchFile.detach], rax
+    cmp     rax, 1
+    jne     .out
+
+    mov     rdi, [rsp+.pf]
+    mov     rsi, rbx
+    dcall   prefetch_free_blocks
+
+.out:
+    epilogue_with_vars 7
+    ret
+
+.error_open:
+    mov     qword [rsp+.result], PREFETCH_OPEN_FAILED
+    jmp     .done
+
+.error_alloc:
+    mov     qword [rsp+.result], -1
+
+    mov     rdi, [rsp+.pf]
+    mov     rsi, PREFETCH_BLOCK_SIZE
+    dcall   prefetch_unreserve
+
+    jmp     .close
+
+;---------------------------------------------------------------------
+; Description: Account for a block about to be read, waiting while the
+;   buffered data is over the limit.
+;
+; C prototype equivalent:
+;
+;     int prefetch_reserve(Prefetch *pf, PrefetchFile *file, size_t index);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Input: RSI (address) - PrefetchFile being read.
+; - Input: RDX (integer) - index of file.
+; - Output: RAX (integer) - 0 on success, or -1 if reading should
+;   stop (nothing is reserved).
+;
+; Notes:
+;
+; - The file being consumed is not made to wait once the consumer
+;   has taken all of its blocks, so the consumer can always make
+;   progress (and free memory), but a slow consumer still holds back
+;   its reader.
+;
+; - A sleeper increments Prefetch.sleepers and then checks again, while
+;   prefetch_wake() changes the futex word and then checks for
+;   sleepers, so a wakeup cannot be missed.
+;---------------------------------------------------------------------
+
+prefetch_reserve:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+    .file       equ     8   ; "PrefetchFile *"
+    .index      equ    16   ; size_t: index of file.
+    .seq        equ    24   ; uint32_t: futex value before checking.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.pf], rdi
+    mov     [rsp+.file], rsi
+    mov     [rsp+.index], rdx
+
+    ;--------------------
+
+.check:
+    mov     rdi, [rsp+.pf]
+
+    ; Remember the futex value before checking.
+    mov     eax, [rdi+Prefetch.seq]
+    mov     [rsp+.seq], rax
+
+    mov     rsi, [rsp+.file]
+    mov     rdx, [rsp+.index]
+    dcall   prefetch_can_reserve
+    cmp     rax, 0
+    jg      .reserve
+    jl      .stop
+
+    mov     rdi, [rsp+.pf]
+    lock inc dword [rdi+Prefetch.sleepers]
+
+    mov     rsi, [rsp+.file]
+    mov     rdx, [rsp+.index]
+    dcall   prefetch_can_reserve
+    cmp     rax, 0
+    jne     .woken
+
+    mov     rdi, [rsp+.pf]
+    add     rdi, Prefetch.seq
+    mov     rsi, [rsp+.seq]
+    dcall   futex_wait
+
+.woken:
+    mov     rdi, [rsp+.pf]
+    lock dec dword [rdi+Prefetch.sleepers]
+    jmp     .check
+
+.reserve:
+    mov     rdi, [rsp+.pf]
+    lock add qword [rdi+Prefetch.used], PREFETCH_BLOCK_SIZE
+
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 4
+    ret
+
+.stop:
+    mov     rax, -1
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Determine if a reader may read another block.
+;
+; C prototype equivalent:
+;
+;     int prefetch_can_reserve(Prefetch *pf, PrefetchFile *file, size_t index);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Input: RSI (address) - PrefetchFile being read.
+; - Input: RDX (integer) - index of file.
+; - Output: RAX (integer) - 1 if it may, 0 if it must wait, or -1 if
+;   reading should stop.
+;---------------------------------------------------------------------
+
+prefetch_can_reserve:
+    prologue_with_vars 0
+
+    mov     rax, -1
+
+    cmp     qword [rdi+Prefetch.stop], 0
+    jne     .out
+
+    cmp     qword [rsi+PrefetchFile.stop], 0
+    jne     .out
+
+    mov     rax, 1
+
+    ; The file being consumed may always read a block once the
+    ; consumer has taken all of its blocks.
+    cmp     rdx, [rdi+Prefetch.turn]
+    jne     .check_used
+
+    mov     rcx, [rsi+PrefetchFile.last]
+    cmp     rcx, [rsi+PrefetchFile.prev]
+    je      .out
+
+.check_used:
+    mov     rcx, [rdi+Prefetch.used]
+    cmp     rcx, [rdi+Prefetch.limit]
+    jb      .out
+
+    mov     rax, 0
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Give back memory reserved by prefetch_reserve() and wake
+;   any readers waiting for it.
+;
+; C prototype equivalent:
+;
+;     void prefetch_unreserve(Prefetch *pf, size_t bytes);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Input: RSI (integer) - number of bytes.
+; - Output: None.
+;---------------------------------------------------------------------
+
+prefetch_unreserve:
+    prologue_with_vars 0
+
+    neg     rsi
+    lock add [rdi+Prefetch.used], rsi
+
+    dcall   prefetch_wake
+
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Wake the readers waiting in prefetch_reserve() (so they
+;   check again).
+;
+; C prototype equivalent:
+;
+;     void prefetch_wake(Prefetch *pf);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Output: None.
+;---------------------------------------------------------------------
+
+prefetch_wake:
+    prologue_with_vars 0
+
+    lock inc dword [rdi+Prefetch.seq]
+
+    cmp     dword [rdi+Prefetch.sleepers], 0
+    je      .out
+
+    add     rdi, Prefetch.seq
+    mov     rsi, PREFETCH_MAX_THREADS
+    dcall   futex_wake
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Free the blocks of a file the consumer has not yet
+;   freed.
+;
+; C prototype equivalent:
+;
+;     void prefetch_free_blocks(Prefetch *pf, PrefetchFile *file);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Prefetch.
+; - Input: RSI (address) - PrefetchFile.
+; - Output: None.
+;
+; Notes:
+;
+; - Must only be called once both the reader and the consumer have
+;   finished with the file. The file is left with an empty list, so
+;   calling this function again is harmless.
+;---------------------------------------------------------------------
+
+prefetch_free_blocks:
+    prologue_with_vars 3
+
+    ;--------------------
+    ; Stack offsets.
+
+    .pf         equ     0   ; "Prefetch *"
+    .block      equ     8   ; "PrefetchBlock *"
+    .bytes      equ    16   ; size_t: amount of memory freed.
+
+    ;--------------------
+
+    mov     [rsp+.pf], rdi
+    mov     qword [rsp+.bytes], 0
+
+    ; Start with the block the consumer last took (if any).
+    mov     rax, [rsi+PrefetchFile.prev]
+    cmp     rax, rsi
+    jne     .have_first
+
+    mov     rax, [rsi+PrefetchFile.next]
+
+.have_first:
+    mov     qword [rsi+PrefetchFile.next], 0
+    mov     [rsi+PrefetchFile.prev], rsi
+    mov     [rsi+PrefetchFile.last], rsi
+
+.next_block:
+    cmp     rax, 0
+    je      .freed
+
+    mov     rdi, rax
+    mov     rax, [rax+PrefetchBlock.next]
+    mov     [rsp+.block], rax
+
+    dcall   free
+
+    add     qword [rsp+.bytes], PREFETCH_BLOCK_SIZE
+
+    mov     rax, [rsp+.block]
+    jmp     .next_block
+
+.freed:
+    cmp     qword [rsp+.bytes], 0
+    je      .out
+
+    mov     rdi, [rsp+.pf]
+    mov     rsi, [rsp+.bytes]
+    dcall   prefetch_unreserve
+
+.out:
+    epilogue_with_vars 3
+    ret
@@ -19,14 +19,19 @@
 #include <string.h>
 #include <limits.h> /* PIPE_BUF */
 #include <fcntl.h> /* O_* flags */
+#include <sys/stat.h> /* mkdir(2) */
 #include <time.h>
 #include <libgen.h> /* basename(3) */
+#include <stdint.h>
 
 #include <check.h>
 
 /* Number of argv elements to use for testing */
 #define TEST_ARGV_ELEMS             4
 
+/* Bytes of arena memory to dirty before each alloc_args_buffer() test */
+#define TEST_ARGS_DIRTY_SIZE        64
+
 /* We need more to test getopt */
 #define TEST_GETOPT_ARGV_ELEMS      6
 
@@ -80,6 +85,7 @@
 /* C prototypes for assembly language routines under test */
 
 extern char *asm_basename(char *path);
+extern const char *asm_basename_len(const char *path, size_t len, size_t *name_len);
 extern char *asm_strchr(const char *s, int c);
 extern int asm_getopt(int argc, char *const argv[], const char *optstring);
 extern size_t asm_strlen(const char *msg);
@@ -91,7 +97,101 @@ extern size_t argv_bytes(int argc, const char *argv[]);
 extern ssize_t read_block(int fd, void *buffer, size_t bytes);
 extern ssize_t write_block(int fd, const void *buffer, size_t bytes);
 extern void *alloc_args_buffer(int argc, const char *argv[], size_t *bytes);
+extern void *arena_alloc(size_t size);
+extern void *arena_alloc_aligned(size_t size, size_t alignment);
+extern void arena_free(void *ptr, size_t size);
+extern void *arena_mark(void);
+extern void arena_release(void *mark);
 extern void set_errno(int value);
+extern unsigned int cpu_features(void);
+extern uint32_t crc32_posix_update(uint32_t crc, const void *buf, size_t len);
+extern uint32_t crc32_posix_final(uint32_t crc, uint64_t length);
+extern uint32_t crc32c_update(uint32_t crc, const void *buf, size_t len);
+extern uint32_t crc32_update(uint32_t crc, const void *buf, size_t len);
+extern int asm_memcmp(const void *s1, const void *s2, size_t n);
+extern size_t asm_memdiff(const void *s1, const void *s2, size_t n);
+extern void *asm_memmem(const void *haystack, size_t haystack_len,
+        const void *needle, size_t needle_len);
+extern size_t asm_memcount(const void *s, int c, size_t n);
+
+/* Mirrors "struc Base64Decoder" (see header.inc) */
+typedef struct base64_decoder {
+    unsigned char quad[4];
+    uint32_t count;
+    uint32_t invalid;
+} Base64Decoder;
+
+extern size_t base64_encode(const void *src, size_t len, char *dst);
+extern size_t base64_decode(Base64Decoder *dec, const char *src, size_t len,
+        void *dst);
+extern size_t base64_decode_final(Base64Decoder *dec, void *dst);
+
+typedef struct inode_set InodeSet;
+
+extern InodeSet *inode_set_new(void);
+extern int inode_set_add(InodeSet *set, uint64_t dev, uint64_t ino);
+extern void inode_set_free(InodeSet *set);
+
+/* Mirrors "struc WalkEntry" (see walk.inc) */
+typedef struct walk_entry {
+    char *path;
+    char *name;
+    long dirfd;
+    long type;
+    size_t depth;
+    size_t worker;
+    unsigned char stx[256];
+} WalkEntry;
+
+/* Mirrors "struc Walk" (see walk.inc) */
+typedef struct walk {
+    int (*visit)(WalkEntry *entry, void *data);
+    void *data;
+    const char *cmd;
+    long error;
+    void *workers;
+    size_t nworkers;
+    size_t pending;
+    uint32_t seq;
+    uint32_t sleepers;
+} Walk;
+
+extern int walk_tree(Walk *walk, const char *path);
+
+/* Mirrors "struc Inflate" (see inflate.inc) */
+typedef struct inflate {
+    long fd;
+    long out_fd;
+    char *in_buf;
+    char *in_pos;
+    char *in_end;
+    char *in_fast;
+    long eof;
+    size_t overrun;
+    uint64_t bitbuf;
+    size_t bitcnt;
+    char *out_buf;
+    char *out_pos;
+    char *out_flushed;
+    char *out_start;
+    char *out_limit;
+    uint64_t crc;
+    uint64_t size;
+    long fixed;
+    uint32_t litlen[1332];
+    uint32_t dist[402];
+    uint32_t codes[128];
+    unsigned char lens[320];
+} Inflate;
+
+/* Must match the INFLATE_ERR_* values in inflate.inc */
+#define INFLATE_ERR_FORMAT  -1
+#define INFLATE_ERR_EOF     -2
+
+extern int inflate_init(Inflate *inf, int out_fd);
+extern void inflate_input(Inflate *inf, int fd);
+extern int inflate_stream(Inflate *inf);
+extern int inflate_byte(Inflate *inf);
 
 /*------------------------------------------------------------------*/
 /* utilities */
@@ -595,6 +695,76 @@ START_TEST(test_asm_utils_asm_basename)
 }
 END_TEST
 
+START_TEST(test_asm_utils_asm_basename_len)
+{
+    typedef struct test_data {
+        const char *path;
+        size_t offset; /* Expected offset of the basename */
+        size_t len;    /* Expected length of the basename */
+    } TestData;
+
+    TestData tests[] = {
+        { "", 0, 0 },
+        { "/", 0, 1 },
+        { "///", 0, 1 },
+        { "a", 0, 1 },
+        { "a/", 0, 1 },
+        { "/a", 1, 1 },
+        { "foo/bar", 4, 3 },
+        { "foo/bar///", 4, 3 },
+        { "/// /////", 3, 1 },
+        { "/usr/lib", 5, 3 },
+        { "../", 0, 2 },
+        { "0123456789abcdef", 0, 16 },
+        { "0123456789abcdef/", 0, 16 },
+        { "/0123456789abcdef", 1, 16 },
+        { "0123456789abcde/0123456789abcdef", 16, 16 },
+        { "0123456789abcdef0123456789abcdef/x", 33, 1 },
+        { "/0123456789abcdef0123456789abcdef0123456789abcdef", 1, 48 },
+    };
+
+    /* Room for the longest path at every alignment, surrounded by
+     * slashes which must not be seen.
+     */
+    char buffer[128] __attribute__((aligned(16)));
+
+    for (int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        const TestData *t = &tests[i];
+        size_t path_len = strlen(t->path);
+
+        for (size_t align = 0; align < 16; align++) {
+            memset(buffer, '/', sizeof(buffer));
+
+            char *path = buffer + 16 + align;
+            memcpy(path, t->path, path_len);
+
+            size_t len = 0;
+
+            const char *result = asm_basename_len(path, path_len, &len);
+
+            if (show_debug()) {
+                fprintf(stderr,
+                        "DEBUG: %s:%d: test[%d]: path: '%s', "
+                        "align: %lu, expected: %lu+%lu, "
+                        "actual: %ld+%lu\n",
+                        __func__,
+                        __LINE__,
+                        i,
+                        t->path,
+                        align,
+                        t->offset,
+                        t->len,
+                        (long)(result - path),
+                        len);
+            }
+
+            ck_assert_ptr_eq(result, path + t->offset);
+            ck_assert_uint_eq(len, t->len);
+        }
+    }
+}
+END_TEST
+
 void
 handle_test_strchr(StrchrTestFunc *tf)
 {
@@ -799,6 +969,78 @@ START_TEST(test_asm_utils_libc_strtol)
 }
 END_TEST
 
+START_TEST(test_asm_utils_num_to_timespec)
+{
+    typedef struct test_data {
+        const char *str;
+        int expected_return;
+        time_t expected_sec;
+        long expected_nsec;
+    } TestData;
+
+    TestData tests[] = {
+        {"", -1, 0, 0},
+        {".", -1, 0, 0},
+        {"s", -1, 0, 0},
+        {"-1", -1, 0, 0},
+        {"a3", -1, 0, 0},
+        {"6g", -1, 0, 0},
+        {"1ss", -1, 0, 0},
+        {"1e3", -1, 0, 0},
+        {"0", 0, 0, 0},
+        {"0.1", 0, 0, 100000000},
+        {"7.5s", 0, 7, 500000000},
+        {"1.5m", 0, 90, 0},
+        {"2h", 0, 7200, 0},
+        {"3d", 0, 259200, 0},
+        {"1.0000000", 0, 1, 0},
+        {".25", 0, 0, 250000000},
+        {"0.0005", 0, 0, 500000},
+        {"0.123456789", 0, 0, 123456789},
+
+        /* Digits beyond nanosecond precision round up */
+        {"0.0000000001", 0, 0, 1},
+        {"0.9999999999", 0, 1, 0},
+        {"0.0000000010", 0, 0, 1},
+
+        {"9223372036854775807", 0, LONG_MAX, 0},
+        {"9223372036854775808", -1, 0, 0},
+        {"9223372036854775807d", -1, 0, 0},
+    };
+
+    for (int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        const TestData *t = &tests[i];
+        struct timespec ts = { 0 };
+
+        int ret = num_to_timespec(t->str, &ts);
+
+        if (show_debug()) {
+            fprintf(stderr,
+                    "DEBUG: %s:%d: test[%d]: str: '%s', "
+                    "expected_ret: %d, expected: %ld.%09ld, "
+                    "ret: %d, ts: %ld.%09ld\n",
+                    __func__,
+                    __LINE__,
+                    i,
+                    t->str,
+                    t->expected_return,
+                    (long)t->expected_sec,
+                    t->expected_nsec,
+                    ret,
+                    (long)ts.tv_sec,
+                    ts.tv_nsec);
+        }
+
+        ck_assert_int_eq(ret, t->expected_return);
+
+        if (ret == 0) {
+            ck_assert(ts.tv_sec == t->expected_sec);
+            ck_assert_int_eq(ts.tv_nsec, t->expected_nsec);
+        }
+    }
+}
+END_TEST
+
 START_TEST(test_asm_utils_alloc_args_buffer)
 {
     typedef struct test_data {
@@ -811,6 +1053,9 @@ START_TEST(test_asm_utils_alloc_args_buffer)
          * newline and nul terminator.
          */
         size_t total_len;
+
+        /* Returned string (NULL on failure) */
+        const char *expected;
     } TestData;
 
     const char *empty = "";
@@ -825,30 +1070,38 @@ START_TEST(test_asm_utils_alloc_args_buffer)
 #define SPC_BYTE 1
 
     TestData tests[] = {
-        { 0, {NULL, NULL, NULL, NULL}, 0, 0 },
-        { 1, {empty, NULL, NULL, NULL}, 0, 0 },
-        { 2, {empty, empty, NULL, NULL}, 0, 0 },
-        { 3, {empty, empty, empty, NULL}, 0, 0 },
-        { 4, {empty, empty, empty, empty}, 0, 0 },
-
-        { 1, {single_byte, NULL, NULL, NULL}, 1, (1+NL_BYTE) },
-        { 2, {single_byte, single_byte, NULL, NULL}, (2*1), ((2*1)+SPC_BYTE+NL_BYTE) },
-        { 3, {single_byte, single_byte, single_byte, NULL}, (3*1), ((3*1)+(2*SPC_BYTE)+NL_BYTE) },
-        { 4, {single_byte, single_byte, single_byte, single_byte}, (4*1), ((4*1)+(3*SPC_BYTE)+NL_BYTE) },
-
-        { 1, {foo, NULL, NULL, NULL}, 3, (3+NL_BYTE) },
-        { 2, {foo, foo, NULL, NULL}, (2*3), ((2*3)+SPC_BYTE+NL_BYTE) },
-        { 3, {foo, foo, foo, NULL}, (3*3), ((3*3)+(2*SPC_BYTE)+NL_BYTE) },
-        { 4, {foo, foo, foo, foo}, (4*3), ((4*3)+(3*SPC_BYTE)+NL_BYTE) },
-
-        { 3, {foo, hello_world, single_byte, NULL}, (3+11+1), ((3+11+1)+(2*SPC_BYTE)+NL_BYTE) },
-        { 4, {foo, hello_world, single_byte, hello_world}, (3+11+1+11), ((3+11+1+11)+(3*SPC_BYTE)+NL_BYTE) },
-        { 4, {hello_world, hello_world, hello_world, hello_world}, (4*11), ((4*11)+(3*SPC_BYTE)+NL_BYTE) },
+        { 0, {NULL, NULL, NULL, NULL}, 0, 0, NULL },
+        { 1, {empty, NULL, NULL, NULL}, 0, 0, NULL },
+        { 2, {empty, empty, NULL, NULL}, 0, 0, NULL },
+        { 3, {empty, empty, empty, NULL}, 0, 0, NULL },
+        { 4, {empty, empty, empty, empty}, 0, 0, NULL },
+
+        { 1, {single_byte, NULL, NULL, NULL}, 1, (1+NL_BYTE), "x\n" },
+        { 2, {single_byte, single_byte, NULL, NULL}, (2*1), ((2*1)+SPC_BYTE+NL_BYTE), "x x\n" },
+        { 3, {single_byte, single_byte, single_byte, NULL}, (3*1), ((3*1)+(2*SPC_BYTE)+NL_BYTE), "x x x\n" },
+        { 4, {single_byte, single_byte, single_byte, single_byte}, (4*1), ((4*1)+(3*SPC_BYTE)+NL_BYTE), "x x x x\n" },
+
+        { 1, {foo, NULL, NULL, NULL}, 3, (3+NL_BYTE), "foo\n" },
+        { 2, {foo, foo, NULL, NULL}, (2*3), ((2*3)+SPC_BYTE+NL_BYTE), "foo foo\n" },
+        { 3, {foo, foo, foo, NULL}, (3*3), ((3*3)+(2*SPC_BYTE)+NL_BYTE), "foo foo foo\n" },
+        { 4, {foo, foo, foo, foo}, (4*3), ((4*3)+(3*SPC_BYTE)+NL_BYTE), "foo foo foo foo\n" },
+
+        { 3, {foo, hello_world, single_byte, NULL}, (3+11+1), ((3+11+1)+(2*SPC_BYTE)+NL_BYTE), "foo hello_world x\n" },
+        { 4, {foo, hello_world, single_byte, hello_world}, (3+11+1+11), ((3+11+1+11)+(3*SPC_BYTE)+NL_BYTE), "foo hello_world x hello_world\n" },
+        { 4, {hello_world, hello_world, hello_world, hello_world}, (4*11), ((4*11)+(3*SPC_BYTE)+NL_BYTE), "hello_world hello_world hello_world hello_world\n" },
+
+        /* Empty arguments are still followed by a separator */
+        { 2, {empty, foo, NULL, NULL}, 3, (3+SPC_BYTE+NL_BYTE), " foo\n" },
+        { 2, {foo, empty, NULL, NULL}, 3, (3+SPC_BYTE+NL_BYTE), "foo \n" },
+        { 3, {foo, empty, empty, NULL}, 3, (3+(2*SPC_BYTE)+NL_BYTE), "foo  \n" },
+        { 4, {single_byte, empty, single_byte, empty}, (2*1), ((2*1)+(3*SPC_BYTE)+NL_BYTE), "x  x \n" },
     };
 
 #undef NL_BYTE
 #undef SPC_BYTE
 
+    void *mark = arena_mark();
+
     for (int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
         const TestData *t = &tests[i];
 
@@ -858,6 +1111,15 @@ START_TEST(test_asm_utils_alloc_args_buffer)
 
         bool expect_failure = !t->args_len;
 
+        /* Arena memory may have been used before, so dirty it to check
+         * that every byte of the buffer is written.
+         */
+        void *scratch = arena_mark();
+        char *dirty = arena_alloc(TEST_ARGS_DIRTY_SIZE);
+        ck_assert_ptr_nonnull(dirty);
+        memset(dirty, 'X', TEST_ARGS_DIRTY_SIZE);
+        arena_release(scratch);
+
         if (show_debug()) {
             fprintf(stderr,
                     "FIXME: PRE  : test[%d]: "
@@ -908,8 +1170,65 @@ START_TEST(test_asm_utils_alloc_args_buffer)
         size_t len = strlen(str);
         ck_assert_int_eq(bytes, len);
 
-        free(str);
+        ck_assert_str_eq(str, t->expected);
     }
+
+    arena_release(mark);
+}
+END_TEST
+
+START_TEST(test_asm_utils_arena)
+{
+    void *mark = arena_mark();
+
+    char *a = arena_alloc(1);
+    ck_assert_ptr_nonnull(a);
+    ck_assert_int_eq((uintptr_t)a % 16, 0);
+
+    char *b = arena_alloc(100);
+    ck_assert_ptr_nonnull(b);
+    ck_assert_int_eq((uintptr_t)b % 16, 0);
+
+    /* Blocks must not overlap */
+    ck_assert(b >= a + 16 || a >= b + 100);
+    memset(a, 'a', 1);
+    memset(b, 'b', 100);
+    ck_assert_int_eq(a[0], 'a');
+
+    char *page = arena_alloc_aligned(4096, 4096);
+    ck_assert_ptr_nonnull(page);
+    ck_assert_int_eq((uintptr_t)page % 4096, 0);
+    memset(page, 'p', 4096);
+
+    /* Bigger than a chunk */
+    size_t big_size = 1024 * 1024;
+    char *big = arena_alloc(big_size);
+    ck_assert_ptr_nonnull(big);
+    memset(big, 'x', big_size);
+    ck_assert_int_eq(b[99], 'b');
+
+    /* A freed block is reused for an allocation of the same
+     * (power of two) size.
+     */
+    char *c = arena_alloc(256);
+    ck_assert_ptr_nonnull(c);
+    arena_free(c, 256);
+    ck_assert_ptr_eq(arena_alloc(256), c);
+
+    arena_free(NULL, 0);
+
+    /* Releasing the mark makes the memory available again */
+    void *inner = arena_mark();
+    char *d = arena_alloc(64);
+    ck_assert_ptr_nonnull(d);
+    arena_release(inner);
+    ck_assert_ptr_eq(arena_alloc(64), d);
+
+    /* Releasing the outer mark also releases the big chunk */
+    arena_release(mark);
+    ck_assert_ptr_eq(arena_alloc(1), a);
+
+    arena_release(mark);
 }
 END_TEST
 
@@ -937,6 +1256,698 @@ START_TEST(test_asm_utils_write_block)
 }
 END_TEST
 
+/*------------------------------------------------------------------*/
+
+START_TEST(test_asm_utils_cpu_features)
+{
+    /* Must match the CPU_FEATURE_* values in header.inc */
+    const unsigned int ssse3 = (1 << 0);
+    const unsigned int sse42 = (1 << 1);
+    const unsigned int pclmul = (1 << 2);
+    const unsigned int avx2 = (1 << 4);
+
+    __builtin_cpu_init();
+
+    unsigned int features = cpu_features();
+
+    ck_assert_int_eq(!!(features & ssse3), !!__builtin_cpu_supports("ssse3"));
+    ck_assert_int_eq(!!(features & sse42), !!__builtin_cpu_supports("sse4.2"));
+    ck_assert_int_eq(!!(features & pclmul), !!__builtin_cpu_supports("pclmul"));
+    ck_assert_int_eq(!!(features & avx2), !!__builtin_cpu_supports("avx2"));
+
+    /* The value is cached */
+    ck_assert_int_eq(cpu_features(), features);
+}
+END_TEST
+
+/* Simple (bit at a time) reference implementations. */
+
+static uint32_t
+ref_crc32_posix(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint32_t)buf[i] << 24;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+static uint32_t
+ref_crc32c(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1);
+        }
+    }
+
+    return crc;
+}
+
+static uint32_t
+ref_crc32(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+
+    return crc;
+}
+
+START_TEST(test_asm_utils_crc32)
+{
+    /* Large enough for all the code paths (folding, multiple streams
+     * and trailing bytes).
+     */
+    const size_t buf_size = (64 * 1024) + 64;
+
+    unsigned char *buf = malloc(buf_size);
+    ck_assert_ptr_nonnull(buf);
+
+    srand(1);
+
+    for (size_t i = 0; i < buf_size; i++) {
+        buf[i] = (unsigned char)rand();
+    }
+
+    /* Known values */
+    const char *check = "123456789";
+
+    ck_assert_uint_eq(crc32c_update(0xffffffff, check, 9) ^ 0xffffffff,
+            0xe3069283);
+
+    ck_assert_uint_eq(crc32_update(0xffffffff, check, 9) ^ 0xffffffff,
+            0xcbf43926);
+
+    /* $ printf 'hello\n' | cksum */
+    uint32_t crc = crc32_posix_update(0, "hello\n", 6);
+    ck_assert_uint_eq(crc32_posix_final(crc, 6), 3015617425U);
+
+    /* $ cksum < /dev/null */
+    ck_assert_uint_eq(crc32_posix_final(0, 0), 4294967295U);
+
+    size_t lengths[] = {
+        0, 1, 7, 8, 15, 16, 63, 64, 65, 127, 128, 1000,
+        3071, 3072, 3073, 4096, 6144 + 17, 64 * 1024,
+    };
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        size_t len = lengths[i];
+
+        /* Check unaligned data too */
+        for (size_t offset = 0; offset < 64; offset += 7) {
+            const unsigned char *p = buf + offset;
+
+            uint32_t initial = (uint32_t)rand();
+
+            ck_assert_uint_eq(crc32_posix_update(initial, p, len),
+                    ref_crc32_posix(initial, p, len));
+
+            ck_assert_uint_eq(crc32c_update(initial, p, len),
+                    ref_crc32c(initial, p, len));
+
+            ck_assert_uint_eq(crc32_update(initial, p, len),
+                    ref_crc32(initial, p, len));
+        }
+    }
+
+    /* Splitting the data must not change the result */
+    crc = crc32_posix_update(0, buf, 1000);
+    crc = crc32_posix_update(crc, buf + 1000, 9000);
+    ck_assert_uint_eq(crc, ref_crc32_posix(0, buf, 10000));
+
+    crc = crc32c_update(0xffffffff, buf, 5000);
+    crc = crc32c_update(crc, buf + 5000, 5000);
+    ck_assert_uint_eq(crc, ref_crc32c(0xffffffff, buf, 10000));
+
+    crc = crc32_update(0xffffffff, buf, 4999);
+    crc = crc32_update(crc, buf + 4999, 5001);
+    ck_assert_uint_eq(crc, ref_crc32(0xffffffff, buf, 10000));
+
+    free(buf);
+}
+END_TEST
+
+/* Decode a raw DEFLATE stream, returning the inflate_stream() result
+ * and the output.
+ */
+static int
+inflate_test_stream(Inflate *inf, const void *data, size_t len,
+        char *out, size_t out_size, size_t *out_len)
+{
+    FILE *in_file = tmpfile();
+    FILE *out_file = tmpfile();
+
+    ck_assert_ptr_nonnull(in_file);
+    ck_assert_ptr_nonnull(out_file);
+
+    ck_assert_uint_eq(fwrite(data, 1, len, in_file), len);
+    ck_assert_int_eq(fflush(in_file), 0);
+    rewind(in_file);
+
+    inf->out_fd = fileno(out_file);
+    inflate_input(inf, fileno(in_file));
+
+    int ret = inflate_stream(inf);
+
+    ck_assert_int_eq(lseek(fileno(out_file), 0, SEEK_SET), 0);
+    ssize_t bytes = read(fileno(out_file), out, out_size);
+    ck_assert_int_ge(bytes, 0);
+    *out_len = (size_t)bytes;
+
+    fclose(in_file);
+    fclose(out_file);
+
+    return ret;
+}
+
+START_TEST(test_asm_utils_inflate)
+{
+    /* Streams created with zlib (raw DEFLATE). */
+
+    /* Stored block: "stored data" */
+    const unsigned char stored[] = {
+        0x01, 0x0b, 0x00, 0xf4, 0xff, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64,
+        0x20, 0x64, 0x61, 0x74, 0x61,
+    };
+
+    /* Fixed Huffman block: "hello hello hello hello\n" followed by
+     * two bytes which are not part of the stream.
+     */
+    const unsigned char fixed[] = {
+        0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0xc8, 0x40, 0x27, 0xb9, 0x00,
+        0x01, 0x02,
+    };
+
+    /* Dynamic Huffman block: the 100 bytes created below. */
+    const unsigned char dynamic[] = {
+        0x35, 0x8c, 0xc1, 0x0d, 0x00, 0x30, 0x08, 0x02, 0x67, 0xe5, 0x80,
+        0xfd, 0x57, 0xa8, 0xb6, 0x29, 0x0f, 0x43, 0x38, 0x50, 0x11, 0x20,
+        0x24, 0xd7, 0x96, 0x54, 0x65, 0xcf, 0x68, 0x72, 0x0f, 0x5a, 0x26,
+        0xfc, 0xc8, 0x56, 0xc7, 0xa3, 0x14, 0xda, 0x1b, 0xd9, 0x64, 0x4b,
+        0x31, 0xce, 0x5b, 0xf6, 0x8f, 0xe6, 0x01, 0x1c,
+    };
+
+    /* Block type 3 is reserved. */
+    const unsigned char bad_type[] = { 0x07 };
+
+    /* Stored block whose length check is wrong. */
+    const unsigned char bad_stored[] = { 0x01, 0x0b, 0x00, 0xf4, 0xfe, 0x73 };
+
+    char expected[100];
+    char out[256];
+    size_t len;
+
+    uint32_t x = 1;
+
+    for (size_t i = 0; i < sizeof(expected); i++) {
+        x = (x * 1103515245 + 12345) & 0x7fffffff;
+        expected[i] = "aaaaaaaabbbbccde"[(x >> 16) % 16];
+    }
+
+    Inflate *inf = malloc(sizeof(Inflate));
+    ck_assert_ptr_nonnull(inf);
+
+    void *mark = arena_mark();
+
+    ck_assert_int_eq(inflate_init(inf, -1), 0);
+
+    ck_assert_int_eq(inflate_test_stream(inf, stored, sizeof(stored),
+                out, sizeof(out), &len), 0);
+    ck_assert_uint_eq(len, 11);
+    ck_assert(! memcmp(out, "stored data", 11));
+    ck_assert_uint_eq(inf->size, 11);
+
+    ck_assert_int_eq(inflate_test_stream(inf, fixed, sizeof(fixed),
+                out, sizeof(out), &len), 0);
+    ck_assert_uint_eq(len, 24);
+    ck_assert(! memcmp(out, "hello hello hello hello\n", 24));
+
+    /* The bytes after the stream are still available. */
+    ck_assert_int_eq(inflate_byte(inf), 1);
+    ck_assert_int_eq(inflate_byte(inf), 2);
+    ck_assert_int_eq(inflate_byte(inf), INFLATE_ERR_EOF);
+
+    ck_assert_int_eq(inflate_test_stream(inf, dynamic, sizeof(dynamic),
+                out, sizeof(out), &len), 0);
+    ck_assert_uint_eq(len, sizeof(expected));
+    ck_assert(! memcmp(out, expected, sizeof(expected)));
+    ck_assert_uint_eq(inf->size, sizeof(expected));
+    ck_assert_uint_eq((uint32_t)inf->crc ^ 0xffffffff, 414598023U);
+
+    ck_assert_int_eq(inflate_test_stream(inf, dynamic, 20,
+                out, sizeof(out), &len), INFLATE_ERR_EOF);
+
+    ck_assert_int_eq(inflate_test_stream(inf, bad_type, sizeof(bad_type),
+                out, sizeof(out), &len), INFLATE_ERR_FORMAT);
+
+    ck_assert_int_eq(inflate_test_stream(inf, bad_stored, sizeof(bad_stored),
+                out, sizeof(out), &len), INFLATE_ERR_FORMAT);
+
+    ck_assert_int_eq(inflate_test_stream(inf, stored, 0,
+                out, sizeof(out), &len), INFLATE_ERR_EOF);
+
+    arena_release(mark);
+    free(inf);
+}
+END_TEST
+
+START_TEST(test_asm_utils_base64)
+{
+    /* RFC 4648 test vectors */
+    struct test_base64 {
+        const char *data;
+        const char *encoded;
+    } tests[] = {
+        { "", "" },
+        { "f", "Zg==" },
+        { "fo", "Zm8=" },
+        { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" },
+        { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" },
+    };
+
+    char encoded[4096];
+    unsigned char data[3000];
+    unsigned char decoded[3000];
+    Base64Decoder dec;
+    size_t len;
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        struct test_base64 *t = &tests[i];
+
+        len = base64_encode(t->data, strlen(t->data), encoded);
+        ck_assert_uint_eq(len, strlen(t->encoded));
+        ck_assert(! memcmp(encoded, t->encoded, len));
+
+        memset(&dec, 0, sizeof(dec));
+        len = base64_decode(&dec, t->encoded, strlen(t->encoded), decoded);
+        len += base64_decode_final(&dec, decoded + len);
+        ck_assert_uint_eq(dec.invalid, 0);
+        ck_assert_uint_eq(len, strlen(t->data));
+        ck_assert(! memcmp(decoded, t->data, len));
+    }
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (unsigned char)((i * 7919) >> 3);
+    }
+
+    /* Lengths either side of the SIMD block sizes */
+    for (size_t n = 0; n < sizeof(data); n += (n < 100 ? 1 : 97)) {
+        size_t chars = base64_encode(data, n, encoded);
+        ck_assert_uint_eq(chars, 4 * ((n + 2) / 3));
+
+        /* Decode in uneven pieces */
+        memset(&dec, 0, sizeof(dec));
+        len = 0;
+
+        for (size_t pos = 0; pos < chars; ) {
+            size_t piece = (pos % 5) + 13;
+
+            if (piece > chars - pos) {
+                piece = chars - pos;
+            }
+
+            len += base64_decode(&dec, encoded + pos, piece, decoded + len);
+            pos += piece;
+        }
+
+        len += base64_decode_final(&dec, decoded + len);
+        ck_assert_uint_eq(dec.invalid, 0);
+        ck_assert_uint_eq(len, n);
+        ck_assert(! memcmp(decoded, data, n));
+    }
+
+    /* Newlines are ignored */
+    memset(&dec, 0, sizeof(dec));
+    len = base64_decode(&dec, "Zm9v\nYmFy\n", 10, decoded);
+    ck_assert_uint_eq(dec.invalid, 0);
+    ck_assert_uint_eq(len, 6);
+    ck_assert(! memcmp(decoded, "foobar", 6));
+
+    /* Data before invalid input is still decoded */
+    memset(&dec, 0, sizeof(dec));
+    len = base64_decode(&dec, "Zm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFy*mFy", 36,
+            decoded);
+    ck_assert_uint_ne(dec.invalid, 0);
+    ck_assert_uint_eq(len, 24);
+
+    /* Missing padding */
+    memset(&dec, 0, sizeof(dec));
+    len = base64_decode(&dec, "Zm9vYg", 6, decoded);
+    len += base64_decode_final(&dec, decoded + len);
+    ck_assert_uint_ne(dec.invalid, 0);
+    ck_assert_uint_eq(len, 4);
+    ck_assert(! memcmp(decoded, "foob", 4));
+}
+END_TEST
+
+static int
+sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+START_TEST(test_asm_utils_asm_memcmp)
+{
+    struct test_memcmp {
+        const char *s1;
+        const char *s2;
+        size_t n;
+    } tests[] = {
+        { "", "", 0 },
+        { "a", "b", 0 },
+        { "a", "a", 1 },
+        { "a", "b", 1 },
+        { "b", "a", 1 },
+        { "hello", "hello", 5 },
+        { "hello", "help!", 5 },
+        { "help!", "hello", 5 },
+        { "hello", "hellp", 4 },
+        { "\x01", "\xff", 1 },
+        { "\xff", "\x01", 1 },
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        struct test_memcmp *t = &tests[i];
+
+        ck_assert_int_eq(sign(asm_memcmp(t->s1, t->s2, t->n)),
+                sign(memcmp(t->s1, t->s2, t->n)));
+    }
+}
+END_TEST
+
+START_TEST(test_asm_utils_asm_memdiff)
+{
+    /* Long enough for the 32 byte loop, the 16 byte block and the
+     * final overlapping vector.
+     */
+    char s1[100];
+    char s2[100];
+
+    for (size_t i = 0; i < sizeof(s1); i++) {
+        s1[i] = (char)(i * 7);
+    }
+
+    for (size_t n = 0; n <= sizeof(s1); n++) {
+        memcpy(s2, s1, sizeof(s1));
+
+        ck_assert_uint_eq(asm_memdiff(s1, s2, n), n);
+
+        for (size_t diff = 0; diff < n; diff++) {
+            memcpy(s2, s1, sizeof(s1));
+
+            /* Later differences must be ignored */
+            s2[diff] ^= 0x80;
+            s2[n - 1] ^= 0x01;
+
+            ck_assert_uint_eq(asm_memdiff(s1, s2, n), diff);
+
+            ck_assert_int_eq(sign(asm_memcmp(s1, s2, n)),
+                    sign(memcmp(s1, s2, n)));
+        }
+
+        /* Bytes beyond the length are ignored */
+        if (n < sizeof(s1)) {
+            memcpy(s2, s1, sizeof(s1));
+            s2[n] ^= 0x80;
+
+            ck_assert_uint_eq(asm_memdiff(s1, s2, n), n);
+        }
+    }
+}
+END_TEST
+
+START_TEST(test_asm_utils_asm_memmem)
+{
+    struct test_memmem {
+        const char *haystack;
+        const char *needle;
+    } tests[] = {
+        { "", "" },
+        { "", "a" },
+        { "a", "" },
+        { "a", "a" },
+        { "a", "b" },
+        { "ab", "b" },
+        { "ab", "ab" },
+        { "ab", "abc" },
+        { "hello world", "o w" },
+        { "hello world", "world" },
+        { "hello world", "worlds" },
+        { "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", "aab" },
+        { "abababababababababababababababababac", "abac" },
+        { "the quick brown fox jumps over the lazy dog", "dog" },
+        { "the quick brown fox jumps over the lazy dog", "the" },
+        { "the quick brown fox jumps over the lazy dog", "lazy" },
+        { "the quick brown fox jumps over the lazy dog", "lazy cat" },
+    };
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        struct test_memmem *t = &tests[i];
+
+        size_t hlen = strlen(t->haystack);
+        size_t nlen = strlen(t->needle);
+
+        ck_assert_ptr_eq(asm_memmem(t->haystack, hlen, t->needle, nlen),
+                memmem(t->haystack, hlen, t->needle, nlen));
+    }
+
+    /* Random data from a small alphabet to create lots of partial
+     * matches, with needles cut from the haystack at various offsets
+     * (including the very end).
+     */
+    const size_t buf_size = 4096 + 33;
+
+    char *buf = malloc(buf_size);
+    ck_assert_ptr_nonnull(buf);
+
+    srand(2);
+
+    for (size_t i = 0; i < buf_size; i++) {
+        buf[i] = "abc\n"[rand() % 4];
+    }
+
+    size_t nlens[] = { 1, 2, 3, 4, 7, 16, 17, 40 };
+
+    for (size_t i = 0; i < sizeof(nlens) / sizeof(nlens[0]); i++) {
+        size_t nlen = nlens[i];
+
+        for (size_t offset = 0; offset + nlen <= buf_size; offset += 61) {
+            const char *needle = buf + offset;
+
+            for (size_t hlen = nlen; hlen <= buf_size; hlen += 509) {
+                ck_assert_ptr_eq(asm_memmem(buf, hlen, needle, nlen),
+                        memmem(buf, hlen, needle, nlen));
+            }
+        }
+
+        const char *needle = buf + buf_size - nlen;
+
+        ck_assert_ptr_eq(asm_memmem(buf, buf_size, needle, nlen),
+                memmem(buf, buf_size, needle, nlen));
+    }
+
+    free(buf);
+}
+END_TEST
+
+START_TEST(test_asm_utils_asm_memcount)
+{
+    /* Large enough to require multiple batches of blocks. */
+    const size_t buf_size = (16 * 255 * 3) + 21;
+
+    unsigned char *buf = malloc(buf_size);
+    ck_assert_ptr_nonnull(buf);
+
+    ck_assert_uint_eq(asm_memcount(buf, 'a', 0), 0);
+
+    /* All bytes match (so the byte counters are fully used) */
+    memset(buf, '\n', buf_size);
+
+    ck_assert_uint_eq(asm_memcount(buf, '\n', buf_size), buf_size);
+    ck_assert_uint_eq(asm_memcount(buf, 'a', buf_size), 0);
+
+    srand(3);
+
+    for (size_t i = 0; i < buf_size; i++) {
+        buf[i] = (unsigned char)rand();
+    }
+
+    for (size_t len = 0; len <= buf_size; len += 97) {
+        for (size_t offset = 0; offset < 3 && offset + len <= buf_size; offset++) {
+            for (int c = 0; c < 256; c += 51) {
+                size_t expected = 0;
+
+                for (size_t i = 0; i < len; i++) {
+                    if (buf[offset + i] == c) {
+                        expected++;
+                    }
+                }
+
+                ck_assert_uint_eq(asm_memcount(buf + offset, c, len), expected);
+            }
+        }
+    }
+
+    free(buf);
+}
+END_TEST
+
+START_TEST(test_asm_utils_inode_set)
+{
+    InodeSet *set = inode_set_new();
+    ck_assert_ptr_nonnull(set);
+
+    /* Enough pairs to grow the stripe tables several times */
+    const uint64_t count = 50000;
+
+    for (uint64_t ino = 1; ino <= count; ino++) {
+        ck_assert_int_eq(inode_set_add(set, 7, ino), 1);
+    }
+
+    for (uint64_t ino = 1; ino <= count; ino++) {
+        ck_assert_int_eq(inode_set_add(set, 7, ino), 0);
+    }
+
+    /* Same inode numbers on a different device */
+    for (uint64_t ino = 1; ino <= count; ino += 1000) {
+        ck_assert_int_eq(inode_set_add(set, 8, ino), 1);
+        ck_assert_int_eq(inode_set_add(set, 8, ino), 0);
+    }
+
+    inode_set_free(set);
+
+    inode_set_free(NULL);
+}
+END_TEST
+
+typedef struct walk_test_data {
+    size_t entries;
+    size_t dirs;
+    size_t max_depth;
+    const char *prune;
+} WalkTestData;
+
+static int
+walk_test_visit(WalkEntry *entry, void *data)
+{
+    WalkTestData *d = data;
+
+    ck_assert_ptr_nonnull(entry->path);
+    ck_assert_ptr_nonnull(entry->name);
+    ck_assert(entry->worker < 16);
+
+    __atomic_fetch_add(&d->entries, 1, __ATOMIC_SEQ_CST);
+
+    if (entry->type == 4 /* DT_DIR */) {
+        __atomic_fetch_add(&d->dirs, 1, __ATOMIC_SEQ_CST);
+    }
+
+    size_t depth = __atomic_load_n(&d->max_depth, __ATOMIC_SEQ_CST);
+
+    while (entry->depth > depth &&
+            !__atomic_compare_exchange_n(&d->max_depth, &depth, entry->depth,
+                false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        ;
+    }
+
+    if (d->prune && ! strcmp(entry->name, d->prune)) {
+        return 1; /* WALK_PRUNE */
+    }
+
+    return 0; /* WALK_CONTINUE */
+}
+
+START_TEST(test_asm_utils_walk_tree)
+{
+    char tmpdir[] = "/tmp/test-walk-XXXXXX";
+    char path[PATH_MAX];
+
+    ck_assert_ptr_nonnull(mkdtemp(tmpdir));
+
+    /* 20 directories, each with a 5 level deep chain of
+     * subdirectories, and 3 files in every directory.
+     */
+    const int dirs = 20;
+    const int levels = 5;
+    const int files = 3;
+
+    for (int i = 0; i < dirs; i++) {
+        int len = snprintf(path, sizeof(path), "%s/dir%d", tmpdir, i);
+
+        for (int level = 0; level < levels; level++) {
+            if (level) {
+                len += snprintf(path + len, sizeof(path) - len, "/sub");
+            }
+
+            ck_assert_int_eq(mkdir(path, 0700), 0);
+
+            for (int f = 0; f < files; f++) {
+                char file[PATH_MAX];
+
+                snprintf(file, sizeof(file), "%s/file%d", path, f);
+
+                int fd = open(file, O_CREAT|O_WRONLY, 0600);
+                ck_assert_int_ge(fd, 0);
+                close(fd);
+            }
+        }
+    }
+
+    WalkTestData data = { 0 };
+
+    Walk walk = {
+        .visit = walk_test_visit,
+        .data = &data,
+        .cmd = "test",
+    };
+
+    ck_assert_int_eq(walk_tree(&walk, tmpdir), 0);
+
+    size_t expected_dirs = 1 + (dirs * levels);
+
+    ck_assert_uint_eq(data.dirs, expected_dirs);
+    ck_assert_uint_eq(data.entries, expected_dirs + (dirs * levels * files));
+    ck_assert_uint_eq(data.max_depth, levels + 1);
+
+    /* Don't descend into the "sub" directories */
+    memset(&data, 0, sizeof(data));
+    data.prune = "sub";
+
+    ck_assert_int_eq(walk_tree(&walk, tmpdir), 0);
+
+    ck_assert_uint_eq(data.dirs, 1 + (dirs * 2));
+    ck_assert_uint_eq(data.entries, 1 + (dirs * 2) + (dirs * files));
+
+    /* A file as the starting path */
+    memset(&data, 0, sizeof(data));
+    snprintf(path, sizeof(path), "%s/dir0/file0", tmpdir);
+
+    ck_assert_int_eq(walk_tree(&walk, path), 0);
+    ck_assert_uint_eq(data.entries, 1);
+    ck_assert_uint_eq(data.dirs, 0);
+
+    /* A path that doesn't exist */
+    snprintf(path, sizeof(path), "%s/enoent", tmpdir);
+    ck_assert_int_eq(walk_tree(&walk, path), -1);
+
+    snprintf(path, sizeof(path), "rm -rf '%s'", tmpdir);
+    ck_assert_int_eq(system(path), 0);
+}
+END_TEST
+
 /*------------------------------------------------------------------*/
 /* Utilities */
 
@@ -1270,14 +2281,27 @@ asm_utils_suite(void)
     tcase_add_test(tc_core, internal_test_read_and_write);
 
     tcase_add_test(tc_core, test_asm_utils_alloc_args_buffer);
+    tcase_add_test(tc_core, test_asm_utils_arena);
     tcase_add_test(tc_core, test_asm_utils_argv_bytes);
     tcase_add_test(tc_core, test_asm_utils_asm_basename);
+    tcase_add_test(tc_core, test_asm_utils_asm_basename_len);
     tcase_add_test(tc_core, test_asm_utils_asm_getopt);
+    tcase_add_test(tc_core, test_asm_utils_asm_memcmp);
+    tcase_add_test(tc_core, test_asm_utils_asm_memdiff);
+    tcase_add_test(tc_core, test_asm_utils_asm_memcount);
+    tcase_add_test(tc_core, test_asm_utils_asm_memmem);
     tcase_add_test(tc_core, test_asm_utils_asm_strchr);
     tcase_add_test(tc_core, test_asm_utils_asm_strlen);
+    tcase_add_test(tc_core, test_asm_utils_base64);
+    tcase_add_test(tc_core, test_asm_utils_cpu_features);
+    tcase_add_test(tc_core, test_asm_utils_crc32);
     tcase_add_test(tc_core, test_asm_utils_errno);
+    tcase_add_test(tc_core, test_asm_utils_inflate);
+    tcase_add_test(tc_core, test_asm_utils_inode_set);
     tcase_add_test(tc_core, test_asm_utils_libc_strtol);
+    tcase_add_test(tc_core, test_asm_utils_num_to_timespec);
     tcase_add_test(tc_core, test_asm_utils_read_block);
+    tcase_add_test(tc_core, test_asm_utils_walk_tree);
     tcase_add_test(tc_core, test_asm_utils_write_block);
 
     /*------------------------------*/
@@ -0,0 +1,1146 @@
+;---------------------------------------------------------------------
+; vim:set expandtab:
+;---------------------------------------------------------------------
+; Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+;
+; SPDX-License-Identifier: Apache-2.0
+;---------------------------------------------------------------------
+
+%include "header.inc"
+%include "walk.inc"
+
+global walk_statx
+global walk_tree
+
+extern futex_wait
+extern futex_wake
+
+extern calloc
+extern close
+extern dprintf
+extern free
+extern get_nprocs
+extern malloc
+extern memcpy
+extern open
+extern pthread_create
+extern pthread_join
+extern pthread_mutex_destroy
+extern pthread_mutex_init
+extern pthread_mutex_lock
+extern pthread_mutex_unlock
+extern realloc
+extern statx
+extern strlen
+extern strrchr
+
+; Size of the buffer each thread passes to getdents64(2). A large
+; buffer means fewer system calls for big directories.
+WALK_DENTS_BUF_SIZE     equ     (256 * 1024)
+
+; Initial number of items a worker queue can hold.
+%assign WALK_INITIAL_ITEMS      64
+
+; Flags for opening a directory to read.
+%assign WALK_OPEN_FLAGS         (O_RDONLY|O_DIRECTORY|O_NOFOLLOW|O_CLOEXEC)
+
+; Flags for statx(2): never follow symbolic links.
+%assign WALK_STATX_FLAGS        (AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT)
+
+;---------------------------------------------------------------------
+; A directory waiting to be read.
+;---------------------------------------------------------------------
+struc WalkItem
+    .depth      resq    1 ; size_t: depth of directory.
+    .len        resq    1 ; size_t: length of .path.
+    .path       resb    1 ; Start of null-terminated path.
+endstruc
+
+;---------------------------------------------------------------------
+; A walk thread and its queue of directories.
+;
+; The queue is a double-ended queue: the owning thread adds and
+; removes items at the tail (so it walks depth first and the queue
+; stays short), and idle threads steal from the head (so they take
+; the directories nearest the top, which are likely to contain the
+; most work).
+;---------------------------------------------------------------------
+struc WalkWorker
+
+%ifdef NASM
+    align 8,db 0
+%endif
+
+%ifdef YASM
+    align 8
+%endif
+    ; Queue (shared).
+    .lock       resb    PTHREAD_MUTEX_T_SIZE ; pthread_mutex_t: protects the queue.
+    .items      resq    1 ; "WalkItem **": queue array.
+    .head       resq    1 ; size_t: index of first item.
+    .tail       resq    1 ; size_t: index after last item.
+    .cap        resq    1 ; size_t: size of .items.
+
+    ; Private.
+    .walk       resq    1 ; "Walk *"
+    .index      resq    1 ; size_t: index of worker.
+    .thread     resq    1 ; pthread_t.
+    .started    resq    1 ; bool: true if .thread needs to be joined.
+    .dents      resq    1 ; "char *": getdents64(2) buffer.
+    .path       resq    1 ; "char *": path buffer (PATH_MAX bytes).
+    .entry      resb    WalkEntry_size
+
+    ; Keeps the private data written by this worker away from the
+    ; next worker's queue.
+    .pad        resb    CACHE_LINE_SIZE
+endstruc
+
+section .text
+
+;---------------------------------------------------------------------
+; Description: Walk a directory tree using multiple threads, calling a
+;   function for every entry (including the starting path).
+;
+; C prototype equivalent:
+;
+;     int walk_tree(Walk *walk, const char *path);
+;
+; Parameters:
+;
+; - Input: RDI (address) - Walk (with .visit, .data and .cmd set).
+; - Input: RSI (string) - starting path.
+; - Output: RAX (integer) - 0 on success, or -1 if any part of the tree
+;   could not be read (an error is displayed).
+;
+; Notes:
+;
+; - Each thread reads directories with getdents64(2) into a large
+;   buffer. Entry types come from the directory (d_type), so no
+;   stat(2) is needed just to find the subdirectories. Only file
+;   systems that do not provide d_type need a statx(2) call. Visit
+;   functions needing other details call walk_statx() with just the
+;   fields they need.
+;
+; - Each thread queues the subdirectories it finds. Idle threads steal
+;   from the queues of other threads, so all the threads keep busy
+;   however unbalanced the tree is. Threads with nothing to steal
+;   sleep on a futex until more work is queued or the walk finishes.
+;
+; - The visit function is called concurrently from all the threads
+;   and the order entries are visited is not defined (although a
+;   directory is always visited before its contents).
+;
+; - Symbolic links are not followed (including the starting path) and
+;   paths must be shorter than PATH_MAX.
+;
+; See: walk_statx().
+;---------------------------------------------------------------------
+
+walk_tree:
+section .rodata
+    .stat_fmt       db  "%s: cannot access '%s'",10,0
+    .alloc_fmt      db  "%s: out of memory",10,0
+section .text
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .walk       equ     0   ; "Walk *"
+    .path       equ     8   ; "char *"
+    .i          equ    16   ; size_t: worker index.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.walk], rdi
+    mov     [rsp+.path], rsi
+
+    ;--------------------
+
+    mov     qword [rdi+Walk.error], 0
+    mov     qword [rdi+Walk.pending], 0
+    mov     dword [rdi+Walk.seq], 0
+    mov     dword [rdi+Walk.sleepers], 0
+    mov     qword [rdi+Walk.workers], 0
+    mov     qword [rdi+Walk.nworkers], 0
+
+    mov     qword [rsp+.ret], -1
+    mov     qword [rsp+.i], 0
+
+    ;--------------------
+    ; nworkers = max(1, min(get_nprocs(), WALK_MAX_THREADS))
+
+    dcall   get_nprocs
+    cdqe
+
+    cmp     rax, WALK_MAX_THREADS
+    jle     .max_ok
+
+    mov     rax, WALK_MAX_THREADS
+
+.max_ok:
+    cmp     rax, 1
+    jge     .min_ok
+
+    mov     rax, 1
+
+.min_ok:
+    mov     rdi, [rsp+.walk]
+    mov     [rdi+Walk.nworkers], rax
+
+    ;--------------------
+    ; Create the workers.
+
+    mov     rdi, rax
+    mov     rsi, WalkWorker_size
+    dcall   calloc
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     rdi, [rsp+.walk]
+    mov     [rdi+Walk.workers], rax
+
+    mov     qword [rsp+.i], 0
+
+.next_worker:
+    mov     rdi, [rsp+.walk]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Walk.nworkers]
+    je      .workers_ready
+
+    imul    rbx, rax, WalkWorker_size
+    add     rbx, [rdi+Walk.workers]
+
+    mov     [rbx+WalkWorker.walk], rdi
+    mov     [rbx+WalkWorker.index], rax
+    mov     [rbx+WalkWorker.entry+WalkEntry.worker], rax
+
+    lea     rdi, [rbx+WalkWorker.lock]
+    mov     rsi, 0 ; Default attributes.
+    dcall   pthread_mutex_init
+
+    ; Note: Increment first so the cleanup also frees a partly
+    ; initialised worker.
+    inc     qword [rsp+.i]
+
+    mov     rdi, WALK_DENTS_BUF_SIZE
+    dcall   malloc
+    mov     [rbx+WalkWorker.dents], rax
+    cmp     rax, 0
+    je      .error_alloc
+
+    mov     rdi, PATH_MAX
+    dcall   malloc
+    mov     [rbx+WalkWorker.path], rax
+    cmp     rax, 0
+    je      .error_alloc
+
+    jmp     .next_worker
+
+.workers_ready:
+    ;--------------------
+    ; Visit the starting path using the first worker.
+
+    mov     rdi, [rsp+.walk]
+    mov     rbx, [rdi+Walk.workers]
+
+    mov     rdi, [rsp+.path]
+    dcall   strlen
+    cmp     rax, PATH_MAX
+    jae     .error_stat
+
+    mov     rdi, [rbx+WalkWorker.path]
+    mov     rsi, [rsp+.path]
+    lea     rdx, [rax+1] ; Include the terminator.
+    dcall   memcpy
+
+    lea     rdi, [rbx+WalkWorker.entry]
+    mov     rax, [rbx+WalkWorker.path]
+    mov     [rdi+WalkEntry.path], rax
+    mov     [rdi+WalkEntry.name], rax
+    mov     qword [rdi+WalkEntry.dirfd], AT_FDCWD
+    mov     qword [rdi+WalkEntry.type], DT_UNKNOWN
+    mov     qword [rdi+WalkEntry.depth], 0
+
+    ; The name is the part after the last '/' (unless that is empty).
+    mov     rdi, rax
+    mov     rsi, '/'
+    dcall   strrchr
+    cmp     rax, 0
+    je      .stat_root
+
+    cmp     byte [rax+1], 0
+    je      .stat_root
+
+    inc     rax
+    mov     [rbx+WalkWorker.entry+WalkEntry.name], rax
+
+.stat_root:
+    lea     rdi, [rbx+WalkWorker.entry]
+    mov     rsi, STATX_TYPE
+    dcall   walk_statx
+    cmp     rax, 0
+    jne     .error_stat
+
+    lea     rdi, [rbx+WalkWorker.entry]
+    mov     rax, [rsp+.walk]
+    mov     rsi, [rax+Walk.data]
+    mov     rax, [rax+Walk.visit]
+    dcall   rax
+    cmp     rax, WALK_CONTINUE
+    jne     .done
+
+    cmp     qword [rbx+WalkWorker.entry+WalkEntry.type], DT_DIR
+    jne     .done
+
+    ;--------------------
+    ; Queue the starting directory, then start the threads.
+
+    mov     rdi, rbx
+    dcall   walk_queue_entry
+    cmp     rax, 0
+    jne     .error_alloc
+
+    mov     qword [rsp+.i], 1
+
+.start_next:
+    mov     rdi, [rsp+.walk]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Walk.nworkers]
+    je      .run
+
+    imul    rbx, rax, WalkWorker_size
+    add     rbx, [rdi+Walk.workers]
+
+    ; If the thread cannot be created, the other threads simply do
+    ; more of the work.
+    lea     rdi, [rbx+WalkWorker.thread]
+    mov     rsi, 0 ; Default thread attributes.
+    mov     rdx, walk_worker
+    mov     rcx, rbx
+    dcall   pthread_create
+    cmp     eax, 0
+    jne     .started
+
+    mov     qword [rbx+WalkWorker.started], 1
+
+.started:
+    inc     qword [rsp+.i]
+    jmp     .start_next
+
+.run:
+    ; This thread is the first worker.
+    mov     rdi, [rsp+.walk]
+    mov     rdi, [rdi+Walk.workers]
+    dcall   walk_worker
+
+    mov     qword [rsp+.i], 1
+
+.join_next:
+    mov     rdi, [rsp+.walk]
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Walk.nworkers]
+    je      .done
+
+    imul    rbx, rax, WalkWorker_size
+    add     rbx, [rdi+Walk.workers]
+
+    cmp     qword [rbx+WalkWorker.started], 0
+    je      .joined
+
+    mov     rdi, [rbx+WalkWorker.thread]
+    mov     rsi, 0 ; Ignore the thread return value.
+    dcall   pthread_join
+
+.joined:
+    inc     qword [rsp+.i]
+    jmp     .join_next
+
+.done:
+    mov     rdi, [rsp+.walk]
+    mov     rax, [rdi+Walk.nworkers]
+    mov     [rsp+.i], rax
+
+    cmp     qword [rdi+Walk.error], 0
+    jne     .cleanup
+
+    mov     qword [rsp+.ret], 0
+
+.cleanup:
+    ;--------------------
+    ; Free the (first .i) workers.
+
+    mov     rdi, [rsp+.walk]
+    cmp     qword [rdi+Walk.workers], 0
+    je      .out
+
+.free_next:
+    cmp     qword [rsp+.i], 0
+    je      .free_workers
+
+    dec     qword [rsp+.i]
+
+    mov     rdi, [rsp+.walk]
+    mov     rax, [rsp+.i]
+    imul    rbx, rax, WalkWorker_size
+    add     rbx, [rdi+Walk.workers]
+
+    mov     rdi, [rbx+WalkWorker.dents]
+    dcall   free
+
+    mov     rdi, [rbx+WalkWorker.path]
+    dcall   free
+
+    mov     rdi, [rbx+WalkWorker.items]
+    dcall   free
+
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_destroy
+
+    jmp     .free_next
+
+.free_workers:
+    mov     rdi, [rsp+.walk]
+    mov     rax, [rdi+Walk.workers]
+    mov     qword [rdi+Walk.workers], 0
+
+    mov     rdi, rax
+    dcall   free
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_stat:
+    mov     rdi, STDERR_FD
+    mov     rsi, .stat_fmt
+    mov     rax, [rsp+.walk]
+    mov     rdx, [rax+Walk.cmd]
+    mov     rcx, [rsp+.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    jmp     .failed
+
+.error_alloc:
+    mov     rdi, STDERR_FD
+    mov     rsi, .alloc_fmt
+    mov     rax, [rsp+.walk]
+    mov     rdx, [rax+Walk.cmd]
+    xor     rax, rax
+    dcall   dprintf
+
+.failed:
+    mov     rdi, [rsp+.walk]
+    mov     qword [rdi+Walk.error], 1
+
+    ; Only free the workers that were initialised.
+    mov     rax, [rsp+.i]
+    cmp     rax, [rdi+Walk.nworkers]
+    jb      .cleanup
+
+    jmp     .done
+
+;---------------------------------------------------------------------
+; Description: Get the details of an entry found by walk_tree().
+;
+; C prototype equivalent:
+;
+;     int walk_statx(WalkEntry *entry, unsigned int mask);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkEntry.
+; - Input: RSI (integer) - STATX_* fields required.
+; - Output: RAX (integer) - 0 on success (WalkEntry.stx is set),
+;   or -1 on error.
+;
+; Notes:
+;
+; - The entry is looked up relative to the open directory it was
+;   found in, so the kernel does not have to resolve the whole path
+;   again.
+;
+; - Requesting only the fields needed allows network file systems to
+;   avoid fetching the rest.
+;
+; - WalkEntry.type is also set (since the type is always returned).
+;
+; See: statx(2).
+;---------------------------------------------------------------------
+
+walk_statx:
+    prologue_with_vars 0
+
+    mov     rbx, rdi ; Preserved across calls.
+
+    mov     rcx, rsi ; mask.
+
+    mov     rdi, [rbx+WalkEntry.dirfd]
+    mov     rsi, [rbx+WalkEntry.name]
+
+    cmp     rdi, AT_FDCWD
+    jne     .stat
+
+    mov     rsi, [rbx+WalkEntry.path]
+
+.stat:
+    mov     rdx, WALK_STATX_FLAGS
+    lea     r8, [rbx+WalkEntry.stx]
+    dcall   statx
+    cmp     eax, 0
+    jne     .error
+
+    ; DT_* value = (S_IF* >> 12)
+    movzx   eax, word [rbx+WalkEntry.stx+Statx.stx_mode]
+    and     eax, S_IFMT
+    shr     eax, 12
+    mov     [rbx+WalkEntry.type], rax
+
+    xor     rax, rax
+    jmp     .out
+
+.error:
+    mov     rax, -1
+
+.out:
+    epilogue_with_vars 0
+    ret
+
+;---------------------------------------------------------------------
+; Description: Thread function for a walk worker: read directories
+;   until there are none left.
+;
+; C prototype equivalent:
+;
+;     void *walk_worker(WalkWorker *worker);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkWorker.
+; - Output: RAX (address) - always NULL.
+;
+; Notes:
+;
+; - Walk.pending counts the directories queued or being read. A
+;   directory is only removed from the count after its subdirectories
+;   have been queued, so the count only reaches zero when the walk is
+;   complete.
+;
+; - A worker with nothing to do registers in Walk.sleepers *before*
+;   checking the queues for a final time, and walk_queue_entry() only
+;   wakes sleepers after adding to a queue. Hence either the worker
+;   sees the new item, or it is woken (or Walk.seq has already changed
+;   and futex_wait() returns at once).
+;---------------------------------------------------------------------
+
+walk_worker:
+    prologue_with_vars 2
+
+    ;--------------------
+    ; Stack offsets.
+
+    .worker     equ     0   ; "WalkWorker *"
+    .item       equ     8   ; "WalkItem *"
+
+    ;--------------------
+
+    mov     [rsp+.worker], rdi
+
+.next_item:
+    mov     rdi, [rsp+.worker]
+    dcall   walk_get
+    cmp     rax, 0
+    je      .idle
+
+.process:
+    mov     [rsp+.item], rax
+
+    mov     rdi, [rsp+.worker]
+    mov     rsi, rax
+    dcall   walk_dir
+
+    mov     rdi, [rsp+.item]
+    dcall   free
+
+    ; pending-- (rax = old value)
+    mov     rdi, [rsp+.worker]
+    mov     rdi, [rdi+WalkWorker.walk]
+    mov     rax, -1
+    lock xadd [rdi+Walk.pending], rax
+    cmp     rax, 1
+    jne     .next_item
+
+    ; The walk is complete, so wake all the sleepers.
+    lock inc dword [rdi+Walk.seq]
+    add     rdi, Walk.seq
+    mov     rsi, WALK_MAX_THREADS
+    dcall   futex_wake
+
+    jmp     .out
+
+.idle:
+    mov     rdi, [rsp+.worker]
+    mov     rdi, [rdi+WalkWorker.walk]
+    cmp     qword [rdi+Walk.pending], 0
+    je      .out
+
+    lock inc dword [rdi+Walk.sleepers]
+
+    ; Remember the futex value before the final check.
+    mov     eax, [rdi+Walk.seq]
+    mov     [rsp+.item], rax
+
+    mov     rdi, [rsp+.worker]
+    dcall   walk_get
+    cmp     rax, 0
+    jne     .woken_with_item
+
+    mov     rdi, [rsp+.worker]
+    mov     rdi, [rdi+WalkWorker.walk]
+    cmp     qword [rdi+Walk.pending], 0
+    je      .woken
+
+    add     rdi, Walk.seq
+    mov     rsi, [rsp+.item]
+    dcall   futex_wait
+
+.woken:
+    mov     rdi, [rsp+.worker]
+    mov     rdi, [rdi+WalkWorker.walk]
+    lock dec dword [rdi+Walk.sleepers]
+    jmp     .next_item
+
+.woken_with_item:
+    mov     rdi, [rsp+.worker]
+    mov     rdi, [rdi+WalkWorker.walk]
+    lock dec dword [rdi+Walk.sleepers]
+    jmp     .process
+
+.out:
+    xor     rax, rax
+
+    epilogue_with_vars 2
+    ret
+
+;---------------------------------------------------------------------
+; Description: Take a directory from the worker's own queue, or steal
+;   one from another worker.
+;
+; C prototype equivalent:
+;
+;     WalkItem *walk_get(WalkWorker *worker);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkWorker.
+; - Output: RAX (address) - WalkItem, or 0 if all the queues are empty.
+;---------------------------------------------------------------------
+
+walk_get:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .worker     equ     0   ; "WalkWorker *"
+    .i          equ     8   ; size_t: number of other workers tried.
+    .item       equ    16   ; "WalkItem *"
+    .victim     equ    24   ; size_t: index of worker to steal from.
+
+    ;--------------------
+
+    mov     [rsp+.worker], rdi
+    mov     qword [rsp+.item], 0
+
+    ;--------------------
+    ; Take the newest item from this worker's queue.
+
+    mov     rbx, rdi
+
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_lock
+
+    mov     rax, [rbx+WalkWorker.tail]
+    cmp     rax, [rbx+WalkWorker.head]
+    je      .unlock_own
+
+    dec     rax
+    mov     [rbx+WalkWorker.tail], rax
+
+    mov     rcx, [rbx+WalkWorker.items]
+    mov     rcx, [rcx+rax*8]
+    mov     [rsp+.item], rcx
+
+    ; Reuse the array from the start once it is empty.
+    cmp     rax, [rbx+WalkWorker.head]
+    jne     .unlock_own
+
+    mov     qword [rbx+WalkWorker.head], 0
+    mov     qword [rbx+WalkWorker.tail], 0
+
+.unlock_own:
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_unlock
+
+    cmp     qword [rsp+.item], 0
+    jne     .out
+
+    ;--------------------
+    ; Steal the oldest item from the other workers, starting with the
+    ; next one.
+
+    mov     rax, [rsp+.worker]
+    mov     rax, [rax+WalkWorker.index]
+    mov     [rsp+.victim], rax
+    mov     qword [rsp+.i], 1
+
+.next_victim:
+    mov     rax, [rsp+.worker]
+    mov     rdx, [rax+WalkWorker.walk]
+    mov     rcx, [rdx+Walk.nworkers]
+
+    mov     rax, [rsp+.i]
+    cmp     rax, rcx
+    jae     .out
+
+    ; victim = (victim + 1) % nworkers
+    mov     rax, [rsp+.victim]
+    inc     rax
+    cmp     rax, rcx
+    jb      .victim_ok
+
+    xor     rax, rax
+
+.victim_ok:
+    mov     [rsp+.victim], rax
+
+    imul    rbx, rax, WalkWorker_size
+    add     rbx, [rdx+Walk.workers]
+
+    ; Check without the lock first to avoid contending for the lock of
+    ; an empty queue.
+    mov     rax, [rbx+WalkWorker.tail]
+    cmp     rax, [rbx+WalkWorker.head]
+    je      .victim_done
+
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_lock
+
+    mov     rax, [rbx+WalkWorker.head]
+    cmp     rax, [rbx+WalkWorker.tail]
+    je      .unlock_victim
+
+    mov     rcx, [rbx+WalkWorker.items]
+    mov     rcx, [rcx+rax*8]
+    mov     [rsp+.item], rcx
+
+    inc     rax
+    mov     [rbx+WalkWorker.head], rax
+
+    cmp     rax, [rbx+WalkWorker.tail]
+    jne     .unlock_victim
+
+    mov     qword [rbx+WalkWorker.head], 0
+    mov     qword [rbx+WalkWorker.tail], 0
+
+.unlock_victim:
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_unlock
+
+    cmp     qword [rsp+.item], 0
+    jne     .out
+
+.victim_done:
+    inc     qword [rsp+.i]
+    jmp     .next_victim
+
+.out:
+    mov     rax, [rsp+.item]
+
+    epilogue_with_vars 4
+    ret
+
+;---------------------------------------------------------------------
+; Description: Queue the directory in the worker's current entry to be
+;   read.
+;
+; C prototype equivalent:
+;
+;     int walk_queue_entry(WalkWorker *worker);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkWorker (whose .entry is a directory).
+; - Output: RAX (integer) - 0 on success, or -1 on error.
+;
+; Notes:
+;
+; A sleeping worker is only woken if there are any, so a busy walk
+; makes no futex calls.
+;---------------------------------------------------------------------
+
+walk_queue_entry:
+    prologue_with_vars 4
+
+    ;--------------------
+    ; Stack offsets.
+
+    .worker     equ     0   ; "WalkWorker *"
+    .item       equ     8   ; "WalkItem *"
+    .len        equ    16   ; size_t: length of path.
+    .ret        equ    24   ; int: return value.
+
+    ;--------------------
+
+    mov     [rsp+.worker], rdi
+    mov     qword [rsp+.ret], -1
+
+    ;--------------------
+    ; Create the item.
+
+    mov     rdi, [rdi+WalkWorker.entry+WalkEntry.path]
+    dcall   strlen
+    mov     [rsp+.len], rax
+
+    lea     rdi, [rax+WalkItem.path+1]
+    dcall   malloc
+    cmp     rax, 0
+    je      .out
+
+    mov     [rsp+.item], rax
+
+    mov     rbx, [rsp+.worker]
+    mov     rcx, [rbx+WalkWorker.entry+WalkEntry.depth]
+    mov     [rax+WalkItem.depth], rcx
+    mov     rcx, [rsp+.len]
+    mov     [rax+WalkItem.len], rcx
+
+    lea     rdi, [rax+WalkItem.path]
+    mov     rsi, [rbx+WalkWorker.entry+WalkEntry.path]
+    lea     rdx, [rcx+1] ; Include the terminator.
+    dcall   memcpy
+
+    ;--------------------
+    ; Add it to the tail of the queue.
+
+    mov     rdi, [rbx+WalkWorker.walk]
+    lock inc qword [rdi+Walk.pending]
+
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_lock
+
+    mov     rax, [rbx+WalkWorker.tail]
+    cmp     rax, [rbx+WalkWorker.cap]
+    jb      .add
+
+    ; Double the size of the queue.
+    mov     rsi, [rbx+WalkWorker.cap]
+    shl     rsi, 1
+    cmp     rsi, 0
+    jne     .grow
+
+    mov     rsi, WALK_INITIAL_ITEMS
+
+.grow:
+    mov     [rsp+.len], rsi ; Reuse.
+
+    mov     rdi, [rbx+WalkWorker.items]
+    shl     rsi, 3 ; Convert to bytes.
+    dcall   realloc
+    cmp     rax, 0
+    je      .error_grow
+
+    mov     [rbx+WalkWorker.items], rax
+    mov     rax, [rsp+.len]
+    mov     [rbx+WalkWorker.cap], rax
+
+    mov     rax, [rbx+WalkWorker.tail]
+
+.add:
+    mov     rcx, [rbx+WalkWorker.items]
+    mov     rdx, [rsp+.item]
+    mov     [rcx+rax*8], rdx
+    inc     qword [rbx+WalkWorker.tail]
+
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_unlock
+
+    mov     qword [rsp+.ret], 0
+
+    ;--------------------
+    ; Wake a sleeping worker to steal the item.
+
+    mov     rdi, [rbx+WalkWorker.walk]
+    cmp     dword [rdi+Walk.sleepers], 0
+    je      .out
+
+    lock inc dword [rdi+Walk.seq]
+    add     rdi, Walk.seq
+    mov     rsi, 1
+    dcall   futex_wake
+
+.out:
+    mov     rax, [rsp+.ret]
+
+    epilogue_with_vars 4
+    ret
+
+.error_grow:
+    lea     rdi, [rbx+WalkWorker.lock]
+    dcall   pthread_mutex_unlock
+
+    mov     rdi, [rbx+WalkWorker.walk]
+    lock dec qword [rdi+Walk.pending]
+
+    mov     rdi, [rsp+.item]
+    dcall   free
+
+    jmp     .out
+
+;---------------------------------------------------------------------
+; Description: Read a directory, visiting each entry and queueing the
+;   subdirectories.
+;
+; C prototype equivalent:
+;
+;     void walk_dir(WalkWorker *worker, WalkItem *item);
+;
+; Parameters:
+;
+; - Input: RDI (address) - WalkWorker.
+; - Input: RSI (address) - WalkItem for the directory.
+; - Output: None.
+;
+; Notes:
+;
+; Errors are displayed and recorded in Walk.error.
+;---------------------------------------------------------------------
+
+walk_dir:
+section .rodata
+    .read_fmt       db  "%s: cannot read directory '%s'",10,0
+    .long_fmt       db  "%s: path too long: '%s/%s'",10,0
+section .text
+    prologue_with_vars 8
+
+    ;--------------------
+    ; Stack offsets.
+
+    .worker     equ     0   ; "WalkWorker *"
+    .item       equ     8   ; "WalkItem *"
+    .fd         equ    16   ; int: directory.
+    .prefix_len equ    24   ; size_t: length of directory path + '/'.
+    .bytes      equ    32   ; size_t: bytes in .dents buffer.
+    .offset     equ    40   ; size_t: offset of next entry in buffer.
+    .name       equ    48   ; "char *": name of current entry.
+    .name_len   equ    56   ; size_t
+
+    ;--------------------
+    ; Save args
+
+    mov     [rsp+.worker], rdi
+    mov     [rsp+.item], rsi
+
+    ;--------------------
+
+    lea     rdi, [rsi+WalkItem.path]
+    mov     rsi, WALK_OPEN_FLAGS
+    dcall   open
+    cdqe
+    cmp     rax, -1
+    je      .error_read
+
+    mov     [rsp+.fd], rax
+
+    ;--------------------
+    ; Copy the directory path and a separator to the path buffer
+    ; (the separator is not needed if the path is "/").
+
+    mov     rbx, [rsp+.worker]
+    mov     rsi, [rsp+.item]
+
+    mov     rdi, [rbx+WalkWorker.path]
+    lea     rsi, [rsi+WalkItem.path]
+    mov     rax, [rsp+.item]
+    mov     rdx, [rax+WalkItem.len]
+    mov     [rsp+.prefix_len], rdx
+    dcall   memcpy
+
+    mov     rdi, [rbx+WalkWorker.path]
+    mov     rdx, [rsp+.prefix_len]
+    cmp     rdx, 0
+    je      .add_separator
+
+    cmp     byte [rdi+rdx-1], '/'
+    je      .read_entries
+
+.add_separator:
+    mov     byte [rdi+rdx], '/'
+    inc     qword [rsp+.prefix_len]
+
+.read_entries:
+    ; getdents64(fd, buf, size)
+    mov     rdi, [rsp+.fd]
+    mov     rsi, [rbx+WalkWorker.dents]
+    mov     rdx, WALK_DENTS_BUF_SIZE
+    mov     rax, SYS_getdents64
+    syscall
+
+    cmp     rax, 0
+    je      .close
+    jl      .error_getdents
+
+    mov     [rsp+.bytes], rax
+    mov     qword [rsp+.offset], 0
+
+.next_entry:
+    mov     rbx, [rsp+.worker]
+
+    mov     rax, [rsp+.offset]
+    cmp     rax, [rsp+.bytes]
+    jae     .read_entries
+
+    ; rcx = &dirent
+    mov     rcx, [rbx+WalkWorker.dents]
+    add     rcx, rax
+
+    movzx   edx, word [rcx+Dirent64.d_reclen]
+    add     [rsp+.offset], rdx
+
+    ;--------------------
+    ; Ignore "." and "..".
+
+    lea     rdi, [rcx+Dirent64.d_name]
+    mov     [rsp+.name], rdi
+
+    cmp     byte [rdi], '.'
+    jne     .not_dot
+
+    cmp     byte [rdi+1], 0
+    je      .next_entry
+
+    cmp     byte [rdi+1], '.'
+    jne     .not_dot
+
+    cmp     byte [rdi+2], 0
+    je      .next_entry
+
+.not_dot:
+    movzx   eax, byte [rcx+Dirent64.d_type]
+    mov     [rbx+WalkWorker.entry+WalkEntry.type], rax
+
+    dcall   strlen
+    mov     [rsp+.name_len], rax
+
+    add     rax, [rsp+.prefix_len]
+    cmp     rax, PATH_MAX
+    jae     .error_long
+
+    ;--------------------
+    ; Set up the entry.
+
+    mov     rdi, [rbx+WalkWorker.path]
+    add     rdi, [rsp+.prefix_len]
+    mov     [rbx+WalkWorker.entry+WalkEntry.name], rdi
+
+    mov     rsi, [rsp+.name]
+    mov     rdx, [rsp+.name_len]
+    inc     rdx ; Include the terminator.
+    dcall   memcpy
+
+    mov     rax, [rbx+WalkWorker.path]
+    mov     [rbx+WalkWorker.entry+WalkEntry.path], rax
+
+    mov     rax, [rsp+.fd]
+    mov     [rbx+WalkWorker.entry+WalkEntry.dirfd], rax
+
+    mov     rax, [rsp+.item]
+    mov     rax, [rax+WalkItem.depth]
+    inc     rax
+    mov     [rbx+WalkWorker.entry+WalkEntry.depth], rax
+
+    cmp     qword [rbx+WalkWorker.entry+WalkEntry.type], DT_UNKNOWN
+    jne     .visit
+
+    ; The file system does not provide the type, so ask for it (and
+    ; leave it unknown if that fails).
+    lea     rdi, [rbx+WalkWorker.entry]
+    mov     rsi, STATX_TYPE
+    dcall   walk_statx
+
+.visit:
+    lea     rdi, [rbx+WalkWorker.entry]
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     rsi, [rax+Walk.data]
+    mov     rax, [rax+Walk.visit]
+    dcall   rax
+    cmp     rax, WALK_CONTINUE
+    jne     .next_entry
+
+    cmp     qword [rbx+WalkWorker.entry+WalkEntry.type], DT_DIR
+    jne     .next_entry
+
+    mov     rdi, rbx
+    dcall   walk_queue_entry
+    cmp     rax, 0
+    je      .next_entry
+
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     qword [rax+Walk.error], 1
+    jmp     .next_entry
+
+.error_getdents:
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     rdx, [rax+Walk.cmd]
+    mov     rcx, [rsp+.item]
+    lea     rcx, [rcx+WalkItem.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     qword [rax+Walk.error], 1
+
+.close:
+    mov     rdi, [rsp+.fd]
+    dcall   close
+
+.out:
+    epilogue_with_vars 8
+    ret
+
+.error_read:
+    mov     rbx, [rsp+.worker]
+    mov     rdi, STDERR_FD
+    mov     rsi, .read_fmt
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     rdx, [rax+Walk.cmd]
+    mov     rcx, [rsp+.item]
+    lea     rcx, [rcx+WalkItem.path]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     qword [rax+Walk.error], 1
+    jmp     .out
+
+.error_long:
+    mov     rdi, STDERR_FD
+    mov     rsi, .long_fmt
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     rdx, [rax+Walk.cmd]
+    mov     rcx, [rsp+.item]
+    lea     rcx, [rcx+WalkItem.path]
+    mov     r8, [rsp+.name]
+    xor     rax, rax
+    dcall   dprintf
+
+    mov     rax, [rbx+WalkWorker.walk]
+    mov     qword [rax+Walk.error], 1
+    jmp     .next_entry
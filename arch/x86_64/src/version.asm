@@ -17,6 +17,8 @@ extern strcmp
 
 %include "header.inc"
 
+hot_text startup
+
 ;---------------------------------------------------------------------
 ; Description: Handle the version options.
 ;
@@ -38,10 +40,10 @@ extern strcmp
 ;---------------------------------------------------------------------
 
 handle_version:
-section .rodata
+hot_rodata
     .short_version_opt      equ '-v'
     .long_version_opt       db  "--version",0
-section .text
+hot_text startup
     prologue_with_vars 0
 
     ; Load the *value* of the argument.
@@ -83,9 +85,9 @@ section .text
 ;---------------------------------------------------------------------
 
 show_version:
-section .rodata
+cold_rodata
     .fmt               db  "%s version %s",10,0
-section .text
+cold_text
     prologue_with_vars 0
 
     mov     rdi, .fmt
@@ -0,0 +1,106 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "base64 encode" {
+	local cmd='base64'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$(printf "" | "$cmd_path")
+	[ -z "$actual" ]
+
+	actual=$(printf "f" | "$cmd_path")
+	[ "$actual" = "Zg==" ]
+
+	actual=$(printf "fo" | "$cmd_path")
+	[ "$actual" = "Zm8=" ]
+
+	actual=$(printf "foobar" | "$cmd_path")
+	[ "$actual" = "Zm9vYmFy" ]
+
+	# No trailing newline without wrapping.
+	actual=$(printf "foob" | "$cmd_path" -w 0 | od -An -c | tr -d ' \n')
+	[ "$actual" = "Zm9vYg==" ]
+}
+
+@test "base64 matches coreutils" {
+	local tmpdir=$(mktemp -d)
+	local cmd='base64'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local size
+	local wrap
+
+	# Sizes either side of the block size (and its multiples).
+	for size in 0 1 2 3 56 57 58 1000 58367 58368 58369 300001
+	do
+		head -c "$size" /dev/urandom > "$tmpdir/data"
+
+		for wrap in 0 1 3 4 5 76 77 100
+		do
+			"$cmd_path" -w "$wrap" < "$tmpdir/data" > "$tmpdir/actual"
+			base64 -w "$wrap" < "$tmpdir/data" > "$tmpdir/expected"
+			cmp "$tmpdir/actual" "$tmpdir/expected"
+
+			"$cmd_path" -d < "$tmpdir/expected" > "$tmpdir/decoded"
+			cmp "$tmpdir/decoded" "$tmpdir/data"
+		done
+
+		# Default wrap, and a file argument.
+		"$cmd_path" "$tmpdir/data" > "$tmpdir/actual"
+		base64 "$tmpdir/data" > "$tmpdir/expected"
+		cmp "$tmpdir/actual" "$tmpdir/expected"
+	done
+
+	# Data arriving in pieces.
+	(printf "ab"; sleep 0.1; printf "cd") | "$cmd_path" > "$tmpdir/actual"
+	[ "$(cat "$tmpdir/actual")" = "YWJjZA==" ]
+
+	(printf "Zm9v"; sleep 0.1; printf "YmFy\nZm"; sleep 0.1; printf "9v\n") |\
+		"$cmd_path" -d > "$tmpdir/actual"
+	[ "$(cat "$tmpdir/actual")" = "foobarfoo" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "base64 invalid input" {
+	local cmd='base64'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# The data before the invalid input is still written.
+	run bash -c "printf 'Zm9v*mFy' | '$cmd_path' -d"
+	[ "$status" -eq 1 ]
+	[ "$output" = "foobase64: invalid input" ]
+
+	# Missing padding.
+	run bash -c "printf 'Zm9vYg' | '$cmd_path' -d 2>/dev/null"
+	[ "$status" -eq 1 ]
+	[ "$output" = "foob" ]
+}
+
+@test "base64 errors" {
+	local cmd='base64'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" -x
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -w foo
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -w -1
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" /does/not/exist
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" a b
+	[ "$status" -eq 1 ]
+}
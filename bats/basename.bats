@@ -122,3 +122,84 @@ load 'test-common.bats'
 		i=$((i+1))
 	done
 }
+
+@test "basename with suffix argument" {
+	local cmd='basename'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" /foo/bar.c .c
+	[ "$status" -eq 0 ]
+	[ "$output" = 'bar' ]
+
+	# The suffix is not removed if it is the entire name.
+	run "$cmd_path" /foo/.c .c
+	[ "$status" -eq 0 ]
+	[ "$output" = '.c' ]
+
+	run "$cmd_path" /foo/bar.c .h
+	[ "$status" -eq 0 ]
+	[ "$output" = 'bar.c' ]
+
+	# Only a name and a suffix are allowed without '-a'.
+	run "$cmd_path" a b c
+	[ "$status" -eq 1 ]
+}
+
+@test "basename with multiple names" {
+	local cmd='basename'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local expected=$(printf '%s\n' foo bar.c '' / baz)
+
+	run "$cmd_path" -a /a/foo bar.c '' /// ///baz//
+	[ "$status" -eq 0 ]
+	[ "$output" = "$expected" ]
+
+	run "$cmd_path" -s .c /a/foo.c bar.c .c
+	[ "$status" -eq 0 ]
+	[ "$output" = "$(printf '%s\n' foo bar .c)" ]
+
+	run "$cmd_path" -a
+	[ "$status" -eq 1 ]
+
+	local actual=$("$cmd_path" -a -z /a/foo /b/bar | od -c)
+	[ "$actual" = "$(printf 'foo\0bar\0' | od -c)" ]
+
+	# Compare with the system version for a large number of names.
+	local -a names=($(seq -f '/some/dir/%g.txt' 1 5000))
+
+	expected=$(printf '%s\n' "${names[@]}" | sed 's!.*/!!')
+	[ "$("$cmd_path" -a "${names[@]}")" = "$expected" ]
+}
+
+@test "basename with names from stdin" {
+	local cmd='basename'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$(printf '/a/foo\n\n/b/bar//\nbaz' | "$cmd_path" --stdin)
+	[ "$actual" = "$(printf '%s\n' foo '' bar baz)" ]
+
+	actual=$(printf '/a/foo.c\n/b/bar.c\n' | "$cmd_path" --stdin -s .c)
+	[ "$actual" = "$(printf '%s\n' foo bar)" ]
+
+	actual=$(printf '/a/new\nline\0/b/bar\0' | "$cmd_path" --stdin -z | od -c)
+	[ "$actual" = "$(printf 'new\nline\0bar\0' | od -c)" ]
+
+	# No input, no output.
+	actual=$("$cmd_path" --stdin < /dev/null)
+	[ -z "$actual" ]
+
+	# Enough names for several reads and writes.
+	local tmpfile=$(mktemp)
+
+	seq -f '/some/dir/%g.txt' 1 200000 > "$tmpfile"
+
+	actual=$("$cmd_path" --stdin < "$tmpfile" | sha256sum)
+	[ "$actual" = "$(sed 's!.*/!!' "$tmpfile" | sha256sum)" ]
+
+	rm -f "$tmpfile"
+
+	# Names cannot be specified too.
+	run "$cmd_path" --stdin foo < /dev/null
+	[ "$status" -eq 1 ]
+}
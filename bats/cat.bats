@@ -72,3 +72,125 @@ load 'test-common.bats'
 	grep -q "$line_1" <<< "${lines[0]}"
 	grep -q "$line_2" <<< "${lines[1]}"
 }
+
+@test "cat multiple files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cat'
+
+	local file_1="$tmpdir/file-1"
+	local file_2="$tmpdir/file-2"
+	local file_3="$tmpdir/file-3"
+
+	seq 3 > "$file_1"
+	: > "$file_2"
+	seq 100 103 > "$file_3"
+
+	test_cmd_unquoted_args "$cmd" "$file_1" "$file_2" "$file_3"
+	[ "$status" -eq 0 ]
+
+	[ -z "${lines[-1]}" ] && unset 'lines[-1]'
+	[ "${#lines[@]}" -eq 7 ]
+
+	[ "${lines[0]}" = 1 ]
+	[ "${lines[2]}" = 3 ]
+	[ "${lines[3]}" = 100 ]
+	[ "${lines[6]}" = 103 ]
+
+	# A missing file in the middle is an error.
+	test_cmd_unquoted_args "$cmd" "$file_1" "$tmpdir/ENOENT" "$file_3"
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cat pipelined" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cat'
+
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local small_file="$tmpdir/small"
+	local big_file="$tmpdir/big"
+	local expected="$tmpdir/expected"
+	local actual="$tmpdir/actual"
+
+	echo 'hello, world' > "$small_file"
+
+	# Much bigger than the ring, so the reader has to wait for the
+	# writer.
+	seq 1000000 > "$big_file"
+
+	local arg
+
+	for arg in "$small_file" "$big_file"
+	do
+		"$cmd_path" -p "$arg" > "$actual"
+		cmp "$arg" "$actual"
+
+		"$cmd_path" -p < "$arg" > "$actual"
+		cmp "$arg" "$actual"
+	done
+
+	"$cmd_path" -p "$small_file" "$big_file" "$small_file" > "$actual"
+	cat "$small_file" "$big_file" "$small_file" > "$expected"
+	cmp "$expected" "$actual"
+
+	# Slow consumer.
+	"$cmd_path" -p "$big_file" | (sleep 1; cat) > "$actual"
+	cmp "$big_file" "$actual"
+
+	rm -rf "$tmpdir"
+}
+
+@test "cat parallel" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cat'
+
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local small_file="$tmpdir/small"
+	local empty_file="$tmpdir/empty"
+	local big_file="$tmpdir/big"
+	local expected="$tmpdir/expected"
+	local actual="$tmpdir/actual"
+
+	echo 'hello, world' > "$small_file"
+	: > "$empty_file"
+
+	# Many blocks, so the readers have to wait for the writer.
+	seq 3000000 > "$big_file"
+
+	local files=("$big_file" "$small_file" "$empty_file" "$big_file" "$small_file")
+
+	cat "${files[@]}" > "$expected"
+
+	local threads
+
+	for threads in 0 1 2 3 16
+	do
+		"$cmd_path" -P "$threads" "${files[@]}" > "$actual"
+		cmp "$expected" "$actual"
+	done
+
+	"$cmd_path" -P4 "${files[@]}" > "$actual"
+	cmp "$expected" "$actual"
+
+	# Slow consumer.
+	"$cmd_path" -P 4 "${files[@]}" | (sleep 1; cat) > "$actual"
+	cmp "$expected" "$actual"
+
+	# Stdin is read in order (once).
+	"$cmd_path" -P 4 "$small_file" - "$small_file" - < "$big_file" > "$actual"
+	cat "$small_file" "$big_file" "$small_file" > "$expected"
+	cmp "$expected" "$actual"
+
+	# The files before a missing file are still displayed.
+	run "$cmd_path" -P 4 "$small_file" "$tmpdir/ENOENT" "$big_file"
+	[ "$status" -eq 1 ]
+	[ "$output" = 'hello, world' ]
+
+	run "$cmd_path" -P foo "$small_file"
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
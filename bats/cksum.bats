@@ -0,0 +1,75 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "cksum stdin" {
+	local cmd='cksum'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input
+
+	for input in '' 'a' 'hello' "$(seq 100000)"
+	do
+		local expected=$(echo -n "$input" | cksum)
+		local actual=$(echo -n "$input" | "$cmd_path")
+
+		[ "$expected" = "$actual" ]
+	done
+}
+
+@test "cksum files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cksum'
+
+	local files=()
+	local size
+
+	# Sizes chosen to exercise all the code paths.
+	for size in 0 1 15 16 63 64 65 1000 3072 65536 100000 1048579
+	do
+		local file="$tmpdir/file-$size"
+		head -c "$size" /dev/urandom > "$file"
+		files+=("$file")
+	done
+
+	local expected=$(cksum "${files[@]}")
+
+	test_cmd_unquoted_args "$cmd" "${files[@]}"
+	[ "$status" -eq 0 ]
+	[ "$output" = "$expected" ]
+
+	# A missing file is reported, but the other files are still handled.
+	test_cmd_unquoted_args "$cmd" "$tmpdir/ENOENT" "${files[1]}"
+	[ "$status" -eq 1 ]
+	[ "${lines[-1]}" = "$(cksum "${files[1]}")" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cksum -a crc32c" {
+	local cmd='cksum'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# Standard CRC-32C check value.
+	local actual=$(echo -n '123456789' | "$cmd_path" -a crc32c)
+	[ "$actual" = '3808858755 9' ]
+
+	actual=$(echo -n '' | "$cmd_path" -a crc32c)
+	[ "$actual" = '0 0' ]
+
+	# The default algorithm can also be selected explicitly.
+	actual=$(echo -n 'hello' | "$cmd_path" -a crc)
+	[ "$actual" = "$(echo -n 'hello' | cksum)" ]
+}
+
+@test "cksum invalid algorithm" {
+	test_cmd_unquoted_args 'cksum' -a 'md5'
+	[ "$status" -eq 1 ]
+}
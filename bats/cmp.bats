@@ -0,0 +1,181 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "cmp identical files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cmp'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" a copy empty
+
+	local opts
+
+	for opts in '' '-s' '-l' '-n 3'
+	do
+		run "$cmd_path" $opts "$tmpdir/a" "$tmpdir/copy"
+		[ "$status" -eq 0 ]
+		[ -z "$output" ]
+
+		run "$cmd_path" $opts "$tmpdir/a" "$tmpdir/a"
+		[ "$status" -eq 0 ]
+		[ -z "$output" ]
+	done
+
+	run "$cmd_path" "$tmpdir/empty" "$tmpdir/empty"
+	[ "$status" -eq 0 ]
+
+	# Stdin.
+	run "$cmd_path" "$tmpdir/a" < "$tmpdir/copy"
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" - "$tmpdir/a" < "$tmpdir/copy"
+	[ "$status" -eq 0 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cmp different files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cmp'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" a b
+
+	cd "$tmpdir"
+
+	run "$cmd_path" a b
+	[ "$status" -eq 1 ]
+	[ "$output" = 'a b differ: char 6, line 2' ]
+
+	run "$cmd_path" -s a b
+	[ "$status" -eq 1 ]
+	[ -z "$output" ]
+
+	run "$cmd_path" -l a b
+	[ "$status" -eq 1 ]
+	[ "${lines[0]}" = ' 6 145 130' ]
+	[ "${lines[1]}" = '11 151 131' ]
+	[ "${#lines[@]}" -eq 2 ]
+
+	# Limits.
+	run "$cmd_path" -n 5 a b
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" -n 6 a b
+	[ "$status" -eq 1 ]
+
+	# Skips.
+	run "$cmd_path" a b 2 2
+	[ "$status" -eq 1 ]
+	[ "$output" = 'a b differ: char 4, line 2' ]
+
+	run "$cmd_path" a b 100 100
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" b - < a
+	[ "$status" -eq 1 ]
+	[ "$output" = 'b - differ: char 6, line 2' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cmp files of different sizes" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cmp'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" a short line empty
+
+	cd "$tmpdir"
+
+	run "$cmd_path" a short
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cmp: EOF on short after byte 5, in line 2' ]
+
+	run "$cmd_path" line a
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cmp: EOF on line after byte 4, line 1' ]
+
+	run "$cmd_path" -l short a
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cmp: EOF on short after byte 5' ]
+
+	run "$cmd_path" a empty
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cmp: EOF on empty which is empty' ]
+
+	run "$cmd_path" -s a short
+	[ "$status" -eq 1 ]
+	[ -z "$output" ]
+
+	# Only the compared bytes matter.
+	run "$cmd_path" -n 5 a short
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" -s -n 5 a short
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" a short - < short
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cmp large files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cmp'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	seq 1 200000 > "$tmpdir/a"
+	sed 's/^150000$/150OOO/' "$tmpdir/a" > "$tmpdir/b"
+
+	run "$cmd_path" "$tmpdir/a" "$tmpdir/b"
+	[ "$status" -eq 1 ]
+	[ "$output" = "$tmpdir/a $tmpdir/b differ: char 938892, line 150000" ]
+
+	# The same result when reading a pipe.
+	run bash -c "cat '$tmpdir/a' | '$cmd_path' - '$tmpdir/b'"
+	[ "$status" -eq 1 ]
+	[ "$output" = "- $tmpdir/b differ: char 938892, line 150000" ]
+
+	run "$cmd_path" -l "$tmpdir/a" "$tmpdir/b"
+	[ "$status" -eq 1 ]
+	[ "${lines[0]}" = ' 938892  60 117' ]
+	[ "${#lines[@]}" -eq 3 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cmp invalid arguments" {
+	local cmd='cmp'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path"
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" a b 1 2 3
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -l -s a b
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -n -1 a b
+	[ "$status" -eq 1 ]
+	[ "$output" = "cmp: invalid limit: '-1'" ]
+
+	run "$cmd_path" a b foo
+	[ "$status" -eq 1 ]
+	[ "$output" = "cmp: invalid skip: 'foo'" ]
+
+	run "$cmd_path" /does/not/exist /dev/null
+	[ "$status" -eq 1 ]
+	[ "$output" = "cmp: /does/not/exist: cannot open file" ]
+}
@@ -0,0 +1,215 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "cp with no args" {
+	test_cmd 'cp'
+	[ "$status" -eq 1 ]
+}
+
+@test "cp with one arg" {
+	test_cmd 'cp' 'foo'
+	[ "$status" -eq 1 ]
+}
+
+@test "cp with missing source file" {
+	local tmpdir=$(mktemp -d)
+
+	test_cmd_unquoted_args 'cp' "$tmpdir/ENOENT" "$tmpdir/copy"
+	[ "$status" -eq 1 ]
+	[ ! -e "$tmpdir/copy" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp regular files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local empty="$tmpdir/empty"
+	local small="$tmpdir/small"
+	local big="$tmpdir/big"
+
+	touch "$empty"
+	echo 'hello, world' > "$small"
+	seq 1000000 > "$big"
+
+	local file
+
+	for file in "$empty" "$small" "$big"
+	do
+		test_cmd_unquoted_args "$cmd" "$file" "$file.copy"
+		[ "$status" -eq 0 ]
+		[ ${#lines[@]} = 0 ]
+
+		cmp "$file" "$file.copy"
+
+		# Overwrite an existing (bigger) file.
+		seq 2000000 > "$file.copy"
+		test_cmd_unquoted_args "$cmd" "$file" "$file.copy"
+		[ "$status" -eq 0 ]
+
+		cmp "$file" "$file.copy"
+	done
+
+	# Copying a file onto itself must not destroy it.
+	test_cmd_unquoted_args "$cmd" "$small" "$small"
+	[ "$status" -eq 1 ]
+	[ "$(cat "$small")" = 'hello, world' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp large file" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local file="$tmpdir/file"
+
+	# Big enough to be copied by multiple threads, with a size that
+	# isn't a multiple of the chunk size.
+	head -c $(( (100 * 1024 * 1024) + 12345 )) /dev/urandom > "$file"
+
+	test_cmd_unquoted_args "$cmd" "$file" "$file.copy"
+	[ "$status" -eq 0 ]
+
+	cmp "$file" "$file.copy"
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp sparse file" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local file="$tmpdir/file"
+
+	# Data, followed by a large hole, followed by more data.
+	echo 'start' > "$file"
+	truncate -s 1G "$file"
+	echo 'end' >> "$file"
+
+	test_cmd_unquoted_args "$cmd" "$file" "$file.copy"
+	[ "$status" -eq 0 ]
+
+	cmp "$file" "$file.copy"
+
+	local src_blocks=$(stat -c '%b' "$file")
+	local dst_blocks=$(stat -c '%b' "$file.copy")
+
+	# The hole must not have been filled in.
+	[ "$dst_blocks" -le $(( src_blocks * 2 )) ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp into directory" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local dir="$tmpdir/dir"
+	mkdir "$dir"
+
+	echo one > "$tmpdir/one"
+	echo two > "$tmpdir/two"
+
+	test_cmd_unquoted_args "$cmd" "$tmpdir/one" "$tmpdir/two" "$dir"
+	[ "$status" -eq 0 ]
+
+	cmp "$tmpdir/one" "$dir/one"
+	cmp "$tmpdir/two" "$dir/two"
+
+	# Multiple sources require a directory.
+	test_cmd_unquoted_args "$cmd" "$tmpdir/one" "$tmpdir/two" "$tmpdir/three"
+	[ "$status" -eq 1 ]
+	[ ! -e "$tmpdir/three" ]
+
+	# Directories require -r.
+	test_cmd_unquoted_args "$cmd" "$dir" "$tmpdir/dir2"
+	[ "$status" -eq 1 ]
+	[ ! -e "$tmpdir/dir2" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp -r" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local src="$tmpdir/src"
+	local dst="$tmpdir/dst"
+
+	mkdir -p "$src/a/b/c" "$src/empty"
+	echo one > "$src/one"
+	echo two > "$src/a/two"
+	seq 100000 > "$src/a/b/c/three"
+	ln -s 'one' "$src/link"
+
+	test_cmd_unquoted_args "$cmd" -r "$src" "$dst"
+	[ "$status" -eq 0 ]
+
+	diff -r --no-dereference "$src" "$dst"
+
+	[ -d "$dst/empty" ]
+	[ -L "$dst/link" ]
+	[ "$(readlink "$dst/link")" = 'one' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp -p" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local file="$tmpdir/file"
+
+	echo hello > "$file"
+	chmod 0640 "$file"
+	touch -d '2001-02-03 04:05:06.123456789' "$file"
+
+	test_cmd_unquoted_args "$cmd" -p "$file" "$file.copy"
+	[ "$status" -eq 0 ]
+
+	cmp "$file" "$file.copy"
+
+	[ "$(stat -c '%a' "$file.copy")" = '640' ]
+	[ "$(stat -c '%y' "$file")" = "$(stat -c '%y' "$file.copy")" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "cp -f" {
+	local tmpdir=$(mktemp -d)
+	local cmd='cp'
+
+	local file="$tmpdir/file"
+	local dest="$tmpdir/dest"
+
+	echo hello > "$file"
+	echo goodbye > "$dest"
+
+	# Replace a file that cannot be opened for writing.
+	chmod 0444 "$dest"
+
+	# (root can write to a read-only file).
+	if [ "$(id -u)" -ne 0 ]
+	then
+		test_cmd_unquoted_args "$cmd" "$file" "$dest"
+		[ "$status" -eq 1 ]
+		[ "$(cat "$dest")" = 'goodbye' ]
+	fi
+
+	test_cmd_unquoted_args "$cmd" -f "$file" "$dest"
+	[ "$status" -eq 0 ]
+
+	cmp "$file" "$dest"
+
+	rm -rf "$tmpdir"
+}
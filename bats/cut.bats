@@ -0,0 +1,143 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "cut fields" {
+	local cmd='cut'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" -f 2 < <(printf 'a\tb\tc\nd\te\tf\n')
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = 'b' ]
+	[ "${lines[1]}" = 'e' ]
+
+	run "$cmd_path" -f 3,1 < <(printf 'a\tb\tc\n')
+	[ "$status" -eq 0 ]
+	[ "$output" = "$(printf 'a\tc')" ]
+
+	run "$cmd_path" -d : -f 2- < <(printf 'a:b:c\n1:2\n')
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = 'b:c' ]
+	[ "${lines[1]}" = '2' ]
+
+	run "$cmd_path" -d , -f -2,4 < <(printf 'a,b,c,d,e\n')
+	[ "$status" -eq 0 ]
+	[ "$output" = 'a,b,d' ]
+
+	# Lines without delimiters are shown whole (unless '-s').
+	run "$cmd_path" -d , -f 2 < <(printf 'a,b\nno delimiter\n')
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = 'b' ]
+	[ "${lines[1]}" = 'no delimiter' ]
+
+	run "$cmd_path" -s -d , -f 2 < <(printf 'a,b\nno delimiter\n')
+	[ "$status" -eq 0 ]
+	[ "$output" = 'b' ]
+
+	# Missing fields give empty lines.
+	run "$cmd_path" -d , -f 5 < <(printf 'a,b\n')
+	[ "$status" -eq 0 ]
+	[ "$output" = '' ]
+
+	# A final unterminated line.
+	run "$cmd_path" -d , -f 1 < <(printf 'a,b\nc,d')
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = 'a' ]
+	[ "${lines[1]}" = 'c' ]
+}
+
+@test "cut bytes" {
+	local cmd='cut'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" -b 2-4 < <(printf 'abcdef\nxy\n\n')
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = 'bcd' ]
+	[ "${lines[1]}" = 'y' ]
+	[ "${lines[2]}" = '' ]
+
+	run "$cmd_path" -c 5-,1,2 < <(printf 'abcdefgh\n')
+	[ "$status" -eq 0 ]
+	[ "$output" = 'abefgh' ]
+}
+
+@test "cut compare with system version" {
+	command -v cut &>/dev/null || skip "need system cut"
+
+	local tmpdir=$(mktemp -d)
+	local cmd='cut'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local file="$tmpdir/data"
+
+	# Lines with varying numbers of fields, including some longer than
+	# the read buffer.
+	local i
+
+	for i in $(seq 1 20000)
+	do
+		printf '%d\t%d\t\t%s\t%d\n' "$i" $((i * 7)) "$(printf '%*s' $((i % 97)) '')" $((i % 3))
+		(( i % 5000 )) || printf 'no delimiter %d\n' "$i"
+	done > "$file"
+
+	head -c 1000000 /dev/zero | tr '\0' 'x' >> "$file"
+	printf '\tend\n' >> "$file"
+
+	local list
+
+	for list in 1 2 3 4 5 6 1,3 2-4 3- -2 1,2,4-
+	do
+		cmp <("$cmd_path" -f "$list" "$file") <(cut -f "$list" "$file")
+		cmp <("$cmd_path" -s -f "$list" "$file") <(cut -s -f "$list" "$file")
+		cmp <("$cmd_path" -b "$list" "$file") <(cut -b "$list" "$file")
+	done
+
+	# Stdin and multiple files.
+	cmp <("$cmd_path" -f 2 "$file" - < "$file") <(cut -f 2 "$file" "$file")
+
+	rm -rf "$tmpdir"
+}
+
+@test "cut errors" {
+	local cmd='cut'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path"
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: you must specify a list of bytes, characters, or fields' ]
+
+	run "$cmd_path" -f 1 -b 1
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: only one type of list may be specified' ]
+
+	run "$cmd_path" -f 0
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: fields and positions are numbered from 1' ]
+
+	run "$cmd_path" -f 3-2
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: invalid decreasing range' ]
+
+	run "$cmd_path" -f x
+	[ "$status" -eq 1 ]
+	[ "$output" = "cut: invalid list: 'x'" ]
+
+	run "$cmd_path" -d ab -f 1
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: the delimiter must be a single character' ]
+
+	run "$cmd_path" -b 1 -s
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: suppressing non-delimited lines makes sense only when operating on fields' ]
+
+	run "$cmd_path" -f 1 /does-not-exist
+	[ "$status" -eq 1 ]
+	[ "$output" = 'cut: /does-not-exist: cannot open file' ]
+}
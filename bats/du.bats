@@ -0,0 +1,90 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "du summary" {
+	local tmpdir=$(mktemp -d)
+	local cmd='du'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local i
+	for i in $(seq 1 20)
+	do
+		mkdir -p "$tmpdir/tree/dir$i/sub/sub"
+		head -c $((i * 1000)) /dev/zero > "$tmpdir/tree/dir$i/file"
+		head -c 5000 /dev/zero > "$tmpdir/tree/dir$i/sub/sub/file"
+	done
+
+	# Hard links are only counted once.
+	head -c 100000 /dev/zero > "$tmpdir/tree/big"
+	ln "$tmpdir/tree/big" "$tmpdir/tree/dir1/big"
+	ln "$tmpdir/tree/big" "$tmpdir/tree/dir2/sub/big"
+
+	local actual=$("$cmd_path" -s "$tmpdir/tree")
+	[ "$actual" = "$(du -s "$tmpdir/tree")" ]
+
+	# A file.
+	actual=$("$cmd_path" -s "$tmpdir/tree/dir3/file")
+	[ "$actual" = "$(du -s "$tmpdir/tree/dir3/file")" ]
+
+	# Multiple paths share the hard link set.
+	actual=$("$cmd_path" -s "$tmpdir/tree/dir1" "$tmpdir/tree/dir2")
+	[ "$actual" = "$(du -s "$tmpdir/tree/dir1" "$tmpdir/tree/dir2")" ]
+
+	# Current directory.
+	actual=$(cd "$tmpdir/tree" && "$cmd_path" -s)
+	[ "$actual" = "$(cd "$tmpdir/tree" && du -s)" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "du human readable" {
+	local tmpdir=$(mktemp -d)
+	local cmd='du'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local size
+	for size in 0 1 5000 20000 3000000
+	do
+		head -c "$size" /dev/urandom > "$tmpdir/file$size"
+
+		local actual=$("$cmd_path" -sh "$tmpdir/file$size")
+		local expected=$(du -sh "$tmpdir/file$size")
+		[ "$actual" = "$expected" ]
+	done
+
+	rm -rf "$tmpdir"
+}
+
+@test "du errors" {
+	local tmpdir=$(mktemp -d)
+	local cmd='du'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" -s "$tmpdir/does-not-exist"
+	[ "$status" -eq 1 ]
+	[ -z "$(echo "$output" | grep -v "cannot access")" ]
+
+	# The total of valid paths is still displayed.
+	mkdir "$tmpdir/dir"
+	run "$cmd_path" -s "$tmpdir/does-not-exist" "$tmpdir/dir"
+	[ "$status" -eq 1 ]
+	echo "$output" | grep -q "	$tmpdir/dir\$"
+
+	run "$cmd_path" -x
+	[ "$status" -eq 1 ]
+
+	# Only summaries are supported.
+	run "$cmd_path" "$tmpdir/dir"
+	[ "$status" -eq 1 ]
+	[ "$output" = 'du: only summaries are supported (specify -s)' ]
+
+	rm -rf "$tmpdir"
+}
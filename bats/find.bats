@@ -0,0 +1,122 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+# Create a test tree below the specified directory.
+create_tree()
+{
+	local dir="$1"
+	local i
+
+	for i in $(seq 1 20)
+	do
+		mkdir -p "$dir/dir$i/sub/sub"
+		head -c $((i * 100)) /dev/zero > "$dir/dir$i/file$i.txt"
+		head -c 2000 /dev/zero > "$dir/dir$i/sub/data.bin"
+		touch "$dir/dir$i/sub/sub/empty.txt"
+		ln -s "file$i.txt" "$dir/dir$i/link"
+	done
+
+	mkfifo "$dir/fifo"
+}
+
+@test "find all" {
+	local tmpdir=$(mktemp -d)
+	local cmd='find'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+
+	# Output order is not defined.
+	local actual=$("$cmd_path" "$tmpdir" | LC_ALL=C sort)
+	[ "$actual" = "$(find "$tmpdir" | LC_ALL=C sort)" ]
+
+	actual=$("$cmd_path" "$tmpdir" -print | LC_ALL=C sort)
+	[ "$actual" = "$(find "$tmpdir" | LC_ALL=C sort)" ]
+
+	actual=$(cd "$tmpdir" && "$cmd_path" | LC_ALL=C sort)
+	[ "$actual" = "$(cd "$tmpdir" && find | LC_ALL=C sort)" ]
+
+	# Multiple paths.
+	actual=$("$cmd_path" "$tmpdir/dir1" "$tmpdir/dir2" | LC_ALL=C sort)
+	[ "$actual" = "$(find "$tmpdir/dir1" "$tmpdir/dir2" | LC_ALL=C sort)" ]
+
+	# A file.
+	actual=$("$cmd_path" "$tmpdir/dir1/file1.txt")
+	[ "$actual" = "$tmpdir/dir1/file1.txt" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "find tests" {
+	local tmpdir=$(mktemp -d)
+	local cmd='find'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+
+	local expr
+	for expr in \
+		'-name *.txt' \
+		'-name file?.txt' \
+		'-name [ds]*' \
+		'-type f' \
+		'-type d' \
+		'-type l' \
+		'-type p' \
+		'-type f -name *.bin' \
+		'-size 0' \
+		'-size +1k' \
+		'-size -2' \
+		'-size 2000c' \
+		'-type f -size +1000c -print'
+	do
+		local actual=$(set -f; "$cmd_path" "$tmpdir" $expr | LC_ALL=C sort)
+		local expected=$(set -f; find "$tmpdir" $expr | LC_ALL=C sort)
+		[ "$actual" = "$expected" ]
+	done
+
+	rm -rf "$tmpdir"
+}
+
+@test "find print0" {
+	local tmpdir=$(mktemp -d)
+	local cmd='find'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+
+	local actual=$("$cmd_path" "$tmpdir" -name '*.txt' -print0 | tr '\0' '\n' | LC_ALL=C sort)
+	local expected=$(find "$tmpdir" -name '*.txt' -print0 | tr '\0' '\n' | LC_ALL=C sort)
+	[ "$actual" = "$expected" ]
+
+	local count=$("$cmd_path" "$tmpdir" -type f -print0 | tr -cd '\0' | wc -c)
+	[ "$count" -eq 60 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "find errors" {
+	local tmpdir=$(mktemp -d)
+	local cmd='find'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" "$tmpdir/does-not-exist"
+	[ "$status" -eq 1 ]
+
+	local args
+	for args in '-foo' '-name' '-type x' '-type' '-size' '-size 1x' '-size +' '-print foo'
+	do
+		run "$cmd_path" "$tmpdir" $args
+		[ "$status" -eq 1 ]
+	done
+
+	rm -rf "$tmpdir"
+}
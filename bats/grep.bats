@@ -0,0 +1,129 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "grep no args" {
+	test_cmd_unquoted_args 'grep'
+	[ "$status" -eq 1 ]
+}
+
+@test "grep stdin" {
+	local cmd='grep'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(printf 'foo\nbar\nfoobar\nbaz\n')
+
+	local actual=$(echo "$input" | "$cmd_path" foo)
+	[ "$actual" = "$(echo "$input" | grep -F foo)" ]
+
+	actual=$(echo "$input" | "$cmd_path" -F bar -)
+	[ "$actual" = "$(echo "$input" | grep -F bar)" ]
+
+	# No match.
+	run bash -c "echo '$input' | '$cmd_path' qux"
+	[ "$status" -eq 1 ]
+	[ -z "$output" ]
+}
+
+@test "grep options" {
+	local tmpdir=$(mktemp -d)
+	local cmd='grep'
+
+	local file="$tmpdir/file"
+	local pattern='1'
+
+	seq 100000 > "$file"
+
+	local opts
+	for opts in '' '-c' '-v' '-n' '-l' '-n -v' '-c -v'
+	do
+		local expected=$(grep -F $opts "$pattern" "$file")
+
+		test_cmd_unquoted_args "$cmd" $opts "$pattern" "$file"
+		[ "$status" -eq 0 ]
+		[ "$output" = "$expected" ]
+	done
+
+	rm -rf "$tmpdir"
+}
+
+@test "grep multiple files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='grep'
+
+	local file1="$tmpdir/file1"
+	local file2="$tmpdir/file2"
+
+	printf 'hello world\ngoodbye\n' > "$file1"
+	printf 'no match\nworld peace\n' > "$file2"
+
+	local opts
+	for opts in '' '-c' '-n' '-l' '-v'
+	do
+		local expected=$(grep -F $opts 'world' "$file1" "$file2")
+
+		test_cmd_unquoted_args "$cmd" $opts 'world' "$file1" "$file2"
+		[ "$status" -eq 0 ]
+		[ "$output" = "$expected" ]
+	done
+
+	# A missing file is reported, but the other files are still searched.
+	test_cmd_unquoted_args "$cmd" 'world' "$tmpdir/ENOENT" "$file1"
+	[ "$status" -eq 1 ]
+	[ "${lines[-1]}" = "$file1:hello world" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "grep unterminated line" {
+	local tmpdir=$(mktemp -d)
+	local cmd='grep'
+
+	local file="$tmpdir/file"
+
+	printf 'first\nlast' > "$file"
+
+	test_cmd_unquoted_args "$cmd" 'last' "$file"
+	[ "$status" -eq 0 ]
+	[ "$output" = 'last' ]
+
+	test_cmd_unquoted_args "$cmd" -v 'last' "$file"
+	[ "$status" -eq 0 ]
+	[ "$output" = 'first' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "grep long lines" {
+	local tmpdir=$(mktemp -d)
+	local cmd='grep'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local file="$tmpdir/file"
+
+	# Lines longer than the read buffer (when reading from a pipe).
+	{
+		head -c 1000000 /dev/zero | tr '\0' 'a'
+		echo 'needle'
+		head -c 1000000 /dev/zero | tr '\0' 'b'
+		echo
+		echo 'needle'
+	} > "$file"
+
+	local expected=$(grep -F -n 'needle' "$file" | cut -c1-20)
+
+	local actual=$("$cmd_path" -n 'needle' "$file" | cut -c1-20)
+	[ "$actual" = "$expected" ]
+
+	actual=$(cat "$file" | "$cmd_path" -n 'needle' | cut -c1-20)
+	[ "$actual" = "$expected" ]
+
+	rm -rf "$tmpdir"
+}
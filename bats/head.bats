@@ -160,3 +160,74 @@ load 'test-common.bats'
 
 	rm -f "$file"
 }
+
+@test "head multiple files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='head'
+
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local file_1="$tmpdir/file-1"
+	local file_2="$tmpdir/file-2"
+	local file_3="$tmpdir/file-3"
+
+	seq 13 > "$file_1"
+	: > "$file_2"
+	printf 'no newline' > "$file_3"
+
+	local expected=$(printf '%s\n' \
+		"==> $file_1 <==" 1 2 '' \
+		"==> $file_2 <==" '' \
+		"==> $file_3 <==" 'no newline')
+
+	local actual=$("$cmd_path" -n 2 "$file_1" "$file_2" "$file_3")
+	[ "$actual" = "$expected" ]
+
+	expected=$(printf '%s\n' "==> $file_1 <==" 1 '' '==> standard input <==' abc)
+	actual=$(echo abc | "$cmd_path" -n 1 "$file_1" -)
+	[ "$actual" = "$expected" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "head parallel" {
+	local tmpdir=$(mktemp -d)
+	local cmd='head'
+
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local small_file="$tmpdir/small"
+	local empty_file="$tmpdir/empty"
+	local big_file="$tmpdir/big"
+	local expected="$tmpdir/expected"
+	local actual="$tmpdir/actual"
+
+	printf '1\n2\n3' > "$small_file"
+	: > "$empty_file"
+	seq 3000000 > "$big_file"
+
+	local files=("$big_file" "$small_file" "$empty_file" "$big_file")
+
+	local opts
+	local threads
+
+	for opts in '-n 2' '-n 0' '-n 2000000' '-c 5' '-c 0' '-c 1000000'
+	do
+		"$cmd_path" $opts "${files[@]}" > "$expected"
+
+		for threads in 0 1 3
+		do
+			"$cmd_path" -P "$threads" $opts "${files[@]}" > "$actual"
+			cmp "$expected" "$actual"
+		done
+	done
+
+	"$cmd_path" "$small_file" - "$small_file" < "$big_file" > "$expected"
+	"$cmd_path" -P 2 "$small_file" - "$small_file" < "$big_file" > "$actual"
+	cmp "$expected" "$actual"
+
+	run "$cmd_path" -P 2 "$small_file" "$tmpdir/ENOENT" "$big_file"
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
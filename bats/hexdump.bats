@@ -0,0 +1,136 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "hexdump canonical" {
+	local tmpdir=$(mktemp -d)
+	local cmd='hexdump'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text binary empty
+
+	run "$cmd_path" -C "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 3 ]
+	[ "${lines[0]}" = '00000000  68 65 6c 6c 6f 20 77 6f  72 6c 64 2c 20 74 68 69  |hello world, thi|' ]
+	[ "${lines[1]}" = '00000010  73 20 69 73 20 61 20 74  65 73 74 21 0a           |s is a test!.|' ]
+	[ "${lines[2]}" = '0000001d' ]
+
+	# Only printable ASCII characters are shown.
+	run "$cmd_path" -C "$tmpdir/binary"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '00000000  00 1f 20 7e 7f 80 ff 41                           |.. ~...A|' ]
+	[ "${lines[1]}" = '00000008' ]
+
+	# Stdin.
+	run "$cmd_path" -C < "$tmpdir/binary"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '00000000  00 1f 20 7e 7f 80 ff 41                           |.. ~...A|' ]
+
+	run "$cmd_path" -C "$tmpdir/empty"
+	[ "$status" -eq 0 ]
+	[ -z "$output" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "hexdump repeated lines" {
+	local tmpdir=$(mktemp -d)
+	local cmd='hexdump'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" zeros
+
+	run "$cmd_path" -C "$tmpdir/zeros"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 4 ]
+	[ "${lines[0]}" = '00000000  00 00 00 00 00 00 00 00  00 00 00 00 00 00 00 00  |................|' ]
+	[ "${lines[1]}" = '*' ]
+	[ "${lines[2]}" = '00000020  00 00 00 00 00 00 00 00                           |........|' ]
+	[ "${lines[3]}" = '00000028' ]
+
+	run "$cmd_path" -C -v "$tmpdir/zeros"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 4 ]
+	[ "${lines[1]}" = '00000010  00 00 00 00 00 00 00 00  00 00 00 00 00 00 00 00  |................|' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "hexdump skip and length" {
+	local tmpdir=$(mktemp -d)
+	local cmd='hexdump'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text binary
+
+	run "$cmd_path" -C -s 6 -n 5 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '00000006  77 6f 72 6c 64                                    |world|' ]
+	[ "${lines[1]}" = '0000000b' ]
+
+	run "$cmd_path" -C -s 0x1c -n 0x3 "$tmpdir/text" "$tmpdir/binary"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '0000001c  0a 00 1f                                          |...|' ]
+	[ "${lines[1]}" = '0000001f' ]
+
+	run "$cmd_path" -C -s 3 -n 4 < "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '00000003  6c 6f 20 77                                       |lo w|' ]
+
+	# Skipping past the end shows the end offset.
+	run "$cmd_path" -C -s 100 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "$output" = '0000001d' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "hexdump large offsets" {
+	local tmpdir=$(mktemp -d)
+	local cmd='hexdump'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# A sparse file: the skipped data is never read.
+	truncate -s 5G "$tmpdir/sparse" || skip "cannot create sparse file"
+	printf 'abcdefghijklmnopqrstuvwxyz' >> "$tmpdir/sparse"
+
+	run "$cmd_path" -C -s 0x13ffffff0 "$tmpdir/sparse"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 4 ]
+	[ "${lines[0]}" = '13ffffff0  00 00 00 00 00 00 00 00  00 00 00 00 00 00 00 00  |................|' ]
+	[ "${lines[1]}" = '140000000  61 62 63 64 65 66 67 68  69 6a 6b 6c 6d 6e 6f 70  |abcdefghijklmnop|' ]
+	[ "${lines[2]}" = '140000010  71 72 73 74 75 76 77 78  79 7a                    |qrstuvwxyz|' ]
+	[ "${lines[3]}" = '14000001a' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "hexdump invalid options" {
+	local tmpdir=$(mktemp -d)
+	local cmd='hexdump'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text
+
+	run "$cmd_path" -n foo "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = "hexdump: invalid length: 'foo'" ]
+
+	run "$cmd_path" -s -1 "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = "hexdump: invalid offset: '-1'" ]
+
+	run "$cmd_path" -C "$tmpdir/does-not-exist"
+	[ "$status" -eq 1 ]
+	[ "$output" = "hexdump: $tmpdir/does-not-exist: cannot open file" ]
+
+	rm -rf "$tmpdir"
+}
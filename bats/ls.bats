@@ -0,0 +1,176 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+create_tree()
+{
+	local dir="$1"
+
+	mkdir -p "$dir/sub/deeper"
+
+	touch "$dir/a" "$dir/B" "$dir/.hidden" "$dir/sub/x"
+	touch "$dir/abcdefghij" "$dir/abcdefghia" "$dir/abcdefgh"
+	echo hello > "$dir/sub/deeper/file"
+	seq 1 1000 > "$dir/big"
+	ln -s a "$dir/link"
+
+	touch -d '2020-01-01 00:00:00' "$dir/abcdefgh"
+	touch -d '2021-01-01 00:00:00' "$dir/big"
+}
+
+@test "ls names" {
+	local tmpdir=$(mktemp -d)
+	local cmd='ls'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+
+	local expected=$(printf '%s\n' B a abcdefgh abcdefghia abcdefghij big link sub)
+	local actual=$("$cmd_path" "$tmpdir")
+	[ "$actual" = "$expected" ]
+
+	actual=$("$cmd_path" -1 "$tmpdir")
+	[ "$actual" = "$expected" ]
+
+	expected=$(printf '%s\n' . .. .hidden B a abcdefgh abcdefghia abcdefghij big link sub)
+	actual=$("$cmd_path" -a "$tmpdir")
+	[ "$actual" = "$expected" ]
+
+	# Default directory.
+	actual=$(cd "$tmpdir/sub" && "$cmd_path")
+	[ "$actual" = "$(printf '%s\n' deeper x)" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "ls sort order" {
+	local tmpdir=$(mktemp -d)
+	local cmd='ls'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+
+	# Largest first, then by name.
+	local actual=$("$cmd_path" -S "$tmpdir" | head -n 2)
+	[ "$actual" = "$(printf '%s\n' sub big)" ]
+
+	# Newest first, so the old files are last.
+	actual=$("$cmd_path" -t "$tmpdir" | tail -n 2)
+	[ "$actual" = "$(printf '%s\n' big abcdefgh)" ]
+
+	# Unsorted: the same names, in directory order.
+	actual=$("$cmd_path" -U "$tmpdir" | sort)
+	[ "$actual" = "$("$cmd_path" "$tmpdir" | sort)" ]
+
+	# The last sort option wins.
+	actual=$("$cmd_path" -U -S "$tmpdir")
+	[ "$actual" = "$("$cmd_path" -S "$tmpdir")" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "ls recursive" {
+	local tmpdir=$(mktemp -d)
+	local cmd='ls'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	mkdir -p "$tmpdir/d/sub/deeper"
+	touch "$tmpdir/d/a" "$tmpdir/d/sub/x" "$tmpdir/d/sub/deeper/y"
+
+	local expected=$(printf '%s\n' \
+		'd:' a sub '' \
+		'd/sub:' deeper x '' \
+		'd/sub/deeper:' y)
+
+	local actual=$(cd "$tmpdir" && "$cmd_path" -R d)
+	[ "$actual" = "$expected" ]
+
+	actual=$(cd "$tmpdir" && "$cmd_path" -R -U d | grep -c ':$')
+	[ "$actual" -eq 3 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "ls long format" {
+	local tmpdir=$(mktemp -d)
+	local cmd='ls'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+	chmod 4754 "$tmpdir/a"
+
+	run "$cmd_path" -l "$tmpdir"
+	[ "$status" -eq 0 ]
+
+	echo "${lines[0]}" | grep -Eq '^total [0-9]+$'
+	echo "$output" | grep -Eq '^-rwsr-xr-- +1 .* a$'
+	echo "$output" | grep -Eq '^-[rw-]{9} +1 .* 3893 Jan  1  2021 big$'
+	echo "$output" | grep -Eq '^l[rwx]{9} +1 .* link -> a$'
+	echo "$output" | grep -Eq '^d[rwx-]{9} +3 .* sub$'
+
+	# Compare with the system version if it is GNU ls.
+	if ls --version 2>/dev/null | grep -q GNU
+	then
+		local expected=$(LC_ALL=C ls -laR "$tmpdir")
+		local actual=$("$cmd_path" -laR "$tmpdir")
+		[ "$actual" = "$expected" ]
+
+		expected=$(LC_ALL=C ls -lt "$tmpdir")
+		actual=$("$cmd_path" -lt "$tmpdir")
+		[ "$actual" = "$expected" ]
+	fi
+
+	rm -rf "$tmpdir"
+}
+
+@test "ls files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='ls'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_tree "$tmpdir"
+
+	# Files first, then directories with headers.
+	local expected=$(printf '%s\n' "$tmpdir/a" "$tmpdir/big" '' "$tmpdir/sub:" deeper x)
+	local actual=$("$cmd_path" "$tmpdir/sub" "$tmpdir/big" "$tmpdir/a")
+	[ "$actual" = "$expected" ]
+
+	run "$cmd_path" "$tmpdir/a" "$tmpdir/does-not-exist"
+	[ "$status" -eq 1 ]
+	[ "${lines[0]}" = "ls: cannot access '$tmpdir/does-not-exist'" ]
+	[ "${lines[1]}" = "$tmpdir/a" ]
+
+	run "$cmd_path" -x
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "ls large directory" {
+	local tmpdir=$(mktemp -d)
+	local cmd='ls'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# Enough entries for several getdents64 calls and statx threads.
+	(cd "$tmpdir" && seq -f 'file%05g' 1 20000 | xargs touch)
+
+	local actual=$("$cmd_path" "$tmpdir" | wc -l)
+	[ "$actual" -eq 20000 ]
+
+	actual=$("$cmd_path" -U "$tmpdir" | wc -l)
+	[ "$actual" -eq 20000 ]
+
+	[ "$("$cmd_path" "$tmpdir")" = "$(seq -f 'file%05g' 1 20000)" ]
+
+	actual=$("$cmd_path" -l "$tmpdir" | wc -l)
+	[ "$actual" -eq 20001 ]
+
+	rm -rf "$tmpdir"
+}
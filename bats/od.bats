@@ -0,0 +1,193 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "od hex bytes" {
+	local tmpdir=$(mktemp -d)
+	local cmd='od'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text empty
+
+	local opts
+
+	for opts in '-An -tx1' '-An -t x1' '-An -txC' '-An'
+	do
+		run "$cmd_path" $opts "$tmpdir/text"
+		[ "$status" -eq 0 ]
+		[ "${#lines[@]}" -eq 2 ]
+		[ "${lines[0]}" = ' 68 65 6c 6c 6f 20 77 6f 72 6c 64 2c 20 74 68 69' ]
+		[ "${lines[1]}" = ' 73 20 69 73 20 61 20 74 65 73 74 21 0a' ]
+	done
+
+	# Stdin.
+	run "$cmd_path" -An -tx1 < "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 2 ]
+	[ "${lines[1]}" = ' 73 20 69 73 20 61 20 74 65 73 74 21 0a' ]
+
+	run "$cmd_path" -An -tx1 "$tmpdir/empty"
+	[ "$status" -eq 0 ]
+	[ -z "$output" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "od addresses" {
+	local tmpdir=$(mktemp -d)
+	local cmd='od'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text empty
+
+	run "$cmd_path" -tx1 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 3 ]
+	[ "${lines[0]}" = '0000000 68 65 6c 6c 6f 20 77 6f 72 6c 64 2c 20 74 68 69' ]
+	[ "${lines[1]}" = '0000020 73 20 69 73 20 61 20 74 65 73 74 21 0a' ]
+	[ "${lines[2]}" = '0000035' ]
+
+	run "$cmd_path" -Ax -tx1 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '000000 68 65 6c 6c 6f 20 77 6f 72 6c 64 2c 20 74 68 69' ]
+	[ "${lines[1]}" = '000010 73 20 69 73 20 61 20 74 65 73 74 21 0a' ]
+	[ "${lines[2]}" = '00001d' ]
+
+	run "$cmd_path" -Ad -tx1 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[1]}" = '0000016 73 20 69 73 20 61 20 74 65 73 74 21 0a' ]
+	[ "${lines[2]}" = '0000029' ]
+
+	run "$cmd_path" -tx1 "$tmpdir/empty"
+	[ "$status" -eq 0 ]
+	[ "$output" = '0000000' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "od repeated lines" {
+	local tmpdir=$(mktemp -d)
+	local cmd='od'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" zeros
+
+	run "$cmd_path" -tx1 "$tmpdir/zeros"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 4 ]
+	[ "${lines[0]}" = '0000000 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00' ]
+	[ "${lines[1]}" = '*' ]
+	[ "${lines[2]}" = '0000040 00 00 00 00 00 00 00 00' ]
+	[ "${lines[3]}" = '0000050' ]
+
+	run "$cmd_path" -v -An -tx1 "$tmpdir/zeros"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 3 ]
+	[ "${lines[1]}" = ' 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00' ]
+	[ "${lines[2]}" = ' 00 00 00 00 00 00 00 00' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "od skip and limit" {
+	local tmpdir=$(mktemp -d)
+	local cmd='od'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text zeros
+
+	run "$cmd_path" -j 6 -N 5 -tx1 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '0000006 77 6f 72 6c 64' ]
+	[ "${lines[1]}" = '0000013' ]
+
+	# Hex and octal values.
+	run "$cmd_path" -j 0x6 -N 05 -tx1 "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = '0000006 77 6f 72 6c 64' ]
+
+	# The files are a single stream.
+	run "$cmd_path" -j 0x1c -tx1 "$tmpdir/text" "$tmpdir/zeros"
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 4 ]
+	[ "${lines[0]}" = '0000034 0a 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00' ]
+	[ "${lines[1]}" = '0000054 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00' ]
+	[ "${lines[2]}" = '0000074 00 00 00 00 00 00 00 00 00' ]
+	[ "${lines[3]}" = '0000105' ]
+
+	run "$cmd_path" -An -j 29 -tx1 "$tmpdir/text" - < "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "${lines[0]}" = ' 68 65 6c 6c 6f 20 77 6f 72 6c 64 2c 20 74 68 69' ]
+
+	run "$cmd_path" -An -j 3 -N 4 -tx1 < "$tmpdir/text"
+	[ "$status" -eq 0 ]
+	[ "$output" = ' 6c 6f 20 77' ]
+
+	run "$cmd_path" -j 100 -tx1 "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = 'od: cannot skip past end of combined input' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "od compare" {
+	command -v od &>/dev/null || skip "need system od"
+
+	local tmpdir=$(mktemp -d)
+	local cmd='od'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	head -c 100000 /dev/urandom > "$tmpdir/random"
+	head -c 5000 /dev/zero >> "$tmpdir/random"
+	printf 'end' >> "$tmpdir/random"
+
+	local opts
+
+	for opts in '-An -tx1' '-tx1' '-Ax -tx1' '-v -Ad -tx1' '-j 999 -N 50000 -tx1'
+	do
+		"$cmd_path" $opts "$tmpdir/random" > "$tmpdir/out"
+		od $opts "$tmpdir/random" > "$tmpdir/expected"
+		cmp "$tmpdir/expected" "$tmpdir/out"
+	done
+
+	rm -rf "$tmpdir"
+}
+
+@test "od invalid options" {
+	local tmpdir=$(mktemp -d)
+	local cmd='od'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" text
+
+	run "$cmd_path" -t o2 "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = "od: unsupported type: 'o2'" ]
+
+	run "$cmd_path" -A q "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = "od: invalid output address radix 'q'; it must be one character from [doxn]" ]
+
+	run "$cmd_path" -j foo "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = "od: invalid -j argument 'foo'" ]
+
+	run "$cmd_path" -N -1 "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "$output" = "od: invalid -N argument '-1'" ]
+
+	# Later files are still shown.
+	run "$cmd_path" -An -tx1 "$tmpdir/does-not-exist" "$tmpdir/text"
+	[ "$status" -eq 1 ]
+	[ "${lines[0]}" = "od: $tmpdir/does-not-exist: cannot open file" ]
+	[ "${lines[1]}" = ' 68 65 6c 6c 6f 20 77 6f 72 6c 64 2c 20 74 68 69' ]
+
+	rm -rf "$tmpdir"
+}
@@ -103,6 +103,13 @@ load 'test-common.bats'
 	tests+=('3d:259200.000000000')
 	tests+=('0.01:0.010000000')
 	tests+=('0.057:0.057000000')
+	tests+=('0.0005:0.000500000')
+	tests+=('1.5m:90.000000000')
+	tests+=('0.123456789:0.123456789')
+
+	# Digits beyond nanosecond precision round up.
+	tests+=('0.0000000001:0.000000001')
+	tests+=('0.9999999999:1.000000000')
 
 	# Strictly, these values are a lie as the command will sleep
 	# "forever" (aka this value) repeatedly.
@@ -125,3 +132,66 @@ load 'test-common.bats'
 		grep -q "^${expected}$" <<< "${lines[0]}"
 	done
 }
+
+@test "sleep spin" {
+	local cmd='sleep'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+	[ -x "$cmd_path" ]
+
+	run "$cmd_path" -s 100 0.01
+	[ "$status" -eq 0 ]
+	[ -z "$output" ]
+
+	run "$cmd_path" -s 0 0
+	[ "$status" -eq 0 ]
+
+	# Spin for longer than the sleep.
+	run "$cmd_path" -s 1000 0.0001
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" -n -s 100 1.5
+	[ "$status" -eq 0 ]
+	[ "$output" = '1.500000000' ]
+
+	local arg
+
+	for arg in '' -1 foo 1000001
+	do
+		run "$cmd_path" -s "$arg" 1
+		[ "$status" -eq 1 ]
+		[ "$output" = "sleep: invalid spin time: '${arg}'" ]
+	done
+}
+
+@test "sleep benchmark" {
+	local cmd='sleep'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+	[ -x "$cmd_path" ]
+
+	run "$cmd_path" -b 10 0.0005
+	[ "$status" -eq 0 ]
+	[ "${#lines[@]}" -eq 2 ]
+	grep -Eq '^ +min +median +p90 +p99 +max$' <<< "${lines[0]}"
+	grep -Eq '^ns( +[0-9]+){5}$' <<< "${lines[1]}"
+
+	run "$cmd_path" -b 10 -s 50 0.0005
+	[ "$status" -eq 0 ]
+	grep -Eq '^ns( +[0-9]+){5}$' <<< "${lines[1]}"
+
+	# Dry run takes precedence.
+	run "$cmd_path" -n -b 10 1
+	[ "$status" -eq 0 ]
+	[ "$output" = '1.000000000' ]
+
+	run "$cmd_path" -b 10 inf
+	[ "$status" -eq 1 ]
+
+	local arg
+
+	for arg in 0 -1 foo 16777217 9223372036854775807
+	do
+		run "$cmd_path" -b "$arg" 1
+		[ "$status" -eq 1 ]
+		[ "$output" = "sleep: invalid number of runs: '${arg}'" ]
+	done
+}
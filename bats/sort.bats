@@ -0,0 +1,106 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "sort stdin" {
+	local cmd='sort'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(printf 'pear\napple\nfig\napple\nBanana\n\nfig tree\n')
+
+	local actual=$(echo "$input" | "$cmd_path")
+	[ "$actual" = "$(echo "$input" | LC_ALL=C sort)" ]
+
+	actual=$(echo "$input" | "$cmd_path" -)
+	[ "$actual" = "$(echo "$input" | LC_ALL=C sort)" ]
+
+	# Empty input.
+	actual=$("$cmd_path" < /dev/null)
+	[ -z "$actual" ]
+}
+
+@test "sort options" {
+	local cmd='sort'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(printf 'pear 10\napple 2\nfig -3\napple 2\nkiwi 2.5\nplum 007\nlime -0\nsloe 0.0\n')
+
+	local opts
+	for opts in '-r' '-u' '-r -u' '-n -k 2' '-n -r -k 2' '-k 2' '-k 1,1' '-k 2,2 -n'
+	do
+		local actual=$(echo "$input" | "$cmd_path" $opts)
+		local expected=$(echo "$input" | LC_ALL=C sort $opts)
+		[ "$actual" = "$expected" ]
+	done
+
+	input=$(printf '10\n9\n-1\n-10\n1.5\n1.25\n0\n100000000000000000000\n99999999999999999999\n-2.5\nfoo\n')
+
+	actual=$(echo "$input" | "$cmd_path" -n)
+	[ "$actual" = "$(echo "$input" | LC_ALL=C sort -n)" ]
+
+	actual=$(echo "$input" | "$cmd_path" -n -r)
+	[ "$actual" = "$(echo "$input" | LC_ALL=C sort -n -r)" ]
+}
+
+@test "sort multiple files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='sort'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	printf 'c\na\n' > "$tmpdir/file1"
+
+	# No trailing newline.
+	printf 'd\nb' > "$tmpdir/file2"
+
+	local actual=$("$cmd_path" "$tmpdir/file1" "$tmpdir/file2")
+	[ "$actual" = "$(printf 'a\nb\nc\nd')" ]
+
+	run "$cmd_path" "$tmpdir/file1" "$tmpdir/enoent"
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "sort large input with temporary files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='sort'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local file="$tmpdir/file"
+
+	# Large enough to need more than the maximum number of runs with
+	# the smallest buffer size.
+	seq 1 400000 | awk '{ print ($1 * 7919) % 400009, "line", $1 }' > "$file"
+
+	local expected=$(LC_ALL=C sort "$file" | cksum)
+
+	local actual=$("$cmd_path" -S 64K -T "$tmpdir" "$file" | cksum)
+	[ "$actual" = "$expected" ]
+
+	expected=$(LC_ALL=C sort -n -r "$file" | cksum)
+	actual=$("$cmd_path" -n -r -S 64K -T "$tmpdir" "$file" | cksum)
+	[ "$actual" = "$expected" ]
+
+	# The temporary files are removed.
+	[ "$(ls "$tmpdir")" = "file" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "sort bad options" {
+	local cmd='sort'
+
+	local opts
+	for opts in '-S' '-S foo' '-S 10X' '-k 0' '-k 2,1' '-k x' '-T /enoent -S 64K' '-z'
+	do
+		run bash -c "seq 1 100000 | $(clean_path "${CMD_DIR}/${cmd}") $opts"
+		[ "$status" -eq 1 ]
+	done
+}
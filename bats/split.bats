@@ -0,0 +1,164 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "split by lines" {
+	local tmpdir=$(mktemp -d)
+	local cmd='split'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	seq 1 5 > "$tmpdir/data"
+
+	run "$cmd_path" -l 2 "$tmpdir/data" "$tmpdir/x"
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/xaa")" = "$(printf '1\n2')" ]
+	[ "$(cat "$tmpdir/xab")" = "$(printf '3\n4')" ]
+	[ "$(cat "$tmpdir/xac")" = '5' ]
+	[ ! -e "$tmpdir/xad" ]
+
+	# Pipe input with numeric suffixes.
+	run "$cmd_path" -d -l 3 - "$tmpdir/p" < <(seq 1 5)
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/p00")" = "$(printf '1\n2\n3')" ]
+	[ "$(cat "$tmpdir/p01")" = "$(printf '4\n5')" ]
+	[ ! -e "$tmpdir/p02" ]
+
+	# A final unterminated line.
+	printf 'a\nb\nc' > "$tmpdir/data"
+
+	run "$cmd_path" -a 3 -l 2 "$tmpdir/data" "$tmpdir/u"
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/uaaa")" = "$(printf 'a\nb')" ]
+	[ "$(cat "$tmpdir/uaab")" = 'c' ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "split by bytes and chunks" {
+	local tmpdir=$(mktemp -d)
+	local cmd='split'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	printf 'abcdefghij' > "$tmpdir/data"
+
+	run "$cmd_path" -b 4 "$tmpdir/data" "$tmpdir/x"
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/xaa")" = 'abcd' ]
+	[ "$(cat "$tmpdir/xab")" = 'efgh' ]
+	[ "$(cat "$tmpdir/xac")" = 'ij' ]
+	[ ! -e "$tmpdir/xad" ]
+
+	run "$cmd_path" -b 4 - "$tmpdir/p" < <(printf 'abcdefghij')
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/paa")" = 'abcd' ]
+	[ "$(cat "$tmpdir/pab")" = 'efgh' ]
+	[ "$(cat "$tmpdir/pac")" = 'ij' ]
+
+	# The last file gets the remainder.
+	run "$cmd_path" -n 3 "$tmpdir/data" "$tmpdir/n"
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/naa")" = 'abc' ]
+	[ "$(cat "$tmpdir/nab")" = 'def' ]
+	[ "$(cat "$tmpdir/nac")" = 'ghij' ]
+
+	# Every file is created, even if empty.
+	run "$cmd_path" -d -n 12 "$tmpdir/data" "$tmpdir/e"
+	[ "$status" -eq 0 ]
+	[ "$(cat "$tmpdir/e09")" = 'j' ]
+	[ -e "$tmpdir/e11" ]
+	[ ! -s "$tmpdir/e11" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "split compare with system version" {
+	command -v split &>/dev/null || skip "need system split"
+
+	local tmpdir=$(mktemp -d)
+	local cmd='split'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local file="$tmpdir/data"
+
+	local i
+
+	for i in $(seq 1 20000)
+	do
+		printf '%d%*s\n' "$i" $((i % 97)) ''
+	done > "$file"
+
+	printf 'no newline' >> "$file"
+
+	local args
+
+	for args in '-l 1' '-l 777' '-b 1000' '-b 1K' '-n 7' '-d -l 3000' '-a 4 -b 12345' ''
+	do
+		rm -rf "$tmpdir/abox" "$tmpdir/system"
+		mkdir "$tmpdir/abox" "$tmpdir/system"
+
+		"$cmd_path" $args "$file" "$tmpdir/abox/x"
+		split $args "$file" "$tmpdir/system/x"
+		diff -r "$tmpdir/abox" "$tmpdir/system"
+
+		rm -rf "$tmpdir/abox" "$tmpdir/system"
+		mkdir "$tmpdir/abox" "$tmpdir/system"
+
+		# '-n' needs a regular file.
+		[[ "$args" = *-n* ]] && continue
+
+		"$cmd_path" $args - "$tmpdir/abox/x" < <(cat "$file")
+		split $args - "$tmpdir/system/x" < <(cat "$file")
+		diff -r "$tmpdir/abox" "$tmpdir/system"
+	done
+
+	rm -rf "$tmpdir"
+}
+
+@test "split errors" {
+	local tmpdir=$(mktemp -d)
+	local cmd='split'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" -b 1 -l 2
+	[ "$status" -eq 1 ]
+	[ "$output" = 'split: cannot split in more than one way' ]
+
+	run "$cmd_path" -b 0
+	[ "$status" -eq 1 ]
+	[ "$output" = "split: invalid number of bytes: '0'" ]
+
+	run "$cmd_path" -l foo
+	[ "$status" -eq 1 ]
+	[ "$output" = "split: invalid number of lines: 'foo'" ]
+
+	run "$cmd_path" -n 3 - < <(printf 'abc')
+	[ "$status" -eq 1 ]
+	[ "$output" = 'split: -: cannot determine file size' ]
+
+	run "$cmd_path" a b c
+	[ "$status" -eq 1 ]
+	[ "$output" = "split: extra operand 'c'" ]
+
+	run "$cmd_path" /does-not-exist
+	[ "$status" -eq 1 ]
+	[ "$output" = 'split: /does-not-exist: cannot open file' ]
+
+	printf 'abc' > "$tmpdir/data"
+
+	run "$cmd_path" -a 1 -d -b 1 "$tmpdir/data" "$tmpdir/x"
+	[ "$status" -eq 0 ]
+
+	run "$cmd_path" -a 1 -d -l 1 - "$tmpdir/x" < <(seq 1 11)
+	[ "$status" -eq 1 ]
+	[ "$output" = 'split: output file suffixes exhausted' ]
+	[ "$(cat "$tmpdir/x9")" = '10' ]
+
+	rm -rf "$tmpdir"
+}
@@ -0,0 +1,74 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "sync" {
+	test_cmd 'sync'
+	[ "$status" -eq 0 ]
+	[ ${#lines[@]} = 0 ]
+}
+
+@test "sync files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='sync'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local files=()
+	local i
+	for i in $(seq 1 50)
+	do
+		echo "$i" > "$tmpdir/file$i"
+		files+=("$tmpdir/file$i")
+	done
+
+	run "$cmd_path" "${files[@]}"
+	[ "$status" -eq 0 ]
+	[ ${#lines[@]} = 0 ]
+
+	run "$cmd_path" -d "${files[@]}"
+	[ "$status" -eq 0 ]
+	[ ${#lines[@]} = 0 ]
+
+	run "$cmd_path" -f "${files[@]}"
+	[ "$status" -eq 0 ]
+	[ ${#lines[@]} = 0 ]
+
+	# Directories can be synced too.
+	run "$cmd_path" "$tmpdir"
+	[ "$status" -eq 0 ]
+
+	# A missing file is reported, but the others are still synced.
+	run "$cmd_path" "$tmpdir/file1" "$tmpdir/missing" "$tmpdir/file2"
+	[ "$status" -eq 1 ]
+	[ ${#lines[@]} = 1 ]
+	echo "$output" | grep -q "missing"
+
+	rm -rf "$tmpdir"
+}
+
+@test "sync bad options" {
+	local tmpdir=$(mktemp -d)
+	local cmd='sync'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	touch "$tmpdir/file"
+
+	# Data only sync requires files.
+	run "$cmd_path" -d
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -d -f "$tmpdir/file"
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -x "$tmpdir/file"
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "tee stdout only" {
+	local cmd='tee'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$(echo hello | "$cmd_path")
+	[ "$actual" = "hello" ]
+
+	# Input that is not a pipe.
+	actual=$("$cmd_path" < /dev/null)
+	[ -z "$actual" ]
+}
+
+@test "tee files" {
+	local tmpdir=$(mktemp -d)
+	local cmd='tee'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input="$tmpdir/input"
+	seq 1 200000 > "$input"
+
+	local files=("$tmpdir/a" "$tmpdir/b" "$tmpdir/c")
+
+	# stdin is a pipe, stdout is a pipe.
+	cat "$input" | "$cmd_path" "${files[@]}" | cat > "$tmpdir/out"
+	cmp "$input" "$tmpdir/out"
+
+	local file
+	for file in "${files[@]}"
+	do
+		cmp "$input" "$file"
+	done
+
+	# stdin is a pipe, stdout is a file.
+	cat "$input" | "$cmd_path" "${files[@]}" > "$tmpdir/out"
+	cmp "$input" "$tmpdir/out"
+
+	for file in "${files[@]}"
+	do
+		cmp "$input" "$file"
+	done
+
+	# stdin is a file.
+	"$cmd_path" "${files[@]}" < "$input" > "$tmpdir/out"
+	cmp "$input" "$tmpdir/out"
+
+	for file in "${files[@]}"
+	do
+		cmp "$input" "$file"
+	done
+
+	# Single file (which consumes the input).
+	cat "$input" | "$cmd_path" "$tmpdir/a" > /dev/null
+	cmp "$input" "$tmpdir/a"
+
+	rm -rf "$tmpdir"
+}
+
+@test "tee append" {
+	local tmpdir=$(mktemp -d)
+	local cmd='tee'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local file="$tmpdir/file"
+	echo one > "$file"
+
+	echo two | "$cmd_path" -a "$file" > /dev/null
+	[ "$(cat "$file")" = "$(printf 'one\ntwo')" ]
+
+	echo three | "$cmd_path" "$file" > /dev/null
+	[ "$(cat "$file")" = "three" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "tee errors" {
+	local tmpdir=$(mktemp -d)
+	local cmd='tee'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# The other outputs are still written to.
+	run bash -c "echo hello | '$cmd_path' '$tmpdir/no/such/file' '$tmpdir/file'"
+	[ "$status" -eq 1 ]
+	[ "$(cat "$tmpdir/file")" = "hello" ]
+
+	run "$cmd_path" -x
+	[ "$status" -eq 1 ]
+
+	rm -rf "$tmpdir"
+}
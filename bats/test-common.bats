@@ -61,16 +61,14 @@ setup() {
 
 	ABOX_PATH="${CMD_DIR}/${ABOX_NAME}"
 
+	# The commands built into the binary.
+	COMMANDS=(${ABOX_COMMANDS:-})
+
 	setup_test_env \
 		"${ABOX_BINARY:-}" \
 		"${CMDS_DIR:-}" \
-		"${TEST_DIR:-}"
-
-	pushd "$CMDS_DIR" &>/dev/null
-	COMMANDS=($(ls *"${asm_ext}" |\
-		sort -u |\
-		sed "s/${asm_ext}//g"))
-	popd &>/dev/null
+		"${TEST_DIR:-}" \
+		"${COMMANDS[@]}"
 
 	COMMANDS_COUNT=${#COMMANDS[@]}
 
@@ -162,6 +160,96 @@ cmd_valid() {
 	return 1
 }
 
+# Returns success if the specified command was built into the binary
+# (according to the generated test settings). Use this to guard checks
+# that run other abox commands, since a build may omit them.
+cmd_built() {
+	local cmd="${1:-}"
+	[ -z "$cmd" ] && die "need command name"
+
+	local built
+	for built in "${COMMANDS[@]}"
+	do
+		[ "$built" = "$cmd" ] && return 0
+	done
+
+	return 1
+}
+
+# Create a test file in the specified directory (see
+# create_test_files()).
+_create_test_file() {
+	local dir="${1:-}"
+	[ -z "$dir" ] && die "need directory"
+
+	local name="${2:-}"
+	[ -z "$name" ] && die "need file name"
+
+	case "$name" in
+		a|copy) printf 'abc\ndef\nghi' ;;
+		b) printf 'abc\ndXf\nghY' ;;
+		binary) printf '\000\037 ~\177\200\377A' ;;
+		empty) true ;;
+		hello) printf 'hello\n' ;;
+		line) printf 'abc\n' ;;
+		numbers) seq 1 200000 ;;
+		random) head -c 300000 /dev/urandom ;;
+		repeat) yes 'abcabcabc' | head -c 1000000 ;;
+		short) printf 'abc\nd' ;;
+		text) printf 'hello world, this is a test!\n' ;;
+		zeros) head -c 40 /dev/zero ;;
+		*) die "invalid test file: '$name'" ;;
+	esac > "${dir}/${name}"
+}
+
+# Create the named test files in the specified directory:
+#
+# - a, copy: three short lines (with no final newline).
+# - b: as a, but differing at bytes 6 and 11.
+# - binary: control and non-ASCII bytes.
+# - empty: an empty file.
+# - hello: a single short line.
+# - line: the first line of a.
+# - numbers: 200,000 numbered lines.
+# - random: 300,000 random bytes.
+# - repeat: 1,000,000 bytes of a repeated pattern.
+# - short: the first 5 bytes of a.
+# - text: a line of text.
+# - zeros: 40 zero bytes.
+#
+# A name ending in ".gz" (or ".N.gz" for compression level N) is the
+# gzip compressed version of the file without that suffix, which is
+# created too.
+create_test_files() {
+	local dir="${1:-}"
+	[ -z "$dir" ] && die "need directory"
+
+	shift
+
+	local name
+
+	for name in "$@"
+	do
+		local file="$name"
+		local level=''
+
+		if [[ "$name" =~ ^(.+)\.([1-9])\.gz$ ]]
+		then
+			file="${BASH_REMATCH[1]}"
+			level="-${BASH_REMATCH[2]}"
+		elif [[ "$name" = *.gz ]]
+		then
+			file="${name%.gz}"
+		fi
+
+		[ -e "${dir}/${file}" ] || _create_test_file "$dir" "$file"
+
+		[ "$file" = "$name" ] && continue
+
+		gzip $level -c "${dir}/${file}" > "${dir}/${name}"
+	done
+}
+
 _test_cmd_via_sym_link() {
 	local quote="${1:-}"
 	[ -n "$quote" ] || die "need quote value"
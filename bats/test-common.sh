@@ -86,6 +86,13 @@ setup_test_env()
 
 	[ -d "$test_dir" ] || die "invalid test dir: '$test_dir'"
 
+	shift 3
+
+	# The remaining arguments are the names of the commands built into
+	# the binary.
+	local cmds=("$@")
+	[ "${#cmds[@]}" -gt 0 ] || die "need commands"
+
 	pushd "$test_dir" &>/dev/null
 
 	local test_bin_dir="${test_dir}/bin"
@@ -96,15 +103,7 @@ setup_test_env()
 	# Create a link for all valid commands
 	local links=()
 
-	local cmd
-	for cmd in "$cmds_dir"/*.asm
-	do
-		local cmd_name
-		cmd_name=$(basename -s "$asm_ext" "$cmd")
-
-		#echo "FIXME: cmd_name: '$cmd_name'"
-		links+=("${cmd_name}")
-	done
+	links+=("${cmds[@]}")
 
 	# Create a link for an invalid command
 	links+=("invalid")
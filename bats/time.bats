@@ -0,0 +1,104 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "time no args" {
+	local cmd='time'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path"
+	[ "$status" -eq 1 ]
+}
+
+@test "time external command" {
+	local cmd='time'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# The command output is unchanged (the results go to stderr).
+	local actual=$("$cmd_path" /bin/echo hello 2>/dev/null)
+	[ "$actual" = "hello" ]
+
+	run "$cmd_path" /bin/echo hello
+	[ "$status" -eq 0 ]
+
+	local metric
+	for metric in real user sys maxrss minflt majflt nvcsw nivcsw
+	do
+		echo "$output" | grep -Eq "^${metric} +[0-9.]+$"
+	done
+
+	run "$cmd_path" /bin/false
+	[ "$status" -eq 1 ]
+	echo "$output" | grep -Eq '^real +[0-9]+\.[0-9]{6}$'
+
+	run "$cmd_path" /does/not/exist
+	[ "$status" -eq 1 ]
+}
+
+@test "time abox command" {
+	local cmd='time'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# echo(1) is run if echo was not built.
+	local actual=$("$cmd_path" echo hello 2>/dev/null)
+	[ "$actual" = "hello" ]
+
+	if cmd_built 'echo'
+	then
+		actual=$("$cmd_path" "$ABOX_PATH" echo hello 2>/dev/null)
+		[ "$actual" = "hello" ]
+	fi
+
+	run "$cmd_path" true
+	[ "$status" -eq 0 ]
+	echo "$output" | grep -Eq '^real +[0-9]+\.[0-9]{6}$'
+
+	run "$cmd_path" false
+	[ "$status" -eq 1 ]
+}
+
+@test "time repeat" {
+	local cmd='time'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$("$cmd_path" -r 3 echo x 2>/dev/null | wc -l)
+	[ "$actual" -eq 3 ]
+
+	run "$cmd_path" -r 3 /bin/true
+	[ "$status" -eq 0 ]
+	echo "$output" | grep -Eq '^ +min +median +max$'
+	echo "$output" | grep -Eq '^real( +[0-9]+\.[0-9]{6}){3}$'
+	echo "$output" | grep -Eq '^minflt( +[0-9]+){3}$'
+
+	local value
+	for value in 0 -1 x
+	do
+		run "$cmd_path" -r "$value" /bin/true
+		[ "$status" -eq 1 ]
+		[ "$output" = "time: invalid number of runs: '${value}'" ]
+	done
+}
+
+@test "time json" {
+	local cmd='time'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" -j -r 2 /bin/true
+	[ "$status" -eq 0 ]
+	[ ${#lines[@]} = 1 ]
+
+	echo "$output" | grep -Eq '^\{"runs":2,"real":\{"min":[0-9]+\.[0-9]{6},"median":'
+	echo "$output" | grep -Eq '"nivcsw":\{"min":[0-9]+,"median":[0-9]+,"max":[0-9]+\}\}$'
+
+	if command -v python3 >/dev/null
+	then
+		echo "$output" | python3 -c 'import json,sys; json.load(sys.stdin)'
+	fi
+}
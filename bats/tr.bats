@@ -0,0 +1,100 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "tr translate" {
+	local cmd='tr'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$(echo "hello world" | "$cmd_path" a-z A-Z)
+	[ "$actual" = "HELLO WORLD" ]
+
+	actual=$(echo "Hello World" | "$cmd_path" '[:upper:]' '[:lower:]')
+	[ "$actual" = "hello world" ]
+
+	# SET2 is extended with its last character.
+	actual=$(echo "abcdef" | "$cmd_path" a-f xy)
+	[ "$actual" = "xyyyyy" ]
+
+	# Escapes.
+	actual=$(printf "a\tb\n" | "$cmd_path" '\t' '\101')
+	[ "$actual" = "aAb" ]
+
+	actual=$(echo "abc" | "$cmd_path" -c 'a\n' X)
+	[ "$actual" = "aXX" ]
+}
+
+@test "tr delete and squeeze" {
+	local cmd='tr'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$(printf "a\r\nb\r\n" | "$cmd_path" -d '\r' | od -An -c | tr -d ' \n')
+	[ "$actual" = 'a\nb\n' ]
+
+	actual=$(echo "h3ll0 w0rld" | "$cmd_path" -d '[:digit:]')
+	[ "$actual" = "hll wrld" ]
+
+	actual=$(echo "h3ll0 w0rld" | "$cmd_path" -cd 'a-z\n')
+	[ "$actual" = "hllwrld" ]
+
+	actual=$(echo "aaabbbccc   ddd" | "$cmd_path" -s 'a-c ')
+	[ "$actual" = "abc ddd" ]
+
+	actual=$(echo "aaabbbccc" | "$cmd_path" -s a-c x)
+	[ "$actual" = "x" ]
+
+	actual=$(echo "a11bb22c" | "$cmd_path" -ds 0-9 b)
+	[ "$actual" = "abc" ]
+}
+
+@test "tr large input" {
+	local tmpdir=$(mktemp -d)
+	local cmd='tr'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	head -c 300001 /dev/urandom > "$tmpdir/data"
+
+	local args
+	for args in "a-z A-Z" "-d \r" "-d \0-\177" "-c a-z x" "-s \0-\377" \
+		"\0-\377 \1-\377\0"
+	do
+		"$cmd_path" $args < "$tmpdir/data" > "$tmpdir/actual"
+		LC_ALL=C tr $args < "$tmpdir/data" > "$tmpdir/expected"
+		cmp "$tmpdir/actual" "$tmpdir/expected"
+	done
+
+	rm -rf "$tmpdir"
+}
+
+@test "tr errors" {
+	local cmd='tr'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path"
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" a
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -d a b
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" a ''
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" z-a x
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" '[:foo:]' x
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -x a b
+	[ "$status" -eq 1 ]
+}
@@ -0,0 +1,167 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "xargs default command" {
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(printf 'a b\n  c\td\n\ne')
+
+	local actual=$(echo "$input" | "$cmd_path")
+	[ "$actual" = "$(echo "$input" | xargs)" ]
+
+	# The command is run once even without any input.
+	actual=$("$cmd_path" < /dev/null | wc -l)
+	[ "$actual" -eq 1 ]
+}
+
+@test "xargs options" {
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(seq 1 100)
+
+	local opts
+	for opts in '' '-n 1' '-n 3' '-n 100' '-n 1000'
+	do
+		# External command.
+		local actual=$(echo "$input" | "$cmd_path" $opts /bin/echo x)
+		local expected=$(echo "$input" | xargs $opts /bin/echo x)
+		[ "$actual" = "$expected" ]
+
+		# abox commands (or echo(1) if echo was not built).
+		actual=$(echo "$input" | "$cmd_path" $opts echo x)
+		[ "$actual" = "$expected" ]
+
+		cmd_built 'echo' || continue
+
+		actual=$(echo "$input" | "$cmd_path" $opts "$ABOX_PATH" echo x)
+		[ "$actual" = "$expected" ]
+	done
+}
+
+@test "xargs quoting" {
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(printf '%s\n' "'a b' \"c  d\" e\\ f" "g'h'i")
+
+	local actual=$(echo "$input" | "$cmd_path" -n 1 /bin/echo)
+	[ "$actual" = "$(echo "$input" | xargs -n 1 /bin/echo)" ]
+
+	run "$cmd_path" /bin/echo <<< "'unterminated"
+	[ "$status" -eq 1 ]
+}
+
+@test "xargs nul and replace" {
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local actual=$(printf 'a b\0c\n\0d' | "$cmd_path" -0 -n 1 /bin/echo | od -c)
+	local expected=$(printf 'a b\0c\n\0d' | xargs -0 -n 1 /bin/echo | od -c)
+	[ "$actual" = "$expected" ]
+
+	local input=$(printf 'one\n  two words\n\nthree\n')
+
+	actual=$(echo "$input" | "$cmd_path" -I {} echo '[{}]' '{}{}' x)
+	[ "$actual" = "$(echo "$input" | xargs -I {} echo '[{}]' '{}{}' x)" ]
+
+	actual=$(echo "$input" | "$cmd_path" -I XX /bin/echo XX)
+	[ "$actual" = "$(echo "$input" | xargs -I XX /bin/echo XX)" ]
+
+	# No input, so no command.
+	actual=$("$cmd_path" -I {} echo {} < /dev/null)
+	[ -z "$actual" ]
+}
+
+@test "xargs parallel" {
+	local tmpdir=$(mktemp -d)
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	local input=$(seq 1 200)
+
+	local procs
+	for procs in 0 2 16 1000
+	do
+		local actual=$(echo "$input" | "$cmd_path" -P $procs -n 3 /bin/echo | tr ' ' '\n' | sort -n)
+		[ "$actual" = "$input" ]
+
+		actual=$(echo "$input" | "$cmd_path" -P $procs -n 3 echo | tr ' ' '\n' | sort -n)
+		[ "$actual" = "$input" ]
+	done
+
+	# abox commands run in-process.
+	cmd_built 'rm' || { rm -rf "$tmpdir"; return 0; }
+
+	local i
+	for i in $(seq 1 100)
+	do
+		touch "$tmpdir/file$i"
+	done
+
+	ls "$tmpdir"/file* | "$cmd_path" -P 16 -n 5 "$ABOX_PATH" rm
+	[ -z "$(ls "$tmpdir")" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "xargs errors" {
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	run "$cmd_path" false <<< 'a'
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" sh -c 'exit 3' <<< 'a'
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" /does/not/exist <<< 'a'
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -s 5 /bin/echo <<< 'a'
+	[ "$status" -eq 1 ]
+
+	run "$cmd_path" -s 20 /bin/echo <<< 'aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa'
+	[ "$status" -eq 1 ]
+
+	local opt
+	for opt in '-n 0' '-n x' '-P -1' '-s 0' '-z'
+	do
+		run "$cmd_path" $opt /bin/echo <<< 'a'
+		[ "$status" -eq 1 ]
+	done
+}
+
+@test "xargs false" {
+	local tmpdir=$(mktemp -d)
+	local cmd='xargs'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	# The false command calls exit(3), so it must be run as a separate
+	# process (found in PATH) rather than in-process, otherwise xargs
+	# would exit after the first item.
+	mkdir "$tmpdir/bin"
+
+	cat > "$tmpdir/bin/false" <<-EOT
+	#!/bin/sh
+	echo "\$@" >> "$tmpdir/log"
+	exit 1
+	EOT
+
+	chmod +x "$tmpdir/bin/false"
+
+	run env PATH="$tmpdir/bin:$PATH" "$cmd_path" -n 1 false < <(printf '1\n2\n3\n')
+	[ "$status" -eq 1 ]
+	[ "$(cat "$tmpdir/log")" = "$(printf '1\n2\n3')" ]
+
+	rm -rf "$tmpdir"
+}
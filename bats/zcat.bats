@@ -0,0 +1,167 @@
+#!/usr/bin/env bats
+#---------------------------------------------------------------------
+# vim:set noexpandtab:
+#---------------------------------------------------------------------
+# Copyright (c) 2023 James O. D. Hunt <jamesodhunt@gmail.com>
+#
+# SPDX-License-Identifier: Apache-2.0
+#---------------------------------------------------------------------
+
+load 'test-common.bats'
+
+@test "zcat files" {
+	command -v gzip &>/dev/null || skip "need gzip"
+
+	local tmpdir=$(mktemp -d)
+	local cmd='zcat'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" \
+		{empty,hello,numbers,random,repeat}{.gz,.1.gz,.9.gz}
+
+	local name
+	local file
+
+	for name in empty hello numbers random repeat
+	do
+		for file in "$name.gz" "$name.1.gz" "$name.9.gz"
+		do
+			"$cmd_path" "$tmpdir/$file" > "$tmpdir/out"
+			cmp "$tmpdir/$name" "$tmpdir/out"
+		done
+	done
+
+	# Stdin.
+	"$cmd_path" < "$tmpdir/numbers.gz" > "$tmpdir/out"
+	cmp "$tmpdir/numbers" "$tmpdir/out"
+
+	"$cmd_path" - < "$tmpdir/numbers.gz" > "$tmpdir/out"
+	cmp "$tmpdir/numbers" "$tmpdir/out"
+
+	# Multiple files.
+	"$cmd_path" "$tmpdir/hello.gz" - "$tmpdir/repeat.gz" \
+		< "$tmpdir/numbers.gz" > "$tmpdir/out"
+	cat "$tmpdir/hello" "$tmpdir/numbers" "$tmpdir/repeat" > "$tmpdir/expected"
+	cmp "$tmpdir/expected" "$tmpdir/out"
+
+	rm -rf "$tmpdir"
+}
+
+@test "zcat multiple members" {
+	command -v gzip &>/dev/null || skip "need gzip"
+
+	local tmpdir=$(mktemp -d)
+	local cmd='zcat'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" numbers.gz empty.gz random.9.gz hello.gz hello.1.gz
+
+	cat "$tmpdir/numbers.gz" "$tmpdir/empty.gz" "$tmpdir/random.9.gz" \
+		"$tmpdir/hello.1.gz" > "$tmpdir/multi.gz"
+	cat "$tmpdir/numbers" "$tmpdir/random" "$tmpdir/hello" > "$tmpdir/expected"
+
+	"$cmd_path" "$tmpdir/multi.gz" > "$tmpdir/out"
+	cmp "$tmpdir/expected" "$tmpdir/out"
+
+	# Trailing zero bytes are ignored.
+	head -c 512 /dev/zero >> "$tmpdir/multi.gz"
+
+	"$cmd_path" "$tmpdir/multi.gz" > "$tmpdir/out"
+	cmp "$tmpdir/expected" "$tmpdir/out"
+
+	# Anything else is reported (after the data).
+	printf 'garbage' >> "$tmpdir/hello.gz"
+
+	run "$cmd_path" "$tmpdir/hello.gz"
+	[ "$status" -eq 1 ]
+	[ "${lines[0]}" = 'hello' ]
+	[ "${lines[1]}" = "zcat: $tmpdir/hello.gz: decompression OK, trailing garbage ignored" ]
+
+	rm -rf "$tmpdir"
+}
+
+@test "zcat invalid files" {
+	command -v gzip &>/dev/null || skip "need gzip"
+
+	local tmpdir=$(mktemp -d)
+	local cmd='zcat'
+	local cmd_path=$(clean_path "${CMD_DIR}/${cmd}")
+
+	create_test_files "$tmpdir" hello.gz empty numbers.gz
+
+	cd "$tmpdir"
+
+	run "$cmd_path" hello
+	[ "$status" -eq 1 ]
+	[ "$output" = 'zcat: hello: not in gzip format' ]
+
+	run "$cmd_path" empty
+	[ "$status" -eq 1 ]
+	[ "$output" = 'zcat: empty: unexpected end of file' ]
+
+	run "$cmd_path" < hello
+	[ "$status" -eq 1 ]
+	[ "$output" = 'zcat: stdin: not in gzip format' ]
+
+	run "$cmd_path" does-not-exist
+	[ "$status" -eq 1 ]
+	[ "$output" = 'zcat: does-not-exist: cannot open file' ]
+
+	# Truncated.
+	head -c 1000 numbers.gz > truncated.gz
+
+	local ret=0
+	"$cmd_path" truncated.gz > out 2> err || ret=$?
+	[ "$ret" -eq 1 ]
+	[ "$(cat err)" = 'zcat: truncated.gz: unexpected end of file' ]
+
+	# The data before the end is still written.
+	[ -s out ]
+	run cmp -s out numbers
+	[ "$status" -ne 0 ]
+	cmp -n $(stat -c '%s' out) out numbers
+
+	# Bits decoded after the end of the input must not produce output,
+	# wherever the stream is cut.
+	local size
+
+	for size in $(seq 1000 1063)
+	do
+		head -c $size numbers.gz > truncated.gz
+
+		ret=0
+		"$cmd_path" truncated.gz > out 2> /dev/null || ret=$?
+		[ "$ret" -eq 1 ]
+		cmp -n $(stat -c '%s' out) out numbers
+	done
+
+	# Corrupt CRC and length.
+	cp hello.gz bad-crc.gz
+	printf '\377' | dd of=bad-crc.gz bs=1 seek=$(( $(stat -c '%s' hello.gz) - 8 )) conv=notrunc 2>/dev/null
+
+	run "$cmd_path" bad-crc.gz
+	[ "$status" -eq 1 ]
+	[ "${lines[1]}" = 'zcat: bad-crc.gz: invalid compressed data--crc error' ]
+
+	cp hello.gz bad-length.gz
+	printf '\377' | dd of=bad-length.gz bs=1 seek=$(( $(stat -c '%s' hello.gz) - 4 )) conv=notrunc 2>/dev/null
+
+	run "$cmd_path" bad-length.gz
+	[ "$status" -eq 1 ]
+	[ "${lines[1]}" = 'zcat: bad-length.gz: invalid compressed data--length error' ]
+
+	# A reserved block type.
+	printf '\037\213\010\000\000\000\000\000\000\003\007' > bad-block.gz
+
+	run "$cmd_path" bad-block.gz
+	[ "$status" -eq 1 ]
+	[ "$output" = 'zcat: bad-block.gz: invalid compressed data--format violated' ]
+
+	# Later files are still processed.
+	run "$cmd_path" hello hello.gz
+	[ "$status" -eq 1 ]
+	[ "${lines[0]}" = 'zcat: hello: not in gzip format' ]
+	[ "${lines[1]}" = 'hello' ]
+
+	rm -rf "$tmpdir"
+}
@@ -97,15 +97,31 @@ setup()
 	true
 }
 
-# Return a sorted list of commands
+# Return a sorted list of commands.
+#
+# If a comma separated list of commands is specified, only those
+# commands are returned.
 get_commands()
 {
 	local cmd_dir="${1:-}"
 	[ -z "$cmd_dir" ] && die "need command directory"
 	[ -d "$cmd_dir" ] || die "invalid command directory: '$cmd_dir' (pwd: '$PWD')"
 
+	local selected="${2:-}"
+
 	local cmd
 
+	if [ -n "$selected" ]
+	then
+		for cmd in ${selected//,/ }
+		do
+			[ -e "${cmd_dir}/${cmd}${asm_ext}" ] || die "invalid command: '$cmd'"
+			echo "$cmd"
+		done | sort -u
+
+		return 0
+	fi
+
 	find "$cmd_dir" -type f -name "*${asm_ext}" |\
 		while read -r cmd
 		do
@@ -113,6 +129,19 @@ get_commands()
 		done | sort
 }
 
+# Returns success if the specified command exports a
+# "command_flags_<cmd>" symbol (a CMD_FLAG_* bitmask).
+command_has_flags()
+{
+	local cmd_dir="${1:-}"
+	[ -z "$cmd_dir" ] && die "need command directory"
+
+	local cmd="${2:-}"
+	[ -z "$cmd" ] && die "need command"
+
+	grep -q "^global command_flags_${cmd}\$" "${cmd_dir}/${cmd}${asm_ext}"
+}
+
 generate_header()
 {
 	local out_file="${1:-}"
@@ -222,13 +251,17 @@ generate_commands()
 	local out_file="${2:-}"
 	[ -z "$out_file" ] && die "need output file"
 
+	# Optional comma separated list of commands to include
+	# (default: all commands).
+	local selected="${3:-}"
+
 	local -r commands_label='commands'
 	local -r commands_count_label='commands_count'
 
 	local cmds
 	local cmd
 
-	cmds=$(get_commands "$cmd_dir" || true)
+	cmds=$(get_commands "$cmd_dir" "$selected" || true)
 	[ -z "$cmds" ] && die "no commands found"
 
 	generate_header "$out_file"
@@ -238,14 +271,19 @@ generate_commands()
 		cat <<-EOT>>"${out_file}"
 		extern command_${cmd}
 		extern command_help_${cmd}
-
 		EOT
+
+		command_has_flags "$cmd_dir" "$cmd" &&
+			echo "extern command_flags_${cmd}" >> "${out_file}"
+
+		echo >> "${out_file}"
 	done
 
 	cat <<-EOT>>"${out_file}"
 	%include "header.inc"
 
-	section .rodata
+	; Used to select the command on every run.
+	hot_rodata
 
 	;---------------------------------------------------------------------
 	; List of available command names.
@@ -295,14 +333,22 @@ generate_commands()
 
 	EOT
 
+	local flags
+
 	for cmd in $cmds
 	do
+		flags=0
+
+		command_has_flags "$cmd_dir" "$cmd" &&
+			flags="command_flags_${cmd}"
+
 		cat <<-EOT>>"${out_file}"
 		command_entry_${cmd}:
 		  istruc Command
 		    at Command.name,  dq  command_name_${cmd}
 		    at Command.func,  dq  command_${cmd}
 		    at Command.help,  dq  command_help_${cmd}
+		    at Command.flags, dq  ${flags}
 		  iend
 
 		EOT
@@ -330,19 +376,110 @@ generate_test_settings()
 	local settings_file="${5:-}"
 	[ -z "$settings_file" ] && die "need settings file"
 
+	# Optional comma separated list of the commands that were built.
+	local selected="${6:-}"
+
 	local canonical_cmds_dir
 	canonical_cmds_dir=$(realpath -e "$cmds_dir")
 
+	local cmds
+	cmds=$(get_commands "$cmds_dir" "$selected" | xargs)
+
 	cat <<-EOT>"$settings_file"
 	# XXX: WARNING: Generated file - do not modify WARNING: XXX:
 
 	ABOX_BINARY='$binary_path'
 	ABOX_NAME='$binary_name'
+	ABOX_COMMANDS='$cmds'
 	CMDS_DIR='$canonical_cmds_dir'
 	TEST_DIR='$test_dir'
 	EOT
 }
 
+# Generate a linker script that augments the default linker script to
+# order the hot and cold sections (see the "Code and data layout" section
+# in header.inc).
+#
+# The resulting layout is:
+#
+# - .text.hot:    startup code, then the code for each of the specified
+#                 hot commands (in order), then any other hot code.
+# - .text:        other code.
+# - .text.unlikely: cold code (help, errors and rarely used options).
+# - .rodata:      other data.
+# - .rodata.hot:  data used by the startup code.
+# - .rodata.cold: help text and error messages.
+#
+# Note that the hot data is placed after (rather than before) .rodata
+# since sections inserted before .rodata end up in the text segment.
+generate_linker_script()
+{
+	local out_file="${1:-}"
+	[ -z "$out_file" ] && die "need output file"
+
+	# Comma separated list of commands to place first
+	# (default: those used most often by scripts).
+	local hot_cmds="${2:-true,cat}"
+
+	local cmd
+	local hot_patterns=''
+
+	for cmd in ${hot_cmds//,/ }
+	do
+		hot_patterns+=$(printf "\n        *(.text.hot.%s)" "$cmd")
+	done
+
+	cat <<-EOT>"$out_file"
+	/*--------------------------------------------------------------------
+	 * XXX Generated file - do not modify! XXX
+	 *--------------------------------------------------------------------
+	 * Generated by: '$script_name'
+	 * Generated at: $(date -Isec)
+	 *--------------------------------------------------------------------
+	 * Copyright (c) ${copyright_year} ${copyright_name_tag}
+	 *
+	 * SPDX-License-Identifier: Apache-2.0
+	 *--------------------------------------------------------------------
+	 * Note: The INSERT commands mean this script augments (rather than
+	 * replaces) the default linker script.
+	 *--------------------------------------------------------------------
+	 */
+
+	SECTIONS
+	{
+	    .text.hot :
+	    {
+	        *(.text.hot.startup)${hot_patterns}
+	        *(.text.hot .text.hot.*)
+	    }
+	}
+	INSERT BEFORE .text;
+
+	SECTIONS
+	{
+	    .text.unlikely :
+	    {
+	        *(.text.unlikely .text.unlikely.*)
+	    }
+	}
+	INSERT AFTER .text;
+
+	SECTIONS
+	{
+	    .rodata.hot :
+	    {
+	        *(.rodata.hot .rodata.hot.*)
+	    }
+
+	    .rodata.cold :
+	    {
+	        *(.rodata.cold .rodata.cold.*)
+	    }
+	}
+	INSERT AFTER .rodata;
+	EOT
+}
+
 # TODO: add SPDX license header check.
 handle_check()
 {
@@ -395,6 +532,387 @@ handle_check()
 	true
 }
 
+# Run a command the specified number of times, and display the median
+# elapsed time.
+#
+# The optional prepare command is run (untimed) before each run.
+bench_run()
+{
+	local label="${1:-}"
+	[ -z "$label" ] && die "need label"
+
+	local runs="${2:-}"
+	[ -z "$runs" ] && die "need run count"
+
+	local prepare="${3:-}"
+
+	shift 3 || die "need command to benchmark"
+	[ $# -eq 0 ] && die "need command to benchmark"
+
+	local i
+	local start
+	local end
+	local times=()
+
+	for ((i=0; i < runs; i++))
+	do
+		[ -n "$prepare" ] && eval "$prepare"
+
+		start=$(date '+%s%N')
+		"$@" >/dev/null
+		end=$(date '+%s%N')
+
+		times+=($(( end - start )))
+	done
+
+	printf "%s\n" "${times[@]}" |\
+		sort -n |\
+		awk -v label="$label" \
+		'{ t[NR] = $1 }
+		END { printf("%-40s %12.3f ms (median of %d)\n",
+			label, t[int((NR + 1) / 2)] / 1000000, NR) }'
+}
+
+# Compare the abox cp command to the system cp(1) for a selection of
+# file sizes and types.
+#
+# The benchmark files are created in $BENCH_DIR (default: /var/tmp) since
+# the results depend heavily on the filesystem (for example, whether it
+# supports reflinks).
+bench_cp()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+
+	local runs="${2:-5}"
+
+	local tmpdir
+	tmpdir=$(mktemp -d -p "${BENCH_DIR:-/var/tmp}")
+
+	local -A sizes=(
+		[small]='4K'
+		[medium]='16M'
+		[large]='512M'
+	)
+
+	local name
+	local file
+	local copy="$tmpdir/copy"
+
+	info "creating benchmark files in '$tmpdir'"
+
+	for name in "${!sizes[@]}"
+	do
+		head -c "${sizes[$name]}" /dev/urandom > "$tmpdir/$name"
+	done
+
+	# A mostly empty sparse file.
+	echo 'start' > "$tmpdir/sparse"
+	truncate -s 1G "$tmpdir/sparse"
+	echo 'end' >> "$tmpdir/sparse"
+
+	sync
+
+	for name in small medium large sparse
+	do
+		file="$tmpdir/$name"
+
+		bench_run "abox cp ($name)" "$runs" "rm -f '$copy'" \
+			"$abox" cp "$file" "$copy"
+
+		cmp "$file" "$copy" || die "abox cp produced a bad copy of '$file'"
+
+		bench_run "cp --reflink=auto ($name)" "$runs" "rm -f '$copy'" \
+			cp --reflink=auto "$file" "$copy"
+	done
+
+	rm -rf "$tmpdir"
+}
+
+# Display the size of the abox binary and the number of page faults
+# taken to start it and run the specified command (default: true).
+#
+# Used to compare a full build with one built for selected commands
+# (see the meson "commands" option).
+bench_size()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+	[ -x "$abox" ] || die "invalid abox binary: '$abox'"
+
+	local runs="${2:-20}"
+
+	local cmd="${3:-true}"
+
+	local time_cmd='/usr/bin/time'
+	[ -x "$time_cmd" ] || die "need GNU time(1) command: '$time_cmd'"
+
+	command -v size &>/dev/null || die "need command: 'size'"
+
+	local file_bytes
+	file_bytes=$(stat -c '%s' "$abox")
+
+	local text data bss
+	read -r text data bss _ < <(size "$abox" | tail -n 1)
+
+	printf "%-40s %12d bytes\n" "file" "$file_bytes"
+	printf "%-40s %12d bytes\n" "text" "$text"
+	printf "%-40s %12d bytes\n" "data" "$data"
+	printf "%-40s %12d bytes\n" "bss" "$bss"
+
+	local i
+	local faults=()
+
+	for ((i=0; i < runs; i++))
+	do
+		faults+=($("$time_cmd" -f '%R' "$abox" "$cmd" 2>&1 >/dev/null | tail -n 1))
+	done
+
+	printf "%s\n" "${faults[@]}" |\
+		sort -n |\
+		awk -v label="page faults (abox $cmd)" \
+		'{ f[NR] = $1 }
+		END { printf("%-40s %12d (median of %d)\n",
+			label, f[int((NR + 1) / 2)], NR) }'
+
+	bench_run "startup (abox $cmd)" "$runs" "" "$abox" "$cmd"
+}
+
+# Display how late abox sleep wakes for a short sleep, with and without
+# spinning for the end of the sleep (see the sleep '-b' and '-s'
+# options).
+bench_sleep()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+	[ -x "$abox" ] || die "invalid abox binary: '$abox'"
+
+	local runs="${2:-1000}"
+
+	local delay='0.0005'
+	local spin
+
+	for spin in 0 50
+	do
+		info "abox sleep $delay (spin ${spin}us, $runs runs)"
+
+		"$abox" sleep -b "$runs" -s "$spin" "$delay"
+	done
+}
+
+# Compare abox zcat with "gzip -dc" on compressed text, random
+# (incompressible) data and a file of multiple gzip members.
+bench_zcat()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+	[ -x "$abox" ] || die "invalid abox binary: '$abox'"
+
+	local runs="${2:-5}"
+
+	command -v gzip &>/dev/null || die "need command: 'gzip'"
+
+	local tmpdir
+	tmpdir=$(mktemp -d -p "${BENCH_DIR:-/var/tmp}")
+
+	info "creating benchmark files in '$tmpdir'"
+
+	seq 1 8000000 > "$tmpdir/text"
+	head -c 64M /dev/urandom > "$tmpdir/random"
+
+	gzip -6 -c "$tmpdir/text" > "$tmpdir/text.gz"
+	gzip -6 -c "$tmpdir/random" > "$tmpdir/random.gz"
+	cat "$tmpdir/text.gz" "$tmpdir/random.gz" > "$tmpdir/multi.gz"
+
+	local name
+	local file
+
+	for name in text random multi
+	do
+		file="$tmpdir/$name.gz"
+
+		bench_run "abox zcat ($name)" "$runs" "" \
+			"$abox" zcat "$file"
+
+		cmp <("$abox" zcat "$file") <(gzip -dc "$file") ||\
+			die "abox zcat produced bad output for '$file'"
+
+		bench_run "gzip -dc ($name)" "$runs" "" \
+			gzip -dc "$file"
+	done
+
+	rm -rf "$tmpdir"
+}
+
+# Compare abox cut with the system version on a large TSV file.
+bench_cut()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+	[ -x "$abox" ] || die "invalid abox binary: '$abox'"
+
+	local runs="${2:-5}"
+
+	command -v cut &>/dev/null || die "need command: 'cut'"
+
+	local tmpdir
+	tmpdir=$(mktemp -d -p "${BENCH_DIR:-/var/tmp}")
+
+	info "creating benchmark files in '$tmpdir'"
+
+	local file="$tmpdir/data.tsv"
+
+	seq 1 4000000 |\
+		awk '{ printf "%d\t%s\t%d\tsome text for column %d\t%x\t%d\n", $1, "name" $1, $1 * 3, $1, $1, $1 % 7 }' \
+		> "$file"
+
+	local list
+
+	for list in 2 1,4 3-
+	do
+		bench_run "abox cut -f $list" "$runs" "" \
+			"$abox" cut -f "$list" "$file"
+
+		cmp <("$abox" cut -f "$list" "$file") <(cut -f "$list" "$file") ||\
+			die "abox cut produced bad output for '-f $list'"
+
+		bench_run "cut -f $list" "$runs" "" \
+			cut -f "$list" "$file"
+	done
+
+	bench_run "abox cut -b 1-8" "$runs" "" \
+		"$abox" cut -b 1-8 "$file"
+
+	bench_run "cut -b 1-8" "$runs" "" \
+		cut -b 1-8 "$file"
+
+	rm -rf "$tmpdir"
+}
+
+# Compare abox od and hexdump with the system versions (where
+# available) on random data.
+bench_hexdump()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+	[ -x "$abox" ] || die "invalid abox binary: '$abox'"
+
+	local runs="${2:-5}"
+
+	local tmpdir
+	tmpdir=$(mktemp -d -p "${BENCH_DIR:-/var/tmp}")
+
+	info "creating benchmark files in '$tmpdir'"
+
+	local file="$tmpdir/random"
+
+	head -c 64M /dev/urandom > "$file"
+
+	bench_run "abox od -An -tx1" "$runs" "" \
+		"$abox" od -An -tx1 "$file"
+
+	if command -v od &>/dev/null
+	then
+		cmp <("$abox" od -An -tx1 "$file") <(od -An -tx1 "$file") ||\
+			die "abox od produced bad output for '$file'"
+
+		bench_run "od -An -tx1" "$runs" "" \
+			od -An -tx1 "$file"
+	fi
+
+	bench_run "abox hexdump -C" "$runs" "" \
+		"$abox" hexdump -C "$file"
+
+	if command -v hexdump &>/dev/null
+	then
+		cmp <("$abox" hexdump -C "$file") <(hexdump -C "$file") ||\
+			die "abox hexdump produced bad output for '$file'"
+
+		bench_run "hexdump -C" "$runs" "" \
+			hexdump -C "$file"
+	fi
+
+	rm -rf "$tmpdir"
+}
+
+# Compare abox split with the system version on large binary and
+# text files.
+bench_split()
+{
+	local abox="${1:-}"
+	[ -z "$abox" ] && die "need abox binary"
+	[ -x "$abox" ] || die "invalid abox binary: '$abox'"
+
+	local runs="${2:-5}"
+
+	command -v split &>/dev/null || die "need command: 'split'"
+
+	local tmpdir
+	tmpdir=$(mktemp -d -p "${BENCH_DIR:-/var/tmp}")
+
+	info "creating benchmark files in '$tmpdir'"
+
+	local binary="$tmpdir/random"
+	local text="$tmpdir/data.txt"
+	local out="$tmpdir/out"
+	local expected="$tmpdir/expected"
+
+	head -c 512M /dev/urandom > "$binary"
+
+	seq 1 20000000 |\
+		awk '{ printf "%d some text for line %d\n", $1, $1 }' \
+		> "$text"
+
+	sync
+
+	local args
+
+	for args in "-n 16 $binary" "-b 64M $binary" "-l 1000000 $text"
+	do
+		bench_run "abox split $args" "$runs" "rm -rf '$out'; mkdir '$out'" \
+			"$abox" split $args "$out/x"
+
+		rm -rf "$expected"
+		mkdir "$expected"
+
+		split $args "$expected/x"
+
+		diff -r "$out" "$expected" >/dev/null ||\
+			die "abox split produced bad output for '$args'"
+
+		bench_run "split $args" "$runs" "rm -rf '$out'; mkdir '$out'" \
+			split $args "$out/x"
+	done
+
+	# Pipe input.
+	bench_run "abox split -l 1000000 (pipe)" "$runs" "rm -rf '$out'; mkdir '$out'" \
+		bash -c "cat '$text' | '$abox' split -l 1000000 - '$out/x'"
+
+	bench_run "split -l 1000000 (pipe)" "$runs" "rm -rf '$out'; mkdir '$out'" \
+		bash -c "cat '$text' | split -l 1000000 - '$out/x'"
+
+	rm -rf "$tmpdir"
+}
+
+handle_bench()
+{
+	local cmd="${1:-}"
+	[ -z "$cmd" ] && die "need benchmark name"
+
+	shift || true
+
+	case "$cmd" in
+		cp) bench_cp "$@" ;;
+		cut) bench_cut "$@" ;;
+		hexdump) bench_hexdump "$@" ;;
+		size) bench_size "$@" ;;
+		sleep) bench_sleep "$@" ;;
+		split) bench_split "$@" ;;
+		zcat) bench_zcat "$@" ;;
+		*) die "invalid benchmark: '$cmd'" ;;
+	esac
+}
+
 handle_generate()
 {
 	local cmd="${1:-}"
@@ -406,6 +924,7 @@ handle_generate()
 		commands) generate_commands "$@" ;;
 		defines) generate_defines "$@" ;;
 		details) generate_details "$@" ;;
+		linker-script) generate_linker_script "$@" ;;
 		test-settings) generate_test_settings "$@" ;;
 		*) die "invalid generate command: '$@'" ;;
 	esac
@@ -424,11 +943,25 @@ usage()
 
 	Commands:
 
+	  bench cp <abox> [runs] : Compare abox cp with cp(1).
+	  bench cut <abox> [runs]
+	                         : Compare abox cut with cut(1).
+	  bench hexdump <abox> [runs]
+	                         : Compare abox od and hexdump with od(1) and hexdump(1).
+	  bench size <abox> [runs] [cmd]
+	                         : Show binary size and startup page faults.
+	  bench sleep <abox> [runs]
+	                         : Show how late short sleeps wake (in ns).
+	  bench split <abox> [runs]
+	                         : Compare abox split with split(1).
+	  bench zcat <abox> [runs]
+	                         : Compare abox zcat with "gzip -dc".
 	  check                  : Perform basic static analysis on asm files in specified directory.
 	  help                   : Show usage.
 	  generate commands      : Generate command structures asm header.
 	  generate defines       : Generate defines for system attributes like errno.
 	  generate details       : Generate program details asm header.
+	  generate linker-script : Generate linker script to order hot and cold sections.
 	  generate test-settings : Generate settings file for bats tests.
 
 	EOT
@@ -443,6 +976,7 @@ handle_args()
 
 	case "$cmd" in
 		help|-h|--help) usage ;;
+		bench) handle_bench "$@" ;;
 		check) handle_check "$@" ;;
 		generate) handle_generate "$@" ;;
 		*) die "invalid command: '$cmd'" ;;